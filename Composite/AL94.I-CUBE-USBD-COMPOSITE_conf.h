@@ -45,6 +45,9 @@
 /*---------- _USBD_USE_CDC_ECM  -----------*/
 #define _USBD_USE_CDC_ECM      false
 
+/*---------- _USBD_USE_CDC_NCM  -----------*/
+#define _USBD_USE_CDC_NCM      false
+
 /*---------- _USBD_USE_HID_MOUSE  -----------*/
 #define _USBD_USE_HID_MOUSE      false
 
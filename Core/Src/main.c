@@ -26,6 +26,11 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "usb_device.h"
+#include "usbd_msc_if.h"
+#include "usbd_cdc_ncm_if.h"
+#include "usbd_cdc_rndis_if.h"
+#include "usbd_cdc_ecm_if.h"
+#include "usbd_iperf.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -46,7 +51,7 @@
 /* Private variables ---------------------------------------------------------*/
 
 /* USER CODE BEGIN PV */
-
+static uint32_t led_tick;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -106,10 +111,28 @@ int main(void)
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-    LL_GPIO_ResetOutputPin(GREEN_LED_GPIO_Port, GREEN_LED_Pin);
-    HAL_Delay(1000);
-    LL_GPIO_SetOutputPin(GREEN_LED_GPIO_Port, GREEN_LED_Pin);
-    HAL_Delay(1000);
+#if (USBD_IPERF_USE_SERVER == 1U)
+    /* Pass timing behind USBD_Iperf_Load() */
+    USBD_Iperf_LoopTick();
+#endif /* USBD_IPERF_USE_SERVER */
+
+    /* MSC write-back and flash erase-ahead, keep the loop free of delays */
+    MSC_Storage_Process();
+
+    /* NCM datagram delivery and IN NTB flush timeout */
+    CDC_NCM_Process();
+
+    /* RNDIS IN transfer flush timeout */
+    CDC_RNDIS_Process();
+
+    /* ECM receive ring and network stack */
+    CDC_ECM_Process();
+
+    if ((HAL_GetTick() - led_tick) >= 1000U)
+    {
+      led_tick = HAL_GetTick();
+      LL_GPIO_TogglePin(GREEN_LED_GPIO_Port, GREEN_LED_Pin);
+    }
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
@@ -101,6 +101,12 @@ void MX_USB_DEVICE_Init(void)
     Error_Handler();
   }
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  if (USBD_CDC_NCM_RegisterInterface(&hUsbDevice, &USBD_CDC_NCM_fops) != USBD_OK)
+  {
+    Error_Handler();
+  }
+#endif
 #if (USBD_USE_HID_MOUSE == 1)
 #endif
 #if (USBD_USE_HID_KEYBOARD == 1)
@@ -0,0 +1,613 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_audio_dsp.c
+  * @brief          : Tone, gain and limiter chain for the audio classes.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           The chain works in place on interleaved left aligned 32-bit
+  *           samples, USBD_AUDIO_DSP_BLOCK frames at a time, and runs
+  *           three stages, each of which can be bypassed:
+  *
+  *             - Tone: a bass and a treble shelf (RBJ cookbook, S = 1) run
+  *               per channel with arm_biquad_cascade_df1_fast_q31(). A
+  *               shelf that boosts has its numerator scaled down by the
+  *               boost so the q31 state cannot wrap, the limiter gives the
+  *               level back. Flat settings skip the filter.
+  *             - Gain: volume and mute with arm_scale_q31(). When the
+  *               target moves the block is ramped sample by sample
+  *               instead, so a Feature Unit request never clicks.
+  *             - Limiter: the make-up gain of the tone stage is applied
+  *               in float, the peak of each frame is seen
+  *               USBD_AUDIO_DSP_LOOKAHEAD frames before it is played and
+  *               the gain ramps down linearly to reach the ceiling just in
+  *               time, then holds and releases exponentially.
+  *
+  *           Settings arrive from the USB interrupt while the chain runs
+  *           from the codec DMA callbacks. New shelf coefficients are
+  *           designed in the bank not in use and picked up at the start of
+  *           the next block, the pending bank is withdrawn while it is
+  *           written so a half designed one is never used.
+  *
+  *           Each stage is timed with the DWT cycle counter,
+  *           USBD_AudioDsp_GetLoad() returns the worst block of a stage as
+  *           per mille of the real time the block lasts, a short last block
+  *           of a transfer is weighed against its own shorter real time.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio_dsp.h"
+#include <string.h>
+
+#if defined(DWT)
+#define AUDIO_DSP_CYCCNT                 1U
+#else
+#define AUDIO_DSP_CYCCNT                 0U
+#endif /* DWT */
+
+/* Private define ------------------------------------------------------------*/
+#define AUDIO_DSP_Q31_SCALE              2147483648.0f
+
+/* Coefficients are stored halved, the kernel shifts the result back */
+#define AUDIO_DSP_EQ_POSTSHIFT           1U
+
+/* Private function prototypes -----------------------------------------------*/
+static void AudioDsp_Design(USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_EqBankTypeDef *bank);
+static void AudioDsp_Shelf(USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_BandTypeDef band,
+                           q31_t *coeffs, float32_t *makeup);
+static void AudioDsp_Block(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n);
+static void AudioDsp_Eq(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n);
+static void AudioDsp_Gain(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n,
+                          float32_t target);
+static void AudioDsp_Limiter(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n,
+                             float32_t makeup);
+static void AudioDsp_LimiterReset(USBD_AudioDsp_HandleTypeDef *hdsp);
+static float32_t AudioDsp_Volume(const USBD_AudioDsp_HandleTypeDef *hdsp);
+static q31_t AudioDsp_Q31(float32_t x);
+static uint32_t AudioDsp_Cycles(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Set up the chain for a rate, the host settings are kept
+  * @param  hdsp: chain instance
+  * @param  freq: sampling rate the chain runs at
+  * @param  channels: interleaved channels
+  * @retval USBD_FAIL on a rate or channel count it cannot run
+  */
+uint8_t USBD_AudioDsp_Init(USBD_AudioDsp_HandleTypeDef *hdsp, uint32_t freq, uint8_t channels)
+{
+  uint8_t ch;
+
+  if ((freq <= (uint32_t)(2.0f * USBD_AUDIO_DSP_TREBLE_FREQ)) || (channels == 0U) ||
+      (channels > USBD_AUDIO_DSP_MAX_CHANNELS))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hdsp->freq = freq;
+  hdsp->channels = channels;
+  hdsp->eq_active = 0U;
+  hdsp->eq_pending = 0U;
+  AudioDsp_Design(hdsp, &hdsp->eq[0]);
+
+  for (ch = 0U; ch < channels; ch++)
+  {
+    arm_biquad_cascade_df1_init_q31(&hdsp->biquad[ch], USBD_AUDIO_DSP_EQ_STAGES, hdsp->eq[0].coeffs,
+                                    hdsp->biquad_state[ch], AUDIO_DSP_EQ_POSTSHIFT);
+  }
+
+  hdsp->gain_target = AudioDsp_Volume(hdsp);
+  hdsp->lim_release = 1.0f - expf(-1000.0f / (USBD_AUDIO_DSP_RELEASE_MS * (float32_t)freq));
+
+  (void)memset(hdsp->cycles, 0, sizeof(hdsp->cycles));
+  (void)memset(hdsp->cycles_max, 0, sizeof(hdsp->cycles_max));
+  hdsp->cycles_budget = (uint32_t)(((uint64_t)SystemCoreClock * USBD_AUDIO_DSP_BLOCK) / freq);
+
+  USBD_AudioDsp_Reset(hdsp);
+
+#if (AUDIO_DSP_CYCCNT == 1U)
+  USBD_LL_StartCycleCounter();
+#endif /* AUDIO_DSP_CYCCNT */
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Flush the filters and the look-ahead, at the start of a stream
+  * @param  hdsp: chain instance
+  * @retval None
+  */
+void USBD_AudioDsp_Reset(USBD_AudioDsp_HandleTypeDef *hdsp)
+{
+  (void)memset(hdsp->biquad_state, 0, sizeof(hdsp->biquad_state));
+  hdsp->gain = hdsp->gain_target;
+  AudioDsp_LimiterReset(hdsp);
+}
+
+/**
+  * @brief  Run the chain in place
+  * @param  hdsp: chain instance
+  * @param  frames: interleaved left aligned 32-bit samples
+  * @param  count: number of frames
+  * @retval None
+  */
+void USBD_AudioDsp_Process(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t count)
+{
+  uint32_t n;
+
+  if (hdsp->freq == 0U)
+  {
+    return;
+  }
+
+  while (count != 0U)
+  {
+    n = MIN(count, USBD_AUDIO_DSP_BLOCK);
+    AudioDsp_Block(hdsp, frames, n);
+    frames += n * hdsp->channels;
+    count -= n;
+  }
+}
+
+/**
+  * @brief  Volume of the Feature Unit
+  * @param  hdsp: chain instance
+  * @param  volume: 1/256 dB, 0x8000 is silence
+  * @retval None
+  */
+void USBD_AudioDsp_SetVolume(USBD_AudioDsp_HandleTypeDef *hdsp, int16_t volume)
+{
+  hdsp->volume = volume;
+  hdsp->gain_target = AudioDsp_Volume(hdsp);
+}
+
+/**
+  * @brief  Mute of the Feature Unit
+  * @param  hdsp: chain instance
+  * @param  mute: 0 plays, anything else mutes
+  * @retval None
+  */
+void USBD_AudioDsp_SetMute(USBD_AudioDsp_HandleTypeDef *hdsp, uint8_t mute)
+{
+  hdsp->mute = mute;
+  hdsp->gain_target = AudioDsp_Volume(hdsp);
+}
+
+/**
+  * @brief  Bass or treble of the Feature Unit
+  * @param  hdsp: chain instance
+  * @param  band: shelf to change
+  * @param  level: 1/4 dB, as carried by the UAC request
+  * @retval None
+  */
+void USBD_AudioDsp_SetTone(USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_BandTypeDef band, int8_t level)
+{
+  uint8_t bank;
+
+  hdsp->tone[band] = level;
+  if (hdsp->freq == 0U)
+  {
+    return;
+  }
+
+  /* Withdraw a bank not picked up yet before writing it again */
+  bank = hdsp->eq_active ^ 1U;
+  hdsp->eq_pending = hdsp->eq_active;
+  AudioDsp_Design(hdsp, &hdsp->eq[bank]);
+  hdsp->eq_pending = bank;
+}
+
+/**
+  * @brief  Take stages out of the chain
+  * @param  hdsp: chain instance
+  * @param  bypass: USBD_AUDIO_DSP_BYPASS_xxx bits
+  * @retval None
+  */
+void USBD_AudioDsp_SetBypass(USBD_AudioDsp_HandleTypeDef *hdsp, uint8_t bypass)
+{
+  if (((hdsp->bypass ^ bypass) & USBD_AUDIO_DSP_BYPASS_LIMITER) != 0U)
+  {
+    AudioDsp_LimiterReset(hdsp);
+  }
+  hdsp->bypass = bypass;
+}
+
+/**
+  * @brief  CPU load of the worst block of a stage
+  * @param  hdsp: chain instance
+  * @param  stage: stage to report
+  * @retval per mille of the real time the block lasts, 0 without DWT
+  */
+uint32_t USBD_AudioDsp_GetLoad(const USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_StageTypeDef stage)
+{
+  if ((hdsp->cycles_budget == 0U) || (stage >= USBD_AUDIO_DSP_STAGES))
+  {
+    return 0U;
+  }
+  return (uint32_t)(((uint64_t)hdsp->cycles_max[stage] * 1000U) / hdsp->cycles_budget);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Design both shelves into a coefficient bank
+  * @param  hdsp: chain instance, rate and tone set
+  * @param  bank: bank to fill
+  * @retval None
+  */
+static void AudioDsp_Design(USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_EqBankTypeDef *bank)
+{
+  bank->makeup = 1.0f;
+  bank->flat = ((hdsp->tone[USBD_AUDIO_DSP_BASS] == 0) && (hdsp->tone[USBD_AUDIO_DSP_TREBLE] == 0)) ? 1U : 0U;
+
+  AudioDsp_Shelf(hdsp, USBD_AUDIO_DSP_BASS, &bank->coeffs[0], &bank->makeup);
+  AudioDsp_Shelf(hdsp, USBD_AUDIO_DSP_TREBLE, &bank->coeffs[5], &bank->makeup);
+}
+
+/**
+  * @brief  One shelf in the {b0, b1, b2, a1, a2} order of the CMSIS kernel
+  * @param  hdsp: chain instance
+  * @param  band: low shelf for the bass, high shelf for the treble
+  * @param  coeffs: five coefficients, halved
+  * @param  makeup: multiplied by the boost taken out of the numerator
+  * @retval None
+  */
+static void AudioDsp_Shelf(USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_BandTypeDef band,
+                           q31_t *coeffs, float32_t *makeup)
+{
+  float32_t db = (float32_t)hdsp->tone[band] / 4.0f;
+  float32_t f0 = (band == USBD_AUDIO_DSP_BASS) ? USBD_AUDIO_DSP_BASS_FREQ : USBD_AUDIO_DSP_TREBLE_FREQ;
+  float32_t a = powf(10.0f, db / 40.0f);
+  float32_t w0 = (2.0f * PI * f0) / (float32_t)hdsp->freq;
+  float32_t c = cosf(w0);
+  float32_t k = 2.0f * sqrtf(a) * (sinf(w0) / 2.0f) * 1.41421356f;
+  float32_t s = (band == USBD_AUDIO_DSP_BASS) ? 1.0f : -1.0f;
+  float32_t b[3];
+  float32_t a0;
+  float32_t a1;
+  float32_t a2;
+  float32_t head = 1.0f;
+  uint8_t i;
+
+  if (hdsp->tone[band] == 0)
+  {
+    coeffs[0] = (q31_t)(0.5f * AUDIO_DSP_Q31_SCALE);
+    coeffs[1] = 0;
+    coeffs[2] = 0;
+    coeffs[3] = 0;
+    coeffs[4] = 0;
+    return;
+  }
+
+  /* Low and high shelves differ by the sign of the (A - 1) cos terms */
+  b[0] = a * ((a + 1.0f) - (s * (a - 1.0f) * c) + k);
+  b[1] = 2.0f * s * a * ((a - 1.0f) - (s * (a + 1.0f) * c));
+  b[2] = a * ((a + 1.0f) - (s * (a - 1.0f) * c) - k);
+  a0 = (a + 1.0f) + (s * (a - 1.0f) * c) + k;
+  a1 = -2.0f * s * ((a - 1.0f) + (s * (a + 1.0f) * c));
+  a2 = (a + 1.0f) + (s * (a - 1.0f) * c) - k;
+
+  /* A boosting shelf peaks at A^2, keep its output within full scale */
+  if (db > 0.0f)
+  {
+    head = 1.0f / (a * a);
+    *makeup *= a * a;
+  }
+
+  for (i = 0U; i < 3U; i++)
+  {
+    coeffs[i] = AudioDsp_Q31((b[i] * head) / (2.0f * a0));
+  }
+  coeffs[3] = AudioDsp_Q31(-a1 / (2.0f * a0));
+  coeffs[4] = AudioDsp_Q31(-a2 / (2.0f * a0));
+}
+
+/**
+  * @brief  Run the stages over one block
+  * @param  hdsp: chain instance
+  * @param  frames: interleaved samples
+  * @param  n: frames, at most USBD_AUDIO_DSP_BLOCK
+  * @retval None
+  */
+static void AudioDsp_Block(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n)
+{
+  USBD_AudioDsp_EqBankTypeDef *bank;
+  float32_t target;
+  uint32_t t[USBD_AUDIO_DSP_STAGES + 1U];
+  uint32_t full;
+  uint8_t ch;
+  uint8_t stage;
+
+  /* New shelves take over between two blocks, the filter state carries on */
+  if (hdsp->eq_pending != hdsp->eq_active)
+  {
+    hdsp->eq_active = hdsp->eq_pending;
+    for (ch = 0U; ch < hdsp->channels; ch++)
+    {
+      hdsp->biquad[ch].pCoeffs = hdsp->eq[hdsp->eq_active].coeffs;
+    }
+  }
+  bank = &hdsp->eq[hdsp->eq_active];
+
+  t[0] = AudioDsp_Cycles();
+  if (((hdsp->bypass & USBD_AUDIO_DSP_BYPASS_EQ) == 0U) && (bank->flat == 0U))
+  {
+    AudioDsp_Eq(hdsp, frames, n);
+  }
+
+  /* Without the limiter the make-up of the shelves goes with the volume */
+  t[1] = AudioDsp_Cycles();
+  target = ((hdsp->bypass & USBD_AUDIO_DSP_BYPASS_GAIN) == 0U) ? hdsp->gain_target : 1.0f;
+  if (((hdsp->bypass & USBD_AUDIO_DSP_BYPASS_EQ) == 0U) &&
+      ((hdsp->bypass & USBD_AUDIO_DSP_BYPASS_LIMITER) != 0U))
+  {
+    target *= bank->makeup;
+  }
+  AudioDsp_Gain(hdsp, frames, n, target);
+
+  t[2] = AudioDsp_Cycles();
+  if ((hdsp->bypass & USBD_AUDIO_DSP_BYPASS_LIMITER) == 0U)
+  {
+    AudioDsp_Limiter(hdsp, frames, n,
+                     ((hdsp->bypass & USBD_AUDIO_DSP_BYPASS_EQ) == 0U) ? bank->makeup : 1.0f);
+  }
+  t[3] = AudioDsp_Cycles();
+
+  for (stage = 0U; stage < USBD_AUDIO_DSP_STAGES; stage++)
+  {
+    hdsp->cycles[stage] = t[stage + 1U] - t[stage];
+
+    /* A short block has a shorter real time budget, compare at full block */
+    full = (uint32_t)(((uint64_t)hdsp->cycles[stage] * USBD_AUDIO_DSP_BLOCK) / n);
+    if (full > hdsp->cycles_max[stage])
+    {
+      hdsp->cycles_max[stage] = full;
+    }
+  }
+}
+
+/**
+  * @brief  Tone stage, one channel at a time through the scratch buffer
+  * @param  hdsp: chain instance
+  * @param  frames: interleaved samples
+  * @param  n: frames
+  * @retval None
+  */
+static void AudioDsp_Eq(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n)
+{
+  uint32_t i;
+  uint8_t ch;
+
+  for (ch = 0U; ch < hdsp->channels; ch++)
+  {
+    for (i = 0U; i < n; i++)
+    {
+      hdsp->scratch[i] = frames[(i * hdsp->channels) + ch];
+    }
+    arm_biquad_cascade_df1_fast_q31(&hdsp->biquad[ch], hdsp->scratch, hdsp->scratch, n);
+    for (i = 0U; i < n; i++)
+    {
+      frames[(i * hdsp->channels) + ch] = hdsp->scratch[i];
+    }
+  }
+}
+
+/**
+  * @brief  Gain stage
+  * @param  hdsp: chain instance
+  * @param  frames: interleaved samples
+  * @param  n: frames
+  * @param  target: linear gain to reach by the end of the block
+  * @retval None
+  */
+static void AudioDsp_Gain(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n,
+                          float32_t target)
+{
+  float32_t g = hdsp->gain;
+  float32_t step;
+  int8_t shift = 0;
+  uint32_t i;
+  uint8_t ch;
+
+  if (target != g)
+  {
+    step = (target - g) / (float32_t)n;
+    for (i = 0U; i < n; i++)
+    {
+      g += step;
+      for (ch = 0U; ch < hdsp->channels; ch++)
+      {
+        *frames = AudioDsp_Q31((float32_t)*frames * (g / AUDIO_DSP_Q31_SCALE));
+        frames++;
+      }
+    }
+    hdsp->gain = target;
+    return;
+  }
+
+  if (g == 1.0f)
+  {
+    return;
+  }
+
+  /* Fraction below one and a left shift for what is above */
+  while ((g >= 1.0f) && (shift < 8))
+  {
+    g *= 0.5f;
+    shift++;
+  }
+  arm_scale_q31(frames, AudioDsp_Q31(g), shift, frames, n * hdsp->channels);
+}
+
+/**
+  * @brief  Look-ahead limiter
+  * @param  hdsp: chain instance
+  * @param  frames: interleaved samples
+  * @param  n: frames
+  * @param  makeup: gain applied before the peaks are measured
+  * @retval None
+  */
+static void AudioDsp_Limiter(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t n,
+                             float32_t makeup)
+{
+  float32_t in[USBD_AUDIO_DSP_MAX_CHANNELS];
+  float32_t scale = makeup / AUDIO_DSP_Q31_SCALE;
+  float32_t peak;
+  float32_t req;
+  float32_t step;
+  uint32_t i;
+  uint8_t ch;
+
+  for (i = 0U; i < n; i++)
+  {
+    peak = 0.0f;
+    for (ch = 0U; ch < hdsp->channels; ch++)
+    {
+      in[ch] = (float32_t)frames[ch] * scale;
+      peak = MAX(peak, fabsf(in[ch]));
+    }
+
+    /* Gain the frame needs once it leaves the delay line */
+    req = (peak > USBD_AUDIO_DSP_LIMIT_CEILING) ? (USBD_AUDIO_DSP_LIMIT_CEILING / peak) : 1.0f;
+
+    if (req < 1.0f)
+    {
+      /* Deeper peaks take over, shallower ones wait for the hold to end */
+      if (req <= hdsp->lim_target)
+      {
+        hdsp->lim_target = req;
+        hdsp->lim_pending = 1.0f;
+      }
+      else if (req < hdsp->lim_pending)
+      {
+        hdsp->lim_pending = req;
+      }
+      step = (hdsp->lim_gain - hdsp->lim_target) / (float32_t)USBD_AUDIO_DSP_LOOKAHEAD;
+      hdsp->lim_step = MAX(hdsp->lim_step, step);
+      hdsp->lim_hold = USBD_AUDIO_DSP_LOOKAHEAD;
+    }
+    else if (hdsp->lim_hold != 0U)
+    {
+      hdsp->lim_hold--;
+      if ((hdsp->lim_hold == 0U) && (hdsp->lim_pending < 1.0f))
+      {
+        hdsp->lim_target = hdsp->lim_pending;
+        hdsp->lim_pending = 1.0f;
+        hdsp->lim_hold = USBD_AUDIO_DSP_LOOKAHEAD;
+      }
+    }
+    else
+    {
+      hdsp->lim_target = 1.0f;
+    }
+
+    if (hdsp->lim_gain > hdsp->lim_target)
+    {
+      hdsp->lim_gain -= hdsp->lim_step;
+      if (hdsp->lim_gain <= hdsp->lim_target)
+      {
+        hdsp->lim_gain = hdsp->lim_target;
+        hdsp->lim_step = 0.0f;
+      }
+    }
+    else
+    {
+      hdsp->lim_gain += (hdsp->lim_target - hdsp->lim_gain) * hdsp->lim_release;
+    }
+
+    for (ch = 0U; ch < hdsp->channels; ch++)
+    {
+      frames[ch] = AudioDsp_Q31(hdsp->lim_delay[hdsp->lim_pos][ch] * hdsp->lim_gain);
+      hdsp->lim_delay[hdsp->lim_pos][ch] = in[ch];
+    }
+    frames += hdsp->channels;
+
+    hdsp->lim_pos++;
+    if (hdsp->lim_pos == USBD_AUDIO_DSP_LOOKAHEAD)
+    {
+      hdsp->lim_pos = 0U;
+    }
+  }
+}
+
+/**
+  * @brief  Empty the look-ahead and open the limiter
+  * @param  hdsp: chain instance
+  * @retval None
+  */
+static void AudioDsp_LimiterReset(USBD_AudioDsp_HandleTypeDef *hdsp)
+{
+  (void)memset(hdsp->lim_delay, 0, sizeof(hdsp->lim_delay));
+  hdsp->lim_gain = 1.0f;
+  hdsp->lim_target = 1.0f;
+  hdsp->lim_pending = 1.0f;
+  hdsp->lim_step = 0.0f;
+  hdsp->lim_hold = 0U;
+  hdsp->lim_pos = 0U;
+}
+
+/**
+  * @brief  Linear gain of the volume and mute settings
+  * @param  hdsp: chain instance
+  * @retval gain
+  */
+static float32_t AudioDsp_Volume(const USBD_AudioDsp_HandleTypeDef *hdsp)
+{
+  if ((hdsp->mute != 0U) || (hdsp->volume == INT16_MIN))
+  {
+    return 0.0f;
+  }
+  return powf(10.0f, (float32_t)hdsp->volume / (256.0f * 20.0f));
+}
+
+/**
+  * @brief  Float in [-1, 1) to q31 with saturation
+  * @param  x: sample
+  * @retval q31 sample
+  */
+static q31_t AudioDsp_Q31(float32_t x)
+{
+  if (x >= 1.0f)
+  {
+    return INT32_MAX;
+  }
+  if (x < -1.0f)
+  {
+    return INT32_MIN;
+  }
+  return (q31_t)(x * AUDIO_DSP_Q31_SCALE);
+}
+
+/**
+  * @brief  Core cycle counter
+  * @retval cycles, 0 without DWT
+  */
+static uint32_t AudioDsp_Cycles(void)
+{
+#if (AUDIO_DSP_CYCCNT == 1U)
+  return DWT->CYCCNT;
+#else
+  return 0U;
+#endif /* AUDIO_DSP_CYCCNT */
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,195 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_audio_dsp.h
+  * @brief          : Header for usbd_audio_dsp.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_AUDIO_DSP_H__
+#define __USBD_AUDIO_DSP_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+#include "arm_math.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_AUDIO_DSP USBD_AUDIO_DSP
+  * @brief Tone, gain and limiter chain applied to an audio stream
+  * @{
+  */
+
+/** @defgroup USBD_AUDIO_DSP_Exported_Defines USBD_AUDIO_DSP_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+#ifndef USBD_AUDIO_DSP_MAX_CHANNELS
+#define USBD_AUDIO_DSP_MAX_CHANNELS      2U
+#endif /* USBD_AUDIO_DSP_MAX_CHANNELS */
+
+/* Frames per stage call, 1 ms at 48 kHz */
+#ifndef USBD_AUDIO_DSP_BLOCK
+#define USBD_AUDIO_DSP_BLOCK             48U
+#endif /* USBD_AUDIO_DSP_BLOCK */
+
+/* Corner frequencies of the bass and treble shelves in Hz */
+#ifndef USBD_AUDIO_DSP_BASS_FREQ
+#define USBD_AUDIO_DSP_BASS_FREQ         200.0f
+#endif /* USBD_AUDIO_DSP_BASS_FREQ */
+
+#ifndef USBD_AUDIO_DSP_TREBLE_FREQ
+#define USBD_AUDIO_DSP_TREBLE_FREQ       4000.0f
+#endif /* USBD_AUDIO_DSP_TREBLE_FREQ */
+
+/* Limiter ceiling as a share of full scale, -1 dBFS */
+#ifndef USBD_AUDIO_DSP_LIMIT_CEILING
+#define USBD_AUDIO_DSP_LIMIT_CEILING     0.891f
+#endif /* USBD_AUDIO_DSP_LIMIT_CEILING */
+
+/* Limiter look-ahead in frames, also the latency it adds */
+#ifndef USBD_AUDIO_DSP_LOOKAHEAD
+#define USBD_AUDIO_DSP_LOOKAHEAD         48U
+#endif /* USBD_AUDIO_DSP_LOOKAHEAD */
+
+/* Time constant of the limiter release in ms */
+#ifndef USBD_AUDIO_DSP_RELEASE_MS
+#define USBD_AUDIO_DSP_RELEASE_MS        50.0f
+#endif /* USBD_AUDIO_DSP_RELEASE_MS */
+
+/* Bass and treble shelves */
+#define USBD_AUDIO_DSP_EQ_STAGES         2U
+
+/* Bypass mask bits */
+#define USBD_AUDIO_DSP_BYPASS_EQ         (1U << USBD_AUDIO_DSP_STAGE_EQ)
+#define USBD_AUDIO_DSP_BYPASS_GAIN       (1U << USBD_AUDIO_DSP_STAGE_GAIN)
+#define USBD_AUDIO_DSP_BYPASS_LIMITER    (1U << USBD_AUDIO_DSP_STAGE_LIMITER)
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_AUDIO_DSP_Exported_Types USBD_AUDIO_DSP_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+typedef enum
+{
+  USBD_AUDIO_DSP_STAGE_EQ = 0U,
+  USBD_AUDIO_DSP_STAGE_GAIN,
+  USBD_AUDIO_DSP_STAGE_LIMITER,
+  USBD_AUDIO_DSP_STAGES,
+} USBD_AudioDsp_StageTypeDef;
+
+typedef enum
+{
+  USBD_AUDIO_DSP_BASS = 0U,
+  USBD_AUDIO_DSP_TREBLE,
+} USBD_AudioDsp_BandTypeDef;
+
+/* Shelf coefficients and the make-up gain that goes with their headroom,
+   swapped as a whole between two blocks */
+typedef struct
+{
+  q31_t coeffs[5U * USBD_AUDIO_DSP_EQ_STAGES];
+  float32_t makeup;
+  uint8_t flat;
+} USBD_AudioDsp_EqBankTypeDef;
+
+typedef struct
+{
+  uint32_t freq;
+  uint8_t channels;
+  uint8_t bypass;               /* USBD_AUDIO_DSP_BYPASS_xxx, 0 runs every stage */
+
+  /* Settings as the host sent them, kept over a change of rate */
+  int16_t volume;               /* 1/256 dB */
+  uint8_t mute;
+  int8_t tone[2];               /* Bass and treble, 1/4 dB */
+
+  /* Tone */
+  USBD_AudioDsp_EqBankTypeDef eq[2];
+  volatile uint8_t eq_active;
+  volatile uint8_t eq_pending;
+  arm_biquad_casd_df1_inst_q31 biquad[USBD_AUDIO_DSP_MAX_CHANNELS];
+  q31_t biquad_state[USBD_AUDIO_DSP_MAX_CHANNELS][4U * USBD_AUDIO_DSP_EQ_STAGES];
+  q31_t scratch[USBD_AUDIO_DSP_BLOCK];
+
+  /* Gain, ramped over one block when the target moves */
+  float32_t gain;
+  volatile float32_t gain_target;
+
+  /* Limiter */
+  float32_t lim_gain;
+  float32_t lim_target;
+  float32_t lim_pending;
+  float32_t lim_step;
+  float32_t lim_release;
+  uint32_t lim_hold;
+  uint32_t lim_pos;
+  float32_t lim_delay[USBD_AUDIO_DSP_LOOKAHEAD][USBD_AUDIO_DSP_MAX_CHANNELS];
+
+  uint32_t cycles[USBD_AUDIO_DSP_STAGES];       /* CPU cycles of each stage on the last block */
+  uint32_t cycles_max[USBD_AUDIO_DSP_STAGES];   /* Worst block since the last init, scaled to a full block */
+  uint32_t cycles_budget;                       /* CPU cycles in the real time of one block */
+} USBD_AudioDsp_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_AUDIO_DSP_Exported_FunctionsPrototype USBD_AUDIO_DSP_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+uint8_t USBD_AudioDsp_Init(USBD_AudioDsp_HandleTypeDef *hdsp, uint32_t freq, uint8_t channels);
+void USBD_AudioDsp_Reset(USBD_AudioDsp_HandleTypeDef *hdsp);
+void USBD_AudioDsp_Process(USBD_AudioDsp_HandleTypeDef *hdsp, int32_t *frames, uint32_t count);
+
+void USBD_AudioDsp_SetVolume(USBD_AudioDsp_HandleTypeDef *hdsp, int16_t volume);
+void USBD_AudioDsp_SetMute(USBD_AudioDsp_HandleTypeDef *hdsp, uint8_t mute);
+void USBD_AudioDsp_SetTone(USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_BandTypeDef band, int8_t level);
+void USBD_AudioDsp_SetBypass(USBD_AudioDsp_HandleTypeDef *hdsp, uint8_t bypass);
+
+uint32_t USBD_AudioDsp_GetLoad(const USBD_AudioDsp_HandleTypeDef *hdsp, USBD_AudioDsp_StageTypeDef stage);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_AUDIO_DSP_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,330 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_audio_loop.c
+  * @brief          : Latency of the speaker to microphone loopback.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           In loopback the speaker samples, once converted and processed
+  *           for the codec, are handed to the microphone in place of the
+  *           captured ones. They cross every buffer a played and recorded
+  *           sample crosses: the speaker buffer, both rate converters and
+  *           Feature Unit chains, and the microphone ring.
+  *
+  *           A host tool measures the latency with markers it embeds in the
+  *           stream it plays: a burst whose left channel rises above
+  *           USBD_AUDIO_LOOP_THRESHOLD after at least
+  *           USBD_AUDIO_LOOP_QUIET_MS of silence. Volume must leave the
+  *           burst above the threshold once processed.
+  *
+  *           The onset is timestamped with the DWT cycle counter twice:
+  *             - USBD_AudioLoop_MarkIn() when the packet that carries it
+  *               reaches the speaker endpoint, plus the frames before it in
+  *               the packet.
+  *             - USBD_AudioLoop_MarkOut() when it is written to the
+  *               microphone ring, plus the frames queued ahead of it, which
+  *               the endpoint drains at the microphone rate.
+  *           The difference is the time the device holds a sample. The host
+  *           tool takes it from its own round trip to see what its stack
+  *           adds, and compares the figures of each buffer configuration.
+  *
+  *           One marker is followed at a time. The handle starts zeroed with
+  *           the loop off, the statistics restart when either rate changes
+  *           and USBD_AudioLoop_GetStats() reads them. The CDC ACM glue
+  *           takes "loop on", "loop off" and "loop stats" from the tool.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio_loop.h"
+#include <string.h>
+
+#if defined(DWT)
+#define AUDIO_LOOP_CYCCNT                1U
+#else
+#define AUDIO_LOOP_CYCCNT                0U
+#endif /* DWT */
+
+/* Private define ------------------------------------------------------------*/
+#define AUDIO_LOOP_THRESHOLD             ((int32_t)USBD_AUDIO_LOOP_THRESHOLD)
+
+/* Private function prototypes -----------------------------------------------*/
+static void AudioLoop_Restart(USBD_AudioLoop_HandleTypeDef *hloop);
+static uint8_t AudioLoop_Loud(int32_t sample);
+static void AudioLoop_Timeout(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t now);
+static void AudioLoop_Account(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t latency_us);
+static uint32_t AudioLoop_Cycles(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Turn the loop on or off, a marker on its way is dropped
+  * @param  hloop: loop instance
+  * @param  enable: 1 to feed the microphone from the speaker
+  * @retval None
+  */
+void USBD_AudioLoop_Enable(USBD_AudioLoop_HandleTypeDef *hloop, uint8_t enable)
+{
+  hloop->pending = 0U;
+  hloop->in_quiet = 0U;
+  hloop->out_quiet = 0U;
+
+#if (AUDIO_LOOP_CYCCNT == 1U)
+  USBD_LL_StartCycleCounter();
+#endif /* AUDIO_LOOP_CYCCNT */
+
+  hloop->enabled = (enable != 0U) ? 1U : 0U;
+}
+
+/**
+  * @brief  Rate of the speaker stream
+  * @param  hloop: loop instance
+  * @param  freq: sampling rate selected by the host
+  * @retval None
+  */
+void USBD_AudioLoop_SetInput(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t freq)
+{
+  if (freq != hloop->stats.in_freq)
+  {
+    hloop->stats.in_freq = freq;
+    AudioLoop_Restart(hloop);
+  }
+}
+
+/**
+  * @brief  Rate of the microphone stream
+  * @param  hloop: loop instance
+  * @param  freq: sampling rate selected by the host
+  * @retval None
+  */
+void USBD_AudioLoop_SetOutput(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t freq)
+{
+  if (freq != hloop->stats.out_freq)
+  {
+    hloop->stats.out_freq = freq;
+    AudioLoop_Restart(hloop);
+  }
+}
+
+/**
+  * @brief  Look for a marker in a packet received on the speaker endpoint
+  * @param  hloop: loop instance
+  * @param  pbuf: packet as received
+  * @param  size: bytes of the packet
+  * @param  subframe: bytes per sample, 2 or 3
+  * @param  channels: interleaved channels, the first one is watched
+  * @note   Call from the USB interrupt as the packet arrives.
+  * @retval None
+  */
+void USBD_AudioLoop_MarkIn(USBD_AudioLoop_HandleTypeDef *hloop, const uint8_t *pbuf, uint32_t size,
+                           uint8_t subframe, uint8_t channels)
+{
+  uint32_t frame = (uint32_t)subframe * channels;
+  uint32_t quiet;
+  uint32_t now;
+  uint32_t k;
+  int32_t sample;
+
+  if ((hloop->enabled == 0U) || (hloop->stats.in_freq == 0U) || (frame == 0U))
+  {
+    return;
+  }
+
+  now = AudioLoop_Cycles();
+  quiet = (hloop->stats.in_freq * USBD_AUDIO_LOOP_QUIET_MS) / 1000U;
+
+  for (k = 0U; k < (size / frame); k++)
+  {
+    if (subframe == 3U)
+    {
+      sample = (int32_t)(((uint32_t)pbuf[2] << 24) | ((uint32_t)pbuf[1] << 16) | ((uint32_t)pbuf[0] << 8));
+    }
+    else
+    {
+      sample = (int32_t)(((uint32_t)pbuf[1] << 24) | ((uint32_t)pbuf[0] << 16));
+    }
+    pbuf += frame;
+
+    if (AudioLoop_Loud(sample) == 0U)
+    {
+      hloop->in_quiet++;
+      continue;
+    }
+
+    /* Only the microphone side ends a marker, a new one waits for it */
+    if ((hloop->in_quiet >= quiet) && (hloop->pending == 0U))
+    {
+      hloop->t_in = now + (uint32_t)(((uint64_t)k * SystemCoreClock) / hloop->stats.in_freq);
+      __DMB();
+      hloop->pending = 1U;
+    }
+    hloop->in_quiet = 0U;
+  }
+}
+
+/**
+  * @brief  Look for the marker in samples about to enter the microphone ring
+  * @param  hloop: loop instance
+  * @param  frames: left aligned 32-bit samples at the microphone rate
+  * @param  count: number of frames
+  * @param  channels: interleaved channels, the first one is watched
+  * @param  queued: frames already in the ring, sent before these
+  * @retval None
+  */
+void USBD_AudioLoop_MarkOut(USBD_AudioLoop_HandleTypeDef *hloop, const int32_t *frames, uint32_t count,
+                            uint8_t channels, uint32_t queued)
+{
+  uint32_t quiet;
+  uint32_t now;
+  uint32_t t_out;
+  uint32_t k;
+
+  if ((hloop->enabled == 0U) || (hloop->stats.out_freq == 0U))
+  {
+    return;
+  }
+
+  now = AudioLoop_Cycles();
+  quiet = (hloop->stats.out_freq * USBD_AUDIO_LOOP_QUIET_MS) / 1000U;
+  AudioLoop_Timeout(hloop, now);
+
+  for (k = 0U; k < count; k++)
+  {
+    if (AudioLoop_Loud(frames[k * channels]) == 0U)
+    {
+      hloop->out_quiet++;
+      continue;
+    }
+
+    if ((hloop->out_quiet >= quiet) && (hloop->pending != 0U))
+    {
+      /* Leaves the device once the frames ahead of it have been sent */
+      t_out = now + (uint32_t)(((uint64_t)(queued + k) * SystemCoreClock) / hloop->stats.out_freq);
+      AudioLoop_Account(hloop, (t_out - hloop->t_in) / (SystemCoreClock / 1000000U));
+      hloop->pending = 0U;
+    }
+    hloop->out_quiet = 0U;
+  }
+}
+
+/**
+  * @brief  Copy the figures of the current configuration
+  * @param  hloop: loop instance
+  * @param  stats: receives the figures
+  * @retval None
+  */
+void USBD_AudioLoop_GetStats(const USBD_AudioLoop_HandleTypeDef *hloop, USBD_AudioLoop_StatsTypeDef *stats)
+{
+  *stats = hloop->stats;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Restart the figures, the rates are kept
+  * @param  hloop: loop instance
+  * @retval None
+  */
+static void AudioLoop_Restart(USBD_AudioLoop_HandleTypeDef *hloop)
+{
+  uint32_t in_freq = hloop->stats.in_freq;
+  uint32_t out_freq = hloop->stats.out_freq;
+
+  (void)memset(&hloop->stats, 0, sizeof(hloop->stats));
+  hloop->stats.in_freq = in_freq;
+  hloop->stats.out_freq = out_freq;
+  hloop->stats.min_us = 0xFFFFFFFFU;
+  hloop->sum_us = 0U;
+  hloop->jitter = 0U;
+  hloop->pending = 0U;
+}
+
+/**
+  * @brief  Whether a sample is past the marker threshold
+  * @param  sample: left aligned 32-bit sample
+  * @retval 1 when loud
+  */
+static uint8_t AudioLoop_Loud(int32_t sample)
+{
+  return ((sample >= AUDIO_LOOP_THRESHOLD) || (sample <= -AUDIO_LOOP_THRESHOLD)) ? 1U : 0U;
+}
+
+/**
+  * @brief  Give up on a marker that did not come back
+  * @param  hloop: loop instance
+  * @param  now: cycle count
+  * @retval None
+  */
+static void AudioLoop_Timeout(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t now)
+{
+  if (hloop->pending == 0U)
+  {
+    return;
+  }
+
+  /* A marker is timestamped ahead by up to a packet, the difference wraps */
+  if ((int32_t)(now - hloop->t_in) > (int32_t)((SystemCoreClock / 1000U) * USBD_AUDIO_LOOP_TIMEOUT_MS))
+  {
+    hloop->stats.lost++;
+    hloop->pending = 0U;
+  }
+}
+
+/**
+  * @brief  Add a marker to the figures
+  * @param  hloop: loop instance
+  * @param  latency_us: time it spent in the device
+  * @retval None
+  */
+static void AudioLoop_Account(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t latency_us)
+{
+  int32_t delta;
+
+  if (hloop->stats.markers != 0U)
+  {
+    delta = (int32_t)latency_us - (int32_t)hloop->stats.last_us;
+    delta = (delta < 0) ? -delta : delta;
+    hloop->jitter += (uint32_t)delta - (hloop->jitter >> 4);
+    hloop->stats.jitter_us = hloop->jitter >> 4;
+  }
+
+  hloop->stats.markers++;
+  hloop->stats.last_us = latency_us;
+  hloop->stats.min_us = MIN(hloop->stats.min_us, latency_us);
+  hloop->stats.max_us = MAX(hloop->stats.max_us, latency_us);
+  hloop->sum_us += latency_us;
+  hloop->stats.mean_us = (uint32_t)(hloop->sum_us / hloop->stats.markers);
+}
+
+/**
+  * @brief  Time base of the timestamps
+  * @param  None
+  * @retval CPU cycles, from the tick where there is no cycle counter
+  */
+static uint32_t AudioLoop_Cycles(void)
+{
+#if (AUDIO_LOOP_CYCCNT == 1U)
+  return DWT->CYCCNT;
+#else
+  return HAL_GetTick() * (SystemCoreClock / 1000U);
+#endif /* AUDIO_LOOP_CYCCNT */
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
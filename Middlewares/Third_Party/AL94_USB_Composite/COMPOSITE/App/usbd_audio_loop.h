@@ -0,0 +1,139 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_audio_loop.h
+  * @brief          : Header for usbd_audio_loop.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_AUDIO_LOOP_H__
+#define __USBD_AUDIO_LOOP_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_AUDIO_LOOP USBD_AUDIO_LOOP
+  * @brief Latency of the speaker to microphone loopback
+  * @{
+  */
+
+/** @defgroup USBD_AUDIO_LOOP_Exported_Defines USBD_AUDIO_LOOP_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Set to 1 to let the speaker stream feed the microphone on request, the
+   composite must then have both audio functions */
+#ifndef USBD_AUDIO_LOOP_ENABLED
+#define USBD_AUDIO_LOOP_ENABLED          0U
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+
+/* Left channel level, left aligned, that starts a marker: -12 dBFS */
+#ifndef USBD_AUDIO_LOOP_THRESHOLD
+#define USBD_AUDIO_LOOP_THRESHOLD        0x20000000
+#endif /* USBD_AUDIO_LOOP_THRESHOLD */
+
+/* Silence needed before the next marker, longer than the bursts the host
+   plays so their tail is not taken for a new one */
+#ifndef USBD_AUDIO_LOOP_QUIET_MS
+#define USBD_AUDIO_LOOP_QUIET_MS         50U
+#endif /* USBD_AUDIO_LOOP_QUIET_MS */
+
+/* A marker not seen back by then is counted lost */
+#ifndef USBD_AUDIO_LOOP_TIMEOUT_MS
+#define USBD_AUDIO_LOOP_TIMEOUT_MS       1000U
+#endif /* USBD_AUDIO_LOOP_TIMEOUT_MS */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_AUDIO_LOOP_Exported_Types USBD_AUDIO_LOOP_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+/* Figures of the current stream configuration, restarted when a rate changes */
+typedef struct
+{
+  uint32_t in_freq;        /* Speaker rate */
+  uint32_t out_freq;       /* Microphone rate */
+  uint32_t markers;        /* Markers seen back */
+  uint32_t lost;
+  uint32_t last_us;        /* From the speaker endpoint to the microphone endpoint */
+  uint32_t min_us;
+  uint32_t max_us;
+  uint32_t mean_us;
+  uint32_t jitter_us;      /* Smoothed change between consecutive markers, as RFC 3550 */
+  uint32_t skipped;        /* Blocks not looped, the codecs run from different crystals */
+} USBD_AudioLoop_StatsTypeDef;
+
+typedef struct
+{
+  __IO uint8_t enabled;
+  uint32_t in_quiet;       /* Frames below the threshold on each side */
+  uint32_t out_quiet;
+  __IO uint8_t pending;    /* A marker went in and has not come out yet */
+  __IO uint32_t t_in;      /* Cycle count at which it went in */
+  uint64_t sum_us;
+  uint32_t jitter;         /* Jitter in 1/16 us */
+  USBD_AudioLoop_StatsTypeDef stats;
+} USBD_AudioLoop_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_AUDIO_LOOP_Exported_FunctionsPrototype USBD_AUDIO_LOOP_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void USBD_AudioLoop_Enable(USBD_AudioLoop_HandleTypeDef *hloop, uint8_t enable);
+void USBD_AudioLoop_SetInput(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t freq);
+void USBD_AudioLoop_SetOutput(USBD_AudioLoop_HandleTypeDef *hloop, uint32_t freq);
+void USBD_AudioLoop_MarkIn(USBD_AudioLoop_HandleTypeDef *hloop, const uint8_t *pbuf, uint32_t size,
+                           uint8_t subframe, uint8_t channels);
+void USBD_AudioLoop_MarkOut(USBD_AudioLoop_HandleTypeDef *hloop, const int32_t *frames, uint32_t count,
+                            uint8_t channels, uint32_t queued);
+void USBD_AudioLoop_GetStats(const USBD_AudioLoop_HandleTypeDef *hloop, USBD_AudioLoop_StatsTypeDef *stats);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_AUDIO_LOOP_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -21,9 +21,13 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_audio_mic_if.h"
+#include "usbd_audio_src.h"
+#include "usbd_audio_dsp.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* Frames the converter may return for one capture block */
+#define AUDIO_HOST_FRAMES ((AUDIO_MIC_CAPTURE_FRAMES + USBD_AUDIO_SRC_BLOCK) * USBD_AUDIO_SRC_MAX_FACTOR)
 /* Private macro -------------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
 static int8_t Audio_Init(uint32_t  AudioFreq, uint32_t BitRes, uint32_t ChnlNbr);
@@ -35,9 +39,29 @@ static int8_t Audio_Stop(void);
 static int8_t Audio_Pause(void);
 static int8_t Audio_Resume(void);
 static int8_t Audio_CommandMgr(uint8_t cmd);
+static int8_t Audio_ToneCtl(uint8_t control, int8_t level);
+static void Audio_Deliver(const int32_t *frames, uint32_t count);
 
 /* Private variables ---------------------------------------------------------*/
 extern USBD_HandleTypeDef hUsbDeviceFS;
+extern USBD_HandleTypeDef hUsbDevice;
+
+/* Codec to host rate conversion */
+static USBD_AudioSrc_HandleTypeDef AUDIO_Src USBD_AUDIO_SRC_SECTION;
+static int32_t AUDIO_Host[AUDIO_HOST_FRAMES * AUDIO_MIC_CHANNELS] USBD_AUDIO_SRC_SECTION;
+static uint8_t AUDIO_Subframe = 2U;
+
+/* Feature Unit processing at the host rate, keeps its settings over a
+   change of rate so it stays out of the NOLOAD section */
+static USBD_AudioDsp_HandleTypeDef AUDIO_Dsp;
+
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+/* Speaker samples looped back, at the codec rate */
+static int32_t AUDIO_Loopback[AUDIO_MIC_CAPTURE_FRAMES * AUDIO_MIC_CHANNELS];
+
+/* Also fed by the speaker interface, turned on from the CDC ACM port */
+USBD_AudioLoop_HandleTypeDef AUDIO_Loop;
+#endif /* USBD_AUDIO_LOOP_ENABLED */
 
 USBD_AUDIO_MIC_ItfTypeDef USBD_AUDIO_MIC_fops_FS = {
   Audio_Init,
@@ -49,22 +73,10 @@ USBD_AUDIO_MIC_ItfTypeDef USBD_AUDIO_MIC_fops_FS = {
   Audio_Pause,
   Audio_Resume,
   Audio_CommandMgr,
+  Audio_ToneCtl,
 };
 
 /* Private functions ---------------------------------------------------------*/
-/* This table maps the audio device class setting in 1/256 dB to a
-* linear 0-64 scaling used in pdm_filter.c. It is computed as
-* 256*20*log10(index/64). */
-const int16_t vol_table[65] =
-{ 0x8000, 0xDBE0, 0xE1E6, 0xE56B, 0xE7EB, 0xE9DB, 0xEB70, 0xECC7,
-0xEDF0, 0xEEF6, 0xEFE0, 0xF0B4, 0xF176, 0xF228, 0xF2CD, 0xF366,
-0xF3F5, 0xF47C, 0xF4FB, 0xF574, 0xF5E6, 0xF652, 0xF6BA, 0xF71C,
-0xF778, 0xF7D6, 0xF82D, 0xF881, 0xF8D2, 0xF920, 0xF96B, 0xF9B4,
-0xF9FB, 0xFA3F, 0xFA82, 0xFAC2, 0xFB01, 0xFB3E, 0xFB79, 0xFBB3,
-0xFBEB, 0xFC22, 0xFC57, 0xFC8C, 0xFCBF, 0xFCF1, 0xFD22, 0xFD51,
-0xFD80, 0xFDAE, 0xFDDB, 0xFE07, 0xFE32, 0xFE5D, 0xFE86, 0xFEAF,
-0xFED7, 0xFF00, 0xFF25, 0xFF4B, 0xFF70, 0xFF95, 0xFFB9, 0xFFD0,
-0x0000 };
 
 
 /**
@@ -76,6 +88,20 @@ const int16_t vol_table[65] =
 */
 static int8_t Audio_Init(uint32_t  AudioFreq, uint32_t BitRes, uint32_t ChnlNbr)
 {
+  /* The codec runs from the crystal family of the host rate, the converter
+     makes up what is left (48 to 96 kHz) */
+  if (USBD_AudioSrc_Init(&AUDIO_Src, USBD_AudioSrc_CodecFreq(AudioFreq), AudioFreq, (uint8_t)ChnlNbr) != USBD_OK)
+  {
+    return USBD_FAIL;
+  }
+  if (USBD_AudioDsp_Init(&AUDIO_Dsp, AudioFreq, (uint8_t)ChnlNbr) != USBD_OK)
+  {
+    return USBD_FAIL;
+  }
+  AUDIO_Subframe = (BitRes == 24U) ? 3U : 2U;
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  USBD_AudioLoop_SetOutput(&AUDIO_Loop, AudioFreq);
+#endif /* USBD_AUDIO_LOOP_ENABLED */
   return USBD_OK;
 }
 
@@ -100,20 +126,13 @@ static int8_t Audio_Record(void)
 
 /**
 * @brief  Controls AUDIO Volume.
-* @param  vol: Volume level
+* @param  Volume: Volume level in 1/256 dB
 * @retval BSP_ERROR_NONE in case of success, AUDIO_ERROR otherwise
 */
 static int8_t Audio_VolumeCtl(int16_t Volume)
 {
-  /* Call low layer volume setting function */
-  uint32_t j = 0;
-
-  /* Find the setting nearest to the desired setting */
-	while(j<64 && abs(Volume-vol_table[j]) > abs(Volume-vol_table[j+1]))
-	{
-		j++;
-	}
-  /** TODO */
+  /* Ramped in by the gain stage over the next block */
+  USBD_AudioDsp_SetVolume(&AUDIO_Dsp, Volume);
   return USBD_OK;
 }
 
@@ -124,6 +143,7 @@ static int8_t Audio_VolumeCtl(int16_t Volume)
 */
 static int8_t Audio_MuteCtl(uint8_t cmd)
 {
+  USBD_AudioDsp_SetMute(&AUDIO_Dsp, cmd);
   return USBD_OK;
 }
 
@@ -171,4 +191,140 @@ static int8_t Audio_CommandMgr(uint8_t cmd)
   return USBD_OK;
 }
 
+/**
+* @brief  Controls AUDIO bass and treble.
+* @param  control: AUDIO_BASS_CONTROL or AUDIO_TREBLE_CONTROL
+* @param  level: level in 1/4 dB
+* @retval BSP_ERROR_NONE in case of success, AUDIO_ERROR otherwise
+*/
+static int8_t Audio_ToneCtl(uint8_t control, int8_t level)
+{
+  USBD_AudioDsp_SetTone(&AUDIO_Dsp, (control == AUDIO_BASS_CONTROL) ? USBD_AUDIO_DSP_BASS : USBD_AUDIO_DSP_TREBLE,
+                        level);
+  return USBD_OK;
+}
+
+/**
+* @brief  Hands samples captured by the codec over to the host
+* @param  frames: left aligned 32-bit samples, AUDIO_MIC_CHANNELS per frame
+* @param  count: number of frames, at most AUDIO_MIC_CAPTURE_FRAMES
+* @note   Call from the codec DMA half and full transfer callbacks. What the
+*         ring cannot take is dropped, and so is everything while the
+*         speaker is looped back.
+* @retval None
+*/
+void Audio_Capture(const int32_t *frames, uint32_t count)
+{
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  if (AUDIO_Loop.enabled != 0U)
+  {
+    return;
+  }
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+
+  Audio_Deliver(frames, count);
+}
+
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+/**
+* @brief  Hands speaker samples over to the host in place of the captured ones
+* @param  frames: left aligned 32-bit samples as sent to the speaker codec
+* @param  count: number of frames
+* @param  channels: interleaved channels, the first AUDIO_MIC_CHANNELS are kept
+* @param  freq: speaker codec rate
+* @note   Call from the speaker codec DMA callbacks. The microphone converter
+*         expects its own codec rate, a speaker stream of the other crystal
+*         family is not looped.
+* @retval None
+*/
+void Audio_Loopback(const int32_t *frames, uint32_t count, uint8_t channels, uint32_t freq)
+{
+  uint32_t n;
+  uint32_t i;
+  uint32_t ch;
+
+  if ((AUDIO_Loop.enabled == 0U) || (channels < AUDIO_MIC_CHANNELS))
+  {
+    return;
+  }
+  if (freq != AUDIO_Src.in_freq)
+  {
+    AUDIO_Loop.stats.skipped++;
+    return;
+  }
+
+  while (count != 0U)
+  {
+    n = MIN(count, AUDIO_MIC_CAPTURE_FRAMES);
+    for (i = 0U; i < n; i++)
+    {
+      for (ch = 0U; ch < AUDIO_MIC_CHANNELS; ch++)
+      {
+        AUDIO_Loopback[(i * AUDIO_MIC_CHANNELS) + ch] = frames[(i * channels) + ch];
+      }
+    }
+    Audio_Deliver(AUDIO_Loopback, n);
+    frames += n * channels;
+    count -= n;
+  }
+}
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+
+/**
+* @brief  Converts and processes codec samples, then queues them in the ring
+* @param  frames: left aligned 32-bit samples, AUDIO_MIC_CHANNELS per frame
+* @param  count: number of frames, at most AUDIO_MIC_CAPTURE_FRAMES
+* @retval None
+*/
+static void Audio_Deliver(const int32_t *frames, uint32_t count)
+{
+  const int32_t *src = AUDIO_Host;
+  uint32_t samples;
+  uint32_t length;
+  uint32_t n;
+  uint8_t *dst;
+
+  samples = USBD_AudioSrc_Process(&AUDIO_Src, frames, MIN(count, AUDIO_MIC_CAPTURE_FRAMES), AUDIO_Host);
+  USBD_AudioDsp_Process(&AUDIO_Dsp, AUDIO_Host, samples);
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  USBD_AudioLoop_MarkOut(&AUDIO_Loop, AUDIO_Host, samples, AUDIO_MIC_CHANNELS,
+                         USBD_AUDIO_MIC_GetLevel(&hUsbDevice) / (AUDIO_Subframe * AUDIO_MIC_CHANNELS));
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+  samples *= AUDIO_MIC_CHANNELS;
+
+  /* The free part of the ring may be split by its end */
+  while (samples != 0U)
+  {
+    dst = USBD_AUDIO_MIC_GetWriteBuffer(&hUsbDevice, &length);
+    n = MIN(samples, length / AUDIO_Subframe);
+    if ((dst == NULL) || (n == 0U))
+    {
+      break;
+    }
+    USBD_AudioSrc_Pack(src, AUDIO_Subframe, dst, n);
+    (void)USBD_AUDIO_MIC_CommitWrite(&hUsbDevice, n * AUDIO_Subframe);
+    src += n;
+    samples -= n;
+  }
+}
+
+/**
+* @brief  CPU load of the rate conversion
+* @retval Worst block in per mille of its real time
+*/
+uint32_t Audio_GetSrcLoad(void)
+{
+  return USBD_AudioSrc_GetLoad(&AUDIO_Src);
+}
+
+/**
+* @brief  CPU load of a stage of the Feature Unit processing
+* @param  stage: USBD_AUDIO_DSP_STAGE_EQ, _GAIN or _LIMITER
+* @retval Worst block in per mille of its real time
+*/
+uint32_t Audio_GetDspLoad(uint8_t stage)
+{
+  return USBD_AudioDsp_GetLoad(&AUDIO_Dsp, (USBD_AudioDsp_StageTypeDef)stage);
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
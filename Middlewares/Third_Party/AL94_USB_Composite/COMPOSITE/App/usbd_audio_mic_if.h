@@ -25,13 +25,26 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_audio_mic.h"
+#include "usbd_audio_loop.h"
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
+/* Codec frames handed over per call of Audio_Capture, 1 ms at 48 kHz */
+#ifndef AUDIO_MIC_CAPTURE_FRAMES
+#define AUDIO_MIC_CAPTURE_FRAMES 48U
+#endif /* AUDIO_MIC_CAPTURE_FRAMES */
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 
 extern USBD_AUDIO_MIC_ItfTypeDef USBD_AUDIO_MIC_fops_FS;
 
+void Audio_Capture(const int32_t *frames, uint32_t count);
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+void Audio_Loopback(const int32_t *frames, uint32_t count, uint8_t channels, uint32_t freq);
+extern USBD_AudioLoop_HandleTypeDef AUDIO_Loop;
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+uint32_t Audio_GetSrcLoad(void);
+uint32_t Audio_GetDspLoad(uint8_t stage);
+
 #endif /* __USBD_AUDIO_IF_H */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
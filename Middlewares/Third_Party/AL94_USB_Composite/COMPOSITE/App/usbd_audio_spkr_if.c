@@ -24,6 +24,12 @@
 
 /* USER CODE BEGIN INCLUDE */
 //#include "cs43l22.h"
+#include "usbd_audio_src.h"
+#include "usbd_audio_dsp.h"
+#include "usbd_audio_loop.h"
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+#include "usbd_audio_mic_if.h"
+#endif /* USBD_AUDIO_LOOP_ENABLED */
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -64,6 +70,13 @@
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
 
+/* Stereo frames in half of the class buffer at the highest rate */
+#define AUDIO_STREAM_HALF_FRAMES ((AUDIO_SPKR_FRAMES(AUDIO_SPKR_MAX_FREQ) * AUDIO_OUT_PACKET_NUM) / 2U)
+
+/* The codec never runs faster than the stream: a half converts to at most
+   as many frames, plus a block held back by the converter */
+#define AUDIO_CODEC_HALF_FRAMES  (AUDIO_STREAM_HALF_FRAMES + USBD_AUDIO_SRC_BLOCK)
+
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -90,6 +103,24 @@
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
 
+/* Stream to codec rate conversion */
+static USBD_AudioSrc_HandleTypeDef AUDIO_Src USBD_AUDIO_SRC_SECTION;
+static int32_t AUDIO_Stream[AUDIO_STREAM_HALF_FRAMES * AUDIO_SPKR_CHANNELS] USBD_AUDIO_SRC_SECTION;
+
+/* Codec DMA buffer, left aligned 32-bit samples played as two halves */
+static int32_t AUDIO_Codec[2U][AUDIO_CODEC_HALF_FRAMES * AUDIO_SPKR_CHANNELS] USBD_AUDIO_SRC_SECTION;
+static uint32_t AUDIO_CodecFrames;
+
+/* Class buffer given at START, converted one half after the other */
+static uint8_t *AUDIO_StreamBuf;
+static uint32_t AUDIO_StreamHalf;
+static uint8_t AUDIO_StreamNext;
+static uint8_t AUDIO_Subframe = 2U;
+
+/* Feature Unit processing at the codec rate, keeps its settings over a
+   change of rate so it stays out of the NOLOAD section */
+static USBD_AudioDsp_HandleTypeDef AUDIO_Dsp;
+
 /* USER CODE END PRIVATE_VARIABLES */
 
 /**
@@ -119,13 +150,18 @@ extern USBD_HandleTypeDef hUsbDevice;
 static int8_t AUDIO_Init(uint32_t AudioFreq, uint32_t Volume, uint32_t options);
 static int8_t AUDIO_DeInit(uint32_t options);
 static int8_t AUDIO_AudioCmd(uint8_t* pbuf, uint32_t size, uint8_t cmd);
-static int8_t AUDIO_VolumeCtl(uint8_t vol);
+static int8_t AUDIO_VolumeCtl(int16_t Volume);
 static int8_t AUDIO_MuteCtl(uint8_t cmd);
 static int8_t AUDIO_PeriodicTC(uint8_t *pbuf, uint32_t size, uint8_t cmd);
 static int8_t AUDIO_GetState(void);
+static uint32_t AUDIO_GetClockCount(void);
+static int8_t AUDIO_ToneCtl(uint8_t control, int8_t level);
+static uint16_t AUDIO_GetReadAhead(uint16_t half);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
 
+static uint32_t AUDIO_Convert(int32_t *codec);
+
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
 /**
@@ -141,6 +177,9 @@ USBD_AUDIO_SPKR_ItfTypeDef USBD_AUDIO_SPKR_fops =
   AUDIO_MuteCtl,
   AUDIO_PeriodicTC,
   AUDIO_GetState,
+  AUDIO_GetClockCount,
+  AUDIO_ToneCtl,
+  AUDIO_GetReadAhead,
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -148,15 +187,37 @@ USBD_AUDIO_SPKR_ItfTypeDef USBD_AUDIO_SPKR_fops =
   * @brief  Initializes the AUDIO media low layer over USB FS IP
   * @param  AudioFreq: Audio frequency used to play the audio stream.
   * @param  Volume: Initial volume level (from 0 (Mute) to 100 (Max))
-  * @param  options: Reserved for future use 
+  * @param  options: Bit resolution of the stream, 16 or 24
   * @retval USBD_OK if all operations are OK else USBD_FAIL
   */
 static int8_t AUDIO_Init(uint32_t AudioFreq, uint32_t Volume, uint32_t options)
 {
   /* USER CODE BEGIN 0 */
-  UNUSED(AudioFreq);
+  uint32_t codec_freq = USBD_AudioSrc_CodecFreq(AudioFreq);
+
   UNUSED(Volume);
-  UNUSED(options);
+
+  /* The codec runs from the crystal family of the stream, the converter
+     makes up what is left (96 to 48 kHz) */
+  if (codec_freq > AudioFreq)
+  {
+    return (USBD_FAIL);
+  }
+  if (USBD_AudioSrc_Init(&AUDIO_Src, AudioFreq, codec_freq, AUDIO_SPKR_CHANNELS) != USBD_OK)
+  {
+    return (USBD_FAIL);
+  }
+  if (USBD_AudioDsp_Init(&AUDIO_Dsp, codec_freq, AUDIO_SPKR_CHANNELS) != USBD_OK)
+  {
+    return (USBD_FAIL);
+  }
+
+  AUDIO_Subframe = (options == 24U) ? 3U : 2U;
+  AUDIO_StreamBuf = NULL;
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  USBD_AudioLoop_SetInput(&AUDIO_Loop, AudioFreq);
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+  //cs43l22_Init(CS43L22_I2C_ADDRESS, OUTPUT_DEVICE_AUTO, Volume, codec_freq);
   return (USBD_OK);
   /* USER CODE END 0 */
 }
@@ -187,28 +248,41 @@ static int8_t AUDIO_AudioCmd(uint8_t* pbuf, uint32_t size, uint8_t cmd)
   switch(cmd)
   {
     case AUDIO_CMD_START:
+    /* First half converted, the second one plays silence while the class
+       buffer fills up behind it */
+    AUDIO_StreamBuf = pbuf;
+    AUDIO_StreamHalf = size;
+    AUDIO_StreamNext = 0U;
+    USBD_AudioSrc_Reset(&AUDIO_Src);
+    USBD_AudioDsp_Reset(&AUDIO_Dsp);
+    AUDIO_CodecFrames = AUDIO_Convert(AUDIO_Codec[0]);
+    (void)USBD_memset(AUDIO_Codec[1], 0, AUDIO_CodecFrames * AUDIO_SPKR_CHANNELS * sizeof(int32_t));
+    //HAL_SAI_Transmit_DMA(&hsai_BlockA1, (uint8_t *)AUDIO_Codec, 2U * AUDIO_CodecFrames * AUDIO_SPKR_CHANNELS);
     break;
 
     case AUDIO_CMD_PLAY:
-    break;	
+    /* The feedback keeps the halves at their size, nothing to restart */
+    break;
+
+    case AUDIO_CMD_STOP:
+    AUDIO_StreamBuf = NULL;
+    //HAL_SAI_DMAStop(&hsai_BlockA1);
+    break;
   }
-  UNUSED(pbuf);
-  UNUSED(size);
-  UNUSED(cmd);
   return (USBD_OK);
   /* USER CODE END 2 */
 }
 
 /**
   * @brief  Controls AUDIO Volume.
-  * @param  vol: volume level (0..100)
+  * @param  Volume: volume level in 1/256 dB
   * @retval USBD_OK if all operations are OK else USBD_FAIL
   */
-static int8_t AUDIO_VolumeCtl(uint8_t vol)
+static int8_t AUDIO_VolumeCtl(int16_t Volume)
 {
   /* USER CODE BEGIN 3 */
-  UNUSED(vol);
-  //cs43l22_SetVolume(CS43L22_I2C_ADDRESS, vol);
+  /* Applied in the samples, the codec stays at a fixed level */
+  USBD_AudioDsp_SetVolume(&AUDIO_Dsp, Volume);
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -221,8 +295,7 @@ static int8_t AUDIO_VolumeCtl(uint8_t vol)
 static int8_t AUDIO_MuteCtl(uint8_t cmd)
 {
   /* USER CODE BEGIN 4 */
-  UNUSED(cmd);
-  //cs43l22_SetMute(CS43L22_I2C_ADDRESS, cmd);
+  USBD_AudioDsp_SetMute(&AUDIO_Dsp, cmd);
   return (USBD_OK);
   /* USER CODE END 4 */
 }
@@ -235,9 +308,14 @@ static int8_t AUDIO_MuteCtl(uint8_t cmd)
 static int8_t AUDIO_PeriodicTC(uint8_t *pbuf, uint32_t size, uint8_t cmd)
 {
   /* USER CODE BEGIN 5 */
+  UNUSED(cmd);
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  /* Timestamp latency markers as they reach the endpoint */
+  USBD_AudioLoop_MarkIn(&AUDIO_Loop, pbuf, size, AUDIO_Subframe, AUDIO_SPKR_CHANNELS);
+#else
   UNUSED(pbuf);
   UNUSED(size);
-  UNUSED(cmd);
+#endif /* USBD_AUDIO_LOOP_ENABLED */
   return (USBD_OK);
   /* USER CODE END 5 */
 }
@@ -253,6 +331,49 @@ static int8_t AUDIO_GetState(void)
   /* USER CODE END 6 */
 }
 
+/**
+  * @brief  Gets the codec clock count latched at the last SOF.
+  * @retval Free running count of the codec clock, for the feedback endpoint
+  */
+static uint32_t AUDIO_GetClockCount(void)
+{
+  /* USER CODE BEGIN 9 */
+  /* Clock a 32-bit timer from the codec MCLK on ETR (AUDIO_SPKR_FB_CLOCK_DIV
+     ticks per sample) and capture it on the OTG SOF internal trigger, then
+     return the capture register. A count that does not move leaves the
+     feedback to the buffer level alone. When resampled, scale the count by
+     AUDIO_Src.in_freq / AUDIO_Src.out_freq to stream samples. */
+  return 0U;
+  /* USER CODE END 9 */
+}
+
+/**
+  * @brief  Controls AUDIO bass and treble.
+  * @param  control: AUDIO_BASS_CONTROL or AUDIO_TREBLE_CONTROL
+  * @param  level: level in 1/4 dB
+  * @retval USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t AUDIO_ToneCtl(uint8_t control, int8_t level)
+{
+  /* USER CODE BEGIN 10 */
+  USBD_AudioDsp_SetTone(&AUDIO_Dsp, (control == AUDIO_BASS_CONTROL) ? USBD_AUDIO_DSP_BASS : USBD_AUDIO_DSP_TREBLE,
+                        level);
+  return (USBD_OK);
+  /* USER CODE END 10 */
+}
+
+/**
+  * @brief  Bytes of the class buffer taken ahead of the codec DMA.
+  * @param  half: bytes of a class buffer half
+  * @retval A whole half is converted at each codec half point
+  */
+static uint16_t AUDIO_GetReadAhead(uint16_t half)
+{
+  /* USER CODE BEGIN 11 */
+  return half;
+  /* USER CODE END 11 */
+}
+
 /**
   * @brief  Manages the DMA full transfer complete event.
   * @retval None
@@ -260,6 +381,8 @@ static int8_t AUDIO_GetState(void)
 void TransferComplete_CallBack(void)
 {
   /* USER CODE BEGIN 7 */
+  /* Second codec half played: refill it from the next stream half */
+  (void)AUDIO_Convert(AUDIO_Codec[1]);
 	USBD_AUDIO_SPKR_Sync(&hUsbDevice, AUDIO_OFFSET_FULL);
   /* USER CODE END 7 */
 }
@@ -271,12 +394,63 @@ void TransferComplete_CallBack(void)
 void HalfTransfer_CallBack(void)
 {
   /* USER CODE BEGIN 8 */
+  /* First codec half played: refill it from the next stream half */
+  (void)AUDIO_Convert(AUDIO_Codec[0]);
 	USBD_AUDIO_SPKR_Sync(&hUsbDevice, AUDIO_OFFSET_HALF);
   /* USER CODE END 8 */
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+/**
+  * @brief  Converts the next half of the class buffer to the codec rate.
+  * @param  codec: codec half to fill
+  * @retval Frames written, constant for a given rate pair as a stream half
+  *         is a whole number of converter blocks
+  */
+static uint32_t AUDIO_Convert(int32_t *codec)
+{
+  uint32_t frames;
+  uint32_t out;
+
+  if (AUDIO_StreamBuf == NULL)
+  {
+    return 0U;
+  }
+
+  frames = AUDIO_StreamHalf / ((uint32_t)AUDIO_Subframe * AUDIO_SPKR_CHANNELS);
+  USBD_AudioSrc_Unpack(&AUDIO_StreamBuf[AUDIO_StreamNext * AUDIO_StreamHalf], AUDIO_Subframe,
+                       AUDIO_Stream, frames * AUDIO_SPKR_CHANNELS);
+  AUDIO_StreamNext ^= 1U;
+
+  out = USBD_AudioSrc_Process(&AUDIO_Src, AUDIO_Stream, frames, codec);
+  USBD_AudioDsp_Process(&AUDIO_Dsp, codec, out);
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  Audio_Loopback(codec, out, AUDIO_SPKR_CHANNELS, AUDIO_Src.out_freq);
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+
+  return out;
+}
+
+/**
+  * @brief  CPU load of the rate conversion.
+  * @retval Worst block in per mille of its real time
+  */
+uint32_t AUDIO_SPKR_GetSrcLoad(void)
+{
+  return USBD_AudioSrc_GetLoad(&AUDIO_Src);
+}
+
+/**
+  * @brief  CPU load of a stage of the Feature Unit processing.
+  * @param  stage: USBD_AUDIO_DSP_STAGE_EQ, _GAIN or _LIMITER
+  * @retval Worst block in per mille of its real time
+  */
+uint32_t AUDIO_SPKR_GetDspLoad(uint8_t stage)
+{
+  return USBD_AudioDsp_GetLoad(&AUDIO_Dsp, (USBD_AudioDsp_StageTypeDef)stage);
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
@@ -117,6 +117,9 @@ void HalfTransfer_CallBack_FS(void);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
 
+uint32_t AUDIO_SPKR_GetSrcLoad(void);
+uint32_t AUDIO_SPKR_GetDspLoad(uint8_t stage);
+
 /* USER CODE END EXPORTED_FUNCTIONS */
 
 /**
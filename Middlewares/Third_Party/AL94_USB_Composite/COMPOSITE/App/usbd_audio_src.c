@@ -0,0 +1,409 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_audio_src.c
+  * @brief          : Polyphase sample rate converter for the audio classes.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           The host picks the rate of the stream with SET_CUR on the
+  *           endpoint, the codec runs from one of two crystal families
+  *           (USBD_AudioSrc_CodecFreq()). The ratio between the two is
+  *           reduced to L/M and bridged with the CMSIS-DSP polyphase
+  *           kernels: arm_fir_interpolate_f32() by L, then
+  *           arm_fir_decimate_f32() by M, either stage skipped when its
+  *           factor is 1 and the samples copied when both are.
+  *
+  *           Both stages use a Blackman windowed sinc designed at init,
+  *           USBD_AUDIO_SRC_TAPS_PER_PHASE taps per branch of the larger
+  *           factor, cut at 45% of the lower Nyquist frequency. The
+  *           interpolator copy carries the gain of L.
+  *
+  *           Samples go in and out interleaved as left aligned 32-bit
+  *           integers, USBD_AudioSrc_Unpack/Pack() convert from and to the
+  *           2, 3 or 4 byte subframes of the USB stream. They are processed
+  *           in float per channel, USBD_AUDIO_SRC_BLOCK input frames at a
+  *           time, a partial block waits for the next call.
+  *
+  *           Each block is timed with the DWT cycle counter: the last and
+  *           worst blocks are kept in the handle next to the cycles the
+  *           block lasts in real time, USBD_AudioSrc_GetLoad() returns the
+  *           worst as per mille of that budget.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_audio_src.h"
+#include <string.h>
+
+#if defined(DWT)
+#define AUDIO_SRC_CYCCNT                 1U
+#else
+#define AUDIO_SRC_CYCCNT                 0U
+#endif /* DWT */
+
+/* Private define ------------------------------------------------------------*/
+/* Cutoff as a share of the lower Nyquist frequency */
+#define AUDIO_SRC_CUTOFF                 0.45f
+
+#define AUDIO_SRC_Q31_SCALE              2147483648.0f
+
+/* Private function prototypes -----------------------------------------------*/
+static void AudioSrc_Design(USBD_AudioSrc_HandleTypeDef *hsrc);
+static uint32_t AudioSrc_Block(USBD_AudioSrc_HandleTypeDef *hsrc, int32_t *out);
+static uint32_t AudioSrc_Gcd(uint32_t a, uint32_t b);
+static uint32_t AudioSrc_Cycles(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Codec rate a stream rate is converted to or from
+  * @param  freq: rate of the USB stream
+  * @retval rate of the crystal family the stream belongs to
+  */
+uint32_t USBD_AudioSrc_CodecFreq(uint32_t freq)
+{
+  return ((freq % 11025U) == 0U) ? USBD_AUDIO_SRC_CODEC_FREQ_44K1 : USBD_AUDIO_SRC_CODEC_FREQ_48K;
+}
+
+/**
+  * @brief  Set up a converter and design its filter
+  * @param  hsrc: converter instance
+  * @param  in_freq: input rate
+  * @param  out_freq: output rate
+  * @param  channels: interleaved channels
+  * @retval USBD_FAIL when the reduced ratio needs a factor over
+  *         USBD_AUDIO_SRC_MAX_FACTOR
+  */
+uint8_t USBD_AudioSrc_Init(USBD_AudioSrc_HandleTypeDef *hsrc, uint32_t in_freq,
+                           uint32_t out_freq, uint8_t channels)
+{
+  uint32_t gcd;
+  uint8_t ch;
+
+  if ((in_freq == 0U) || (out_freq == 0U) || (channels == 0U) ||
+      (channels > USBD_AUDIO_SRC_MAX_CHANNELS))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  gcd = AudioSrc_Gcd(in_freq, out_freq);
+  if (((out_freq / gcd) > USBD_AUDIO_SRC_MAX_FACTOR) || ((in_freq / gcd) > USBD_AUDIO_SRC_MAX_FACTOR))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hsrc->in_freq = in_freq;
+  hsrc->out_freq = out_freq;
+  hsrc->up = (uint8_t)(out_freq / gcd);
+  hsrc->down = (uint8_t)(in_freq / gcd);
+  hsrc->channels = channels;
+  hsrc->taps = (uint16_t)(USBD_AUDIO_SRC_TAPS_PER_PHASE * MAX(hsrc->up, hsrc->down));
+  hsrc->fill = 0U;
+  hsrc->cycles = 0U;
+  hsrc->cycles_max = 0U;
+  hsrc->blocks = 0U;
+  hsrc->cycles_budget = (uint32_t)(((uint64_t)SystemCoreClock * USBD_AUDIO_SRC_BLOCK) / in_freq);
+
+  AudioSrc_Design(hsrc);
+
+  for (ch = 0U; ch < channels; ch++)
+  {
+    if ((hsrc->up > 1U) &&
+        (arm_fir_interpolate_init_f32(&hsrc->interp[ch], hsrc->up, hsrc->taps, hsrc->coeffs_up,
+                                      hsrc->state_up[ch], USBD_AUDIO_SRC_BLOCK) != ARM_MATH_SUCCESS))
+    {
+      return (uint8_t)USBD_FAIL;
+    }
+    if ((hsrc->down > 1U) &&
+        (arm_fir_decimate_init_f32(&hsrc->decim[ch], hsrc->taps, hsrc->down, hsrc->coeffs_down,
+                                   hsrc->state_down[ch], USBD_AUDIO_SRC_BLOCK * hsrc->up) != ARM_MATH_SUCCESS))
+    {
+      return (uint8_t)USBD_FAIL;
+    }
+  }
+
+#if (AUDIO_SRC_CYCCNT == 1U)
+  USBD_LL_StartCycleCounter();
+#endif /* AUDIO_SRC_CYCCNT */
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Flush the filters and the partial block, at the start of a stream
+  * @param  hsrc: converter instance
+  * @retval None
+  */
+void USBD_AudioSrc_Reset(USBD_AudioSrc_HandleTypeDef *hsrc)
+{
+  (void)memset(hsrc->state_up, 0, sizeof(hsrc->state_up));
+  (void)memset(hsrc->state_down, 0, sizeof(hsrc->state_down));
+  hsrc->fill = 0U;
+}
+
+/**
+  * @brief  Convert interleaved frames
+  * @param  hsrc: converter instance
+  * @param  in: left aligned 32-bit samples at the input rate
+  * @param  frames: input frames
+  * @param  out: output samples, room for
+  *         (frames + USBD_AUDIO_SRC_BLOCK) * up / down frames
+  * @retval output frames written
+  */
+uint32_t USBD_AudioSrc_Process(USBD_AudioSrc_HandleTypeDef *hsrc, const int32_t *in,
+                               uint32_t frames, int32_t *out)
+{
+  uint32_t produced = 0U;
+  uint32_t n;
+  uint32_t i;
+  uint8_t ch;
+
+  if ((hsrc->up == 1U) && (hsrc->down == 1U))
+  {
+    (void)memcpy(out, in, frames * hsrc->channels * sizeof(int32_t));
+    return frames;
+  }
+
+  while (frames != 0U)
+  {
+    n = MIN(frames, USBD_AUDIO_SRC_BLOCK - hsrc->fill);
+
+    for (i = 0U; i < n; i++)
+    {
+      for (ch = 0U; ch < hsrc->channels; ch++)
+      {
+        hsrc->in[ch][hsrc->fill + i] = (float32_t)in[ch] * (1.0f / AUDIO_SRC_Q31_SCALE);
+      }
+      in += hsrc->channels;
+    }
+    frames -= n;
+    hsrc->fill += n;
+
+    if (hsrc->fill == USBD_AUDIO_SRC_BLOCK)
+    {
+      produced += AudioSrc_Block(hsrc, &out[produced * hsrc->channels]);
+      hsrc->fill = 0U;
+    }
+  }
+
+  return produced;
+}
+
+/**
+  * @brief  CPU load of the worst block
+  * @param  hsrc: converter instance
+  * @retval per mille of the real time the block lasts, 0 without DWT
+  */
+uint32_t USBD_AudioSrc_GetLoad(const USBD_AudioSrc_HandleTypeDef *hsrc)
+{
+  if (hsrc->cycles_budget == 0U)
+  {
+    return 0U;
+  }
+  return (uint32_t)(((uint64_t)hsrc->cycles_max * 1000U) / hsrc->cycles_budget);
+}
+
+/**
+  * @brief  Little endian USB subframes to left aligned 32-bit samples
+  * @param  src: packed samples
+  * @param  subframe: bytes per sample, 2, 3 or 4
+  * @param  dst: 32-bit samples
+  * @param  samples: number of samples, all channels
+  * @retval None
+  */
+void USBD_AudioSrc_Unpack(const uint8_t *src, uint8_t subframe, int32_t *dst, uint32_t samples)
+{
+  uint32_t i;
+
+  for (i = 0U; i < samples; i++)
+  {
+    switch (subframe)
+    {
+    case 2U:
+      dst[i] = (int32_t)(((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 24));
+      break;
+
+    case 3U:
+      dst[i] = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24));
+      break;
+
+    default:
+      dst[i] = (int32_t)((uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+                         ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24));
+      break;
+    }
+    src += subframe;
+  }
+}
+
+/**
+  * @brief  Left aligned 32-bit samples to little endian USB subframes
+  * @param  src: 32-bit samples
+  * @param  subframe: bytes per sample, 2, 3 or 4, the low bytes are dropped
+  * @param  dst: packed samples
+  * @param  samples: number of samples, all channels
+  * @retval None
+  */
+void USBD_AudioSrc_Pack(const int32_t *src, uint8_t subframe, uint8_t *dst, uint32_t samples)
+{
+  uint32_t i;
+  uint8_t b;
+  uint32_t value;
+
+  for (i = 0U; i < samples; i++)
+  {
+    value = (uint32_t)src[i] >> (8U * (4U - subframe));
+    for (b = 0U; b < subframe; b++)
+    {
+      dst[b] = (uint8_t)(value >> (8U * b));
+    }
+    dst += subframe;
+  }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Blackman windowed sinc low pass, unity gain for the decimator
+  *         and L for the interpolator
+  * @param  hsrc: converter instance, factors and taps set
+  * @retval None
+  */
+static void AudioSrc_Design(USBD_AudioSrc_HandleTypeDef *hsrc)
+{
+  /* Cutoff in cycles per sample at the intermediate rate */
+  float32_t fc = AUDIO_SRC_CUTOFF / (2.0f * (float32_t)MAX(hsrc->up, hsrc->down));
+  float32_t centre = (float32_t)(hsrc->taps - 1U) / 2.0f;
+  float32_t span = (float32_t)(hsrc->taps - 1U);
+  float32_t sum = 0.0f;
+  float32_t t;
+  float32_t h;
+  uint16_t i;
+
+  for (i = 0U; i < hsrc->taps; i++)
+  {
+    t = (float32_t)i - centre;
+    h = (t == 0.0f) ? (2.0f * fc) : (sinf(2.0f * PI * fc * t) / (PI * t));
+    h *= 0.42f - (0.5f * cosf((2.0f * PI * (float32_t)i) / span)) +
+         (0.08f * cosf((4.0f * PI * (float32_t)i) / span));
+    hsrc->coeffs_down[i] = h;
+    sum += h;
+  }
+
+  for (i = 0U; i < hsrc->taps; i++)
+  {
+    hsrc->coeffs_down[i] /= sum;
+    hsrc->coeffs_up[i] = hsrc->coeffs_down[i] * (float32_t)hsrc->up;
+  }
+}
+
+/**
+  * @brief  Run one block of USBD_AUDIO_SRC_BLOCK input frames
+  * @param  hsrc: converter instance
+  * @param  out: interleaved output
+  * @retval output frames
+  */
+static uint32_t AudioSrc_Block(USBD_AudioSrc_HandleTypeDef *hsrc, int32_t *out)
+{
+  uint32_t start = AudioSrc_Cycles();
+  uint32_t n;
+  uint32_t i;
+  float32_t x;
+  uint8_t ch;
+
+  n = (USBD_AUDIO_SRC_BLOCK * hsrc->up) / hsrc->down;
+
+  for (ch = 0U; ch < hsrc->channels; ch++)
+  {
+    if (hsrc->down == 1U)
+    {
+      arm_fir_interpolate_f32(&hsrc->interp[ch], hsrc->in[ch], hsrc->out, USBD_AUDIO_SRC_BLOCK);
+    }
+    else if (hsrc->up == 1U)
+    {
+      arm_fir_decimate_f32(&hsrc->decim[ch], hsrc->in[ch], hsrc->out, USBD_AUDIO_SRC_BLOCK);
+    }
+    else
+    {
+      arm_fir_interpolate_f32(&hsrc->interp[ch], hsrc->in[ch], hsrc->mid, USBD_AUDIO_SRC_BLOCK);
+      arm_fir_decimate_f32(&hsrc->decim[ch], hsrc->mid, hsrc->out, USBD_AUDIO_SRC_BLOCK * hsrc->up);
+    }
+
+    for (i = 0U; i < n; i++)
+    {
+      x = hsrc->out[i];
+      if (x >= 1.0f)
+      {
+        out[(i * hsrc->channels) + ch] = INT32_MAX;
+      }
+      else if (x < -1.0f)
+      {
+        out[(i * hsrc->channels) + ch] = INT32_MIN;
+      }
+      else
+      {
+        out[(i * hsrc->channels) + ch] = (int32_t)(x * AUDIO_SRC_Q31_SCALE);
+      }
+    }
+  }
+
+  hsrc->cycles = AudioSrc_Cycles() - start;
+  if (hsrc->cycles > hsrc->cycles_max)
+  {
+    hsrc->cycles_max = hsrc->cycles;
+  }
+  hsrc->blocks++;
+
+  return n;
+}
+
+/**
+  * @brief  Greatest common divisor
+  * @param  a: first number, not 0
+  * @param  b: second number, not 0
+  * @retval gcd of a and b
+  */
+static uint32_t AudioSrc_Gcd(uint32_t a, uint32_t b)
+{
+  uint32_t r;
+
+  while (b != 0U)
+  {
+    r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/**
+  * @brief  Core cycle counter
+  * @retval cycles, 0 without DWT
+  */
+static uint32_t AudioSrc_Cycles(void)
+{
+#if (AUDIO_SRC_CYCCNT == 1U)
+  return DWT->CYCCNT;
+#else
+  return 0U;
+#endif /* AUDIO_SRC_CYCCNT */
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
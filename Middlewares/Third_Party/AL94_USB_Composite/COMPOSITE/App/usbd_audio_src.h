@@ -0,0 +1,155 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_audio_src.h
+  * @brief          : Header for usbd_audio_src.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_AUDIO_SRC_H__
+#define __USBD_AUDIO_SRC_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+#include "arm_math.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_AUDIO_SRC USBD_AUDIO_SRC
+  * @brief Polyphase sample rate converter between the USB and codec rates
+  * @{
+  */
+
+/** @defgroup USBD_AUDIO_SRC_Exported_Defines USBD_AUDIO_SRC_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+#ifndef USBD_AUDIO_SRC_MAX_CHANNELS
+#define USBD_AUDIO_SRC_MAX_CHANNELS      2U
+#endif /* USBD_AUDIO_SRC_MAX_CHANNELS */
+
+/* Largest interpolation or decimation factor once the ratio is reduced,
+   rates further apart need the codec clocked from the other family */
+#ifndef USBD_AUDIO_SRC_MAX_FACTOR
+#define USBD_AUDIO_SRC_MAX_FACTOR        4U
+#endif /* USBD_AUDIO_SRC_MAX_FACTOR */
+
+/* Filter taps per polyphase branch, the filter has this many times the
+   larger of the two factors */
+#ifndef USBD_AUDIO_SRC_TAPS_PER_PHASE
+#define USBD_AUDIO_SRC_TAPS_PER_PHASE    16U
+#endif /* USBD_AUDIO_SRC_TAPS_PER_PHASE */
+
+/* Input frames per kernel call, a multiple of every factor up to
+   USBD_AUDIO_SRC_MAX_FACTOR */
+#ifndef USBD_AUDIO_SRC_BLOCK
+#define USBD_AUDIO_SRC_BLOCK             48U
+#endif /* USBD_AUDIO_SRC_BLOCK */
+
+/* Codec clock of each crystal family */
+#ifndef USBD_AUDIO_SRC_CODEC_FREQ_48K
+#define USBD_AUDIO_SRC_CODEC_FREQ_48K    48000U
+#endif /* USBD_AUDIO_SRC_CODEC_FREQ_48K */
+
+#ifndef USBD_AUDIO_SRC_CODEC_FREQ_44K1
+#define USBD_AUDIO_SRC_CODEC_FREQ_44K1   44100U
+#endif /* USBD_AUDIO_SRC_CODEC_FREQ_44K1 */
+
+/* Placement of the converter state, next to the audio streaming buffers */
+#ifndef USBD_AUDIO_SRC_SECTION
+#define USBD_AUDIO_SRC_SECTION           __attribute__((section(".usb_audio")))
+#endif /* USBD_AUDIO_SRC_SECTION */
+
+#define USBD_AUDIO_SRC_MAX_TAPS          (USBD_AUDIO_SRC_TAPS_PER_PHASE * USBD_AUDIO_SRC_MAX_FACTOR)
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_AUDIO_SRC_Exported_Types USBD_AUDIO_SRC_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+typedef struct
+{
+  uint32_t in_freq;
+  uint32_t out_freq;
+  uint8_t up;                   /* Interpolation factor L */
+  uint8_t down;                 /* Decimation factor M */
+  uint8_t channels;
+  uint16_t taps;
+  uint32_t fill;                /* Input frames waiting for a whole block */
+  uint32_t cycles;              /* CPU cycles spent on the last block */
+  uint32_t cycles_max;          /* Worst block since the last init */
+  uint32_t cycles_budget;       /* CPU cycles in the real time of one block */
+  uint32_t blocks;
+  arm_fir_interpolate_instance_f32 interp[USBD_AUDIO_SRC_MAX_CHANNELS];
+  arm_fir_decimate_instance_f32 decim[USBD_AUDIO_SRC_MAX_CHANNELS];
+  float32_t coeffs_up[USBD_AUDIO_SRC_MAX_TAPS];
+  float32_t coeffs_down[USBD_AUDIO_SRC_MAX_TAPS];
+  float32_t state_up[USBD_AUDIO_SRC_MAX_CHANNELS][USBD_AUDIO_SRC_MAX_TAPS + USBD_AUDIO_SRC_BLOCK];
+  float32_t state_down[USBD_AUDIO_SRC_MAX_CHANNELS][USBD_AUDIO_SRC_MAX_TAPS + (USBD_AUDIO_SRC_BLOCK * USBD_AUDIO_SRC_MAX_FACTOR)];
+  float32_t in[USBD_AUDIO_SRC_MAX_CHANNELS][USBD_AUDIO_SRC_BLOCK];
+  float32_t mid[USBD_AUDIO_SRC_BLOCK * USBD_AUDIO_SRC_MAX_FACTOR];
+  float32_t out[USBD_AUDIO_SRC_BLOCK * USBD_AUDIO_SRC_MAX_FACTOR];
+} USBD_AudioSrc_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_AUDIO_SRC_Exported_FunctionsPrototype USBD_AUDIO_SRC_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+uint32_t USBD_AudioSrc_CodecFreq(uint32_t freq);
+uint8_t USBD_AudioSrc_Init(USBD_AudioSrc_HandleTypeDef *hsrc, uint32_t in_freq,
+                           uint32_t out_freq, uint8_t channels);
+void USBD_AudioSrc_Reset(USBD_AudioSrc_HandleTypeDef *hsrc);
+uint32_t USBD_AudioSrc_Process(USBD_AudioSrc_HandleTypeDef *hsrc, const int32_t *in,
+                               uint32_t frames, int32_t *out);
+uint32_t USBD_AudioSrc_GetLoad(const USBD_AudioSrc_HandleTypeDef *hsrc);
+
+void USBD_AudioSrc_Unpack(const uint8_t *src, uint8_t subframe, int32_t *dst, uint32_t samples);
+void USBD_AudioSrc_Pack(const int32_t *src, uint8_t subframe, uint8_t *dst, uint32_t samples);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_AUDIO_SRC_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
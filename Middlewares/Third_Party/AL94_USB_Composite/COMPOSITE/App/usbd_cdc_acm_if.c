@@ -25,6 +25,12 @@
 /* USER CODE BEGIN INCLUDE */
 //#include "usart.h"
 //#include "tim.h"
+#include "usbd_audio_loop.h"
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+#include "usbd_audio_mic_if.h"
+#include <stdio.h>
+#include <string.h>
+#endif /* USBD_AUDIO_LOOP_ENABLED */
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -137,6 +143,9 @@ static int8_t CDC_Receive(uint8_t cdc_ch, uint8_t *pbuf, uint32_t *Len);
 static int8_t CDC_TransmitCplt(uint8_t cdc_ch, uint8_t *Buf, uint32_t *Len, uint8_t epnum);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+static uint8_t CDC_AudioLoopCmd(uint8_t cdc_ch, const uint8_t *Buf, uint32_t Len);
+#endif /* USBD_AUDIO_LOOP_ENABLED */
 //UART_HandleTypeDef *CDC_CH_To_UART_Handle(uint8_t cdc_ch)
 //{
 //  UART_HandleTypeDef *handle = NULL;
@@ -421,6 +430,16 @@ static int8_t CDC_Control(uint8_t cdc_ch, uint8_t cmd, uint8_t *pbuf, uint16_t l
 static int8_t CDC_Receive(uint8_t cdc_ch, uint8_t *Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+  /* Loopback commands are answered instead of echoed */
+  if (CDC_AudioLoopCmd(cdc_ch, Buf, *Len) != 0U)
+  {
+    USBD_CDC_SetRxBuffer(cdc_ch, &hUsbDevice, &Buf[0]);
+    USBD_CDC_ReceivePacket(cdc_ch, &hUsbDevice);
+    return (USBD_OK);
+  }
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+
   //HAL_UART_Transmit_DMA(CDC_CH_To_UART_Handle(cdc_ch), Buf, *Len);
   CDC_Transmit(cdc_ch, Buf, *Len); // echo back on same channel
 
@@ -478,6 +497,67 @@ uint8_t CDC_Transmit(uint8_t ch, uint8_t *Buf, uint16_t Len)
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+#if (USBD_AUDIO_LOOP_ENABLED == 1U)
+/**
+  * @brief  CDC_AudioLoopCmd
+  *         Control of the audio loopback for the host tool that plays the
+  *         markers, one command per packet:
+  *           "loop on" / "loop off": feed the microphone from the speaker
+  *           "loop stats": one line with the figures of the current rates,
+  *           times in us
+  * @param  cdc_ch: CDC channel the packet came in on, also the one answered
+  * @param  Buf: packet received
+  * @param  Len: packet length
+  * @retval 1 if the packet was a loopback command, 0 otherwise
+  */
+static uint8_t CDC_AudioLoopCmd(uint8_t cdc_ch, const uint8_t *Buf, uint32_t Len)
+{
+  USBD_AudioLoop_StatsTypeDef stats;
+  const char *reply;
+  int len;
+
+  if ((Len >= 10U) && (memcmp(Buf, "loop stats", 10U) == 0))
+  {
+    USBD_AudioLoop_GetStats(&AUDIO_Loop, &stats);
+    len = snprintf((char *)TX_Buffer[cdc_ch], APP_TX_DATA_SIZE,
+                   "%lu %lu n %lu lost %lu last %lu min %lu max %lu mean %lu jit %lu skip %lu\r\n",
+                   (unsigned long)stats.in_freq, (unsigned long)stats.out_freq,
+                   (unsigned long)stats.markers, (unsigned long)stats.lost,
+                   (unsigned long)stats.last_us, (unsigned long)stats.min_us,
+                   (unsigned long)stats.max_us, (unsigned long)stats.mean_us,
+                   (unsigned long)stats.jitter_us, (unsigned long)stats.skipped);
+    if (len >= APP_TX_DATA_SIZE)
+    {
+      len = APP_TX_DATA_SIZE - 1;
+    }
+  }
+  else
+  {
+    if ((Len >= 7U) && (memcmp(Buf, "loop on", 7U) == 0))
+    {
+      USBD_AudioLoop_Enable(&AUDIO_Loop, 1U);
+      reply = "on\r\n";
+    }
+    else if ((Len >= 8U) && (memcmp(Buf, "loop off", 8U) == 0))
+    {
+      USBD_AudioLoop_Enable(&AUDIO_Loop, 0U);
+      reply = "off\r\n";
+    }
+    else
+    {
+      return 0U;
+    }
+    len = (int)strlen(reply);
+    (void)memcpy(TX_Buffer[cdc_ch], reply, (size_t)len);
+  }
+
+  /* Dropped if the previous packet is still on its way, the tool asks again */
+  (void)CDC_Transmit(cdc_ch, TX_Buffer[cdc_ch], (uint16_t)len);
+
+  return 1U;
+}
+#endif /* USBD_AUDIO_LOOP_ENABLED */
+
 //void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 //{
 //  /* Initiate next USB packet transfer once UART completes transfer (transmitting data over Tx line) */
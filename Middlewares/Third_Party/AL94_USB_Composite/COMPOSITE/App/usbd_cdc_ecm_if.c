@@ -20,9 +20,15 @@
 /* Includes ------------------------------------------------------------------*/
 
 #include "usbd_cdc_ecm_if.h"
+#include "usbd_netif.h"
+#include "usbd_iperf.h"
 
 extern USBD_HandleTypeDef hUsbDevice;
 
+#if (USBD_NETIF_USE_LWIP == 1U) && (USBD_UDP_USE_FASTPATH == 1U)
+#error "The ECM interface runs either lwIP or the UDP responder"
+#endif
+
 /*
   Include here  LwIP files if used
 */
@@ -32,15 +38,51 @@ extern USBD_HandleTypeDef hUsbDevice;
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 
-#if defined ( __ICCARM__ ) /*!< IAR Compiler */
-#pragma data_alignment=4
-#endif
-__ALIGN_BEGIN static uint8_t UserRxBuffer[CDC_ECM_ETH_MAX_SEGSZE + 100]__ALIGN_END; /* Received Data over USB are stored in this buffer */
+#if (USBD_NETIF_USE_LWIP == 1U)
+static USBD_Netif_HandleTypeDef CDC_ECM_Netif;
 
-#if defined ( __ICCARM__ ) /*!< IAR Compiler */
-#pragma data_alignment=4
-#endif
-__ALIGN_BEGIN  static uint8_t UserTxBuffer[CDC_ECM_ETH_MAX_SEGSZE + 100]__ALIGN_END; /* Received Data over CDC_ECM (CDC_ECM interface) are stored in this buffer */
+/* Received frames stay in the class ring while lwIP holds them */
+static const USBD_Netif_ConfTypeDef CDC_ECM_NetifConf =
+{
+  NULL,
+  NULL,
+  USBD_CDC_ECM_SetTxBuffer,
+  USBD_CDC_ECM_TransmitPacket,
+  USBD_CDC_ECM_ReleaseRxFrame,
+  0U,
+  CDC_ECM_TX_FRAMES,
+  NULL,
+  0U,
+  CDC_ECM_NETIF_HWADDR,
+  {'e', 'c'},
+  CDC_ECM_NETIF_IPADDR,
+  CDC_ECM_NETIF_NETMASK,
+  CDC_ECM_NETIF_GW,
+};
+#endif /* USBD_NETIF_USE_LWIP */
+
+#if (USBD_UDP_USE_FASTPATH == 1U)
+USBD_UDP_HandleTypeDef CDC_ECM_Udp;
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+USBD_Iperf_HandleTypeDef CDC_ECM_Iperf;
+#endif /* USBD_IPERF_USE_SERVER */
+
+static uint8_t CDC_ECM_UdpOutput(uint8_t *frame, uint32_t len);
+static void CDC_ECM_UdpReceive(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+                               uint8_t *data, uint16_t len);
+
+/* TransmitFrame sends the frame in place, it is free again on TransmitCplt */
+static const USBD_UDP_ConfTypeDef CDC_ECM_UdpConf =
+{
+  CDC_ECM_UdpOutput,
+  CDC_ECM_UdpReceive,
+  0U,
+  CDC_ECM_NETIF_HWADDR,
+  CDC_ECM_NETIF_IPADDR,
+  CDC_ECM_NETIF_NETMASK,
+};
+#endif /* USBD_UDP_USE_FASTPATH */
 
 static uint8_t CDC_ECMInitialized = 0U;
 
@@ -82,9 +124,18 @@ static int8_t CDC_ECM_Itf_Init(void)
     CDC_ECMInitialized = 1U;
   }
 
-  /* Set Application Buffers */
-  (void)USBD_CDC_ECM_SetTxBuffer(&hUsbDevice, UserTxBuffer, 0U);
-  (void)USBD_CDC_ECM_SetRxBuffer(&hUsbDevice, UserRxBuffer);
+#if (USBD_NETIF_USE_LWIP == 1U)
+  /* lwIP is registered from the main loop */
+  USBD_Netif_Start(&CDC_ECM_Netif, &hUsbDevice, &CDC_ECM_NetifConf);
+#elif (USBD_UDP_USE_FASTPATH == 1U)
+  USBD_UDP_Init(&CDC_ECM_Udp, &CDC_ECM_UdpConf);
+#if (USBD_IPERF_USE_SERVER == 1U)
+  USBD_Iperf_Init(&CDC_ECM_Iperf, &CDC_ECM_Udp);
+#endif /* USBD_IPERF_USE_SERVER */
+#endif /* USBD_NETIF_USE_LWIP */
+
+  /* The class receives into its own frame ring, frames to send are queued
+     with USBD_CDC_ECM_TransmitFrame() */
 
   return (0);
 }
@@ -177,22 +228,35 @@ static int8_t CDC_ECM_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
 
 /**
   * @brief  CDC_ECM_Itf_Receive
-  *         Data received over USB OUT endpoint are sent over CDC_ECM interface
-  *         through this function.
-  * @param  Buf: Buffer of data to be transmitted
-  * @param  Len: Number of data received (in bytes)
-  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  *         One frame received over the USB OUT endpoint, called from
+  *         USBD_CDC_ECM_Process() in the main loop.
+  *
+  *         @note
+  *         The frame is given back to the class on return unless USBD_BUSY
+  *         is returned, it is then kept until USBD_CDC_ECM_ReleaseRxFrame().
+  *
+  * @param  Buf: Ethernet frame
+  * @param  Len: Frame length (in bytes)
+  * @retval USBD_OK when done with the frame, USBD_BUSY to keep it
   */
 static int8_t CDC_ECM_Itf_Receive(uint8_t *Buf, uint32_t *Len)
 {
-  /* Get the CDC_ECM handler pointer */
-  USBD_CDC_ECM_HandleTypeDef *hcdc_cdc_ecm = (USBD_CDC_ECM_HandleTypeDef *)(hUsbDevice.pClassData_CDC_ECM);
-
-  /* Call Eth buffer processing */
-  hcdc_cdc_ecm->RxState = 1U;
-
+#if (USBD_NETIF_USE_LWIP == 1U)
+  /* Lent to lwIP as it is, freeing the pbuf releases the frame */
+  if (USBD_Netif_Input(&CDC_ECM_Netif, Buf, *Len) == (uint8_t)USBD_OK)
+  {
+    return (int8_t)USBD_BUSY;
+  }
+#elif (USBD_UDP_USE_FASTPATH == 1U)
+  /* Answered right here, the frame is not needed afterwards */
+  (void)USBD_UDP_Input(&CDC_ECM_Udp, Buf, *Len);
+#else
+  /*
+    Hand the frame to the TCP/IP stack here
+  */
   UNUSED(Len);
   UNUSED(Buf);
+#endif /* USBD_NETIF_USE_LWIP */
 
   return (0);
 }
@@ -202,8 +266,9 @@ static int8_t CDC_ECM_Itf_Receive(uint8_t *Buf, uint32_t *Len)
   *         Data transmitted callback
   *
   *         @note
-  *         This function is IN transfer complete callback used to inform user that
-  *         the submitted Data is successfully sent over USB.
+  *         Called from the USB interrupt once a frame queued with
+  *         USBD_CDC_ECM_TransmitFrame() went out, Buf belongs to the
+  *         application again. The next queued frame is already on its way.
   *
   * @param  Buf: Buffer of data to be received
   * @param  Len: Number of data received (in bytes)
@@ -211,6 +276,14 @@ static int8_t CDC_ECM_Itf_Receive(uint8_t *Buf, uint32_t *Len)
   */
 static int8_t CDC_ECM_Itf_TransmitCplt(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
 {
+#if (USBD_NETIF_USE_LWIP == 1U)
+  /* Start the next frame of the lwIP TX ring */
+  USBD_Netif_TransmitCplt(&CDC_ECM_Netif, Buf);
+#elif (USBD_UDP_USE_FASTPATH == 1U)
+  /* The frame goes back to the responder pool */
+  USBD_UDP_TransmitCplt(&CDC_ECM_Udp, Buf);
+#endif /* USBD_NETIF_USE_LWIP */
+
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
@@ -220,8 +293,7 @@ static int8_t CDC_ECM_Itf_TransmitCplt(uint8_t *Buf, uint32_t *Len, uint8_t epnu
 
 /**
   * @brief  CDC_ECM_Itf_Process
-  *         Data received over USB OUT endpoint are sent over CDC_ECM interface
-  *         through this function.
+  *         Background work of the network stack, called from USBD_CDC_ECM_Process()
   * @param  pdef: pointer to the USB Device Handle
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
@@ -230,16 +302,86 @@ static int8_t CDC_ECM_Itf_Process(USBD_HandleTypeDef *pdev)
   /* Get the CDC_ECM handler pointer */
   USBD_CDC_ECM_HandleTypeDef *hcdc_cdc_ecm = (USBD_CDC_ECM_HandleTypeDef *)(pdev->pClassData_CDC_ECM);
 
+#if (USBD_NETIF_USE_LWIP == 1U)
+  if (hcdc_cdc_ecm != NULL)
+  {
+    USBD_Netif_Process(&CDC_ECM_Netif, hcdc_cdc_ecm->LinkStatus);
+  }
+#elif (USBD_UDP_USE_FASTPATH == 1U) && (USBD_IPERF_USE_SERVER == 1U)
+  /* iperf reverse tests */
+  if ((hcdc_cdc_ecm != NULL) && (hcdc_cdc_ecm->LinkStatus != 0U))
+  {
+    USBD_Iperf_Process(&CDC_ECM_Iperf);
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+
   if ((hcdc_cdc_ecm != NULL) && (hcdc_cdc_ecm->LinkStatus != 0U))
   {
     /*
-      Read a received packet from the Ethernet buffers and send it
-      to the lwIP for handling
-      Call here the TCP/IP background tasks.
+      Call here the TCP/IP background tasks, outgoing frames go through
+      USBD_CDC_ECM_TransmitFrame()
     */
   }
 
   return (0);
 }
 
+#if (USBD_UDP_USE_FASTPATH == 1U)
+/**
+  * @brief  CDC_ECM_UdpOutput
+  *         Frame from the UDP responder
+  * @param  frame: Ethernet frame, kept until TransmitCplt
+  * @param  len: frame length
+  * @retval USBD_OK once queued, USBD_BUSY when the TX ring is full
+  */
+static uint8_t CDC_ECM_UdpOutput(uint8_t *frame, uint32_t len)
+{
+  return USBD_CDC_ECM_TransmitFrame(&hUsbDevice, frame, len);
+}
+
+/**
+  * @brief  CDC_ECM_UdpReceive
+  *         UDP datagram addressed to the device, called from the main loop
+  * @param  src_ip: sender address
+  * @param  src_port: sender port
+  * @param  dst_port: local port
+  * @param  data: payload, only valid during the call
+  * @param  len: payload length
+  * @retval None
+  */
+static void CDC_ECM_UdpReceive(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+                               uint8_t *data, uint16_t len)
+{
+#if (USBD_IPERF_USE_SERVER == 1U)
+  if (USBD_Iperf_UdpInput(&CDC_ECM_Iperf, src_ip, src_port, dst_port, data, len) == (uint8_t)USBD_OK)
+  {
+    return;
+  }
+#endif /* USBD_IPERF_USE_SERVER */
+
+  /*
+     Add your code here
+  */
+  UNUSED(src_ip);
+  UNUSED(src_port);
+  UNUSED(dst_port);
+  UNUSED(data);
+  UNUSED(len);
+}
+#endif /* USBD_UDP_USE_FASTPATH */
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  CDC_ECM_Process
+  *         Hand received frames to the interface and run the network stack,
+  *         to be polled from the main loop
+  * @param  None
+  * @retval None
+  */
+void CDC_ECM_Process(void)
+{
+  (void)USBD_CDC_ECM_Process(&hUsbDevice);
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
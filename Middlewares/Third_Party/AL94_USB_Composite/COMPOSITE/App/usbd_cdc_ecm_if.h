@@ -23,6 +23,8 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_cdc_ecm.h"
+#include "usbd_udp.h"
+#include "usbd_iperf.h"
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
@@ -73,10 +75,28 @@
 #define CDC_ECM_CONNECT_SPEED_UPSTREAM                          0x004C4B40U /* 5Mbps */
 #define CDC_ECM_CONNECT_SPEED_DOWNSTREAM                        0x004C4B40U /* 5Mbps */
 
+/* Device end of the link for lwIP or the UDP responder, the MAC above is the host's */
+#define CDC_ECM_NETIF_HWADDR                 {0x02U, 0x02U, 0x02U, 0x03U, 0x00U, 0x02U}
+#define CDC_ECM_NETIF_IPADDR                 0xC0A80801U /* 192.168.8.1 */
+#define CDC_ECM_NETIF_NETMASK                0xFFFFFF00U /* 255.255.255.0 */
+#define CDC_ECM_NETIF_GW                     0x00000000U
+
 extern USBD_CDC_ECM_ItfTypeDef                          USBD_CDC_ECM_fops;
 
+#if (USBD_UDP_USE_FASTPATH == 1U)
+/* Responder of the interface, for USBD_UDP_OpenFlow() and USBD_UDP_Send() */
+extern USBD_UDP_HandleTypeDef                           CDC_ECM_Udp;
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+/* iperf 2 server on the responder, for its counters */
+extern USBD_Iperf_HandleTypeDef                         CDC_ECM_Iperf;
+#endif /* USBD_IPERF_USE_SERVER */
+#endif /* USBD_UDP_USE_FASTPATH */
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
+void CDC_ECM_Process(void);
+
 #endif /* __USBD_CDC_ECM_IF_H */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
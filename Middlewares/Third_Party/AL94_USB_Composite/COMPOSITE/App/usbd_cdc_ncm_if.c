@@ -0,0 +1,202 @@
+/**
+  ******************************************************************************
+  * @file    Src/usbd_cdc_ncm_if.c
+  * @author  MCD Application Team
+  * @brief   Source file for USBD CDC_NCM interface
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "usbd_cdc_ncm_if.h"
+
+extern USBD_HandleTypeDef hUsbDevice;
+
+/*
+  Include here  LwIP files if used
+*/
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+static uint8_t CDC_NCMInitialized = 0U;
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t CDC_NCM_Itf_Init(void);
+static int8_t CDC_NCM_Itf_DeInit(void);
+static int8_t CDC_NCM_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length);
+static int8_t CDC_NCM_Itf_Receive(uint8_t *pbuf, uint32_t *Len);
+static int8_t CDC_NCM_Itf_TransmitCplt(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
+static int8_t CDC_NCM_Itf_Process(USBD_HandleTypeDef *pdev);
+
+USBD_CDC_NCM_ItfTypeDef USBD_CDC_NCM_fops =
+{
+  CDC_NCM_Itf_Init,
+  CDC_NCM_Itf_DeInit,
+  CDC_NCM_Itf_Control,
+  CDC_NCM_Itf_Receive,
+  CDC_NCM_Itf_TransmitCplt,
+  CDC_NCM_Itf_Process,
+  (uint8_t *)CDC_NCM_MAC_STR_DESC,
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  CDC_NCM_Itf_Init
+  *         Initializes the CDC_NCM media low layer
+  * @param  None
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Init(void)
+{
+  if (CDC_NCMInitialized == 0U)
+  {
+    /*
+      Initialize the TCP/IP stack here
+    */
+
+    CDC_NCMInitialized = 1U;
+  }
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_DeInit
+  *         DeInitializes the CDC_NCM media low layer
+  * @param  None
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_DeInit(void)
+{
+  /*
+    Set the link down at TCP/IP level
+  */
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_Control
+  *         Manage the CDC_NCM class requests the class does not answer itself
+  * @param  Cmd: Command code
+  * @param  Buf: Buffer containing command data (request parameters)
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  switch (cmd)
+  {
+    case CDC_NCM_SET_ETH_MULTICAST_FILTERS:
+      /* Add your code here */
+      break;
+
+    case CDC_NCM_SET_ETH_PACKET_FILTER:
+      /* Add your code here */
+      break;
+
+    default:
+      break;
+  }
+  UNUSED(length);
+  UNUSED(pbuf);
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_Receive
+  *         One datagram unpacked from an OUT NTB, called from the main loop.
+  *
+  *         @note
+  *         Buf points into the NTB buffer and is only valid during the call,
+  *         copy the frame out before returning.
+  *
+  * @param  Buf: Ethernet frame
+  * @param  Len: Frame length (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Receive(uint8_t *Buf, uint32_t *Len)
+{
+  /*
+    Hand the frame to the TCP/IP stack here
+  */
+  UNUSED(Len);
+  UNUSED(Buf);
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_TransmitCplt
+  *         Data transmitted callback
+  *
+  *         @note
+  *         Called from the USB interrupt once an IN NTB went out, datagrams
+  *         refused with USBD_BUSY can be queued again from here on.
+  *
+  * @param  Buf: NTB sent
+  * @param  Len: NTB length (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_TransmitCplt(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+{
+  UNUSED(Buf);
+  UNUSED(Len);
+  UNUSED(epnum);
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_Process
+  *         Background work of the network stack, called from USBD_CDC_NCM_Process()
+  * @param  pdef: pointer to the USB Device Handle
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Process(USBD_HandleTypeDef *pdev)
+{
+  /* Get the CDC_NCM handler pointer */
+  USBD_CDC_NCM_HandleTypeDef *hcdc_cdc_ncm = (USBD_CDC_NCM_HandleTypeDef *)(pdev->pClassData_CDC_NCM);
+
+  if ((hcdc_cdc_ncm != NULL) && (hcdc_cdc_ncm->LinkStatus != 0U))
+  {
+    /*
+      Call here the TCP/IP background tasks, outgoing frames go through
+      USBD_CDC_NCM_TransmitDatagram()
+    */
+  }
+
+  return (0);
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  CDC_NCM_Process
+  *         Unpack received NTBs and flush pending IN datagrams, to be polled
+  *         from the main loop
+  * @param  None
+  * @retval None
+  */
+void CDC_NCM_Process(void)
+{
+  (void)USBD_CDC_NCM_Process(&hUsbDevice);
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,47 @@
+/**
+  ******************************************************************************
+  * @file    Inc/usbd_cdc_ncm_if.h
+  * @author  MCD Application Team
+  * @brief   Header for usbd_cdc_ncm_if.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_NCM_IF_H
+#define __USBD_CDC_NCM_IF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_ncm.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+
+/* MAC address the host gives its end of the link, 12 hex digits */
+#define CDC_NCM_MAC_STR_DESC                 (uint8_t *)"000202030001"
+
+/* Ethernet Maximum Segment size, typically 1514 bytes */
+#define CDC_NCM_ETH_MAX_SEGSZE                                  1514U
+
+#define CDC_NCM_CONNECT_SPEED_UPSTREAM                          0x004C4B40U /* 5Mbps */
+#define CDC_NCM_CONNECT_SPEED_DOWNSTREAM                        0x004C4B40U /* 5Mbps */
+
+extern USBD_CDC_NCM_ItfTypeDef                          USBD_CDC_NCM_fops;
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+void CDC_NCM_Process(void);
+
+#endif /* __USBD_CDC_NCM_IF_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -32,22 +32,78 @@
 */
 
 #include "usbd_cdc_rndis_if.h"
+#include "usbd_netif.h"
+#include "usbd_iperf.h"
 
 extern USBD_HandleTypeDef hUsbDevice;
 
+#if (USBD_NETIF_USE_LWIP == 1U) && (USBD_UDP_USE_FASTPATH == 1U)
+#error "The RNDIS interface runs either lwIP or the UDP responder"
+#endif
+
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+#if (USBD_NETIF_USE_LWIP == 1U)
+#if defined ( __ICCARM__ ) /*!< IAR Compiler */
+#pragma data_alignment=4
+#endif
+__ALIGN_BEGIN static uint8_t UserRxPool[USBD_NETIF_RX_BUFFERS][CDC_RNDIS_MAX_TRANSFER_SIZE] __ALIGN_END; /* OUT transfers lent to lwIP */
+
+static USBD_Netif_HandleTypeDef CDC_RNDIS_Netif;
+
+static const USBD_Netif_ConfTypeDef CDC_RNDIS_NetifConf =
+{
+  USBD_CDC_RNDIS_SetRxBuffer,
+  USBD_CDC_RNDIS_ReceivePacket,
+  USBD_CDC_RNDIS_SetTxBuffer,
+  USBD_CDC_RNDIS_TransmitPacket,
+  NULL,
+  sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef),
+  1U,
+  &UserRxPool[0][0],
+  CDC_RNDIS_MAX_TRANSFER_SIZE,
+  CDC_RNDIS_NETIF_HWADDR,
+  {'r', 'n'},
+  CDC_RNDIS_NETIF_IPADDR,
+  CDC_RNDIS_NETIF_NETMASK,
+  CDC_RNDIS_NETIF_GW,
+};
+#else
 #if defined ( __ICCARM__ ) /*!< IAR Compiler */
 #pragma data_alignment=4
 #endif
-__ALIGN_BEGIN uint8_t UserRxBuffer[CDC_RNDIS_ETH_MAX_SEGSZE + 100] __ALIGN_END; /* Received Data over USB are stored in this buffer */
+__ALIGN_BEGIN uint8_t UserRxBuffer[CDC_RNDIS_MAX_TRANSFER_SIZE] __ALIGN_END; /* Received Data over USB are stored in this buffer */
 
 #if defined ( __ICCARM__ ) /*!< IAR Compiler */
 #pragma data_alignment=4
 #endif
 __ALIGN_BEGIN static uint8_t UserTxBuffer[CDC_RNDIS_ETH_MAX_SEGSZE + 100] __ALIGN_END; /* Received Data over CDC_RNDIS (CDC_RNDIS interface) are stored in this buffer */
+#endif /* USBD_NETIF_USE_LWIP */
+
+#if (USBD_UDP_USE_FASTPATH == 1U)
+USBD_UDP_HandleTypeDef CDC_RNDIS_Udp;
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+USBD_Iperf_HandleTypeDef CDC_RNDIS_Iperf;
+#endif /* USBD_IPERF_USE_SERVER */
+
+static uint8_t CDC_RNDIS_UdpOutput(uint8_t *frame, uint32_t len);
+static void CDC_RNDIS_UdpReceive(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+                                 uint8_t *data, uint16_t len);
+
+/* TransmitFrame copies into the aggregated transfer, the frame is free on return */
+static const USBD_UDP_ConfTypeDef CDC_RNDIS_UdpConf =
+{
+  CDC_RNDIS_UdpOutput,
+  CDC_RNDIS_UdpReceive,
+  1U,
+  CDC_RNDIS_NETIF_HWADDR,
+  CDC_RNDIS_NETIF_IPADDR,
+  CDC_RNDIS_NETIF_NETMASK,
+};
+#endif /* USBD_UDP_USE_FASTPATH */
 
 static uint8_t CDC_RNDISInitialized = 0U;
 
@@ -91,9 +147,21 @@ static int8_t CDC_RNDIS_Itf_Init(void)
     CDC_RNDISInitialized = 1U;
   }
 
+#if (USBD_NETIF_USE_LWIP == 1U)
+  /* lwIP is registered from the main loop, only pick the first OUT buffer here */
+  USBD_Netif_Start(&CDC_RNDIS_Netif, &hUsbDevice, &CDC_RNDIS_NetifConf);
+#else
   /* Set Application Buffers */
   (void)USBD_CDC_RNDIS_SetTxBuffer(&hUsbDevice, UserTxBuffer, 0U);
-  (void)USBD_CDC_RNDIS_SetRxBuffer(&hUsbDevice, UserRxBuffer);
+  (void)USBD_CDC_RNDIS_SetRxBuffer(&hUsbDevice, UserRxBuffer, sizeof(UserRxBuffer));
+#endif /* USBD_NETIF_USE_LWIP */
+
+#if (USBD_UDP_USE_FASTPATH == 1U)
+  USBD_UDP_Init(&CDC_RNDIS_Udp, &CDC_RNDIS_UdpConf);
+#if (USBD_IPERF_USE_SERVER == 1U)
+  USBD_Iperf_Init(&CDC_RNDIS_Iperf, &CDC_RNDIS_Udp);
+#endif /* USBD_IPERF_USE_SERVER */
+#endif /* USBD_UDP_USE_FASTPATH */
 
   return (0);
 }
@@ -164,12 +232,30 @@ static int8_t CDC_RNDIS_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
   * @brief  CDC_RNDIS_Itf_Receive
   *         Data received over USB OUT endpoint are sent over CDC_RNDIS interface
   *         through this function.
+  *
+  *         @note
+  *         Called once per PACKET_MSG of the OUT transfer. The frames stay in
+  *         UserRxBuffer until USBD_CDC_RNDIS_ReceivePacket() arms the endpoint again.
+  *
   * @param  Buf: Buffer of data to be transmitted
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
 static int8_t CDC_RNDIS_Itf_Receive(uint8_t *Buf, uint32_t *Len)
 {
+#if (USBD_NETIF_USE_LWIP == 1U)
+  /* Lent to lwIP as it is, the endpoint is armed again on a free buffer */
+  if (USBD_Netif_Input(&CDC_RNDIS_Netif, Buf, *Len) != (uint8_t)USBD_OK)
+  {
+    /* Counted as OID_GEN_RCV_NO_BUFFER */
+    return (int8_t)USBD_FAIL;
+  }
+#else
+#if (USBD_UDP_USE_FASTPATH == 1U)
+  /* Answered right here, the endpoint is armed again from the main loop */
+  (void)USBD_UDP_Input(&CDC_RNDIS_Udp, Buf, *Len);
+#endif /* USBD_UDP_USE_FASTPATH */
+
   /* Get the CDC_RNDIS handler pointer */
   USBD_CDC_RNDIS_HandleTypeDef *hcdc_cdc_rndis = (USBD_CDC_RNDIS_HandleTypeDef *)(hUsbDevice.pClassData_CDC_RNDIS);
 
@@ -178,6 +264,7 @@ static int8_t CDC_RNDIS_Itf_Receive(uint8_t *Buf, uint32_t *Len)
 
   UNUSED(Buf);
   UNUSED(Len);
+#endif /* USBD_NETIF_USE_LWIP */
 
   return (0);
 }
@@ -197,6 +284,11 @@ static int8_t CDC_RNDIS_Itf_Receive(uint8_t *Buf, uint32_t *Len)
   */
 static int8_t CDC_RNDIS_Itf_TransmitCplt(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
 {
+#if (USBD_NETIF_USE_LWIP == 1U)
+  /* Start the next frame of the lwIP TX ring */
+  USBD_Netif_TransmitCplt(&CDC_RNDIS_Netif, Buf);
+#endif /* USBD_NETIF_USE_LWIP */
+
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
@@ -216,16 +308,97 @@ static int8_t CDC_RNDIS_Itf_Process(USBD_HandleTypeDef *pdev)
   /* Get the CDC_RNDIS handler pointer */
   USBD_CDC_RNDIS_HandleTypeDef   *hcdc_cdc_rndis = (USBD_CDC_RNDIS_HandleTypeDef *)(pdev->pClassData_CDC_RNDIS);
 
+#if (USBD_NETIF_USE_LWIP == 1U)
+  if (hcdc_cdc_rndis != NULL)
+  {
+    USBD_Netif_Process(&CDC_RNDIS_Netif, hcdc_cdc_rndis->LinkStatus);
+  }
+#elif (USBD_UDP_USE_FASTPATH == 1U)
+  /* Every frame of the last OUT transfer has been answered */
+  if ((hcdc_cdc_rndis != NULL) && (hcdc_cdc_rndis->RxState != 0U))
+  {
+    hcdc_cdc_rndis->RxState = 0U;
+    (void)USBD_CDC_RNDIS_ReceivePacket(pdev);
+  }
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+  /* iperf reverse tests */
+  if ((hcdc_cdc_rndis != NULL) && (hcdc_cdc_rndis->LinkStatus != 0U))
+  {
+    USBD_Iperf_Process(&CDC_RNDIS_Iperf);
+  }
+#endif /* USBD_IPERF_USE_SERVER */
+#endif /* USBD_NETIF_USE_LWIP */
+
   if ((hcdc_cdc_rndis != NULL) && (hcdc_cdc_rndis->LinkStatus != 0U))
   {
     /*
        Add your code here
        Read a received packet from the Ethernet buffers and send it
-       to the lwIP for handling
+       to the lwIP for handling, outgoing frames go through
+       USBD_CDC_RNDIS_TransmitFrame()
     */
   }
 
   return (0);
 }
 
+#if (USBD_UDP_USE_FASTPATH == 1U)
+/**
+  * @brief  CDC_RNDIS_UdpOutput
+  *         Frame from the UDP responder
+  * @param  frame: Ethernet frame
+  * @param  len: frame length
+  * @retval USBD_OK once queued, USBD_BUSY when both transfer buffers are in use
+  */
+static uint8_t CDC_RNDIS_UdpOutput(uint8_t *frame, uint32_t len)
+{
+  return USBD_CDC_RNDIS_TransmitFrame(&hUsbDevice, frame, (uint16_t)len);
+}
+
+/**
+  * @brief  CDC_RNDIS_UdpReceive
+  *         UDP datagram addressed to the device, called from the USB interrupt
+  * @param  src_ip: sender address
+  * @param  src_port: sender port
+  * @param  dst_port: local port
+  * @param  data: payload, only valid during the call
+  * @param  len: payload length
+  * @retval None
+  */
+static void CDC_RNDIS_UdpReceive(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+                                 uint8_t *data, uint16_t len)
+{
+#if (USBD_IPERF_USE_SERVER == 1U)
+  if (USBD_Iperf_UdpInput(&CDC_RNDIS_Iperf, src_ip, src_port, dst_port, data, len) == (uint8_t)USBD_OK)
+  {
+    return;
+  }
+#endif /* USBD_IPERF_USE_SERVER */
+
+  /*
+     Add your code here
+  */
+  UNUSED(src_ip);
+  UNUSED(src_port);
+  UNUSED(dst_port);
+  UNUSED(data);
+  UNUSED(len);
+}
+#endif /* USBD_UDP_USE_FASTPATH */
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  CDC_RNDIS_Process
+  *         Flush pending IN frames and run the network stack, to be polled
+  *         from the main loop
+  * @param  None
+  * @retval None
+  */
+void CDC_RNDIS_Process(void)
+{
+  (void)USBD_CDC_RNDIS_Process(&hUsbDevice);
+}
+
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
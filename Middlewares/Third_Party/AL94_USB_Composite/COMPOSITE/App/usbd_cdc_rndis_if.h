@@ -23,6 +23,8 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_cdc_rndis.h"
+#include "usbd_udp.h"
+#include "usbd_iperf.h"
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
@@ -37,7 +39,7 @@
 #define CDC_RNDIS_MAC_ADDR5                    0x00U /* 00 */
 
 #define USBD_CDC_RNDIS_VENDOR_DESC             "STMicroelectronics"
-#define USBD_CDC_RNDIS_LINK_SPEED              100000U /* 10Mbps */
+#define USBD_CDC_RNDIS_LINK_SPEED              0U /* 100 bit/s units, 0 follows the bus speed */
 #define USBD_CDC_RNDIS_VID                     0x0483U
 
 /* Max Number of Trials waiting for Tx ready */
@@ -49,11 +51,28 @@
 #define CDC_RNDIS_CONNECT_SPEED_UPSTREAM                    0x1E000000U
 #define CDC_RNDIS_CONNECT_SPEED_DOWNSTREAM                  0x1E000000U
 
+/* Device end of the link for lwIP or the UDP responder, the MAC above is the host's */
+#define CDC_RNDIS_NETIF_HWADDR                 {0x02U, 0x02U, 0x02U, 0x03U, 0x00U, 0x01U}
+#define CDC_RNDIS_NETIF_IPADDR                 0xC0A80701U /* 192.168.7.1 */
+#define CDC_RNDIS_NETIF_NETMASK                0xFFFFFF00U /* 255.255.255.0 */
+#define CDC_RNDIS_NETIF_GW                     0x00000000U
+
 
 extern USBD_CDC_RNDIS_ItfTypeDef                    USBD_CDC_RNDIS_fops;
 
+#if (USBD_UDP_USE_FASTPATH == 1U)
+/* Responder of the interface, for USBD_UDP_OpenFlow() and USBD_UDP_Send() */
+extern USBD_UDP_HandleTypeDef                       CDC_RNDIS_Udp;
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+/* iperf 2 server on the responder, for its counters */
+extern USBD_Iperf_HandleTypeDef                     CDC_RNDIS_Iperf;
+#endif /* USBD_IPERF_USE_SERVER */
+#endif /* USBD_UDP_USE_FASTPATH */
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
+void CDC_RNDIS_Process(void);
 
 #endif /* __USBD_CDC_RNDIS_IF_H */
 
@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_csum.h
+  * @brief          : Header for usbd_csum.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CSUM_H__
+#define __USBD_CSUM_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_CSUM USBD_CSUM
+  * @brief Internet checksum, CRC32 and CRC32C for the network and storage paths
+  * @{
+  */
+
+/** @defgroup USBD_CSUM_Exported_Defines USBD_CSUM_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Set to 0 to keep the CRC unit free for the application, the table driven
+   code is used then. Only applies where the device has one */
+#ifndef USBD_CSUM_USE_HW_CRC
+#define USBD_CSUM_USE_HW_CRC             1U
+#endif /* USBD_CSUM_USE_HW_CRC */
+
+/* Shorter buffers are not worth programming the CRC unit for */
+#ifndef USBD_CSUM_HW_CRC_MIN
+#define USBD_CSUM_HW_CRC_MIN             32U
+#endif /* USBD_CSUM_HW_CRC_MIN */
+
+/* Bytes fed to the CRC unit per critical section */
+#ifndef USBD_CSUM_HW_CRC_CHUNK
+#define USBD_CSUM_HW_CRC_CHUNK           256U
+#endif /* USBD_CSUM_HW_CRC_CHUNK */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CSUM_Exported_FunctionsPrototype USBD_CSUM_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+uint32_t USBD_Csum_Add(const uint8_t *data, uint32_t len, uint32_t sum);
+uint16_t USBD_Csum_Fold(uint32_t sum);
+uint16_t USBD_Csum_Update16(uint16_t csum, uint16_t from, uint16_t to);
+uint16_t USBD_Csum_Update32(uint16_t csum, uint32_t from, uint32_t to);
+
+uint32_t USBD_Csum_Crc32(uint32_t crc, const uint8_t *data, uint32_t len);
+uint32_t USBD_Csum_Crc32C(uint32_t crc, const uint8_t *data, uint32_t len);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CSUM_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -22,6 +22,7 @@
 #include "usbd_dfu_if.h"
 
 /* USER CODE BEGIN INCLUDE */
+#include "usbd_csum.h"
 
 /* USER CODE END INCLUDE */
 
@@ -92,6 +93,13 @@
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
 
+#if (USBD_DFU_VERIFY_IMAGE == 1U)
+/* Contiguous run of writes not verified yet */
+static uint32_t DFU_SegStart;
+static uint32_t DFU_SegNext;
+static uint32_t DFU_SegCrc;
+#endif /* USBD_DFU_VERIFY_IMAGE */
+
 /* USER CODE END PRIVATE_VARIABLES */
 
 /**
@@ -124,8 +132,12 @@ static uint16_t MEM_If_Write(uint8_t *src, uint8_t *dest, uint32_t Len);
 static uint8_t *MEM_If_Read(uint8_t *src, uint8_t *dest, uint32_t Len);
 static uint16_t MEM_If_DeInit(void);
 static uint16_t MEM_If_GetStatus(uint32_t Add, uint8_t Cmd, uint8_t *buffer);
+static uint16_t MEM_If_Manifest(void);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+#if (USBD_DFU_VERIFY_IMAGE == 1U)
+static uint16_t MEM_If_Verify(void);
+#endif /* USBD_DFU_VERIFY_IMAGE */
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -145,7 +157,8 @@ __ALIGN_BEGIN USBD_DFU_MediaTypeDef USBD_DFU_fops __ALIGN_END =
     MEM_If_Erase,
     MEM_If_Write,
     MEM_If_Read,
-    MEM_If_GetStatus
+    MEM_If_GetStatus,
+    MEM_If_Manifest
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -157,6 +170,11 @@ __ALIGN_BEGIN USBD_DFU_MediaTypeDef USBD_DFU_fops __ALIGN_END =
 uint16_t MEM_If_Init(void)
 {
   /* USER CODE BEGIN 6 */
+#if (USBD_DFU_VERIFY_IMAGE == 1U)
+  DFU_SegStart = 0U;
+  DFU_SegNext = 0U;
+  DFU_SegCrc = 0U;
+#endif /* USBD_DFU_VERIFY_IMAGE */
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -194,6 +212,21 @@ uint16_t MEM_If_Erase(uint32_t Add)
 uint16_t MEM_If_Write(uint8_t *src, uint8_t *dest, uint32_t Len)
 {
   /* USER CODE BEGIN 9 */
+  /* Program the flash here, then account the block for the read back */
+#if (USBD_DFU_VERIFY_IMAGE == 1U)
+  if ((uint32_t)dest != DFU_SegNext)
+  {
+    /* A new segment starts, the previous one is complete */
+    if (MEM_If_Verify() != USBD_OK)
+    {
+      return (USBD_FAIL);
+    }
+    DFU_SegStart = (uint32_t)dest;
+  }
+
+  DFU_SegCrc = USBD_Csum_Crc32(DFU_SegCrc, src, Len);
+  DFU_SegNext = (uint32_t)dest + Len;
+#endif /* USBD_DFU_VERIFY_IMAGE */
   return (USBD_OK);
   /* USER CODE END 9 */
 }
@@ -238,8 +271,47 @@ uint16_t MEM_If_GetStatus(uint32_t Add, uint8_t Cmd, uint8_t *buffer)
   /* USER CODE END 11 */
 }
 
+/**
+  * @brief  Manifestation, last check before leaving DFU mode.
+  * @retval USBD_OK if the image may be run, USBD_FAIL else.
+  */
+uint16_t MEM_If_Manifest(void)
+{
+  /* USER CODE BEGIN 12 */
+#if (USBD_DFU_VERIFY_IMAGE == 1U)
+  return MEM_If_Verify();
+#else
+  return (USBD_OK);
+#endif /* USBD_DFU_VERIFY_IMAGE */
+  /* USER CODE END 12 */
+}
+
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+#if (USBD_DFU_VERIFY_IMAGE == 1U)
+/**
+  * @brief  Compare the pending segment in flash with what was received.
+  * @retval USBD_OK if it matches or there was nothing to check, USBD_FAIL else.
+  */
+static uint16_t MEM_If_Verify(void)
+{
+  uint32_t start = DFU_SegStart;
+  uint32_t len = DFU_SegNext - DFU_SegStart;
+  uint32_t crc = DFU_SegCrc;
+
+  DFU_SegStart = 0U;
+  DFU_SegNext = 0U;
+  DFU_SegCrc = 0U;
+
+  if (len == 0U)
+  {
+    return (USBD_OK);
+  }
+
+  return (USBD_Csum_Crc32(0U, (const uint8_t *)start, len) == crc) ? USBD_OK : USBD_FAIL;
+}
+#endif /* USBD_DFU_VERIFY_IMAGE */
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
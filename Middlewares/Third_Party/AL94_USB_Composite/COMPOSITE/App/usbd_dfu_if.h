@@ -50,6 +50,14 @@
 
 /* USER CODE BEGIN EXPORTED_DEFINES */
 
+/* Read back every downloaded segment and compare its CRC32 with the data the
+   host sent, a mismatch fails the download with errVERIFY. Set to 1 once
+   MEM_If_Write() programs the flash, the template one only returns USBD_OK
+   and every read back would mismatch */
+#ifndef USBD_DFU_VERIFY_IMAGE
+#define USBD_DFU_VERIFY_IMAGE            0U
+#endif /* USBD_DFU_VERIFY_IMAGE */
+
 /* USER CODE END EXPORTED_DEFINES */
 
 /**
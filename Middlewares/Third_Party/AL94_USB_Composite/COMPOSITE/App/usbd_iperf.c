@@ -0,0 +1,1103 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_iperf.c
+  * @brief          : iperf 2 compatible throughput server for the USB network
+  *                   interfaces.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           Answers "iperf -c <device> [-u] [-r|-d]" from an iperf 2 client
+  *           on USBD_IPERF_PORT, so sustained throughput can be compared
+  *           across RNDIS and ECM, FIFO layouts and DMA settings with a
+  *           stock tool on the host.
+  *
+  *           Transports: UDP runs on the fast path (usbd_udp.c), the
+  *           interface Receive callback passes datagrams through
+  *           USBD_Iperf_UdpInput(). With lwIP (usbd_netif.c) the server
+  *           opens its own raw API TCP and UDP pcbs instead.
+  *
+  *           Receive: payloads are only counted, never copied; the lwIP
+  *           pbufs pointing into the USB buffers are freed on the spot. UDP
+  *           loss, reordering and jitter (RFC 1889) come from the iperf
+  *           datagram header, and the closing datagram is answered with
+  *           the server report the client prints.
+  *
+  *           Transmit: a client header with HEADER_VERSION1 (-r, -d) asks
+  *           for a reverse test towards the client's port, started at once
+  *           for -d and after the client's own test for -r. UDP datagrams
+  *           are built in the lent TX frame, only the 12 byte iperf header
+  *           is written and the body goes out as it lies, paced to the
+  *           client's rate. TCP writes all reference one pattern buffer,
+  *           lwIP is never asked to copy.
+  *
+  *           USBD_Iperf_Process(), polled from the main loop, runs the
+  *           reverse tests. Counters of both directions sit in the handle.
+  *
+  *           CPU load: USBD_Iperf_LoopTick(), called once per main loop
+  *           pass, times the passes with the DWT cycle counter. The fastest
+  *           pass seen is what an idle pass costs; whatever the passes take
+  *           beyond that went to interrupts and real work. USBD_Iperf_Load()
+  *           returns that share in per mille, 0 where there is no DWT.
+  *
+  *           iperf 3 uses a JSON control connection and is not answered.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_iperf.h"
+#include <string.h>
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+
+/* Private define ------------------------------------------------------------*/
+/* iperf 2 wire format, all fields big endian */
+#define IPERF_UDP_HLEN                   12U   /* id, tv_sec, tv_usec */
+#define IPERF_CLIENT_HLEN                24U   /* flags, threads, port, buffer len, rate, amount */
+#define IPERF_SERVER_HLEN                40U   /* UDP server report */
+
+#define IPERF_HEADER_VERSION1            0x80000000U
+#define IPERF_RUN_NOW                    0x00000001U
+
+#define IPERF_UDP_DEFAULT_LEN            1470U
+
+#define IPERF_PROTO_UDP                  0U
+#define IPERF_PROTO_TCP                  1U
+
+#define IPERF_RX_IDLE                    0U
+#define IPERF_RX_RUN                     1U
+#define IPERF_RX_DONE                    2U
+
+#define IPERF_TX_IDLE                    0U
+#define IPERF_TX_WAIT                    1U   /* -r: after the receive test */
+#define IPERF_TX_START                   2U
+#define IPERF_TX_CONNECT                 3U
+#define IPERF_TX_RUN                     4U
+#define IPERF_TX_FIN                     5U
+
+#if defined(DWT)
+#define IPERF_CYCCNT                     1U
+#else
+#define IPERF_CYCCNT                     0U
+#endif /* DWT */
+
+/* Private variables ---------------------------------------------------------*/
+#if (USBD_NETIF_USE_LWIP == 1U)
+/* Payload of every TCP write, the iperf digit pattern */
+static uint8_t Iperf_Pattern[USBD_IPERF_PATTERN_SIZE];
+#endif /* USBD_NETIF_USE_LWIP */
+
+#if (IPERF_CYCCNT == 1U)
+static uint32_t Iperf_CycHigh;
+static uint32_t Iperf_CycLast;
+static uint64_t Iperf_LoopLast;
+static uint64_t Iperf_LoadStart;
+static uint32_t Iperf_LoopMin;
+static uint32_t Iperf_LoopPasses;
+#endif /* IPERF_CYCCNT */
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t Iperf_UdpDatagram(USBD_Iperf_HandleTypeDef *hperf, uint32_t src_ip,
+                                 uint16_t src_port, const uint8_t *hdr, uint32_t len);
+static void Iperf_UdpReport(USBD_Iperf_HandleTypeDef *hperf, const uint8_t *hdr, uint32_t len);
+static uint8_t Iperf_UdpSendData(USBD_Iperf_HandleTypeDef *hperf, int32_t id, uint64_t now);
+static void Iperf_UdpGenerate(USBD_Iperf_HandleTypeDef *hperf, uint64_t now);
+static void Iperf_ParseHeader(USBD_Iperf_HandleTypeDef *hperf, const uint8_t *hdr,
+                              uint8_t proto, uint32_t ip);
+static void Iperf_RxStart(USBD_Iperf_HandleTypeDef *hperf, uint8_t proto, uint32_t ip,
+                          uint16_t port, uint64_t now);
+static void Iperf_RxDone(USBD_Iperf_HandleTypeDef *hperf);
+static void Iperf_TxStart(USBD_Iperf_HandleTypeDef *hperf, uint64_t now);
+static uint8_t Iperf_TxDone(const USBD_Iperf_HandleTypeDef *hperf, uint64_t now);
+static void Iperf_CountersStart(USBD_Iperf_CountersTypeDef *cnt);
+static uint64_t Iperf_NowUs(void);
+#if (IPERF_CYCCNT == 1U)
+static uint64_t Iperf_Cycles(void);
+#endif /* IPERF_CYCCNT */
+#if (USBD_NETIF_USE_LWIP == 1U)
+static void Iperf_UdpRecv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                          const ip_addr_t *addr, u16_t port);
+static err_t Iperf_TcpAccept(void *arg, struct tcp_pcb *pcb, err_t err);
+static err_t Iperf_TcpRecv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err);
+static void Iperf_TcpRxError(void *arg, err_t err);
+static err_t Iperf_TcpConnected(void *arg, struct tcp_pcb *pcb, err_t err);
+static err_t Iperf_TcpSent(void *arg, struct tcp_pcb *pcb, u16_t len);
+static void Iperf_TcpTxError(void *arg, err_t err);
+static void Iperf_TcpFill(USBD_Iperf_HandleTypeDef *hperf, uint64_t now);
+#endif /* USBD_NETIF_USE_LWIP */
+static uint32_t Iperf_Get32(const uint8_t *addr);
+static void Iperf_Put32(uint8_t *addr, uint32_t val);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Reset the server and bind it to its transport
+  * @param  hperf: server instance
+  * @param  hudp: fast path responder, NULL with lwIP, the pcbs are opened
+  *         here then and lwIP must be initialized
+  * @retval None
+  */
+void USBD_Iperf_Init(USBD_Iperf_HandleTypeDef *hperf, USBD_UDP_HandleTypeDef *hudp)
+{
+#if (USBD_NETIF_USE_LWIP == 1U)
+  struct tcp_pcb *pcb;
+  uint32_t i;
+#endif /* USBD_NETIF_USE_LWIP */
+
+  hperf->hudp = hudp;
+
+  /* Whatever was going on, the link is new */
+  hperf->rx_state = IPERF_RX_IDLE;
+  hperf->tx_state = IPERF_TX_IDLE;
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+  for (i = 0U; i < USBD_IPERF_PATTERN_SIZE; i++)
+  {
+    Iperf_Pattern[i] = (uint8_t)('0' + (i % 10U));
+  }
+
+  if (hperf->tcp_listen == NULL)
+  {
+    pcb = tcp_new();
+
+    if ((pcb != NULL) && (tcp_bind(pcb, IP_ADDR_ANY, USBD_IPERF_PORT) == ERR_OK))
+    {
+      hperf->tcp_listen = tcp_listen(pcb);
+    }
+
+    if (hperf->tcp_listen != NULL)
+    {
+      tcp_arg(hperf->tcp_listen, hperf);
+      tcp_accept(hperf->tcp_listen, Iperf_TcpAccept);
+    }
+    else if (pcb != NULL)
+    {
+      (void)tcp_close(pcb);
+    }
+    else
+    {
+      /* Out of pcbs */
+    }
+  }
+
+  if (hperf->udp == NULL)
+  {
+    hperf->udp = udp_new();
+
+    if (hperf->udp != NULL)
+    {
+      (void)udp_bind(hperf->udp, IP_ADDR_ANY, USBD_IPERF_PORT);
+      udp_recv(hperf->udp, Iperf_UdpRecv, hperf);
+    }
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+}
+
+/**
+  * @brief  Offer a fast path datagram to the server, called from the
+  *         interface Receive callback
+  * @param  hperf: server instance
+  * @param  src_ip: sender address
+  * @param  src_port: sender port
+  * @param  dst_port: local port
+  * @param  data: payload
+  * @param  len: payload length
+  * @retval USBD_OK when the server took the datagram, USBD_FAIL otherwise
+  */
+uint8_t USBD_Iperf_UdpInput(USBD_Iperf_HandleTypeDef *hperf, uint32_t src_ip, uint16_t src_port,
+                            uint16_t dst_port, uint8_t *data, uint16_t len)
+{
+  if (dst_port != USBD_IPERF_PORT)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  return Iperf_UdpDatagram(hperf, src_ip, src_port, data, len);
+}
+
+/**
+  * @brief  Run the reverse tests, to be polled from the main loop
+  * @param  hperf: server instance
+  * @retval None
+  */
+void USBD_Iperf_Process(USBD_Iperf_HandleTypeDef *hperf)
+{
+  uint64_t now = Iperf_NowUs();
+
+  switch (hperf->tx_state)
+  {
+    case IPERF_TX_WAIT:
+      if (hperf->rx_state == IPERF_RX_DONE)
+      {
+        hperf->tx_state = IPERF_TX_START;
+      }
+      break;
+
+    case IPERF_TX_START:
+      Iperf_TxStart(hperf, now);
+      break;
+
+    case IPERF_TX_RUN:
+#if (USBD_NETIF_USE_LWIP == 1U)
+      if (hperf->tx_proto == IPERF_PROTO_TCP)
+      {
+        Iperf_TcpFill(hperf, now);
+        break;
+      }
+#endif /* USBD_NETIF_USE_LWIP */
+      Iperf_UdpGenerate(hperf, now);
+      break;
+
+    case IPERF_TX_FIN:
+      /* The client answers the last datagram with its report */
+      if ((HAL_GetTick() - hperf->tx_fin_tick) >= USBD_IPERF_FIN_INTERVAL)
+      {
+        if (hperf->tx_fins >= USBD_IPERF_FIN_RETRIES)
+        {
+          hperf->tx_state = IPERF_TX_IDLE;
+        }
+        else if (Iperf_UdpSendData(hperf, -(int32_t)hperf->tx_id, now) == (uint8_t)USBD_OK)
+        {
+          hperf->tx_fins++;
+          hperf->tx_fin_tick = HAL_GetTick();
+        }
+        else
+        {
+          /* Class full, try again on the next pass */
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  * @brief  Throughput of one direction
+  * @param  cnt: counters
+  * @retval kbit/s from the first to the last packet
+  */
+uint32_t USBD_Iperf_Kbps(const USBD_Iperf_CountersTypeDef *cnt)
+{
+  if (cnt->time_ms == 0U)
+  {
+    return 0U;
+  }
+
+  return (uint32_t)((cnt->bytes * 8U) / cnt->time_ms);
+}
+
+/**
+  * @brief  Mark one pass of the main loop, for USBD_Iperf_Load()
+  * @param  None
+  * @retval None
+  */
+void USBD_Iperf_LoopTick(void)
+{
+#if (IPERF_CYCCNT == 1U)
+  uint64_t now = Iperf_Cycles();
+  uint32_t pass;
+
+  if (Iperf_LoopLast == 0U)
+  {
+    Iperf_LoadStart = now;
+  }
+  else
+  {
+    pass = (uint32_t)(now - Iperf_LoopLast);
+
+    if ((Iperf_LoopMin == 0U) || (pass < Iperf_LoopMin))
+    {
+      Iperf_LoopMin = pass;
+    }
+    Iperf_LoopPasses++;
+  }
+
+  Iperf_LoopLast = now;
+#endif /* IPERF_CYCCNT */
+}
+
+/**
+  * @brief  CPU share taken by interrupts and main loop work since the
+  *         previous call
+  * @param  None
+  * @retval load in per mille, 0 without a cycle counter
+  */
+uint32_t USBD_Iperf_Load(void)
+{
+#if (IPERF_CYCCNT == 1U)
+  uint64_t elapsed = Iperf_LoopLast - Iperf_LoadStart;
+  uint64_t idle = (uint64_t)Iperf_LoopPasses * Iperf_LoopMin;
+  uint32_t load = 0U;
+
+  if ((elapsed != 0U) && (idle < elapsed))
+  {
+    load = 1000U - (uint32_t)((idle * 1000U) / elapsed);
+  }
+
+  Iperf_LoadStart = Iperf_LoopLast;
+  Iperf_LoopPasses = 0U;
+
+  return load;
+#else
+  return 0U;
+#endif /* IPERF_CYCCNT */
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Account one UDP datagram of a client test
+  * @param  hperf: server instance
+  * @param  src_ip: sender address
+  * @param  src_port: sender port
+  * @param  hdr: datagram start, at least the first IPERF_UDP_HLEN +
+  *         IPERF_CLIENT_HLEN bytes or the whole datagram if shorter
+  * @param  len: datagram length
+  * @retval USBD_OK when the datagram belonged to iperf, USBD_FAIL otherwise
+  */
+static uint8_t Iperf_UdpDatagram(USBD_Iperf_HandleTypeDef *hperf, uint32_t src_ip,
+                                 uint16_t src_port, const uint8_t *hdr, uint32_t len)
+{
+  uint64_t now = Iperf_NowUs();
+  uint8_t same = ((src_ip == hperf->rx_ip) && (src_port == hperf->rx_port)) ? 1U : 0U;
+  uint32_t seq;
+  int32_t id;
+  int32_t transit;
+  int32_t delta;
+
+  if (len < IPERF_UDP_HLEN)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  /* The client's report on our reverse test */
+  if ((hperf->tx_state == IPERF_TX_FIN) && (src_ip == hperf->tx_ip) && (src_port == hperf->tx_port))
+  {
+    hperf->tx_state = IPERF_TX_IDLE;
+    return (uint8_t)USBD_OK;
+  }
+
+  id = (int32_t)Iperf_Get32(&hdr[0]);
+
+  if ((hperf->rx_state != IPERF_RX_RUN) || (same == 0U))
+  {
+    if (id < 0)
+    {
+      /* Our report got lost, the client repeats its last datagram */
+      if ((same != 0U) && (hperf->rx_state == IPERF_RX_DONE))
+      {
+        Iperf_UdpReport(hperf, hdr, len);
+      }
+      return (uint8_t)USBD_OK;
+    }
+
+    Iperf_RxStart(hperf, IPERF_PROTO_UDP, src_ip, src_port, now);
+
+    if (len >= (IPERF_UDP_HLEN + IPERF_CLIENT_HLEN))
+    {
+      Iperf_ParseHeader(hperf, &hdr[IPERF_UDP_HLEN], IPERF_PROTO_UDP, src_ip);
+    }
+  }
+
+  hperf->rx.bytes += len;
+  hperf->rx.packets++;
+  hperf->rx.time_ms = (uint32_t)((now - hperf->rx_start_us) / 1000U);
+
+  /* RFC 1889 jitter, kept in 1/16 us: J += (|D| - J) / 16 */
+  transit = (int32_t)((uint32_t)now - ((Iperf_Get32(&hdr[4]) * 1000000U) + Iperf_Get32(&hdr[8])));
+  if (hperf->rx.packets > 1U)
+  {
+    delta = transit - hperf->rx_transit;
+    delta = (delta < 0) ? -delta : delta;
+    hperf->rx_jitter += (uint32_t)delta - (hperf->rx_jitter >> 4);
+    hperf->rx.jitter_us = hperf->rx_jitter >> 4;
+  }
+  hperf->rx_transit = transit;
+
+  /* The last datagram carries the negated id */
+  seq = (id < 0) ? (uint32_t)(-id) : (uint32_t)id;
+
+  if (seq >= hperf->rx_next_id)
+  {
+    hperf->rx.lost += seq - hperf->rx_next_id;
+    hperf->rx_next_id = seq + 1U;
+  }
+  else
+  {
+    /* Late, it was counted as lost */
+    hperf->rx.out_of_order++;
+    if (hperf->rx.lost != 0U)
+    {
+      hperf->rx.lost--;
+    }
+  }
+
+  if (id < 0)
+  {
+    Iperf_RxDone(hperf);
+    Iperf_UdpReport(hperf, hdr, len);
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Answer the last datagram of a client test with the server report
+  * @param  hperf: server instance
+  * @param  hdr: the client's last datagram, its iperf header is echoed
+  * @param  len: its length, the report has the same
+  * @retval None
+  */
+static void Iperf_UdpReport(USBD_Iperf_HandleTypeDef *hperf, const uint8_t *hdr, uint32_t len)
+{
+  const USBD_Iperf_CountersTypeDef *cnt = &hperf->rx;
+  uint8_t *payload;
+  uint8_t *srv;
+#if (USBD_NETIF_USE_LWIP == 1U)
+  struct pbuf *p;
+  ip_addr_t addr;
+#else
+  USBD_UDP_FlowTypeDef flow;
+#endif /* USBD_NETIF_USE_LWIP */
+
+  if (len < (IPERF_UDP_HLEN + IPERF_SERVER_HLEN))
+  {
+    len = IPERF_UDP_HLEN + IPERF_SERVER_HLEN;
+  }
+  if (len > USBD_UDP_MAX_PAYLOAD)
+  {
+    len = USBD_UDP_MAX_PAYLOAD;
+  }
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+  p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)len, PBUF_RAM);
+  if (p == NULL)
+  {
+    return;
+  }
+  payload = (uint8_t *)p->payload;
+#else
+  if (USBD_UDP_OpenFlow(hperf->hudp, &flow, hperf->rx_ip, USBD_IPERF_PORT,
+                        hperf->rx_port) != (uint8_t)USBD_OK)
+  {
+    return;
+  }
+
+  payload = USBD_UDP_Alloc(hperf->hudp);
+  if (payload == NULL)
+  {
+    return;
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+
+  (void)memcpy(payload, hdr, IPERF_UDP_HLEN);
+  (void)memset(&payload[IPERF_UDP_HLEN], 0, len - IPERF_UDP_HLEN);
+
+  srv = &payload[IPERF_UDP_HLEN];
+  Iperf_Put32(&srv[0], IPERF_HEADER_VERSION1);
+  Iperf_Put32(&srv[4], (uint32_t)(cnt->bytes >> 32));
+  Iperf_Put32(&srv[8], (uint32_t)cnt->bytes);
+  Iperf_Put32(&srv[12], cnt->time_ms / 1000U);
+  Iperf_Put32(&srv[16], (cnt->time_ms % 1000U) * 1000U);
+  Iperf_Put32(&srv[20], cnt->lost);
+  Iperf_Put32(&srv[24], cnt->out_of_order);
+  Iperf_Put32(&srv[28], hperf->rx_next_id);
+  Iperf_Put32(&srv[32], cnt->jitter_us / 1000000U);
+  Iperf_Put32(&srv[36], cnt->jitter_us % 1000000U);
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+  ip_addr_set_ip4_u32(&addr, lwip_htonl(hperf->rx_ip));
+  (void)udp_sendto(hperf->udp, p, &addr, hperf->rx_port);
+  (void)pbuf_free(p);
+#else
+  if (USBD_UDP_Send(hperf->hudp, &flow, payload, (uint16_t)len) != (uint8_t)USBD_OK)
+  {
+    USBD_UDP_Free(hperf->hudp, payload);
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+}
+
+/**
+  * @brief  Send one datagram of the reverse UDP test, only its iperf header
+  *         is written
+  * @param  hperf: server instance
+  * @param  id: datagram id, negated for the last one
+  * @param  now: time stamp, us
+  * @retval USBD_OK, USBD_BUSY when the transport is full
+  */
+static uint8_t Iperf_UdpSendData(USBD_Iperf_HandleTypeDef *hperf, int32_t id, uint64_t now)
+{
+  uint8_t *payload;
+  uint8_t ret;
+#if (USBD_NETIF_USE_LWIP == 1U)
+  struct pbuf *p;
+  ip_addr_t addr;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, hperf->tx_len, PBUF_RAM);
+  if (p == NULL)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+  payload = (uint8_t *)p->payload;
+#else
+  payload = USBD_UDP_Alloc(hperf->hudp);
+  if (payload == NULL)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+
+  Iperf_Put32(&payload[0], (uint32_t)id);
+  Iperf_Put32(&payload[4], (uint32_t)(now / 1000000U));
+  Iperf_Put32(&payload[8], (uint32_t)(now % 1000000U));
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+  ip_addr_set_ip4_u32(&addr, lwip_htonl(hperf->tx_ip));
+  ret = (udp_sendto(hperf->udp, p, &addr, hperf->tx_port) == ERR_OK) ? (uint8_t)USBD_OK : (uint8_t)USBD_BUSY;
+  (void)pbuf_free(p);
+#else
+  ret = USBD_UDP_Send(hperf->hudp, &hperf->tx_flow, payload, hperf->tx_len);
+  if (ret != (uint8_t)USBD_OK)
+  {
+    USBD_UDP_Free(hperf->hudp, payload);
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+
+  return ret;
+}
+
+/**
+  * @brief  Send reverse UDP datagrams until the transport is full or the
+  *         rate is reached
+  * @param  hperf: server instance
+  * @param  now: time, us
+  * @retval None
+  */
+static void Iperf_UdpGenerate(USBD_Iperf_HandleTypeDef *hperf, uint64_t now)
+{
+  uint64_t elapsed = now - hperf->tx_start_us;
+  uint64_t allowed = ((uint64_t)hperf->tx_rate * elapsed) / 8000000U;
+
+  while (hperf->tx_state == IPERF_TX_RUN)
+  {
+    if (Iperf_TxDone(hperf, now) != 0U)
+    {
+      hperf->tx_state = IPERF_TX_FIN;
+      hperf->tx_fins = 0U;
+      hperf->tx_fin_tick = HAL_GetTick() - USBD_IPERF_FIN_INTERVAL;
+      break;
+    }
+
+    if (hperf->tx.bytes >= allowed)
+    {
+      break;
+    }
+
+    if (Iperf_UdpSendData(hperf, (int32_t)hperf->tx_id, now) != (uint8_t)USBD_OK)
+    {
+      break;
+    }
+
+    hperf->tx_id++;
+    hperf->tx.bytes += hperf->tx_len;
+    hperf->tx.packets++;
+    hperf->tx.time_ms = (uint32_t)(elapsed / 1000U);
+  }
+}
+
+/**
+  * @brief  Pick up the reverse test a client header asks for
+  * @param  hperf: server instance
+  * @param  hdr: client header
+  * @param  proto: IPERF_PROTO_UDP or IPERF_PROTO_TCP
+  * @param  ip: client address
+  * @retval None
+  */
+static void Iperf_ParseHeader(USBD_Iperf_HandleTypeDef *hperf, const uint8_t *hdr,
+                              uint8_t proto, uint32_t ip)
+{
+  uint32_t flags = Iperf_Get32(&hdr[0]);
+  uint32_t len = Iperf_Get32(&hdr[12]);
+  int32_t amount = (int32_t)Iperf_Get32(&hdr[20]);
+
+  /* Plain tests carry payload here, reverse tests are one at a time */
+  if (((flags & IPERF_HEADER_VERSION1) == 0U) || (hperf->tx_state != IPERF_TX_IDLE))
+  {
+    return;
+  }
+
+  hperf->tx_proto = proto;
+  hperf->tx_ip = ip;
+  hperf->tx_port = (uint16_t)Iperf_Get32(&hdr[8]);
+  hperf->tx_run_now = ((flags & IPERF_RUN_NOW) != 0U) ? 1U : 0U;
+
+  if (len == 0U)
+  {
+    len = IPERF_UDP_DEFAULT_LEN;
+  }
+  if (len < (IPERF_UDP_HLEN + IPERF_CLIENT_HLEN))
+  {
+    len = IPERF_UDP_HLEN + IPERF_CLIENT_HLEN;
+  }
+  if (len > USBD_UDP_MAX_PAYLOAD)
+  {
+    len = USBD_UDP_MAX_PAYLOAD;
+  }
+  hperf->tx_len = (uint16_t)len;
+
+  hperf->tx_rate = Iperf_Get32(&hdr[16]);
+  if ((proto == IPERF_PROTO_TCP) || (hperf->tx_rate == 0U))
+  {
+    /* TCP sends as fast as the window allows, the field is the window size */
+    hperf->tx_rate = (proto == IPERF_PROTO_TCP) ? 0U : USBD_IPERF_DEFAULT_RATE;
+  }
+
+  /* Negative: time in 10 ms units, else bytes */
+  if (amount < 0)
+  {
+    hperf->tx_amount = 0U;
+    hperf->tx_time_ms = (uint32_t)(-amount) * 10U;
+  }
+  else
+  {
+    hperf->tx_amount = (uint32_t)amount;
+    hperf->tx_time_ms = 0U;
+  }
+
+  hperf->tx_state = (hperf->tx_run_now != 0U) ? IPERF_TX_START : IPERF_TX_WAIT;
+}
+
+/**
+  * @brief  A client starts a test
+  * @param  hperf: server instance
+  * @param  proto: IPERF_PROTO_UDP or IPERF_PROTO_TCP
+  * @param  ip: client address
+  * @param  port: client port
+  * @param  now: time, us
+  * @retval None
+  */
+static void Iperf_RxStart(USBD_Iperf_HandleTypeDef *hperf, uint8_t proto, uint32_t ip,
+                          uint16_t port, uint64_t now)
+{
+  Iperf_CountersStart(&hperf->rx);
+
+  hperf->rx_proto = proto;
+  hperf->rx_ip = ip;
+  hperf->rx_port = port;
+  hperf->rx_next_id = 0U;
+  hperf->rx_transit = 0;
+  hperf->rx_jitter = 0U;
+  hperf->rx_start_us = now;
+  hperf->rx_state = IPERF_RX_RUN;
+}
+
+/**
+  * @brief  The client test ended, a -r reverse test may start
+  * @param  hperf: server instance
+  * @retval None
+  */
+static void Iperf_RxDone(USBD_Iperf_HandleTypeDef *hperf)
+{
+  hperf->rx_state = IPERF_RX_DONE;
+}
+
+/**
+  * @brief  Set up the reverse test
+  * @param  hperf: server instance
+  * @param  now: time, us
+  * @retval None
+  */
+static void Iperf_TxStart(USBD_Iperf_HandleTypeDef *hperf, uint64_t now)
+{
+#if (USBD_NETIF_USE_LWIP == 1U)
+  ip_addr_t addr;
+
+  if (hperf->tx_proto == IPERF_PROTO_TCP)
+  {
+    hperf->tcp_tx = tcp_new();
+    if (hperf->tcp_tx == NULL)
+    {
+      hperf->tx_state = IPERF_TX_IDLE;
+      return;
+    }
+
+    tcp_arg(hperf->tcp_tx, hperf);
+    tcp_err(hperf->tcp_tx, Iperf_TcpTxError);
+    tcp_sent(hperf->tcp_tx, Iperf_TcpSent);
+
+    ip_addr_set_ip4_u32(&addr, lwip_htonl(hperf->tx_ip));
+    hperf->tx_state = IPERF_TX_CONNECT;
+
+    if (tcp_connect(hperf->tcp_tx, &addr, hperf->tx_port, Iperf_TcpConnected) != ERR_OK)
+    {
+      tcp_abort(hperf->tcp_tx);
+      hperf->tcp_tx = NULL;
+      hperf->tx_state = IPERF_TX_IDLE;
+    }
+    return;
+  }
+#else
+  /* Waits here while the client's MAC is being resolved */
+  if (USBD_UDP_OpenFlow(hperf->hudp, &hperf->tx_flow, hperf->tx_ip, USBD_IPERF_PORT,
+                        hperf->tx_port) != (uint8_t)USBD_OK)
+  {
+    return;
+  }
+#endif /* USBD_NETIF_USE_LWIP */
+
+  Iperf_CountersStart(&hperf->tx);
+  hperf->tx_id = 0U;
+  hperf->tx_start_us = now;
+  hperf->tx_state = IPERF_TX_RUN;
+}
+
+/**
+  * @brief  Whether the reverse test sent its amount or ran its time
+  * @param  hperf: server instance
+  * @param  now: time, us
+  * @retval 1 once done
+  */
+static uint8_t Iperf_TxDone(const USBD_Iperf_HandleTypeDef *hperf, uint64_t now)
+{
+  if (hperf->tx_amount != 0U)
+  {
+    return (hperf->tx.bytes >= hperf->tx_amount) ? 1U : 0U;
+  }
+
+  return ((now - hperf->tx_start_us) >= ((uint64_t)hperf->tx_time_ms * 1000U)) ? 1U : 0U;
+}
+
+/**
+  * @brief  Clear the counters of one direction for a new test
+  * @param  cnt: counters
+  * @retval None
+  */
+static void Iperf_CountersStart(USBD_Iperf_CountersTypeDef *cnt)
+{
+  uint32_t tests = cnt->tests;
+
+  (void)memset(cnt, 0, sizeof(*cnt));
+  cnt->tests = tests + 1U;
+}
+
+/**
+  * @brief  Time base of the tests
+  * @param  None
+  * @retval us, from the cycle counter where there is one, else from the tick
+  */
+static uint64_t Iperf_NowUs(void)
+{
+#if (IPERF_CYCCNT == 1U)
+  return Iperf_Cycles() / (SystemCoreClock / 1000000U);
+#else
+  return (uint64_t)HAL_GetTick() * 1000U;
+#endif /* IPERF_CYCCNT */
+}
+
+#if (IPERF_CYCCNT == 1U)
+/**
+  * @brief  DWT cycle counter extended to 64 bits, started on first use;
+  *         the main loop must call in at least once per wrap (9 s at 480 MHz)
+  * @param  None
+  * @retval cycles
+  */
+static uint64_t Iperf_Cycles(void)
+{
+  uint32_t primask;
+  uint32_t now;
+  uint64_t cycles;
+
+  USBD_LL_StartCycleCounter();
+
+  /* Called from the USB interrupt too */
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  now = DWT->CYCCNT;
+  if (now < Iperf_CycLast)
+  {
+    Iperf_CycHigh++;
+  }
+  Iperf_CycLast = now;
+  cycles = ((uint64_t)Iperf_CycHigh << 32) | now;
+
+  __set_PRIMASK(primask);
+
+  return cycles;
+}
+#endif /* IPERF_CYCCNT */
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+/**
+  * @brief  lwIP UDP receive callback, the datagram is only counted
+  * @param  arg: server instance
+  * @param  pcb: server pcb
+  * @param  p: datagram
+  * @param  addr: sender address
+  * @param  port: sender port
+  * @retval None
+  */
+static void Iperf_UdpRecv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                          const ip_addr_t *addr, u16_t port)
+{
+  uint8_t hdr[IPERF_UDP_HLEN + IPERF_CLIENT_HLEN];
+
+  UNUSED(pcb);
+
+  (void)pbuf_copy_partial(p, hdr, (u16_t)sizeof(hdr), 0U);
+  (void)Iperf_UdpDatagram((USBD_Iperf_HandleTypeDef *)arg, lwip_ntohl(ip_addr_get_ip4_u32(addr)),
+                          port, hdr, p->tot_len);
+  (void)pbuf_free(p);
+}
+
+/**
+  * @brief  A client connected, one TCP test at a time
+  * @param  arg: server instance
+  * @param  pcb: new connection
+  * @param  err: ERR_OK unless lwIP ran out of memory
+  * @retval ERR_OK, ERR_ABRT when the connection was refused
+  */
+static err_t Iperf_TcpAccept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  USBD_Iperf_HandleTypeDef *hperf = (USBD_Iperf_HandleTypeDef *)arg;
+
+  if ((err != ERR_OK) || (pcb == NULL))
+  {
+    return ERR_VAL;
+  }
+
+  if (hperf->tcp_rx != NULL)
+  {
+    tcp_abort(pcb);
+    return ERR_ABRT;
+  }
+
+  hperf->tcp_rx = pcb;
+  hperf->tcp_hdr_len = 0U;
+  Iperf_RxStart(hperf, IPERF_PROTO_TCP, lwip_ntohl(ip_addr_get_ip4_u32(&pcb->remote_ip)),
+                pcb->remote_port, Iperf_NowUs());
+
+  tcp_arg(pcb, hperf);
+  tcp_recv(pcb, Iperf_TcpRecv);
+  tcp_err(pcb, Iperf_TcpRxError);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  Data of the client test: counted, acknowledged and freed
+  * @param  arg: server instance
+  * @param  pcb: connection
+  * @param  p: received data, NULL once the client closed
+  * @param  err: ERR_OK
+  * @retval ERR_OK, ERR_ABRT when the connection was aborted
+  */
+static err_t Iperf_TcpRecv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  USBD_Iperf_HandleTypeDef *hperf = (USBD_Iperf_HandleTypeDef *)arg;
+  uint64_t now = Iperf_NowUs();
+
+  UNUSED(err);
+
+  if (p == NULL)
+  {
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    hperf->tcp_rx = NULL;
+    Iperf_RxDone(hperf);
+
+    if (tcp_close(pcb) != ERR_OK)
+    {
+      tcp_abort(pcb);
+      return ERR_ABRT;
+    }
+    return ERR_OK;
+  }
+
+  /* The client header leads the stream */
+  if (hperf->tcp_hdr_len < IPERF_CLIENT_HLEN)
+  {
+    hperf->tcp_hdr_len += (uint8_t)pbuf_copy_partial(p, &hperf->tcp_hdr[hperf->tcp_hdr_len],
+                                                     (u16_t)(IPERF_CLIENT_HLEN - hperf->tcp_hdr_len), 0U);
+    if (hperf->tcp_hdr_len == IPERF_CLIENT_HLEN)
+    {
+      Iperf_ParseHeader(hperf, hperf->tcp_hdr, IPERF_PROTO_TCP, hperf->rx_ip);
+    }
+  }
+
+  hperf->rx.bytes += p->tot_len;
+  hperf->rx.packets++;
+  hperf->rx.time_ms = (uint32_t)((now - hperf->rx_start_us) / 1000U);
+
+  tcp_recved(pcb, p->tot_len);
+  (void)pbuf_free(p);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  The client connection was reset, the pcb is gone
+  * @param  arg: server instance
+  * @param  err: reason
+  * @retval None
+  */
+static void Iperf_TcpRxError(void *arg, err_t err)
+{
+  USBD_Iperf_HandleTypeDef *hperf = (USBD_Iperf_HandleTypeDef *)arg;
+
+  UNUSED(err);
+
+  hperf->tcp_rx = NULL;
+  Iperf_RxDone(hperf);
+}
+
+/**
+  * @brief  The reverse connection is up, start sending
+  * @param  arg: server instance
+  * @param  pcb: connection
+  * @param  err: ERR_OK
+  * @retval ERR_OK
+  */
+static err_t Iperf_TcpConnected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  USBD_Iperf_HandleTypeDef *hperf = (USBD_Iperf_HandleTypeDef *)arg;
+  uint64_t now = Iperf_NowUs();
+
+  UNUSED(pcb);
+  UNUSED(err);
+
+  Iperf_CountersStart(&hperf->tx);
+  hperf->tx_start_us = now;
+  hperf->tx_state = IPERF_TX_RUN;
+  Iperf_TcpFill(hperf, now);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  The client acknowledged data, queue more
+  * @param  arg: server instance
+  * @param  pcb: connection
+  * @param  len: bytes acknowledged
+  * @retval ERR_OK
+  */
+static err_t Iperf_TcpSent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+  UNUSED(pcb);
+  UNUSED(len);
+
+  Iperf_TcpFill((USBD_Iperf_HandleTypeDef *)arg, Iperf_NowUs());
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  The reverse connection failed or was reset, the pcb is gone
+  * @param  arg: server instance
+  * @param  err: reason
+  * @retval None
+  */
+static void Iperf_TcpTxError(void *arg, err_t err)
+{
+  USBD_Iperf_HandleTypeDef *hperf = (USBD_Iperf_HandleTypeDef *)arg;
+
+  UNUSED(err);
+
+  hperf->tcp_tx = NULL;
+  hperf->tx_state = IPERF_TX_IDLE;
+}
+
+/**
+  * @brief  Fill the send buffer of the reverse connection with references
+  *         to the pattern, close it once the test is done
+  * @param  hperf: server instance
+  * @param  now: time, us
+  * @retval None
+  */
+static void Iperf_TcpFill(USBD_Iperf_HandleTypeDef *hperf, uint64_t now)
+{
+  struct tcp_pcb *pcb = hperf->tcp_tx;
+  uint32_t len;
+
+  if ((pcb == NULL) || (hperf->tx_state != IPERF_TX_RUN))
+  {
+    return;
+  }
+
+  for (;;)
+  {
+    if (Iperf_TxDone(hperf, now) != 0U)
+    {
+      /* Queued data still goes out before the FIN */
+      tcp_sent(pcb, NULL);
+      tcp_err(pcb, NULL);
+      hperf->tcp_tx = NULL;
+      hperf->tx_state = IPERF_TX_IDLE;
+
+      if (tcp_close(pcb) != ERR_OK)
+      {
+        tcp_abort(pcb);
+      }
+      return;
+    }
+
+    len = tcp_sndbuf(pcb);
+    if (len > USBD_IPERF_PATTERN_SIZE)
+    {
+      len = USBD_IPERF_PATTERN_SIZE;
+    }
+    if ((hperf->tx_amount != 0U) && (len > (hperf->tx_amount - hperf->tx.bytes)))
+    {
+      len = (uint32_t)(hperf->tx_amount - hperf->tx.bytes);
+    }
+
+    if ((len == 0U) || (tcp_write(pcb, Iperf_Pattern, (u16_t)len, 0U) != ERR_OK))
+    {
+      break;
+    }
+
+    hperf->tx.bytes += len;
+    hperf->tx.packets++;
+    hperf->tx.time_ms = (uint32_t)((now - hperf->tx_start_us) / 1000U);
+  }
+
+  (void)tcp_output(pcb);
+}
+#endif /* USBD_NETIF_USE_LWIP */
+
+static uint32_t Iperf_Get32(const uint8_t *addr)
+{
+  return ((uint32_t)addr[0] << 24) | ((uint32_t)addr[1] << 16) |
+         ((uint32_t)addr[2] << 8) | addr[3];
+}
+
+static void Iperf_Put32(uint8_t *addr, uint32_t val)
+{
+  addr[0] = (uint8_t)(val >> 24);
+  addr[1] = (uint8_t)(val >> 16);
+  addr[2] = (uint8_t)(val >> 8);
+  addr[3] = (uint8_t)val;
+}
+
+#endif /* USBD_IPERF_USE_SERVER */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
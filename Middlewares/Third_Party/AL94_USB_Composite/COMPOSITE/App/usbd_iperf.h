@@ -0,0 +1,188 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_iperf.h
+  * @brief          : Header for usbd_iperf.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_IPERF_H__
+#define __USBD_IPERF_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+#include "usbd_udp.h"
+#include "usbd_netif.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_IPERF USBD_IPERF
+  * @brief iperf 2 throughput server on the USB network interfaces
+  * @{
+  */
+
+/** @defgroup USBD_IPERF_Exported_Defines USBD_IPERF_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Set to 1 to answer iperf 2 clients: UDP on the fast path (USBD_UDP_USE_FASTPATH),
+   TCP and UDP once lwIP runs the interfaces (USBD_NETIF_USE_LWIP) */
+#ifndef USBD_IPERF_USE_SERVER
+#define USBD_IPERF_USE_SERVER            0U
+#endif /* USBD_IPERF_USE_SERVER */
+
+#ifndef USBD_IPERF_PORT
+#define USBD_IPERF_PORT                  5001U
+#endif /* USBD_IPERF_PORT */
+
+/* UDP rate of a reverse test whose client asked for none, bit/s */
+#ifndef USBD_IPERF_DEFAULT_RATE
+#define USBD_IPERF_DEFAULT_RATE          1000000U
+#endif /* USBD_IPERF_DEFAULT_RATE */
+
+/* The last datagram of a reverse UDP test is repeated until the client reports */
+#ifndef USBD_IPERF_FIN_RETRIES
+#define USBD_IPERF_FIN_RETRIES           10U
+#endif /* USBD_IPERF_FIN_RETRIES */
+
+#ifndef USBD_IPERF_FIN_INTERVAL
+#define USBD_IPERF_FIN_INTERVAL          250U
+#endif /* USBD_IPERF_FIN_INTERVAL */
+
+/* Largest write the TCP sender hands lwIP at once, all from one pattern buffer */
+#define USBD_IPERF_PATTERN_SIZE          1472U
+
+/**
+  * @}
+  */
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+#endif /* USBD_NETIF_USE_LWIP */
+
+/** @defgroup USBD_IPERF_Exported_Types USBD_IPERF_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+/* One direction of the current or last test */
+typedef struct
+{
+  uint64_t bytes;          /* Payload bytes, headers left out */
+  uint32_t packets;        /* Datagrams, or TCP receive callbacks and writes */
+  uint32_t lost;           /* UDP receive only */
+  uint32_t out_of_order;
+  uint32_t jitter_us;
+  uint32_t time_ms;        /* From the first to the last packet */
+  uint32_t tests;
+} USBD_Iperf_CountersTypeDef;
+
+typedef struct
+{
+  USBD_UDP_HandleTypeDef *hudp; /* Fast path transport, NULL with lwIP */
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+  struct tcp_pcb *tcp_listen;
+  struct tcp_pcb *tcp_rx;
+  struct tcp_pcb *tcp_tx;
+  struct udp_pcb *udp;
+  uint8_t tcp_hdr[24];     /* Client header at the start of the stream */
+  uint8_t tcp_hdr_len;
+#endif /* USBD_NETIF_USE_LWIP */
+
+  /* Receive: the client's test, one at a time */
+  __IO uint8_t rx_state;
+  uint8_t rx_proto;
+  uint32_t rx_ip;
+  uint16_t rx_port;
+  uint32_t rx_next_id;     /* Next UDP datagram id expected */
+  int32_t rx_transit;      /* Last transit time, for the jitter */
+  uint32_t rx_jitter;      /* Jitter in 1/16 us */
+  uint64_t rx_start_us;
+
+  /* Transmit: the reverse test the client header asked for */
+  __IO uint8_t tx_state;
+  uint8_t tx_proto;
+  uint8_t tx_run_now;      /* Dual test, else after the receive test ends */
+  uint32_t tx_ip;
+  uint16_t tx_port;
+  uint16_t tx_len;         /* UDP payload per datagram */
+  uint32_t tx_rate;        /* UDP bit/s */
+  uint32_t tx_amount;      /* Bytes, 0 when the test is timed */
+  uint32_t tx_time_ms;
+  uint32_t tx_id;
+  uint32_t tx_fins;
+  uint32_t tx_fin_tick;
+  uint64_t tx_start_us;
+  USBD_UDP_FlowTypeDef tx_flow;
+
+  USBD_Iperf_CountersTypeDef rx;
+  USBD_Iperf_CountersTypeDef tx;
+} USBD_Iperf_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_IPERF_Exported_FunctionsPrototype USBD_IPERF_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void USBD_Iperf_Init(USBD_Iperf_HandleTypeDef *hperf, USBD_UDP_HandleTypeDef *hudp);
+uint8_t USBD_Iperf_UdpInput(USBD_Iperf_HandleTypeDef *hperf, uint32_t src_ip, uint16_t src_port,
+                            uint16_t dst_port, uint8_t *data, uint16_t len);
+void USBD_Iperf_Process(USBD_Iperf_HandleTypeDef *hperf);
+uint32_t USBD_Iperf_Kbps(const USBD_Iperf_CountersTypeDef *cnt);
+
+void USBD_Iperf_LoopTick(void);
+uint32_t USBD_Iperf_Load(void);
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+/* Served by usbd_netif.c on all lwIP interfaces */
+extern USBD_Iperf_HandleTypeDef USBD_Netif_Iperf;
+#endif /* USBD_NETIF_USE_LWIP */
+
+/**
+  * @}
+  */
+
+#endif /* USBD_IPERF_USE_SERVER */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_IPERF_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,304 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_cache.c
+  * @brief          : Write-back block cache for the MSC storage interface.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           Writes from the USB interrupt only copy the blocks into cache
+  *           lines and mark them dirty, so the host is acknowledged at bus
+  *           speed whatever the backend costs. MSC_Cache_Flush(), polled from
+  *           the main loop, writes the oldest dirty line back. A write that
+  *           does not fit in the free and clean lines returns USBD_BUSY
+  *           without touching the cache; the MSC class then keeps the OUT
+  *           endpoint NAKing until USBD_MSC_Resume() retries it.
+  *
+  *           Reads are served from the cache when a line holds the block and
+  *           go straight to the backend otherwise, so reads never wait for a
+  *           flush. The MSC class writes at most MSC_MEDIA_PACKET at a time,
+  *           which the cache must hold whole (MSC_CACHE_LINES).
+  *
+  *           The flush runs with interrupts enabled, a backend write may take
+  *           as long as a sector erase. Until it completes the line being
+  *           written back stays dirty and the USB side leaves it alone: a
+  *           write to its block returns USBD_BUSY.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_cache.h"
+#include "usbd_def.h"
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static MSC_Cache_LineTypeDef *Cache_Lookup(MSC_Cache_HandleTypeDef *hcache, uint32_t blk_addr);
+static MSC_Cache_LineTypeDef *Cache_Alloc(MSC_Cache_HandleTypeDef *hcache);
+static uint32_t Cache_Available(MSC_Cache_HandleTypeDef *hcache);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Attach a cache to its backend, all lines start free
+  * @param  hcache: cache instance
+  * @param  read: backend read
+  * @param  write: backend write
+  * @retval None
+  */
+void MSC_Cache_Init(MSC_Cache_HandleTypeDef *hcache, MSC_Cache_IoTypeDef read, MSC_Cache_IoTypeDef write)
+{
+  (void)memset(hcache, 0, sizeof(MSC_Cache_HandleTypeDef));
+
+  hcache->read = read;
+  hcache->write = write;
+}
+
+/**
+  * @brief  Read blocks, preferring cached copies over the backend
+  * @param  hcache: cache instance
+  * @param  buf: destination buffer
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+int8_t MSC_Cache_Read(MSC_Cache_HandleTypeDef *hcache, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  MSC_Cache_LineTypeDef *line;
+  uint32_t blk;
+
+  for (blk = blk_addr; blk < (blk_addr + blk_len); blk++)
+  {
+    line = Cache_Lookup(hcache, blk);
+
+    if (line != NULL)
+    {
+      (void)memcpy(buf, line->data, MSC_CACHE_BLK_SIZ);
+    }
+    else if (hcache->read(buf, blk, 1U) < 0)
+    {
+      return -1;
+    }
+
+    buf += MSC_CACHE_BLK_SIZ;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Queue blocks for write-back
+  * @param  hcache: cache instance
+  * @param  buf: source buffer
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 0 if the blocks are cached, USBD_BUSY if the caller has to retry
+  *         after a flush, -1 if they could never fit
+  */
+int8_t MSC_Cache_Write(MSC_Cache_HandleTypeDef *hcache, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  MSC_Cache_LineTypeDef *line;
+  uint32_t blk;
+  uint32_t need = 0U;
+
+  /* Never retried into the cache, see MSC_CACHE_LINES */
+  if (blk_len > MSC_CACHE_LINES)
+  {
+    return -1;
+  }
+
+  /* Every block not already dirty turns one free or clean line dirty */
+  for (blk = blk_addr; blk < (blk_addr + blk_len); blk++)
+  {
+    line = Cache_Lookup(hcache, blk);
+
+    /* The backend is reading this one */
+    if ((line != NULL) && (line == hcache->flushing))
+    {
+      return (int8_t)USBD_BUSY;
+    }
+
+    if ((line == NULL) || (line->state != MSC_CACHE_LINE_DIRTY))
+    {
+      need++;
+    }
+  }
+
+  /* All or nothing, a partially cached packet could not be retried */
+  if (need > Cache_Available(hcache))
+  {
+    return (int8_t)USBD_BUSY;
+  }
+
+  for (blk = blk_addr; blk < (blk_addr + blk_len); blk++)
+  {
+    line = Cache_Lookup(hcache, blk);
+
+    if (line == NULL)
+    {
+      line = Cache_Alloc(hcache);
+      line->blk_addr = blk;
+    }
+
+    if (line->state != MSC_CACHE_LINE_DIRTY)
+    {
+      hcache->dirty++;
+    }
+
+    (void)memcpy(line->data, buf, MSC_CACHE_BLK_SIZ);
+    line->state = MSC_CACHE_LINE_DIRTY;
+    line->age = ++hcache->age;
+
+    buf += MSC_CACHE_BLK_SIZ;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Write the oldest dirty line back, to be polled from the main loop
+  * @note   Interrupts are only masked to pick the line and to retire it, the
+  *         backend write runs with them enabled. Not reentrant.
+  * @param  hcache: cache instance
+  * @retval 1 if a line was written back, 0 if nothing was dirty or the
+  *         backend was busy, -1 if the backend failed and the line was dropped
+  */
+int8_t MSC_Cache_Flush(MSC_Cache_HandleTypeDef *hcache)
+{
+  MSC_Cache_LineTypeDef *oldest = NULL;
+  uint32_t primask;
+  uint32_t i;
+  int8_t status;
+  int8_t ret;
+
+  if (hcache->dirty == 0U)
+  {
+    return 0;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  for (i = 0U; i < MSC_CACHE_LINES; i++)
+  {
+    if ((hcache->line[i].state == MSC_CACHE_LINE_DIRTY) &&
+        ((oldest == NULL) || ((int32_t)(hcache->line[i].age - oldest->age) < 0)))
+    {
+      oldest = &hcache->line[i];
+    }
+  }
+
+  hcache->flushing = oldest;
+
+  __set_PRIMASK(primask);
+
+  status = hcache->write(oldest->data, oldest->blk_addr, 1U);
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (status < 0)
+  {
+    hcache->dirty--;
+    oldest->state = MSC_CACHE_LINE_FREE;
+    ret = -1;
+  }
+  else if (status == (int8_t)USBD_BUSY)
+  {
+    /* Backend in use, the line stays dirty for the next pass */
+    ret = 0;
+  }
+  else
+  {
+    hcache->dirty--;
+    oldest->state = MSC_CACHE_LINE_CLEAN;
+    ret = 1;
+  }
+
+  hcache->flushing = NULL;
+
+  __set_PRIMASK(primask);
+
+  return ret;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Find the line holding a block
+  * @param  hcache: cache instance
+  * @param  blk_addr: block
+  * @retval line, NULL if the block is not cached
+  */
+static MSC_Cache_LineTypeDef *Cache_Lookup(MSC_Cache_HandleTypeDef *hcache, uint32_t blk_addr)
+{
+  uint32_t i;
+
+  for (i = 0U; i < MSC_CACHE_LINES; i++)
+  {
+    if ((hcache->line[i].state != MSC_CACHE_LINE_FREE) && (hcache->line[i].blk_addr == blk_addr))
+    {
+      return &hcache->line[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  * @brief  Take a free line, else evict the least recently written clean one
+  * @param  hcache: cache instance
+  * @retval line, NULL if every line is dirty
+  */
+static MSC_Cache_LineTypeDef *Cache_Alloc(MSC_Cache_HandleTypeDef *hcache)
+{
+  MSC_Cache_LineTypeDef *victim = NULL;
+  uint32_t i;
+
+  for (i = 0U; i < MSC_CACHE_LINES; i++)
+  {
+    if (hcache->line[i].state == MSC_CACHE_LINE_FREE)
+    {
+      return &hcache->line[i];
+    }
+
+    if ((hcache->line[i].state == MSC_CACHE_LINE_CLEAN) &&
+        ((victim == NULL) || ((int32_t)(hcache->line[i].age - victim->age) < 0)))
+    {
+      victim = &hcache->line[i];
+    }
+  }
+
+  return victim;
+}
+
+/**
+  * @brief  Count the lines a write may take
+  * @param  hcache: cache instance
+  * @retval free and clean lines
+  */
+static uint32_t Cache_Available(MSC_Cache_HandleTypeDef *hcache)
+{
+  return MSC_CACHE_LINES - hcache->dirty;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
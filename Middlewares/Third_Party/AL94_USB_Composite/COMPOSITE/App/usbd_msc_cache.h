@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_cache.h
+  * @brief          : Header for usbd_msc_cache.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_CACHE_H__
+#define __USBD_MSC_CACHE_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_MSC_CACHE USBD_MSC_CACHE
+  * @brief Write-back block cache placed in front of a slow MSC backend
+  * @{
+  */
+
+/** @defgroup USBD_MSC_CACHE_Exported_Defines USBD_MSC_CACHE_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Lines per cache, must cover at least one MSC_MEDIA_PACKET worth of blocks */
+#ifndef MSC_CACHE_LINES
+#define MSC_CACHE_LINES                  16U
+#endif /* MSC_CACHE_LINES */
+
+#define MSC_CACHE_BLK_SIZ                512U
+
+#define MSC_CACHE_LINE_FREE              0U
+#define MSC_CACHE_LINE_CLEAN             1U
+#define MSC_CACHE_LINE_DIRTY             2U
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MSC_CACHE_Exported_Types USBD_MSC_CACHE_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+/* Backend block access, same contract as the storage callbacks: < 0 on error,
+   a write may return USBD_BUSY to be retried */
+typedef int8_t (*MSC_Cache_IoTypeDef)(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+
+typedef struct
+{
+  uint32_t blk_addr;
+  uint32_t age;     /* Write order, oldest dirty line is flushed first */
+  uint8_t  state;
+  uint8_t  data[MSC_CACHE_BLK_SIZ];
+} MSC_Cache_LineTypeDef;
+
+typedef struct
+{
+  MSC_Cache_LineTypeDef line[MSC_CACHE_LINES];
+  MSC_Cache_IoTypeDef   read;
+  MSC_Cache_IoTypeDef   write;
+  uint32_t              age;
+  uint32_t              dirty;
+  MSC_Cache_LineTypeDef *volatile flushing;   /* Line the backend is writing back, NULL if none */
+} MSC_Cache_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MSC_CACHE_Exported_FunctionsPrototype USBD_MSC_CACHE_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void MSC_Cache_Init(MSC_Cache_HandleTypeDef *hcache, MSC_Cache_IoTypeDef read, MSC_Cache_IoTypeDef write);
+int8_t MSC_Cache_Read(MSC_Cache_HandleTypeDef *hcache, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+int8_t MSC_Cache_Write(MSC_Cache_HandleTypeDef *hcache, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+int8_t MSC_Cache_Flush(MSC_Cache_HandleTypeDef *hcache);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_CACHE_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
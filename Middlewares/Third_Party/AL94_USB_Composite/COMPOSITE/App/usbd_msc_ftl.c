@@ -0,0 +1,847 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_ftl.c
+  * @brief          : Flash translation layer for the MSC storage interface.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Flash layout
+  *          ===================================================================
+  *           The FTL owns MSC_FTL_SECTOR_NBR erase sectors of bank 2. Each
+  *           sector starts with a header flash word (magic, sequence number)
+  *           followed by slots of one tag flash word and one 512-byte block.
+  *           Blocks are only ever appended: a rewrite programs a new slot and
+  *           the RAM mapping table moves to it, leaving the old copy as
+  *           garbage. The tag is programmed after the data, so a slot only
+  *           counts once it is complete.
+  *
+  *           The tag also holds the CRC32C of the block, its complement
+  *           and a flag word that says it is there; slots written before
+  *           the CRC was added have all three at zero. Reads check it
+  *           (MSC_FTL_VERIFY_READS) and fail rather than return rotten data,
+  *           a CRC that does not match its complement fails them too.
+  *           Compaction copies the CRC along with the block, so corruption
+  *           stays detectable after the move.
+  *
+  *           On mount the sectors are replayed oldest sequence first, which
+  *           rebuilds the mapping table and drops anything a power loss left
+  *           half-written: torn slots are skipped, torn headers or erases are
+  *           erased again.
+  *
+  *           Sector erases never run on the host write path as long as
+  *           MSC_FTL_Process() is polled: it erases sectors that hold only
+  *           garbage and compacts the emptiest sector ahead of time, so the
+  *           host only waits for flash word programming. If the host outruns
+  *           it, the write path does the same work in the foreground.
+  *
+  *           Writes and background steps run with interrupts enabled and
+  *           are serialized by a busy flag: a write that finds it taken
+  *           returns USBD_BUSY. Reads take no lock, from the USB interrupt
+  *           they only see a mapping entry change once its slot is
+  *           committed, and a superseded slot is not erased before the next
+  *           step.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_ftl.h"
+#include "usbd_csum.h"
+#include "usbd_def.h"
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint8_t  state;
+  uint16_t used;   /* Slots consumed, valid or not */
+  uint16_t valid;  /* Slots still referenced by the mapping table */
+  uint32_t seq;
+} FTL_SectorTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define FTL_HDR_MAGIC                    0x4C54464DU   /* "MFTL" */
+#define FTL_TAG_MAGIC                    0x4B4C424DU   /* "MBLK" */
+#define FTL_TAG_CRC                      0x43524343U   /* "CCRC", the tag holds a CRC */
+
+/* What a slot tag says about the CRC of its block */
+#define FTL_CRC_NONE                     0U   /* Written before the CRC was added */
+#define FTL_CRC_VALID                    1U
+#define FTL_CRC_CORRUPT                  2U   /* The tag itself is damaged */
+
+#define FTL_SECTOR_ERASED                0U
+#define FTL_SECTOR_ACTIVE                1U
+#define FTL_SECTOR_FULL                  2U
+#define FTL_SECTOR_DIRTY                 3U   /* Garbage only, waiting for erase */
+#define FTL_SECTOR_ERASING               4U
+
+#define FTL_NO_SECTOR                    0xFFU
+#define FTL_NO_SLOT                      0xFFFFU
+
+/* Background compaction only runs on sectors with at least this much garbage */
+#ifndef MSC_FTL_GC_THRESHOLD
+#define MSC_FTL_GC_THRESHOLD             (MSC_FTL_SLOTS_PER_SECTOR / 4U)
+#endif /* MSC_FTL_GC_THRESHOLD */
+
+/* Private macro -------------------------------------------------------------*/
+#define FTL_SECTOR_ADDR(s)               (MSC_FTL_BASE_ADDR + ((uint32_t)(s) * MSC_FTL_SECTOR_SIZE))
+#define FTL_SLOT_ADDR(p)                 (FTL_SECTOR_ADDR((p) / MSC_FTL_SLOTS_PER_SECTOR) + MSC_FTL_WORD_SIZE + \
+                                          (((uint32_t)(p) % MSC_FTL_SLOTS_PER_SECTOR) * MSC_FTL_SLOT_SIZE))
+
+/* Private variables ---------------------------------------------------------*/
+static FTL_SectorTypeDef FTL_Sector[MSC_FTL_SECTOR_NBR];
+static uint16_t FTL_Map[MSC_FTL_BLK_NBR];
+static uint8_t FTL_Active = FTL_NO_SECTOR;
+static uint8_t FTL_Victim = FTL_NO_SECTOR;
+static uint16_t FTL_VictimSlot;
+static uint8_t FTL_Erasing = FTL_NO_SECTOR;
+static uint32_t FTL_NextSeq;
+static uint8_t FTL_Mounted;
+static __IO uint8_t FTL_Busy;   /* A write or a background step is running */
+
+/* Flash word staging buffer, HAL_FLASH_Program() reads the source by words */
+static uint32_t FTL_Word[FLASH_NB_32BITWORD_IN_FLASHWORD];
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t FTL_IsBlank(uint32_t addr, uint32_t len);
+static int8_t FTL_ProgramWord(uint32_t addr, const void *src);
+static void FTL_EraseStart(uint8_t sector);
+static uint8_t FTL_EraseDone(void);
+static void FTL_EraseWait(void);
+static uint32_t FTL_Free(void);
+static uint32_t FTL_Pending(void);
+static int8_t FTL_Open(void);
+static int8_t FTL_Append(uint32_t lbn, uint32_t src, uint32_t crc);
+static uint8_t FTL_TagCrc(const uint32_t *tag, uint32_t *crc);
+static void FTL_Release(uint16_t phys);
+static void FTL_Replay(uint8_t sector);
+static uint8_t FTL_Step(uint8_t foreground);
+static uint8_t FTL_Lock(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Rebuild the mapping table from flash, once per power cycle
+  * @retval 0 if the flash area could be mounted, -1 otherwise
+  */
+int8_t MSC_FTL_Mount(void)
+{
+  uint32_t *hdr;
+  uint8_t replayed[MSC_FTL_SECTOR_NBR];
+  uint32_t lbn;
+  uint8_t s;
+  uint8_t k;
+  uint8_t oldest;
+
+  if (FTL_Mounted != 0U)
+  {
+    return 0;
+  }
+
+  if (HAL_FLASH_Unlock() != HAL_OK)
+  {
+    return -1;
+  }
+
+  (void)memset(FTL_Map, 0xFF, sizeof(FTL_Map));
+
+  FTL_NextSeq = 1U;
+  FTL_Active = FTL_NO_SECTOR;
+  FTL_Victim = FTL_NO_SECTOR;
+  FTL_Erasing = FTL_NO_SECTOR;
+
+  /* Classify sectors by their header */
+  for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+  {
+    hdr = (uint32_t *)FTL_SECTOR_ADDR(s);
+    FTL_Sector[s].used = 0U;
+    FTL_Sector[s].valid = 0U;
+    FTL_Sector[s].seq = 0U;
+    replayed[s] = 1U;
+
+    if ((hdr[0] == FTL_HDR_MAGIC) && (hdr[2] == ~hdr[1]))
+    {
+      FTL_Sector[s].state = FTL_SECTOR_FULL;
+      FTL_Sector[s].seq = hdr[1];
+      replayed[s] = 0U;
+
+      if (hdr[1] >= FTL_NextSeq)
+      {
+        FTL_NextSeq = hdr[1] + 1U;
+      }
+    }
+    else if (FTL_IsBlank(FTL_SECTOR_ADDR(s), MSC_FTL_SECTOR_SIZE) != 0U)
+    {
+      FTL_Sector[s].state = FTL_SECTOR_ERASED;
+    }
+    else
+    {
+      /* Interrupted erase or header program */
+      FTL_Sector[s].state = FTL_SECTOR_DIRTY;
+    }
+  }
+
+  /* Replay oldest first so that newer copies of a block win */
+  for (k = 0U; k < MSC_FTL_SECTOR_NBR; k++)
+  {
+    oldest = FTL_NO_SECTOR;
+
+    for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+    {
+      if ((replayed[s] == 0U) &&
+          ((oldest == FTL_NO_SECTOR) || (FTL_Sector[s].seq < FTL_Sector[oldest].seq)))
+      {
+        oldest = s;
+      }
+    }
+
+    if (oldest == FTL_NO_SECTOR)
+    {
+      break;
+    }
+
+    FTL_Replay(oldest);
+    replayed[oldest] = 1U;
+
+    /* The newest sector with room left keeps taking writes */
+    FTL_Active = oldest;
+  }
+
+  for (lbn = 0U; lbn < MSC_FTL_BLK_NBR; lbn++)
+  {
+    if (FTL_Map[lbn] != FTL_NO_SLOT)
+    {
+      FTL_Sector[FTL_Map[lbn] / MSC_FTL_SLOTS_PER_SECTOR].valid++;
+    }
+  }
+
+  if ((FTL_Active != FTL_NO_SECTOR) && (FTL_Sector[FTL_Active].used < MSC_FTL_SLOTS_PER_SECTOR))
+  {
+    FTL_Sector[FTL_Active].state = FTL_SECTOR_ACTIVE;
+  }
+  else
+  {
+    FTL_Active = FTL_NO_SECTOR;
+  }
+
+  for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+  {
+    if ((FTL_Sector[s].state == FTL_SECTOR_FULL) && (FTL_Sector[s].valid == 0U))
+    {
+      FTL_Sector[s].state = FTL_SECTOR_DIRTY;
+    }
+  }
+
+  FTL_Mounted = 1U;
+
+  return 0;
+}
+
+/**
+  * @brief  Read logical blocks, unwritten blocks read as zeros
+  * @param  buf: destination buffer
+  * @param  blk_addr: first logical block
+  * @param  blk_len: number of blocks
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+int8_t MSC_FTL_Read(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  uint32_t lbn;
+  uint32_t crc;
+  uint16_t phys;
+
+  if ((FTL_Mounted == 0U) || ((blk_addr + blk_len) > MSC_FTL_BLK_NBR))
+  {
+    return -1;
+  }
+
+  for (lbn = blk_addr; lbn < (blk_addr + blk_len); lbn++)
+  {
+    phys = FTL_Map[lbn];
+
+    if (phys == FTL_NO_SLOT)
+    {
+      (void)memset(buf, 0, MSC_FTL_BLK_SIZ);
+    }
+    else
+    {
+      /* Stalls on the bus while a bank 2 erase is in progress */
+      (void)memcpy(buf, (const void *)(FTL_SLOT_ADDR(phys) + MSC_FTL_WORD_SIZE), MSC_FTL_BLK_SIZ);
+
+#if (MSC_FTL_VERIFY_READS == 1U)
+      switch (FTL_TagCrc((const uint32_t *)FTL_SLOT_ADDR(phys), &crc))
+      {
+        case FTL_CRC_NONE:
+          break;
+
+        case FTL_CRC_VALID:
+          if (USBD_Csum_Crc32C(0U, buf, MSC_FTL_BLK_SIZ) != crc)
+          {
+            return -1;
+          }
+          break;
+
+        default:
+          return -1;
+      }
+#else
+      UNUSED(crc);
+#endif /* MSC_FTL_VERIFY_READS */
+    }
+
+    buf += MSC_FTL_BLK_SIZ;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Write logical blocks
+  * @param  buf: source buffer
+  * @param  blk_addr: first logical block
+  * @param  blk_len: number of blocks
+  * @retval 0 if all operations are OK, USBD_BUSY if another write or a
+  *         background step is running, -1 otherwise
+  */
+int8_t MSC_FTL_Write(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  uint32_t lbn;
+  int8_t ret = 0;
+
+  if ((FTL_Mounted == 0U) || ((blk_addr + blk_len) > MSC_FTL_BLK_NBR))
+  {
+    return -1;
+  }
+
+  if (FTL_Lock() == 0U)
+  {
+    return (int8_t)USBD_BUSY;
+  }
+
+  for (lbn = blk_addr; (lbn < (blk_addr + blk_len)) && (ret == 0); lbn++)
+  {
+    /* Leave a sector's worth of room, plus what an ongoing compaction still
+       has to move, so that garbage collection can never run out of space */
+    while ((FTL_Free() <= (MSC_FTL_SLOTS_PER_SECTOR + FTL_Pending())) && (ret == 0))
+    {
+      if (FTL_Step(1U) == 0U)
+      {
+        ret = -1;
+      }
+    }
+
+    if ((ret == 0) && (FTL_Append(lbn, (uint32_t)buf, USBD_Csum_Crc32C(0U, buf, MSC_FTL_BLK_SIZ)) != 0))
+    {
+      ret = -1;
+    }
+
+    buf += MSC_FTL_BLK_SIZ;
+  }
+
+  FTL_Busy = 0U;
+
+  return ret;
+}
+
+/**
+  * @brief  Background erase and compaction, to be polled from the main loop
+  * @note   Runs one step with interrupts enabled, skipped while a write holds
+  *         the FTL. A step is at most one slot copy, an erase is only
+  *         started here and polled later.
+  * @retval None
+  */
+void MSC_FTL_Process(void)
+{
+  if ((FTL_Mounted == 0U) || (FTL_Lock() == 0U))
+  {
+    return;
+  }
+
+  (void)FTL_Step(0U);
+
+  FTL_Busy = 0U;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Check that a flash area reads erased
+  * @param  addr: start address
+  * @param  len: length in bytes, multiple of 4
+  * @retval 1 if blank, 0 otherwise
+  */
+static uint8_t FTL_IsBlank(uint32_t addr, uint32_t len)
+{
+  const uint32_t *p = (const uint32_t *)addr;
+  uint32_t i;
+
+  for (i = 0U; i < (len / 4U); i++)
+  {
+    if (p[i] != 0xFFFFFFFFU)
+    {
+      return 0U;
+    }
+  }
+
+  return 1U;
+}
+
+/**
+  * @brief  Program one 256-bit flash word
+  * @param  addr: flash word aligned destination
+  * @param  src: source, any alignment
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t FTL_ProgramWord(uint32_t addr, const void *src)
+{
+  /* Bank 2 cannot program while it erases */
+  FTL_EraseWait();
+
+  (void)memcpy(FTL_Word, src, MSC_FTL_WORD_SIZE);
+
+  if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_FLASHWORD, addr, (uint32_t)FTL_Word) != HAL_OK)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Start a sector erase without waiting for it
+  * @param  sector: FTL sector index
+  * @retval None
+  */
+static void FTL_EraseStart(uint8_t sector)
+{
+  FTL_Erasing = sector;
+  FTL_Sector[sector].state = FTL_SECTOR_ERASING;
+
+  __HAL_FLASH_CLEAR_FLAG_BANK2(FLASH_FLAG_ALL_ERRORS_BANK2 | FLASH_FLAG_EOP_BANK2);
+  FLASH_Erase_Sector(MSC_FTL_FIRST_SECTOR + sector, MSC_FTL_BANK, FLASH_VOLTAGE_RANGE_3);
+}
+
+/**
+  * @brief  Retire the pending erase once the bank is idle
+  * @retval 1 if no erase is pending anymore, 0 otherwise
+  */
+static uint8_t FTL_EraseDone(void)
+{
+  FTL_SectorTypeDef *sec;
+
+  if (FTL_Erasing == FTL_NO_SECTOR)
+  {
+    return 1U;
+  }
+
+  if (__HAL_FLASH_GET_FLAG_BANK2(FLASH_FLAG_QW_BANK2))
+  {
+    return 0U;
+  }
+
+  FLASH->CR2 &= (~(FLASH_CR_SER | FLASH_CR_SNB));
+
+  sec = &FTL_Sector[FTL_Erasing];
+  sec->used = 0U;
+  sec->valid = 0U;
+  sec->seq = 0U;
+
+  if ((FLASH->SR2 & (FLASH_FLAG_ALL_ERRORS_BANK2 & 0x7FFFFFFFU)) != 0U)
+  {
+    /* Retry on the next step */
+    sec->state = FTL_SECTOR_DIRTY;
+  }
+  else
+  {
+    sec->state = FTL_SECTOR_ERASED;
+  }
+
+  __HAL_FLASH_CLEAR_FLAG_BANK2(FLASH_FLAG_ALL_ERRORS_BANK2 | FLASH_FLAG_EOP_BANK2);
+  FTL_Erasing = FTL_NO_SECTOR;
+
+  return 1U;
+}
+
+/**
+  * @brief  Block until the pending erase is retired
+  * @retval None
+  */
+static void FTL_EraseWait(void)
+{
+  while (FTL_EraseDone() == 0U)
+  {
+  }
+}
+
+/**
+  * @brief  Slots that can still be programmed without an erase
+  * @retval number of slots
+  */
+static uint32_t FTL_Free(void)
+{
+  uint32_t free = 0U;
+  uint8_t s;
+
+  for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+  {
+    if (FTL_Sector[s].state == FTL_SECTOR_ERASED)
+    {
+      free += MSC_FTL_SLOTS_PER_SECTOR;
+    }
+    else if (FTL_Sector[s].state == FTL_SECTOR_ACTIVE)
+    {
+      free += (uint32_t)MSC_FTL_SLOTS_PER_SECTOR - FTL_Sector[s].used;
+    }
+    else
+    {
+      /* .. */
+    }
+  }
+
+  return free;
+}
+
+/**
+  * @brief  Slots the ongoing compaction still has to copy
+  * @retval number of slots
+  */
+static uint32_t FTL_Pending(void)
+{
+  return (FTL_Victim == FTL_NO_SECTOR) ? 0U : FTL_Sector[FTL_Victim].valid;
+}
+
+/**
+  * @brief  Start appending to an erased sector
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t FTL_Open(void)
+{
+  uint32_t hdr[FLASH_NB_32BITWORD_IN_FLASHWORD] = {0U};
+  uint8_t s;
+
+  for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+  {
+    if (FTL_Sector[s].state == FTL_SECTOR_ERASED)
+    {
+      break;
+    }
+  }
+
+  if (s == MSC_FTL_SECTOR_NBR)
+  {
+    return -1;
+  }
+
+  hdr[0] = FTL_HDR_MAGIC;
+  hdr[1] = FTL_NextSeq;
+  hdr[2] = ~FTL_NextSeq;
+
+  FTL_Sector[s].state = FTL_SECTOR_ACTIVE;
+  FTL_Sector[s].seq = FTL_NextSeq++;
+  FTL_Active = s;
+
+  return FTL_ProgramWord(FTL_SECTOR_ADDR(s), hdr);
+}
+
+/**
+  * @brief  Append one block to the log and point the mapping table at it
+  * @param  lbn: logical block number
+  * @param  src: block data, RAM or flash
+  * @param  crc: CRC32C of the block
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t FTL_Append(uint32_t lbn, uint32_t src, uint32_t crc)
+{
+  uint32_t tag[FLASH_NB_32BITWORD_IN_FLASHWORD] = {0U};
+  FTL_SectorTypeDef *sec;
+  uint32_t addr;
+  uint16_t phys;
+  uint32_t i;
+
+  if (FTL_Active == FTL_NO_SECTOR)
+  {
+    if (FTL_Open() != 0)
+    {
+      return -1;
+    }
+  }
+
+  sec = &FTL_Sector[FTL_Active];
+  phys = (uint16_t)((FTL_Active * MSC_FTL_SLOTS_PER_SECTOR) + sec->used);
+  addr = FTL_SLOT_ADDR(phys);
+
+  /* The slot is consumed even if programming fails half way */
+  sec->used++;
+
+  if (sec->used == MSC_FTL_SLOTS_PER_SECTOR)
+  {
+    sec->state = FTL_SECTOR_FULL;
+    FTL_Active = FTL_NO_SECTOR;
+  }
+
+  for (i = 0U; i < MSC_FTL_BLK_SIZ; i += MSC_FTL_WORD_SIZE)
+  {
+    if (FTL_ProgramWord(addr + MSC_FTL_WORD_SIZE + i, (const void *)(src + i)) != 0)
+    {
+      return -1;
+    }
+  }
+
+  /* Commit */
+  tag[0] = FTL_TAG_MAGIC;
+  tag[1] = lbn;
+  tag[2] = ~lbn;
+  tag[3] = crc;
+  tag[4] = ~crc;
+  tag[5] = FTL_TAG_CRC;
+
+  if (FTL_ProgramWord(addr, tag) != 0)
+  {
+    return -1;
+  }
+
+  if (FTL_Map[lbn] != FTL_NO_SLOT)
+  {
+    FTL_Release(FTL_Map[lbn]);
+  }
+
+  FTL_Map[lbn] = phys;
+  sec->valid++;
+
+  return 0;
+}
+
+/**
+  * @brief  Drop a reference to a superseded slot
+  * @param  phys: physical slot
+  * @retval None
+  */
+static void FTL_Release(uint16_t phys)
+{
+  uint8_t s = (uint8_t)(phys / MSC_FTL_SLOTS_PER_SECTOR);
+
+  FTL_Sector[s].valid--;
+
+  if ((FTL_Sector[s].valid == 0U) && (FTL_Sector[s].state == FTL_SECTOR_FULL))
+  {
+    FTL_Sector[s].state = FTL_SECTOR_DIRTY;
+
+    if (FTL_Victim == s)
+    {
+      FTL_Victim = FTL_NO_SECTOR;
+    }
+  }
+}
+
+/**
+  * @brief  CRC32C a slot tag carries, slots written before it was added have none
+  * @param  tag: slot tag
+  * @param  crc: CRC32C of the block
+  * @retval FTL_CRC_VALID, FTL_CRC_NONE when the CRC words and flag are all
+  *         still zero, FTL_CRC_CORRUPT otherwise
+  */
+static uint8_t FTL_TagCrc(const uint32_t *tag, uint32_t *crc)
+{
+  *crc = tag[3];
+
+  if ((tag[5] == FTL_TAG_CRC) && (tag[4] == ~tag[3]))
+  {
+    return FTL_CRC_VALID;
+  }
+
+  if ((tag[5] == 0U) && (tag[4] == 0U) && (tag[3] == 0U))
+  {
+    return FTL_CRC_NONE;
+  }
+
+  return FTL_CRC_CORRUPT;
+}
+
+/**
+  * @brief  Load the committed slots of a sector into the mapping table
+  * @param  sector: FTL sector index
+  * @retval None
+  */
+static void FTL_Replay(uint8_t sector)
+{
+  const uint32_t *tag;
+  uint32_t addr;
+  uint16_t phys;
+  uint16_t i;
+
+  for (i = 0U; i < MSC_FTL_SLOTS_PER_SECTOR; i++)
+  {
+    phys = (uint16_t)((sector * MSC_FTL_SLOTS_PER_SECTOR) + i);
+    addr = FTL_SLOT_ADDR(phys);
+    tag = (const uint32_t *)addr;
+
+    if ((tag[0] == FTL_TAG_MAGIC) && (tag[2] == ~tag[1]) && (tag[1] < MSC_FTL_BLK_NBR))
+    {
+      FTL_Map[tag[1]] = phys;
+      FTL_Sector[sector].used = i + 1U;
+    }
+    else if (FTL_IsBlank(addr, MSC_FTL_SLOT_SIZE) == 0U)
+    {
+      /* Torn write: data without tag, never reuse it */
+      FTL_Sector[sector].used = i + 1U;
+    }
+    else
+    {
+      /* .. */
+    }
+  }
+}
+
+/**
+  * @brief  One unit of erase-ahead work
+  * @param  foreground: 1 when a host write is waiting, 0 from the main loop
+  * @retval 1 if progress was made or an erase is in flight, 0 otherwise
+  */
+static uint8_t FTL_Step(uint8_t foreground)
+{
+  const uint32_t *tag;
+  uint32_t addr;
+  uint32_t lbn;
+  uint32_t crc;
+  uint16_t phys;
+  uint16_t garbage;
+  uint8_t s;
+
+  if (FTL_Erasing != FTL_NO_SECTOR)
+  {
+    if (foreground != 0U)
+    {
+      FTL_EraseWait();
+    }
+    else
+    {
+      (void)FTL_EraseDone();
+    }
+
+    return 1U;
+  }
+
+  /* Erase sectors that hold garbage only */
+  for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+  {
+    if (FTL_Sector[s].state == FTL_SECTOR_DIRTY)
+    {
+      FTL_EraseStart(s);
+
+      if (foreground != 0U)
+      {
+        FTL_EraseWait();
+      }
+      return 1U;
+    }
+  }
+
+  /* Keep two sectors' worth of free slots ahead of the host */
+  if ((foreground == 0U) && (FTL_Free() >= (2U * MSC_FTL_SLOTS_PER_SECTOR)))
+  {
+    return 0U;
+  }
+
+  if (FTL_Victim == FTL_NO_SECTOR)
+  {
+    /* Compact the sector with the least valid data */
+    for (s = 0U; s < MSC_FTL_SECTOR_NBR; s++)
+    {
+      if ((FTL_Sector[s].state == FTL_SECTOR_FULL) &&
+          ((FTL_Victim == FTL_NO_SECTOR) || (FTL_Sector[s].valid < FTL_Sector[FTL_Victim].valid)))
+      {
+        FTL_Victim = s;
+      }
+    }
+
+    if (FTL_Victim == FTL_NO_SECTOR)
+    {
+      return 0U;
+    }
+
+    garbage = MSC_FTL_SLOTS_PER_SECTOR - FTL_Sector[FTL_Victim].valid;
+
+    if ((garbage == 0U) || (FTL_Sector[FTL_Victim].valid > FTL_Free()) ||
+        ((foreground == 0U) && (garbage < MSC_FTL_GC_THRESHOLD)))
+    {
+      FTL_Victim = FTL_NO_SECTOR;
+      return 0U;
+    }
+
+    FTL_VictimSlot = 0U;
+  }
+
+  /* Move the next valid slot of the victim */
+  while (FTL_VictimSlot < MSC_FTL_SLOTS_PER_SECTOR)
+  {
+    phys = (uint16_t)((FTL_Victim * MSC_FTL_SLOTS_PER_SECTOR) + FTL_VictimSlot);
+    addr = FTL_SLOT_ADDR(phys);
+    tag = (const uint32_t *)addr;
+    lbn = tag[1];
+    FTL_VictimSlot++;
+
+    if ((tag[0] == FTL_TAG_MAGIC) && (lbn < MSC_FTL_BLK_NBR) && (FTL_Map[lbn] == phys))
+    {
+      /* Releasing the last valid slot retires the victim */
+      switch (FTL_TagCrc(tag, &crc))
+      {
+        case FTL_CRC_VALID:
+          break;
+
+        case FTL_CRC_NONE:
+          crc = USBD_Csum_Crc32C(0U, (const uint8_t *)(addr + MSC_FTL_WORD_SIZE), MSC_FTL_BLK_SIZ);
+          break;
+
+        default:
+          /* A CRC the block cannot match keeps its reads failing */
+          crc = ~USBD_Csum_Crc32C(0U, (const uint8_t *)(addr + MSC_FTL_WORD_SIZE), MSC_FTL_BLK_SIZ);
+          break;
+      }
+
+      return (FTL_Append(lbn, addr + MSC_FTL_WORD_SIZE, crc) == 0) ? 1U : 0U;
+    }
+  }
+
+  FTL_Victim = FTL_NO_SECTOR;
+
+  return 1U;
+}
+
+/**
+  * @brief  Take the FTL for a write or a background step
+  * @retval 1 if taken, 0 if already busy
+  */
+static uint8_t FTL_Lock(void)
+{
+  uint32_t primask;
+  uint8_t taken = 0U;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (FTL_Busy == 0U)
+  {
+    FTL_Busy = 1U;
+    taken = 1U;
+  }
+
+  __set_PRIMASK(primask);
+
+  return taken;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_ftl.h
+  * @brief          : Header for usbd_msc_ftl.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_FTL_H__
+#define __USBD_MSC_FTL_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_MSC_FTL USBD_MSC_FTL
+  * @brief Flash translation layer for the MSC storage interface
+  * @{
+  */
+
+/** @defgroup USBD_MSC_FTL_Exported_Defines USBD_MSC_FTL_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Flash area owned by the FTL: whole 128 KB sectors of bank 2 (FLASH2 in the linker script) */
+#ifndef MSC_FTL_BASE_ADDR
+#define MSC_FTL_BASE_ADDR                0x08100000U
+#endif /* MSC_FTL_BASE_ADDR */
+
+#ifndef MSC_FTL_FIRST_SECTOR
+#define MSC_FTL_FIRST_SECTOR             FLASH_SECTOR_0
+#endif /* MSC_FTL_FIRST_SECTOR */
+
+#ifndef MSC_FTL_SECTOR_NBR
+#define MSC_FTL_SECTOR_NBR               4U
+#endif /* MSC_FTL_SECTOR_NBR */
+
+/* Sectors kept out of the logical capacity so garbage collection always has room */
+#ifndef MSC_FTL_SPARE_SECTORS
+#define MSC_FTL_SPARE_SECTORS            2U
+#endif /* MSC_FTL_SPARE_SECTORS */
+
+/* Check the CRC32C of every block read, a mismatch fails the read */
+#ifndef MSC_FTL_VERIFY_READS
+#define MSC_FTL_VERIFY_READS             1U
+#endif /* MSC_FTL_VERIFY_READS */
+
+#define MSC_FTL_BANK                     FLASH_BANK_2
+#define MSC_FTL_SECTOR_SIZE              0x20000U
+#define MSC_FTL_WORD_SIZE                (FLASH_NB_32BITWORD_IN_FLASHWORD * 4U)
+#define MSC_FTL_BLK_SIZ                  512U
+
+/* A slot is one tag flash word followed by one logical block */
+#define MSC_FTL_SLOT_SIZE                (MSC_FTL_WORD_SIZE + MSC_FTL_BLK_SIZ)
+#define MSC_FTL_SLOTS_PER_SECTOR         ((MSC_FTL_SECTOR_SIZE - MSC_FTL_WORD_SIZE) / MSC_FTL_SLOT_SIZE)
+#define MSC_FTL_BLK_NBR                  ((MSC_FTL_SECTOR_NBR - MSC_FTL_SPARE_SECTORS) * MSC_FTL_SLOTS_PER_SECTOR)
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MSC_FTL_Exported_FunctionsPrototype USBD_MSC_FTL_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+int8_t MSC_FTL_Mount(void);
+int8_t MSC_FTL_Read(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+int8_t MSC_FTL_Write(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+void MSC_FTL_Process(void);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_FTL_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
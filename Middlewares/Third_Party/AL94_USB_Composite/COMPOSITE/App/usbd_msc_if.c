@@ -23,7 +23,10 @@
 #include "usbd_msc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
-
+#include "usbd_msc_ftl.h"
+#include "usbd_msc_vfat.h"
+#include "usbd_msc_cache.h"
+#include <string.h>
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -51,7 +54,15 @@ uint8_t MSC_Storage[32*1024];
   */
 
 /* USER CODE BEGIN PRIVATE_TYPES */
-
+/* One entry per LUN, each unit has its own backend and capacity */
+typedef struct
+{
+  int8_t (*Init)(void);
+  int8_t (*Read)(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+  int8_t (*Write)(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+  uint32_t blk_nbr;
+  uint8_t  read_only;
+} STORAGE_LunTypeDef;
 /* USER CODE END PRIVATE_TYPES */
 
 /**
@@ -63,12 +74,18 @@ uint8_t MSC_Storage[32*1024];
   * @{
   */
 
-#define STORAGE_LUN_NBR                  1
+#define STORAGE_LUN_NBR                  3
 #define STORAGE_BLK_NBR                  32*1024/512
 #define STORAGE_BLK_SIZ                  512
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
+#define STORAGE_LUN_FLASH                0U
+#define STORAGE_LUN_RAM                  1U
+#define STORAGE_LUN_VFAT                 2U
 
+#if ((MSC_MEDIA_PACKET / STORAGE_BLK_SIZ) > MSC_CACHE_LINES)
+#error "MSC_CACHE_LINES must hold a whole MSC_MEDIA_PACKET"
+#endif
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -107,13 +124,48 @@ const int8_t STORAGE_Inquirydata[] = {/* 36 */
   0x00,	
   0x00,
   'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
-  'P', 'r', 'o', 'd', 'u', 'c', 't', ' ', /* Product      : 16 Bytes */
+  'F', 'l', 'a', 's', 'h', ' ', 'd', 'i', /* Product      : 16 Bytes */
+  's', 'k', ' ', ' ', ' ', ' ', ' ', ' ',
+  '0', '.', '0' ,'1',                     /* Version      : 4 Bytes */
+
+  /* LUN 1 */
+  0x00,
+  0x80,
+  0x02,
+  0x02,
+  (STANDARD_INQUIRY_DATA_LEN - 5),
+  0x00,
+  0x00,
+  0x00,
+  'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+  'R', 'A', 'M', ' ', 'd', 'i', 's', 'k', /* Product      : 16 Bytes */
   ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+  '0', '.', '0' ,'1',                     /* Version      : 4 Bytes */
+
+  /* LUN 2 */
+  0x00,
+  0x80,
+  0x02,
+  0x02,
+  (STANDARD_INQUIRY_DATA_LEN - 5),
+  0x00,
+  0x00,
+  0x00,
+  'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+  'V', 'i', 'r', 't', 'u', 'a', 'l', ' ', /* Product      : 16 Bytes */
+  'F', 'A', 'T', ' ', ' ', ' ', ' ', ' ',
   '0', '.', '0' ,'1'                      /* Version      : 4 Bytes */
 }; 
 /* USER CODE END INQUIRY_DATA */
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+static const char STORAGE_Readme[] =
+  "Files on this drive are generated by the device when they are read.\r\n"
+  "AXISRAM.BIN is a live snapshot of the 512 KB AXI SRAM at 0x24000000.\r\n";
+static uint8_t STORAGE_VfatReady;
+
+/* Flash programming is slow: the flash LUN is written back from the main loop */
+static MSC_Cache_HandleTypeDef STORAGE_FlashCache;
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -150,6 +202,21 @@ static int8_t STORAGE_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16
 static int8_t STORAGE_GetMaxLun(void);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static int8_t STORAGE_FlashInit(void);
+static int8_t STORAGE_FlashRead(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_FlashWrite(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_RamRead(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_RamWrite(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t STORAGE_VfatInit(void);
+static int8_t STORAGE_ReadmeFile(uint32_t offset, uint8_t *buf, uint32_t len);
+static int8_t STORAGE_SramFile(uint32_t offset, uint8_t *buf, uint32_t len);
+
+static const STORAGE_LunTypeDef STORAGE_Lun[STORAGE_LUN_NBR] =
+{
+  { STORAGE_FlashInit, STORAGE_FlashRead, STORAGE_FlashWrite, MSC_FTL_BLK_NBR, 0U },
+  { NULL, STORAGE_RamRead, STORAGE_RamWrite, STORAGE_BLK_NBR, 0U },
+  { STORAGE_VfatInit, MSC_VFAT_Read, NULL, MSC_VFAT_BLK_NBR, 1U }
+};
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -178,6 +245,16 @@ USBD_StorageTypeDef USBD_Storage_Interface_fops =
 int8_t STORAGE_Init(uint8_t lun)
 {
   /* USER CODE BEGIN 2 */
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
+
+  if ((STORAGE_Lun[lun].Init != NULL) && (STORAGE_Lun[lun].Init() < 0))
+  {
+    return -1;
+  }
+
   return (USBD_OK);
   /* USER CODE END 2 */
 }
@@ -192,7 +269,12 @@ int8_t STORAGE_Init(uint8_t lun)
 int8_t STORAGE_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
 {
   /* USER CODE BEGIN 3 */
-  *block_num  = STORAGE_BLK_NBR;
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
+
+  *block_num  = STORAGE_Lun[lun].blk_nbr;
   *block_size = STORAGE_BLK_SIZ;
   return (USBD_OK);
   /* USER CODE END 3 */
@@ -206,6 +288,11 @@ int8_t STORAGE_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_siz
 int8_t STORAGE_IsReady(uint8_t lun)
 {
   /* USER CODE BEGIN 4 */
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
+
   return (USBD_OK);
   /* USER CODE END 4 */
 }
@@ -218,6 +305,11 @@ int8_t STORAGE_IsReady(uint8_t lun)
 int8_t STORAGE_IsWriteProtected(uint8_t lun)
 {
   /* USER CODE BEGIN 5 */
+  if ((lun >= STORAGE_LUN_NBR) || (STORAGE_Lun[lun].read_only != 0U))
+  {
+    return (USBD_FAIL);
+  }
+
   return (USBD_OK);
   /* USER CODE END 5 */
 }
@@ -230,16 +322,12 @@ int8_t STORAGE_IsWriteProtected(uint8_t lun)
 int8_t STORAGE_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
 {
   /* USER CODE BEGIN 6 */
+  if (lun >= STORAGE_LUN_NBR)
+  {
+    return -1;
+  }
 
-  uint32_t bytecount = blk_len*STORAGE_BLK_SIZ;
-  uint32_t mem_address = blk_addr*STORAGE_BLK_SIZ;
-
-  for(uint32_t i=0; i<bytecount; i++)
-      {
-	  buf[i] = MSC_Storage[mem_address+i];
-      }
-
-  return (USBD_OK);
+  return (STORAGE_Lun[lun].Read(buf, blk_addr, blk_len) < 0) ? -1 : USBD_OK;
   /* USER CODE END 6 */
 }
 
@@ -251,16 +339,13 @@ int8_t STORAGE_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_l
 int8_t STORAGE_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
 {
   /* USER CODE BEGIN 7 */
+  if ((lun >= STORAGE_LUN_NBR) || (STORAGE_Lun[lun].Write == NULL))
+  {
+    return -1;
+  }
 
-   uint32_t bytecount = blk_len*STORAGE_BLK_SIZ;
-   uint32_t mem_address = blk_addr*STORAGE_BLK_SIZ;
-
-    for(uint32_t i=0; i<bytecount; i++)
-    {
-	MSC_Storage[mem_address+i] = buf[i];
-    }
-
-  return (USBD_OK);
+  /* USBD_BUSY is passed up: the class retries from MSC_Storage_Process() */
+  return STORAGE_Lun[lun].Write(buf, blk_addr, blk_len);
   /* USER CODE END 7 */
 }
 
@@ -277,6 +362,159 @@ int8_t STORAGE_GetMaxLun(void)
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  Background storage work, to be polled from the main loop
+  * @note   Writes one cached block back to flash, advances the FTL and
+  *         restarts a host write that was held back for lack of cache room
+  *         or a busy backend. Flash work runs with interrupts enabled.
+  * @param  None
+  * @retval None
+  */
+void MSC_Storage_Process(void)
+{
+  uint32_t primask;
+
+  (void)MSC_Cache_Flush(&STORAGE_FlashCache);
+
+  /* Erase and compaction every pass, so that sustained writes do not leave
+     all of it to the foreground */
+  MSC_FTL_Process();
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  (void)USBD_MSC_Resume(&hUsbDevice);
+
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Flash LUN mount, once per power cycle
+  * @param  None
+  * @retval 0 if the FTL is mounted, -1 otherwise
+  */
+static int8_t STORAGE_FlashInit(void)
+{
+  if (STORAGE_FlashCache.read == NULL)
+  {
+    MSC_Cache_Init(&STORAGE_FlashCache, MSC_FTL_Read, MSC_FTL_Write);
+  }
+
+  return MSC_FTL_Mount();
+}
+
+/**
+  * @brief  Flash LUN read, through the write-back cache
+  * @param  buf: destination buffer
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t STORAGE_FlashRead(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  if ((blk_addr + blk_len) > MSC_FTL_BLK_NBR)
+  {
+    return -1;
+  }
+
+  return MSC_Cache_Read(&STORAGE_FlashCache, buf, blk_addr, blk_len);
+}
+
+/**
+  * @brief  Flash LUN write, queued in the write-back cache
+  * @param  buf: source buffer
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 0 if queued, USBD_BUSY if the cache is full, -1 otherwise
+  */
+static int8_t STORAGE_FlashWrite(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  if ((blk_addr + blk_len) > MSC_FTL_BLK_NBR)
+  {
+    return -1;
+  }
+
+  return MSC_Cache_Write(&STORAGE_FlashCache, buf, blk_addr, blk_len);
+}
+
+/**
+  * @brief  RAM LUN read
+  * @param  buf: destination buffer
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t STORAGE_RamRead(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  if ((blk_addr + blk_len) > STORAGE_BLK_NBR)
+  {
+    return -1;
+  }
+
+  (void)memcpy(buf, &MSC_Storage[blk_addr * STORAGE_BLK_SIZ], (uint32_t)blk_len * STORAGE_BLK_SIZ);
+  return 0;
+}
+
+/**
+  * @brief  RAM LUN write
+  * @param  buf: source buffer
+  * @param  blk_addr: first block
+  * @param  blk_len: number of blocks
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t STORAGE_RamWrite(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  if ((blk_addr + blk_len) > STORAGE_BLK_NBR)
+  {
+    return -1;
+  }
+
+  (void)memcpy(&MSC_Storage[blk_addr * STORAGE_BLK_SIZ], buf, (uint32_t)blk_len * STORAGE_BLK_SIZ);
+  return 0;
+}
+
+/**
+  * @brief  Virtual FAT LUN file registration, once per power cycle
+  * @param  None
+  * @retval 0
+  */
+static int8_t STORAGE_VfatInit(void)
+{
+  if (STORAGE_VfatReady == 0U)
+  {
+    STORAGE_VfatReady = 1U;
+    (void)MSC_VFAT_AddFile("README.TXT", sizeof(STORAGE_Readme) - 1U, STORAGE_ReadmeFile);
+    (void)MSC_VFAT_AddFile("AXISRAM.BIN", 512U * 1024U, STORAGE_SramFile);
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  README.TXT producer
+  * @param  offset: file offset
+  * @param  buf: destination
+  * @param  len: bytes to produce
+  * @retval USBD_OK
+  */
+static int8_t STORAGE_ReadmeFile(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+  (void)memcpy(buf, &STORAGE_Readme[offset], len);
+  return (USBD_OK);
+}
+
+/**
+  * @brief  AXISRAM.BIN producer, copies the memory straight into the USB buffer
+  * @param  offset: file offset
+  * @param  buf: destination
+  * @param  len: bytes to produce
+  * @retval USBD_OK
+  */
+static int8_t STORAGE_SramFile(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+  (void)memcpy(buf, (const uint8_t *)(D1_AXISRAM_BASE + offset), len);
+  return (USBD_OK);
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
@@ -105,7 +105,7 @@ extern USBD_StorageTypeDef USBD_Storage_Interface_fops;
   */
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
-
+void MSC_Storage_Process(void);
 /* USER CODE END EXPORTED_FUNCTIONS */
 
 /**
@@ -0,0 +1,375 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_vfat.c
+  * @brief          : Virtual FAT16 volume for the MSC storage interface.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Volume layout
+  *          ===================================================================
+  *           Nothing of the volume is stored. Every sector the host reads is
+  *           computed from the file table: the boot sector from constants,
+  *           FAT and root directory sectors from the file sizes, and data
+  *           sectors by calling the file's producer straight into the USB
+  *           buffer. Files are laid out as contiguous cluster runs in the
+  *           order they were added, so the FAT entry of a cluster is simply
+  *           the next cluster or end of chain.
+  *
+  *           The volume is read-only and the file set is fixed once the host
+  *           has mounted it: add files before the device is connected.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_vfat.h"
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint8_t name[11];
+  uint32_t size;
+  uint16_t first_cluster;
+  uint16_t cluster_nbr;
+  MSC_VFAT_ReadTypeDef read;
+} VFAT_FileTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define VFAT_CLUSTER_SIZE                (MSC_VFAT_CLUSTER_SECTORS * MSC_VFAT_BLK_SIZ)
+#define VFAT_VOLUME_LABEL                "STM32 VFAT "
+#define VFAT_VOLUME_ID                   0x20200101U
+
+/* 2020-01-01 00:00:00 */
+#define VFAT_DATE                        ((uint16_t)(((2020U - 1980U) << 9) | (1U << 5) | 1U))
+#define VFAT_TIME                        0x0000U
+
+#define VFAT_ATTR_READ_ONLY              0x01U
+#define VFAT_ATTR_VOLUME_ID              0x08U
+#define VFAT_ATTR_ARCHIVE                0x20U
+
+/* Private macro -------------------------------------------------------------*/
+#define VFAT_PUT16(p, v)                 do { (p)[0] = (uint8_t)(v); (p)[1] = (uint8_t)((v) >> 8); } while (0)
+#define VFAT_PUT32(p, v)                 do { VFAT_PUT16((p), (v)); VFAT_PUT16((p) + 2, (v) >> 16); } while (0)
+
+/* Private variables ---------------------------------------------------------*/
+static VFAT_FileTypeDef VFAT_File[MSC_VFAT_MAX_FILES];
+static uint8_t VFAT_FileNbr;
+static uint16_t VFAT_NextCluster = 2U;
+
+/* Private function prototypes -----------------------------------------------*/
+static void VFAT_BootSector(uint8_t *buf);
+static void VFAT_FatSector(uint8_t *buf, uint32_t sector);
+static void VFAT_RootSector(uint8_t *buf, uint32_t sector);
+static int8_t VFAT_DataSector(uint8_t *buf, uint32_t sector);
+static void VFAT_DirEntry(uint8_t *entry, const uint8_t *name, uint8_t attr,
+                          uint16_t cluster, uint32_t size);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Add a file to the volume
+  * @param  name: 8.3 file name, e.g. "TRACE.BIN"
+  * @param  size: file size in bytes
+  * @param  read: producer called for each data sector read by the host
+  * @retval 0 if the file was added, -1 if the table or the volume is full
+  */
+int8_t MSC_VFAT_AddFile(const char *name, uint32_t size, MSC_VFAT_ReadTypeDef read)
+{
+  VFAT_FileTypeDef *file;
+  uint32_t clusters = (size + VFAT_CLUSTER_SIZE - 1U) / VFAT_CLUSTER_SIZE;
+  uint8_t i = 0U;
+  uint8_t c;
+
+  if ((VFAT_FileNbr == MSC_VFAT_MAX_FILES) || (read == NULL) ||
+      ((VFAT_NextCluster + clusters) > (MSC_VFAT_CLUSTER_NBR + 2U)))
+  {
+    return -1;
+  }
+
+  file = &VFAT_File[VFAT_FileNbr];
+  (void)memset(file->name, ' ', sizeof(file->name));
+
+  /* Upper-cased base name, padded to 8, then the extension */
+  while ((*name != '\0') && (*name != '.') && (i < 8U))
+  {
+    c = (uint8_t)*name++;
+    file->name[i++] = ((c >= (uint8_t)'a') && (c <= (uint8_t)'z')) ? (c - 0x20U) : c;
+  }
+
+  while ((*name != '\0') && (*name != '.'))
+  {
+    name++;
+  }
+
+  if (*name == '.')
+  {
+    name++;
+    for (i = 8U; (i < 11U) && (*name != '\0'); i++)
+    {
+      c = (uint8_t)*name++;
+      file->name[i] = ((c >= (uint8_t)'a') && (c <= (uint8_t)'z')) ? (c - 0x20U) : c;
+    }
+  }
+
+  file->size = size;
+  file->read = read;
+  file->cluster_nbr = (uint16_t)clusters;
+  file->first_cluster = (clusters != 0U) ? VFAT_NextCluster : 0U;
+
+  VFAT_NextCluster += (uint16_t)clusters;
+  VFAT_FileNbr++;
+
+  return 0;
+}
+
+/**
+  * @brief  Generate volume sectors
+  * @param  buf: destination buffer
+  * @param  blk_addr: first sector
+  * @param  blk_len: number of sectors
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+int8_t MSC_VFAT_Read(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  uint32_t sector;
+
+  if ((blk_addr + blk_len) > MSC_VFAT_BLK_NBR)
+  {
+    return -1;
+  }
+
+  for (sector = blk_addr; sector < (blk_addr + blk_len); sector++)
+  {
+    if (sector >= MSC_VFAT_DATA_START)
+    {
+      if (VFAT_DataSector(buf, sector - MSC_VFAT_DATA_START) != 0)
+      {
+        return -1;
+      }
+    }
+    else if (sector >= MSC_VFAT_ROOT_START)
+    {
+      VFAT_RootSector(buf, sector - MSC_VFAT_ROOT_START);
+    }
+    else if (sector >= MSC_VFAT_FAT_START)
+    {
+      /* Every FAT copy is identical */
+      VFAT_FatSector(buf, (sector - MSC_VFAT_FAT_START) % MSC_VFAT_FAT_SECTORS);
+    }
+    else
+    {
+      VFAT_BootSector(buf);
+    }
+
+    buf += MSC_VFAT_BLK_SIZ;
+  }
+
+  return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Boot sector with the FAT16 BIOS parameter block
+  * @param  buf: sector buffer
+  * @retval None
+  */
+static void VFAT_BootSector(uint8_t *buf)
+{
+  (void)memset(buf, 0, MSC_VFAT_BLK_SIZ);
+
+  buf[0] = 0xEBU;
+  buf[1] = 0x3CU;
+  buf[2] = 0x90U;
+  (void)memcpy(&buf[3], "MSDOS5.0", 8U);
+  VFAT_PUT16(&buf[11], MSC_VFAT_BLK_SIZ);
+  buf[13] = MSC_VFAT_CLUSTER_SECTORS;
+  VFAT_PUT16(&buf[14], MSC_VFAT_FAT_START);
+  buf[16] = MSC_VFAT_FAT_NBR;
+  VFAT_PUT16(&buf[17], MSC_VFAT_ROOT_ENTRIES);
+
+  if (MSC_VFAT_BLK_NBR < 0x10000U)
+  {
+    VFAT_PUT16(&buf[19], MSC_VFAT_BLK_NBR);
+  }
+  else
+  {
+    VFAT_PUT32(&buf[32], MSC_VFAT_BLK_NBR);
+  }
+
+  buf[21] = 0xF8U;                      /* Fixed media */
+  VFAT_PUT16(&buf[22], MSC_VFAT_FAT_SECTORS);
+  VFAT_PUT16(&buf[24], 63U);            /* Sectors per track */
+  VFAT_PUT16(&buf[26], 255U);           /* Heads */
+  buf[36] = 0x80U;                      /* Drive number */
+  buf[38] = 0x29U;                      /* Extended boot signature */
+  VFAT_PUT32(&buf[39], VFAT_VOLUME_ID);
+  (void)memcpy(&buf[43], VFAT_VOLUME_LABEL, 11U);
+  (void)memcpy(&buf[54], "FAT16   ", 8U);
+  buf[510] = 0x55U;
+  buf[511] = 0xAAU;
+}
+
+/**
+  * @brief  FAT sector: every file is one contiguous chain
+  * @param  buf: sector buffer
+  * @param  sector: sector index inside the FAT
+  * @retval None
+  */
+static void VFAT_FatSector(uint8_t *buf, uint32_t sector)
+{
+  uint32_t cluster = sector * (MSC_VFAT_BLK_SIZ / 2U);
+  uint32_t last;
+  uint16_t entry;
+  uint16_t i;
+  uint8_t f = 0U;
+
+  for (i = 0U; i < (MSC_VFAT_BLK_SIZ / 2U); i++, cluster++)
+  {
+    entry = 0x0000U;
+
+    if (cluster == 0U)
+    {
+      entry = 0xFFF8U;                  /* Media descriptor */
+    }
+    else if (cluster == 1U)
+    {
+      entry = 0xFFFFU;
+    }
+    else
+    {
+      /* Clusters only grow along the sector, so does the file index */
+      while ((f < VFAT_FileNbr) &&
+             (cluster >= ((uint32_t)VFAT_File[f].first_cluster + VFAT_File[f].cluster_nbr)))
+      {
+        f++;
+      }
+
+      if ((f < VFAT_FileNbr) && (VFAT_File[f].cluster_nbr != 0U) &&
+          (cluster >= VFAT_File[f].first_cluster))
+      {
+        last = (uint32_t)VFAT_File[f].first_cluster + VFAT_File[f].cluster_nbr - 1U;
+        entry = (cluster == last) ? 0xFFFFU : (uint16_t)(cluster + 1U);
+      }
+    }
+
+    VFAT_PUT16(&buf[2U * i], entry);
+  }
+}
+
+/**
+  * @brief  Root directory sector: volume label then one entry per file
+  * @param  buf: sector buffer
+  * @param  sector: sector index inside the root directory
+  * @retval None
+  */
+static void VFAT_RootSector(uint8_t *buf, uint32_t sector)
+{
+  uint32_t index = sector * (MSC_VFAT_BLK_SIZ / 32U);
+  uint16_t i;
+
+  (void)memset(buf, 0, MSC_VFAT_BLK_SIZ);
+
+  for (i = 0U; i < (MSC_VFAT_BLK_SIZ / 32U); i++, index++)
+  {
+    if (index == 0U)
+    {
+      VFAT_DirEntry(&buf[32U * i], (const uint8_t *)VFAT_VOLUME_LABEL, VFAT_ATTR_VOLUME_ID, 0U, 0U);
+    }
+    else if (index <= VFAT_FileNbr)
+    {
+      VFAT_DirEntry(&buf[32U * i], VFAT_File[index - 1U].name,
+                    VFAT_ATTR_READ_ONLY | VFAT_ATTR_ARCHIVE,
+                    VFAT_File[index - 1U].first_cluster, VFAT_File[index - 1U].size);
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+/**
+  * @brief  Data sector: streamed from the producer of the owning file
+  * @param  buf: sector buffer
+  * @param  sector: sector index inside the data area
+  * @retval 0 if all operations are OK, -1 otherwise
+  */
+static int8_t VFAT_DataSector(uint8_t *buf, uint32_t sector)
+{
+  uint32_t cluster = (sector / MSC_VFAT_CLUSTER_SECTORS) + 2U;
+  uint32_t offset;
+  uint32_t len = 0U;
+  uint8_t f;
+
+  for (f = 0U; f < VFAT_FileNbr; f++)
+  {
+    if ((cluster >= VFAT_File[f].first_cluster) &&
+        (cluster < ((uint32_t)VFAT_File[f].first_cluster + VFAT_File[f].cluster_nbr)))
+    {
+      break;
+    }
+  }
+
+  if (f < VFAT_FileNbr)
+  {
+    offset = ((cluster - VFAT_File[f].first_cluster) * VFAT_CLUSTER_SIZE) +
+             ((sector % MSC_VFAT_CLUSTER_SECTORS) * MSC_VFAT_BLK_SIZ);
+
+    if (offset < VFAT_File[f].size)
+    {
+      len = VFAT_File[f].size - offset;
+      len = (len > MSC_VFAT_BLK_SIZ) ? MSC_VFAT_BLK_SIZ : len;
+
+      if (VFAT_File[f].read(offset, buf, len) != 0)
+      {
+        return -1;
+      }
+    }
+  }
+
+  /* Slack after the end of file, or unallocated cluster */
+  (void)memset(&buf[len], 0, MSC_VFAT_BLK_SIZ - len);
+
+  return 0;
+}
+
+/**
+  * @brief  Fill a 32-byte short name directory entry
+  * @param  entry: entry buffer, already zeroed
+  * @param  name: 11-character padded name
+  * @param  attr: attributes
+  * @param  cluster: first cluster
+  * @param  size: file size
+  * @retval None
+  */
+static void VFAT_DirEntry(uint8_t *entry, const uint8_t *name, uint8_t attr,
+                          uint16_t cluster, uint32_t size)
+{
+  (void)memcpy(entry, name, 11U);
+  entry[11] = attr;
+  VFAT_PUT16(&entry[14], VFAT_TIME);
+  VFAT_PUT16(&entry[16], VFAT_DATE);
+  VFAT_PUT16(&entry[18], VFAT_DATE);
+  VFAT_PUT16(&entry[22], VFAT_TIME);
+  VFAT_PUT16(&entry[24], VFAT_DATE);
+  VFAT_PUT16(&entry[26], cluster);
+  VFAT_PUT32(&entry[28], size);
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
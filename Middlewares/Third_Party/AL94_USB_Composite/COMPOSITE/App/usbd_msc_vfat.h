@@ -0,0 +1,111 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_msc_vfat.h
+  * @brief          : Header for usbd_msc_vfat.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_VFAT_H__
+#define __USBD_MSC_VFAT_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_MSC_VFAT USBD_MSC_VFAT
+  * @brief Read-only FAT16 volume generated from producer callbacks
+  * @{
+  */
+
+/** @defgroup USBD_MSC_VFAT_Exported_Defines USBD_MSC_VFAT_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+#ifndef MSC_VFAT_MAX_FILES
+#define MSC_VFAT_MAX_FILES               8U
+#endif /* MSC_VFAT_MAX_FILES */
+
+/* 8 sectors per cluster and 16384 clusters: a 64 MB volume, safely FAT16 */
+#ifndef MSC_VFAT_CLUSTER_SECTORS
+#define MSC_VFAT_CLUSTER_SECTORS         8U
+#endif /* MSC_VFAT_CLUSTER_SECTORS */
+
+#ifndef MSC_VFAT_CLUSTER_NBR
+#define MSC_VFAT_CLUSTER_NBR             16384U
+#endif /* MSC_VFAT_CLUSTER_NBR */
+
+#define MSC_VFAT_BLK_SIZ                 512U
+#define MSC_VFAT_ROOT_ENTRIES            512U
+#define MSC_VFAT_FAT_NBR                 2U
+
+#define MSC_VFAT_FAT_SECTORS             ((((MSC_VFAT_CLUSTER_NBR + 2U) * 2U) + MSC_VFAT_BLK_SIZ - 1U) / MSC_VFAT_BLK_SIZ)
+#define MSC_VFAT_ROOT_SECTORS            ((MSC_VFAT_ROOT_ENTRIES * 32U) / MSC_VFAT_BLK_SIZ)
+#define MSC_VFAT_FAT_START               1U
+#define MSC_VFAT_ROOT_START              (MSC_VFAT_FAT_START + (MSC_VFAT_FAT_NBR * MSC_VFAT_FAT_SECTORS))
+#define MSC_VFAT_DATA_START              (MSC_VFAT_ROOT_START + MSC_VFAT_ROOT_SECTORS)
+#define MSC_VFAT_BLK_NBR                 (MSC_VFAT_DATA_START + (MSC_VFAT_CLUSTER_NBR * MSC_VFAT_CLUSTER_SECTORS))
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MSC_VFAT_Exported_Types USBD_MSC_VFAT_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+/* Fill buf with len bytes of the file starting at offset, return 0 on success */
+typedef int8_t (*MSC_VFAT_ReadTypeDef)(uint32_t offset, uint8_t *buf, uint32_t len);
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_MSC_VFAT_Exported_FunctionsPrototype USBD_MSC_VFAT_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+int8_t MSC_VFAT_AddFile(const char *name, uint32_t size, MSC_VFAT_ReadTypeDef read);
+int8_t MSC_VFAT_Read(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_VFAT_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,516 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_netif.c
+  * @brief          : lwIP network interface for the CDC RNDIS and ECM classes.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           Receive: the OUT endpoint fills one buffer of a small pool. The
+  *           frames found in it are queued from the USB interrupt without a
+  *           copy; USBD_Netif_Process(), polled from the main loop, wraps each
+  *           one in a PBUF_REF custom pbuf pointing into the buffer and hands
+  *           it to lwIP. A buffer returns to the pool once lwIP freed every
+  *           frame it holds, and the endpoint is armed again on the first
+  *           free buffer, so reception goes on while lwIP works on earlier
+  *           frames. A class with its own frame ring (ECM) leaves rx_pool
+  *           NULL: its frames are lent the same way and handed back through
+  *           ReleaseRxBuffer.
+  *
+  *           Transmit: linkoutput queues the pbuf in a ring of descriptors and
+  *           the IN endpoint walks the ring from its completion interrupt,
+  *           passing the class as many frames as it accepts at once. A
+  *           single pbuf is sent in place, the class header (RNDIS
+  *           PACKET_MSG) going into the pbuf headroom; set
+  *           PBUF_LINK_ENCAPSULATION_HLEN to at least that header size. A
+  *           chain, or a pbuf without the headroom, is flattened into one
+  *           PBUF_RAM pbuf since a USB transfer needs contiguous memory.
+  *
+  *           lwIP runs with NO_SYS from the main loop, its timers are driven
+  *           from USBD_Netif_Process() too.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_netif.h"
+#include "usbd_csum.h"
+#include "usbd_iperf.h"
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+
+#include "lwip/init.h"
+#include "lwip/etharp.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+#include <string.h>
+
+#if (NO_SYS == 0)
+#error "usbd_netif is polled from the main loop and expects NO_SYS set to 1"
+#endif
+
+#if (ETH_PAD_SIZE != 0)
+#error "usbd_netif lends the USB buffers as they are, ETH_PAD_SIZE must be 0"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static uint8_t USBD_Netif_StackReady = 0U;
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+USBD_Iperf_HandleTypeDef USBD_Netif_Iperf;
+#endif /* USBD_IPERF_USE_SERVER */
+
+/* Private function prototypes -----------------------------------------------*/
+static err_t Netif_Init(struct netif *netif);
+static err_t Netif_LinkOutput(struct netif *netif, struct pbuf *p);
+static void Netif_RxFree(struct pbuf *p);
+static void Netif_RxRefill(USBD_Netif_HandleTypeDef *hnet);
+static void Netif_TxKick(USBD_Netif_HandleTypeDef *hnet);
+static void Netif_TxReclaim(USBD_Netif_HandleTypeDef *hnet);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Bind the driver to a class instance and pick the first OUT buffer,
+  *         called from the interface Init callback before the class arms the
+  *         OUT endpoint
+  * @param  hnet: driver instance
+  * @param  pdev: device instance
+  * @param  conf: class entry points, buffer pool and addresses
+  * @retval None
+  */
+void USBD_Netif_Start(USBD_Netif_HandleTypeDef *hnet, USBD_HandleTypeDef *pdev,
+                      const USBD_Netif_ConfTypeDef *conf)
+{
+  uint32_t i;
+
+  hnet->pdev = pdev;
+  hnet->conf = conf;
+
+  /* Whatever was on the bus is gone, lwIP may still hold received frames */
+  hnet->tx_busy = 0U;
+  hnet->rx_armed = USBD_NETIF_RX_IDLE;
+
+  for (i = 0U; (conf->rx_pool != NULL) && (i < USBD_NETIF_RX_BUFFERS); i++)
+  {
+    if (hnet->rx_refs[i] == 0U)
+    {
+      hnet->rx_armed = i;
+      (void)conf->SetRxBuffer(pdev, &conf->rx_pool[i * conf->rx_size], conf->rx_size);
+      break;
+    }
+  }
+}
+
+/**
+  * @brief  Queue one received frame for lwIP, called from the interface
+  *         Receive callback in the USB interrupt
+  * @param  hnet: driver instance
+  * @param  buf: Ethernet frame inside the armed OUT buffer
+  * @param  len: frame length
+  * @retval USBD_OK when lwIP got the frame, USBD_FAIL when it was dropped
+  */
+uint8_t USBD_Netif_Input(USBD_Netif_HandleTypeDef *hnet, uint8_t *buf, uint32_t len)
+{
+  USBD_Netif_RxFrameTypeDef *frame = NULL;
+  uint32_t i;
+
+  /* The OUT endpoint stays NAKing until Netif_RxRefill() arms a free buffer */
+  if (hnet->rx_armed != USBD_NETIF_RX_IDLE)
+  {
+    hnet->rx_filled = hnet->rx_armed;
+    hnet->rx_armed = USBD_NETIF_RX_IDLE;
+  }
+
+  for (i = 0U; i < USBD_NETIF_RX_FRAMES; i++)
+  {
+    if (hnet->rx_frame[i].busy == 0U)
+    {
+      frame = &hnet->rx_frame[i];
+      break;
+    }
+  }
+
+  if ((frame == NULL) || (len == 0U) || (len > 0xFFFFU))
+  {
+    hnet->rx_drops++;
+    return (uint8_t)USBD_FAIL;
+  }
+
+  frame->busy = 1U;
+  frame->hnet = hnet;
+  frame->payload = buf;
+  frame->len = (uint16_t)len;
+  frame->buf = (uint8_t)hnet->rx_filled;
+
+  if (hnet->conf->rx_pool != NULL)
+  {
+    hnet->rx_refs[hnet->rx_filled]++;
+  }
+
+  hnet->rx_queue[hnet->rx_head % USBD_NETIF_RX_FRAMES] = (uint8_t)i;
+  hnet->rx_head++;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  IN transfer completion, called from the interface TransmitCplt
+  *         callback in the USB interrupt; starts the next queued frame
+  * @param  hnet: driver instance
+  * @param  buf: buffer the class just sent
+  * @retval None
+  */
+void USBD_Netif_TransmitCplt(USBD_Netif_HandleTypeDef *hnet, uint8_t *buf)
+{
+  /* Classes complete their transfers in order, this is the oldest one */
+  if ((hnet->tx_busy != 0U) &&
+      (buf == hnet->tx_frame[(hnet->tx_next - hnet->tx_busy) % USBD_NETIF_TX_FRAMES].data))
+  {
+    hnet->tx_busy--;
+    Netif_TxKick(hnet);
+  }
+}
+
+/**
+  * @brief  Main loop work: registers the interface on first call, follows the
+  *         link state, feeds lwIP with the queued frames, gives sent pbufs
+  *         back and runs the lwIP timers
+  * @param  hnet: driver instance
+  * @param  link_up: class link status
+  * @retval None
+  */
+void USBD_Netif_Process(USBD_Netif_HandleTypeDef *hnet, uint32_t link_up)
+{
+  USBD_Netif_RxFrameTypeDef *frame;
+  struct pbuf *p;
+  ip4_addr_t ipaddr;
+  ip4_addr_t netmask;
+  ip4_addr_t gw;
+  uint32_t primask;
+
+  if (hnet->conf == NULL)
+  {
+    return;
+  }
+
+  if (hnet->added == 0U)
+  {
+    if (USBD_Netif_StackReady == 0U)
+    {
+      lwip_init();
+      USBD_Netif_StackReady = 1U;
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+      /* Listens on every interface added from here on */
+      USBD_Iperf_Init(&USBD_Netif_Iperf, NULL);
+#endif /* USBD_IPERF_USE_SERVER */
+    }
+
+    ip4_addr_set_u32(&ipaddr, lwip_htonl(hnet->conf->ipaddr));
+    ip4_addr_set_u32(&netmask, lwip_htonl(hnet->conf->netmask));
+    ip4_addr_set_u32(&gw, lwip_htonl(hnet->conf->gw));
+
+    if (netif_add(&hnet->netif, &ipaddr, &netmask, &gw, hnet, Netif_Init, netif_input) == NULL)
+    {
+      return;
+    }
+
+    if (netif_default == NULL)
+    {
+      netif_set_default(&hnet->netif);
+    }
+    netif_set_up(&hnet->netif);
+    hnet->added = 1U;
+  }
+
+  if ((link_up != 0U) && !netif_is_link_up(&hnet->netif))
+  {
+    netif_set_link_up(&hnet->netif);
+  }
+  else if ((link_up == 0U) && netif_is_link_up(&hnet->netif))
+  {
+    netif_set_link_down(&hnet->netif);
+  }
+  else
+  {
+    /* No change */
+  }
+
+  while (hnet->rx_tail != hnet->rx_head)
+  {
+    frame = &hnet->rx_frame[hnet->rx_queue[hnet->rx_tail % USBD_NETIF_RX_FRAMES]];
+    hnet->rx_tail++;
+
+    frame->pc.custom_free_function = Netif_RxFree;
+    p = pbuf_alloced_custom(PBUF_RAW, frame->len, PBUF_REF, &frame->pc,
+                            frame->payload, frame->len);
+
+    if (p == NULL)
+    {
+      hnet->rx_drops++;
+      Netif_RxFree((struct pbuf *)(void *)&frame->pc);
+    }
+    else if (hnet->netif.input(p, &hnet->netif) != ERR_OK)
+    {
+      hnet->rx_drops++;
+      (void)pbuf_free(p);
+    }
+    else
+    {
+      /* lwIP owns the frame until it frees the pbuf */
+    }
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  Netif_RxRefill(hnet);
+  Netif_TxKick(hnet);
+  __set_PRIMASK(primask);
+
+  Netif_TxReclaim(hnet);
+
+  sys_check_timeouts();
+
+#if (USBD_IPERF_USE_SERVER == 1U)
+  USBD_Iperf_Process(&USBD_Netif_Iperf);
+#endif /* USBD_IPERF_USE_SERVER */
+}
+
+/**
+  * @brief  Internet checksum for lwIP, see LWIP_CHKSUM in usbd_netif.h
+  * @param  dataptr: bytes to sum
+  * @param  len: byte count
+  * @retval folded sum in network byte order, not complemented
+  */
+u16_t USBD_Netif_Chksum(const void *dataptr, int len)
+{
+  return lwip_htons(USBD_Csum_Fold(USBD_Csum_Add((const uint8_t *)dataptr, (uint32_t)len, 0U)));
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  netif_add() callback
+  * @param  netif: lwIP interface, its state is the driver instance
+  * @retval ERR_OK
+  */
+static err_t Netif_Init(struct netif *netif)
+{
+  USBD_Netif_HandleTypeDef *hnet = (USBD_Netif_HandleTypeDef *)netif->state;
+
+  netif->name[0] = hnet->conf->name[0];
+  netif->name[1] = hnet->conf->name[1];
+  netif->output = etharp_output;
+  netif->linkoutput = Netif_LinkOutput;
+  netif->mtu = USBD_NETIF_MTU;
+  netif->hwaddr_len = ETH_HWADDR_LEN;
+  (void)memcpy(netif->hwaddr, hnet->conf->hwaddr, ETH_HWADDR_LEN);
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  lwIP linkoutput, queues the frame for the IN endpoint
+  * @param  netif: lwIP interface
+  * @param  p: frame, referenced or copied, lwIP keeps its own reference
+  * @retval ERR_OK, ERR_MEM when the ring or the pbuf pool is exhausted
+  */
+static err_t Netif_LinkOutput(struct netif *netif, struct pbuf *p)
+{
+  USBD_Netif_HandleTypeDef *hnet = (USBD_Netif_HandleTypeDef *)netif->state;
+  USBD_Netif_TxFrameTypeDef *frame;
+  uint16_t header = hnet->conf->tx_header;
+  struct pbuf *q;
+  uint32_t primask;
+
+  Netif_TxReclaim(hnet);
+
+  if ((hnet->tx_head - hnet->tx_free) >= USBD_NETIF_TX_FRAMES)
+  {
+    hnet->tx_drops++;
+    return ERR_MEM;
+  }
+
+  frame = &hnet->tx_frame[hnet->tx_head % USBD_NETIF_TX_FRAMES];
+
+  if ((p->next == NULL) && (pbuf_add_header(p, header) == 0U))
+  {
+    /* Sent in place, the class writes its header into the headroom */
+    pbuf_ref(p);
+    frame->p = p;
+    frame->header = header;
+  }
+  else
+  {
+    q = pbuf_alloc(PBUF_RAW, (u16_t)(p->tot_len + header), PBUF_RAM);
+    if (q == NULL)
+    {
+      hnet->tx_drops++;
+      return ERR_MEM;
+    }
+
+    (void)pbuf_copy_partial(p, (uint8_t *)q->payload + header, p->tot_len, 0U);
+    frame->p = q;
+    frame->header = 0U;
+  }
+
+  frame->data = (uint8_t *)frame->p->payload;
+  frame->len = frame->p->len;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  hnet->tx_head++;
+  Netif_TxKick(hnet);
+  __set_PRIMASK(primask);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  Custom pbuf free function of the received frames, the buffer goes
+  *         back to the pool with its last frame
+  * @param  p: pbuf embedded in a USBD_Netif_RxFrameTypeDef
+  * @retval None
+  */
+static void Netif_RxFree(struct pbuf *p)
+{
+  USBD_Netif_RxFrameTypeDef *frame = (USBD_Netif_RxFrameTypeDef *)(void *)p;
+  USBD_Netif_HandleTypeDef *hnet = (USBD_Netif_HandleTypeDef *)frame->hnet;
+  uint32_t primask;
+
+  if (hnet->conf->rx_pool == NULL)
+  {
+    /* The class owns the buffer, it resumes reception itself */
+    (void)hnet->conf->ReleaseRxBuffer(hnet->pdev, frame->payload);
+    frame->busy = 0U;
+    return;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  hnet->rx_refs[frame->buf]--;
+  frame->busy = 0U;
+
+  /* Resume reception right away if the endpoint ran out of buffers */
+  Netif_RxRefill(hnet);
+
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Arm the OUT endpoint on a free buffer if it is idle, called with
+  *         interrupts masked
+  * @param  hnet: driver instance
+  * @retval None
+  */
+static void Netif_RxRefill(USBD_Netif_HandleTypeDef *hnet)
+{
+  uint32_t i;
+
+  if ((hnet->rx_armed != USBD_NETIF_RX_IDLE) || (hnet->pdev == NULL) ||
+      (hnet->conf->rx_pool == NULL))
+  {
+    return;
+  }
+
+  for (i = 0U; i < USBD_NETIF_RX_BUFFERS; i++)
+  {
+    if (hnet->rx_refs[i] == 0U)
+    {
+      hnet->rx_armed = i;
+      (void)hnet->conf->SetRxBuffer(hnet->pdev, &hnet->conf->rx_pool[i * hnet->conf->rx_size],
+                                    hnet->conf->rx_size);
+      (void)hnet->conf->ReceivePacket(hnet->pdev);
+      break;
+    }
+  }
+}
+
+/**
+  * @brief  Hand the queued frames to the class for as long as it takes them,
+  *         called with interrupts masked
+  * @param  hnet: driver instance
+  * @retval None
+  */
+static void Netif_TxKick(USBD_Netif_HandleTypeDef *hnet)
+{
+  USBD_Netif_TxFrameTypeDef *frame;
+
+  if (hnet->pdev == NULL)
+  {
+    return;
+  }
+
+  /* SetTxBuffer() only once the class has room, it may hold the buffer in flight */
+  while ((hnet->tx_next != hnet->tx_head) && (hnet->tx_busy < hnet->conf->tx_depth))
+  {
+    frame = &hnet->tx_frame[hnet->tx_next % USBD_NETIF_TX_FRAMES];
+
+    (void)hnet->conf->SetTxBuffer(hnet->pdev, frame->data, frame->len);
+
+    /* USBD_BUSY if someone else uses the IN endpoint, retried on completion or from Process */
+    if (hnet->conf->TransmitPacket(hnet->pdev) != (uint8_t)USBD_OK)
+    {
+      break;
+    }
+
+    hnet->tx_busy++;
+    hnet->tx_next++;
+  }
+}
+
+/**
+  * @brief  Give the pbufs of the frames already sent back to lwIP
+  * @param  hnet: driver instance
+  * @retval None
+  */
+static void Netif_TxReclaim(USBD_Netif_HandleTypeDef *hnet)
+{
+  USBD_Netif_TxFrameTypeDef *frame;
+  uint32_t primask;
+  uint32_t done;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  done = hnet->tx_next - hnet->tx_busy;
+  __set_PRIMASK(primask);
+
+  while (hnet->tx_free != done)
+  {
+    frame = &hnet->tx_frame[hnet->tx_free % USBD_NETIF_TX_FRAMES];
+
+    if (frame->header != 0U)
+    {
+      (void)pbuf_remove_header(frame->p, frame->header);
+    }
+    (void)pbuf_free(frame->p);
+    frame->p = NULL;
+
+    hnet->tx_free++;
+  }
+}
+
+#endif /* USBD_NETIF_USE_LWIP */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,190 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_netif.h
+  * @brief          : Header for usbd_netif.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_NETIF_H__
+#define __USBD_NETIF_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_NETIF USBD_NETIF
+  * @brief lwIP network interface on top of the CDC RNDIS and CDC ECM classes
+  * @{
+  */
+
+/** @defgroup USBD_NETIF_Exported_Defines USBD_NETIF_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Set to 1 once lwIP is part of the build, the RNDIS and ECM interface
+   templates then hand their frames to lwIP through this driver */
+#ifndef USBD_NETIF_USE_LWIP
+#define USBD_NETIF_USE_LWIP              0U
+#endif /* USBD_NETIF_USE_LWIP */
+
+/* USB OUT buffers per interface, one is armed while the others are lent to lwIP */
+#ifndef USBD_NETIF_RX_BUFFERS
+#define USBD_NETIF_RX_BUFFERS            4U
+#endif /* USBD_NETIF_RX_BUFFERS */
+
+/* Received frames lwIP may hold at once per interface */
+#ifndef USBD_NETIF_RX_FRAMES
+#define USBD_NETIF_RX_FRAMES             16U
+#endif /* USBD_NETIF_RX_FRAMES */
+
+/* Frames queued for the IN endpoint per interface */
+#ifndef USBD_NETIF_TX_FRAMES
+#define USBD_NETIF_TX_FRAMES             8U
+#endif /* USBD_NETIF_TX_FRAMES */
+
+#define USBD_NETIF_MTU                   1500U
+
+#define USBD_NETIF_RX_IDLE               0xFFU
+
+/**
+  * @}
+  */
+
+#if (USBD_NETIF_USE_LWIP == 1U)
+
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+/** @defgroup USBD_NETIF_Exported_Types USBD_NETIF_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+/* Everything the driver needs to know about one USB network function, the
+   RNDIS and ECM classes share the same buffer API */
+typedef struct
+{
+  uint8_t (*SetRxBuffer)(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length);
+  uint8_t (*ReceivePacket)(USBD_HandleTypeDef *pdev);
+  uint8_t (*SetTxBuffer)(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length);
+  uint8_t (*TransmitPacket)(USBD_HandleTypeDef *pdev);
+  uint8_t (*ReleaseRxBuffer)(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
+  uint16_t tx_header;      /* Bytes the class writes in front of each frame */
+  uint16_t tx_depth;       /* Frames the class holds at once, 1 when SetTxBuffer()
+                              replaces the buffer of the transfer in flight */
+  uint8_t *rx_pool;        /* USBD_NETIF_RX_BUFFERS buffers of rx_size bytes,
+                              NULL when the class keeps its own frame ring */
+  uint32_t rx_size;        /* Largest OUT transfer the class receives */
+  uint8_t hwaddr[6];
+  char name[2];
+  uint32_t ipaddr;         /* Host byte order */
+  uint32_t netmask;
+  uint32_t gw;
+} USBD_Netif_ConfTypeDef;
+
+/* One received frame lent to lwIP, the pbuf points into its RX buffer */
+typedef struct
+{
+  struct pbuf_custom pc;   /* Must stay first, lwIP hands it back on free */
+  void *hnet;
+  uint8_t *payload;
+  uint16_t len;
+  uint8_t buf;
+  __IO uint8_t busy;
+} USBD_Netif_RxFrameTypeDef;
+
+typedef struct
+{
+  struct pbuf *p;
+  uint8_t *data;
+  uint16_t len;
+  uint16_t header;         /* Header added in front of a referenced pbuf */
+} USBD_Netif_TxFrameTypeDef;
+
+typedef struct
+{
+  struct netif netif;
+  USBD_HandleTypeDef *pdev;
+  const USBD_Netif_ConfTypeDef *conf;
+  uint32_t added;
+
+  __IO uint8_t rx_refs[USBD_NETIF_RX_BUFFERS];
+  __IO uint32_t rx_armed;  /* Buffer the OUT endpoint owns, USBD_NETIF_RX_IDLE if none */
+  uint32_t rx_filled;      /* Buffer the frames of the last transfer live in */
+  USBD_Netif_RxFrameTypeDef rx_frame[USBD_NETIF_RX_FRAMES];
+  uint8_t rx_queue[USBD_NETIF_RX_FRAMES];
+  __IO uint32_t rx_head;   /* Written from the USB interrupt */
+  uint32_t rx_tail;
+
+  USBD_Netif_TxFrameTypeDef tx_frame[USBD_NETIF_TX_FRAMES];
+  uint32_t tx_head;        /* Next slot lwIP fills */
+  __IO uint32_t tx_next;   /* Next slot handed to the class */
+  uint32_t tx_free;        /* Next slot to give back to lwIP */
+  __IO uint32_t tx_busy;    /* Frames handed to the class and not completed */
+
+  uint32_t rx_drops;
+  uint32_t tx_drops;
+} USBD_Netif_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_NETIF_Exported_FunctionsPrototype USBD_NETIF_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void USBD_Netif_Start(USBD_Netif_HandleTypeDef *hnet, USBD_HandleTypeDef *pdev,
+                      const USBD_Netif_ConfTypeDef *conf);
+uint8_t USBD_Netif_Input(USBD_Netif_HandleTypeDef *hnet, uint8_t *buf, uint32_t len);
+void USBD_Netif_TransmitCplt(USBD_Netif_HandleTypeDef *hnet, uint8_t *buf);
+void USBD_Netif_Process(USBD_Netif_HandleTypeDef *hnet, uint32_t link_up);
+
+/* Checksum routine for lwIP, in lwipopts.h:
+     u16_t USBD_Netif_Chksum(const void *dataptr, int len);
+     #define LWIP_CHKSUM                 USBD_Netif_Chksum */
+u16_t USBD_Netif_Chksum(const void *dataptr, int len);
+
+/**
+  * @}
+  */
+
+#endif /* USBD_NETIF_USE_LWIP */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_NETIF_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
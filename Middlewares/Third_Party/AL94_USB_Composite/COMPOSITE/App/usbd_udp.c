@@ -0,0 +1,676 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_udp.c
+  * @brief          : ARP, ICMP echo and UDP responder for the CDC RNDIS and ECM
+  *                   classes.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           A static IPv4 address answering ARP and ping, and UDP in both
+  *           directions, for telemetry links that do not need TCP. It works
+  *           on whole Ethernet frames: USBD_UDP_Input() takes the frames the
+  *           class received, conf->Output() hands frames to the class.
+  *
+  *           Sending: USBD_UDP_OpenFlow() prebuilds the Ethernet, IP and UDP
+  *           headers of one destination together with their partial
+  *           checksums. USBD_UDP_Alloc() lends a TX frame, the application
+  *           writes its payload in place behind the headers and
+  *           USBD_UDP_Send() copies the 42 byte template in front of it and
+  *           completes both checksums from the partial sums, so only the
+  *           payload is ever summed. USBD_UDP_SendSummed() skips that too
+  *           when the application kept the payload sum while writing it.
+  *
+  *           The frame goes back to the pool on TransmitCplt, or as soon as
+  *           Output returns when the class copies it (conf->tx_copies).
+  *
+  *           USBD_UDP_Input() may run in the USB interrupt (RNDIS) or in the
+  *           main loop (ECM), the datagram callback runs in the same context.
+  *
+  *           The USB host is the only neighbour: its addresses are learnt
+  *           from the ARP and IP frames it sends. IP fragments and options
+  *           addressed to the responder are dropped.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_udp.h"
+
+/* Private define ------------------------------------------------------------*/
+#define UDP_ETHTYPE_IP                   0x0800U
+#define UDP_ETHTYPE_ARP                  0x0806U
+
+#define UDP_ARP_LEN                      28U
+#define UDP_ARP_REQUEST                  1U
+#define UDP_ARP_REPLY                    2U
+
+#define UDP_PROTO_ICMP                   1U
+#define UDP_PROTO_UDP                    17U
+
+#define UDP_ICMP_ECHO_REPLY              0U
+#define UDP_ICMP_ECHO_REQUEST            8U
+
+#define UDP_IP_TTL                       64U
+#define UDP_IP_DF                        0x4000U
+
+/* Frame offsets */
+#define UDP_OFS_ETH_DST                  0U
+#define UDP_OFS_ETH_SRC                  6U
+#define UDP_OFS_ETH_TYPE                 12U
+#define UDP_OFS_IP                       USBD_UDP_ETH_HLEN
+#define UDP_OFS_UDP                      (USBD_UDP_ETH_HLEN + USBD_UDP_IP_HLEN)
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t UDP_InputArp(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len);
+static uint8_t UDP_InputIp(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len);
+static void UDP_EchoReply(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t ip_len);
+static void UDP_SendArp(USBD_UDP_HandleTypeDef *hudp, uint16_t op,
+                        const uint8_t *hwaddr, uint32_t ipaddr);
+static uint8_t *UDP_AllocFrame(USBD_UDP_HandleTypeDef *hudp);
+static void UDP_FreeFrame(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame);
+static uint8_t UDP_Output(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len);
+static void UDP_Learn(USBD_UDP_HandleTypeDef *hudp, const uint8_t *hwaddr, uint32_t ipaddr);
+static uint16_t UDP_Get16(const uint8_t *addr);
+static uint32_t UDP_Get32(const uint8_t *addr);
+static void UDP_Put16(uint8_t *addr, uint16_t val);
+static void UDP_Put32(uint8_t *addr, uint32_t val);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Bind the responder to its interface
+  * @param  hudp: responder instance
+  * @param  conf: class output, datagram callback and addresses
+  * @retval None
+  */
+void USBD_UDP_Init(USBD_UDP_HandleTypeDef *hudp, const USBD_UDP_ConfTypeDef *conf)
+{
+  uint32_t i;
+
+  hudp->conf = conf;
+  hudp->tx_next = 0U;
+
+  /* Whatever was queued on the bus is gone */
+  for (i = 0U; i < USBD_UDP_TX_FRAMES; i++)
+  {
+    hudp->tx_frame[i].busy = 0U;
+  }
+}
+
+/**
+  * @brief  Handle one received Ethernet frame
+  * @param  hudp: responder instance
+  * @param  frame: Ethernet frame, only read during the call
+  * @param  len: frame length
+  * @retval USBD_OK when the frame was for the responder, USBD_FAIL otherwise
+  */
+uint8_t USBD_UDP_Input(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len)
+{
+  uint32_t i;
+  uint8_t bcast = 1U;
+  uint8_t ours = 1U;
+
+  if ((hudp->conf == NULL) || (len < USBD_UDP_ETH_HLEN))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hudp->rx_frames++;
+
+  for (i = 0U; i < 6U; i++)
+  {
+    bcast &= (frame[UDP_OFS_ETH_DST + i] == 0xFFU) ? 1U : 0U;
+    ours &= (frame[UDP_OFS_ETH_DST + i] == hudp->conf->hwaddr[i]) ? 1U : 0U;
+  }
+
+  if ((bcast == 0U) && (ours == 0U))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  switch (UDP_Get16(&frame[UDP_OFS_ETH_TYPE]))
+  {
+    case UDP_ETHTYPE_ARP:
+      return UDP_InputArp(hudp, frame, len);
+
+    case UDP_ETHTYPE_IP:
+      return UDP_InputIp(hudp, frame, len);
+
+    default:
+      return (uint8_t)USBD_FAIL;
+  }
+}
+
+/**
+  * @brief  IN transfer of a frame completed, called from the interface
+  *         TransmitCplt callback
+  * @param  hudp: responder instance
+  * @param  frame: frame the class just sent
+  * @retval None
+  */
+void USBD_UDP_TransmitCplt(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame)
+{
+  UDP_FreeFrame(hudp, frame);
+}
+
+/**
+  * @brief  Prebuild the headers towards one destination
+  * @param  hudp: responder instance
+  * @param  flow: flow to fill in
+  * @param  ipaddr: destination address, host byte order
+  * @param  src_port: local port
+  * @param  dst_port: remote port
+  * @retval USBD_OK, USBD_BUSY while the destination MAC is being resolved;
+  *         an ARP request went out, call again once the host answered
+  */
+uint8_t USBD_UDP_OpenFlow(USBD_UDP_HandleTypeDef *hudp, USBD_UDP_FlowTypeDef *flow,
+                          uint32_t ipaddr, uint16_t src_port, uint16_t dst_port)
+{
+  static const uint8_t bcast[6] = {0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU};
+  const USBD_UDP_ConfTypeDef *conf = hudp->conf;
+  const uint8_t *hwaddr;
+  uint8_t *ip = &flow->hdr[USBD_UDP_ETH_HLEN];
+  uint8_t *udp = &flow->hdr[USBD_UDP_ETH_HLEN + USBD_UDP_IP_HLEN];
+
+  /* Limited broadcast, or directed broadcast of our subnet */
+  if ((ipaddr == USBD_UDP_BROADCAST) || (ipaddr == (conf->ipaddr | ~conf->netmask)))
+  {
+    hwaddr = bcast;
+  }
+  else if ((hudp->peer_valid != 0U) && (hudp->peer_ip == ipaddr))
+  {
+    hwaddr = hudp->peer_hwaddr;
+  }
+  else
+  {
+    UDP_SendArp(hudp, UDP_ARP_REQUEST, bcast, ipaddr);
+    return (uint8_t)USBD_BUSY;
+  }
+
+  (void)memcpy(&flow->hdr[UDP_OFS_ETH_DST], hwaddr, 6U);
+  (void)memcpy(&flow->hdr[UDP_OFS_ETH_SRC], conf->hwaddr, 6U);
+  UDP_Put16(&flow->hdr[UDP_OFS_ETH_TYPE], UDP_ETHTYPE_IP);
+
+  /* Length, id and checksums are left at 0 for USBD_UDP_Send() */
+  (void)memset(ip, 0, USBD_UDP_IP_HLEN + USBD_UDP_UDP_HLEN);
+  ip[0] = 0x45U;
+  UDP_Put16(&ip[6], UDP_IP_DF);
+  ip[8] = UDP_IP_TTL;
+  ip[9] = UDP_PROTO_UDP;
+  UDP_Put32(&ip[12], conf->ipaddr);
+  UDP_Put32(&ip[16], ipaddr);
+  UDP_Put16(&udp[0], src_port);
+  UDP_Put16(&udp[2], dst_port);
+
+  flow->ip_sum = USBD_Csum_Add(ip, USBD_UDP_IP_HLEN, 0U);
+  flow->udp_sum = USBD_Csum_Add(&ip[12], 8U, UDP_PROTO_UDP);
+  flow->udp_sum = USBD_Csum_Add(udp, 4U, flow->udp_sum);
+  flow->ipaddr = ipaddr;
+  flow->src_port = src_port;
+  flow->dst_port = dst_port;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Lend a TX frame for a datagram built in place
+  * @param  hudp: responder instance
+  * @retval payload area of USBD_UDP_MAX_PAYLOAD bytes, NULL when all frames
+  *         are in use
+  */
+uint8_t *USBD_UDP_Alloc(USBD_UDP_HandleTypeDef *hudp)
+{
+  uint8_t *frame = UDP_AllocFrame(hudp);
+
+  return (frame != NULL) ? &frame[USBD_UDP_HLEN] : NULL;
+}
+
+/**
+  * @brief  Give back a frame from USBD_UDP_Alloc() without sending it
+  * @param  hudp: responder instance
+  * @param  payload: payload area returned by USBD_UDP_Alloc()
+  * @retval None
+  */
+void USBD_UDP_Free(USBD_UDP_HandleTypeDef *hudp, uint8_t *payload)
+{
+  UDP_FreeFrame(hudp, payload - USBD_UDP_HLEN);
+}
+
+/**
+  * @brief  Send a datagram built in place
+  * @param  hudp: responder instance
+  * @param  flow: destination opened with USBD_UDP_OpenFlow()
+  * @param  payload: payload area returned by USBD_UDP_Alloc()
+  * @param  len: payload length
+  * @retval USBD_OK, USBD_BUSY when the class is full: the frame stays
+  *         allocated and the call may be repeated
+  */
+uint8_t USBD_UDP_Send(USBD_UDP_HandleTypeDef *hudp, const USBD_UDP_FlowTypeDef *flow,
+                      uint8_t *payload, uint16_t len)
+{
+  uint32_t sum = 0U;
+
+#if (USBD_UDP_TX_CHECKSUM == 1U)
+  sum = USBD_Csum_Add(payload, len, 0U);
+#endif /* USBD_UDP_TX_CHECKSUM */
+
+  return USBD_UDP_SendSummed(hudp, flow, payload, len, sum);
+}
+
+/**
+  * @brief  Send a datagram whose payload sum the application already has
+  * @param  hudp: responder instance
+  * @param  flow: destination opened with USBD_UDP_OpenFlow()
+  * @param  payload: payload area returned by USBD_UDP_Alloc()
+  * @param  len: payload length
+  * @param  sum: USBD_Csum_Add() of the payload, may be kept up to date
+  *         incrementally while the payload is written
+  * @retval USBD_OK, USBD_BUSY when the class is full
+  */
+uint8_t USBD_UDP_SendSummed(USBD_UDP_HandleTypeDef *hudp, const USBD_UDP_FlowTypeDef *flow,
+                            uint8_t *payload, uint16_t len, uint32_t sum)
+{
+  uint8_t *frame = payload - USBD_UDP_HLEN;
+  uint8_t *ip = &frame[UDP_OFS_IP];
+  uint8_t *udp = &frame[UDP_OFS_UDP];
+  uint16_t ip_len = (uint16_t)(len + USBD_UDP_IP_HLEN + USBD_UDP_UDP_HLEN);
+  uint16_t udp_len = (uint16_t)(len + USBD_UDP_UDP_HLEN);
+  uint16_t csum;
+  uint8_t ret;
+
+  if (len > USBD_UDP_MAX_PAYLOAD)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  (void)memcpy(frame, flow->hdr, USBD_UDP_HLEN);
+
+  UDP_Put16(&ip[2], ip_len);
+  UDP_Put16(&ip[4], hudp->ip_id);
+  UDP_Put16(&ip[10], (uint16_t)~USBD_Csum_Fold(flow->ip_sum + ip_len + hudp->ip_id));
+  UDP_Put16(&udp[4], udp_len);
+
+#if (USBD_UDP_TX_CHECKSUM == 1U)
+  /* The UDP length counts once in the pseudo header and once in the header */
+  csum = (uint16_t)~USBD_Csum_Fold(flow->udp_sum + (2U * (uint32_t)udp_len) + USBD_Csum_Fold(sum));
+  UDP_Put16(&udp[6], (csum == 0U) ? 0xFFFFU : csum);
+#else
+  UNUSED(sum);
+  UNUSED(csum);
+#endif /* USBD_UDP_TX_CHECKSUM */
+
+  ret = UDP_Output(hudp, frame, (uint32_t)USBD_UDP_HLEN + len);
+
+  if (ret == (uint8_t)USBD_OK)
+  {
+    hudp->ip_id++;
+    hudp->tx_datagrams++;
+  }
+  else
+  {
+    hudp->tx_busy++;
+  }
+
+  return ret;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Answer ARP requests for our address and learn the host's
+  * @param  hudp: responder instance
+  * @param  frame: Ethernet frame
+  * @param  len: frame length
+  * @retval USBD_OK when the frame was for the responder, USBD_FAIL otherwise
+  */
+static uint8_t UDP_InputArp(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len)
+{
+  uint8_t *arp = &frame[USBD_UDP_ETH_HLEN];
+  uint32_t sender_ip;
+  uint16_t op;
+
+  if ((len < (USBD_UDP_ETH_HLEN + UDP_ARP_LEN)) || (UDP_Get16(&arp[0]) != 1U) ||
+      (UDP_Get16(&arp[2]) != UDP_ETHTYPE_IP) || (arp[4] != 6U) || (arp[5] != 4U))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (UDP_Get32(&arp[24]) != hudp->conf->ipaddr)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  op = UDP_Get16(&arp[6]);
+  sender_ip = UDP_Get32(&arp[14]);
+
+  UDP_Learn(hudp, &arp[8], sender_ip);
+
+  if (op == UDP_ARP_REQUEST)
+  {
+    UDP_SendArp(hudp, UDP_ARP_REPLY, &arp[8], sender_ip);
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Handle IPv4 packets addressed to us: ICMP echo and UDP
+  * @param  hudp: responder instance
+  * @param  frame: Ethernet frame
+  * @param  len: frame length
+  * @retval USBD_OK when the frame was for the responder, USBD_FAIL otherwise
+  */
+static uint8_t UDP_InputIp(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len)
+{
+  const USBD_UDP_ConfTypeDef *conf = hudp->conf;
+  uint8_t *ip = &frame[UDP_OFS_IP];
+  uint8_t *udp = &frame[UDP_OFS_UDP];
+  uint32_t dst_ip;
+  uint32_t src_ip;
+  uint16_t ip_len;
+  uint16_t udp_len;
+
+  if (len < (USBD_UDP_ETH_HLEN + USBD_UDP_IP_HLEN))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  dst_ip = UDP_Get32(&ip[16]);
+  src_ip = UDP_Get32(&ip[12]);
+
+  if ((dst_ip != conf->ipaddr) && (dst_ip != USBD_UDP_BROADCAST) &&
+      (dst_ip != (conf->ipaddr | ~conf->netmask)))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  ip_len = UDP_Get16(&ip[2]);
+
+  /* No options, no fragments */
+  if ((ip[0] != 0x45U) || ((UDP_Get16(&ip[6]) & 0x3FFFU) != 0U) ||
+      (ip_len < USBD_UDP_IP_HLEN) || (ip_len > (len - USBD_UDP_ETH_HLEN)) ||
+      (USBD_Csum_Fold(USBD_Csum_Add(ip, USBD_UDP_IP_HLEN, 0U)) != 0xFFFFU))
+  {
+    hudp->rx_errors++;
+    return (uint8_t)USBD_OK;
+  }
+
+  if (((src_ip ^ conf->ipaddr) & conf->netmask) == 0U)
+  {
+    UDP_Learn(hudp, &frame[UDP_OFS_ETH_SRC], src_ip);
+  }
+
+  switch (ip[9])
+  {
+    case UDP_PROTO_ICMP:
+      if ((dst_ip == conf->ipaddr) && (ip_len >= (USBD_UDP_IP_HLEN + 8U)) &&
+          (ip[USBD_UDP_IP_HLEN] == UDP_ICMP_ECHO_REQUEST))
+      {
+        UDP_EchoReply(hudp, frame, ip_len);
+      }
+      break;
+
+    case UDP_PROTO_UDP:
+      udp_len = (ip_len >= (USBD_UDP_IP_HLEN + USBD_UDP_UDP_HLEN)) ? UDP_Get16(&udp[4]) : 0U;
+
+      if ((udp_len < USBD_UDP_UDP_HLEN) || (udp_len > (ip_len - USBD_UDP_IP_HLEN)))
+      {
+        hudp->rx_errors++;
+        break;
+      }
+
+#if (USBD_UDP_RX_CHECKSUM == 1U)
+      if ((UDP_Get16(&udp[6]) != 0U) &&
+          (USBD_Csum_Fold(USBD_Csum_Add(udp, udp_len,
+                                        USBD_Csum_Add(&ip[12], 8U, UDP_PROTO_UDP + (uint32_t)udp_len))) != 0xFFFFU))
+      {
+        hudp->rx_errors++;
+        break;
+      }
+#endif /* USBD_UDP_RX_CHECKSUM */
+
+      hudp->rx_datagrams++;
+
+      if (conf->Receive != NULL)
+      {
+        conf->Receive(src_ip, UDP_Get16(&udp[0]), UDP_Get16(&udp[2]),
+                      &udp[USBD_UDP_UDP_HLEN], (uint16_t)(udp_len - USBD_UDP_UDP_HLEN));
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Turn an echo request into a reply in a TX frame
+  * @param  hudp: responder instance
+  * @param  frame: Ethernet frame holding the request
+  * @param  ip_len: IP packet length
+  * @retval None
+  */
+static void UDP_EchoReply(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t ip_len)
+{
+  uint8_t *reply = UDP_AllocFrame(hudp);
+  uint8_t *ip;
+  uint8_t *icmp;
+
+  if (reply == NULL)
+  {
+    hudp->tx_busy++;
+    return;
+  }
+
+  (void)memcpy(reply, &frame[UDP_OFS_ETH_SRC], 6U);
+  (void)memcpy(&reply[UDP_OFS_ETH_SRC], hudp->conf->hwaddr, 6U);
+  UDP_Put16(&reply[UDP_OFS_ETH_TYPE], UDP_ETHTYPE_IP);
+  (void)memcpy(&reply[UDP_OFS_IP], &frame[UDP_OFS_IP], ip_len);
+
+  ip = &reply[UDP_OFS_IP];
+  icmp = &ip[USBD_UDP_IP_HLEN];
+
+  UDP_Put32(&ip[16], UDP_Get32(&frame[UDP_OFS_IP + 12U]));
+  UDP_Put32(&ip[12], hudp->conf->ipaddr);
+  ip[8] = UDP_IP_TTL;
+  UDP_Put16(&ip[10], 0U);
+  UDP_Put16(&ip[10], (uint16_t)~USBD_Csum_Fold(USBD_Csum_Add(ip, USBD_UDP_IP_HLEN, 0U)));
+
+  /* Only the type changes, patch the checksum instead of summing the data */
+  icmp[0] = UDP_ICMP_ECHO_REPLY;
+  UDP_Put16(&icmp[2], USBD_Csum_Update16(UDP_Get16(&icmp[2]), (uint16_t)UDP_ICMP_ECHO_REQUEST << 8,
+                                         (uint16_t)UDP_ICMP_ECHO_REPLY << 8));
+
+  if (UDP_Output(hudp, reply, USBD_UDP_ETH_HLEN + ip_len) == (uint8_t)USBD_OK)
+  {
+    hudp->echo_replies++;
+  }
+  else
+  {
+    hudp->tx_busy++;
+    UDP_FreeFrame(hudp, reply);
+  }
+}
+
+/**
+  * @brief  Send an ARP request or reply
+  * @param  hudp: responder instance
+  * @param  op: UDP_ARP_REQUEST or UDP_ARP_REPLY
+  * @param  hwaddr: target MAC, broadcast for a request
+  * @param  ipaddr: target address
+  * @retval None
+  */
+static void UDP_SendArp(USBD_UDP_HandleTypeDef *hudp, uint16_t op,
+                        const uint8_t *hwaddr, uint32_t ipaddr)
+{
+  uint8_t *frame = UDP_AllocFrame(hudp);
+  uint8_t *arp;
+
+  if (frame == NULL)
+  {
+    hudp->tx_busy++;
+    return;
+  }
+
+  arp = &frame[USBD_UDP_ETH_HLEN];
+
+  (void)memcpy(&frame[UDP_OFS_ETH_DST], hwaddr, 6U);
+  (void)memcpy(&frame[UDP_OFS_ETH_SRC], hudp->conf->hwaddr, 6U);
+  UDP_Put16(&frame[UDP_OFS_ETH_TYPE], UDP_ETHTYPE_ARP);
+
+  UDP_Put16(&arp[0], 1U);
+  UDP_Put16(&arp[2], UDP_ETHTYPE_IP);
+  arp[4] = 6U;
+  arp[5] = 4U;
+  UDP_Put16(&arp[6], op);
+  (void)memcpy(&arp[8], hudp->conf->hwaddr, 6U);
+  UDP_Put32(&arp[14], hudp->conf->ipaddr);
+  (void)memset(&arp[18], 0, 6U);
+  if (op == UDP_ARP_REPLY)
+  {
+    (void)memcpy(&arp[18], hwaddr, 6U);
+  }
+  UDP_Put32(&arp[24], ipaddr);
+
+  if (UDP_Output(hudp, frame, USBD_UDP_ETH_HLEN + UDP_ARP_LEN) == (uint8_t)USBD_OK)
+  {
+    hudp->arp_replies += (op == UDP_ARP_REPLY) ? 1U : 0U;
+  }
+  else
+  {
+    hudp->tx_busy++;
+    UDP_FreeFrame(hudp, frame);
+  }
+}
+
+/**
+  * @brief  Take a free TX frame
+  * @param  hudp: responder instance
+  * @retval frame, NULL when all are in use
+  */
+static uint8_t *UDP_AllocFrame(USBD_UDP_HandleTypeDef *hudp)
+{
+  uint8_t *frame = NULL;
+  uint32_t primask;
+  uint32_t i;
+  uint32_t idx;
+
+  /* Replies may be built from the USB interrupt while the main loop sends */
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  for (i = 0U; i < USBD_UDP_TX_FRAMES; i++)
+  {
+    idx = (hudp->tx_next + i) % USBD_UDP_TX_FRAMES;
+
+    if (hudp->tx_frame[idx].busy == 0U)
+    {
+      hudp->tx_frame[idx].busy = 1U;
+      hudp->tx_next = (idx + 1U) % USBD_UDP_TX_FRAMES;
+      frame = (uint8_t *)hudp->tx_frame[idx].data;
+      break;
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  return frame;
+}
+
+/**
+  * @brief  Give a TX frame back to the pool
+  * @param  hudp: responder instance
+  * @param  frame: frame start
+  * @retval None
+  */
+static void UDP_FreeFrame(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame)
+{
+  uint32_t i;
+
+  for (i = 0U; i < USBD_UDP_TX_FRAMES; i++)
+  {
+    if ((uint8_t *)hudp->tx_frame[i].data == frame)
+    {
+      hudp->tx_frame[i].busy = 0U;
+      break;
+    }
+  }
+}
+
+/**
+  * @brief  Hand a frame to the class, frees it right away if the class copied it
+  * @param  hudp: responder instance
+  * @param  frame: frame start
+  * @param  len: frame length
+  * @retval status of conf->Output
+  */
+static uint8_t UDP_Output(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len)
+{
+  uint8_t ret = hudp->conf->Output(frame, len);
+
+  if ((ret == (uint8_t)USBD_OK) && (hudp->conf->tx_copies != 0U))
+  {
+    UDP_FreeFrame(hudp, frame);
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Remember the host's addresses
+  * @param  hudp: responder instance
+  * @param  hwaddr: host MAC
+  * @param  ipaddr: host address
+  * @retval None
+  */
+static void UDP_Learn(USBD_UDP_HandleTypeDef *hudp, const uint8_t *hwaddr, uint32_t ipaddr)
+{
+  hudp->peer_ip = ipaddr;
+  (void)memcpy(hudp->peer_hwaddr, hwaddr, 6U);
+  hudp->peer_valid = 1U;
+}
+
+static uint16_t UDP_Get16(const uint8_t *addr)
+{
+  return (uint16_t)(((uint16_t)addr[0] << 8) | addr[1]);
+}
+
+static uint32_t UDP_Get32(const uint8_t *addr)
+{
+  return ((uint32_t)addr[0] << 24) | ((uint32_t)addr[1] << 16) |
+         ((uint32_t)addr[2] << 8) | addr[3];
+}
+
+static void UDP_Put16(uint8_t *addr, uint16_t val)
+{
+  addr[0] = (uint8_t)(val >> 8);
+  addr[1] = (uint8_t)val;
+}
+
+static void UDP_Put32(uint8_t *addr, uint32_t val)
+{
+  addr[0] = (uint8_t)(val >> 24);
+  addr[1] = (uint8_t)(val >> 16);
+  addr[2] = (uint8_t)(val >> 8);
+  addr[3] = (uint8_t)val;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
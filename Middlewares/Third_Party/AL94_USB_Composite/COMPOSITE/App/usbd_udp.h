@@ -0,0 +1,177 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_udp.h
+  * @brief          : Header for usbd_udp.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_UDP_H__
+#define __USBD_UDP_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+#include "usbd_csum.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_UDP USBD_UDP
+  * @brief ARP, ICMP echo and UDP responder on top of the CDC RNDIS and ECM frames
+  * @{
+  */
+
+/** @defgroup USBD_UDP_Exported_Defines USBD_UDP_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Set to 1 to answer on the RNDIS and ECM interfaces with this responder
+   instead of a TCP/IP stack, not together with USBD_NETIF_USE_LWIP */
+#ifndef USBD_UDP_USE_FASTPATH
+#define USBD_UDP_USE_FASTPATH            0U
+#endif /* USBD_UDP_USE_FASTPATH */
+
+/* Frames being built or waiting for the IN endpoint per interface */
+#ifndef USBD_UDP_TX_FRAMES
+#define USBD_UDP_TX_FRAMES               4U
+#endif /* USBD_UDP_TX_FRAMES */
+
+/* Verify the UDP checksum of received datagrams, the IP header is always checked */
+#ifndef USBD_UDP_RX_CHECKSUM
+#define USBD_UDP_RX_CHECKSUM             1U
+#endif /* USBD_UDP_RX_CHECKSUM */
+
+/* Fill in the UDP checksum of sent datagrams, 0 sends them without one */
+#ifndef USBD_UDP_TX_CHECKSUM
+#define USBD_UDP_TX_CHECKSUM             1U
+#endif /* USBD_UDP_TX_CHECKSUM */
+
+#define USBD_UDP_ETH_HLEN                14U
+#define USBD_UDP_IP_HLEN                 20U
+#define USBD_UDP_UDP_HLEN                8U
+#define USBD_UDP_HLEN                    (USBD_UDP_ETH_HLEN + USBD_UDP_IP_HLEN + USBD_UDP_UDP_HLEN)
+#define USBD_UDP_MTU                     1500U
+#define USBD_UDP_MAX_PAYLOAD             (USBD_UDP_MTU - USBD_UDP_IP_HLEN - USBD_UDP_UDP_HLEN)
+#define USBD_UDP_FRAME_SIZE              (USBD_UDP_ETH_HLEN + USBD_UDP_MTU)
+
+#define USBD_UDP_BROADCAST               0xFFFFFFFFU
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_UDP_Exported_Types USBD_UDP_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+typedef struct
+{
+  /* Hand a frame to the class, USBD_OK once queued, USBD_BUSY to retry later */
+  uint8_t (*Output)(uint8_t *frame, uint32_t len);
+  /* UDP datagram addressed to us, data is only valid during the call */
+  void (*Receive)(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+                  uint8_t *data, uint16_t len);
+  uint8_t tx_copies;       /* Output copies the frame, no TransmitCplt follows */
+  uint8_t hwaddr[6];
+  uint32_t ipaddr;         /* Host byte order */
+  uint32_t netmask;
+} USBD_UDP_ConfTypeDef;
+
+/* Prebuilt headers of one destination, see USBD_UDP_OpenFlow() */
+typedef struct
+{
+  uint8_t hdr[USBD_UDP_HLEN];
+  uint32_t ip_sum;         /* IP header sum without length and id */
+  uint32_t udp_sum;        /* Pseudo header and ports sum without length */
+  uint32_t ipaddr;
+  uint16_t src_port;
+  uint16_t dst_port;
+} USBD_UDP_FlowTypeDef;
+
+typedef struct
+{
+  uint32_t data[(USBD_UDP_FRAME_SIZE + 3U) / 4U]; /* Force 32-bit alignment */
+  __IO uint32_t busy;
+} USBD_UDP_TxFrameTypeDef;
+
+typedef struct
+{
+  const USBD_UDP_ConfTypeDef *conf;
+
+  USBD_UDP_TxFrameTypeDef tx_frame[USBD_UDP_TX_FRAMES];
+  uint32_t tx_next;        /* Where the search for a free frame starts */
+  uint16_t ip_id;
+
+  uint32_t peer_ip;        /* Single entry neighbour cache, the USB host */
+  uint8_t peer_hwaddr[6];
+  uint8_t peer_valid;
+
+  uint32_t rx_frames;
+  uint32_t rx_datagrams;
+  uint32_t rx_errors;
+  uint32_t tx_datagrams;
+  uint32_t tx_busy;
+  uint32_t arp_replies;
+  uint32_t echo_replies;
+} USBD_UDP_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_UDP_Exported_FunctionsPrototype USBD_UDP_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void USBD_UDP_Init(USBD_UDP_HandleTypeDef *hudp, const USBD_UDP_ConfTypeDef *conf);
+uint8_t USBD_UDP_Input(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame, uint32_t len);
+void USBD_UDP_TransmitCplt(USBD_UDP_HandleTypeDef *hudp, uint8_t *frame);
+
+uint8_t USBD_UDP_OpenFlow(USBD_UDP_HandleTypeDef *hudp, USBD_UDP_FlowTypeDef *flow,
+                          uint32_t ipaddr, uint16_t src_port, uint16_t dst_port);
+uint8_t *USBD_UDP_Alloc(USBD_UDP_HandleTypeDef *hudp);
+void USBD_UDP_Free(USBD_UDP_HandleTypeDef *hudp, uint8_t *payload);
+uint8_t USBD_UDP_Send(USBD_UDP_HandleTypeDef *hudp, const USBD_UDP_FlowTypeDef *flow,
+                      uint8_t *payload, uint16_t len);
+uint8_t USBD_UDP_SendSummed(USBD_UDP_HandleTypeDef *hudp, const USBD_UDP_FlowTypeDef *flow,
+                            uint8_t *payload, uint16_t len, uint32_t sum);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_UDP_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -32,7 +32,7 @@
 /* #include "img_bin.h" */
 
 /* USER CODE BEGIN INCLUDE */
-
+#include <string.h>
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -99,6 +99,16 @@
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
 
+#if (USBD_VIDEO_PATTERN_ENABLED == 1U)
+/* The pattern gives YUY2 and NV12, the producers MJPEG only */
+#define VIDEO_QUEUE_FRAME_SIZE           MIN(USBD_VIDEO_QUEUE_FRAME_SIZE, UVC_FRAME_SIZE_MJPEG(UVC_WIDTH, UVC_HEIGHT))
+#else
+#define VIDEO_QUEUE_FRAME_SIZE           USBD_VIDEO_QUEUE_FRAME_SIZE
+#endif /* USBD_VIDEO_PATTERN_ENABLED */
+
+/* Triple buffer behind VIDEO_Queue */
+__ALIGN_BEGIN static uint8_t VIDEO_Pool[USBD_VIDEO_QUEUE_POOL_SIZE(VIDEO_QUEUE_FRAME_SIZE)] __ALIGN_END USBD_VIDEO_QUEUE_SECTION;
+
 /* USER CODE END PRIVATE_VARIABLES */
 
 /**
@@ -114,6 +124,18 @@
 
 /* USER CODE BEGIN EXPORTED_VARIABLES */
 
+#if (USBD_VIDEO_PATTERN_ENABLED == 1U)
+/* Test pattern generated as it is sent, in place of the producers for YUY2 and NV12 */
+USBD_VideoPattern_HandleTypeDef VIDEO_Pattern;
+#endif /* USBD_VIDEO_PATTERN_ENABLED */
+
+/* Images from the producers, USBD_VideoQueue_Acquire() then USBD_VideoQueue_Submit() */
+USBD_VideoQueue_HandleTypeDef VIDEO_Queue;
+
+/* Format, size and rate the host committed, for the producers to follow */
+USBD_VIDEO_StreamTypeDef VIDEO_Stream;
+__IO uint8_t VIDEO_Streaming = 0U;
+
 /* USER CODE END EXPORTED_VARIABLES */
 
 /**
@@ -128,7 +150,7 @@
 static int8_t VIDEO_Itf_Init(void);
 static int8_t VIDEO_Itf_DeInit(void);
 static int8_t VIDEO_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length);
-static int8_t VIDEO_Itf_Data(uint8_t **pbuf, uint16_t *psize, uint16_t *pcktidx);
+static int8_t VIDEO_Itf_Data(USBD_VIDEO_FrameTypeDef *frame);
 
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
@@ -157,9 +179,11 @@ USBD_VIDEO_ItfTypeDef USBD_VIDEO_fops_FS =
   */
 static int8_t VIDEO_Itf_Init(void)
 {
-  /*
-     Add your initialization code here
-  */
+  /* Once only, producers may hold buffers over a new configuration */
+  if (VIDEO_Queue.frame_size == 0U)
+  {
+    USBD_VideoQueue_Init(&VIDEO_Queue, VIDEO_Pool, VIDEO_QUEUE_FRAME_SIZE);
+  }
 
   return (0);
 }
@@ -189,22 +213,53 @@ static int8_t VIDEO_Itf_DeInit(void)
   */
 static int8_t VIDEO_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
 {
+  switch (cmd)
+  {
+  case VIDEO_CMD_START:
+    if ((pbuf != NULL) && (length == sizeof(VIDEO_Stream)))
+    {
+      (void)memcpy(&VIDEO_Stream, pbuf, sizeof(VIDEO_Stream));
+      /* An image waiting may be in the format of the previous commit */
+      USBD_VideoQueue_Flush(&VIDEO_Queue);
+#if (USBD_VIDEO_PATTERN_ENABLED == 1U)
+      USBD_VideoPattern_Start(&VIDEO_Pattern, &VIDEO_Stream);
+#endif /* USBD_VIDEO_PATTERN_ENABLED */
+      VIDEO_Streaming = 1U;
+    }
+    break;
+
+  case VIDEO_CMD_STOP:
+    VIDEO_Streaming = 0U;
+    USBD_VideoQueue_Flush(&VIDEO_Queue);
+    break;
+
+  default:
+    break;
+  }
 
   return (0);
 }
 
 /**
   * @brief  TEMPLATE_Data
-  *         Manage the UVC data packets
-  * @param  pbuf: pointer to the buffer data to be filled
-  * @param  psize: pointer tot he current packet size to be filled
-  * @param  pcktidx: pointer to the current packet index in the current image
-  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  *         Hand the next image to the class, which sends it from this buffer
+  * @param  frame: to be filled with the image address, size and capture time.
+  *         UVC_FRAME_HEADROOM bytes before the address must be free. The
+  *         buffer given by the previous call is no longer in use.
+  * @retval Result of the operation: USBD_OK if an image is given else USBD_FAIL
   */
-static int8_t VIDEO_Itf_Data(uint8_t **pbuf, uint16_t *psize, uint16_t *pcktidx)
+static int8_t VIDEO_Itf_Data(USBD_VIDEO_FrameTypeDef *frame)
 {
-
-  return (0);
+#if (USBD_VIDEO_PATTERN_ENABLED == 1U)
+  /* Generated while the class sends it, MJPEG cannot be */
+  if (VIDEO_Stream.format != UVC_FORMAT_MJPEG)
+  {
+    return USBD_VideoPattern_Next(&VIDEO_Pattern, frame);
+  }
+#endif /* USBD_VIDEO_PATTERN_ENABLED */
+
+  /* Newest complete image from the producers */
+  return USBD_VideoQueue_Next(&VIDEO_Queue, frame);
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
@@ -27,6 +27,8 @@ extern "C" {
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_video.h"
+#include "usbd_video_queue.h"
+#include "usbd_video_pattern.h"
 
 /* USER CODE BEGIN INCLUDE */
 
@@ -91,6 +93,13 @@ extern USBD_VIDEO_ItfTypeDef USBD_VIDEO_fops_FS;
 
 /* USER CODE BEGIN EXPORTED_VARIABLES */
 
+#if (USBD_VIDEO_PATTERN_ENABLED == 1U)
+extern USBD_VideoPattern_HandleTypeDef VIDEO_Pattern;
+#endif /* USBD_VIDEO_PATTERN_ENABLED */
+extern USBD_VideoQueue_HandleTypeDef VIDEO_Queue;
+extern USBD_VIDEO_StreamTypeDef VIDEO_Stream;
+extern __IO uint8_t VIDEO_Streaming;
+
 /* USER CODE END EXPORTED_VARIABLES */
 
 /**
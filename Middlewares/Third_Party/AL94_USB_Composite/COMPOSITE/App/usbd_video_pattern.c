@@ -0,0 +1,308 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_video_pattern.c
+  * @brief          : Test pattern generated as the UVC payloads are sent.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           The pattern is never held as an image: USBD_VideoPattern_Next()
+  *           gives the class an image without data and a fill callback, and
+  *           the class has each payload's bytes written as it arms it. A line
+  *           is rendered once into the handle and copied to the payloads it
+  *           spans, so streams of the largest frame at the highest rate need
+  *           the handle only, which also holds the payload buffer the class
+  *           builds each payload in.
+  *
+  *           YUY2 and NV12 are generated, in the size the host committed:
+  *             - the top two thirds are 75% colour bars,
+  *             - the bottom third a luma ramp moving by 4 pixels an image,
+  *               over a U ramp top to bottom,
+  *             - the top left corner the number of images sent since the
+  *               stream started, USBD_VIDEO_PATTERN_DIGITS decimal digits.
+  *           The counter shows images the host lost, the bars and ramps the
+  *           colour conversion and scaling of the host path.
+  *
+  *           MJPEG cannot be generated: with it committed
+  *           USBD_VideoPattern_Next() has no image. usbd_video_if.c then
+  *           takes the images from the frame queue, whose buffers are only
+  *           sized for MJPEG, and the stream carries empty payloads until a
+  *           producer submits one.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_video_pattern.h"
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define VIDEO_PATTERN_NO_LINE            0xFFFFFFFFU
+
+/* Counter digits, 3x5 dots, a row per entry with the left dot in bit 2 */
+#define VIDEO_PATTERN_FONT_W             3U
+#define VIDEO_PATTERN_FONT_H             5U
+
+/* Counter levels */
+#define VIDEO_PATTERN_Y_LIT              235U
+#define VIDEO_PATTERN_Y_DARK             16U
+
+/* Private variables ---------------------------------------------------------*/
+static const uint8_t VideoPattern_Font[10][VIDEO_PATTERN_FONT_H] =
+{
+  {7U, 5U, 5U, 5U, 7U},
+  {2U, 6U, 2U, 2U, 7U},
+  {7U, 1U, 7U, 4U, 7U},
+  {7U, 1U, 7U, 1U, 7U},
+  {5U, 5U, 7U, 1U, 1U},
+  {7U, 4U, 7U, 1U, 7U},
+  {7U, 4U, 7U, 5U, 7U},
+  {7U, 1U, 1U, 1U, 1U},
+  {7U, 5U, 7U, 5U, 7U},
+  {7U, 5U, 7U, 1U, 7U},
+};
+
+/* 75% bars, BT.601 video range: white, yellow, cyan, green, magenta, red, blue, black */
+static const uint8_t VideoPattern_Bars[8][3] =
+{
+  {180U, 128U, 128U},
+  {162U,  44U, 142U},
+  {131U, 156U,  44U},
+  {112U,  72U,  58U},
+  { 84U, 184U, 198U},
+  { 65U, 100U, 212U},
+  { 35U, 212U, 114U},
+  { 16U, 128U, 128U},
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static void VideoPattern_Fill(USBD_VIDEO_FrameTypeDef *frame, uint8_t *dst, uint32_t offset, uint32_t len);
+static void VideoPattern_Line(USBD_VideoPattern_HandleTypeDef *hpattern, uint32_t line);
+static void VideoPattern_Pixel(const USBD_VideoPattern_HandleTypeDef *hpattern, uint32_t x, uint32_t y,
+                               uint8_t *yuv);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Follow the settings the host committed, the counter restarts
+  * @param  hpattern: pattern instance
+  * @param  stream: format, size and rate given with VIDEO_CMD_START
+  * @retval None
+  */
+void USBD_VideoPattern_Start(USBD_VideoPattern_HandleTypeDef *hpattern, const USBD_VIDEO_StreamTypeDef *stream)
+{
+  uint32_t width = stream->width;
+  uint32_t height = stream->height;
+
+  (void)memset(hpattern, 0, sizeof(*hpattern));
+  hpattern->stream = *stream;
+  hpattern->line = VIDEO_PATTERN_NO_LINE;
+  hpattern->scale = (uint16_t)MAX(height / 60U, 1U);
+
+  switch (stream->format)
+  {
+  case UVC_FORMAT_YUY2:
+    hpattern->stride = width * 2U;
+    hpattern->frame_size = UVC_FRAME_SIZE_YUY2(width, height);
+    break;
+
+  case UVC_FORMAT_NV12:
+    hpattern->stride = width;
+    hpattern->frame_size = UVC_FRAME_SIZE_NV12(width, height);
+    break;
+
+  default:
+    break;
+  }
+
+  /* Lines are rendered whole, pixels in pairs */
+  if ((hpattern->stride > USBD_VIDEO_PATTERN_LINE_SIZE) || ((width & 1U) != 0U) || ((height & 1U) != 0U))
+  {
+    hpattern->stride = 0U;
+    hpattern->frame_size = 0U;
+  }
+}
+
+/**
+  * @brief  Image for the class to send next, generated as it is sent
+  * @param  hpattern: pattern instance
+  * @param  frame: receives the image
+  * @note   Call from the class Data callback.
+  * @retval USBD_OK, USBD_FAIL when the committed format cannot be generated
+  */
+int8_t USBD_VideoPattern_Next(USBD_VideoPattern_HandleTypeDef *hpattern, USBD_VIDEO_FrameTypeDef *frame)
+{
+  uint32_t count = hpattern->count;
+  uint32_t i;
+
+  if (hpattern->stride == 0U)
+  {
+    return (int8_t)USBD_FAIL;
+  }
+
+  for (i = USBD_VIDEO_PATTERN_DIGITS; i > 0U; i--)
+  {
+    hpattern->digits[i - 1U] = (uint8_t)(count % 10U);
+    count /= 10U;
+  }
+
+  /* The lines of the previous image are stale */
+  hpattern->line = VIDEO_PATTERN_NO_LINE;
+
+  frame->data = NULL;
+  frame->size = hpattern->frame_size;
+  frame->pts = USBD_VIDEO_GetClock();
+  frame->fill = VideoPattern_Fill;
+  frame->context = hpattern;
+  frame->payload = (uint8_t *)hpattern->payload;
+
+  hpattern->count++;
+
+  return (int8_t)USBD_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Write image bytes of the pattern, the class fill callback
+  * @param  frame: image given by USBD_VideoPattern_Next()
+  * @param  dst: payload data
+  * @param  offset: first image byte
+  * @param  len: image bytes
+  * @retval None
+  */
+static void VideoPattern_Fill(USBD_VIDEO_FrameTypeDef *frame, uint8_t *dst, uint32_t offset, uint32_t len)
+{
+  USBD_VideoPattern_HandleTypeDef *hpattern = (USBD_VideoPattern_HandleTypeDef *)frame->context;
+  uint32_t line;
+  uint32_t col;
+  uint32_t n;
+
+  /* NV12 chroma lines follow the luma ones with the same stride */
+  while (len > 0U)
+  {
+    line = offset / hpattern->stride;
+    col = offset % hpattern->stride;
+    n = MIN(hpattern->stride - col, len);
+
+    if (line != hpattern->line)
+    {
+      VideoPattern_Line(hpattern, line);
+    }
+
+    (void)memcpy(dst, &hpattern->line_buf[col], n);
+    dst += n;
+    offset += n;
+    len -= n;
+  }
+}
+
+/**
+  * @brief  Render a line of the image into the handle
+  * @param  hpattern: pattern instance
+  * @param  line: line in memory order, NV12 chroma lines after the luma ones
+  * @retval None
+  */
+static void VideoPattern_Line(USBD_VideoPattern_HandleTypeDef *hpattern, uint32_t line)
+{
+  uint32_t width = hpattern->stream.width;
+  uint32_t height = hpattern->stream.height;
+  uint8_t *buf = hpattern->line_buf;
+  uint8_t p0[3];
+  uint8_t p1[3];
+  uint32_t x;
+
+  for (x = 0U; x < width; x += 2U)
+  {
+    if (hpattern->stream.format == UVC_FORMAT_YUY2)
+    {
+      /* Y0 U Y1 V, the chroma of the left pixel */
+      VideoPattern_Pixel(hpattern, x, line, p0);
+      VideoPattern_Pixel(hpattern, x + 1U, line, p1);
+      buf[(2U * x) + 0U] = p0[0];
+      buf[(2U * x) + 1U] = p0[1];
+      buf[(2U * x) + 2U] = p1[0];
+      buf[(2U * x) + 3U] = p0[2];
+    }
+    else if (line < height)
+    {
+      VideoPattern_Pixel(hpattern, x, line, p0);
+      VideoPattern_Pixel(hpattern, x + 1U, line, p1);
+      buf[x] = p0[0];
+      buf[x + 1U] = p1[0];
+    }
+    else
+    {
+      /* U V of the top left pixel of each 2x2 block */
+      VideoPattern_Pixel(hpattern, x, (line - height) * 2U, p0);
+      buf[x] = p0[1];
+      buf[x + 1U] = p0[2];
+    }
+  }
+
+  hpattern->line = line;
+}
+
+/**
+  * @brief  Colour of a pixel of the current image
+  * @param  hpattern: pattern instance
+  * @param  x: column
+  * @param  y: row
+  * @param  yuv: receives Y, U and V
+  * @retval None
+  */
+static void VideoPattern_Pixel(const USBD_VideoPattern_HandleTypeDef *hpattern, uint32_t x, uint32_t y,
+                               uint8_t *yuv)
+{
+  uint32_t width = hpattern->stream.width;
+  uint32_t height = hpattern->stream.height;
+  uint32_t scale = hpattern->scale;
+  uint32_t cell = (VIDEO_PATTERN_FONT_W + 1U) * scale;
+  uint32_t origin = 2U * scale;
+  uint32_t ramp = (height * 2U) / 3U;
+  uint32_t dx;
+  uint32_t dy;
+  uint8_t row;
+
+  /* Counter, a dark box with a dot column and row between the digits */
+  if ((x >= origin) && (x < (origin + (USBD_VIDEO_PATTERN_DIGITS * cell))) &&
+      (y >= origin) && (y < (origin + ((VIDEO_PATTERN_FONT_H + 1U) * scale))))
+  {
+    dx = ((x - origin) % cell) / scale;
+    dy = (y - origin) / scale;
+    row = (dy < VIDEO_PATTERN_FONT_H) ?
+          VideoPattern_Font[hpattern->digits[(x - origin) / cell]][dy] : 0U;
+
+    yuv[0] = ((dx < VIDEO_PATTERN_FONT_W) && (((row >> (2U - dx)) & 1U) != 0U)) ?
+             (uint8_t)VIDEO_PATTERN_Y_LIT : (uint8_t)VIDEO_PATTERN_Y_DARK;
+    yuv[1] = 128U;
+    yuv[2] = 128U;
+  }
+  else if (y < ramp)
+  {
+    (void)memcpy(yuv, VideoPattern_Bars[(x * 8U) / width], 3U);
+  }
+  else
+  {
+    yuv[0] = (uint8_t)(16U + ((((x + (hpattern->count * 4U)) % width) * 219U) / width));
+    yuv[1] = (uint8_t)(16U + (((y - ramp) * 224U) / (height - ramp)));
+    yuv[2] = 128U;
+  }
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,112 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_video_pattern.h
+  * @brief          : Header for usbd_video_pattern.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_VIDEO_PATTERN_H__
+#define __USBD_VIDEO_PATTERN_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_video.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_VIDEO_PATTERN USBD_VIDEO_PATTERN
+  * @brief Test pattern generated as the UVC payloads are sent
+  * @{
+  */
+
+/** @defgroup USBD_VIDEO_PATTERN_Exported_Defines USBD_VIDEO_PATTERN_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* Set to 1 to stream the test pattern in place of the frame queue for YUY2
+   and NV12. MJPEG still comes from the queue, which then only needs buffers
+   of MJPEG images */
+#ifndef USBD_VIDEO_PATTERN_ENABLED
+#define USBD_VIDEO_PATTERN_ENABLED       0U
+#endif /* USBD_VIDEO_PATTERN_ENABLED */
+
+/* Digits of the frame counter drawn in the top left corner */
+#ifndef USBD_VIDEO_PATTERN_DIGITS
+#define USBD_VIDEO_PATTERN_DIGITS        6U
+#endif /* USBD_VIDEO_PATTERN_DIGITS */
+
+/* Longest line rendered, a YUY2 line of the largest frame */
+#define USBD_VIDEO_PATTERN_LINE_SIZE     (UVC_WIDTH * 2U)
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_VIDEO_PATTERN_Exported_Types USBD_VIDEO_PATTERN_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+typedef struct
+{
+  USBD_VIDEO_StreamTypeDef stream;
+  uint32_t stride;         /* Bytes per line, 0 when the format cannot be generated */
+  uint32_t frame_size;
+  uint32_t count;          /* Images generated since the stream started */
+  uint32_t line;           /* Line held in line_buf, 0xFFFFFFFF when none */
+  uint16_t scale;          /* Pixels per dot of the counter */
+  uint8_t digits[USBD_VIDEO_PATTERN_DIGITS];
+  uint8_t line_buf[USBD_VIDEO_PATTERN_LINE_SIZE];
+  uint32_t payload[(UVC_MAX_PAYLOAD + 3U) / 4U];   /* Built by the class with fill */
+} USBD_VideoPattern_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_VIDEO_PATTERN_Exported_FunctionsPrototype USBD_VIDEO_PATTERN_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void USBD_VideoPattern_Start(USBD_VideoPattern_HandleTypeDef *hpattern, const USBD_VIDEO_StreamTypeDef *stream);
+int8_t USBD_VideoPattern_Next(USBD_VideoPattern_HandleTypeDef *hpattern, USBD_VIDEO_FrameTypeDef *frame);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_VIDEO_PATTERN_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
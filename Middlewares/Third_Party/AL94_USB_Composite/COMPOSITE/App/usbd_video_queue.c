@@ -0,0 +1,303 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_video_queue.c
+  * @brief          : Frame buffers between the image producers and the UVC
+  *                   stream.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           Producers work on whole images at their own pace:
+  *             - USBD_VideoQueue_Acquire() gives a free buffer,
+  *             - the image is captured or encoded into it,
+  *             - USBD_VideoQueue_Submit() hands it over with its capture
+  *               time, taken from USBD_VIDEO_GetClock().
+  *
+  *           The class asks for an image each time the previous one is out,
+  *           from the USB interrupt, and USBD_VideoQueue_Next() answers with
+  *           the newest complete one. Three buffers let the stream, the
+  *           newest image and the producer never wait on each other:
+  *             - an image submitted while an older one still waits replaces
+  *               it, the older one is counted dropped,
+  *             - when nothing new is complete the last image is sent again
+  *               and counted repeated, or with USBD_VIDEO_QUEUE_REPEAT at 0
+  *               the class sends empty payloads until there is.
+  *
+  *           The buffers keep USBD_VIDEO_QUEUE_HEADROOM bytes in front of
+  *           each image for the class to write the payload headers.
+  *           USBD_VideoQueue_Flush() frees the images sent and waiting when
+  *           the stream stops or starts, the host may have changed format.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_video_queue.h"
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define VIDEO_QUEUE_NONE                 ((uint8_t)USBD_VIDEO_QUEUE_SLOTS)
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t VideoQueue_Find(const USBD_VideoQueue_HandleTypeDef *hqueue, const uint8_t *buf,
+                               USBD_VideoQueue_SlotStateTypeDef state);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Share the storage between the buffers, all free
+  * @param  hqueue: queue instance
+  * @param  pool: USBD_VIDEO_QUEUE_POOL_SIZE(frame_size) bytes, word aligned
+  * @param  frame_size: largest image
+  * @retval None
+  */
+void USBD_VideoQueue_Init(USBD_VideoQueue_HandleTypeDef *hqueue, uint8_t *pool, uint32_t frame_size)
+{
+  uint32_t stride = USBD_VIDEO_QUEUE_HEADROOM + ((frame_size + 3U) & ~3U);
+  uint32_t i;
+
+  (void)memset(hqueue, 0, sizeof(*hqueue));
+
+  for (i = 0U; i < USBD_VIDEO_QUEUE_SLOTS; i++)
+  {
+    hqueue->slot[i].data = &pool[(i * stride) + USBD_VIDEO_QUEUE_HEADROOM];
+    hqueue->slot[i].state = VIDEO_SLOT_FREE;
+  }
+
+  hqueue->frame_size = frame_size;
+  hqueue->ready = VIDEO_QUEUE_NONE;
+  hqueue->sending = VIDEO_QUEUE_NONE;
+}
+
+/**
+  * @brief  Take a buffer to fill with the next image
+  * @param  hqueue: queue instance
+  * @param  capacity: receives the largest image it holds, may be NULL
+  * @retval buffer, NULL when the producers already hold all the free ones
+  */
+uint8_t *USBD_VideoQueue_Acquire(USBD_VideoQueue_HandleTypeDef *hqueue, uint32_t *capacity)
+{
+  uint8_t *buf = NULL;
+  uint32_t primask;
+  uint32_t i;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  for (i = 0U; i < USBD_VIDEO_QUEUE_SLOTS; i++)
+  {
+    if (hqueue->slot[i].state == VIDEO_SLOT_FREE)
+    {
+      hqueue->slot[i].state = VIDEO_SLOT_WRITING;
+      buf = hqueue->slot[i].data;
+      break;
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  if (capacity != NULL)
+  {
+    *capacity = (buf != NULL) ? hqueue->frame_size : 0U;
+  }
+
+  return buf;
+}
+
+/**
+  * @brief  Hand over a complete image, it replaces one still waiting
+  * @param  hqueue: queue instance
+  * @param  buf: buffer from USBD_VideoQueue_Acquire()
+  * @param  size: image bytes
+  * @param  pts: capture time, from USBD_VIDEO_GetClock()
+  * @retval USBD_OK, USBD_FAIL when the buffer is not held or the image too large
+  */
+uint8_t USBD_VideoQueue_Submit(USBD_VideoQueue_HandleTypeDef *hqueue, uint8_t *buf, uint32_t size, uint32_t pts)
+{
+  uint8_t idx = VideoQueue_Find(hqueue, buf, VIDEO_SLOT_WRITING);
+  uint32_t primask;
+
+  if (idx == VIDEO_QUEUE_NONE)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if ((size == 0U) || (size > hqueue->frame_size))
+  {
+    hqueue->slot[idx].state = VIDEO_SLOT_FREE;
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hqueue->slot[idx].size = size;
+  hqueue->slot[idx].pts = pts;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hqueue->ready != VIDEO_QUEUE_NONE)
+  {
+    hqueue->slot[hqueue->ready].state = VIDEO_SLOT_FREE;
+    hqueue->stats.dropped++;
+  }
+
+  hqueue->slot[idx].state = VIDEO_SLOT_READY;
+  hqueue->ready = idx;
+  hqueue->stats.submitted++;
+
+  __set_PRIMASK(primask);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  Give a buffer back without submitting it
+  * @param  hqueue: queue instance
+  * @param  buf: buffer from USBD_VideoQueue_Acquire()
+  * @retval None
+  */
+void USBD_VideoQueue_Release(USBD_VideoQueue_HandleTypeDef *hqueue, uint8_t *buf)
+{
+  uint8_t idx = VideoQueue_Find(hqueue, buf, VIDEO_SLOT_WRITING);
+
+  if (idx != VIDEO_QUEUE_NONE)
+  {
+    hqueue->slot[idx].state = VIDEO_SLOT_FREE;
+  }
+}
+
+/**
+  * @brief  Free the image being sent and the one waiting, buffers held by
+  *         the producers are left to them
+  * @param  hqueue: queue instance
+  * @note   Call with the stream stopped, or from the class Control callback.
+  * @retval None
+  */
+void USBD_VideoQueue_Flush(USBD_VideoQueue_HandleTypeDef *hqueue)
+{
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hqueue->ready != VIDEO_QUEUE_NONE)
+  {
+    hqueue->slot[hqueue->ready].state = VIDEO_SLOT_FREE;
+    hqueue->ready = VIDEO_QUEUE_NONE;
+  }
+
+  if (hqueue->sending != VIDEO_QUEUE_NONE)
+  {
+    hqueue->slot[hqueue->sending].state = VIDEO_SLOT_FREE;
+    hqueue->sending = VIDEO_QUEUE_NONE;
+  }
+
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Image for the class to send next, the one sent so far is freed
+  * @param  hqueue: queue instance
+  * @param  frame: receives the image
+  * @note   Call from the class Data callback.
+  * @retval USBD_OK, USBD_FAIL when there is nothing to send
+  */
+int8_t USBD_VideoQueue_Next(USBD_VideoQueue_HandleTypeDef *hqueue, USBD_VIDEO_FrameTypeDef *frame)
+{
+  USBD_VideoQueue_SlotTypeDef *slot;
+  int8_t ret = (int8_t)USBD_OK;
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hqueue->ready != VIDEO_QUEUE_NONE)
+  {
+    if (hqueue->sending != VIDEO_QUEUE_NONE)
+    {
+      hqueue->slot[hqueue->sending].state = VIDEO_SLOT_FREE;
+    }
+
+    hqueue->sending = hqueue->ready;
+    hqueue->ready = VIDEO_QUEUE_NONE;
+    hqueue->slot[hqueue->sending].state = VIDEO_SLOT_SENDING;
+    hqueue->stats.sent++;
+  }
+  else if ((USBD_VIDEO_QUEUE_REPEAT == 1U) && (hqueue->sending != VIDEO_QUEUE_NONE))
+  {
+    hqueue->stats.repeated++;
+  }
+  else
+  {
+    if (hqueue->sending != VIDEO_QUEUE_NONE)
+    {
+      hqueue->slot[hqueue->sending].state = VIDEO_SLOT_FREE;
+      hqueue->sending = VIDEO_QUEUE_NONE;
+    }
+    ret = (int8_t)USBD_FAIL;
+  }
+
+  if (ret == (int8_t)USBD_OK)
+  {
+    slot = &hqueue->slot[hqueue->sending];
+    frame->data = slot->data;
+    frame->size = slot->size;
+    frame->pts = slot->pts;
+  }
+
+  __set_PRIMASK(primask);
+
+  return ret;
+}
+
+/**
+  * @brief  Copy the counters
+  * @param  hqueue: queue instance
+  * @param  stats: receives the counters
+  * @retval None
+  */
+void USBD_VideoQueue_GetStats(const USBD_VideoQueue_HandleTypeDef *hqueue, USBD_VideoQueue_StatsTypeDef *stats)
+{
+  *stats = hqueue->stats;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Slot of a buffer
+  * @param  hqueue: queue instance
+  * @param  buf: image address
+  * @param  state: state the slot must be in
+  * @retval slot index, VIDEO_QUEUE_NONE when not found
+  */
+static uint8_t VideoQueue_Find(const USBD_VideoQueue_HandleTypeDef *hqueue, const uint8_t *buf,
+                               USBD_VideoQueue_SlotStateTypeDef state)
+{
+  uint8_t i;
+
+  for (i = 0U; i < USBD_VIDEO_QUEUE_SLOTS; i++)
+  {
+    if ((hqueue->slot[i].data == buf) && (hqueue->slot[i].state == state))
+    {
+      return i;
+    }
+  }
+
+  return VIDEO_QUEUE_NONE;
+}
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
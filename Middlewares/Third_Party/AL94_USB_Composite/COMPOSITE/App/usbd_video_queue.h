@@ -0,0 +1,147 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_video_queue.h
+  * @brief          : Header for usbd_video_queue.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2020 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_VIDEO_QUEUE_H__
+#define __USBD_VIDEO_QUEUE_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_video.h"
+
+/** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
+  * @brief For Usb device.
+  * @{
+  */
+
+/** @defgroup USBD_VIDEO_QUEUE USBD_VIDEO_QUEUE
+  * @brief Frame buffers between the image producers and the UVC stream
+  * @{
+  */
+
+/** @defgroup USBD_VIDEO_QUEUE_Exported_Defines USBD_VIDEO_QUEUE_Exported_Defines
+  * @brief Defines.
+  * @{
+  */
+
+/* One buffer sent, one complete and waiting, one being filled */
+#define USBD_VIDEO_QUEUE_SLOTS           3U
+
+/* Largest image a producer can submit, in any format offered */
+#ifndef USBD_VIDEO_QUEUE_FRAME_SIZE
+#define USBD_VIDEO_QUEUE_FRAME_SIZE      UVC_MAX_FRAME_SIZE
+#endif /* USBD_VIDEO_QUEUE_FRAME_SIZE */
+
+/* Set to 0 to send empty payloads rather than the last image again when
+   the producer has nothing new */
+#ifndef USBD_VIDEO_QUEUE_REPEAT
+#define USBD_VIDEO_QUEUE_REPEAT          1U
+#endif /* USBD_VIDEO_QUEUE_REPEAT */
+
+/* Placement of the buffers, the default section is a NOLOAD region of the AXI SRAM */
+#ifndef USBD_VIDEO_QUEUE_SECTION
+#define USBD_VIDEO_QUEUE_SECTION         __attribute__((section(".usb_video")))
+#endif /* USBD_VIDEO_QUEUE_SECTION */
+
+/* Free bytes kept in front of each image for the payload headers, the image stays word aligned */
+#define USBD_VIDEO_QUEUE_HEADROOM        ((UVC_FRAME_HEADROOM + 3U) & ~3U)
+
+/* Bytes of the storage given to USBD_VideoQueue_Init() */
+#define USBD_VIDEO_QUEUE_POOL_SIZE(size) (USBD_VIDEO_QUEUE_SLOTS * (USBD_VIDEO_QUEUE_HEADROOM + (((size) + 3U) & ~3U)))
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_VIDEO_QUEUE_Exported_Types USBD_VIDEO_QUEUE_Exported_Types
+  * @brief Types.
+  * @{
+  */
+
+typedef enum
+{
+  VIDEO_SLOT_FREE = 0U,
+  VIDEO_SLOT_WRITING,      /* Acquired by a producer */
+  VIDEO_SLOT_READY,        /* Submitted, the newest complete image */
+  VIDEO_SLOT_SENDING,      /* Handed to the class */
+} USBD_VideoQueue_SlotStateTypeDef;
+
+typedef struct
+{
+  uint8_t *data;
+  uint32_t size;
+  uint32_t pts;
+  __IO USBD_VideoQueue_SlotStateTypeDef state;
+} USBD_VideoQueue_SlotTypeDef;
+
+typedef struct
+{
+  uint32_t submitted;
+  uint32_t sent;           /* Images handed to the class */
+  uint32_t dropped;        /* Replaced by a newer one before being sent */
+  uint32_t repeated;       /* Sent again, nothing newer was complete */
+} USBD_VideoQueue_StatsTypeDef;
+
+typedef struct
+{
+  USBD_VideoQueue_SlotTypeDef slot[USBD_VIDEO_QUEUE_SLOTS];
+  uint32_t frame_size;
+  __IO uint8_t ready;      /* Slot index, USBD_VIDEO_QUEUE_SLOTS when none */
+  __IO uint8_t sending;
+  USBD_VideoQueue_StatsTypeDef stats;
+} USBD_VideoQueue_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_VIDEO_QUEUE_Exported_FunctionsPrototype USBD_VIDEO_QUEUE_Exported_FunctionsPrototype
+  * @brief Public functions declaration.
+  * @{
+  */
+
+void USBD_VideoQueue_Init(USBD_VideoQueue_HandleTypeDef *hqueue, uint8_t *pool, uint32_t frame_size);
+uint8_t *USBD_VideoQueue_Acquire(USBD_VideoQueue_HandleTypeDef *hqueue, uint32_t *capacity);
+uint8_t USBD_VideoQueue_Submit(USBD_VideoQueue_HandleTypeDef *hqueue, uint8_t *buf, uint32_t size, uint32_t pts);
+void USBD_VideoQueue_Release(USBD_VideoQueue_HandleTypeDef *hqueue, uint8_t *buf);
+void USBD_VideoQueue_Flush(USBD_VideoQueue_HandleTypeDef *hqueue);
+int8_t USBD_VideoQueue_Next(USBD_VideoQueue_HandleTypeDef *hqueue, USBD_VIDEO_FrameTypeDef *frame);
+void USBD_VideoQueue_GetStats(const USBD_VideoQueue_HandleTypeDef *hqueue, USBD_VideoQueue_StatsTypeDef *stats);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_VIDEO_QUEUE_H__ */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -36,12 +36,34 @@
 #define AUDIO_STREAMING_INTERFACE_DESC_SIZE           0x07U
 
 #define AUDIO_CONTROL_MUTE                            0x0001U
+#define AUDIO_CONTROL_VOLUME                          0x0002U
+#define AUDIO_CONTROL_BASS                            0x0004U
+#define AUDIO_CONTROL_TREBLE                          0x0010U
+
+/* Feature Unit control selectors */
+#define AUDIO_MUTE_CONTROL                            0x01U
+#define AUDIO_VOLUME_CONTROL                          0x02U
+#define AUDIO_BASS_CONTROL                            0x03U
+#define AUDIO_TREBLE_CONTROL                          0x05U
+
+/* Bass and treble range in 1/4 dB, +/-12 dB */
+#define AUDIO_TONE_MIN                                (-48)
+#define AUDIO_TONE_MAX                                48
+#define AUDIO_TONE_RES                                1
 
 #define AUDIO_FORMAT_TYPE_I                           0x01U
 #define AUDIO_FORMAT_TYPE_III                         0x03U
 
 #define AUDIO_ENDPOINT_GENERAL                        0x01U
 
+/* Endpoint control selector and its bmAttributes bit */
+#define AUDIO_SAMPLING_FREQ_CONTROL                   0x01U
+#define AUDIO_EP_ATTR_SAMPLING_FREQ                   0x01U
+#define AUDIO_SAMPLING_FREQ_SIZE                      0x03U
+
+/* Type I format descriptor with a discrete list of n sampling frequencies */
+#define AUDIO_FORMAT_TYPE_I_DESC_SIZE(n)              (0x08U + (0x03U * (n)))
+
 #define AUDIO_REQ_GET_CUR                             0x81U
 #define AUDIO_REQ_GET_MIN                             0x82
 #define AUDIO_REQ_GET_MAX                             0x83
@@ -49,6 +71,8 @@
 #define AUDIO_REQ_SET_CUR                             0x01U
 
 #define AUDIO_STREAMING_CTRL                          0x02U
+/* control.unit of a request addressed to the streaming endpoint */
+#define AUDIO_ENDPOINT_CTRL                           0xFFU
 
 
 /* Audio Commands enmueration */
@@ -80,5 +104,6 @@ typedef struct
   uint8_t data[USB_MAX_EP0_SIZE];
   uint8_t len;
   uint8_t unit;
+  uint8_t selector;
 } USBD_AUDIO_ControlTypeDef;
 #endif /* _AUDIO_COMMON_USBD_AUDIO_H_ */
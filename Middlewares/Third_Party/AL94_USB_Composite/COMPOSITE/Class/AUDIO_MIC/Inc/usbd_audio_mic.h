@@ -49,15 +49,55 @@ extern "C" {
 
 /* AUDIO Class Config */
 #define AUDIO_MIC_CHANNELS                                0x01
-#define AUDIO_MIC_SMPL_FREQ                               16000U
-#define USBD_AUDIO_MIC_CONFIG_DESC_SIZE                   (116 + AUDIO_MIC_CHANNELS)
+
+/* Sampling frequencies offered to the host, in increasing order */
+#ifndef AUDIO_MIC_FREQ_0
+#define AUDIO_MIC_FREQ_0                                  44100U
+#endif /* AUDIO_MIC_FREQ_0 */
+
+#ifndef AUDIO_MIC_FREQ_1
+#define AUDIO_MIC_FREQ_1                                  48000U
+#endif /* AUDIO_MIC_FREQ_1 */
+
+#ifndef AUDIO_MIC_FREQ_2
+#define AUDIO_MIC_FREQ_2                                  96000U
+#endif /* AUDIO_MIC_FREQ_2 */
+
+#define AUDIO_MIC_FREQ_NUM                                3U
+
+/* Rate used until the host selects one */
+#ifndef AUDIO_MIC_SMPL_FREQ
+#define AUDIO_MIC_SMPL_FREQ                               AUDIO_MIC_FREQ_1
+#endif /* AUDIO_MIC_SMPL_FREQ */
+
+/* Highest sampling rate the streaming ring is dimensioned for */
+#ifndef AUDIO_MIC_MAX_SMPL_FREQ
+#define AUDIO_MIC_MAX_SMPL_FREQ                           AUDIO_MIC_FREQ_2
+#endif /* AUDIO_MIC_MAX_SMPL_FREQ */
+
+/* Streaming alternate settings: 16-bit samples in 2 bytes or 24-bit
+   samples in 3 bytes */
+#define AUDIO_MIC_ALT_16BIT                               1U
+#define AUDIO_MIC_ALT_24BIT                               2U
+#define AUDIO_MIC_MAX_SUBFRAME                            3U
+
+/* Size of one streaming alternate setting: standard and class specific
+   interface, format, data endpoint and its class descriptor */
+#define AUDIO_MIC_FMT_DESC_SIZE                           AUDIO_FORMAT_TYPE_I_DESC_SIZE(AUDIO_MIC_FREQ_NUM)
+#define AUDIO_MIC_ALT_DESC_SIZE                           (9U + 7U + AUDIO_MIC_FMT_DESC_SIZE + 9U + 7U)
+
+/* Up to the zero bandwidth setting, then the two operational settings */
+#define AUDIO_MIC_ALT_DESC_OFFSET                         (73U + AUDIO_MIC_CHANNELS)
+#define USBD_AUDIO_MIC_CONFIG_DESC_SIZE                   (AUDIO_MIC_ALT_DESC_OFFSET + (2U * AUDIO_MIC_ALT_DESC_SIZE))
 
 
 
 #define AUDIO_MIC_VOL_MIN                                 0xDBE0
 #define AUDIO_MIC_VOL_RES                                 0x0023
 #define AUDIO_MIC_VOL_MAX                                 0x0000
-#define AUDIO_MIC_PACKET                                  (uint32_t)((((AUDIO_MIC_SMPL_FREQ/1000)+2)*8)*2)
+/* A packet carries one frame more than nominal when the ring runs ahead */
+#define AUDIO_MIC_EP_SIZE(subframe)                       ((((AUDIO_MIC_MAX_SMPL_FREQ + 999U) / 1000U) + 1U) * AUDIO_MIC_CHANNELS * (subframe))
+#define AUDIO_MIC_PACKET                                  (uint32_t)AUDIO_MIC_EP_SIZE(AUDIO_MIC_MAX_SUBFRAME)
 #define AUDIO_MIC_TERMINAL_ID                             1
 #define AUDIO_MIC_FU_ID                                   2
 #define AUDIO_MIC_OUT_TERMINAL_ID                         3
@@ -74,6 +114,15 @@ typedef enum
 /* Number of sub-packets in the audio transfer buffer.*/
 #define AUDIO_MIC_PACKET_NUM 20
 
+/* Nominal 1 ms packet at the highest rate, the ring holds AUDIO_MIC_PACKET_NUM of them */
+#define AUDIO_MIC_MAX_PACKET_NOMINAL                      ((AUDIO_MIC_MAX_SMPL_FREQ / 1000U) * AUDIO_MIC_CHANNELS * AUDIO_MIC_MAX_SUBFRAME)
+#define AUDIO_MIC_RING_SIZE                               (AUDIO_MIC_MAX_PACKET_NOMINAL * AUDIO_MIC_PACKET_NUM)
+
+/* Placement of the ring, the default section is a NOLOAD region of the AXI SRAM */
+#ifndef AUDIO_MIC_RING_SECTION
+#define AUDIO_MIC_RING_SECTION                            __attribute__((section(".usb_audio")))
+#endif /* AUDIO_MIC_RING_SECTION */
+
 #define TIMEOUT_VALUE 200
 
 
@@ -81,20 +130,28 @@ typedef struct
 {
   __IO uint32_t alt_setting;
   uint8_t channels;
+  uint8_t subframe;             /* Bytes per sample of the alternate setting */
   uint32_t frequency;
   __IO int16_t timeout;
-  uint16_t buffer_length;
-  uint16_t dataAmount;
+  uint32_t buffer_length;
   uint16_t paketDimension;
-  uint8_t state;
-  uint16_t rd_ptr;
-  uint16_t wr_ptr;
+  __IO uint8_t state;
+  __IO uint32_t rd_ptr;
+  __IO uint32_t wr_ptr;
+  uint32_t in_flight;
   uint8_t upper_treshold;
   uint8_t lower_treshold;
+  __IO uint32_t underrun;
+  __IO uint32_t overrun;
+  __IO uint32_t iso_incomplete; /* Packets the host missed, see IsoINIncomplete */
   USBD_AUDIO_ControlTypeDef control;
   uint8_t *buffer;
+  uint8_t mute;                 /* Feature Unit settings, reported by GET_CUR */
+  int8_t bass;
+  int8_t treble;
 } USBD_AUDIO_MIC_HandleTypeDef;
 
+/* Init is called again each time the host selects another rate or sample size */
 typedef struct
 {
   int8_t (*Init)(uint32_t AudioFreq, uint32_t BitRes, uint32_t ChnlNbr);
@@ -106,6 +163,7 @@ typedef struct
   int8_t (*Pause)(void);
   int8_t (*Resume)(void);
   int8_t (*CommandMgr)(uint8_t cmd);
+  int8_t (*ToneCtl)(uint8_t control, int8_t level); /* AUDIO_BASS/TREBLE_CONTROL in 1/4 dB */
 } USBD_AUDIO_MIC_ItfTypeDef;
 /**
 * @}
@@ -139,7 +197,10 @@ extern uint8_t AUDIO_MIC_STR_DESC_IDX;
 */
 uint8_t USBD_AUDIO_MIC_RegisterInterface(USBD_HandleTypeDef *pdev, 
                                          USBD_AUDIO_MIC_ItfTypeDef *fops);
-uint8_t USBD_AUDIO_MIC_Data_Transfer(USBD_HandleTypeDef *pdev, int16_t *audioData, uint16_t dataAmount);
+uint8_t USBD_AUDIO_MIC_Data_Transfer(USBD_HandleTypeDef *pdev, const void *audioData, uint16_t PCMSamples);
+uint8_t *USBD_AUDIO_MIC_GetWriteBuffer(USBD_HandleTypeDef *pdev, uint32_t *length);
+uint8_t USBD_AUDIO_MIC_CommitWrite(USBD_HandleTypeDef *pdev, uint32_t length);
+uint32_t USBD_AUDIO_MIC_GetLevel(USBD_HandleTypeDef *pdev);
 
   void USBD_Update_Audio_MIC_DESC(uint8_t *desc,
                                   uint8_t ac_itf,
@@ -20,20 +20,28 @@
 *             - 1 Audio Terminal Input
 *             - Audio Class-Specific AC Interfaces
 *             - Audio Class-Specific AS Interfaces
-*             - AudioControl Requests: mute and volume control
+*             - AudioControl Requests: mute, volume, bass and treble control
+*             - Endpoint Requests: SET_CUR and GET_CUR of the sampling frequency
 *             - Audio Synchronization type: Asynchronous
 *             - Multiple frequencies and channel number configurable using ad hoc
 *               init function
 *
 *          The current audio class version supports the following audio features:
 *             - Pulse Coded Modulation (PCM) format
-*             - Configurable sampling rate
-*             - Bit resolution: 16
+*             - Sampling rate AUDIO_MIC_FREQ_0 to _2, selected by the host
+*             - Bit resolution: 16 (alternate setting 1) or 24 (alternate setting 2)
 *             - Configurable Number of channels
-*             - Volume control
+*             - Volume control, bass and treble on the master channel
 *             - Mute/Unmute capability
 *             - Asynchronous Endpoints
 *
+*          Samples are exchanged through a statically allocated ring placed in
+*          AUDIO_MIC_RING_SECTION. The application is the single producer
+*          (USBD_AUDIO_MIC_Data_Transfer, or GetWriteBuffer/CommitWrite to fill
+*          the ring in place), DataIn is the single consumer and hands packets
+*          to the endpoint straight from the ring. Each side only moves its own
+*          index, so neither needs to mask interrupts.
+*
 * @note     This driver has been developed starting from the usbd_audio.c file
 *           included within the standard Cube Package for STM32F4
 *
@@ -95,6 +103,7 @@ uint8_t AUDIO_MIC_STR_DESC_IDX = _AUDIO_MIC_STR_DESC_IDX;
 /** @defgroup USBD_AUDIO_Private_Macros
   * @{
   */
+#define AUDIO_MIC_SAMPLE_FREQ(frq) (uint8_t)(frq), (uint8_t)((frq) >> 8), (uint8_t)((frq) >> 16)
 
 /**
   * @}
@@ -120,6 +129,11 @@ static void USBD_AUDIO_MIC_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupRe
 static void USBD_AUDIO_MIC_REQ_GetMaximum(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
 static void USBD_AUDIO_MIC_REQ_GetMinimum(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
 static void USBD_AUDIO_MIC_REQ_GetResolution(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint32_t USBD_AUDIO_MIC_RingFill(USBD_AUDIO_MIC_HandleTypeDef *haudio);
+static uint32_t USBD_AUDIO_MIC_RingAdvance(USBD_AUDIO_MIC_HandleTypeDef *haudio, uint32_t ptr, uint32_t length);
+static void USBD_AUDIO_MIC_RingReset(USBD_AUDIO_MIC_HandleTypeDef *haudio);
+static uint8_t USBD_AUDIO_MIC_CheckTimeout(USBD_HandleTypeDef *pdev);
+static void USBD_AUDIO_MIC_SetFormat(USBD_HandleTypeDef *pdev, USBD_AUDIO_MIC_HandleTypeDef *haudio);
 
 /**
   * @}
@@ -129,9 +143,11 @@ static void USBD_AUDIO_MIC_REQ_GetResolution(USBD_HandleTypeDef *pdev, USBD_Setu
   * @{
   */
 /* This dummy buffer with 0 values will be sent when there is no availble data */
-static uint8_t IsocInBuffDummy[48 * 4 * 2];
+static uint8_t IsocInBuffDummy[AUDIO_MIC_PACKET];
 static int16_t VOL_CUR;
 static USBD_AUDIO_MIC_HandleTypeDef haudioInstance;
+/* Streaming ring, sized for the highest rate so it never has to be reallocated */
+__ALIGN_BEGIN static uint8_t AUDIO_MIC_Ring[AUDIO_MIC_RING_SIZE] AUDIO_MIC_RING_SECTION __ALIGN_END;
 
 USBD_ClassTypeDef USBD_AUDIO_MIC =
     {
@@ -234,10 +250,11 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_MIC_CfgDesc[USBD_AUDIO_MIC_CONFIG_DESC_S
         0x01,                            /* bControlSize */
 
 #if (AUDIO_MIC_CHANNELS == 1)
-        0x02,
+        AUDIO_CONTROL_MUTE | AUDIO_CONTROL_VOLUME |
+        AUDIO_CONTROL_BASS | AUDIO_CONTROL_TREBLE,
         0x00,
 #else
-        0x00,
+        AUDIO_CONTROL_MUTE | AUDIO_CONTROL_BASS | AUDIO_CONTROL_TREBLE,
         0x02,
         0x02,
 #endif
@@ -294,17 +311,16 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_MIC_CfgDesc[USBD_AUDIO_MIC_CONFIG_DESC_S
         //73 + AUDIO_MIC_CHANNELS byte
 
         /* USB Microphone Standard AS Interface Descriptor - Audio Streaming Operational */
-        /* Interface 1, Alternate Setting 1                                           */
+        /* Interface 1, Alternate Setting 1, 16-bit samples                         */
         0x09,                          /* bLength */
         USB_DESC_TYPE_INTERFACE,       /* bDescriptorType */
         _AUDIO_MIC_AS_ITF_NBR,         /* bInterfaceNumber */
-        0x01,                          /* bAlternateSetting */
+        AUDIO_MIC_ALT_16BIT,           /* bAlternateSetting */
         0x01,                          /* bNumEndpoints */
         USB_DEVICE_CLASS_AUDIO,        /* bInterfaceClass */
         AUDIO_SUBCLASS_AUDIOSTREAMING, /* bInterfaceSubClass */
         AUDIO_PROTOCOL_UNDEFINED,      /* bInterfaceProtocol */
         0x00,                          /* iInterface */
-        //82 + AUDIO_MIC_CHANNELS byte
 
         /* USB Microphone Audio Streaming Interface Descriptor */
         AUDIO_STREAMING_INTERFACE_DESC_SIZE, /* bLength */
@@ -314,43 +330,95 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_MIC_CfgDesc[USBD_AUDIO_MIC_CONFIG_DESC_S
         0x01,                                /* bDelay */
         0x01,                                /* wFormatTag AUDIO_FORMAT_PCM  0x0001*/
         0x00,
-        //89 + AUDIO_MIC_CHANNELS byte
 
         /* USB Microphone Audio Type I Format Interface Descriptor */
-        0x0B,                            /* bLength */
+        AUDIO_MIC_FMT_DESC_SIZE,         /* bLength */
         AUDIO_INTERFACE_DESCRIPTOR_TYPE, /* bDescriptorType */
         AUDIO_STREAMING_FORMAT_TYPE,     /* bDescriptorSubtype */
         AUDIO_FORMAT_TYPE_I,             /* bFormatType */
         AUDIO_MIC_CHANNELS,              /* bNrChannels */
         0x02,                            /* bSubFrameSize */
         16,                              /* bBitResolution */
-        0x01,                            /* bSamFreqType */
-        AUDIO_MIC_SMPL_FREQ & 0xff,      /* tSamFreq 8000 = 0x1F40 */
-        (AUDIO_MIC_SMPL_FREQ >> 8) & 0xff,
-        AUDIO_MIC_SMPL_FREQ >> 16,
-        //100 + AUDIO_MIC_CHANNELS byte
+        AUDIO_MIC_FREQ_NUM,              /* bSamFreqType */
+        AUDIO_MIC_SAMPLE_FREQ(AUDIO_MIC_FREQ_0), /* tSamFreq */
+        AUDIO_MIC_SAMPLE_FREQ(AUDIO_MIC_FREQ_1),
+        AUDIO_MIC_SAMPLE_FREQ(AUDIO_MIC_FREQ_2),
+
+        /* Endpoint 1 - Standard Descriptor */
+        AUDIO_STANDARD_ENDPOINT_DESC_SIZE,          /* bLength */
+        0x05,                                       /* bDescriptorType */
+        _AUDIO_MIC_EP,                              /* bEndpointAddress 1 in endpoint*/
+        0x05,                                       /* bmAttributes */
+        AUDIO_MIC_EP_SIZE(2U) & 0xFF,               /* wMaxPacketSize */
+        AUDIO_MIC_EP_SIZE(2U) >> 8,
+        0x01, /* bInterval */
+        0x00, /* bRefresh */
+        0x00, /* bSynchAddress */
+
+        /* Endpoint - Audio Streaming Descriptor*/
+        AUDIO_STREAMING_ENDPOINT_DESC_SIZE, /* bLength */
+        AUDIO_ENDPOINT_DESCRIPTOR_TYPE,     /* bDescriptorType */
+        AUDIO_ENDPOINT_GENERAL,             /* bDescriptor */
+        AUDIO_EP_ATTR_SAMPLING_FREQ,        /* bmAttributes: sampling frequency control */
+        0x00,                               /* bLockDelayUnits */
+        0x00,                               /* wLockDelay */
+        0x00,
+        //(73 + AUDIO_MIC_CHANNELS) + AUDIO_MIC_ALT_DESC_SIZE byte
+
+        /* USB Microphone Standard AS Interface Descriptor - Audio Streaming Operational */
+        /* Interface 1, Alternate Setting 2, 24-bit samples                         */
+        0x09,                          /* bLength */
+        USB_DESC_TYPE_INTERFACE,       /* bDescriptorType */
+        _AUDIO_MIC_AS_ITF_NBR,         /* bInterfaceNumber */
+        AUDIO_MIC_ALT_24BIT,           /* bAlternateSetting */
+        0x01,                          /* bNumEndpoints */
+        USB_DEVICE_CLASS_AUDIO,        /* bInterfaceClass */
+        AUDIO_SUBCLASS_AUDIOSTREAMING, /* bInterfaceSubClass */
+        AUDIO_PROTOCOL_UNDEFINED,      /* bInterfaceProtocol */
+        0x00,                          /* iInterface */
+
+        /* USB Microphone Audio Streaming Interface Descriptor */
+        AUDIO_STREAMING_INTERFACE_DESC_SIZE, /* bLength */
+        AUDIO_INTERFACE_DESCRIPTOR_TYPE,     /* bDescriptorType */
+        AUDIO_STREAMING_GENERAL,             /* bDescriptorSubtype */
+        0x03,                                /* bTerminalLink */
+        0x01,                                /* bDelay */
+        0x01,                                /* wFormatTag AUDIO_FORMAT_PCM  0x0001*/
+        0x00,
+
+        /* USB Microphone Audio Type I Format Interface Descriptor */
+        AUDIO_MIC_FMT_DESC_SIZE,         /* bLength */
+        AUDIO_INTERFACE_DESCRIPTOR_TYPE, /* bDescriptorType */
+        AUDIO_STREAMING_FORMAT_TYPE,     /* bDescriptorSubtype */
+        AUDIO_FORMAT_TYPE_I,             /* bFormatType */
+        AUDIO_MIC_CHANNELS,              /* bNrChannels */
+        0x03,                            /* bSubFrameSize */
+        24,                              /* bBitResolution */
+        AUDIO_MIC_FREQ_NUM,              /* bSamFreqType */
+        AUDIO_MIC_SAMPLE_FREQ(AUDIO_MIC_FREQ_0), /* tSamFreq */
+        AUDIO_MIC_SAMPLE_FREQ(AUDIO_MIC_FREQ_1),
+        AUDIO_MIC_SAMPLE_FREQ(AUDIO_MIC_FREQ_2),
 
         /* Endpoint 1 - Standard Descriptor */
-        AUDIO_STANDARD_ENDPOINT_DESC_SIZE,                                  /* bLength */
-        0x05,                                                               /* bDescriptorType */
-        _AUDIO_MIC_EP,                                                      /* bEndpointAddress 1 in endpoint*/
-        0x05,                                                               /* bmAttributes */
-        ((AUDIO_MIC_SMPL_FREQ / 1000 + 2) * AUDIO_MIC_CHANNELS * 2) & 0xFF, /* wMaxPacketSize */
-        ((AUDIO_MIC_SMPL_FREQ / 1000 + 2) * AUDIO_MIC_CHANNELS * 2) >> 8,
+        AUDIO_STANDARD_ENDPOINT_DESC_SIZE,          /* bLength */
+        0x05,                                       /* bDescriptorType */
+        _AUDIO_MIC_EP,                              /* bEndpointAddress 1 in endpoint*/
+        0x05,                                       /* bmAttributes */
+        AUDIO_MIC_EP_SIZE(3U) & 0xFF,               /* wMaxPacketSize */
+        AUDIO_MIC_EP_SIZE(3U) >> 8,
         0x01, /* bInterval */
         0x00, /* bRefresh */
         0x00, /* bSynchAddress */
-        //109 + AUDIO_MIC_CHANNELS byte
 
         /* Endpoint - Audio Streaming Descriptor*/
         AUDIO_STREAMING_ENDPOINT_DESC_SIZE, /* bLength */
         AUDIO_ENDPOINT_DESCRIPTOR_TYPE,     /* bDescriptorType */
         AUDIO_ENDPOINT_GENERAL,             /* bDescriptor */
-        0x00,                               /* bmAttributes */
+        AUDIO_EP_ATTR_SAMPLING_FREQ,        /* bmAttributes: sampling frequency control */
         0x00,                               /* bLockDelayUnits */
         0x00,                               /* wLockDelay */
         0x00,
-        //116 + AUDIO_MIC_CHANNELS byte
+        //USBD_AUDIO_MIC_CONFIG_DESC_SIZE byte
 };
 
 /* USB Standard Device Descriptor */
@@ -398,12 +466,10 @@ static uint8_t USBD_AUDIO_MIC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
     haudio->paketDimension = 1;
   }
   uint16_t packet_dim = haudio->paketDimension;
-  uint16_t wr_rd_offset = (AUDIO_MIC_PACKET_NUM / 2) * haudio->dataAmount / haudio->paketDimension;
-  haudio->wr_ptr = wr_rd_offset * packet_dim;
-  haudio->rd_ptr = 0;
+  USBD_AUDIO_MIC_RingReset(haudio);
   haudio->timeout = 0;
 
-  ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->Init(haudio->frequency, 0, haudio->channels);
+  ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->Init(haudio->frequency, 8U * haudio->subframe, haudio->channels);
 
   USBD_LL_OpenEP(pdev,
                  AUDIO_MIC_EP,
@@ -454,6 +520,7 @@ static uint8_t USBD_AUDIO_MIC_Setup(USBD_HandleTypeDef *pdev,
   uint16_t len;
   uint8_t *pbuf;
   uint16_t status_info = 0U;
+  uint8_t subframe;
   USBD_StatusTypeDef ret = USBD_OK;
 
   haudio = (USBD_AUDIO_MIC_HandleTypeDef *)pdev->pClassData_UAC_MIC;
@@ -539,6 +606,18 @@ static uint8_t USBD_AUDIO_MIC_Setup(USBD_HandleTypeDef *pdev,
         if ((uint8_t)(req->wValue) <= USBD_MAX_NUM_INTERFACES)
         {
           haudio->alt_setting = (uint8_t)(req->wValue);
+
+          /* Each operational setting carries its own sample size */
+          if ((LOBYTE(req->wIndex) == AUDIO_MIC_AS_ITF_NBR) && (haudio->alt_setting != 0U))
+          {
+            subframe = (haudio->alt_setting == AUDIO_MIC_ALT_24BIT) ? 3U : 2U;
+
+            if (subframe != haudio->subframe)
+            {
+              haudio->subframe = subframe;
+              USBD_AUDIO_MIC_SetFormat(pdev, haudio);
+            }
+          }
         }
         else
         {
@@ -586,9 +665,6 @@ static uint8_t *USBD_AUDIO_MIC_GetCfgDesc(uint16_t *length)
   return USBD_AUDIO_MIC_CfgDesc;
 }
 
-uint16_t app;
-uint16_t rd_ptr;
-uint16_t wr_ptr;
 /**
   * @brief  USBD_AUDIO_DataIn
   *         handle data IN Stage
@@ -603,55 +679,67 @@ static uint8_t USBD_AUDIO_MIC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 
   haudio = pdev->pClassData_UAC_MIC;
 
-  rd_ptr = haudio->rd_ptr;
-  wr_ptr = haudio->wr_ptr;
-
   uint32_t length_usb_pck;
-  // uint16_t app;
-  uint16_t IsocInWr_app = haudio->wr_ptr;
-  uint16_t true_dim = haudio->buffer_length;
+  uint32_t level;
+  uint32_t offset;
+  uint32_t true_dim = haudio->buffer_length;
   uint16_t packet_dim = haudio->paketDimension;
   uint16_t channels = haudio->channels;
   length_usb_pck = packet_dim;
   haudio->timeout = 0;
   if (epnum == (AUDIO_MIC_EP & 0x7F))
   {
+    /* The previous packet has been sent, give its bytes back to the producer */
+    if (haudio->in_flight != 0U)
+    {
+      haudio->rd_ptr = USBD_AUDIO_MIC_RingAdvance(haudio, haudio->rd_ptr, haudio->in_flight);
+      haudio->in_flight = 0U;
+    }
     if (haudio->state == STATE_USB_IDLE)
     {
+      /* Drop whatever was left from a previous stream */
+      haudio->rd_ptr = haudio->wr_ptr;
       haudio->state = STATE_USB_REQUESTS_STARTED;
       ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->Record();
     }
+    level = USBD_AUDIO_MIC_RingFill(haudio);
+    if ((haudio->state == STATE_USB_REQUESTS_STARTED) &&
+        (level >= (packet_dim * (AUDIO_MIC_PACKET_NUM / 2U))))
+    {
+      /* Ring is half full, start streaming from it */
+      haudio->state = STATE_USB_BUFFER_WRITE_STARTED;
+    }
     if (haudio->state == STATE_USB_BUFFER_WRITE_STARTED)
     {
-      haudio->rd_ptr = haudio->rd_ptr % (true_dim);
-      if (IsocInWr_app < haudio->rd_ptr)
-      {
-        app = ((true_dim)-haudio->rd_ptr) + IsocInWr_app;
-      }
-      else
+      if (level >= (packet_dim * haudio->upper_treshold))
       {
-        app = IsocInWr_app - haudio->rd_ptr;
+        length_usb_pck += channels * haudio->subframe;
       }
-      if (app >= (packet_dim * haudio->upper_treshold))
+      else if (level <= (packet_dim * haudio->lower_treshold))
       {
-        length_usb_pck += channels * 2;
+        length_usb_pck -= channels * haudio->subframe;
       }
-      else if (app <= (packet_dim * haudio->lower_treshold))
+    }
+    if ((haudio->state == STATE_USB_BUFFER_WRITE_STARTED) && (level < length_usb_pck))
+    {
+      /* Producer fell behind: send silence and refill to half */
+      haudio->underrun++;
+      haudio->state = STATE_USB_REQUESTS_STARTED;
+      length_usb_pck = packet_dim;
+    }
+    if (haudio->state == STATE_USB_BUFFER_WRITE_STARTED)
+    {
+      offset = (haudio->rd_ptr >= true_dim) ? (haudio->rd_ptr - true_dim) : haudio->rd_ptr;
+      /* A packet never straddles the end of the ring: it is cut short there
+         and the level trim above makes up for it on the following packets */
+      if (length_usb_pck > (true_dim - offset))
       {
-        length_usb_pck -= channels * 2;
+        length_usb_pck = true_dim - offset;
       }
+      haudio->in_flight = length_usb_pck;
       USBD_LL_Transmit(pdev, AUDIO_MIC_EP,
-                       (uint8_t *)(&haudio->buffer[haudio->rd_ptr]),
+                       &haudio->buffer[offset],
                        length_usb_pck);
-      haudio->rd_ptr += length_usb_pck;
-
-      if (app < haudio->buffer_length / 10)
-      {
-        ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->Stop();
-        haudio->state = STATE_USB_IDLE;
-        haudio->timeout = 0;
-        memset(haudio->buffer, 0, (haudio->buffer_length + haudio->dataAmount));
-      }
     }
     else
     {
@@ -673,12 +761,67 @@ static uint8_t USBD_AUDIO_MIC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t USBD_AUDIO_MIC_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
+  USBD_AUDIO_MIC_ItfTypeDef *itf;
+  uint32_t freq;
+  int8_t level;
   haudio = pdev->pClassData_UAC_MIC;
+  if (haudio == NULL)
+  {
+    return USBD_FAIL;
+  }
+  if ((haudio->control.cmd == AUDIO_REQ_SET_CUR) && (haudio->control.unit == AUDIO_ENDPOINT_CTRL))
+  {
+    /* Sampling frequency on 3 bytes, anything not offered is ignored */
+    freq = (uint32_t)haudio->control.data[0] |
+           ((uint32_t)haudio->control.data[1] << 8) |
+           ((uint32_t)haudio->control.data[2] << 16);
+
+    if ((freq != haudio->frequency) &&
+        ((freq == AUDIO_MIC_FREQ_0) || (freq == AUDIO_MIC_FREQ_1) || (freq == AUDIO_MIC_FREQ_2)))
+    {
+      haudio->frequency = freq;
+      USBD_AUDIO_MIC_SetFormat(pdev, haudio);
+    }
+
+    haudio->control.cmd = 0;
+    haudio->control.len = 0;
+    haudio->control.unit = 0;
+  }
   if (haudio->control.cmd == AUDIO_REQ_SET_CUR)
   {
     if (haudio->control.unit == AUDIO_STREAMING_CTRL)
     {
-      ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->VolumeCtl(VOL_CUR);
+      itf = (USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC;
+
+      switch (haudio->control.selector)
+      {
+      case AUDIO_MUTE_CONTROL:
+        haudio->mute = haudio->control.data[0];
+        itf->MuteCtl(haudio->mute);
+        break;
+
+      case AUDIO_BASS_CONTROL:
+      case AUDIO_TREBLE_CONTROL:
+        level = (int8_t)haudio->control.data[0];
+        level = MAX(MIN(level, AUDIO_TONE_MAX), AUDIO_TONE_MIN);
+        if (haudio->control.selector == AUDIO_BASS_CONTROL)
+        {
+          haudio->bass = level;
+        }
+        else
+        {
+          haudio->treble = level;
+        }
+        if (itf->ToneCtl != NULL)
+        {
+          itf->ToneCtl(haudio->control.selector, level);
+        }
+        break;
+
+      default:
+        itf->VolumeCtl(VOL_CUR);
+        break;
+      }
 
       haudio->control.cmd = 0;
       haudio->control.len = 0;
@@ -720,10 +863,23 @@ static uint8_t USBD_AUDIO_MIC_SOF(USBD_HandleTypeDef *pdev)
   */
 static uint8_t USBD_AUDIO_MIC_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  UNUSED(pdev);
-  UNUSED(epnum);
+  USBD_AUDIO_MIC_HandleTypeDef *haudio;
 
-  return (uint8_t)USBD_OK;
+  haudio = pdev->pClassData_UAC_MIC;
+  if ((haudio == NULL) || (epnum != (AUDIO_MIC_EP & 0x7FU)) || (haudio->alt_setting == 0U))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  /* The host did not read the packet armed for the last frame and the
+     driver has disabled the endpoint. Its samples are late by now: DataIn
+     drops them with the packet in flight, which keeps the ring in step with
+     the producer, and arms the endpoint again, the odd/even frame being
+     taken from the current frame number */
+  haudio->iso_incomplete++;
+  (void)USBD_LL_FlushEP(pdev, AUDIO_MIC_EP);
+
+  return USBD_AUDIO_MIC_DataIn(pdev, epnum);
 }
 /**
   * @brief  USBD_AUDIO_IsoOutIncomplete
@@ -775,6 +931,15 @@ static void USBD_AUDIO_MIC_REQ_GetMaximum(USBD_HandleTypeDef *pdev, USBD_SetupRe
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
   haudio = pdev->pClassData_UAC_MIC;
 
+  if ((HIBYTE(req->wValue) == AUDIO_BASS_CONTROL) || (HIBYTE(req->wValue) == AUDIO_TREBLE_CONTROL))
+  {
+    (haudio->control.data)[0] = (uint8_t)AUDIO_TONE_MAX;
+    USBD_CtlSendData(pdev,
+                     haudio->control.data,
+                     MIN(req->wLength, 1U));
+    return;
+  }
+
   (haudio->control.data)[0] = (uint16_t)AUDIO_MIC_VOL_MAX & 0xFF;
   (haudio->control.data)[1] = ((uint16_t)AUDIO_MIC_VOL_MAX & 0xFF00) >> 8;
 
@@ -794,6 +959,15 @@ static void USBD_AUDIO_MIC_REQ_GetMinimum(USBD_HandleTypeDef *pdev, USBD_SetupRe
 {
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
   haudio = pdev->pClassData_UAC_MIC;
+
+  if ((HIBYTE(req->wValue) == AUDIO_BASS_CONTROL) || (HIBYTE(req->wValue) == AUDIO_TREBLE_CONTROL))
+  {
+    (haudio->control.data)[0] = (uint8_t)AUDIO_TONE_MIN;
+    USBD_CtlSendData(pdev,
+                     haudio->control.data,
+                     MIN(req->wLength, 1U));
+    return;
+  }
   (haudio->control.data)[0] = (uint16_t)AUDIO_MIC_VOL_MIN & 0xFF;
   (haudio->control.data)[1] = ((uint16_t)AUDIO_MIC_VOL_MIN & 0xFF00) >> 8;
   /* Send the current mute state */
@@ -813,6 +987,15 @@ static void USBD_AUDIO_MIC_REQ_GetResolution(USBD_HandleTypeDef *pdev, USBD_Setu
 {
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
   haudio = pdev->pClassData_UAC_MIC;
+
+  if ((HIBYTE(req->wValue) == AUDIO_BASS_CONTROL) || (HIBYTE(req->wValue) == AUDIO_TREBLE_CONTROL))
+  {
+    (haudio->control.data)[0] = (uint8_t)AUDIO_TONE_RES;
+    USBD_CtlSendData(pdev,
+                     haudio->control.data,
+                     MIN(req->wLength, 1U));
+    return;
+  }
   (haudio->control.data)[0] = (uint16_t)AUDIO_MIC_VOL_RES & 0xFF;
   (haudio->control.data)[1] = ((uint16_t)AUDIO_MIC_VOL_RES & 0xFF00) >> 8;
   USBD_CtlSendData(pdev,
@@ -832,8 +1015,44 @@ static void USBD_AUDIO_MIC_REQ_GetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupRe
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
   haudio = pdev->pClassData_UAC_MIC;
 
-  (haudio->control.data)[0] = (uint16_t)VOL_CUR & 0xFF;
-  (haudio->control.data)[1] = ((uint16_t)VOL_CUR & 0xFF00) >> 8;
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT)
+  {
+    if (HIBYTE(req->wValue) != AUDIO_SAMPLING_FREQ_CONTROL)
+    {
+      USBD_CtlError(pdev, req);
+      return;
+    }
+
+    /* Current sampling frequency on 3 bytes */
+    (haudio->control.data)[0] = (uint8_t)haudio->frequency;
+    (haudio->control.data)[1] = (uint8_t)(haudio->frequency >> 8);
+    (haudio->control.data)[2] = (uint8_t)(haudio->frequency >> 16);
+
+    USBD_CtlSendData(pdev,
+                     haudio->control.data,
+                     MIN(req->wLength, AUDIO_SAMPLING_FREQ_SIZE));
+    return;
+  }
+
+  switch (HIBYTE(req->wValue))
+  {
+  case AUDIO_MUTE_CONTROL:
+    (haudio->control.data)[0] = haudio->mute;
+    break;
+
+  case AUDIO_BASS_CONTROL:
+    (haudio->control.data)[0] = (uint8_t)haudio->bass;
+    break;
+
+  case AUDIO_TREBLE_CONTROL:
+    (haudio->control.data)[0] = (uint8_t)haudio->treble;
+    break;
+
+  default:
+    (haudio->control.data)[0] = (uint16_t)VOL_CUR & 0xFF;
+    (haudio->control.data)[1] = ((uint16_t)VOL_CUR & 0xFF00) >> 8;
+    break;
+  }
 
   USBD_CtlSendData(pdev,
                    haudio->control.data,
@@ -851,16 +1070,35 @@ static void USBD_AUDIO_MIC_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupRe
 {
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
   haudio = pdev->pClassData_UAC_MIC;
-  if (req->wLength)
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT)
   {
-    /* Prepare the reception of the buffer over EP0 */
+    if ((HIBYTE(req->wValue) != AUDIO_SAMPLING_FREQ_CONTROL) || (req->wLength != AUDIO_SAMPLING_FREQ_SIZE))
+    {
+      USBD_CtlError(pdev, req);
+      return;
+    }
+
     USBD_CtlPrepareRx(pdev,
-                      (uint8_t *)&VOL_CUR,
+                      haudio->control.data,
                       req->wLength);
 
+    haudio->control.cmd = AUDIO_REQ_SET_CUR;
+    haudio->control.len = req->wLength;
+    haudio->control.unit = AUDIO_ENDPOINT_CTRL; /* Sampling frequency of the streaming endpoint */
+    return;
+  }
+  if (req->wLength)
+  {
+    /* Prepare the reception of the buffer over EP0, the volume straight
+       into its current value */
+    USBD_CtlPrepareRx(pdev,
+                      (HIBYTE(req->wValue) == AUDIO_VOLUME_CONTROL) ? (uint8_t *)&VOL_CUR : haudio->control.data,
+                      (HIBYTE(req->wValue) == AUDIO_VOLUME_CONTROL) ? MIN(req->wLength, sizeof(VOL_CUR)) : req->wLength);
+
     haudio->control.cmd = AUDIO_REQ_SET_CUR;    /* Set the request value */
     haudio->control.len = req->wLength;         /* Set the request data length */
     haudio->control.unit = HIBYTE(req->wIndex); /* Set the request target unit */
+    haudio->control.selector = HIBYTE(req->wValue); /* Set the request control */
   }
 }
 
@@ -877,14 +1115,16 @@ static void USBD_AUDIO_MIC_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupRe
 *         Fills the USB internal buffer with audio data from user
 * @param pdev: device instance
 * @param audioData: audio data to be sent via USB
-* @param dataAmount: number of PCM samples to be copyed
+* @param PCMSamples: number of PCM samples to be copyed, packed on the
+*        sample size of the alternate setting (2 or 3 bytes)
 * @note Depending on the calling frequency, a coherent amount of samples must be passed to
 *       the function. E.g.: assuming a Sampling frequency of 16 KHz and 1 channel,
 *       you can pass 16 PCM samples if the function is called each millisecond,
-*       32 samples if called every 2 milliseconds and so on.
-* @retval status
+*       32 samples if called every 2 milliseconds and so on. A block must not
+*       exceed half of the ring (AUDIO_MIC_PACKET_NUM / 2 milliseconds).
+* @retval status, USBD_BUSY when the block was dropped because the ring is full
 */
-uint8_t USBD_AUDIO_MIC_Data_Transfer(USBD_HandleTypeDef *pdev, int16_t *audioData, uint16_t PCMSamples)
+uint8_t USBD_AUDIO_MIC_Data_Transfer(USBD_HandleTypeDef *pdev, const void *audioData, uint16_t PCMSamples)
 {
 
   USBD_AUDIO_MIC_HandleTypeDef *haudio;
@@ -894,54 +1134,120 @@ uint8_t USBD_AUDIO_MIC_Data_Transfer(USBD_HandleTypeDef *pdev, int16_t *audioDat
   {
     return USBD_BUSY;
   }
-  uint16_t dataAmount = PCMSamples * 2; /*Bytes*/
-  uint16_t true_dim = haudio->buffer_length;
-  uint16_t current_data_Amount = haudio->dataAmount;
-  uint16_t packet_dim = haudio->paketDimension;
+  uint32_t dataAmount = (uint32_t)PCMSamples * haudio->subframe; /*Bytes*/
+  uint32_t true_dim = haudio->buffer_length;
+  uint32_t offset;
+  uint32_t first;
 
-  if (haudio->state == STATE_USB_REQUESTS_STARTED || current_data_Amount != dataAmount)
+  if (USBD_AUDIO_MIC_CheckTimeout(pdev) != USBD_OK)
+  {
+    return USBD_OK;
+  }
+  if ((true_dim - USBD_AUDIO_MIC_RingFill(haudio)) < dataAmount)
   {
-    /*USB parameters definition, based on the amount of data passed*/
-    haudio->dataAmount = dataAmount;
-    uint16_t wr_rd_offset = (AUDIO_MIC_PACKET_NUM / 2) * dataAmount / packet_dim;
-    haudio->wr_ptr = wr_rd_offset * packet_dim;
-    haudio->rd_ptr = 0;
-    haudio->upper_treshold = wr_rd_offset + 1;
-    haudio->lower_treshold = wr_rd_offset - 1;
-    haudio->buffer_length = (packet_dim * (dataAmount / packet_dim) * AUDIO_MIC_PACKET_NUM);
+    /* Host is not draining fast enough, drop the whole block */
+    haudio->overrun++;
+    return USBD_BUSY;
+  }
 
-    /*Memory allocation for data buffer, depending (also) on data amount passed to the transfer function*/
-    if (haudio->buffer != NULL)
-    {
-      USBD_free(haudio->buffer);
-    }
-    haudio->buffer = USBD_malloc(haudio->buffer_length + haudio->dataAmount);
-    if (haudio->buffer == NULL)
-    {
-      return USBD_FAIL;
-    }
-    memset(haudio->buffer, 0, (haudio->buffer_length + haudio->dataAmount));
-    haudio->state = STATE_USB_BUFFER_WRITE_STARTED;
+  offset = (haudio->wr_ptr >= true_dim) ? (haudio->wr_ptr - true_dim) : haudio->wr_ptr;
+  first = MIN(dataAmount, true_dim - offset);
+  (void)USBD_memcpy(&haudio->buffer[offset], audioData, first);
+  if (first < dataAmount)
+  {
+    (void)USBD_memcpy(haudio->buffer, ((const uint8_t *)audioData) + first, dataAmount - first);
   }
-  else if (haudio->state == STATE_USB_BUFFER_WRITE_STARTED)
+  /* Samples must be in the ring before the consumer can see them */
+  __DMB();
+  haudio->wr_ptr = USBD_AUDIO_MIC_RingAdvance(haudio, haudio->wr_ptr, dataAmount);
+
+  return USBD_OK;
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_GetWriteBuffer
+*         Returns the free contiguous part of the ring so that the caller
+*         (e.g. a DMA or a filter) can produce samples in place
+* @param pdev: device instance
+* @param length: free contiguous bytes at the returned address
+* @note The free space may be split by the end of the ring, call again after
+*       USBD_AUDIO_MIC_CommitWrite to get the remainder.
+* @retval write pointer, NULL when the host is not streaming
+*/
+uint8_t *USBD_AUDIO_MIC_GetWriteBuffer(USBD_HandleTypeDef *pdev, uint32_t *length)
+{
+  USBD_AUDIO_MIC_HandleTypeDef *haudio;
+  haudio = (USBD_AUDIO_MIC_HandleTypeDef *)pdev->pClassData_UAC_MIC;
+  uint32_t true_dim;
+  uint32_t offset;
+
+  *length = 0U;
+  if ((haudio == NULL) ||
+      ((haudio->state != STATE_USB_REQUESTS_STARTED) &&
+       (haudio->state != STATE_USB_BUFFER_WRITE_STARTED)))
   {
-    if (haudio->timeout++ == TIMEOUT_VALUE)
-    {
-      haudio->state = STATE_USB_IDLE;
-      ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->Stop();
-      haudio->timeout = 0;
-    }
-    memcpy((uint8_t *)&haudio->buffer[haudio->wr_ptr], (uint8_t *)(audioData), dataAmount);
-    haudio->wr_ptr += dataAmount;
-    haudio->wr_ptr = haudio->wr_ptr % (true_dim);
-    if ((haudio->wr_ptr - dataAmount) == 0)
-    {
-      memcpy((uint8_t *)(((uint8_t *)haudio->buffer) + true_dim), (uint8_t *)haudio->buffer, dataAmount);
-    }
+    return NULL;
+  }
+
+  true_dim = haudio->buffer_length;
+  offset = (haudio->wr_ptr >= true_dim) ? (haudio->wr_ptr - true_dim) : haudio->wr_ptr;
+  *length = MIN(true_dim - USBD_AUDIO_MIC_RingFill(haudio), true_dim - offset);
+
+  return &haudio->buffer[offset];
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_CommitWrite
+*         Publishes bytes written at the address returned by
+*         USBD_AUDIO_MIC_GetWriteBuffer
+* @param pdev: device instance
+* @param length: number of bytes produced, whole sample frames
+* @retval status
+*/
+uint8_t USBD_AUDIO_MIC_CommitWrite(USBD_HandleTypeDef *pdev, uint32_t length)
+{
+  USBD_AUDIO_MIC_HandleTypeDef *haudio;
+  haudio = (USBD_AUDIO_MIC_HandleTypeDef *)pdev->pClassData_UAC_MIC;
+
+  if ((haudio == NULL) || (haudio->state == STATE_USB_WAITING_FOR_INIT))
+  {
+    return USBD_BUSY;
+  }
+  if (USBD_AUDIO_MIC_CheckTimeout(pdev) != USBD_OK)
+  {
+    return USBD_OK;
+  }
+  if ((haudio->buffer_length - USBD_AUDIO_MIC_RingFill(haudio)) < length)
+  {
+    haudio->overrun++;
+    return USBD_FAIL;
   }
+
+  __DMB();
+  haudio->wr_ptr = USBD_AUDIO_MIC_RingAdvance(haudio, haudio->wr_ptr, length);
+
   return USBD_OK;
 }
 
+/**
+* @brief  USBD_AUDIO_MIC_GetLevel
+*         Bytes waiting to be sent, the packet on the endpoint included
+* @param pdev: device instance
+* @retval fill level of the ring in bytes
+*/
+uint32_t USBD_AUDIO_MIC_GetLevel(USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_MIC_HandleTypeDef *haudio;
+  haudio = (USBD_AUDIO_MIC_HandleTypeDef *)pdev->pClassData_UAC_MIC;
+
+  if (haudio == NULL)
+  {
+    return 0U;
+  }
+
+  return USBD_AUDIO_MIC_RingFill(haudio);
+}
+
 /**
   * @brief  USBD_AUDIO_RegisterInterface
   * @param  fops: Audio interface callback
@@ -966,13 +1272,20 @@ void USBD_Update_Audio_MIC_DESC(uint8_t *desc,
                                 uint8_t in_ep,
                                 uint8_t str_idx)
 {
+  uint16_t alt;
+
   desc[11] = ac_itf;
   desc[19] = ac_itf;
   desc[25] = str_idx;
   desc[34] = as_itf;
   desc[66 + AUDIO_MIC_CHANNELS] = as_itf;
-  desc[75 + AUDIO_MIC_CHANNELS] = as_itf;
-  desc[102 + AUDIO_MIC_CHANNELS] = in_ep;
+
+  /* Operational settings: interface and data endpoint */
+  for (alt = AUDIO_MIC_ALT_DESC_OFFSET; alt < USBD_AUDIO_MIC_CONFIG_DESC_SIZE; alt += AUDIO_MIC_ALT_DESC_SIZE)
+  {
+    desc[alt + 2U] = as_itf;
+    desc[alt + 18U + AUDIO_MIC_FMT_DESC_SIZE] = in_ep;
+  }
 
   AUDIO_MIC_EP = in_ep;
   AUDIO_MIC_AC_ITF_NBR = ac_itf;
@@ -982,15 +1295,119 @@ void USBD_Update_Audio_MIC_DESC(uint8_t *desc,
 
   haudioInstance.paketDimension = (AUDIO_MIC_SMPL_FREQ / 1000 * AUDIO_MIC_CHANNELS * 2);
   haudioInstance.frequency = AUDIO_MIC_SMPL_FREQ;
-  haudioInstance.buffer_length = haudioInstance.paketDimension * AUDIO_MIC_PACKET_NUM;
   haudioInstance.channels = AUDIO_MIC_CHANNELS;
-  haudioInstance.upper_treshold = 5;
-  haudioInstance.lower_treshold = 2;
+  haudioInstance.subframe = 2U;
+  haudioInstance.upper_treshold = (AUDIO_MIC_PACKET_NUM / 2U) + 1U;
+  haudioInstance.lower_treshold = (AUDIO_MIC_PACKET_NUM / 2U) - 1U;
   haudioInstance.state = STATE_USB_WAITING_FOR_INIT;
-  haudioInstance.wr_ptr = 3 * haudioInstance.paketDimension;
-  haudioInstance.rd_ptr = 0;
-  haudioInstance.dataAmount = 0;
-  haudioInstance.buffer = 0;
+  USBD_AUDIO_MIC_RingReset(&haudioInstance);
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_SetFormat
+*         Sizes the packets and the ring for the selected rate and sample
+*         size, then restarts the hardware layer
+* @param  pdev: device instance
+* @param  haudio: audio handle
+* @retval None
+*/
+static void USBD_AUDIO_MIC_SetFormat(USBD_HandleTypeDef *pdev, USBD_AUDIO_MIC_HandleTypeDef *haudio)
+{
+  USBD_AUDIO_MIC_ItfTypeDef *itf = (USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC;
+
+  if ((haudio->state == STATE_USB_REQUESTS_STARTED) ||
+      (haudio->state == STATE_USB_BUFFER_WRITE_STARTED))
+  {
+    itf->Stop();
+  }
+
+  haudio->paketDimension = (uint16_t)((haudio->frequency / 1000U) * haudio->channels * haudio->subframe);
+  USBD_AUDIO_MIC_RingReset(haudio);
+  itf->Init(haudio->frequency, 8U * haudio->subframe, haudio->channels);
+
+  /* The next DataIn starts recording again at the new format */
+  if (haudio->state != STATE_USB_WAITING_FOR_INIT)
+  {
+    haudio->state = STATE_USB_IDLE;
+  }
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_RingFill
+*         Bytes queued in the ring, including the packet in flight
+* @param  haudio: audio handle
+* @retval fill level in bytes
+*/
+static uint32_t USBD_AUDIO_MIC_RingFill(USBD_AUDIO_MIC_HandleTypeDef *haudio)
+{
+  uint32_t wr = haudio->wr_ptr;
+  uint32_t rd = haudio->rd_ptr;
+
+  /* Both indexes run over twice the ring so that full and empty differ */
+  return (wr >= rd) ? (wr - rd) : ((2U * haudio->buffer_length) - rd + wr);
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_RingAdvance
+*         Moves a ring index forward
+* @param  haudio: audio handle
+* @param  ptr: index to move
+* @param  length: number of bytes
+* @retval new index
+*/
+static uint32_t USBD_AUDIO_MIC_RingAdvance(USBD_AUDIO_MIC_HandleTypeDef *haudio, uint32_t ptr, uint32_t length)
+{
+  ptr += length;
+  if (ptr >= (2U * haudio->buffer_length))
+  {
+    ptr -= 2U * haudio->buffer_length;
+  }
+  return ptr;
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_RingReset
+*         Empties the ring and sizes it for the current packet dimension
+* @param  haudio: audio handle
+* @retval None
+*/
+static void USBD_AUDIO_MIC_RingReset(USBD_AUDIO_MIC_HandleTypeDef *haudio)
+{
+  haudio->buffer = AUDIO_MIC_Ring;
+  haudio->buffer_length = MIN((uint32_t)haudio->paketDimension * AUDIO_MIC_PACKET_NUM,
+                              (uint32_t)AUDIO_MIC_RING_SIZE);
+  haudio->rd_ptr = 0U;
+  haudio->wr_ptr = 0U;
+  haudio->in_flight = 0U;
+  haudio->underrun = 0U;
+  haudio->overrun = 0U;
+}
+
+/**
+* @brief  USBD_AUDIO_MIC_CheckTimeout
+*         Stops recording when the host has not polled the endpoint for
+*         TIMEOUT_VALUE producer calls
+* @param  pdev: device instance
+* @retval USBD_OK while the host is streaming
+*/
+static uint8_t USBD_AUDIO_MIC_CheckTimeout(USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_MIC_HandleTypeDef *haudio;
+  haudio = (USBD_AUDIO_MIC_HandleTypeDef *)pdev->pClassData_UAC_MIC;
+
+  if ((haudio->state != STATE_USB_REQUESTS_STARTED) &&
+      (haudio->state != STATE_USB_BUFFER_WRITE_STARTED))
+  {
+    return USBD_BUSY;
+  }
+  if (haudio->timeout++ == TIMEOUT_VALUE)
+  {
+    haudio->state = STATE_USB_IDLE;
+    ((USBD_AUDIO_MIC_ItfTypeDef *)pdev->pUserData_UAC_MIC)->Stop();
+    haudio->timeout = 0;
+    return USBD_BUSY;
+  }
+  return USBD_OK;
 }
 
 /**
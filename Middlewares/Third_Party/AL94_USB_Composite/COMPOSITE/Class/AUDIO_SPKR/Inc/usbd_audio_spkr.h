@@ -45,43 +45,168 @@ extern "C" {
 
 #define AUDIO_SPKR_STR_DESC                          "STM32 SPEAKER"
 
-#define USBD_AUDIO_FREQ                               16000U
+/* Sampling frequencies offered to the host, in increasing order. The codec
+   runs from the crystal family of the selected rate, the resampler of the
+   application bridges the rest */
+#ifndef AUDIO_SPKR_FREQ_0
+#define AUDIO_SPKR_FREQ_0                             44100U
+#endif /* AUDIO_SPKR_FREQ_0 */
 
-#define USBD_AUDIO_SPKR_CONFIG_DESC_SIZE              117
+#ifndef AUDIO_SPKR_FREQ_1
+#define AUDIO_SPKR_FREQ_1                             48000U
+#endif /* AUDIO_SPKR_FREQ_1 */
+
+#ifndef AUDIO_SPKR_FREQ_2
+#define AUDIO_SPKR_FREQ_2                             96000U
+#endif /* AUDIO_SPKR_FREQ_2 */
+
+#define AUDIO_SPKR_FREQ_NUM                           3U
+#define AUDIO_SPKR_MAX_FREQ                           AUDIO_SPKR_FREQ_2
+
+/* Rate used until the host selects one */
+#ifndef USBD_AUDIO_FREQ
+#define USBD_AUDIO_FREQ                               AUDIO_SPKR_FREQ_1
+#endif /* USBD_AUDIO_FREQ */
+
+/* Streaming alternate settings: stereo, 16-bit samples in 2 bytes or
+   24-bit samples in 3 bytes */
+#define AUDIO_SPKR_CHANNELS                           2U
+#define AUDIO_SPKR_ALT_16BIT                          1U
+#define AUDIO_SPKR_ALT_24BIT                          2U
+#define AUDIO_SPKR_MAX_SUBFRAME                       3U
+
+/* Asynchronous speaker with an explicit feedback IN endpoint: the host
+   paces the stream from the codec clock measured against SOF. 0 keeps the
+   adaptive stream, drift absorbed by stretching the playback buffer */
+#ifndef AUDIO_SPKR_FB_ENABLED
+#define AUDIO_SPKR_FB_ENABLED                         1U
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
+/* Size of one streaming alternate setting: standard and class specific
+   interface, format, data endpoint and its class descriptor */
+#define AUDIO_SPKR_FMT_DESC_SIZE                      AUDIO_FORMAT_TYPE_I_DESC_SIZE(AUDIO_SPKR_FREQ_NUM)
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+#define AUDIO_SPKR_ALT_DESC_SIZE                      (9U + 7U + AUDIO_SPKR_FMT_DESC_SIZE + 9U + 7U + 9U)
+#else
+#define AUDIO_SPKR_ALT_DESC_SIZE                      (9U + 7U + AUDIO_SPKR_FMT_DESC_SIZE + 9U + 7U)
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
+/* Up to the zero bandwidth setting, then the two operational settings */
+#define AUDIO_SPKR_ALT_DESC_OFFSET                    74U
+#define USBD_AUDIO_SPKR_CONFIG_DESC_SIZE              (AUDIO_SPKR_ALT_DESC_OFFSET + (2U * AUDIO_SPKR_ALT_DESC_SIZE))
 
 #define AUDIO_OUT_TC                                  0x01U
 #define AUDIO_IN_TC                                   0x02U
 
 
-#define AUDIO_OUT_PACKET                              (uint16_t)(((USBD_AUDIO_FREQ * 2U * 2U) / 1000U))
+/* Stereo frames of a nominal packet at freq, 45 at 44.1 kHz */
+#define AUDIO_SPKR_FRAMES(freq)                       (((freq) + 999U) / 1000U)
+
+/* Largest nominal packet, 24-bit at the highest rate */
+#define AUDIO_OUT_PACKET                              (uint16_t)(AUDIO_SPKR_FRAMES(AUDIO_SPKR_MAX_FREQ) * AUDIO_SPKR_CHANNELS * AUDIO_SPKR_MAX_SUBFRAME)
 #define AUDIO_DEFAULT_VOLUME                          70U
 
+/* Feature Unit volume in 1/256 dB, -60 to 0 dB by 1 dB */
+#define AUDIO_SPKR_VOL_MIN                            0xC400
+#define AUDIO_SPKR_VOL_RES                            0x0100
+#define AUDIO_SPKR_VOL_MAX                            0x0000
+
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+/* The host adds a stereo sample to a packet when the feedback asks for more */
+#define AUDIO_SPKR_EP_SIZE(subframe)                  ((AUDIO_SPKR_FRAMES(AUDIO_SPKR_MAX_FREQ) + 1U) * AUDIO_SPKR_CHANNELS * (subframe))
+
+/* bRefresh: the host reads the rate every 2^AUDIO_SPKR_FB_REFRESH ms (1 to 9),
+   which is also the measurement window */
+#ifndef AUDIO_SPKR_FB_REFRESH
+#define AUDIO_SPKR_FB_REFRESH                         3U
+#endif /* AUDIO_SPKR_FB_REFRESH */
+
+/* Ticks of the captured codec clock per sample, 256 for MCLK = 256 Fs.
+   A codec resampled from the stream rate scales its count to stream samples */
+#ifndef AUDIO_SPKR_FB_CLOCK_DIV
+#define AUDIO_SPKR_FB_CLOCK_DIV                       256U
+#endif /* AUDIO_SPKR_FB_CLOCK_DIV */
+
+/* Frames over which a buffer level error is worked off, keeps the playback
+   buffer half full whatever the residual error of the measured rate */
+#ifndef AUDIO_SPKR_FB_LEVEL_TC
+#define AUDIO_SPKR_FB_LEVEL_TC                        256U
+#endif /* AUDIO_SPKR_FB_LEVEL_TC */
+
+/* 10.14 samples per frame, the nominal rate and how far the feedback may
+   move from it (a quarter sample per frame) */
+#define AUDIO_SPKR_FB_NOMINAL(freq)                   (((freq) << 14) / 1000U)
+#define AUDIO_SPKR_FB_RANGE                           (1UL << 12)
+
+/* Number of sub-packets in the audio transfer buffer, even and higher than 3.
+   Drift no longer has to be absorbed, a few milliseconds are enough */
+#ifndef AUDIO_OUT_PACKET_NUM
+#define AUDIO_OUT_PACKET_NUM                          8U
+#endif /* AUDIO_OUT_PACKET_NUM */
+#else
+#define AUDIO_SPKR_EP_SIZE(subframe)                  (AUDIO_SPKR_FRAMES(AUDIO_SPKR_MAX_FREQ) * AUDIO_SPKR_CHANNELS * (subframe))
+
 /* Number of sub-packets in the audio transfer buffer. You can modify this value but always make sure
   that it is an even number and higher than 3 */
+#ifndef AUDIO_OUT_PACKET_NUM
 #define AUDIO_OUT_PACKET_NUM                          80U
-/* Total size of the audio transfer buffer */
+#endif /* AUDIO_OUT_PACKET_NUM */
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
+#define AUDIO_OUT_MAX_PACKET                          (uint16_t)AUDIO_SPKR_EP_SIZE(AUDIO_SPKR_MAX_SUBFRAME)
+
+/* Total size of the audio transfer buffer, the part in use follows the
+   rate and sample size the host selected */
 #define AUDIO_TOTAL_BUF_SIZE                          ((uint16_t)(AUDIO_OUT_PACKET * AUDIO_OUT_PACKET_NUM))
 
   typedef struct
   {
     uint32_t alt_setting;
-    uint8_t buffer[AUDIO_TOTAL_BUF_SIZE];
+    uint8_t buffer[AUDIO_TOTAL_BUF_SIZE + AUDIO_OUT_MAX_PACKET]; /* A packet may run past the end, its tail is moved to the start */
     AUDIO_OffsetTypeDef offset;
     uint8_t rd_enable;
     uint16_t rd_ptr;
     uint16_t wr_ptr;
     USBD_AUDIO_ControlTypeDef control;
+    uint32_t freq;             /* Sampling frequency selected by the host */
+    uint8_t subframe;          /* Bytes per sample of the alternate setting */
+    uint16_t frame;            /* Bytes per stereo frame */
+    uint16_t packet;           /* Bytes of a nominal packet */
+    uint16_t buf_size;         /* Part of buffer in use, AUDIO_OUT_PACKET_NUM packets */
+    int16_t volume;            /* Feature Unit settings, reported by GET_CUR */
+    uint8_t mute;
+    int8_t bass;
+    int8_t treble;
+    uint32_t iso_incomplete;   /* Data packets lost, feedback reads skipped by the host are not counted */
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+    uint32_t fb_nominal;       /* 10.14 nominal rate of freq */
+    uint32_t fb_value;         /* 10.14 samples per frame asked from the host */
+    uint32_t fb_clock;         /* Codec clock count at the start of the window */
+    uint32_t fb_clock_valid;   /* 0 until the first count of the stream */
+    uint32_t fb_sof;           /* SOFs in the current window */
+    uint32_t fb_sof_window;    /* SOFs per window, 8 per frame at high speed */
+    uint32_t fb_level_sum;     /* Buffer levels seen at the DMA half points */
+    uint32_t fb_level_num;
+    uint16_t fb_setpoint;      /* Level kept at the DMA half points, playback starts there */
+    uint8_t fb_data[4];        /* FS 10.14, HS 16.16 feedback on the IN endpoint, after 32-bit fields for DMA */
+#endif /* AUDIO_SPKR_FB_ENABLED */
   } USBD_AUDIO_SPKR_HandleTypeDef;
 
+  /* Init is called again each time the host selects another rate or
+     sample size, options carries the bit resolution */
   typedef struct
   {
     int8_t (*Init)(uint32_t AudioFreq, uint32_t Volume, uint32_t options);
     int8_t (*DeInit)(uint32_t options);
     int8_t (*AudioCmd)(uint8_t *pbuf, uint32_t size, uint8_t cmd);
-    int8_t (*VolumeCtl)(uint8_t vol);
+    int8_t (*VolumeCtl)(int16_t Volume);          /* 1/256 dB */
     int8_t (*MuteCtl)(uint8_t cmd);
     int8_t (*PeriodicTC)(uint8_t *pbuf, uint32_t size, uint8_t cmd);
     int8_t (*GetState)(void);
+    uint32_t (*GetClockCount)(void); /* Codec clock ticks latched at the last SOF, NULL if not captured */
+    int8_t (*ToneCtl)(uint8_t control, int8_t level); /* AUDIO_BASS/TREBLE_CONTROL in 1/4 dB */
+    uint16_t (*GetReadAhead)(uint16_t half); /* Bytes past the DMA half point the interface takes
+                                                at each Sync, NULL when the DMA plays the buffer */
   } USBD_AUDIO_SPKR_ItfTypeDef;
   /**
   * @}
@@ -102,6 +227,7 @@ extern "C" {
   extern USBD_ClassTypeDef USBD_AUDIO_SPKR;
 
   extern uint8_t AUDIO_SPKR_EP;
+  extern uint8_t AUDIO_SPKR_FB_EP;
   extern uint8_t AUDIO_SPKR_AC_ITF_NBR;
   extern uint8_t AUDIO_SPKR_AS_ITF_NBR;
   extern uint8_t AUDIO_SPKR_STR_DESC_IDX;
@@ -122,6 +248,7 @@ extern "C" {
                                    uint8_t ac_itf,
                                    uint8_t as_itf,
                                    uint8_t out_ep,
+                                   uint8_t fb_ep,
                                    uint8_t str_idx);
   /**
   * @}
@@ -20,19 +20,40 @@
   *             - 1 Audio Terminal Input (1 channel)
   *             - Audio Class-Specific AC Interfaces
   *             - Audio Class-Specific AS Interfaces
-  *             - AudioControl Requests: only SET_CUR and GET_CUR requests are supported (for Mute)
-  *             - Audio Feature Unit (limited to Mute control)
-  *             - Audio Synchronization type: Asynchronous
-  *             - Single fixed audio sampling rate (configurable in usbd_conf.h file)
+  *             - AudioControl Requests: SET_CUR and GET_CUR, and GET_MIN/MAX/RES for
+  *               volume, bass and treble
+  *             - Endpoint Requests: SET_CUR and GET_CUR of the sampling frequency
+  *             - Audio Feature Unit: mute, volume, bass and treble on the master channel
+  *             - Audio Synchronization type: Asynchronous, with an explicit feedback
+  *               endpoint when AUDIO_SPKR_FB_ENABLED
+  *             - Sampling rates AUDIO_SPKR_FREQ_0 to _2 selected by the host
   *          The current audio class version supports the following audio features:
   *             - Pulse Coded Modulation (PCM) format
-  *             - sampling rate: 48KHz.
-  *             - Bit resolution: 16
+  *             - sampling rate: 44.1, 48 or 96KHz.
+  *             - Bit resolution: 16 (alternate setting 1) or 24 (alternate setting 2)
   *             - Number of channels: 2
-  *             - No volume control
+  *             - Volume, bass and treble, applied by the interface
   *             - Mute/Unmute capability
   *             - Asynchronous Endpoints
   *
+  *          Feedback (AUDIO_SPKR_FB_ENABLED):
+  *           The codec clock runs free and the host adapts. Each SOF the class
+  *           reads the interface GetClockCount(), a free running count of the
+  *           codec clock latched by a timer capture on SOF. Over a window of
+  *           2^AUDIO_SPKR_FB_REFRESH frames the count gives the samples played
+  *           per frame in 10.14 format, sent to the host on the feedback
+  *           endpoint: 3 bytes of 10.14 per frame at full speed, 4 bytes of
+  *           16.16 per microframe at high speed. The SOF interrupt must be
+  *           enabled in the PCD (Init.Sof_enable). The playback buffer level
+  *           seen at each DMA half point trims that rate so the buffer stays
+  *           at its setpoint; without a clock count the trim alone tracks the
+  *           codec. The setpoint is half the buffer when the DMA plays it. An
+  *           interface that takes a whole half at each Sync (a converter)
+  *           reports it with GetReadAhead(), and the setpoint moves half way
+  *           between that read and a full buffer so the margin is kept both
+  *           ways. Playback starts at the setpoint, so the latency is
+  *           AUDIO_OUT_PACKET_NUM / 2 ms, 3/4 of it behind a converter.
+  *
   * @note     In HS mode and when the DMA is used, all variables and data structures
   *           dealing with the DMA during the transaction process should be 32-bit aligned.
   *
@@ -59,11 +80,13 @@
 #include "usbd_ctlreq.h"
 
 #define _AUDIO_SPKR_EP 0x01U
+#define _AUDIO_SPKR_FB_EP 0x81U
 #define _AUDIO_SPKR_AC_ITF_NBR 0x00U
 #define _AUDIO_SPKR_AS_ITF_NBR 0x01U
 #define _AUDIO_SPKR_STR_DESC_IDX 0x00U
 
 uint8_t AUDIO_SPKR_EP = _AUDIO_SPKR_EP;
+uint8_t AUDIO_SPKR_FB_EP = _AUDIO_SPKR_FB_EP;
 uint8_t AUDIO_SPKR_AC_ITF_NBR = _AUDIO_SPKR_AC_ITF_NBR;
 uint8_t AUDIO_SPKR_AS_ITF_NBR = _AUDIO_SPKR_AS_ITF_NBR;
 uint8_t AUDIO_SPKR_STR_DESC_IDX = _AUDIO_SPKR_STR_DESC_IDX;
@@ -96,8 +119,8 @@ uint8_t AUDIO_SPKR_STR_DESC_IDX = _AUDIO_SPKR_STR_DESC_IDX;
   */
 #define AUDIO_SAMPLE_FREQ(frq) (uint8_t)(frq), (uint8_t)((frq >> 8)), (uint8_t)((frq >> 16))
 
-#define AUDIO_PACKET_SZE(frq) (uint8_t)(((frq * 2U * 2U) / 1000U) & 0xFFU), \
-                              (uint8_t)((((frq * 2U * 2U) / 1000U) >> 8) & 0xFFU)
+#define AUDIO_PACKET_SZE(subframe) (uint8_t)(AUDIO_SPKR_EP_SIZE(subframe) & 0xFFU), \
+                                   (uint8_t)((AUDIO_SPKR_EP_SIZE(subframe) >> 8) & 0xFFU)
 
 /**
   * @}
@@ -120,6 +143,13 @@ static uint8_t USBD_AUDIO_SPKR_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t
 static uint8_t USBD_AUDIO_SPKR_IsoOutIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnum);
 static void USBD_AUDIO_SPKR_REQ_GetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
 static void USBD_AUDIO_SPKR_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static void USBD_AUDIO_SPKR_REQ_GetRange(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_AUDIO_SPKR_SetFormat(USBD_HandleTypeDef *pdev, USBD_AUDIO_SPKR_HandleTypeDef *haudio);
+static void USBD_AUDIO_SPKR_Advance(USBD_HandleTypeDef *pdev, USBD_AUDIO_SPKR_HandleTypeDef *haudio, uint16_t size);
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+static void USBD_AUDIO_SPKR_SendFeedback(USBD_HandleTypeDef *pdev);
+static void USBD_AUDIO_SPKR_UpdateFeedback(USBD_HandleTypeDef *pdev, USBD_AUDIO_SPKR_HandleTypeDef *haudio);
+#endif /* AUDIO_SPKR_FB_ENABLED */
 
 /**
   * @}
@@ -224,7 +254,8 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_SPKR_CfgDesc[USBD_AUDIO_SPKR_CONFIG_DESC
         AUDIO_STREAMING_CTRL,            /* bUnitID */
         0x01,                            /* bSourceID */
         0x01,                            /* bControlSize */
-        AUDIO_CONTROL_MUTE,              /* bmaControls(0) */
+        AUDIO_CONTROL_MUTE | AUDIO_CONTROL_VOLUME |
+        AUDIO_CONTROL_BASS | AUDIO_CONTROL_TREBLE, /* bmaControls(0) */
         0x00,                            /* bmaControls(1) */
         0x00,                            /* iTerminal */
         /* 09 byte*/
@@ -255,12 +286,16 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_SPKR_CfgDesc[USBD_AUDIO_SPKR_CONFIG_DESC
         /* 09 byte*/
 
         /* USB Speaker Standard AS Interface Descriptor - Audio Streaming Operational */
-        /* Interface 1, Alternate Setting 1                                           */
+        /* Interface 1, Alternate Setting 1, 16-bit samples                         */
         AUDIO_INTERFACE_DESC_SIZE,     /* bLength */
         USB_DESC_TYPE_INTERFACE,       /* bDescriptorType */
-        _AUDIO_SPKR_AS_ITF_NBR,         /* bInterfaceNumber */
-        0x01,                          /* bAlternateSetting */
+        _AUDIO_SPKR_AS_ITF_NBR,        /* bInterfaceNumber */
+        AUDIO_SPKR_ALT_16BIT,          /* bAlternateSetting */
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+        0x02,                          /* bNumEndpoints: data and feedback */
+#else
         0x01,                          /* bNumEndpoints */
+#endif /* AUDIO_SPKR_FB_ENABLED */
         USB_DEVICE_CLASS_AUDIO,        /* bInterfaceClass */
         AUDIO_SUBCLASS_AUDIOSTREAMING, /* bInterfaceSubClass */
         AUDIO_PROTOCOL_UNDEFINED,      /* bInterfaceProtocol */
@@ -277,38 +312,146 @@ __ALIGN_BEGIN static uint8_t USBD_AUDIO_SPKR_CfgDesc[USBD_AUDIO_SPKR_CONFIG_DESC
         0x00,
         /* 07 byte*/
 
-        /* USB Speaker Audio Type III Format Interface Descriptor */
-        0x0B,                               /* bLength */
-        AUDIO_INTERFACE_DESCRIPTOR_TYPE,    /* bDescriptorType */
-        AUDIO_STREAMING_FORMAT_TYPE,        /* bDescriptorSubtype */
-        AUDIO_FORMAT_TYPE_I,                /* bFormatType */
-        0x02,                               /* bNrChannels */
-        0x02,                               /* bSubFrameSize :  2 Bytes per frame (16bits) */
-        16,                                 /* bBitResolution (16-bits per sample) */
-        0x01,                               /* bSamFreqType only one frequency supported */
-        AUDIO_SAMPLE_FREQ(USBD_AUDIO_FREQ), /* Audio sampling frequency coded on 3 bytes */
-        /* 11 byte*/
+        /* USB Speaker Audio Type I Format Interface Descriptor */
+        AUDIO_SPKR_FMT_DESC_SIZE,             /* bLength */
+        AUDIO_INTERFACE_DESCRIPTOR_TYPE,      /* bDescriptorType */
+        AUDIO_STREAMING_FORMAT_TYPE,          /* bDescriptorSubtype */
+        AUDIO_FORMAT_TYPE_I,                  /* bFormatType */
+        AUDIO_SPKR_CHANNELS,                  /* bNrChannels */
+        0x02,                                 /* bSubFrameSize :  2 Bytes per sample */
+        16,                                   /* bBitResolution (16-bits per sample) */
+        AUDIO_SPKR_FREQ_NUM,                  /* bSamFreqType: discrete frequencies */
+        AUDIO_SAMPLE_FREQ(AUDIO_SPKR_FREQ_0), /* Audio sampling frequencies coded on 3 bytes */
+        AUDIO_SAMPLE_FREQ(AUDIO_SPKR_FREQ_1),
+        AUDIO_SAMPLE_FREQ(AUDIO_SPKR_FREQ_2),
+        /* 17 byte*/
 
         /* Endpoint 1 - Standard Descriptor */
         AUDIO_STANDARD_ENDPOINT_DESC_SIZE, /* bLength */
         USB_DESC_TYPE_ENDPOINT,            /* bDescriptorType */
         _AUDIO_SPKR_EP,                     /* bEndpointAddress 1 out endpoint */
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+        USBD_EP_TYPE_ISOC | 0x04U,         /* bmAttributes: isochronous, asynchronous */
+        AUDIO_PACKET_SZE(2U),              /* wMaxPacketSize in Bytes, one stereo sample over the nominal rate */
+        AUDIO_FS_BINTERVAL,                /* bInterval */
+        0x00,                              /* bRefresh */
+        _AUDIO_SPKR_FB_EP,                 /* bSynchAddress: feedback endpoint */
+#else
         USBD_EP_TYPE_ISOC,                 /* bmAttributes */
-        AUDIO_PACKET_SZE(USBD_AUDIO_FREQ), /* wMaxPacketSize in Bytes (Freq(Samples)*2(Stereo)*2(HalfWord)) */
+        AUDIO_PACKET_SZE(2U),              /* wMaxPacketSize in Bytes (Freq(Samples)*2(Stereo)*2(Bytes)) */
         AUDIO_FS_BINTERVAL,                /* bInterval */
         0x00,                              /* bRefresh */
         0x00,                              /* bSynchAddress */
+#endif /* AUDIO_SPKR_FB_ENABLED */
         /* 09 byte*/
 
         /* Endpoint - Audio Streaming Descriptor*/
         AUDIO_STREAMING_ENDPOINT_DESC_SIZE, /* bLength */
         AUDIO_ENDPOINT_DESCRIPTOR_TYPE,     /* bDescriptorType */
         AUDIO_ENDPOINT_GENERAL,             /* bDescriptor */
-        0x00,                               /* bmAttributes */
+        AUDIO_EP_ATTR_SAMPLING_FREQ,        /* bmAttributes: sampling frequency control */
         0x00,                               /* bLockDelayUnits */
         0x00,                               /* wLockDelay */
         0x00,
         /* 07 byte*/
+
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+        /* Feedback Endpoint - Standard Descriptor */
+        AUDIO_STANDARD_ENDPOINT_DESC_SIZE, /* bLength */
+        USB_DESC_TYPE_ENDPOINT,            /* bDescriptorType */
+        _AUDIO_SPKR_FB_EP,                 /* bEndpointAddress in endpoint */
+        USBD_EP_TYPE_ISOC,                 /* bmAttributes */
+        0x04,                              /* wMaxPacketSize: 3 bytes at FS, 4 at HS */
+        0x00,
+        0x01,                              /* bInterval */
+        AUDIO_SPKR_FB_REFRESH,             /* bRefresh */
+        0x00,                              /* bSynchAddress */
+        /* 09 byte*/
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
+        /* USB Speaker Standard AS Interface Descriptor - Audio Streaming Operational */
+        /* Interface 1, Alternate Setting 2, 24-bit samples                         */
+        AUDIO_INTERFACE_DESC_SIZE,     /* bLength */
+        USB_DESC_TYPE_INTERFACE,       /* bDescriptorType */
+        _AUDIO_SPKR_AS_ITF_NBR,        /* bInterfaceNumber */
+        AUDIO_SPKR_ALT_24BIT,          /* bAlternateSetting */
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+        0x02,                          /* bNumEndpoints: data and feedback */
+#else
+        0x01,                          /* bNumEndpoints */
+#endif /* AUDIO_SPKR_FB_ENABLED */
+        USB_DEVICE_CLASS_AUDIO,        /* bInterfaceClass */
+        AUDIO_SUBCLASS_AUDIOSTREAMING, /* bInterfaceSubClass */
+        AUDIO_PROTOCOL_UNDEFINED,      /* bInterfaceProtocol */
+        0x00,                          /* iInterface */
+        /* 09 byte*/
+
+        /* USB Speaker Audio Streaming Interface Descriptor */
+        AUDIO_STREAMING_INTERFACE_DESC_SIZE, /* bLength */
+        AUDIO_INTERFACE_DESCRIPTOR_TYPE,     /* bDescriptorType */
+        AUDIO_STREAMING_GENERAL,             /* bDescriptorSubtype */
+        0x01,                                /* bTerminalLink */
+        0x01,                                /* bDelay */
+        0x01,                                /* wFormatTag AUDIO_FORMAT_PCM  0x0001 */
+        0x00,
+        /* 07 byte*/
+
+        /* USB Speaker Audio Type I Format Interface Descriptor */
+        AUDIO_SPKR_FMT_DESC_SIZE,             /* bLength */
+        AUDIO_INTERFACE_DESCRIPTOR_TYPE,      /* bDescriptorType */
+        AUDIO_STREAMING_FORMAT_TYPE,          /* bDescriptorSubtype */
+        AUDIO_FORMAT_TYPE_I,                  /* bFormatType */
+        AUDIO_SPKR_CHANNELS,                  /* bNrChannels */
+        0x03,                                 /* bSubFrameSize :  3 Bytes per sample */
+        24,                                   /* bBitResolution (24-bits per sample) */
+        AUDIO_SPKR_FREQ_NUM,                  /* bSamFreqType: discrete frequencies */
+        AUDIO_SAMPLE_FREQ(AUDIO_SPKR_FREQ_0), /* Audio sampling frequencies coded on 3 bytes */
+        AUDIO_SAMPLE_FREQ(AUDIO_SPKR_FREQ_1),
+        AUDIO_SAMPLE_FREQ(AUDIO_SPKR_FREQ_2),
+        /* 17 byte*/
+
+        /* Endpoint 1 - Standard Descriptor */
+        AUDIO_STANDARD_ENDPOINT_DESC_SIZE, /* bLength */
+        USB_DESC_TYPE_ENDPOINT,            /* bDescriptorType */
+        _AUDIO_SPKR_EP,                     /* bEndpointAddress 1 out endpoint */
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+        USBD_EP_TYPE_ISOC | 0x04U,         /* bmAttributes: isochronous, asynchronous */
+        AUDIO_PACKET_SZE(3U),              /* wMaxPacketSize in Bytes, one stereo sample over the nominal rate */
+        AUDIO_FS_BINTERVAL,                /* bInterval */
+        0x00,                              /* bRefresh */
+        _AUDIO_SPKR_FB_EP,                 /* bSynchAddress: feedback endpoint */
+#else
+        USBD_EP_TYPE_ISOC,                 /* bmAttributes */
+        AUDIO_PACKET_SZE(3U),              /* wMaxPacketSize in Bytes (Freq(Samples)*2(Stereo)*3(Bytes)) */
+        AUDIO_FS_BINTERVAL,                /* bInterval */
+        0x00,                              /* bRefresh */
+        0x00,                              /* bSynchAddress */
+#endif /* AUDIO_SPKR_FB_ENABLED */
+        /* 09 byte*/
+
+        /* Endpoint - Audio Streaming Descriptor*/
+        AUDIO_STREAMING_ENDPOINT_DESC_SIZE, /* bLength */
+        AUDIO_ENDPOINT_DESCRIPTOR_TYPE,     /* bDescriptorType */
+        AUDIO_ENDPOINT_GENERAL,             /* bDescriptor */
+        AUDIO_EP_ATTR_SAMPLING_FREQ,        /* bmAttributes: sampling frequency control */
+        0x00,                               /* bLockDelayUnits */
+        0x00,                               /* wLockDelay */
+        0x00,
+        /* 07 byte*/
+
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+        /* Feedback Endpoint - Standard Descriptor */
+        AUDIO_STANDARD_ENDPOINT_DESC_SIZE, /* bLength */
+        USB_DESC_TYPE_ENDPOINT,            /* bDescriptorType */
+        _AUDIO_SPKR_FB_EP,                 /* bEndpointAddress in endpoint */
+        USBD_EP_TYPE_ISOC,                 /* bmAttributes */
+        0x04,                              /* wMaxPacketSize: 3 bytes at FS, 4 at HS */
+        0x00,
+        0x01,                              /* bInterval */
+        AUDIO_SPKR_FB_REFRESH,             /* bRefresh */
+        0x00,                              /* bSynchAddress */
+        /* 09 byte*/
+#endif /* AUDIO_SPKR_FB_ENABLED */
 };
 
 /* USB Standard Device Descriptor */
@@ -367,26 +510,26 @@ static uint8_t USBD_AUDIO_SPKR_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   }
 
   /* Open EP OUT */
-  (void)USBD_LL_OpenEP(pdev, AUDIO_SPKR_EP, USBD_EP_TYPE_ISOC, AUDIO_OUT_PACKET);
+  (void)USBD_LL_OpenEP(pdev, AUDIO_SPKR_EP, USBD_EP_TYPE_ISOC, AUDIO_OUT_MAX_PACKET);
   pdev->ep_out[AUDIO_SPKR_EP & 0xFU].is_used = 1U;
 
-  haudio->alt_setting = 0U;
-  haudio->offset = AUDIO_OFFSET_UNKNOWN;
-  haudio->wr_ptr = 0U;
-  haudio->rd_ptr = 0U;
-  haudio->rd_enable = 0U;
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  /* Open feedback EP IN */
+  pdev->ep_in[AUDIO_SPKR_FB_EP & 0xFU].bInterval = 0x01U;
+  (void)USBD_LL_OpenEP(pdev, AUDIO_SPKR_FB_EP, USBD_EP_TYPE_ISOC,
+                       (pdev->dev_speed == USBD_SPEED_HIGH) ? 4U : 3U);
+  pdev->ep_in[AUDIO_SPKR_FB_EP & 0xFU].is_used = 1U;
 
-  /* Initialize the Audio output Hardware layer */
-  if (((USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR)->Init(USBD_AUDIO_FREQ, AUDIO_DEFAULT_VOLUME, 0U) != 0U)
-  {
-    return (uint8_t)USBD_FAIL;
-  }
+  haudio->fb_sof_window = (pdev->dev_speed == USBD_SPEED_HIGH) ? (8UL << AUDIO_SPKR_FB_REFRESH) : (1UL << AUDIO_SPKR_FB_REFRESH);
+#endif /* AUDIO_SPKR_FB_ENABLED */
 
-  /* Prepare Out endpoint to receive 1st packet */
-  (void)USBD_LL_PrepareReceive(pdev, AUDIO_SPKR_EP, haudio->buffer,
-                               AUDIO_OUT_PACKET);
+  haudio->alt_setting = 0U;
+  haudio->offset = AUDIO_OFFSET_UNKNOWN;
+  haudio->freq = USBD_AUDIO_FREQ;
+  haudio->subframe = 2U;
 
-  return (uint8_t)USBD_OK;
+  /* Initialize the Audio output Hardware layer and receive the 1st packet */
+  return USBD_AUDIO_SPKR_SetFormat(pdev, haudio);
 }
 
 /**
@@ -405,6 +548,13 @@ static uint8_t USBD_AUDIO_SPKR_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   pdev->ep_out[AUDIO_SPKR_EP & 0xFU].is_used = 0U;
   pdev->ep_out[AUDIO_SPKR_EP & 0xFU].bInterval = 0U;
 
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  /* Close feedback EP IN */
+  (void)USBD_LL_CloseEP(pdev, AUDIO_SPKR_FB_EP);
+  pdev->ep_in[AUDIO_SPKR_FB_EP & 0xFU].is_used = 0U;
+  pdev->ep_in[AUDIO_SPKR_FB_EP & 0xFU].bInterval = 0U;
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
   /* DeInit  physical Interface components */
   if (pdev->pClassData_UAC_SPKR != NULL)
   {
@@ -432,6 +582,7 @@ static uint8_t USBD_AUDIO_SPKR_Setup(USBD_HandleTypeDef *pdev,
   uint16_t len;
   uint8_t *pbuf;
   uint16_t status_info = 0U;
+  uint8_t subframe;
   USBD_StatusTypeDef ret = USBD_OK;
 
   haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
@@ -454,6 +605,12 @@ static uint8_t USBD_AUDIO_SPKR_Setup(USBD_HandleTypeDef *pdev,
       USBD_AUDIO_SPKR_REQ_SetCurrent(pdev, req);
       break;
 
+    case AUDIO_REQ_GET_MIN:
+    case AUDIO_REQ_GET_MAX:
+    case AUDIO_REQ_GET_RES:
+      USBD_AUDIO_SPKR_REQ_GetRange(pdev, req);
+      break;
+
     default:
       USBD_CtlError(pdev, req);
       ret = USBD_FAIL;
@@ -504,6 +661,34 @@ static uint8_t USBD_AUDIO_SPKR_Setup(USBD_HandleTypeDef *pdev,
         if ((uint8_t)(req->wValue) <= USBD_MAX_NUM_INTERFACES)
         {
           haudio->alt_setting = (uint8_t)(req->wValue);
+
+          if (LOBYTE(req->wIndex) == AUDIO_SPKR_AS_ITF_NBR)
+          {
+            /* Each operational setting carries its own sample size */
+            subframe = (haudio->alt_setting == AUDIO_SPKR_ALT_24BIT) ? 3U : 2U;
+
+            if ((haudio->alt_setting != 0U) && (subframe != haudio->subframe))
+            {
+              haudio->subframe = subframe;
+              (void)USBD_AUDIO_SPKR_SetFormat(pdev, haudio);
+            }
+
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+            if (haudio->alt_setting != 0U)
+            {
+              /* Stream opened: measure from here, the nominal rate goes first */
+              haudio->fb_clock_valid = 0U;
+              haudio->fb_sof = 0U;
+              haudio->fb_level_sum = 0U;
+              haudio->fb_level_num = 0U;
+              USBD_AUDIO_SPKR_SendFeedback(pdev);
+            }
+            else
+            {
+              (void)USBD_LL_FlushEP(pdev, AUDIO_SPKR_FB_EP);
+            }
+#endif /* AUDIO_SPKR_FB_ENABLED */
+          }
         }
         else
         {
@@ -560,10 +745,25 @@ static uint8_t *USBD_AUDIO_SPKR_GetCfgDesc(uint16_t *length)
   */
 static uint8_t USBD_AUDIO_SPKR_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  USBD_AUDIO_SPKR_HandleTypeDef *haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+
+  if (haudio == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  /* Feedback read by the host: queue the latest rate */
+  if ((epnum == (AUDIO_SPKR_FB_EP & 0x7FU)) && (haudio->alt_setting != 0U))
+  {
+    USBD_AUDIO_SPKR_SendFeedback(pdev);
+  }
+#else
   UNUSED(pdev);
   UNUSED(epnum);
 
   /* Only OUT data are processed */
+#endif /* AUDIO_SPKR_FB_ENABLED */
   return (uint8_t)USBD_OK;
 }
 
@@ -576,6 +776,9 @@ static uint8_t USBD_AUDIO_SPKR_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t USBD_AUDIO_SPKR_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
   USBD_AUDIO_SPKR_HandleTypeDef *haudio;
+  USBD_AUDIO_SPKR_ItfTypeDef *itf;
+  uint32_t freq;
+  int8_t level;
   haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
 
   if (haudio == NULL)
@@ -589,7 +792,57 @@ static uint8_t USBD_AUDIO_SPKR_EP0_RxReady(USBD_HandleTypeDef *pdev)
 
     if (haudio->control.unit == AUDIO_STREAMING_CTRL)
     {
-      ((USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR)->MuteCtl(haudio->control.data[0]);
+      itf = (USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR;
+
+      switch (haudio->control.selector)
+      {
+      case AUDIO_MUTE_CONTROL:
+        haudio->mute = haudio->control.data[0];
+        itf->MuteCtl(haudio->mute);
+        break;
+
+      case AUDIO_VOLUME_CONTROL:
+        haudio->volume = (int16_t)((uint16_t)haudio->control.data[0] | ((uint16_t)haudio->control.data[1] << 8));
+        itf->VolumeCtl(haudio->volume);
+        break;
+
+      case AUDIO_BASS_CONTROL:
+      case AUDIO_TREBLE_CONTROL:
+        level = (int8_t)haudio->control.data[0];
+        level = MAX(MIN(level, AUDIO_TONE_MAX), AUDIO_TONE_MIN);
+        if (haudio->control.selector == AUDIO_BASS_CONTROL)
+        {
+          haudio->bass = level;
+        }
+        else
+        {
+          haudio->treble = level;
+        }
+        if (itf->ToneCtl != NULL)
+        {
+          itf->ToneCtl(haudio->control.selector, level);
+        }
+        break;
+
+      default:
+        break;
+      }
+      haudio->control.cmd = 0U;
+      haudio->control.len = 0U;
+    }
+    else if (haudio->control.unit == AUDIO_ENDPOINT_CTRL)
+    {
+      /* Sampling frequency on 3 bytes, anything not offered is ignored */
+      freq = (uint32_t)haudio->control.data[0] |
+             ((uint32_t)haudio->control.data[1] << 8) |
+             ((uint32_t)haudio->control.data[2] << 16);
+
+      if ((freq != haudio->freq) &&
+          ((freq == AUDIO_SPKR_FREQ_0) || (freq == AUDIO_SPKR_FREQ_1) || (freq == AUDIO_SPKR_FREQ_2)))
+      {
+        haudio->freq = freq;
+        (void)USBD_AUDIO_SPKR_SetFormat(pdev, haudio);
+      }
       haudio->control.cmd = 0U;
       haudio->control.len = 0U;
     }
@@ -618,21 +871,31 @@ static uint8_t USBD_AUDIO_SPKR_EP0_TxReady(USBD_HandleTypeDef *pdev)
   */
 static uint8_t USBD_AUDIO_SPKR_SOF(USBD_HandleTypeDef *pdev)
 {
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  USBD_AUDIO_SPKR_HandleTypeDef *haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+
+  if ((haudio != NULL) && (haudio->alt_setting != 0U))
+  {
+    USBD_AUDIO_SPKR_UpdateFeedback(pdev, haudio);
+  }
+#else
   UNUSED(pdev);
+#endif /* AUDIO_SPKR_FB_ENABLED */
 
   return (uint8_t)USBD_OK;
 }
 
 /**
-  * @brief  USBD_AUDIO_SOF
-  *         handle SOF event
+  * @brief  USBD_AUDIO_SPKR_Sync
+  *         Follow the playback DMA, called at its half and full transfer
   * @param  pdev: device instance
-  * @retval status
+  * @param  offset: half of the buffer the DMA just finished
+  * @retval None
   */
 void USBD_AUDIO_SPKR_Sync(USBD_HandleTypeDef *pdev, AUDIO_OffsetTypeDef offset)
 {
   USBD_AUDIO_SPKR_HandleTypeDef *haudio;
-  uint32_t BufferSize = AUDIO_TOTAL_BUF_SIZE / 2U;
+  uint32_t BufferSize;
 
   if (pdev->pClassData_UAC_SPKR == NULL)
   {
@@ -640,6 +903,7 @@ void USBD_AUDIO_SPKR_Sync(USBD_HandleTypeDef *pdev, AUDIO_OffsetTypeDef offset)
   }
 
   haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+  BufferSize = haudio->buf_size / 2U;
 
   haudio->offset = offset;
 
@@ -647,41 +911,51 @@ void USBD_AUDIO_SPKR_Sync(USBD_HandleTypeDef *pdev, AUDIO_OffsetTypeDef offset)
   {
     haudio->rd_ptr += (uint16_t)BufferSize;
 
-    if (haudio->rd_ptr == AUDIO_TOTAL_BUF_SIZE)
+    if (haudio->rd_ptr == haudio->buf_size)
     {
       /* roll back */
       haudio->rd_ptr = 0U;
     }
   }
 
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  /* The DMA sits on rd_ptr: the level is exact here, the feedback keeps it
+     at the setpoint and the playback size never changes */
+  if (haudio->rd_enable == 1U)
+  {
+    haudio->fb_level_sum += ((uint32_t)haudio->wr_ptr + haudio->buf_size - haudio->rd_ptr) % haudio->buf_size;
+    haudio->fb_level_num++;
+  }
+#else
   if (haudio->rd_ptr > haudio->wr_ptr)
   {
-    if ((haudio->rd_ptr - haudio->wr_ptr) < AUDIO_OUT_PACKET)
+    if ((haudio->rd_ptr - haudio->wr_ptr) < haudio->packet)
     {
-      BufferSize += 4U;
+      BufferSize += haudio->frame;
     }
     else
     {
-      if ((haudio->rd_ptr - haudio->wr_ptr) > (AUDIO_TOTAL_BUF_SIZE - AUDIO_OUT_PACKET))
+      if ((haudio->rd_ptr - haudio->wr_ptr) > (haudio->buf_size - haudio->packet))
       {
-        BufferSize -= 4U;
+        BufferSize -= haudio->frame;
       }
     }
   }
   else
   {
-    if ((haudio->wr_ptr - haudio->rd_ptr) < AUDIO_OUT_PACKET)
+    if ((haudio->wr_ptr - haudio->rd_ptr) < haudio->packet)
     {
-      BufferSize -= 4U;
+      BufferSize -= haudio->frame;
     }
     else
     {
-      if ((haudio->wr_ptr - haudio->rd_ptr) > (AUDIO_TOTAL_BUF_SIZE - AUDIO_OUT_PACKET))
+      if ((haudio->wr_ptr - haudio->rd_ptr) > (haudio->buf_size - haudio->packet))
       {
-        BufferSize += 4U;
+        BufferSize += haudio->frame;
       }
     }
   }
+#endif /* AUDIO_SPKR_FB_ENABLED */
 
   if (haudio->offset == AUDIO_OFFSET_FULL)
   {
@@ -699,8 +973,20 @@ void USBD_AUDIO_SPKR_Sync(USBD_HandleTypeDef *pdev, AUDIO_OffsetTypeDef offset)
   */
 static uint8_t USBD_AUDIO_SPKR_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  USBD_AUDIO_SPKR_HandleTypeDef *haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+
+  /* The host reads the feedback every 2^bRefresh frames only: the value
+     armed for the other frames expires, arm it again for the next one */
+  if ((haudio != NULL) && (epnum == (AUDIO_SPKR_FB_EP & 0x7FU)) && (haudio->alt_setting != 0U))
+  {
+    (void)USBD_LL_FlushEP(pdev, AUDIO_SPKR_FB_EP);
+    USBD_AUDIO_SPKR_SendFeedback(pdev);
+  }
+#else
   UNUSED(pdev);
   UNUSED(epnum);
+#endif /* AUDIO_SPKR_FB_ENABLED */
 
   return (uint8_t)USBD_OK;
 }
@@ -713,8 +999,31 @@ static uint8_t USBD_AUDIO_SPKR_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t
   */
 static uint8_t USBD_AUDIO_SPKR_IsoOutIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  UNUSED(pdev);
-  UNUSED(epnum);
+  USBD_AUDIO_SPKR_HandleTypeDef *haudio;
+
+  haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+
+  if ((haudio == NULL) || (epnum != AUDIO_SPKR_EP) || (haudio->alt_setting == 0U))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  /* No packet arrived in the last frame and the driver has disabled the
+     endpoint. Once playing, stand in for the lost packet with one nominal
+     packet of silence so the buffer keeps the level and phase the codec
+     and the feedback expect */
+  haudio->iso_incomplete++;
+
+  if (haudio->offset != AUDIO_OFFSET_UNKNOWN)
+  {
+    (void)USBD_memset(&haudio->buffer[haudio->wr_ptr], 0, haudio->packet);
+    USBD_AUDIO_SPKR_Advance(pdev, haudio, haudio->packet);
+  }
+
+  /* Arm again, the driver picks the odd/even frame from the frame number */
+  (void)USBD_LL_PrepareReceive(pdev, AUDIO_SPKR_EP,
+                               &haudio->buffer[haudio->wr_ptr],
+                               AUDIO_OUT_MAX_PACKET);
 
   return (uint8_t)USBD_OK;
 }
@@ -745,38 +1054,71 @@ static uint8_t USBD_AUDIO_SPKR_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
     /* Packet received Callback */
     ((USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR)->PeriodicTC(&haudio->buffer[haudio->wr_ptr], PacketSize, AUDIO_OUT_TC);
 
-    /* Increment the Buffer pointer or roll it back when all buffers are full */
-    haudio->wr_ptr += PacketSize;
-
-    if (haudio->wr_ptr == AUDIO_TOTAL_BUF_SIZE)
-    {
-      /* All buffers are full: roll back */
-      haudio->wr_ptr = 0U;
-
-      if (haudio->offset == AUDIO_OFFSET_UNKNOWN)
-      {
-        ((USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR)->AudioCmd(&haudio->buffer[0], AUDIO_TOTAL_BUF_SIZE / 2U, AUDIO_CMD_START);
-        haudio->offset = AUDIO_OFFSET_NONE;
-      }
-    }
-
-    if (haudio->rd_enable == 0U)
-    {
-      if (haudio->wr_ptr == (AUDIO_TOTAL_BUF_SIZE / 2U))
-      {
-        haudio->rd_enable = 1U;
-      }
-    }
+    USBD_AUDIO_SPKR_Advance(pdev, haudio, PacketSize);
 
     /* Prepare Out endpoint to receive next audio packet */
     (void)USBD_LL_PrepareReceive(pdev, AUDIO_SPKR_EP,
                                  &haudio->buffer[haudio->wr_ptr],
-                                 AUDIO_OUT_PACKET);
+                                 AUDIO_OUT_MAX_PACKET);
   }
 
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  USBD_AUDIO_SPKR_Advance
+  *         Account for a packet written at wr_ptr and start playback once
+  *         the buffer is half full
+  * @param  pdev: device instance
+  * @param  haudio: speaker handle
+  * @param  size: bytes of the packet
+  * @retval None
+  */
+static void USBD_AUDIO_SPKR_Advance(USBD_HandleTypeDef *pdev, USBD_AUDIO_SPKR_HandleTypeDef *haudio, uint16_t size)
+{
+  /* Increment the Buffer pointer or roll it back when all buffers are full */
+  haudio->wr_ptr += size;
+
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  /* Packets follow the host rate: one may end past the buffer */
+  if (haudio->wr_ptr >= haudio->buf_size)
+  {
+    haudio->wr_ptr -= haudio->buf_size;
+    (void)USBD_memcpy(&haudio->buffer[0], &haudio->buffer[haudio->buf_size], haudio->wr_ptr);
+  }
+
+  /* Play once at the setpoint, the feedback keeps it there */
+  if ((haudio->offset == AUDIO_OFFSET_UNKNOWN) && (haudio->wr_ptr >= haudio->fb_setpoint))
+  {
+    ((USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR)->AudioCmd(&haudio->buffer[0], haudio->buf_size / 2U, AUDIO_CMD_START);
+    haudio->offset = AUDIO_OFFSET_NONE;
+    haudio->rd_enable = 1U;
+  }
+#else
+  /* Packet sizes vary at 44.1 kHz: one may end past the buffer */
+  if (haudio->wr_ptr >= haudio->buf_size)
+  {
+    /* All buffers are full: roll back */
+    haudio->wr_ptr -= haudio->buf_size;
+    (void)USBD_memcpy(&haudio->buffer[0], &haudio->buffer[haudio->buf_size], haudio->wr_ptr);
+
+    if (haudio->offset == AUDIO_OFFSET_UNKNOWN)
+    {
+      ((USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR)->AudioCmd(&haudio->buffer[0], haudio->buf_size / 2U, AUDIO_CMD_START);
+      haudio->offset = AUDIO_OFFSET_NONE;
+    }
+  }
+
+  if (haudio->rd_enable == 0U)
+  {
+    if (haudio->wr_ptr >= (haudio->buf_size / 2U))
+    {
+      haudio->rd_enable = 1U;
+    }
+  }
+#endif /* AUDIO_SPKR_FB_ENABLED */
+}
+
 /**
   * @brief  AUDIO_Req_GetCurrent
   *         Handles the GET_CUR Audio control request.
@@ -794,10 +1136,49 @@ static void  USBD_AUDIO_SPKR_REQ_GetCurrent(USBD_HandleTypeDef *pdev, USBD_Setup
     return;
   }
 
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT)
+  {
+    if (HIBYTE(req->wValue) != AUDIO_SAMPLING_FREQ_CONTROL)
+    {
+      USBD_CtlError(pdev, req);
+      return;
+    }
+
+    /* Send the current sampling frequency on 3 bytes */
+    haudio->control.data[0] = (uint8_t)haudio->freq;
+    haudio->control.data[1] = (uint8_t)(haudio->freq >> 8);
+    haudio->control.data[2] = (uint8_t)(haudio->freq >> 16);
+
+    (void)USBD_CtlSendData(pdev, haudio->control.data, MIN(req->wLength, AUDIO_SAMPLING_FREQ_SIZE));
+    return;
+  }
+
   (void)USBD_memset(haudio->control.data, 0, 64U);
 
-  /* Send the current mute state */
-  (void)USBD_CtlSendData(pdev, haudio->control.data, req->wLength);
+  /* Send the current setting of the Feature Unit control */
+  switch (HIBYTE(req->wValue))
+  {
+  case AUDIO_MUTE_CONTROL:
+    haudio->control.data[0] = haudio->mute;
+    break;
+
+  case AUDIO_VOLUME_CONTROL:
+    haudio->control.data[0] = LOBYTE((uint16_t)haudio->volume);
+    haudio->control.data[1] = HIBYTE((uint16_t)haudio->volume);
+    break;
+
+  case AUDIO_BASS_CONTROL:
+    haudio->control.data[0] = (uint8_t)haudio->bass;
+    break;
+
+  case AUDIO_TREBLE_CONTROL:
+    haudio->control.data[0] = (uint8_t)haudio->treble;
+    break;
+
+  default:
+    break;
+  }
+  (void)USBD_CtlSendData(pdev, haudio->control.data, MIN(req->wLength, 64U));
 }
 
 /**
@@ -817,6 +1198,22 @@ static void USBD_AUDIO_SPKR_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupR
     return;
   }
 
+  if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT)
+  {
+    if ((HIBYTE(req->wValue) != AUDIO_SAMPLING_FREQ_CONTROL) || (req->wLength != AUDIO_SAMPLING_FREQ_SIZE))
+    {
+      USBD_CtlError(pdev, req);
+      return;
+    }
+
+    (void)USBD_CtlPrepareRx(pdev, haudio->control.data, req->wLength);
+
+    haudio->control.cmd = AUDIO_REQ_SET_CUR;
+    haudio->control.len = (uint8_t)req->wLength;
+    haudio->control.unit = AUDIO_ENDPOINT_CTRL;  /* Sampling frequency of the streaming endpoint */
+    return;
+  }
+
   if (req->wLength != 0U)
   {
     /* Prepare the reception of the buffer over EP0 */
@@ -825,9 +1222,56 @@ static void USBD_AUDIO_SPKR_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupR
     haudio->control.cmd = AUDIO_REQ_SET_CUR;     /* Set the request value */
     haudio->control.len = (uint8_t)req->wLength; /* Set the request data length */
     haudio->control.unit = HIBYTE(req->wIndex);  /* Set the request target unit */
+    haudio->control.selector = HIBYTE(req->wValue); /* Set the request control */
   }
 }
 
+/**
+  * @brief  AUDIO_Req_GetRange
+  *         Handles the GET_MIN, GET_MAX and GET_RES Audio control requests.
+  * @param  pdev: instance
+  * @param  req: setup class request
+  * @retval status
+  */
+static void USBD_AUDIO_SPKR_REQ_GetRange(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_AUDIO_SPKR_HandleTypeDef *haudio;
+  int16_t value;
+  uint16_t len;
+  haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+
+  if ((haudio == NULL) || ((req->bmRequest & USB_REQ_RECIPIENT_MASK) != USB_REQ_RECIPIENT_INTERFACE))
+  {
+    USBD_CtlError(pdev, req);
+    return;
+  }
+
+  switch (HIBYTE(req->wValue))
+  {
+  case AUDIO_VOLUME_CONTROL:
+    value = (req->bRequest == AUDIO_REQ_GET_MIN) ? (int16_t)AUDIO_SPKR_VOL_MIN :
+            (req->bRequest == AUDIO_REQ_GET_MAX) ? (int16_t)AUDIO_SPKR_VOL_MAX : (int16_t)AUDIO_SPKR_VOL_RES;
+    len = 2U;
+    break;
+
+  case AUDIO_BASS_CONTROL:
+  case AUDIO_TREBLE_CONTROL:
+    value = (req->bRequest == AUDIO_REQ_GET_MIN) ? AUDIO_TONE_MIN :
+            (req->bRequest == AUDIO_REQ_GET_MAX) ? AUDIO_TONE_MAX : AUDIO_TONE_RES;
+    len = 1U;
+    break;
+
+  default:
+    /* Mute has no range */
+    USBD_CtlError(pdev, req);
+    return;
+  }
+
+  haudio->control.data[0] = LOBYTE((uint16_t)value);
+  haudio->control.data[1] = HIBYTE((uint16_t)value);
+  (void)USBD_CtlSendData(pdev, haudio->control.data, MIN(req->wLength, len));
+}
+
 /**
   * @brief  DeviceQualifierDescriptor
   *         return Device Qualifier descriptor
@@ -859,21 +1303,179 @@ uint8_t USBD_AUDIO_SPKR_RegisterInterface(USBD_HandleTypeDef *pdev,
   return (uint8_t)USBD_OK;
 }
 
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+/**
+  * @brief  USBD_AUDIO_SPKR_SendFeedback
+  *         Arm the feedback endpoint with the current rate
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_AUDIO_SPKR_SendFeedback(USBD_HandleTypeDef *pdev)
+{
+  USBD_AUDIO_SPKR_HandleTypeDef *haudio = (USBD_AUDIO_SPKR_HandleTypeDef *)pdev->pClassData_UAC_SPKR;
+  uint32_t value = haudio->fb_value;
+  uint32_t len = 3U;
+
+  if (pdev->dev_speed == USBD_SPEED_HIGH)
+  {
+    /* 16.16 samples per microframe: x4 for the format, /8 for the microframe */
+    value >>= 1;
+    len = 4U;
+  }
+
+  haudio->fb_data[0] = (uint8_t)value;
+  haudio->fb_data[1] = (uint8_t)(value >> 8);
+  haudio->fb_data[2] = (uint8_t)(value >> 16);
+  haudio->fb_data[3] = (uint8_t)(value >> 24);
+
+  (void)USBD_LL_Transmit(pdev, AUDIO_SPKR_FB_EP, haudio->fb_data, len);
+}
+
+/**
+  * @brief  USBD_AUDIO_SPKR_UpdateFeedback
+  *         Count SOFs and compute the rate at the end of each window
+  * @param  pdev: device instance
+  * @param  haudio: class handle
+  * @retval None
+  */
+static void USBD_AUDIO_SPKR_UpdateFeedback(USBD_HandleTypeDef *pdev, USBD_AUDIO_SPKR_HandleTypeDef *haudio)
+{
+  USBD_AUDIO_SPKR_ItfTypeDef *itf = (USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR;
+  uint32_t rate = haudio->fb_nominal;
+  uint32_t count;
+  int32_t level;
+
+  haudio->fb_sof++;
+  if (haudio->fb_sof < haudio->fb_sof_window)
+  {
+    return;
+  }
+  haudio->fb_sof = 0U;
+
+  /* Codec samples over 2^AUDIO_SPKR_FB_REFRESH frames, a clock that does
+     not move counts as no clock */
+  if (itf->GetClockCount != NULL)
+  {
+    count = itf->GetClockCount();
+
+    if ((haudio->fb_clock_valid != 0U) && (count != haudio->fb_clock))
+    {
+      rate = (uint32_t)(((uint64_t)(count - haudio->fb_clock) << 14) /
+                        ((uint64_t)AUDIO_SPKR_FB_CLOCK_DIV << AUDIO_SPKR_FB_REFRESH));
+    }
+
+    haudio->fb_clock = count;
+    haudio->fb_clock_valid = 1U;
+  }
+
+  /* Bytes missing to the setpoint, worked off over AUDIO_SPKR_FB_LEVEL_TC
+     frames at haudio->frame bytes per stereo sample */
+  if (haudio->fb_level_num != 0U)
+  {
+    level = (int32_t)haudio->fb_setpoint - (int32_t)(haudio->fb_level_sum / haudio->fb_level_num);
+    rate = (uint32_t)((int32_t)rate + ((level * (1L << 14)) / ((int32_t)haudio->frame * (int32_t)AUDIO_SPKR_FB_LEVEL_TC)));
+
+    haudio->fb_level_sum = 0U;
+    haudio->fb_level_num = 0U;
+  }
+
+  if (rate > (haudio->fb_nominal + AUDIO_SPKR_FB_RANGE))
+  {
+    rate = haudio->fb_nominal + AUDIO_SPKR_FB_RANGE;
+  }
+  if (rate < (haudio->fb_nominal - AUDIO_SPKR_FB_RANGE))
+  {
+    rate = haudio->fb_nominal - AUDIO_SPKR_FB_RANGE;
+  }
+
+  haudio->fb_value = rate;
+}
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
+/**
+  * @brief  USBD_AUDIO_SPKR_SetFormat
+  *         Size the stream for the selected rate and sample size, then
+  *         restart the hardware layer and the reception
+  * @param  pdev: device instance
+  * @param  haudio: class handle
+  * @retval status
+  */
+static uint8_t USBD_AUDIO_SPKR_SetFormat(USBD_HandleTypeDef *pdev, USBD_AUDIO_SPKR_HandleTypeDef *haudio)
+{
+  USBD_AUDIO_SPKR_ItfTypeDef *itf = (USBD_AUDIO_SPKR_ItfTypeDef *)pdev->pUserData_UAC_SPKR;
+
+  /* The buffer layout changes under a running playback */
+  if (haudio->offset != AUDIO_OFFSET_UNKNOWN)
+  {
+    (void)itf->AudioCmd(&haudio->buffer[0], haudio->buf_size / 2U, AUDIO_CMD_STOP);
+  }
+
+  haudio->frame = (uint16_t)(AUDIO_SPKR_CHANNELS * haudio->subframe);
+  haudio->packet = (uint16_t)(AUDIO_SPKR_FRAMES(haudio->freq) * haudio->frame);
+  haudio->buf_size = (uint16_t)(haudio->packet * AUDIO_OUT_PACKET_NUM);
+  haudio->offset = AUDIO_OFFSET_UNKNOWN;
+  haudio->wr_ptr = 0U;
+  haudio->rd_ptr = 0U;
+  haudio->rd_enable = 0U;
+
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  haudio->fb_nominal = AUDIO_SPKR_FB_NOMINAL(haudio->freq);
+  haudio->fb_value = haudio->fb_nominal;
+  haudio->fb_clock_valid = 0U;
+  haudio->fb_sof = 0U;
+  haudio->fb_level_sum = 0U;
+  haudio->fb_level_num = 0U;
+
+  /* Centre the level between what the reader holds and a full buffer,
+     on a whole stereo frame */
+  haudio->fb_setpoint = (uint16_t)(haudio->buf_size / 2U);
+  if (itf->GetReadAhead != NULL)
+  {
+    haudio->fb_setpoint = (uint16_t)(MIN(itf->GetReadAhead(haudio->fb_setpoint), haudio->fb_setpoint) +
+                                     haudio->buf_size) / 2U;
+    haudio->fb_setpoint -= (uint16_t)(haudio->fb_setpoint % haudio->frame);
+  }
+#endif /* AUDIO_SPKR_FB_ENABLED */
+
+  if (itf->Init(haudio->freq, AUDIO_DEFAULT_VOLUME, 8U * (uint32_t)haudio->subframe) != 0)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  (void)USBD_LL_PrepareReceive(pdev, AUDIO_SPKR_EP, haudio->buffer,
+                               AUDIO_OUT_MAX_PACKET);
+
+  return (uint8_t)USBD_OK;
+}
+
 void USBD_Update_Audio_SPKR_DESC(uint8_t *desc,
                                  uint8_t ac_itf,
                                  uint8_t as_itf,
                                  uint8_t out_ep,
+                                 uint8_t fb_ep,
                                  uint8_t str_idx)
 {
+  uint16_t alt;
+
   desc[11] = ac_itf;
   desc[19] = ac_itf;
   desc[25] = str_idx;
   desc[34] = as_itf;
   desc[67] = as_itf;
-  desc[76] = as_itf;
-  desc[103] = out_ep;
+
+  /* Operational settings: interface, data endpoint and feedback endpoint */
+  for (alt = AUDIO_SPKR_ALT_DESC_OFFSET; alt < USBD_AUDIO_SPKR_CONFIG_DESC_SIZE; alt += AUDIO_SPKR_ALT_DESC_SIZE)
+  {
+    desc[alt + 2U] = as_itf;
+    desc[alt + 18U + AUDIO_SPKR_FMT_DESC_SIZE] = out_ep;
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+    desc[alt + 24U + AUDIO_SPKR_FMT_DESC_SIZE] = fb_ep;
+    desc[alt + 34U + AUDIO_SPKR_FMT_DESC_SIZE] = fb_ep;
+#endif /* AUDIO_SPKR_FB_ENABLED */
+  }
 
   AUDIO_SPKR_EP = out_ep;
+  AUDIO_SPKR_FB_EP = fb_ep;
   AUDIO_SPKR_AC_ITF_NBR = ac_itf;
   AUDIO_SPKR_AS_ITF_NBR = as_itf;
 
@@ -67,6 +67,28 @@ extern "C" {
 
 #define CDC_ECM_DATA_BUFFER_SIZE                        2000U
 
+/* Received frames held by the class, reception goes on while the
+   application works on the earlier ones */
+#ifndef CDC_ECM_RX_FRAMES
+#define CDC_ECM_RX_FRAMES                               4U
+#endif /* CDC_ECM_RX_FRAMES */
+
+/* Frames queued for the IN endpoint */
+#ifndef CDC_ECM_TX_FRAMES
+#define CDC_ECM_TX_FRAMES                               4U
+#endif /* CDC_ECM_TX_FRAMES */
+
+/* One received frame, wMaxSegmentSize plus the packet it may overshoot by */
+#ifndef CDC_ECM_RX_FRAME_SIZE
+#define CDC_ECM_RX_FRAME_SIZE                           2048U
+#endif /* CDC_ECM_RX_FRAME_SIZE */
+
+/* Milliseconds between two NETWORK_CONNECTION or two CONNECTION_SPEED_CHANGE
+   notifications, events raised meanwhile are merged into the next one */
+#ifndef CDC_ECM_NOTIF_INTERVAL
+#define CDC_ECM_NOTIF_INTERVAL                          100U
+#endif /* CDC_ECM_NOTIF_INTERVAL */
+
 #define CDC_ECM_DATA_HS_IN_PACKET_SIZE                  CDC_ECM_DATA_HS_MAX_PACKET_SIZE
 #define CDC_ECM_DATA_HS_OUT_PACKET_SIZE                 CDC_ECM_DATA_HS_MAX_PACKET_SIZE
 
@@ -87,6 +109,16 @@ extern "C" {
 #define CDC_ECM_NET_DISCONNECTED                                0x00U
 #define CDC_ECM_NET_CONNECTED                                   0x01U
 
+/* Notifications waiting for the CMD endpoint, sent in this order */
+#define CDC_ECM_NOTIF_CONNECTION                                0x01U
+#define CDC_ECM_NOTIF_SPEED                                     0x02U
+#define CDC_ECM_NOTIF_RESPONSE                                  0x04U
+
+/* Frame ownership */
+#define CDC_ECM_FRAME_USB                                       0x00U /* RX: free for the OUT endpoint, TX: queued or in flight */
+#define CDC_ECM_FRAME_READY                                     0x01U /* RX: waits for USBD_CDC_ECM_Process() */
+#define CDC_ECM_FRAME_APP                                       0x02U /* RX: kept by the application, TX: free */
+
 
 /* Ethernet statistics definitions */
 #define CDC_ECM_XMIT_OK_VAL                                     CDC_ECM_ETH_STATS_VAL_ENABLED
@@ -162,6 +194,20 @@ typedef struct
   uint8_t data[8];
 } USBD_CDC_ECM_NotifTypeDef;
 
+typedef struct
+{
+  uint32_t data[CDC_ECM_RX_FRAME_SIZE / 4U]; /* Force 32-bit alignment */
+  __IO uint32_t Length;
+  __IO uint32_t Owner;
+} USBD_CDC_ECM_RxFrameTypeDef;
+
+typedef struct
+{
+  uint8_t *Buffer;          /* Application buffer, sent without copy */
+  uint32_t Length;
+  __IO uint32_t Owner;
+} USBD_CDC_ECM_TxFrameTypeDef;
+
 typedef struct
 {
   uint32_t data[CDC_ECM_DATA_BUFFER_SIZE / 4U]; /* Force 32-bit alignment */
@@ -169,18 +215,33 @@ typedef struct
   uint8_t CmdLength;
   uint8_t Reserved1; /* Reserved Byte to force 4 bytes alignment of following fields */
   uint8_t Reserved2; /* Reserved Byte to force 4 bytes alignment of following fields */
-  uint8_t *RxBuffer;
   uint8_t *TxBuffer;
-  uint32_t RxLength;
+  uint32_t RxLength;        /* Bytes of the frame being received */
   uint32_t TxLength;
 
+  USBD_CDC_ECM_RxFrameTypeDef RxFrame[CDC_ECM_RX_FRAMES];
+  __IO uint32_t RxHead;     /* Frame the OUT endpoint receives into */
+  uint32_t RxTail;          /* Next frame to hand to the application */
+
+  USBD_CDC_ECM_TxFrameTypeDef TxFrame[CDC_ECM_TX_FRAMES];
+  uint32_t TxHead;          /* Next free descriptor */
+  __IO uint32_t TxTail;     /* Descriptor in flight */
+
   __IO uint32_t TxState;
-  __IO uint32_t RxState;
+  __IO uint32_t RxState;    /* 1 while the OUT endpoint NAKs until the head frame is free */
 
   __IO uint32_t MaxPcktLen;
   __IO uint32_t LinkStatus;
   __IO uint32_t NotificationStatus;
   USBD_CDC_ECM_NotifTypeDef Req;
+
+  __IO uint32_t NotifBusy;     /* 1 while Req is on the CMD endpoint */
+  __IO uint32_t NotifPending;  /* CDC_ECM_NOTIF_xxx events not sent yet */
+  uint32_t NotifSent;          /* CDC_ECM_NOTIF_xxx events sent since Init */
+  uint32_t NotifTick[2];       /* HAL tick of the last connection and speed notification */
+  uint16_t NotifConnection;    /* Latest connection state */
+  uint16_t NotifConnSent;      /* Connection state the host was told */
+  uint8_t NotifSpeed[8];       /* Latest upstream and downstream speeds */
 } USBD_CDC_ECM_HandleTypeDef;
 
 typedef enum
@@ -224,11 +285,14 @@ uint8_t USBD_CDC_ECM_RegisterInterface(USBD_HandleTypeDef *pdev,
 uint8_t USBD_CDC_ECM_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff,
                                  uint32_t length);
 
-uint8_t USBD_CDC_ECM_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
+uint8_t USBD_CDC_ECM_TransmitPacket(USBD_HandleTypeDef *pdev);
 
-uint8_t USBD_CDC_ECM_ReceivePacket(USBD_HandleTypeDef *pdev);
+uint8_t USBD_CDC_ECM_TransmitFrame(USBD_HandleTypeDef *pdev, uint8_t *pbuf,
+                                   uint32_t length);
 
-uint8_t USBD_CDC_ECM_TransmitPacket(USBD_HandleTypeDef *pdev);
+uint8_t USBD_CDC_ECM_ReleaseRxFrame(USBD_HandleTypeDef *pdev, uint8_t *pbuf);
+
+uint8_t USBD_CDC_ECM_Process(USBD_HandleTypeDef *pdev);
 
 uint8_t USBD_CDC_ECM_SendNotification(USBD_HandleTypeDef *pdev,
                                       USBD_CDC_ECM_NotifCodeTypeDef Notif,
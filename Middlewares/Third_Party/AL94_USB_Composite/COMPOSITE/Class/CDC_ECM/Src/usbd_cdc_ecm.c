@@ -10,6 +10,35 @@
   *           - Command IN transfer (class requests management)
   *           - Error management
   *
+  *  @verbatim
+  *
+  *          ===================================================================
+  *                                CDC_ECM Class Driver Description
+  *          ===================================================================
+  *           OUT: frames are received into a ring of CDC_ECM_RX_FRAMES class
+  *           buffers, used strictly in ring order. A completed frame is marked
+  *           READY and the endpoint moves on to the next buffer of the ring if
+  *           it is free. USBD_CDC_ECM_Process(), polled from the main loop,
+  *           hands READY frames to the interface Receive callback in order. A
+  *           callback returning USBD_BUSY keeps the frame until
+  *           USBD_CDC_ECM_ReleaseRxFrame(). The endpoint NAKs as soon as the
+  *           next buffer of the ring is still READY or kept by the
+  *           application, even if others are free, until that buffer is
+  *           given back.
+  *
+  *           IN: USBD_CDC_ECM_TransmitFrame() queues an application buffer on
+  *           a ring of CDC_ECM_TX_FRAMES descriptors and returns at once,
+  *           USBD_BUSY when the ring is full. Each completed transfer starts
+  *           the next queued frame before TransmitCplt gives the buffer back.
+  *
+  *           CMD: USBD_CDC_ECM_SendNotification() only records the event, one
+  *           notification at a time is on the interrupt endpoint. Events of
+  *           the same kind raised meanwhile are merged, and connection or
+  *           speed changes are spaced by CDC_ECM_NOTIF_INTERVAL, the ones
+  *           held back leave from USBD_CDC_ECM_Process().
+  *
+  *  @endverbatim
+  *
   ******************************************************************************
   * @attention
   *
@@ -104,6 +133,14 @@ static uint8_t *USBD_CDC_ECM_USRStringDescriptor(USBD_HandleTypeDef *pdev,
 
 uint8_t *USBD_CDC_ECM_GetDeviceQualifierDescriptor(uint16_t *length);
 
+static void CDC_ECM_ArmRx(USBD_HandleTypeDef *pdev);
+static void CDC_ECM_StartTx(USBD_HandleTypeDef *pdev);
+static void CDC_ECM_StartNotif(USBD_HandleTypeDef *pdev);
+
+#if (CDC_ECM_RX_FRAME_SIZE < (CDC_ECM_ETH_MAX_SEGSZE + CDC_ECM_DATA_HS_MAX_PACKET_SIZE))
+#error "CDC_ECM_RX_FRAME_SIZE must hold wMaxSegmentSize plus one HS packet"
+#endif
+
 /* USB Standard Device Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_CDC_ECM_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
     {
@@ -504,6 +541,7 @@ static uint8_t USBD_CDC_ECM_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   UNUSED(cfgidx);
 
   USBD_CDC_ECM_HandleTypeDef *hcdc;
+  uint32_t idx;
 
   hcdc = &CDC_ECM_Instance;
 
@@ -564,10 +602,32 @@ static uint8_t USBD_CDC_ECM_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   hcdc->TxLength = 0U;
   hcdc->LinkStatus = 0U;
   hcdc->NotificationStatus = 0U;
+  hcdc->NotifBusy = 0U;
+  hcdc->NotifPending = 0U;
+  hcdc->NotifSent = 0U;
   hcdc->MaxPcktLen = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_ECM_DATA_HS_MAX_PACKET_SIZE : CDC_ECM_DATA_FS_MAX_PACKET_SIZE;
 
+  /* Frames still kept by the application come back through
+     USBD_CDC_ECM_ReleaseRxFrame(), anything else is dropped */
+  for (idx = 0U; idx < CDC_ECM_RX_FRAMES; idx++)
+  {
+    if (hcdc->RxFrame[idx].Owner != CDC_ECM_FRAME_APP)
+    {
+      hcdc->RxFrame[idx].Owner = CDC_ECM_FRAME_USB;
+    }
+  }
+  hcdc->RxHead = 0U;
+  hcdc->RxTail = 0U;
+
+  for (idx = 0U; idx < CDC_ECM_TX_FRAMES; idx++)
+  {
+    hcdc->TxFrame[idx].Owner = CDC_ECM_FRAME_APP;
+  }
+  hcdc->TxHead = 0U;
+  hcdc->TxTail = 0U;
+
   /* Prepare Out endpoint to receive next packet */
-  (void)USBD_LL_PrepareReceive(pdev, CDC_ECM_OUT_EP, hcdc->RxBuffer, hcdc->MaxPcktLen);
+  CDC_ECM_ArmRx(pdev);
 
   return (uint8_t)USBD_OK;
 }
@@ -723,6 +783,9 @@ static uint8_t USBD_CDC_ECM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
   PCD_HandleTypeDef *hpcd = pdev->pData;
+  USBD_CDC_ECM_TxFrameTypeDef *frame;
+  uint8_t *buf;
+  uint32_t len;
 
   if (pdev->pClassData_CDC_ECM == NULL)
   {
@@ -742,21 +805,36 @@ static uint8_t USBD_CDC_ECM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
     }
     else
     {
+      frame = &hcdc->TxFrame[hcdc->TxTail];
+      buf = frame->Buffer;
+      len = frame->Length;
+
+      /* Give the descriptor back and keep the endpoint busy with the next one */
+      frame->Owner = CDC_ECM_FRAME_APP;
+      hcdc->TxTail = (hcdc->TxTail + 1U) % CDC_ECM_TX_FRAMES;
       hcdc->TxState = 0U;
+      CDC_ECM_StartTx(pdev);
+
       if (((USBD_CDC_ECM_ItfTypeDef *)pdev->pUserData_CDC_ECM)->TransmitCplt != NULL)
       {
-        ((USBD_CDC_ECM_ItfTypeDef *)pdev->pUserData_CDC_ECM)->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
+        ((USBD_CDC_ECM_ItfTypeDef *)pdev->pUserData_CDC_ECM)->TransmitCplt(buf, &len, epnum);
       }
     }
   }
   else if (epnum == (CDC_ECM_CMD_EP & 0x7FU))
   {
+    hcdc->NotifBusy = 0U;
+
     if (hcdc->NotificationStatus != 0U)
     {
+      hcdc->NotificationStatus = 0U;
+
       (void)USBD_CDC_ECM_SendNotification(pdev, ECM_CONNECTION_SPEED_CHANGE,
                                           0U, (uint8_t *)ConnSpeedTab);
-
-      hcdc->NotificationStatus = 0U;
+    }
+    else
+    {
+      CDC_ECM_StartNotif(pdev);
     }
   }
   else
@@ -777,6 +855,7 @@ static uint8_t USBD_CDC_ECM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t USBD_CDC_ECM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  USBD_CDC_ECM_RxFrameTypeDef *frame;
   uint32_t CurrPcktLen;
 
   if (pdev->pClassData_CDC_ECM == NULL)
@@ -786,6 +865,8 @@ static uint8_t USBD_CDC_ECM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 
   if (epnum == CDC_ECM_OUT_EP)
   {
+    frame = &hcdc->RxFrame[hcdc->RxHead];
+
     /* Get the received data length */
     CurrPcktLen = USBD_LL_GetRxDataSize(pdev, epnum);
 
@@ -795,18 +876,20 @@ static uint8_t USBD_CDC_ECM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
     /* If the buffer size is less than max packet size: it is the last packet in current frame */
     if ((CurrPcktLen < hcdc->MaxPcktLen) || (hcdc->RxLength >= CDC_ECM_ETH_MAX_SEGSZE))
     {
-      /* USB data will be immediately processed, this allow next USB traffic being
-      NAKed till the end of the application Xfer */
+      /* The frame waits for USBD_CDC_ECM_Process(), reception goes on in the next buffer */
+      frame->Length = hcdc->RxLength;
+      frame->Owner = CDC_ECM_FRAME_READY;
+
+      hcdc->RxLength = 0U;
+      hcdc->RxHead = (hcdc->RxHead + 1U) % CDC_ECM_RX_FRAMES;
 
-      /* Process data by application (ie. copy to app buffer or notify user)
-      hcdc->RxLength must be reset to zero at the end of the call of this function */
-      ((USBD_CDC_ECM_ItfTypeDef *)pdev->pUserData_CDC_ECM)->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+      CDC_ECM_ArmRx(pdev);
     }
     else
     {
       /* Prepare Out endpoint to receive next packet in current/new frame */
       (void)USBD_LL_PrepareReceive(pdev, CDC_ECM_OUT_EP,
-                                   (uint8_t *)(hcdc->RxBuffer + hcdc->RxLength),
+                                   (uint8_t *)frame->data + hcdc->RxLength,
                                    hcdc->MaxPcktLen);
     }
   }
@@ -964,12 +1047,12 @@ uint8_t USBD_CDC_ECM_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint3
 }
 
 /**
-  * @brief  USBD_CDC_ECM_SetRxBuffer
+  * @brief  USBD_CDC_ECM_TransmitPacket
+  *         Queue the buffer given to USBD_CDC_ECM_SetTxBuffer()
   * @param  pdev: device instance
-  * @param  pbuff: Rx Buffer
-  * @retval status
+  * @retval status, USBD_BUSY when the TX ring is full
   */
-uint8_t USBD_CDC_ECM_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
+uint8_t USBD_CDC_ECM_TransmitPacket(USBD_HandleTypeDef *pdev)
 {
   USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
 
@@ -978,68 +1061,169 @@ uint8_t USBD_CDC_ECM_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
     return (uint8_t)USBD_FAIL;
   }
 
-  hcdc->RxBuffer = pbuff;
-
-  return (uint8_t)USBD_OK;
+  return USBD_CDC_ECM_TransmitFrame(pdev, hcdc->TxBuffer, hcdc->TxLength);
 }
 
 /**
-  * @brief  USBD_CDC_ECM_TransmitPacket
-  *         Transmit packet on IN endpoint
+  * @brief  USBD_CDC_ECM_TransmitFrame
+  *         Queue one Ethernet frame for the IN endpoint without waiting,
+  *         callable from the main loop and from interrupts. The buffer
+  *         belongs to the class until TransmitCplt reports it.
   * @param  pdev: device instance
-  * @retval status
+  * @param  pbuf: Ethernet frame
+  * @param  length: frame length
+  * @retval status, USBD_BUSY when the TX ring is full
   */
-uint8_t USBD_CDC_ECM_TransmitPacket(USBD_HandleTypeDef *pdev)
+uint8_t USBD_CDC_ECM_TransmitFrame(USBD_HandleTypeDef *pdev, uint8_t *pbuf,
+                                   uint32_t length)
 {
   USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  USBD_CDC_ECM_TxFrameTypeDef *frame;
   USBD_StatusTypeDef ret = USBD_BUSY;
+  uint32_t primask;
 
-  if (pdev->pClassData_CDC_ECM == NULL)
+  if ((hcdc == NULL) || (length > CDC_ECM_ETH_MAX_SEGSZE))
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  if (hcdc->TxState == 0U)
-  {
-    /* Tx Transfer in progress */
-    hcdc->TxState = 1U;
+  primask = __get_PRIMASK();
+  __disable_irq();
 
-    /* Update the packet total length */
-    pdev->ep_in[CDC_ECM_IN_EP & 0xFU].total_length = hcdc->TxLength;
+  frame = &hcdc->TxFrame[hcdc->TxHead];
 
-    /* Transmit next packet */
-    (void)USBD_LL_Transmit(pdev, CDC_ECM_IN_EP, hcdc->TxBuffer, hcdc->TxLength);
+  if (frame->Owner == CDC_ECM_FRAME_APP)
+  {
+    frame->Buffer = pbuf;
+    frame->Length = length;
+    frame->Owner = CDC_ECM_FRAME_USB;
+    hcdc->TxHead = (hcdc->TxHead + 1U) % CDC_ECM_TX_FRAMES;
+
+    CDC_ECM_StartTx(pdev);
 
     ret = USBD_OK;
   }
 
+  __set_PRIMASK(primask);
+
   return (uint8_t)ret;
 }
 
 /**
-  * @brief  USBD_CDC_ECM_ReceivePacket
-  *         prepare OUT Endpoint for reception
+  * @brief  USBD_CDC_ECM_ReleaseRxFrame
+  *         Give back a frame the Receive callback kept by returning USBD_BUSY
   * @param  pdev: device instance
+  * @param  pbuf: frame buffer passed to Receive
   * @retval status
   */
-uint8_t USBD_CDC_ECM_ReceivePacket(USBD_HandleTypeDef *pdev)
+uint8_t USBD_CDC_ECM_ReleaseRxFrame(USBD_HandleTypeDef *pdev, uint8_t *pbuf)
 {
   USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  USBD_StatusTypeDef ret = USBD_FAIL;
+  uint32_t primask;
+  uint32_t idx;
 
-  if (pdev->pClassData_CDC_ECM == NULL)
+  if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  /* Prepare Out endpoint to receive next packet */
-  (void)USBD_LL_PrepareReceive(pdev, CDC_ECM_OUT_EP, hcdc->RxBuffer, hcdc->MaxPcktLen);
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  for (idx = 0U; idx < CDC_ECM_RX_FRAMES; idx++)
+  {
+    if (((uint8_t *)hcdc->RxFrame[idx].data == pbuf) &&
+        (hcdc->RxFrame[idx].Owner == CDC_ECM_FRAME_APP))
+    {
+      hcdc->RxFrame[idx].Owner = CDC_ECM_FRAME_USB;
+
+      /* Resume reception if the endpoint waited for this frame */
+      if (hcdc->RxState != 0U)
+      {
+        CDC_ECM_ArmRx(pdev);
+      }
+
+      ret = USBD_OK;
+      break;
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_ECM_Process
+  *         Hand received frames to the interface and run its background
+  *         work, to be polled from the main loop
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_CDC_ECM_Process(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  USBD_CDC_ECM_ItfTypeDef *EcmInterface = (USBD_CDC_ECM_ItfTypeDef *)pdev->pUserData_CDC_ECM;
+  USBD_CDC_ECM_RxFrameTypeDef *frame;
+  uint32_t primask;
+  uint32_t len;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  frame = &hcdc->RxFrame[hcdc->RxTail];
+
+  while (frame->Owner == CDC_ECM_FRAME_READY)
+  {
+    len = frame->Length;
+
+    if (EcmInterface->Receive((uint8_t *)frame->data, &len) == (int8_t)USBD_BUSY)
+    {
+      frame->Owner = CDC_ECM_FRAME_APP;
+    }
+    else
+    {
+      primask = __get_PRIMASK();
+      __disable_irq();
+
+      frame->Owner = CDC_ECM_FRAME_USB;
+
+      if (hcdc->RxState != 0U)
+      {
+        CDC_ECM_ArmRx(pdev);
+      }
+
+      __set_PRIMASK(primask);
+    }
+
+    hcdc->RxTail = (hcdc->RxTail + 1U) % CDC_ECM_RX_FRAMES;
+    frame = &hcdc->RxFrame[hcdc->RxTail];
+  }
+
+  /* Events held back by CDC_ECM_NOTIF_INTERVAL */
+  if (hcdc->NotifPending != 0U)
+  {
+    CDC_ECM_StartNotif(pdev);
+  }
+
+  if (EcmInterface->Process != NULL)
+  {
+    (void)EcmInterface->Process(pdev);
+  }
 
   return (uint8_t)USBD_OK;
 }
 
 /**
   * @brief  USBD_CDC_ECM_SendNotification
-  *         Transmit Notification packet on CMD IN interrupt endpoint
+  *         Queue a notification for the CMD IN interrupt endpoint. Events
+  *         raised while another one is in flight are merged: a connection
+  *         change keeps the latest state only and is dropped if the host
+  *         already knows it, a speed change keeps the latest speeds and
+  *         RESPONSE_AVAILABLE is sent once for any number of responses.
   * @param  pdev: device instance
   *         Notif: value of the notification type (from CDC_ECM_Notification_TypeDef enumeration list)
   *         bVal: value of the notification switch (ie. 0x00 or 0x01 for Network Connection notification)
@@ -1051,7 +1235,7 @@ uint8_t USBD_CDC_ECM_SendNotification(USBD_HandleTypeDef *pdev,
                                       uint16_t bVal, uint8_t *pData)
 {
   uint32_t Idx;
-  uint32_t ReqSize = 0U;
+  uint32_t primask;
   USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
   USBD_StatusTypeDef ret = USBD_OK;
 
@@ -1060,49 +1244,30 @@ uint8_t USBD_CDC_ECM_SendNotification(USBD_HandleTypeDef *pdev,
     return (uint8_t)USBD_FAIL;
   }
 
-  /* Initialize the request fields */
-  (hcdc->Req).bmRequest = CDC_ECM_BMREQUEST_TYPE_ECM;
-  (hcdc->Req).bRequest = (uint8_t)Notif;
+  primask = __get_PRIMASK();
+  __disable_irq();
 
-  switch ((hcdc->Req).bRequest)
+  switch (Notif)
   {
   case ECM_NETWORK_CONNECTION:
-    (hcdc->Req).wValue = bVal;
-    (hcdc->Req).wIndex = CDC_ECM_CMD_ITF_NBR;
-    (hcdc->Req).wLength = 0U;
-
-    for (Idx = 0U; Idx < 8U; Idx++)
-    {
-      (hcdc->Req).data[Idx] = 0U;
-    }
-    ReqSize = 8U;
+    hcdc->NotifConnection = bVal;
+    hcdc->NotifPending |= CDC_ECM_NOTIF_CONNECTION;
     break;
 
   case ECM_RESPONSE_AVAILABLE:
-    (hcdc->Req).wValue = 0U;
-    (hcdc->Req).wIndex = CDC_ECM_CMD_ITF_NBR;
-    (hcdc->Req).wLength = 0U;
-    for (Idx = 0U; Idx < 8U; Idx++)
-    {
-      (hcdc->Req).data[Idx] = 0U;
-    }
-    ReqSize = 8U;
+    hcdc->NotifPending |= CDC_ECM_NOTIF_RESPONSE;
     break;
 
   case ECM_CONNECTION_SPEED_CHANGE:
-    (hcdc->Req).wValue = 0U;
-    (hcdc->Req).wIndex = CDC_ECM_CMD_ITF_NBR;
-    (hcdc->Req).wLength = 0x0008U;
-    ReqSize = 16U;
-
     /* Check pointer to data buffer */
     if (pData != NULL)
     {
       for (Idx = 0U; Idx < 8U; Idx++)
       {
-        (hcdc->Req).data[Idx] = pData[Idx];
+        hcdc->NotifSpeed[Idx] = pData[Idx];
       }
     }
+    hcdc->NotifPending |= CDC_ECM_NOTIF_SPEED;
     break;
 
   default:
@@ -1110,10 +1275,11 @@ uint8_t USBD_CDC_ECM_SendNotification(USBD_HandleTypeDef *pdev,
     break;
   }
 
-  /* Transmit notification packet */
-  if (ReqSize != 0U)
+  __set_PRIMASK(primask);
+
+  if (ret == USBD_OK)
   {
-    (void)USBD_LL_Transmit(pdev, CDC_ECM_CMD_EP, (uint8_t *)&(hcdc->Req), ReqSize);
+    CDC_ECM_StartNotif(pdev);
   }
 
   return (uint8_t)ret;
@@ -1145,6 +1311,153 @@ void USBD_Update_CDC_ECM_DESC(uint8_t *desc,
   CDC_ECM_STR_DESC_IDX = str_idx;
 }
 
+/**
+  * @brief  CDC_ECM_ArmRx
+  *         Point the OUT endpoint at the head frame if it is free, otherwise
+  *         NAK the host until that frame is given back; called from the USB
+  *         interrupt or with interrupts masked
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void CDC_ECM_ArmRx(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  USBD_CDC_ECM_RxFrameTypeDef *frame = &hcdc->RxFrame[hcdc->RxHead];
+
+  if (frame->Owner == CDC_ECM_FRAME_USB)
+  {
+    hcdc->RxState = 0U;
+    (void)USBD_LL_PrepareReceive(pdev, CDC_ECM_OUT_EP, (uint8_t *)frame->data, hcdc->MaxPcktLen);
+  }
+  else
+  {
+    hcdc->RxState = 1U;
+  }
+}
+
+/**
+  * @brief  CDC_ECM_StartTx
+  *         Start the oldest queued frame if the IN endpoint is idle; called
+  *         from the USB interrupt or with interrupts masked
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void CDC_ECM_StartTx(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  USBD_CDC_ECM_TxFrameTypeDef *frame = &hcdc->TxFrame[hcdc->TxTail];
+
+  if ((hcdc->TxState != 0U) || (frame->Owner != CDC_ECM_FRAME_USB))
+  {
+    return;
+  }
+
+  /* Tx Transfer in progress */
+  hcdc->TxState = 1U;
+
+  /* Update the packet total length */
+  pdev->ep_in[CDC_ECM_IN_EP & 0xFU].total_length = frame->Length;
+
+  /* Transmit next packet */
+  (void)USBD_LL_Transmit(pdev, CDC_ECM_IN_EP, frame->Buffer, frame->Length);
+}
+
+/**
+  * @brief  CDC_ECM_StartNotif
+  *         Send the next pending notification if the CMD endpoint is idle,
+  *         connection and speed changes no closer than CDC_ECM_NOTIF_INTERVAL
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void CDC_ECM_StartNotif(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_ECM_HandleTypeDef *hcdc = (USBD_CDC_ECM_HandleTypeDef *)pdev->pClassData_CDC_ECM;
+  uint32_t primask;
+  uint32_t now;
+  uint32_t Idx;
+  uint32_t ReqSize = 0U;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hcdc->NotifBusy != 0U)
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  now = HAL_GetTick();
+
+  /* The host already knows this connection state */
+  if (((hcdc->NotifPending & CDC_ECM_NOTIF_CONNECTION) != 0U) &&
+      ((hcdc->NotifSent & CDC_ECM_NOTIF_CONNECTION) != 0U) &&
+      (hcdc->NotifConnection == hcdc->NotifConnSent))
+  {
+    hcdc->NotifPending &= ~CDC_ECM_NOTIF_CONNECTION;
+  }
+
+  (hcdc->Req).bmRequest = CDC_ECM_BMREQUEST_TYPE_ECM;
+  (hcdc->Req).wIndex = CDC_ECM_CMD_ITF_NBR;
+
+  /* A speed change always follows the connection it belongs to */
+  if ((hcdc->NotifPending & CDC_ECM_NOTIF_CONNECTION) != 0U)
+  {
+    if (((hcdc->NotifSent & CDC_ECM_NOTIF_CONNECTION) == 0U) ||
+        ((now - hcdc->NotifTick[0]) >= CDC_ECM_NOTIF_INTERVAL))
+    {
+      (hcdc->Req).bRequest = (uint8_t)ECM_NETWORK_CONNECTION;
+      (hcdc->Req).wValue = hcdc->NotifConnection;
+      (hcdc->Req).wLength = 0U;
+      ReqSize = 8U;
+
+      hcdc->NotifPending &= ~CDC_ECM_NOTIF_CONNECTION;
+      hcdc->NotifSent |= CDC_ECM_NOTIF_CONNECTION;
+      hcdc->NotifConnSent = hcdc->NotifConnection;
+      hcdc->NotifTick[0] = now;
+    }
+  }
+  else if ((hcdc->NotifPending & CDC_ECM_NOTIF_SPEED) != 0U)
+  {
+    if (((hcdc->NotifSent & CDC_ECM_NOTIF_SPEED) == 0U) ||
+        ((now - hcdc->NotifTick[1]) >= CDC_ECM_NOTIF_INTERVAL))
+    {
+      (hcdc->Req).bRequest = (uint8_t)ECM_CONNECTION_SPEED_CHANGE;
+      (hcdc->Req).wValue = 0U;
+      (hcdc->Req).wLength = 0x0008U;
+
+      for (Idx = 0U; Idx < 8U; Idx++)
+      {
+        (hcdc->Req).data[Idx] = hcdc->NotifSpeed[Idx];
+      }
+      ReqSize = 16U;
+
+      hcdc->NotifPending &= ~CDC_ECM_NOTIF_SPEED;
+      hcdc->NotifSent |= CDC_ECM_NOTIF_SPEED;
+      hcdc->NotifTick[1] = now;
+    }
+  }
+
+  /* Responses are not rate limited, one notification covers all of them */
+  if ((ReqSize == 0U) && ((hcdc->NotifPending & CDC_ECM_NOTIF_RESPONSE) != 0U))
+  {
+    (hcdc->Req).bRequest = (uint8_t)ECM_RESPONSE_AVAILABLE;
+    (hcdc->Req).wValue = 0U;
+    (hcdc->Req).wLength = 0U;
+    ReqSize = 8U;
+
+    hcdc->NotifPending &= ~CDC_ECM_NOTIF_RESPONSE;
+    hcdc->NotifSent |= CDC_ECM_NOTIF_RESPONSE;
+  }
+
+  if (ReqSize != 0U)
+  {
+    hcdc->NotifBusy = 1U;
+    (void)USBD_LL_Transmit(pdev, CDC_ECM_CMD_EP, (uint8_t *)&(hcdc->Req), ReqSize);
+  }
+
+  __set_PRIMASK(primask);
+}
+
 /**
   * @}
   */
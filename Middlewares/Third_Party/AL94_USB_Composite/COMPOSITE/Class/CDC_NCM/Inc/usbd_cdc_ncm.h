@@ -0,0 +1,280 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_ncm.h
+  * @author  MCD Application Team
+  * @brief   header file for the usbd_cdc_ncm.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_CDC_NCM_H
+#define __USB_CDC_NCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_ioreq.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_ncm
+  * @brief This file is the Header file for usbd_cdc_ncm.c
+  * @{
+  */
+
+
+/** @defgroup usbd_cdc_ncm_Exported_Defines
+  * @{
+  */
+
+#define CDC_NCM_STR_DESC                                "STM32 CDC NCM"
+
+#ifndef CDC_NCM_HS_BINTERVAL
+#define CDC_NCM_HS_BINTERVAL                            0x10U
+#endif /* CDC_NCM_HS_BINTERVAL */
+
+#ifndef CDC_NCM_FS_BINTERVAL
+#define CDC_NCM_FS_BINTERVAL                            0x10U
+#endif /* CDC_NCM_FS_BINTERVAL */
+
+/* Largest NTB sent to the host, the host may lower it with SET_NTB_INPUT_SIZE */
+#ifndef CDC_NCM_NTB_IN_MAX_SIZE
+#define CDC_NCM_NTB_IN_MAX_SIZE                         8192U
+#endif /* CDC_NCM_NTB_IN_MAX_SIZE */
+
+/* Largest NTB accepted from the host */
+#ifndef CDC_NCM_NTB_OUT_MAX_SIZE
+#define CDC_NCM_NTB_OUT_MAX_SIZE                        8192U
+#endif /* CDC_NCM_NTB_OUT_MAX_SIZE */
+
+/* Datagrams packed into one IN NTB at most */
+#ifndef CDC_NCM_TX_MAX_DATAGRAMS
+#define CDC_NCM_TX_MAX_DATAGRAMS                        32U
+#endif /* CDC_NCM_TX_MAX_DATAGRAMS */
+
+/* Milliseconds a partly filled IN NTB may wait for more datagrams while the
+   bus is idle, 0 sends every datagram as soon as the IN endpoint is free */
+#ifndef CDC_NCM_TX_FLUSH_TIMEOUT
+#define CDC_NCM_TX_FLUSH_TIMEOUT                        1U
+#endif /* CDC_NCM_TX_FLUSH_TIMEOUT */
+
+/* NDP chain length accepted in one OUT NTB */
+#ifndef CDC_NCM_RX_MAX_NDP
+#define CDC_NCM_RX_MAX_NDP                              4U
+#endif /* CDC_NCM_RX_MAX_NDP */
+
+/* Datagram placement inside IN NTBs, reported in GET_NTB_PARAMETERS */
+#define CDC_NCM_NDP_IN_DIVISOR                          4U
+#define CDC_NCM_NDP_IN_PAYLOAD_REMAINDER                0U
+#define CDC_NCM_NDP_IN_ALIGNMENT                        4U
+
+/* Datagram placement requested for OUT NTBs */
+#define CDC_NCM_NDP_OUT_DIVISOR                         4U
+#define CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER               0U
+#define CDC_NCM_NDP_OUT_ALIGNMENT                       4U
+
+/* CDC_NCM Endpoints parameters */
+#define CDC_NCM_DATA_HS_MAX_PACKET_SIZE                 512U  /* Endpoint IN & OUT Packet size */
+#define CDC_NCM_DATA_FS_MAX_PACKET_SIZE                 64U   /* Endpoint IN & OUT Packet size */
+#define CDC_NCM_CMD_PACKET_SIZE                         16U   /* Control Endpoint Packet size */
+
+#define CDC_NCM_CONFIG_DESC_SIZE                        94U
+
+#define CDC_NCM_CMD_BUFFER_SIZE                         64U
+
+/*---------------------------------------------------------------------*/
+/*  CDC_NCM definitions                                                */
+/*---------------------------------------------------------------------*/
+#define CDC_NCM_SEND_ENCAPSULATED_COMMAND                       0x00U
+#define CDC_NCM_GET_ENCAPSULATED_RESPONSE                       0x01U
+#define CDC_NCM_SET_ETH_MULTICAST_FILTERS                       0x40U
+#define CDC_NCM_SET_ETH_PWRM_PATTERN_FILTER                     0x41U
+#define CDC_NCM_GET_ETH_PWRM_PATTERN_FILTER                     0x42U
+#define CDC_NCM_SET_ETH_PACKET_FILTER                           0x43U
+#define CDC_NCM_GET_ETH_STATISTIC                               0x44U
+#define CDC_NCM_GET_NTB_PARAMETERS                              0x80U
+#define CDC_NCM_GET_NET_ADDRESS                                 0x81U
+#define CDC_NCM_SET_NET_ADDRESS                                 0x82U
+#define CDC_NCM_GET_NTB_FORMAT                                  0x83U
+#define CDC_NCM_SET_NTB_FORMAT                                  0x84U
+#define CDC_NCM_GET_NTB_INPUT_SIZE                              0x85U
+#define CDC_NCM_SET_NTB_INPUT_SIZE                              0x86U
+#define CDC_NCM_GET_MAX_DATAGRAM_SIZE                           0x87U
+#define CDC_NCM_SET_MAX_DATAGRAM_SIZE                           0x88U
+#define CDC_NCM_GET_CRC_MODE                                    0x89U
+#define CDC_NCM_SET_CRC_MODE                                    0x8AU
+
+#define CDC_NCM_NET_DISCONNECTED                                0x00U
+#define CDC_NCM_NET_CONNECTED                                   0x01U
+
+#define CDC_NCM_BMREQUEST_TYPE_NCM                              0xA1U
+
+/* Transfer block framing, 16-bit variant only */
+#define CDC_NCM_NTH16_SIGNATURE                                 0x484D434EU /* "NCMH" */
+#define CDC_NCM_NDP16_NOCRC_SIGNATURE                           0x304D434EU /* "NCM0" */
+#define CDC_NCM_NDP16_CRC_SIGNATURE                             0x314D434EU /* "NCM1" */
+#define CDC_NCM_NTH16_SIZE                                      12U
+#define CDC_NCM_NDP16_HEADER_SIZE                               8U
+#define CDC_NCM_NTB_PARAMETERS_SIZE                             28U
+#define CDC_NCM_NTB16_FORMAT                                    0x0001U
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CORE_Exported_TypesDefinitions
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+typedef struct
+{
+  int8_t (*Init)(void);
+  int8_t (*DeInit)(void);
+  int8_t (*Control)(uint8_t cmd, uint8_t *pbuf, uint16_t length);
+  int8_t (*Receive)(uint8_t *Buf, uint32_t *Len);
+  int8_t (*TransmitCplt)(uint8_t *Buf, uint32_t *Len, uint8_t epnum);
+  int8_t (*Process)(USBD_HandleTypeDef *pdev);
+  const uint8_t *pStrDesc;
+} USBD_CDC_NCM_ItfTypeDef;
+
+typedef struct
+{
+  uint8_t bmRequest;
+  uint8_t bRequest;
+  uint16_t wValue;
+  uint16_t wIndex;
+  uint16_t wLength;
+  uint8_t data[8];
+} USBD_CDC_NCM_NotifTypeDef;
+
+typedef struct
+{
+  uint32_t data[CDC_NCM_CMD_BUFFER_SIZE / 4U]; /* Force 32-bit alignment */
+  uint32_t RxNtb[2][CDC_NCM_NTB_OUT_MAX_SIZE / 4U];
+  uint32_t TxNtb[2][CDC_NCM_NTB_IN_MAX_SIZE / 4U];
+  uint16_t TxNdp[CDC_NCM_TX_MAX_DATAGRAMS][2]; /* wDatagramIndex, wDatagramLength */
+  uint8_t CmdOpCode;
+  uint8_t CmdLength;
+  uint8_t AltSetting;
+  uint8_t Reserved1; /* Reserved Byte to force 4 bytes alignment of following fields */
+
+  __IO uint32_t RxLength[2]; /* OUT NTB length per buffer, 0 when free */
+  __IO uint32_t RxArmed;     /* Buffer the OUT endpoint receives into, 0xFF when stalled */
+  uint32_t RxNext;           /* Next buffer to hand to the application */
+
+  uint32_t TxBuild;          /* Buffer collecting datagrams */
+  uint32_t TxCount;          /* Datagrams in the collecting buffer */
+  uint32_t TxOffset;         /* First free byte in the collecting buffer */
+  uint32_t TxTick;           /* HAL tick of the first collected datagram */
+  uint32_t TxLength;         /* Length of the NTB in flight */
+  uint16_t TxSequence;
+  uint16_t Reserved2;
+  uint32_t NtbInSize;        /* Current dwNtbInMaxSize */
+
+  __IO uint32_t TxState;
+  __IO uint32_t MaxPcktLen;
+  __IO uint32_t LinkStatus;
+  __IO uint32_t NotificationStatus;
+
+  uint32_t RxDatagrams;
+  uint32_t RxErrors;
+  uint32_t TxNtbs;
+  uint32_t TxDatagrams;
+  USBD_CDC_NCM_NotifTypeDef Req;
+} USBD_CDC_NCM_HandleTypeDef;
+
+typedef enum
+{
+  NCM_NETWORK_CONNECTION = 0x00,
+  NCM_RESPONSE_AVAILABLE = 0x01,
+  NCM_CONNECTION_SPEED_CHANGE = 0x2A
+} USBD_CDC_NCM_NotifCodeTypeDef;
+
+/** @defgroup USBD_CORE_Exported_Macros
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CORE_Exported_Variables
+  * @{
+  */
+
+extern USBD_ClassTypeDef USBD_CDC_NCM;
+
+extern uint8_t CDC_NCM_IN_EP;
+extern uint8_t CDC_NCM_OUT_EP;
+extern uint8_t CDC_NCM_CMD_EP;
+extern uint8_t CDC_NCM_CMD_ITF_NBR;
+extern uint8_t CDC_NCM_COM_ITF_NBR;
+extern uint8_t CDC_NCM_STR_DESC_IDX;
+extern uint8_t CDC_NCM_MAC_STR_DESC_IDX;
+
+/**
+  * @}
+  */
+
+/** @defgroup USB_CORE_Exported_Functions
+  * @{
+  */
+uint8_t USBD_CDC_NCM_RegisterInterface(USBD_HandleTypeDef *pdev,
+                                       USBD_CDC_NCM_ItfTypeDef *fops);
+
+uint8_t USBD_CDC_NCM_TransmitDatagram(USBD_HandleTypeDef *pdev, uint8_t *pbuf,
+                                      uint16_t length);
+
+uint8_t USBD_CDC_NCM_Flush(USBD_HandleTypeDef *pdev);
+
+uint8_t USBD_CDC_NCM_Process(USBD_HandleTypeDef *pdev);
+
+uint8_t USBD_CDC_NCM_SendNotification(USBD_HandleTypeDef *pdev,
+                                      USBD_CDC_NCM_NotifCodeTypeDef Notif,
+                                      uint16_t bVal, uint8_t *pData);
+
+void USBD_Update_CDC_NCM_DESC(uint8_t *desc,
+                              uint8_t cmd_itf,
+                              uint8_t com_itf,
+                              uint8_t in_ep,
+                              uint8_t cmd_ep,
+                              uint8_t out_ep,
+                              uint8_t str_idx);
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USB_CDC_NCM_H */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,1604 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_ncm.c
+  * @author  MCD Application Team
+  * @brief   This file provides the high layer firmware functions to manage the
+  *          following functionalities of the USB CDC_NCM Class:
+  *           - Initialization and Configuration of high and low layer
+  *           - Enumeration as CDC_NCM Device
+  *           - OUT/IN NTB transfers carrying several datagrams each
+  *           - Command IN transfer (class requests management)
+  *           - Error management
+  *
+  *  @verbatim
+  *
+  *          ===================================================================
+  *                                CDC_NCM Class Driver Description
+  *          ===================================================================
+  *           Only the 16-bit NTB format is supported, CRC mode is not.
+  *
+  *           OUT: the OUT endpoint receives a whole NTB per transfer into one
+  *           of two buffers. USBD_CDC_NCM_Process(), polled from the main loop,
+  *           walks the NDPs of a filled buffer, hands each datagram to the
+  *           interface Receive callback, then gives the buffer back to the
+  *           endpoint. While both buffers are full the endpoint NAKs.
+  *
+  *           IN: USBD_CDC_NCM_TransmitDatagram() copies a datagram into the
+  *           NTB being collected. The NTB is sent when it is full, as soon as
+  *           the NTB in flight completes, or CDC_NCM_TX_FLUSH_TIMEOUT ms after
+  *           its first datagram when the bus was idle. The NDP is written
+  *           behind the datagrams when the NTB is closed.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2019 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                             www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* BSPDependencies
+- "stm32xxxxx_{eval}{discovery}{nucleo_144}.c"
+- "stm32xxxxx_{eval}{discovery}_io.c"
+EndBSPDependencies */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_ncm.h"
+#include "usbd_ctlreq.h"
+
+#include "usbd_cdc_ncm_if.h"
+
+#define _CDC_NCM_IN_EP 0x81U       /* EP1 for data IN */
+#define _CDC_NCM_OUT_EP 0x01U      /* EP1 for data OUT */
+#define _CDC_NCM_CMD_EP 0x82U      /* EP2 for CDC NCM commands */
+#define _CDC_NCM_CMD_ITF_NBR 0x00U /* Command Interface Number 0 */
+#define _CDC_NCM_COM_ITF_NBR 0x01U /* Communication Interface Number 0 */
+#define _CDC_NCM_STR_DESC_IDX 0x00U
+#define _CDC_NCM_MAC_STR_DESC_IDX 0x00U
+
+uint8_t CDC_NCM_IN_EP = _CDC_NCM_IN_EP;
+uint8_t CDC_NCM_OUT_EP = _CDC_NCM_OUT_EP;
+uint8_t CDC_NCM_CMD_EP = _CDC_NCM_CMD_EP;
+uint8_t CDC_NCM_CMD_ITF_NBR = _CDC_NCM_CMD_ITF_NBR;
+uint8_t CDC_NCM_COM_ITF_NBR = _CDC_NCM_COM_ITF_NBR;
+uint8_t CDC_NCM_STR_DESC_IDX = _CDC_NCM_STR_DESC_IDX;
+uint8_t CDC_NCM_MAC_STR_DESC_IDX = _CDC_NCM_MAC_STR_DESC_IDX;
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup USBD_CDC_NCM
+  * @brief usbd core module
+  * @{
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_TypesDefinitions
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Defines
+  * @{
+  */
+
+#define CDC_NCM_RX_STALLED                              0xFFU
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Macros
+  * @{
+  */
+
+#define CDC_NCM_ALIGN(x, a)                             (((x) + ((a) - 1U)) & ~((a) - 1U))
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_FunctionPrototypes
+  * @{
+  */
+
+static uint8_t USBD_CDC_NCM_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_CDC_NCM_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_CDC_NCM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_CDC_NCM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_CDC_NCM_EP0_RxReady(USBD_HandleTypeDef *pdev);
+static uint8_t USBD_CDC_NCM_Setup(USBD_HandleTypeDef *pdev,
+                                  USBD_SetupReqTypedef *req);
+
+static uint8_t *USBD_CDC_NCM_GetFSCfgDesc(uint16_t *length);
+static uint8_t *USBD_CDC_NCM_GetHSCfgDesc(uint16_t *length);
+static uint8_t *USBD_CDC_NCM_GetOtherSpeedCfgDesc(uint16_t *length);
+
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+static uint8_t *USBD_CDC_NCM_USRStringDescriptor(USBD_HandleTypeDef *pdev,
+                                                 uint8_t index, uint16_t *length);
+#endif
+
+uint8_t *USBD_CDC_NCM_GetDeviceQualifierDescriptor(uint16_t *length);
+
+static void CDC_NCM_SetAlt(USBD_HandleTypeDef *pdev, uint8_t alt);
+static uint16_t CDC_NCM_ClassRequest(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static void CDC_NCM_ParseNtb(USBD_HandleTypeDef *pdev, uint8_t *ntb, uint32_t len);
+static void CDC_NCM_SendNtb(USBD_HandleTypeDef *pdev);
+static uint32_t CDC_NCM_Get32(uint8_t *addr);
+static void CDC_NCM_Put16(uint8_t *addr, uint16_t val);
+static void CDC_NCM_Put32(uint8_t *addr, uint32_t val);
+
+/* USB Standard Device Descriptor */
+__ALIGN_BEGIN static uint8_t USBD_CDC_NCM_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+    {
+        USB_LEN_DEV_QUALIFIER_DESC,
+        USB_DESC_TYPE_DEVICE_QUALIFIER,
+        0x00,
+        0x02,
+        0x00,
+        0x00,
+        0x00,
+        0x40,
+        0x01,
+        0x00,
+};
+
+static uint32_t ConnSpeedTab[2] = {CDC_NCM_CONNECT_SPEED_UPSTREAM,
+                                   CDC_NCM_CONNECT_SPEED_DOWNSTREAM};
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Variables
+  * @{
+  */
+
+static USBD_CDC_NCM_HandleTypeDef CDC_NCM_Instance;
+
+/* CDC_NCM interface class callbacks structure */
+USBD_ClassTypeDef USBD_CDC_NCM =
+    {
+        USBD_CDC_NCM_Init,
+        USBD_CDC_NCM_DeInit,
+        USBD_CDC_NCM_Setup,
+        NULL, /* EP0_TxSent, */
+        USBD_CDC_NCM_EP0_RxReady,
+        USBD_CDC_NCM_DataIn,
+        USBD_CDC_NCM_DataOut,
+        NULL,
+        NULL,
+        NULL,
+        USBD_CDC_NCM_GetHSCfgDesc,
+        USBD_CDC_NCM_GetFSCfgDesc,
+        USBD_CDC_NCM_GetOtherSpeedCfgDesc,
+        USBD_CDC_NCM_GetDeviceQualifierDescriptor,
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+        USBD_CDC_NCM_USRStringDescriptor,
+#endif
+};
+
+/* USB CDC_NCM device Configuration Descriptor */
+__ALIGN_BEGIN static uint8_t USBD_CDC_NCM_CfgHSDesc[CDC_NCM_CONFIG_DESC_SIZE] __ALIGN_END =
+    {
+        /* Configuration Descriptor */
+        0x09,                             /* bLength: Configuration Descriptor size */
+        USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
+        LOBYTE(CDC_NCM_CONFIG_DESC_SIZE), /* wTotalLength:no of returned bytes */
+        HIBYTE(CDC_NCM_CONFIG_DESC_SIZE),
+        0x02, /* bNumInterfaces: 2 interface */
+        0x01, /* bConfigurationValue: Configuration value */
+        0x00, /* iConfiguration: Index of string descriptor describing the configuration */
+#if (USBD_SELF_POWERED == 1U)
+        0xC0, /* bmAttributes: Bus Powered according to user configuration */
+#else
+        0x80, /* bmAttributes: Bus Powered according to user configuration */
+#endif
+        USBD_MAX_POWER, /* MaxPower (mA) */
+
+        /*---------------------------------------------------------------------------*/
+
+        /* IAD descriptor */
+        0x08,                  /* bLength */
+        0x0B,                  /* bDescriptorType */
+        _CDC_NCM_CMD_ITF_NBR,  /* bFirstInterface */
+        0x02,                  /* bInterfaceCount */
+        0x02,                  /* bFunctionClass: Communication Interface Class */
+        0x0D,                  /* bFunctionSubClass: Network Control Model */
+        0x00,                  /* bFunctionProtocol */
+        _CDC_NCM_STR_DESC_IDX, /* iFunction */
+
+        /* Interface Descriptor */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+        _CDC_NCM_CMD_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x00,                    /* bAlternateSetting: Alternate setting */
+        0x01,                    /* bNumEndpoints: One endpoint used */
+        0x02,                    /* bInterfaceClass: Communication Interface Class */
+        0x0D,                    /* bInterfaceSubClass: Network Control Model */
+        0x00,                    /* bInterfaceProtocol: No specific protocol required */
+        0x00,                    /* iInterface */
+
+        /* Header Functional Descriptor */
+        0x05, /* bLength: Endpoint Descriptor size */
+        0x24, /* bDescriptorType: CS_INTERFACE */
+        0x00, /* bDescriptorSubtype: Header functional descriptor */
+        0x10, /* bcdCDC: spec release number: 1.10 */
+        0x01,
+
+        /* Union Functional Descriptor */
+        0x05,                 /* bFunctionLength */
+        0x24,                 /* bDescriptorType: CS_INTERFACE */
+        0x06,                 /* bDescriptorSubtype: Union functional descriptor */
+        _CDC_NCM_CMD_ITF_NBR, /* bMasterInterface: Communication class interface */
+        _CDC_NCM_COM_ITF_NBR, /* bSlaveInterface0: Data Class Interface */
+
+        /* Ethernet Networking Functional Descriptor */
+        0x0D,                      /* bFunctionLength */
+        0x24,                      /* bDescriptorType: CS_INTERFACE */
+        0x0F,                      /* Ethernet Networking functional descriptor subtype */
+        _CDC_NCM_MAC_STR_DESC_IDX, /* iMACAddress: Device's MAC string index */
+        0x00,                      /* bmEthernetStatistics: none */
+        0x00,
+        0x00,
+        0x00,
+        LOBYTE(CDC_NCM_ETH_MAX_SEGSZE),
+        HIBYTE(CDC_NCM_ETH_MAX_SEGSZE), /* wMaxSegmentSize: Ethernet Maximum Segment size, typically 1514 bytes */
+        0x00,
+        0x00, /* wNumberMCFilters: the number of multicast filters */
+        0x00, /* bNumberPowerFilters: the number of wakeup power filters */
+
+        /* NCM Functional Descriptor */
+        0x06, /* bFunctionLength */
+        0x24, /* bDescriptorType: CS_INTERFACE */
+        0x1A, /* bDescriptorSubtype: NCM functional descriptor */
+        0x00, /* bcdNcmVersion: 1.00 */
+        0x01,
+        0x00, /* bmNetworkCapabilities: none of the optional requests */
+
+        /* Communication Endpoint Descriptor */
+        0x07,                            /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,          /* bDescriptorType: Endpoint */
+        _CDC_NCM_CMD_EP,                 /* bEndpointAddress */
+        0x03,                            /* bmAttributes: Interrupt */
+        LOBYTE(CDC_NCM_CMD_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_CMD_PACKET_SIZE),
+        CDC_NCM_HS_BINTERVAL, /* bInterval */
+
+        /*----------------------*/
+
+        /* Data class interface descriptor, no endpoints in alternate setting 0 */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+        _CDC_NCM_COM_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x00,                    /* bAlternateSetting: Alternate setting */
+        0x00,                    /* bNumEndpoints: No endpoints */
+        0x0A,                    /* bInterfaceClass: CDC */
+        0x00,                    /* bInterfaceSubClass */
+        0x01,                    /* bInterfaceProtocol: Network Transfer Block */
+        0x00,                    /* iInterface */
+
+        /* Data class interface descriptor, alternate setting 1 moves the data */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+        _CDC_NCM_COM_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x01,                    /* bAlternateSetting: Alternate setting */
+        0x02,                    /* bNumEndpoints: Two endpoints used */
+        0x0A,                    /* bInterfaceClass: CDC */
+        0x00,                    /* bInterfaceSubClass */
+        0x01,                    /* bInterfaceProtocol: Network Transfer Block */
+        0x00,                    /* iInterface */
+
+        /* Endpoint OUT Descriptor */
+        0x07,                                    /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,                  /* bDescriptorType: Endpoint */
+        _CDC_NCM_OUT_EP,                         /* bEndpointAddress */
+        0x02,                                    /* bmAttributes: Bulk */
+        LOBYTE(CDC_NCM_DATA_HS_MAX_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_DATA_HS_MAX_PACKET_SIZE),
+        0x00, /* bInterval: ignore for Bulk transfer */
+
+        /* Endpoint IN Descriptor */
+        0x07,                                    /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,                  /* bDescriptorType: Endpoint */
+        _CDC_NCM_IN_EP,                          /* bEndpointAddress */
+        0x02,                                    /* bmAttributes: Bulk */
+        LOBYTE(CDC_NCM_DATA_HS_MAX_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_DATA_HS_MAX_PACKET_SIZE),
+        0x00 /* bInterval: ignore for Bulk transfer */
+};
+
+/* USB CDC_NCM device Configuration Descriptor */
+__ALIGN_BEGIN static uint8_t USBD_CDC_NCM_CfgFSDesc[CDC_NCM_CONFIG_DESC_SIZE] __ALIGN_END =
+    {
+        /* Configuration Descriptor */
+        0x09,                             /* bLength: Configuration Descriptor size */
+        USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
+        LOBYTE(CDC_NCM_CONFIG_DESC_SIZE), /* wTotalLength: Total size of the Config descriptor */
+        HIBYTE(CDC_NCM_CONFIG_DESC_SIZE),
+        0x02, /* bNumInterfaces: 2 interface */
+        0x01, /* bConfigurationValue: Configuration value */
+        0x00, /* iConfiguration: Index of string descriptor describing the configuration */
+#if (USBD_SELF_POWERED == 1U)
+        0xC0, /* bmAttributes: Bus Powered according to user configuration */
+#else
+        0x80, /* bmAttributes: Bus Powered according to user configuration */
+#endif
+        USBD_MAX_POWER, /* MaxPower (mA) */
+
+        /*---------------------------------------------------------------------------*/
+        /* IAD descriptor */
+        0x08,                  /* bLength */
+        0x0B,                  /* bDescriptorType */
+        _CDC_NCM_CMD_ITF_NBR,  /* bFirstInterface */
+        0x02,                  /* bInterfaceCount */
+        0x02,                  /* bFunctionClass: Communication Interface Class */
+        0x0D,                  /* bFunctionSubClass: Network Control Model */
+        0x00,                  /* bFunctionProtocol */
+        _CDC_NCM_STR_DESC_IDX, /* iFunction */
+
+        /* Interface Descriptor */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+        _CDC_NCM_CMD_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x00,                    /* bAlternateSetting: Alternate setting */
+        0x01,                    /* bNumEndpoints: One endpoint used */
+        0x02,                    /* bInterfaceClass: Communication Interface Class */
+        0x0D,                    /* bInterfaceSubClass: Network Control Model */
+        0x00,                    /* bInterfaceProtocol: No specific protocol required */
+        0x00,                    /* iInterface */
+
+        /* Header Functional Descriptor */
+        0x05, /* bLength: Endpoint Descriptor size */
+        0x24, /* bDescriptorType: CS_INTERFACE */
+        0x00, /* bDescriptorSubtype: Header functional descriptor */
+        0x10, /* bcdCDC: spec release number: 1.10 */
+        0x01,
+
+        /* Union Functional Descriptor */
+        0x05,                 /* bFunctionLength */
+        0x24,                 /* bDescriptorType: CS_INTERFACE */
+        0x06,                 /* bDescriptorSubtype: Union functional descriptor */
+        _CDC_NCM_CMD_ITF_NBR, /* bMasterInterface: Communication class interface */
+        _CDC_NCM_COM_ITF_NBR, /* bSlaveInterface0: Data Class Interface */
+
+        /* Ethernet Networking Functional Descriptor */
+        0x0D,                      /* bFunctionLength */
+        0x24,                      /* bDescriptorType: CS_INTERFACE */
+        0x0F,                      /* Ethernet Networking functional descriptor subtype */
+        _CDC_NCM_MAC_STR_DESC_IDX, /* iMACAddress: Device's MAC string index */
+        0x00,                      /* bmEthernetStatistics: none */
+        0x00,
+        0x00,
+        0x00,
+        LOBYTE(CDC_NCM_ETH_MAX_SEGSZE),
+        HIBYTE(CDC_NCM_ETH_MAX_SEGSZE), /* wMaxSegmentSize: Ethernet Maximum Segment size, typically 1514 bytes */
+        0x00,
+        0x00, /* wNumberMCFilters: the number of multicast filters */
+        0x00, /* bNumberPowerFilters: the number of wakeup power filters */
+
+        /* NCM Functional Descriptor */
+        0x06, /* bFunctionLength */
+        0x24, /* bDescriptorType: CS_INTERFACE */
+        0x1A, /* bDescriptorSubtype: NCM functional descriptor */
+        0x00, /* bcdNcmVersion: 1.00 */
+        0x01,
+        0x00, /* bmNetworkCapabilities: none of the optional requests */
+
+        /* Communication Endpoint Descriptor */
+        0x07,                            /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,          /* bDescriptorType: Endpoint */
+        _CDC_NCM_CMD_EP,                 /* bEndpointAddress */
+        0x03,                            /* bmAttributes: Interrupt */
+        LOBYTE(CDC_NCM_CMD_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_CMD_PACKET_SIZE),
+        CDC_NCM_FS_BINTERVAL, /* bInterval */
+
+        /*----------------------*/
+
+        /* Data class interface descriptor, no endpoints in alternate setting 0 */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+        _CDC_NCM_COM_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x00,                    /* bAlternateSetting: Alternate setting */
+        0x00,                    /* bNumEndpoints: No endpoints */
+        0x0A,                    /* bInterfaceClass: CDC */
+        0x00,                    /* bInterfaceSubClass */
+        0x01,                    /* bInterfaceProtocol: Network Transfer Block */
+        0x00,                    /* iInterface */
+
+        /* Data class interface descriptor, alternate setting 1 moves the data */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+        _CDC_NCM_COM_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x01,                    /* bAlternateSetting: Alternate setting */
+        0x02,                    /* bNumEndpoints: Two endpoints used */
+        0x0A,                    /* bInterfaceClass: CDC */
+        0x00,                    /* bInterfaceSubClass */
+        0x01,                    /* bInterfaceProtocol: Network Transfer Block */
+        0x00,                    /* iInterface */
+
+        /* Endpoint OUT Descriptor */
+        0x07,                                    /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,                  /* bDescriptorType: Endpoint */
+        _CDC_NCM_OUT_EP,                         /* bEndpointAddress */
+        0x02,                                    /* bmAttributes: Bulk */
+        LOBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE),
+        0x00, /* bInterval: ignore for Bulk transfer */
+
+        /* Endpoint IN Descriptor */
+        0x07,                                    /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,                  /* bDescriptorType: Endpoint */
+        _CDC_NCM_IN_EP,                          /* bEndpointAddress */
+        0x02,                                    /* bmAttributes: Bulk */
+        LOBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE),
+        0x00 /* bInterval: ignore for Bulk transfer */
+};
+
+__ALIGN_BEGIN static uint8_t USBD_CDC_NCM_OtherSpeedCfgDesc[CDC_NCM_CONFIG_DESC_SIZE] __ALIGN_END =
+    {
+        /* Configuration Descriptor */
+        0x09,                             /* bLength: Configuration Descriptor size */
+        USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
+        LOBYTE(CDC_NCM_CONFIG_DESC_SIZE), /* wTotalLength */
+        HIBYTE(CDC_NCM_CONFIG_DESC_SIZE),
+        0x02, /* bNumInterfaces: 2 interfaces */
+        0x01, /* bConfigurationValue: Configuration value */
+        0x04, /* iConfiguration: Index of string descriptor describing the configuration */
+#if (USBD_SELF_POWERED == 1U)
+        0xC0, /* bmAttributes: Bus Powered according to user configuration */
+#else
+        0x80, /* bmAttributes: Bus Powered according to user configuration */
+#endif
+        USBD_MAX_POWER, /* MaxPower (mA) */
+
+        /*---------------------------------------------------------------------------*/
+        /* IAD descriptor */
+        0x08,                  /* bLength */
+        0x0B,                  /* bDescriptorType */
+        _CDC_NCM_CMD_ITF_NBR,  /* bFirstInterface */
+        0x02,                  /* bInterfaceCount */
+        0x02,                  /* bFunctionClass: Communication Interface Class */
+        0x0D,                  /* bFunctionSubClass: Network Control Model */
+        0x00,                  /* bFunctionProtocol */
+        _CDC_NCM_STR_DESC_IDX, /* iFunction */
+
+        /* Interface Descriptor */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+        _CDC_NCM_CMD_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x00,                    /* bAlternateSetting: Alternate setting */
+        0x01,                    /* bNumEndpoints: One endpoint used */
+        0x02,                    /* bInterfaceClass: Communication Interface Class */
+        0x0D,                    /* bInterfaceSubClass: Network Control Model */
+        0x00,                    /* bInterfaceProtocol: No specific protocol required */
+        0x00,                    /* iInterface */
+
+        /* Header Functional Descriptor */
+        0x05, /* bLength: Endpoint Descriptor size */
+        0x24, /* bDescriptorType: CS_INTERFACE */
+        0x00, /* bDescriptorSubtype: Header functional descriptor */
+        0x10, /* bcdCDC: spec release number: 1.10 */
+        0x01,
+
+        /* Union Functional Descriptor */
+        0x05,                 /* bFunctionLength */
+        0x24,                 /* bDescriptorType: CS_INTERFACE */
+        0x06,                 /* bDescriptorSubtype: Union functional descriptor */
+        _CDC_NCM_CMD_ITF_NBR, /* bMasterInterface: Communication class interface */
+        _CDC_NCM_COM_ITF_NBR, /* bSlaveInterface0: Data Class Interface */
+
+        /* Ethernet Networking Functional Descriptor */
+        0x0D,                      /* bFunctionLength */
+        0x24,                      /* bDescriptorType: CS_INTERFACE */
+        0x0F,                      /* Ethernet Networking functional descriptor subtype */
+        _CDC_NCM_MAC_STR_DESC_IDX, /* iMACAddress: Device's MAC string index */
+        0x00,                      /* bmEthernetStatistics: none */
+        0x00,
+        0x00,
+        0x00,
+        LOBYTE(CDC_NCM_ETH_MAX_SEGSZE),
+        HIBYTE(CDC_NCM_ETH_MAX_SEGSZE), /* wMaxSegmentSize: Ethernet Maximum Segment size, typically 1514 bytes */
+        0x00,
+        0x00, /* wNumberMCFilters: the number of multicast filters */
+        0x00, /* bNumberPowerFilters: the number of wakeup power filters */
+
+        /* NCM Functional Descriptor */
+        0x06, /* bFunctionLength */
+        0x24, /* bDescriptorType: CS_INTERFACE */
+        0x1A, /* bDescriptorSubtype: NCM functional descriptor */
+        0x00, /* bcdNcmVersion: 1.00 */
+        0x01,
+        0x00, /* bmNetworkCapabilities: none of the optional requests */
+
+        /* Communication Endpoint Descriptor */
+        0x07,                            /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT,          /* bDescriptorType: Endpoint */
+        _CDC_NCM_CMD_EP,                 /* bEndpointAddress */
+        0x03,                            /* bmAttributes: Interrupt */
+        LOBYTE(CDC_NCM_CMD_PACKET_SIZE), /* wMaxPacketSize */
+        HIBYTE(CDC_NCM_CMD_PACKET_SIZE),
+        CDC_NCM_FS_BINTERVAL, /* bInterval */
+
+        /*----------------------*/
+
+        /* Data class interface descriptor, no endpoints in alternate setting 0 */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+        _CDC_NCM_COM_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x00,                    /* bAlternateSetting: Alternate setting */
+        0x00,                    /* bNumEndpoints: No endpoints */
+        0x0A,                    /* bInterfaceClass: CDC */
+        0x00,                    /* bInterfaceSubClass */
+        0x01,                    /* bInterfaceProtocol: Network Transfer Block */
+        0x00,                    /* iInterface */
+
+        /* Data class interface descriptor, alternate setting 1 moves the data */
+        0x09,                    /* bLength: Interface Descriptor size */
+        USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+        _CDC_NCM_COM_ITF_NBR,    /* bInterfaceNumber: Number of Interface */
+        0x01,                    /* bAlternateSetting: Alternate setting */
+        0x02,                    /* bNumEndpoints: Two endpoints used */
+        0x0A,                    /* bInterfaceClass: CDC */
+        0x00,                    /* bInterfaceSubClass */
+        0x01,                    /* bInterfaceProtocol: Network Transfer Block */
+        0x00,                    /* iInterface */
+
+        /* Endpoint OUT Descriptor */
+        0x07,                   /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+        _CDC_NCM_OUT_EP,        /* bEndpointAddress */
+        0x02,                   /* bmAttributes: Bulk */
+        0x40,                   /* wMaxPacketSize */
+        0x00,
+        0x00, /* bInterval: ignore for Bulk transfer */
+
+        /* Endpoint IN Descriptor */
+        0x07,                   /* bLength: Endpoint Descriptor size */
+        USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+        _CDC_NCM_IN_EP,         /* bEndpointAddress */
+        0x02,                   /* bmAttributes: Bulk */
+        0x40,                   /* wMaxPacketSize */
+        0x00,
+        0x00 /* bInterval: ignore for Bulk transfer */
+};
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_CDC_NCM_Init
+  *         Initialize the CDC_NCM interface
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+  USBD_CDC_NCM_HandleTypeDef *hncm;
+
+  hncm = &CDC_NCM_Instance;
+
+  if (hncm == NULL)
+  {
+    pdev->pClassData_CDC_NCM = NULL;
+    return (uint8_t)USBD_EMEM;
+  }
+
+  pdev->pClassData_CDC_NCM = (void *)hncm;
+
+  if (pdev->dev_speed == USBD_SPEED_HIGH)
+  {
+    /* Set bInterval for CDC NCM CMD Endpoint */
+    pdev->ep_in[CDC_NCM_CMD_EP & 0xFU].bInterval = CDC_NCM_HS_BINTERVAL;
+  }
+  else
+  {
+    /* Set bInterval for CDC NCM CMD Endpoint */
+    pdev->ep_in[CDC_NCM_CMD_EP & 0xFU].bInterval = CDC_NCM_FS_BINTERVAL;
+  }
+
+  /* Open Command IN EP, the data endpoints only exist in alternate setting 1 */
+  (void)USBD_LL_OpenEP(pdev, CDC_NCM_CMD_EP, USBD_EP_TYPE_INTR, CDC_NCM_CMD_PACKET_SIZE);
+  pdev->ep_in[CDC_NCM_CMD_EP & 0xFU].is_used = 1U;
+
+  /* Init  physical Interface components */
+  ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->Init();
+
+  /* Init Xfer states */
+  hncm->CmdOpCode = 0xFFU;
+  hncm->AltSetting = 0U;
+  hncm->RxLength[0] = 0U;
+  hncm->RxLength[1] = 0U;
+  hncm->RxArmed = CDC_NCM_RX_STALLED;
+  hncm->RxNext = 0U;
+  hncm->TxBuild = 0U;
+  hncm->TxCount = 0U;
+  hncm->TxState = 0U;
+  hncm->TxSequence = 0U;
+  hncm->NtbInSize = CDC_NCM_NTB_IN_MAX_SIZE;
+  hncm->LinkStatus = 0U;
+  hncm->NotificationStatus = 0U;
+  hncm->MaxPcktLen = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_NCM_DATA_HS_MAX_PACKET_SIZE : CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_DeInit
+  *         DeInitialize the CDC_NCM layer
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+  /* Close the data endpoints */
+  CDC_NCM_SetAlt(pdev, 0U);
+
+  /* Close Command IN EP */
+  (void)USBD_LL_CloseEP(pdev, CDC_NCM_CMD_EP);
+  pdev->ep_in[CDC_NCM_CMD_EP & 0xFU].is_used = 0U;
+  pdev->ep_in[CDC_NCM_CMD_EP & 0xFU].bInterval = 0U;
+
+  /* DeInit  physical Interface components */
+  if (pdev->pClassData_CDC_NCM != NULL)
+  {
+    ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->DeInit();
+    pdev->pClassData_CDC_NCM = NULL;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_Setup
+  *         Handle the CDC_NCM specific requests
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_Setup(USBD_HandleTypeDef *pdev,
+                                  USBD_SetupReqTypedef *req)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  USBD_CDC_NCM_ItfTypeDef *NcmInterface = (USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM;
+  USBD_StatusTypeDef ret = USBD_OK;
+  uint16_t len;
+  uint16_t status_info = 0U;
+  uint8_t ifalt = 0U;
+
+  if (hncm == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+  case USB_REQ_TYPE_CLASS:
+    if ((req->bmRequest & 0x80U) != 0U)
+    {
+      len = CDC_NCM_ClassRequest(pdev, req);
+
+      if (len == 0U)
+      {
+        NcmInterface->Control(req->bRequest,
+                              (uint8_t *)hncm->data, req->wLength);
+
+        len = req->wLength;
+      }
+
+      len = MIN(CDC_NCM_CMD_BUFFER_SIZE, MIN(len, req->wLength));
+      (void)USBD_CtlSendData(pdev, (uint8_t *)hncm->data, len);
+    }
+    else if (req->wLength != 0U)
+    {
+      hncm->CmdOpCode = req->bRequest;
+      hncm->CmdLength = (uint8_t)MIN(req->wLength, USB_MAX_EP0_SIZE);
+
+      (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hncm->data, hncm->CmdLength);
+    }
+    else if (req->bRequest == CDC_NCM_SET_NTB_FORMAT)
+    {
+      /* Only NTB16 is offered */
+      if (req->wValue != 0U)
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+    }
+    else
+    {
+      NcmInterface->Control(req->bRequest, (uint8_t *)req, 0U);
+    }
+    break;
+
+  case USB_REQ_TYPE_STANDARD:
+    switch (req->bRequest)
+    {
+    case USB_REQ_GET_STATUS:
+      if (pdev->dev_state == USBD_STATE_CONFIGURED)
+      {
+        (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
+      }
+      else
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+      break;
+
+    case USB_REQ_GET_INTERFACE:
+      if (pdev->dev_state == USBD_STATE_CONFIGURED)
+      {
+        if (LOBYTE(req->wIndex) == CDC_NCM_COM_ITF_NBR)
+        {
+          ifalt = hncm->AltSetting;
+        }
+        (void)USBD_CtlSendData(pdev, &ifalt, 1U);
+      }
+      else
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+      break;
+
+    case USB_REQ_SET_INTERFACE:
+      if (pdev->dev_state != USBD_STATE_CONFIGURED)
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+      }
+      else if (LOBYTE(req->wIndex) == CDC_NCM_COM_ITF_NBR)
+      {
+        if (req->wValue <= 1U)
+        {
+          CDC_NCM_SetAlt(pdev, (uint8_t)req->wValue);
+        }
+        else
+        {
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+        }
+      }
+      break;
+
+    case USB_REQ_CLEAR_FEATURE:
+      break;
+
+    default:
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+      break;
+    }
+    break;
+
+  default:
+    USBD_CtlError(pdev, req);
+    ret = USBD_FAIL;
+    break;
+  }
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_DataIn
+  *         Data sent on non-control IN endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  PCD_HandleTypeDef *hpcd = pdev->pData;
+
+  if (pdev->pClassData_CDC_NCM == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (epnum == (CDC_NCM_IN_EP & 0x7FU))
+  {
+    /* A short NTB ending on a packet boundary needs a ZLP, a full size one does not */
+    if ((pdev->ep_in[epnum].total_length > 0U) &&
+        (pdev->ep_in[epnum].total_length < hncm->NtbInSize) &&
+        ((pdev->ep_in[epnum].total_length % hpcd->IN_ep[epnum].maxpacket) == 0U))
+    {
+      /* Update the packet total length */
+      pdev->ep_in[epnum].total_length = 0U;
+
+      /* Send ZLP */
+      (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
+    }
+    else
+    {
+      hncm->TxState = 0U;
+      if (((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->TransmitCplt != NULL)
+      {
+        ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->TransmitCplt((uint8_t *)hncm->TxNtb[hncm->TxBuild ^ 1U],
+                                                                          &hncm->TxLength, epnum);
+      }
+
+      /* Datagrams queued while this NTB was on the bus go out right away */
+      if ((hncm->TxState == 0U) && (hncm->TxCount != 0U))
+      {
+        CDC_NCM_SendNtb(pdev);
+      }
+    }
+  }
+  else if (epnum == (CDC_NCM_CMD_EP & 0x7FU))
+  {
+    if (hncm->NotificationStatus != 0U)
+    {
+      (void)USBD_CDC_NCM_SendNotification(pdev, NCM_CONNECTION_SPEED_CHANGE,
+                                          0U, (uint8_t *)ConnSpeedTab);
+
+      hncm->NotificationStatus = 0U;
+    }
+  }
+  else
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_DataOut
+  *         Data received on non-control Out endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  uint32_t idx;
+
+  if (pdev->pClassData_CDC_NCM == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if ((epnum != CDC_NCM_OUT_EP) || (hncm->RxArmed == CDC_NCM_RX_STALLED))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  idx = hncm->RxArmed;
+
+  /* The transfer covers a whole NTB: it ends on a short packet or when the buffer is full */
+  hncm->RxLength[idx] = USBD_LL_GetRxDataSize(pdev, epnum);
+
+  if (hncm->RxLength[idx] == 0U)
+  {
+    /* Stray ZLP, receive into the same buffer again */
+    (void)USBD_LL_PrepareReceive(pdev, CDC_NCM_OUT_EP, (uint8_t *)hncm->RxNtb[idx],
+                                 CDC_NCM_NTB_OUT_MAX_SIZE);
+  }
+  else if (hncm->RxLength[idx ^ 1U] == 0U)
+  {
+    hncm->RxArmed = idx ^ 1U;
+    (void)USBD_LL_PrepareReceive(pdev, CDC_NCM_OUT_EP, (uint8_t *)hncm->RxNtb[idx ^ 1U],
+                                 CDC_NCM_NTB_OUT_MAX_SIZE);
+  }
+  else
+  {
+    /* Both buffers wait for USBD_CDC_NCM_Process(), NAK the host meanwhile */
+    hncm->RxArmed = CDC_NCM_RX_STALLED;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_EP0_RxReady
+  *         Handle EP0 Rx Ready event
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_EP0_RxReady(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  uint32_t size;
+
+  if (hncm == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (hncm->CmdOpCode == CDC_NCM_SET_NTB_INPUT_SIZE)
+  {
+    size = (hncm->CmdLength >= 4U) ? CDC_NCM_Get32((uint8_t *)hncm->data) : 0U;
+
+    /* Keep what fits in the IN buffers, the host only gets smaller NTBs */
+    if ((size >= (CDC_NCM_NTH16_SIZE + 16U + CDC_NCM_ETH_MAX_SEGSZE)) && (size <= CDC_NCM_NTB_IN_MAX_SIZE))
+    {
+      hncm->NtbInSize = size;
+    }
+    else
+    {
+      /* An invalid size is refused, the status stage is stalled */
+      USBD_CtlError(pdev, NULL);
+    }
+    hncm->CmdOpCode = 0xFFU;
+  }
+  else if ((pdev->pUserData_CDC_NCM != NULL) && (hncm->CmdOpCode != 0xFFU))
+  {
+    ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->Control(hncm->CmdOpCode, (uint8_t *)hncm->data, (uint16_t)hncm->CmdLength);
+    hncm->CmdOpCode = 0xFFU;
+  }
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_NCM_GetFSCfgDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_CDC_NCM_CfgFSDesc);
+
+  return USBD_CDC_NCM_CfgFSDesc;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetHSCfgDesc
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_NCM_GetHSCfgDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_CDC_NCM_CfgHSDesc);
+
+  return USBD_CDC_NCM_CfgHSDesc;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetCfgDesc
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_NCM_GetOtherSpeedCfgDesc(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_CDC_NCM_OtherSpeedCfgDesc);
+
+  return USBD_CDC_NCM_OtherSpeedCfgDesc;
+}
+
+/**
+  * @brief  DeviceQualifierDescriptor
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+uint8_t *USBD_CDC_NCM_GetDeviceQualifierDescriptor(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_CDC_NCM_DeviceQualifierDesc);
+
+  return USBD_CDC_NCM_DeviceQualifierDesc;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: CD  Interface callback
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_RegisterInterface(USBD_HandleTypeDef *pdev,
+                                       USBD_CDC_NCM_ItfTypeDef *fops)
+{
+  if (fops == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  pdev->pUserData_CDC_NCM = fops;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_USRStringDescriptor
+  *         Manages the transfer of user string descriptors.
+  * @param  speed : current device speed
+  * @param  index: descriptor index
+  * @param  length : pointer data length
+  * @retval pointer to the descriptor table or NULL if the descriptor is not supported.
+  */
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+static uint8_t *USBD_CDC_NCM_USRStringDescriptor(USBD_HandleTypeDef *pdev, uint8_t index, uint16_t *length)
+{
+  static uint8_t USBD_StrDesc[255];
+
+  /* Check if the requested string interface is supported */
+  if (index == CDC_NCM_MAC_STR_DESC_IDX)
+  {
+    USBD_GetString((uint8_t *)((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->pStrDesc, USBD_StrDesc, length);
+    return USBD_StrDesc;
+  }
+  /* Not supported Interface Descriptor index */
+  else
+  {
+    return NULL;
+  }
+}
+#endif
+
+/**
+  * @brief  USBD_CDC_NCM_TransmitDatagram
+  *         Copy a datagram into the IN NTB being collected
+  * @note   Called from the main loop, runs with interrupts masked for the
+  *         duration of one datagram copy.
+  * @param  pdev: device instance
+  * @param  pbuf: datagram
+  * @param  length: datagram length
+  * @retval USBD_OK if queued, USBD_BUSY if both NTB buffers are in use,
+  *         USBD_FAIL if the data interface is down or the datagram too long
+  */
+uint8_t USBD_CDC_NCM_TransmitDatagram(USBD_HandleTypeDef *pdev, uint8_t *pbuf,
+                                      uint16_t length)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  USBD_StatusTypeDef ret = USBD_OK;
+  uint32_t primask;
+  uint32_t pos;
+  uint32_t end;
+
+  if ((hncm == NULL) || (hncm->AltSetting == 0U) ||
+      (length == 0U) || (length > CDC_NCM_ETH_MAX_SEGSZE))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hncm->TxCount == 0U)
+  {
+    hncm->TxOffset = CDC_NCM_NTH16_SIZE;
+  }
+
+  pos = CDC_NCM_ALIGN(hncm->TxOffset, CDC_NCM_NDP_IN_DIVISOR) + CDC_NCM_NDP_IN_PAYLOAD_REMAINDER;
+  end = CDC_NCM_ALIGN(pos + length, CDC_NCM_NDP_IN_ALIGNMENT) +
+        CDC_NCM_NDP16_HEADER_SIZE + ((hncm->TxCount + 2U) * 4U);
+
+  if ((hncm->TxCount == CDC_NCM_TX_MAX_DATAGRAMS) || (end > hncm->NtbInSize))
+  {
+    if (hncm->TxState != 0U)
+    {
+      ret = USBD_BUSY;
+    }
+    else
+    {
+      CDC_NCM_SendNtb(pdev);
+
+      hncm->TxOffset = CDC_NCM_NTH16_SIZE;
+      pos = CDC_NCM_ALIGN(hncm->TxOffset, CDC_NCM_NDP_IN_DIVISOR) + CDC_NCM_NDP_IN_PAYLOAD_REMAINDER;
+    }
+  }
+
+  if (ret == USBD_OK)
+  {
+    (void)memcpy((uint8_t *)hncm->TxNtb[hncm->TxBuild] + pos, pbuf, length);
+
+    hncm->TxNdp[hncm->TxCount][0] = (uint16_t)pos;
+    hncm->TxNdp[hncm->TxCount][1] = length;
+    hncm->TxOffset = pos + length;
+
+    if (hncm->TxCount == 0U)
+    {
+      hncm->TxTick = HAL_GetTick();
+    }
+    hncm->TxCount++;
+
+#if (CDC_NCM_TX_FLUSH_TIMEOUT == 0U)
+    if (hncm->TxState == 0U)
+    {
+      CDC_NCM_SendNtb(pdev);
+    }
+#endif
+  }
+
+  __set_PRIMASK(primask);
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_Flush
+  *         Send the collected datagrams without waiting for the timeout
+  * @param  pdev: device instance
+  * @retval USBD_OK if sent or nothing was queued, USBD_BUSY if an NTB is in flight
+  */
+uint8_t USBD_CDC_NCM_Flush(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  USBD_StatusTypeDef ret = USBD_OK;
+  uint32_t primask;
+
+  if (hncm == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hncm->TxCount != 0U)
+  {
+    if (hncm->TxState == 0U)
+    {
+      CDC_NCM_SendNtb(pdev);
+    }
+    else
+    {
+      /* Goes out from DataIn when the NTB in flight completes */
+      ret = USBD_BUSY;
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_Process
+  *         Hand received datagrams to the interface and flush the IN NTB
+  *         once its timeout expired, to be polled from the main loop
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_Process(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  uint32_t primask;
+  uint32_t idx;
+
+  if (hncm == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  idx = hncm->RxNext;
+
+  if (hncm->RxLength[idx] != 0U)
+  {
+    CDC_NCM_ParseNtb(pdev, (uint8_t *)hncm->RxNtb[idx], hncm->RxLength[idx]);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    hncm->RxLength[idx] = 0U;
+    hncm->RxNext = idx ^ 1U;
+
+    if ((hncm->RxArmed == CDC_NCM_RX_STALLED) && (hncm->AltSetting != 0U))
+    {
+      hncm->RxArmed = idx;
+      (void)USBD_LL_PrepareReceive(pdev, CDC_NCM_OUT_EP, (uint8_t *)hncm->RxNtb[idx],
+                                   CDC_NCM_NTB_OUT_MAX_SIZE);
+    }
+
+    __set_PRIMASK(primask);
+  }
+
+  if ((hncm->TxCount != 0U) && (hncm->TxState == 0U) &&
+      ((HAL_GetTick() - hncm->TxTick) >= CDC_NCM_TX_FLUSH_TIMEOUT))
+  {
+    (void)USBD_CDC_NCM_Flush(pdev);
+  }
+
+  if (((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->Process != NULL)
+  {
+    (void)((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->Process(pdev);
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_SendNotification
+  *         Transmit Notification packet on CMD IN interrupt endpoint
+  * @param  pdev: device instance
+  *         Notif: value of the notification type (from CDC_NCM_Notification_TypeDef enumeration list)
+  *         bVal: value of the notification switch (ie. 0x00 or 0x01 for Network Connection notification)
+  *         pData: pointer to data buffer (ie. upstream and downstream connection speed values)
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_SendNotification(USBD_HandleTypeDef *pdev,
+                                      USBD_CDC_NCM_NotifCodeTypeDef Notif,
+                                      uint16_t bVal, uint8_t *pData)
+{
+  uint32_t Idx;
+  uint32_t ReqSize = 0U;
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  USBD_StatusTypeDef ret = USBD_OK;
+
+  if (hncm == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  /* Initialize the request fields */
+  (hncm->Req).bmRequest = CDC_NCM_BMREQUEST_TYPE_NCM;
+  (hncm->Req).bRequest = (uint8_t)Notif;
+
+  switch ((hncm->Req).bRequest)
+  {
+  case NCM_NETWORK_CONNECTION:
+  case NCM_RESPONSE_AVAILABLE:
+    (hncm->Req).wValue = (Notif == NCM_NETWORK_CONNECTION) ? bVal : 0U;
+    (hncm->Req).wIndex = CDC_NCM_CMD_ITF_NBR;
+    (hncm->Req).wLength = 0U;
+
+    for (Idx = 0U; Idx < 8U; Idx++)
+    {
+      (hncm->Req).data[Idx] = 0U;
+    }
+    ReqSize = 8U;
+    break;
+
+  case NCM_CONNECTION_SPEED_CHANGE:
+    (hncm->Req).wValue = 0U;
+    (hncm->Req).wIndex = CDC_NCM_CMD_ITF_NBR;
+    (hncm->Req).wLength = 0x0008U;
+    ReqSize = 16U;
+
+    /* Check pointer to data buffer */
+    if (pData != NULL)
+    {
+      for (Idx = 0U; Idx < 8U; Idx++)
+      {
+        (hncm->Req).data[Idx] = pData[Idx];
+      }
+    }
+    break;
+
+  default:
+    ret = USBD_FAIL;
+    break;
+  }
+
+  /* Transmit notification packet */
+  if (ReqSize != 0U)
+  {
+    (void)USBD_LL_Transmit(pdev, CDC_NCM_CMD_EP, (uint8_t *)&(hncm->Req), ReqSize);
+  }
+
+  return (uint8_t)ret;
+}
+
+void USBD_Update_CDC_NCM_DESC(uint8_t *desc,
+                              uint8_t cmd_itf,
+                              uint8_t com_itf,
+                              uint8_t in_ep,
+                              uint8_t cmd_ep,
+                              uint8_t out_ep,
+                              uint8_t str_idx)
+{
+  desc[11] = cmd_itf;
+  desc[16] = str_idx;
+  desc[19] = cmd_itf;
+  desc[34] = cmd_itf;
+  desc[35] = com_itf;
+  desc[39] = str_idx + 1U;
+  desc[57] = cmd_ep;
+  desc[64] = com_itf;
+  desc[73] = com_itf;
+  desc[82] = out_ep;
+  desc[89] = in_ep;
+
+  CDC_NCM_IN_EP = in_ep;
+  CDC_NCM_OUT_EP = out_ep;
+  CDC_NCM_CMD_EP = cmd_ep;
+  CDC_NCM_CMD_ITF_NBR = cmd_itf;
+  CDC_NCM_COM_ITF_NBR = com_itf;
+  CDC_NCM_STR_DESC_IDX = str_idx;
+  CDC_NCM_MAC_STR_DESC_IDX = str_idx + 1U;
+}
+
+/**
+  * @brief  CDC_NCM_SetAlt
+  *         Switch the data interface, alternate setting 1 opens the bulk pipes
+  * @param  pdev: device instance
+  * @param  alt: alternate setting
+  * @retval None
+  */
+static void CDC_NCM_SetAlt(USBD_HandleTypeDef *pdev, uint8_t alt)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+
+  if (hncm == NULL)
+  {
+    return;
+  }
+
+  if (hncm->AltSetting != 0U)
+  {
+    (void)USBD_LL_CloseEP(pdev, CDC_NCM_IN_EP);
+    pdev->ep_in[CDC_NCM_IN_EP & 0xFU].is_used = 0U;
+
+    (void)USBD_LL_CloseEP(pdev, CDC_NCM_OUT_EP);
+    pdev->ep_out[CDC_NCM_OUT_EP & 0xFU].is_used = 0U;
+  }
+
+  /* Either way the NTB state starts over */
+  hncm->AltSetting = alt;
+  hncm->RxLength[0] = 0U;
+  hncm->RxLength[1] = 0U;
+  hncm->RxArmed = CDC_NCM_RX_STALLED;
+  hncm->RxNext = 0U;
+  hncm->TxBuild = 0U;
+  hncm->TxCount = 0U;
+  hncm->TxState = 0U;
+  hncm->TxSequence = 0U;
+  hncm->NtbInSize = CDC_NCM_NTB_IN_MAX_SIZE;
+
+  if (alt == 0U)
+  {
+    hncm->LinkStatus = 0U;
+    return;
+  }
+
+  (void)USBD_LL_OpenEP(pdev, CDC_NCM_IN_EP, USBD_EP_TYPE_BULK, (uint16_t)hncm->MaxPcktLen);
+  pdev->ep_in[CDC_NCM_IN_EP & 0xFU].is_used = 1U;
+
+  (void)USBD_LL_OpenEP(pdev, CDC_NCM_OUT_EP, USBD_EP_TYPE_BULK, (uint16_t)hncm->MaxPcktLen);
+  pdev->ep_out[CDC_NCM_OUT_EP & 0xFU].is_used = 1U;
+
+  /* Receive whole NTBs */
+  hncm->RxArmed = 0U;
+  (void)USBD_LL_PrepareReceive(pdev, CDC_NCM_OUT_EP, (uint8_t *)hncm->RxNtb[0],
+                               CDC_NCM_NTB_OUT_MAX_SIZE);
+
+  /* The host keeps the carrier off until told otherwise */
+  hncm->LinkStatus = 1U;
+  (void)USBD_CDC_NCM_SendNotification(pdev, NCM_NETWORK_CONNECTION,
+                                      CDC_NCM_NET_CONNECTED, NULL);
+  hncm->NotificationStatus = 1U;
+}
+
+/**
+  * @brief  CDC_NCM_ClassRequest
+  *         Answer the NCM specific IN requests
+  * @param  pdev: device instance
+  * @param  req: usb request
+  * @retval reply length, 0 to let the interface answer
+  */
+static uint16_t CDC_NCM_ClassRequest(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  uint8_t *buf = (uint8_t *)hncm->data;
+
+  switch (req->bRequest)
+  {
+  case CDC_NCM_GET_NTB_PARAMETERS:
+    CDC_NCM_Put16(&buf[0], CDC_NCM_NTB_PARAMETERS_SIZE);
+    CDC_NCM_Put16(&buf[2], CDC_NCM_NTB16_FORMAT);
+    CDC_NCM_Put32(&buf[4], CDC_NCM_NTB_IN_MAX_SIZE);
+    CDC_NCM_Put16(&buf[8], CDC_NCM_NDP_IN_DIVISOR);
+    CDC_NCM_Put16(&buf[10], CDC_NCM_NDP_IN_PAYLOAD_REMAINDER);
+    CDC_NCM_Put16(&buf[12], CDC_NCM_NDP_IN_ALIGNMENT);
+    CDC_NCM_Put16(&buf[14], 0U);
+    CDC_NCM_Put32(&buf[16], CDC_NCM_NTB_OUT_MAX_SIZE);
+    CDC_NCM_Put16(&buf[20], CDC_NCM_NDP_OUT_DIVISOR);
+    CDC_NCM_Put16(&buf[22], CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER);
+    CDC_NCM_Put16(&buf[24], CDC_NCM_NDP_OUT_ALIGNMENT);
+    CDC_NCM_Put16(&buf[26], 0U); /* wNtbOutMaxDatagrams: no limit */
+    return CDC_NCM_NTB_PARAMETERS_SIZE;
+
+  case CDC_NCM_GET_NTB_FORMAT:
+    CDC_NCM_Put16(&buf[0], 0U);
+    return 2U;
+
+  case CDC_NCM_GET_NTB_INPUT_SIZE:
+    CDC_NCM_Put32(&buf[0], hncm->NtbInSize);
+    return 4U;
+
+  default:
+    return 0U;
+  }
+}
+
+/**
+  * @brief  CDC_NCM_ParseNtb
+  *         Walk the NDPs of an OUT NTB and deliver every datagram
+  * @param  pdev: device instance
+  * @param  ntb: transfer block
+  * @param  len: received length
+  * @retval None
+  */
+static void CDC_NCM_ParseNtb(USBD_HandleTypeDef *pdev, uint8_t *ntb, uint32_t len)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  USBD_CDC_NCM_ItfTypeDef *NcmInterface = (USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM;
+  uint32_t block;
+  uint32_t ndp;
+  uint32_t ndp_len;
+  uint32_t entry;
+  uint32_t index;
+  uint32_t dg_len;
+  uint32_t loops;
+
+  if ((len < CDC_NCM_NTH16_SIZE) ||
+      (CDC_NCM_Get32(ntb) != CDC_NCM_NTH16_SIGNATURE) ||
+      (SWAPBYTE(&ntb[4]) != CDC_NCM_NTH16_SIZE))
+  {
+    hncm->RxErrors++;
+    return;
+  }
+
+  /* wBlockLength may be shorter than the transfer, never longer */
+  block = SWAPBYTE(&ntb[8]);
+  if ((block != 0U) && (block <= len))
+  {
+    len = block;
+  }
+  else if (block > len)
+  {
+    hncm->RxErrors++;
+    return;
+  }
+
+  ndp = SWAPBYTE(&ntb[10]);
+
+  for (loops = 0U; (ndp != 0U) && (loops < CDC_NCM_RX_MAX_NDP); loops++)
+  {
+    if (((ndp & 3U) != 0U) || ((ndp + 16U) > len) ||
+        ((CDC_NCM_Get32(&ntb[ndp]) != CDC_NCM_NDP16_NOCRC_SIGNATURE) &&
+         (CDC_NCM_Get32(&ntb[ndp]) != CDC_NCM_NDP16_CRC_SIGNATURE)))
+    {
+      hncm->RxErrors++;
+      return;
+    }
+
+    ndp_len = SWAPBYTE(&ntb[ndp + 4U]);
+    if ((ndp_len < 16U) || ((ndp + ndp_len) > len))
+    {
+      hncm->RxErrors++;
+      return;
+    }
+
+    for (entry = ndp + CDC_NCM_NDP16_HEADER_SIZE; (entry + 4U) <= (ndp + ndp_len); entry += 4U)
+    {
+      index = SWAPBYTE(&ntb[entry]);
+      dg_len = SWAPBYTE(&ntb[entry + 2U]);
+
+      if ((index == 0U) || (dg_len == 0U))
+      {
+        break;
+      }
+
+      if (((index + dg_len) > len) || (dg_len > CDC_NCM_ETH_MAX_SEGSZE))
+      {
+        hncm->RxErrors++;
+        continue;
+      }
+
+      hncm->RxDatagrams++;
+      (void)NcmInterface->Receive(&ntb[index], &dg_len);
+    }
+
+    ndp = SWAPBYTE(&ntb[ndp + 6U]);
+  }
+}
+
+/**
+  * @brief  CDC_NCM_SendNtb
+  *         Close the collecting NTB and start its IN transfer
+  * @note   Caller makes sure the IN endpoint is idle and masks interrupts
+  *         when not running from the USB interrupt.
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void CDC_NCM_SendNtb(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hncm = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassData_CDC_NCM;
+  uint8_t *ntb = (uint8_t *)hncm->TxNtb[hncm->TxBuild];
+  uint32_t ndp;
+  uint32_t ndp_len;
+  uint32_t i;
+
+  /* NDP16 behind the last datagram, its entry list ends with a null entry */
+  ndp = CDC_NCM_ALIGN(hncm->TxOffset, CDC_NCM_NDP_IN_ALIGNMENT);
+  ndp_len = CDC_NCM_NDP16_HEADER_SIZE + ((hncm->TxCount + 1U) * 4U);
+
+  CDC_NCM_Put32(&ntb[ndp], CDC_NCM_NDP16_NOCRC_SIGNATURE);
+  CDC_NCM_Put16(&ntb[ndp + 4U], (uint16_t)ndp_len);
+  CDC_NCM_Put16(&ntb[ndp + 6U], 0U);
+
+  for (i = 0U; i < hncm->TxCount; i++)
+  {
+    CDC_NCM_Put16(&ntb[ndp + 8U + (i * 4U)], hncm->TxNdp[i][0]);
+    CDC_NCM_Put16(&ntb[ndp + 10U + (i * 4U)], hncm->TxNdp[i][1]);
+  }
+  CDC_NCM_Put32(&ntb[ndp + 8U + (i * 4U)], 0U);
+
+  hncm->TxLength = ndp + ndp_len;
+
+  CDC_NCM_Put32(&ntb[0], CDC_NCM_NTH16_SIGNATURE);
+  CDC_NCM_Put16(&ntb[4], CDC_NCM_NTH16_SIZE);
+  CDC_NCM_Put16(&ntb[6], hncm->TxSequence);
+  CDC_NCM_Put16(&ntb[8], (uint16_t)hncm->TxLength);
+  CDC_NCM_Put16(&ntb[10], (uint16_t)ndp);
+
+  hncm->TxSequence++;
+  hncm->TxNtbs++;
+  hncm->TxDatagrams += hncm->TxCount;
+  hncm->TxCount = 0U;
+  hncm->TxBuild ^= 1U;
+
+  /* Tx Transfer in progress */
+  hncm->TxState = 1U;
+
+  /* Update the packet total length */
+  pdev->ep_in[CDC_NCM_IN_EP & 0xFU].total_length = hncm->TxLength;
+
+  (void)USBD_LL_Transmit(pdev, CDC_NCM_IN_EP, ntb, hncm->TxLength);
+}
+
+static uint32_t CDC_NCM_Get32(uint8_t *addr)
+{
+  return (uint32_t)SWAPBYTE(addr) | ((uint32_t)SWAPBYTE(addr + 2U) << 16);
+}
+
+static void CDC_NCM_Put16(uint8_t *addr, uint16_t val)
+{
+  addr[0] = LOBYTE(val);
+  addr[1] = HIBYTE(val);
+}
+
+static void CDC_NCM_Put32(uint8_t *addr, uint32_t val)
+{
+  CDC_NCM_Put16(addr, (uint16_t)(val & 0xFFFFU));
+  CDC_NCM_Put16(addr + 2U, (uint16_t)(val >> 16));
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -52,6 +52,23 @@ extern "C"
 #define CDC_RNDIS_FS_BINTERVAL                            0x10U
 #endif /* CDC_RNDIS_FS_BINTERVAL */
 
+/* Largest bulk transfer in either direction, each one carries one or more
+   concatenated PACKET_MSGs. Keep it a multiple of the HS packet size. */
+#ifndef CDC_RNDIS_MAX_TRANSFER_SIZE
+#define CDC_RNDIS_MAX_TRANSFER_SIZE                       8192U
+#endif /* CDC_RNDIS_MAX_TRANSFER_SIZE */
+
+/* PACKET_MSGs accepted from the host in one transfer, and packed into one
+   transfer to the host at most */
+#ifndef CDC_RNDIS_MAX_PACKETS_PER_TRANSFER
+#define CDC_RNDIS_MAX_PACKETS_PER_TRANSFER                8U
+#endif /* CDC_RNDIS_MAX_PACKETS_PER_TRANSFER */
+
+/* Milliseconds a partly filled IN transfer may wait for more frames while the
+   bus is idle, 0 sends every frame as soon as the IN endpoint is free */
+#ifndef CDC_RNDIS_TX_FLUSH_TIMEOUT
+#define CDC_RNDIS_TX_FLUSH_TIMEOUT                        1U
+#endif /* CDC_RNDIS_TX_FLUSH_TIMEOUT */
 
 /* CDC_RNDIS Endpoints parameters: you can fine tune these values
    depending on the needed baudrates and performance. */
@@ -66,6 +83,11 @@ extern "C"
 #define CDC_RNDIS_DATA_FS_IN_PACKET_SIZE                  CDC_RNDIS_DATA_FS_MAX_PACKET_SIZE
 #define CDC_RNDIS_DATA_FS_OUT_PACKET_SIZE                 CDC_RNDIS_DATA_FS_MAX_PACKET_SIZE
 
+/* Link speed reported to the host in bit/s: the bulk payload a bus can carry,
+   13 packets per HS microframe and 19 per FS frame at most */
+#define CDC_RNDIS_HS_LINK_SPEED                           (13U * CDC_RNDIS_DATA_HS_MAX_PACKET_SIZE * 8000U * 8U)
+#define CDC_RNDIS_FS_LINK_SPEED                           (19U * CDC_RNDIS_DATA_FS_MAX_PACKET_SIZE * 1000U * 8U)
+
 /*---------------------------------------------------------------------*/
 /*  CDC_RNDIS definitions                                                    */
 /*---------------------------------------------------------------------*/
@@ -231,6 +253,17 @@ extern "C"
     uint8_t data[8];
   } USBD_CDC_RNDIS_NotifTypeDef;
 
+  /* Frame counters behind the OID_GEN statistics, cleared when the
+     configuration is set */
+  typedef struct
+  {
+    uint32_t XmitOk;           /* Frames the host took off the IN endpoint */
+    uint32_t RcvOk;            /* Frames the application accepted */
+    uint32_t XmitError;        /* Frames refused by USBD_CDC_RNDIS_TransmitFrame() */
+    uint32_t RcvError;         /* Malformed or surplus PACKET_MSGs */
+    uint32_t RcvNoBuffer;      /* Frames the application had no buffer for */
+  } USBD_CDC_RNDIS_StatsTypeDef;
+
   typedef struct
   {
     uint32_t data[CDC_RNDIS_MAX_DATA_SZE / 4U]; /* Force 32-bit alignment */
@@ -242,6 +275,7 @@ extern "C"
     uint8_t *TxBuffer;
     uint32_t RxLength;
     uint32_t TxLength;
+    uint32_t RxSize;     /* Bytes RxBuffer holds, an OUT transfer is armed for no more */
 
     USBD_CDC_RNDIS_NotifTypeDef Req;
     USBD_CDC_RNDIS_StateTypeDef State;
@@ -253,6 +287,20 @@ extern "C"
     __IO uint32_t LinkStatus;
     __IO uint32_t NotificationStatus;
     __IO uint32_t PacketFilter;
+    __IO uint32_t NotifBusy;       /* 1 while Req is on the CMD endpoint */
+    __IO uint32_t NotifPending;    /* RESPONSE_AVAILABLE raised while busy */
+
+    uint32_t TxAggr[2][CDC_RNDIS_MAX_TRANSFER_SIZE / 4U]; /* Concatenated PACKET_MSGs to the host */
+    uint32_t TxAggrBuild;      /* Buffer collecting frames */
+    uint32_t TxAggrCount;      /* Frames in the collecting buffer */
+    uint32_t TxAggrOffset;     /* First free byte in the collecting buffer */
+    uint32_t TxAggrTick;       /* HAL tick of the first collected frame */
+    uint32_t TxAggrLength;     /* Length of the aggregate in flight, 0 for TransmitPacket */
+    uint32_t TxMaxTransfer;    /* Transfer budget, bounded by the host INIT_MSG */
+    uint32_t TxFrames;         /* Frames in the IN transfer in flight */
+    uint32_t LinkSpeed;        /* Bit/s of the negotiated bus speed */
+
+    USBD_CDC_RNDIS_StatsTypeDef Stats;
   } USBD_CDC_RNDIS_HandleTypeDef;
 
   typedef enum
@@ -488,9 +536,13 @@ extern "C"
   /** @defgroup USB_CORE_Exported_Functions
   * @{
   */
-  uint8_t USBD_CDC_RNDIS_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
+  uint8_t USBD_CDC_RNDIS_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length);
   uint8_t USBD_CDC_RNDIS_ReceivePacket(USBD_HandleTypeDef *pdev);
   uint8_t USBD_CDC_RNDIS_TransmitPacket(USBD_HandleTypeDef *pdev);
+  uint8_t USBD_CDC_RNDIS_TransmitFrame(USBD_HandleTypeDef *pdev, uint8_t *pbuf,
+                                       uint16_t length);
+  uint8_t USBD_CDC_RNDIS_Flush(USBD_HandleTypeDef *pdev);
+  uint8_t USBD_CDC_RNDIS_Process(USBD_HandleTypeDef *pdev);
 
   uint8_t USBD_CDC_RNDIS_RegisterInterface(USBD_HandleTypeDef *pdev,
                                            USBD_CDC_RNDIS_ItfTypeDef *fops);
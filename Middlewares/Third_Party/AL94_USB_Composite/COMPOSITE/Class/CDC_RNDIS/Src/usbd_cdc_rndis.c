@@ -97,6 +97,9 @@ uint8_t CDC_RNDIS_STR_DESC_IDX = _CDC_RNDIS_STR_DESC_IDX;
   * @{
   */
 
+/* PACKET_MSGs to the host start on 4 byte boundaries (PacketAlignmentFactor 2) */
+#define CDC_RNDIS_ALIGN(x)                                (((x) + 3U) & ~3U)
+
 /**
   * @}
   */
@@ -135,6 +138,7 @@ static uint8_t USBD_CDC_RNDIS_ProcessSetMsg(USBD_HandleTypeDef *pdev, USBD_CDC_R
 static uint8_t USBD_CDC_RNDIS_ProcessResetMsg(USBD_HandleTypeDef *pdev, USBD_CDC_RNDIS_ResetMsgTypeDef *Msg);
 static uint8_t USBD_CDC_RNDIS_ProcessPacketMsg(USBD_HandleTypeDef *pdev, USBD_CDC_RNDIS_PacketMsgTypeDef *Msg);
 static uint8_t USBD_CDC_RNDIS_ProcessUnsupportedMsg(USBD_HandleTypeDef *pdev, USBD_CDC_RNDIS_CtrlMsgTypeDef *Msg);
+static void CDC_RNDIS_SendAggregate(USBD_HandleTypeDef *pdev);
 
 /* USB Standard Device Descriptor */
 __ALIGN_BEGIN static uint8_t USBD_CDC_RNDIS_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
@@ -530,6 +534,11 @@ static const uint32_t CDC_RNDIS_SupportedOIDs[] =
         OID_GEN_MAXIMUM_TOTAL_SIZE,
         OID_GEN_MEDIA_CONNECT_STATUS,
         OID_GEN_MAXIMUM_SEND_PACKETS,
+        OID_GEN_XMIT_OK,
+        OID_GEN_RCV_OK,
+        OID_GEN_XMIT_ERROR,
+        OID_GEN_RCV_ERROR,
+        OID_GEN_RCV_NO_BUFFER,
         OID_802_3_PERMANENT_ADDRESS,
         OID_802_3_CURRENT_ADDRESS,
         OID_802_3_MULTICAST_LIST,
@@ -621,11 +630,20 @@ static uint8_t USBD_CDC_RNDIS_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   hcdc->TxLength = 0U;
   hcdc->LinkStatus = 0U;
   hcdc->NotificationStatus = 0U;
+  hcdc->NotifBusy = 0U;
+  hcdc->NotifPending = 0U;
   hcdc->MaxPcktLen = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_RNDIS_DATA_HS_MAX_PACKET_SIZE : CDC_RNDIS_DATA_FS_MAX_PACKET_SIZE;
-
-  /* Prepare Out endpoint to receive next packet */
+  hcdc->TxAggrBuild = 0U;
+  hcdc->TxAggrCount = 0U;
+  hcdc->TxAggrLength = 0U;
+  hcdc->TxMaxTransfer = CDC_RNDIS_MAX_TRANSFER_SIZE;
+  hcdc->TxFrames = 0U;
+  hcdc->LinkSpeed = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_RNDIS_HS_LINK_SPEED : CDC_RNDIS_FS_LINK_SPEED;
+  (void)USBD_memset(&hcdc->Stats, 0, sizeof(hcdc->Stats));
+
+  /* Prepare Out endpoint to receive a whole transfer */
   (void)USBD_LL_PrepareReceive(pdev, CDC_RNDIS_OUT_EP,
-                               hcdc->RxBuffer, hcdc->MaxPcktLen);
+                               hcdc->RxBuffer, MIN(hcdc->RxSize, CDC_RNDIS_MAX_TRANSFER_SIZE));
 
   return (uint8_t)USBD_OK;
 }
@@ -736,7 +754,9 @@ static uint8_t USBD_CDC_RNDIS_Setup(USBD_HandleTypeDef *pdev,
         hcdc->CmdOpCode = req->bRequest;
         hcdc->CmdLength = (uint8_t)MIN(CDC_RNDIS_CMD_PACKET_SIZE, req->wLength);
 
-        (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hcdc->data, hcdc->CmdLength);
+        /* Receive the whole message, INITIALIZE and SET are longer than one packet */
+        (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hcdc->data,
+                                MIN(CDC_RNDIS_MAX_DATA_SZE, req->wLength));
       }
     }
     /* No Data control request: there is no such request for CDC_RNDIS protocol,
@@ -833,16 +853,49 @@ static uint8_t USBD_CDC_RNDIS_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
     }
     else
     {
+      uint32_t AggrLength = hcdc->TxAggrLength;
+
+      hcdc->Stats.XmitOk += hcdc->TxFrames;
+      hcdc->TxFrames = 0U;
       hcdc->TxState = 0U;
+      hcdc->TxAggrLength = 0U;
 
       if (((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->TransmitCplt != NULL)
       {
-        ((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
+        if (AggrLength != 0U)
+        {
+          ((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->TransmitCplt((uint8_t *)hcdc->TxAggr[hcdc->TxAggrBuild ^ 1U],
+                                                                                &AggrLength, epnum);
+        }
+        else
+        {
+          ((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->TransmitCplt(hcdc->TxBuffer, &hcdc->TxLength, epnum);
+        }
+      }
+
+      /* Frames queued while this transfer was on the bus go out right away */
+      if ((hcdc->TxState == 0U) && (hcdc->TxAggrCount != 0U))
+      {
+        CDC_RNDIS_SendAggregate(pdev);
       }
     }
   }
   else if (epnum == (CDC_RNDIS_CMD_EP & 0x7FU))
   {
+    hcdc->NotifBusy = 0U;
+
+    /* Responses completed while the last notification was in flight; none
+       is needed if the host already fetched them */
+    if (hcdc->NotifPending != 0U)
+    {
+      hcdc->NotifPending = 0U;
+
+      if (hcdc->ResponseRdy != 0U)
+      {
+        (void)USBD_CDC_RNDIS_SendNotification(pdev, RNDIS_RESPONSE_AVAILABLE, 0U, NULL);
+      }
+    }
+
     if (hcdc->NotificationStatus != 0U)
     {
       (void)USBD_CDC_RNDIS_SendNotification(pdev, RNDIS_CONNECTION_SPEED_CHANGE,
@@ -869,7 +922,6 @@ static uint8_t USBD_CDC_RNDIS_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t USBD_CDC_RNDIS_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_CDC_RNDIS_HandleTypeDef *hcdc;
-  uint32_t CurrPcktLen;
 
   if (pdev->pClassData_CDC_RNDIS == NULL)
   {
@@ -880,28 +932,16 @@ static uint8_t USBD_CDC_RNDIS_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 
   if (epnum == CDC_RNDIS_OUT_EP)
   {
-    /* Get the received data length */
-    CurrPcktLen = USBD_LL_GetRxDataSize(pdev, epnum);
+    /* The transfer ends on a short packet or when the buffer is full, it
+       holds one or more concatenated PACKET_MSGs */
+    hcdc->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
 
-    /* Increment the frame length */
-    hcdc->RxLength += CurrPcktLen;
-
-    /* If the buffer size is less than max packet size: it is the last packet in current frame */
-    if ((CurrPcktLen < hcdc->MaxPcktLen) ||
-        (hcdc->RxLength >= (CDC_RNDIS_ETH_MAX_SEGSZE + sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef))))
-    {
-      /* USB data will be immediately processed, this allow next USB traffic being
-      NAKed till the end of the application Xfer */
-
-      /* Call data packet message parsing and processing function */
-      (void)USBD_CDC_RNDIS_ProcessPacketMsg(pdev, (USBD_CDC_RNDIS_PacketMsgTypeDef *)(void *)hcdc->RxBuffer);
-    }
-    else
+    /* USB data will be immediately processed, this allow next USB traffic being
+    NAKed till the application calls USBD_CDC_RNDIS_ReceivePacket() */
+    if (USBD_CDC_RNDIS_ProcessPacketMsg(pdev, (USBD_CDC_RNDIS_PacketMsgTypeDef *)(void *)hcdc->RxBuffer) != (uint8_t)USBD_OK)
     {
-      /* Prepare Out endpoint to receive next packet in current/new frame */
-      (void)USBD_LL_PrepareReceive(pdev, CDC_RNDIS_OUT_EP,
-                                   (uint8_t *)(hcdc->RxBuffer + hcdc->RxLength),
-                                   hcdc->MaxPcktLen);
+      /* Nothing was handed to the application (ZLP, malformed transfer), receive again */
+      (void)USBD_CDC_RNDIS_ReceivePacket(pdev);
     }
   }
   else
@@ -1077,9 +1117,10 @@ uint8_t USBD_CDC_RNDIS_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uin
   * @brief  USBD_CDC_RNDIS_SetRxBuffer
   * @param  pdev: device instance
   * @param  pbuff: Rx Buffer
+  * @param  length: Rx Buffer size, at most CDC_RNDIS_MAX_TRANSFER_SIZE is used
   * @retval status
   */
-uint8_t USBD_CDC_RNDIS_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
+uint8_t USBD_CDC_RNDIS_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff, uint32_t length)
 {
   USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
 
@@ -1089,6 +1130,7 @@ uint8_t USBD_CDC_RNDIS_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
   }
 
   hcdc->RxBuffer = pbuff;
+  hcdc->RxSize = length;
 
   return (uint8_t)USBD_OK;
 }
@@ -1117,6 +1159,7 @@ uint8_t USBD_CDC_RNDIS_TransmitPacket(USBD_HandleTypeDef *pdev)
   {
     /* Tx Transfer in progress */
     hcdc->TxState = 1U;
+    hcdc->TxFrames = 1U;
 
     /* Format the packet information */
     PacketMsg->MsgType = CDC_RNDIS_PACKET_MSG_ID;
@@ -1160,16 +1203,179 @@ uint8_t USBD_CDC_RNDIS_ReceivePacket(USBD_HandleTypeDef *pdev)
 
   hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
 
-  /* Prepare Out endpoint to receive next packet */
+  /* Prepare Out endpoint to receive next transfer */
   (void)USBD_LL_PrepareReceive(pdev, CDC_RNDIS_OUT_EP,
-                               hcdc->RxBuffer, hcdc->MaxPcktLen);
+                               hcdc->RxBuffer, MIN(hcdc->RxSize, CDC_RNDIS_MAX_TRANSFER_SIZE));
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_RNDIS_TransmitFrame
+  *         Wrap an Ethernet frame in a PACKET_MSG and queue it for the IN endpoint.
+  *         Frames are concatenated into one transfer until the transfer budget
+  *         or the packet count is reached, USBD_CDC_RNDIS_Process() sends a
+  *         partly filled transfer once CDC_RNDIS_TX_FLUSH_TIMEOUT expired.
+  * @param  pdev: device instance
+  * @param  pbuf: Ethernet frame, copied before returning
+  * @param  length: frame length
+  * @retval status, USBD_BUSY when both transfer buffers are in use
+  */
+uint8_t USBD_CDC_RNDIS_TransmitFrame(USBD_HandleTypeDef *pdev, uint8_t *pbuf,
+                                     uint16_t length)
+{
+  USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
+  USBD_CDC_RNDIS_PacketMsgTypeDef *PacketMsg;
+  USBD_StatusTypeDef ret = USBD_OK;
+  uint32_t MsgLength;
+  uint32_t primask;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if ((length == 0U) || (length > CDC_RNDIS_ETH_MAX_SEGSZE))
+  {
+    hcdc->Stats.XmitError++;
+    return (uint8_t)USBD_FAIL;
+  }
+
+  MsgLength = CDC_RNDIS_ALIGN(sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef) + length);
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  /* A single message always fits, whatever budget the host asked for */
+  if ((hcdc->TxAggrCount != 0U) &&
+      ((hcdc->TxAggrCount == CDC_RNDIS_MAX_PACKETS_PER_TRANSFER) ||
+       ((hcdc->TxAggrOffset + MsgLength) > hcdc->TxMaxTransfer)))
+  {
+    if (hcdc->TxState != 0U)
+    {
+      ret = USBD_BUSY;
+    }
+    else
+    {
+      CDC_RNDIS_SendAggregate(pdev);
+    }
+  }
+
+  if (ret == USBD_OK)
+  {
+    if (hcdc->TxAggrCount == 0U)
+    {
+      hcdc->TxAggrOffset = 0U;
+      hcdc->TxAggrTick = HAL_GetTick();
+    }
+
+    PacketMsg = (USBD_CDC_RNDIS_PacketMsgTypeDef *)(void *)((uint8_t *)hcdc->TxAggr[hcdc->TxAggrBuild] +
+                                                            hcdc->TxAggrOffset);
+
+    /* Format the packet information, the padding is part of the message */
+    PacketMsg->MsgType = CDC_RNDIS_PACKET_MSG_ID;
+    PacketMsg->MsgLength = MsgLength;
+    PacketMsg->DataOffset = sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef) - CDC_RNDIS_PCKTMSG_DATAOFFSET_OFFSET;
+    PacketMsg->DataLength = length;
+    PacketMsg->OOBDataOffset = 0U;
+    PacketMsg->OOBDataLength = 0U;
+    PacketMsg->NumOOBDataElements = 0U;
+    PacketMsg->PerPacketInfoOffset = 0U;
+    PacketMsg->PerPacketInfoLength = 0U;
+    PacketMsg->VcHandle = 0U;
+    PacketMsg->Reserved = 0U;
+
+    (void)USBD_memcpy((uint8_t *)PacketMsg + sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef), pbuf, length);
+
+    hcdc->TxAggrOffset += MsgLength;
+    hcdc->TxAggrCount++;
+
+#if (CDC_RNDIS_TX_FLUSH_TIMEOUT == 0U)
+    if (hcdc->TxState == 0U)
+    {
+      CDC_RNDIS_SendAggregate(pdev);
+    }
+#endif
+  }
+
+  __set_PRIMASK(primask);
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_RNDIS_Flush
+  *         Send the frames collected so far without waiting for the timeout
+  * @param  pdev: device instance
+  * @retval status, USBD_BUSY when they go out after the transfer in flight
+  */
+uint8_t USBD_CDC_RNDIS_Flush(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
+  USBD_StatusTypeDef ret = USBD_OK;
+  uint32_t primask;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hcdc->TxAggrCount != 0U)
+  {
+    if (hcdc->TxState == 0U)
+    {
+      CDC_RNDIS_SendAggregate(pdev);
+    }
+    else
+    {
+      /* Goes out from DataIn when the transfer in flight completes */
+      ret = USBD_BUSY;
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_RNDIS_Process
+  *         Flush the IN frames once the aggregation timeout expired and run
+  *         the interface background work, to be polled from the main loop
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_CDC_RNDIS_Process(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if ((hcdc->TxAggrCount != 0U) && (hcdc->TxState == 0U) &&
+      ((HAL_GetTick() - hcdc->TxAggrTick) >= CDC_RNDIS_TX_FLUSH_TIMEOUT))
+  {
+    (void)USBD_CDC_RNDIS_Flush(pdev);
+  }
+
+  if (((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->Process != NULL)
+  {
+    (void)((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->Process(pdev);
+  }
 
   return (uint8_t)USBD_OK;
 }
 
 /**
   * @brief  USBD_CDC_RNDIS_SendNotification
-  *         Transmit Notification packet on CMD IN interrupt endpoint
+  *         Transmit Notification packet on CMD IN interrupt endpoint, a
+  *         notification raised while another one is in flight is merged
+  *         into a single one sent when the endpoint completes
   * @param  pdev: device instance
   *         Notif: value of the notification type (from CDC_RNDIS_Notification_TypeDef enumeration list)
   *         bVal: value of the notification switch (ie. 0x00 or 0x01 for Network Connection notification)
@@ -1181,6 +1387,7 @@ uint8_t USBD_CDC_RNDIS_SendNotification(USBD_HandleTypeDef *pdev,
                                         uint16_t bVal, uint8_t *pData)
 {
   uint32_t Idx;
+  uint32_t primask;
   uint16_t ReqSize = 0U;
   USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
   USBD_StatusTypeDef ret = USBD_OK;
@@ -1193,6 +1400,17 @@ uint8_t USBD_CDC_RNDIS_SendNotification(USBD_HandleTypeDef *pdev,
     return (uint8_t)USBD_FAIL;
   }
 
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if ((hcdc->NotifBusy != 0U) && (Notif == RNDIS_RESPONSE_AVAILABLE))
+  {
+    hcdc->NotifPending = 1U;
+    __set_PRIMASK(primask);
+
+    return (uint8_t)ret;
+  }
+
   /* Initialize the request fields */
   (hcdc->Req).bmRequest = CDC_RNDIS_BMREQUEST_TYPE_RNDIS;
   (hcdc->Req).bRequest = (uint8_t)Notif;
@@ -1220,9 +1438,12 @@ uint8_t USBD_CDC_RNDIS_SendNotification(USBD_HandleTypeDef *pdev,
   /* Transmit notification packet */
   if (ReqSize != 0U)
   {
+    hcdc->NotifBusy = 1U;
     (void)USBD_LL_Transmit(pdev, CDC_RNDIS_CMD_EP, (uint8_t *)&(hcdc->Req), ReqSize);
   }
 
+  __set_PRIMASK(primask);
+
   return (uint8_t)ret;
 }
 
@@ -1303,6 +1524,9 @@ static uint8_t USBD_CDC_RNDIS_ProcessInitMsg(USBD_HandleTypeDef *pdev,
   /* Store the Message Request ID */
   uint32_t ReqId = InitMessage->ReqId;
 
+  /* Largest transfer the host accepts, the response overwrites it */
+  uint32_t HostMaxTransfer = InitMessage->MaxTransferSize;
+
   if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
@@ -1327,12 +1551,16 @@ static uint8_t USBD_CDC_RNDIS_ProcessInitMsg(USBD_HandleTypeDef *pdev,
   InitResponse->MinorVersion = CDC_RNDIS_VERSION_MINOR;
   InitResponse->DeviceFlags = CDC_RNDIS_DF_CONNECTIONLESS;
   InitResponse->Medium = CDC_RNDIS_MEDIUM_802_3;
-  InitResponse->MaxPacketsPerTransfer = 1U;
-  InitResponse->MaxTransferSize = (sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef) + CDC_RNDIS_ETH_FRAME_SIZE_MAX);
-  InitResponse->PacketAlignmentFactor = 2U; /* Not needed as single packet by transfer set */
+  InitResponse->MaxPacketsPerTransfer = CDC_RNDIS_MAX_PACKETS_PER_TRANSFER;
+  InitResponse->MaxTransferSize = CDC_RNDIS_MAX_TRANSFER_SIZE;
+  InitResponse->PacketAlignmentFactor = 2U; /* Concatenated messages start on 4 byte boundaries */
   InitResponse->AFListOffset = 0U;          /* Reserved for connection-oriented devices. Set value to zero. */
   InitResponse->AFListSize = 0U;            /* Reserved for connection-oriented devices. Set value to zero. */
 
+  /* Frames to the host are packed up to its own limit */
+  hcdc->TxMaxTransfer = ((HostMaxTransfer != 0U) && (HostMaxTransfer < CDC_RNDIS_MAX_TRANSFER_SIZE)) ?
+                        HostMaxTransfer : CDC_RNDIS_MAX_TRANSFER_SIZE;
+
   /* Set CDC_RNDIS state to INITIALIZED */
   hcdc->State = CDC_RNDIS_STATE_INITIALIZED;
 
@@ -1500,13 +1728,48 @@ static uint8_t USBD_CDC_RNDIS_ProcessQueryMsg(USBD_HandleTypeDef *pdev,
 
   case OID_GEN_MAXIMUM_SEND_PACKETS:
     QueryResponse->InfoBufLength = sizeof(uint32_t);
-    QueryResponse->InfoBuf[0] = 1U;
+    QueryResponse->InfoBuf[0] = CDC_RNDIS_MAX_PACKETS_PER_TRANSFER;
     QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
     break;
 
   case OID_GEN_LINK_SPEED:
     QueryResponse->InfoBufLength = sizeof(uint32_t);
+    /* In units of 100 bit/s */
+#if (USBD_CDC_RNDIS_LINK_SPEED != 0U)
     QueryResponse->InfoBuf[0] = USBD_CDC_RNDIS_LINK_SPEED;
+#else
+    QueryResponse->InfoBuf[0] = hcdc->LinkSpeed / 100U;
+#endif /* USBD_CDC_RNDIS_LINK_SPEED */
+    QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
+    break;
+
+  case OID_GEN_XMIT_OK:
+    QueryResponse->InfoBufLength = sizeof(uint32_t);
+    QueryResponse->InfoBuf[0] = hcdc->Stats.XmitOk;
+    QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
+    break;
+
+  case OID_GEN_RCV_OK:
+    QueryResponse->InfoBufLength = sizeof(uint32_t);
+    QueryResponse->InfoBuf[0] = hcdc->Stats.RcvOk;
+    QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
+    break;
+
+  case OID_GEN_XMIT_ERROR:
+    QueryResponse->InfoBufLength = sizeof(uint32_t);
+    QueryResponse->InfoBuf[0] = hcdc->Stats.XmitError;
+    QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
+    break;
+
+  case OID_GEN_RCV_ERROR:
+    QueryResponse->InfoBufLength = sizeof(uint32_t);
+    QueryResponse->InfoBuf[0] = hcdc->Stats.RcvError;
+    QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
+    break;
+
+  case OID_GEN_RCV_NO_BUFFER:
+    QueryResponse->InfoBufLength = sizeof(uint32_t);
+    QueryResponse->InfoBuf[0] = hcdc->Stats.RcvNoBuffer;
     QueryResponse->Status = CDC_RNDIS_STATUS_SUCCESS;
     break;
 
@@ -1686,37 +1949,61 @@ static uint8_t USBD_CDC_RNDIS_ProcessResetMsg(USBD_HandleTypeDef *pdev,
 static uint8_t USBD_CDC_RNDIS_ProcessPacketMsg(USBD_HandleTypeDef *pdev,
                                                USBD_CDC_RNDIS_PacketMsgTypeDef *Msg)
 {
-  uint32_t tmp1, tmp2;
+  USBD_CDC_RNDIS_PacketMsgTypeDef *PacketMsg;
+  uint32_t Offset = 0U;
+  uint32_t Count = 0U;
+  uint32_t FrameLen;
 
   /* Get the CDC_RNDIS handle pointer */
   USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
 
-  /* Get and format the Msg input */
-  USBD_CDC_RNDIS_PacketMsgTypeDef *PacketMsg = (USBD_CDC_RNDIS_PacketMsgTypeDef *)Msg;
-
   if (hcdc == NULL)
   {
     return (uint8_t)USBD_FAIL;
   }
 
-  /* Check correctness of the message */
-  if ((PacketMsg->MsgType != CDC_RNDIS_PACKET_MSG_ID))
+  /* Walk the messages concatenated in the transfer, a trailing short packet
+     filler or anything malformed ends the walk */
+  while (((Offset + sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef)) <= hcdc->RxLength) &&
+         (Count < CDC_RNDIS_MAX_PACKETS_PER_TRANSFER))
   {
-    return (uint8_t)USBD_FAIL;
-  }
+    PacketMsg = (USBD_CDC_RNDIS_PacketMsgTypeDef *)(void *)((uint8_t *)Msg + Offset);
+
+    /* Check correctness of the message */
+    if ((PacketMsg->MsgType != CDC_RNDIS_PACKET_MSG_ID) ||
+        (PacketMsg->MsgLength < sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef)) ||
+        (PacketMsg->MsgLength > (hcdc->RxLength - Offset)) ||
+        (PacketMsg->DataOffset > (PacketMsg->MsgLength - CDC_RNDIS_PCKTMSG_DATAOFFSET_OFFSET)) ||
+        (PacketMsg->DataLength > (PacketMsg->MsgLength - PacketMsg->DataOffset - CDC_RNDIS_PCKTMSG_DATAOFFSET_OFFSET)))
+    {
+      break;
+    }
 
-  /* Point to the payload and update the message length */
+    /* Process data by application, the payload stays valid until the next
+       USBD_CDC_RNDIS_ReceivePacket() */
+    FrameLen = PacketMsg->DataLength;
+    if (((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->Receive((uint8_t *)PacketMsg + PacketMsg->DataOffset +
+                                                                          CDC_RNDIS_PCKTMSG_DATAOFFSET_OFFSET,
+                                                                          &FrameLen) == 0)
+    {
+      hcdc->Stats.RcvOk++;
+    }
+    else
+    {
+      hcdc->Stats.RcvNoBuffer++;
+    }
 
-  /* Use temporary storage variables to comply with MISRA-C 2012 rule of (+) operand allowed types */
-  tmp1 = (uint32_t)PacketMsg;
-  tmp2 = (uint32_t)(PacketMsg->DataOffset);
-  hcdc->RxBuffer = (uint8_t *)(tmp1 + tmp2 + CDC_RNDIS_PCKTMSG_DATAOFFSET_OFFSET);
-  hcdc->RxLength = PacketMsg->DataLength;
+    Offset += PacketMsg->MsgLength;
+    Count++;
+  }
 
-  /* Process data by application */
-  ((USBD_CDC_RNDIS_ItfTypeDef *)pdev->pUserData_CDC_RNDIS)->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+  /* Whatever is left of the transfer is lost */
+  if ((Offset + sizeof(USBD_CDC_RNDIS_PacketMsgTypeDef)) <= hcdc->RxLength)
+  {
+    hcdc->Stats.RcvError++;
+  }
 
-  return (uint8_t)USBD_OK;
+  return (Count != 0U) ? (uint8_t)USBD_OK : (uint8_t)USBD_FAIL;
 }
 
 /**
@@ -1758,6 +2045,32 @@ static uint8_t USBD_CDC_RNDIS_ProcessUnsupportedMsg(USBD_HandleTypeDef *pdev,
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  CDC_RNDIS_SendAggregate
+  *         Start the IN transfer of the collected PACKET_MSGs and switch
+  *         collecting to the other buffer, called with interrupts masked
+  * @param  pdev: USB Device Handle pointer
+  * @retval None
+  */
+static void CDC_RNDIS_SendAggregate(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_RNDIS_HandleTypeDef *hcdc = (USBD_CDC_RNDIS_HandleTypeDef *)pdev->pClassData_CDC_RNDIS;
+  uint8_t *pbuf = (uint8_t *)hcdc->TxAggr[hcdc->TxAggrBuild];
+
+  hcdc->TxAggrLength = hcdc->TxAggrOffset;
+  hcdc->TxFrames = hcdc->TxAggrCount;
+  hcdc->TxAggrCount = 0U;
+  hcdc->TxAggrBuild ^= 1U;
+
+  /* Tx Transfer in progress */
+  hcdc->TxState = 1U;
+
+  /* Update the packet total length */
+  pdev->ep_in[CDC_RNDIS_IN_EP & 0xFU].total_length = hcdc->TxAggrLength;
+
+  (void)USBD_LL_Transmit(pdev, CDC_RNDIS_IN_EP, pbuf, hcdc->TxAggrLength);
+}
+
 void USBD_Update_CDC_RNDIS_DESC(uint8_t *desc,
                                 uint8_t cmd_itf,
                                 uint8_t com_itf,
@@ -49,6 +49,7 @@ extern "C" {
 #define USBD_CDC_ACM_COUNT           _USBD_CDC_ACM_COUNT
 #define USBD_USE_CDC_RNDIS           _USBD_USE_CDC_RNDIS
 #define USBD_USE_CDC_ECM             _USBD_USE_CDC_ECM
+#define USBD_USE_CDC_NCM             _USBD_USE_CDC_NCM
 #define USBD_USE_HID_MOUSE           _USBD_USE_HID_MOUSE
 #define USBD_USE_HID_KEYBOARD        _USBD_USE_HID_KEYBOARD
 #define USBD_USE_HID_CUSTOM          _USBD_USE_HID_CUSTOM
@@ -70,6 +71,9 @@ extern "C" {
 #if(USBD_USE_CDC_ECM == 1)
 #include "usbd_cdc_ecm_if.h"
 #endif
+#if(USBD_USE_CDC_NCM == 1)
+#include "usbd_cdc_ncm_if.h"
+#endif
 #if(USBD_USE_HID_MOUSE == 1)
 #include "usbd_hid_mouse.h"
 #endif
@@ -127,6 +127,9 @@ typedef struct USBD_COMPOSITE_CFG_DESC_t
 #if (USBD_USE_CDC_ECM == 1)
   uint8_t USBD_CDC_ECM_DESC[CDC_ECM_CONFIG_DESC_SIZE - 0x09];
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  uint8_t USBD_CDC_NCM_DESC[CDC_NCM_CONFIG_DESC_SIZE - 0x09];
+#endif
 #if (USBD_USE_HID_MOUSE == 1)
   uint8_t USBD_HID_MOUSE_DESC[USB_HID_CONFIG_DESC_SIZ - 0x09];
 #endif
@@ -207,6 +210,9 @@ static uint8_t USBD_COMPOSITE_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 #if (USBD_USE_CDC_ECM == 1)
   USBD_CDC_ECM.Init(pdev, cfgidx);
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  USBD_CDC_NCM.Init(pdev, cfgidx);
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
   USBD_CDC_RNDIS.Init(pdev, cfgidx);
 #endif
@@ -256,6 +262,9 @@ static uint8_t USBD_COMPOSITE_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 #if (USBD_USE_CDC_ECM == 1)
   USBD_CDC_ECM.DeInit(pdev, cfgidx);
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  USBD_CDC_NCM.DeInit(pdev, cfgidx);
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
   USBD_CDC_RNDIS.DeInit(pdev, cfgidx);
 #endif
@@ -300,6 +309,34 @@ static uint8_t USBD_COMPOSITE_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 static uint8_t USBD_COMPOSITE_Setup(USBD_HandleTypeDef *pdev,
                                     USBD_SetupReqTypedef *req)
 {
+#if (USBD_USE_UAC_MIC == 1) || (USBD_USE_UAC_SPKR == 1)
+  /* Sampling frequency requests carry an endpoint address in wIndex, which
+     may equal an interface number: route them before the interfaces */
+  if (((req->bmRequest & USB_REQ_TYPE_MASK) == USB_REQ_TYPE_CLASS) &&
+      ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT))
+  {
+#if (USBD_USE_UAC_MIC == 1)
+    if (LOBYTE(req->wIndex) == AUDIO_MIC_EP)
+    {
+      return USBD_AUDIO_MIC.Setup(pdev, req);
+    }
+#endif
+#if (USBD_USE_UAC_SPKR == 1)
+    if (LOBYTE(req->wIndex) == AUDIO_SPKR_EP)
+    {
+      return USBD_AUDIO_SPKR.Setup(pdev, req);
+    }
+#endif
+  }
+#endif
+#if (USBD_USE_UVC == 1)
+  /* Clearing the halt of the streaming endpoint stops a bulk stream */
+  if (((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT) &&
+      (LOBYTE(req->wIndex) == UVC_IN_EP))
+  {
+    return USBD_VIDEO.Setup(pdev, req);
+  }
+#endif
 #if (USBD_USE_CDC_ACM == 1)
   for (uint8_t i = 0; i < USBD_CDC_ACM_COUNT; i++)
   {
@@ -315,6 +352,12 @@ static uint8_t USBD_COMPOSITE_Setup(USBD_HandleTypeDef *pdev,
     return USBD_CDC_ECM.Setup(pdev, req);
   }
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  if (LOBYTE(req->wIndex) == CDC_NCM_CMD_ITF_NBR || LOBYTE(req->wIndex) == CDC_NCM_COM_ITF_NBR)
+  {
+    return USBD_CDC_NCM.Setup(pdev, req);
+  }
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
   if (LOBYTE(req->wIndex) == CDC_RNDIS_CMD_ITF_NBR || LOBYTE(req->wIndex) == CDC_RNDIS_COM_ITF_NBR)
   {
@@ -403,6 +446,12 @@ static uint8_t USBD_COMPOSITE_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
     return USBD_CDC_ECM.DataIn(pdev, epnum);
   }
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  if (epnum == (CDC_NCM_IN_EP & 0x7F) || epnum == (CDC_NCM_CMD_EP & 0x7F))
+  {
+    return USBD_CDC_NCM.DataIn(pdev, epnum);
+  }
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
   if (epnum == (CDC_RNDIS_IN_EP & 0x7F) || epnum == (CDC_RNDIS_CMD_EP & 0x7F))
   {
@@ -433,7 +482,11 @@ static uint8_t USBD_COMPOSITE_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
     return USBD_AUDIO_MIC.DataIn(pdev, epnum);
   }
 #endif
-#if (USBD_USE_UAC_SPKR == 1)
+#if (USBD_USE_UAC_SPKR == 1) && (AUDIO_SPKR_FB_ENABLED == 1U)
+  if (epnum == (AUDIO_SPKR_FB_EP & 0x7F))
+  {
+    return USBD_AUDIO_SPKR.DataIn(pdev, epnum);
+  }
 #endif
 #if (USBD_USE_UVC == 1)
   if (epnum == (UVC_IN_EP & 0x7F))
@@ -446,6 +499,12 @@ static uint8_t USBD_COMPOSITE_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   {
     return USBD_MSC.DataIn(pdev, epnum);
   }
+#if (MSC_UAS_ENABLED == 1U)
+  if (epnum == (MSC_UAS_STATUS_EP & 0x7F))
+  {
+    return USBD_MSC.DataIn(pdev, epnum);
+  }
+#endif /* MSC_UAS_ENABLED */
 #endif
 #if (USBD_USE_DFU == 1)
 #endif
@@ -473,6 +532,9 @@ static uint8_t USBD_COMPOSITE_EP0_RxReady(USBD_HandleTypeDef *pdev)
 #if (USBD_USE_CDC_ECM == 1)
   USBD_CDC_ECM.EP0_RxReady(pdev);
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  USBD_CDC_NCM.EP0_RxReady(pdev);
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
   USBD_CDC_RNDIS.EP0_RxReady(pdev);
 #endif
@@ -490,6 +552,7 @@ static uint8_t USBD_COMPOSITE_EP0_RxReady(USBD_HandleTypeDef *pdev)
   USBD_AUDIO_SPKR.EP0_RxReady(pdev);
 #endif
 #if (USBD_USE_UVC == 1)
+  USBD_VIDEO.EP0_RxReady(pdev);
 #endif
 #if (USBD_USE_MSC == 1)
 #endif
@@ -514,6 +577,8 @@ static uint8_t USBD_COMPOSITE_EP0_TxReady(USBD_HandleTypeDef *pdev)
 #endif
 #if (USBD_USE_CDC_ECM == 1)
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
 #endif
 #if (USBD_USE_HID_MOUSE == 1)
@@ -553,6 +618,8 @@ static uint8_t USBD_COMPOSITE_SOF(USBD_HandleTypeDef *pdev)
 #endif
 #if (USBD_USE_CDC_ECM == 1)
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
 #endif
 #if (USBD_USE_HID_MOUSE == 1)
@@ -594,6 +661,8 @@ static uint8_t USBD_COMPOSITE_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t
 #endif
 #if (USBD_USE_CDC_ECM == 1)
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
 #endif
 #if (USBD_USE_HID_MOUSE == 1)
@@ -608,7 +677,11 @@ static uint8_t USBD_COMPOSITE_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t
     USBD_AUDIO_MIC.IsoINIncomplete(pdev, epnum);
   }
 #endif
-#if (USBD_USE_UAC_SPKR == 1)
+#if (USBD_USE_UAC_SPKR == 1) && (AUDIO_SPKR_FB_ENABLED == 1U)
+  if (epnum == (AUDIO_SPKR_FB_EP & 0x7F))
+  {
+    USBD_AUDIO_SPKR.IsoINIncomplete(pdev, epnum);
+  }
 #endif
 #if (USBD_USE_UVC == 1)
   if (epnum == (UVC_IN_EP & 0x7F))
@@ -639,6 +712,8 @@ static uint8_t USBD_COMPOSITE_IsoOutIncomplete(USBD_HandleTypeDef *pdev, uint8_t
 #endif
 #if (USBD_USE_CDC_ECM == 1)
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
 #endif
 #if (USBD_USE_HID_MOUSE == 1)
@@ -690,6 +765,12 @@ static uint8_t USBD_COMPOSITE_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
     return USBD_CDC_ECM.DataOut(pdev, epnum);
   }
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+  if (epnum == CDC_NCM_OUT_EP)
+  {
+    return USBD_CDC_NCM.DataOut(pdev, epnum);
+  }
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
   if (epnum == CDC_RNDIS_OUT_EP)
   {
@@ -721,6 +802,12 @@ static uint8_t USBD_COMPOSITE_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
   {
     return USBD_MSC.DataOut(pdev, epnum);
   }
+#if (MSC_UAS_ENABLED == 1U)
+  if (epnum == MSC_UAS_CMD_EP)
+  {
+    return USBD_MSC.DataOut(pdev, epnum);
+  }
+#endif /* MSC_UAS_ENABLED */
 #endif
 #if (USBD_USE_DFU == 1)
 #endif
@@ -820,6 +907,16 @@ static uint8_t *USBD_COMPOSITE_GetUsrStringDesc(USBD_HandleTypeDef *pdev, uint8_
       USBD_GetString((uint8_t *)CDC_ECM_STR_DESC, USBD_StrDesc, length);
     }
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+    if (index == CDC_NCM_STR_DESC_IDX)
+    {
+      USBD_GetString((uint8_t *)CDC_NCM_STR_DESC, USBD_StrDesc, length);
+    }
+    if (index == CDC_NCM_MAC_STR_DESC_IDX)
+    {
+      USBD_GetString((uint8_t *)((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData_CDC_NCM)->pStrDesc, USBD_StrDesc, length);
+    }
+#endif
 #if (USBD_USE_CDC_RNDIS == 1)
     if (index == CDC_RNDIS_STR_DESC_IDX)
     {
@@ -953,6 +1050,34 @@ void USBD_COMPOSITE_Mount_Class(void)
   USBD_Track_String_Index += 1;
 #endif
 
+#if (USBD_USE_CDC_NCM == 1)
+  ptr = USBD_CDC_NCM.GetFSConfigDescriptor(&len);
+  USBD_Update_CDC_NCM_DESC(ptr,
+                           interface_no_track,
+                           interface_no_track + 1,
+                           in_ep_track,
+                           in_ep_track + 1,
+                           out_ep_track,
+                           USBD_Track_String_Index);
+  memcpy(USBD_COMPOSITE_FSCfgDesc.USBD_CDC_NCM_DESC, ptr + 0x09, len - 0x09);
+
+  ptr = USBD_CDC_NCM.GetHSConfigDescriptor(&len);
+  USBD_Update_CDC_NCM_DESC(ptr,
+                           interface_no_track,
+                           interface_no_track + 1,
+                           in_ep_track,
+                           in_ep_track + 1,
+                           out_ep_track,
+                           USBD_Track_String_Index);
+  memcpy(USBD_COMPOSITE_HSCfgDesc.USBD_CDC_NCM_DESC, ptr + 0x09, len - 0x09);
+
+  /* Function name and MAC address strings */
+  in_ep_track += 2;
+  out_ep_track += 1;
+  interface_no_track += 2;
+  USBD_Track_String_Index += 2;
+#endif
+
 #if (USBD_USE_HID_MOUSE == 1)
   ptr = USBD_HID_MOUSE.GetFSConfigDescriptor(&len);
   USBD_Update_HID_Mouse_DESC(ptr, interface_no_track, in_ep_track, USBD_Track_String_Index);
@@ -1020,13 +1145,16 @@ void USBD_COMPOSITE_Mount_Class(void)
 
 #if (USBD_USE_UAC_SPKR == 1)
   ptr = USBD_AUDIO_SPKR.GetFSConfigDescriptor(&len);
-  USBD_Update_Audio_SPKR_DESC(ptr, interface_no_track, interface_no_track + 1, out_ep_track, USBD_Track_String_Index);
+  USBD_Update_Audio_SPKR_DESC(ptr, interface_no_track, interface_no_track + 1, out_ep_track, in_ep_track, USBD_Track_String_Index);
   memcpy(USBD_COMPOSITE_FSCfgDesc.USBD_AUDIO_SPKR_DESC, ptr + 0x09, len - 0x09);
 
   ptr = USBD_AUDIO_SPKR.GetHSConfigDescriptor(&len);
-  USBD_Update_Audio_SPKR_DESC(ptr, interface_no_track, interface_no_track + 1, out_ep_track, USBD_Track_String_Index);
+  USBD_Update_Audio_SPKR_DESC(ptr, interface_no_track, interface_no_track + 1, out_ep_track, in_ep_track, USBD_Track_String_Index);
   memcpy(USBD_COMPOSITE_HSCfgDesc.USBD_AUDIO_SPKR_DESC, ptr + 0x09, len - 0x09);
 
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+  in_ep_track += 1;
+#endif
   out_ep_track += 1;
   interface_no_track += 2;
   USBD_Track_String_Index += 1;
@@ -1048,15 +1176,32 @@ void USBD_COMPOSITE_Mount_Class(void)
 
 #if (USBD_USE_MSC == 1)
   ptr = USBD_MSC.GetFSConfigDescriptor(&len);
-  USBD_Update_MSC_DESC(ptr, interface_no_track, in_ep_track, out_ep_track, USBD_Track_String_Index);
+  USBD_Update_MSC_DESC(ptr,
+                       interface_no_track,
+                       in_ep_track,
+                       out_ep_track,
+                       in_ep_track + 1,
+                       out_ep_track + 1,
+                       USBD_Track_String_Index);
   memcpy(USBD_COMPOSITE_FSCfgDesc.USBD_MSC_DESC, ptr + 0x09, len - 0x09);
 
   ptr = USBD_MSC.GetHSConfigDescriptor(&len);
-  USBD_Update_MSC_DESC(ptr, interface_no_track, in_ep_track, out_ep_track, USBD_Track_String_Index);
+  USBD_Update_MSC_DESC(ptr,
+                       interface_no_track,
+                       in_ep_track,
+                       out_ep_track,
+                       in_ep_track + 1,
+                       out_ep_track + 1,
+                       USBD_Track_String_Index);
   memcpy(USBD_COMPOSITE_HSCfgDesc.USBD_MSC_DESC, ptr + 0x09, len - 0x09);
 
+#if (MSC_UAS_ENABLED == 1U)
+  in_ep_track += 2;
+  out_ep_track += 2;
+#else
   in_ep_track += 1;
   out_ep_track += 1;
+#endif
   interface_no_track += 1;
   USBD_Track_String_Index += 1;
 #endif
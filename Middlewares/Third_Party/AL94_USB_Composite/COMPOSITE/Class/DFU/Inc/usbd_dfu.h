@@ -187,6 +187,7 @@ typedef struct
   uint16_t (*Write)(uint8_t *src, uint8_t *dest, uint32_t Len);
   uint8_t *(*Read)(uint8_t *src, uint8_t *dest, uint32_t Len);
   uint16_t (*GetStatus)(uint32_t Add, uint8_t cmd, uint8_t *buff);
+  uint16_t (*Manifest)(void);   /* Optional image check, NULL if none */
 } USBD_DFU_MediaTypeDef;
 /**
   * @}
@@ -1062,6 +1062,7 @@ static void DFU_Abort(USBD_HandleTypeDef *pdev)
 static void DFU_Leave(USBD_HandleTypeDef *pdev)
 {
   USBD_DFU_HandleTypeDef *hdfu = (USBD_DFU_HandleTypeDef *)pdev->pClassData_DFU;
+  USBD_DFU_MediaTypeDef *DfuInterface = (USBD_DFU_MediaTypeDef *)pdev->pUserData_DFU;
 
   if (hdfu == NULL)
   {
@@ -1070,6 +1071,19 @@ static void DFU_Leave(USBD_HandleTypeDef *pdev)
 
   hdfu->manif_state = DFU_MANIFEST_COMPLETE;
 
+  /* Let the media check the image before it is run */
+  if ((DfuInterface->Manifest != NULL) && (DfuInterface->Manifest() != USBD_OK))
+  {
+    hdfu->dev_state = DFU_STATE_ERROR;
+
+    hdfu->dev_status[0] = DFU_ERROR_VERIFY;
+    hdfu->dev_status[1] = 0U;
+    hdfu->dev_status[2] = 0U;
+    hdfu->dev_status[3] = 0U;
+    hdfu->dev_status[4] = hdfu->dev_state;
+    return;
+  }
+
   if (((USBD_DFU_CfgDesc[(11U + (9U * USBD_DFU_MAX_ITF_NUM))]) & 0x04U) != 0U)
   {
     hdfu->dev_state = DFU_STATE_MANIFEST_SYNC;
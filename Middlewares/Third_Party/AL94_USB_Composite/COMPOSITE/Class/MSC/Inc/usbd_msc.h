@@ -28,6 +28,7 @@ extern "C" {
 /* Includes ------------------------------------------------------------------*/
 #include  "usbd_msc_bot.h"
 #include  "usbd_msc_scsi.h"
+#include  "usbd_msc_uas.h"
 #include  "usbd_ioreq.h"
 
 /** @addtogroup USBD_MSC_BOT
@@ -55,7 +56,11 @@ extern "C" {
 
 #define BOT_GET_MAX_LUN              0xFE
 #define BOT_RESET                    0xFF
+#if (MSC_UAS_ENABLED == 1U)
+#define USB_MSC_CONFIG_DESC_SIZ      85
+#else
 #define USB_MSC_CONFIG_DESC_SIZ      32
+#endif /* MSC_UAS_ENABLED */
 
 /**
   * @}
@@ -98,6 +103,10 @@ typedef struct
 
   uint32_t scsi_blk_addr;
   uint32_t scsi_blk_len;
+  uint8_t scsi_write_pending;
+#if (MSC_UAS_ENABLED == 1U)
+  USBD_MSC_UAS_HandleTypeDef uas;
+#endif /* MSC_UAS_ENABLED */
 } USBD_MSC_BOT_HandleTypeDef;
 
 /* Structure for MSC process */
@@ -107,11 +116,15 @@ extern uint8_t MSC_IN_EP;
 extern uint8_t MSC_OUT_EP;
 extern uint8_t MSC_ITF_NBR;
 extern uint8_t MSC_BOT_STR_DESC_IDX;
+extern uint8_t MSC_UAS_CMD_EP;
+extern uint8_t MSC_UAS_STATUS_EP;
 
 uint8_t USBD_MSC_RegisterStorage(USBD_HandleTypeDef *pdev,
                                  USBD_StorageTypeDef *fops);
 
-void USBD_Update_MSC_DESC(uint8_t *desc, uint8_t itf_no, uint8_t in_ep, uint8_t out_ep, uint8_t str_idx);
+uint8_t USBD_MSC_Resume(USBD_HandleTypeDef *pdev);
+
+void USBD_Update_MSC_DESC(uint8_t *desc, uint8_t itf_no, uint8_t in_ep, uint8_t out_ep, uint8_t status_ep, uint8_t cmd_ep, uint8_t str_idx);
 
 /**
   * @}
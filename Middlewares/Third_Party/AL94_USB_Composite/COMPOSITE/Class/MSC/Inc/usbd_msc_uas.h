@@ -0,0 +1,196 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_uas.h
+  * @author  MCD Application Team
+  * @brief   Header for the usbd_msc_uas.c file
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_UAS_H
+#define __USBD_MSC_UAS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup MSC_UAS
+  * @brief This file is the Header file for usbd_msc_uas.c
+  * @{
+  */
+
+
+/** @defgroup USBD_UAS_Exported_Defines
+  * @{
+  */
+
+/* UAS Class Config */
+#ifndef MSC_UAS_ENABLED
+#define MSC_UAS_ENABLED                    1U
+#endif /* MSC_UAS_ENABLED */
+
+#ifndef MSC_UAS_QUEUE_DEPTH
+#define MSC_UAS_QUEUE_DEPTH                4U       /* Commands accepted ahead of the data pipes */
+#endif /* MSC_UAS_QUEUE_DEPTH */
+
+#ifndef MSC_UAS_RESP_DEPTH
+#define MSC_UAS_RESP_DEPTH                 2U       /* Responses waiting for the status pipe */
+#endif /* MSC_UAS_RESP_DEPTH */
+
+#define MSC_UAS_ALT_SETTING                0x01U    /* bAlternateSetting of the UAS interface */
+
+/* Information Unit IDs */
+#define USBD_UAS_IU_COMMAND                0x01U
+#define USBD_UAS_IU_SENSE                  0x03U
+#define USBD_UAS_IU_RESPONSE               0x04U
+#define USBD_UAS_IU_TASK_MGMT              0x05U
+#define USBD_UAS_IU_READ_READY             0x06U
+#define USBD_UAS_IU_WRITE_READY            0x07U
+
+#define USBD_UAS_COMMAND_IU_LENGTH         32U
+#define USBD_UAS_TASK_MGMT_IU_LENGTH       16U
+#define USBD_UAS_SENSE_IU_LENGTH           16U      /* Without sense data */
+#define USBD_UAS_RESPONSE_IU_LENGTH        8U
+#define USBD_UAS_READY_IU_LENGTH           4U
+#define USBD_UAS_STATUS_IU_MAX             36U      /* Sense IU + fixed format sense data */
+
+/* Pipe Usage descriptor IDs */
+#define USBD_UAS_PIPE_DESC_TYPE            0x24U
+#define USBD_UAS_PIPE_COMMAND              0x01U
+#define USBD_UAS_PIPE_STATUS               0x02U
+#define USBD_UAS_PIPE_DATA_IN              0x03U
+#define USBD_UAS_PIPE_DATA_OUT             0x04U
+
+/* SCSI status carried by the Sense IU */
+#define USBD_UAS_STATUS_GOOD               0x00U
+#define USBD_UAS_STATUS_CHECK_CONDITION    0x02U
+#define USBD_UAS_STATUS_TASK_SET_FULL      0x28U
+
+/* Response IU codes */
+#define USBD_UAS_RC_TMF_COMPLETE           0x00U
+#define USBD_UAS_RC_INVALID_IU             0x02U
+#define USBD_UAS_RC_TMF_NOT_SUPPORTED      0x04U
+#define USBD_UAS_RC_TMF_FAILED             0x05U
+#define USBD_UAS_RC_TMF_SUCCEEDED          0x08U
+#define USBD_UAS_RC_INCORRECT_LUN          0x09U
+#define USBD_UAS_RC_OVERLAPPED_TAG         0x0AU
+
+/* Task management functions */
+#define USBD_UAS_TMF_ABORT_TASK            0x01U
+#define USBD_UAS_TMF_ABORT_TASK_SET        0x02U
+#define USBD_UAS_TMF_CLEAR_TASK_SET        0x04U
+#define USBD_UAS_TMF_LUN_RESET             0x08U
+#define USBD_UAS_TMF_IT_NEXUS_RESET        0x10U
+#define USBD_UAS_TMF_QUERY_TASK            0x80U
+
+/* Command slot states */
+#define USBD_UAS_SLOT_FREE                 0U
+#define USBD_UAS_SLOT_QUEUED               1U       /* Waiting for the data pipes */
+#define USBD_UAS_SLOT_ACTIVE               2U       /* Owns the data pipes */
+#define USBD_UAS_SLOT_ABORTED              3U       /* Dropped by a TMF, skipped when dequeued */
+
+/* Status pipe phases of the active command */
+#define USBD_UAS_PHASE_IDLE                0U
+#define USBD_UAS_PHASE_DATA                1U       /* READ/WRITE READY sent */
+#define USBD_UAS_PHASE_SENSE_PENDING       2U       /* Sense IU waiting for the status pipe */
+#define USBD_UAS_PHASE_SENSE               3U       /* Sense IU sent */
+
+#define USBD_UAS_NO_CMD                    0xFFU
+
+/**
+  * @}
+  */
+
+/** @defgroup MSC_UAS_Private_TypesDefinitions
+  * @{
+  */
+
+typedef struct
+{
+  uint8_t  state;
+  uint8_t  lun;
+  uint16_t tag;
+  uint8_t  CB[16];
+}
+USBD_MSC_UAS_CmdTypeDef;
+
+typedef struct
+{
+  uint16_t tag;
+  uint8_t  iu_id;                              /* Response IU, or Sense IU of a refused command */
+  uint8_t  code;                               /* Response code, or SCSI status */
+}
+USBD_MSC_UAS_RespTypeDef;
+
+typedef struct
+{
+  uint8_t  cmd_iu[USBD_UAS_COMMAND_IU_LENGTH];
+  uint8_t  status_iu[USBD_UAS_STATUS_IU_MAX];
+  uint8_t  resp_iu[USBD_UAS_SENSE_IU_LENGTH];  /* Built only with the status pipe idle */
+  USBD_MSC_UAS_RespTypeDef resp[MSC_UAS_RESP_DEPTH];
+  USBD_MSC_UAS_CmdTypeDef queue[MSC_UAS_QUEUE_DEPTH];
+  uint8_t  head;
+  uint8_t  count;
+  uint8_t  active;
+  uint8_t  phase;
+  uint8_t  sense_status;
+  uint8_t  cmd_armed;
+  uint8_t  status_busy;
+  uint8_t  resp_head;
+  uint8_t  resp_count;
+}
+USBD_MSC_UAS_HandleTypeDef;
+
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_UAS_Exported_FunctionsPrototypes
+  * @{
+  */
+void MSC_UAS_Init(USBD_HandleTypeDef  *pdev);
+void MSC_UAS_DeInit(USBD_HandleTypeDef  *pdev);
+void MSC_UAS_DataIn(USBD_HandleTypeDef  *pdev,
+                    uint8_t epnum);
+
+void MSC_UAS_DataOut(USBD_HandleTypeDef  *pdev,
+                     uint8_t epnum);
+
+void MSC_UAS_SendStatus(USBD_HandleTypeDef  *pdev,
+                        uint8_t CSW_Status);
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_MSC_UAS_H */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -15,6 +15,7 @@
   *           This driver implements the following aspects of the specification:
   *             - Bulk-Only Transport protocol
   *             - Subclass : SCSI transparent command set (ref. SCSI Primary Commands - 3 (SPC-3))
+  *             - USB Attached SCSI protocol on alternate setting 1 (MSC_UAS_ENABLED)
   *
   *  @endverbatim
   *
@@ -45,11 +46,15 @@ EndBSPDependencies */
 #define _MSC_OUT_EP 0x01U
 #define _MSC_ITF_NBR 0x00
 #define _MSC_BOT_STR_DESC_IDX 0x00U
+#define _MSC_UAS_CMD_EP 0x02U
+#define _MSC_UAS_STATUS_EP 0x82U
 
 uint8_t MSC_IN_EP = _MSC_IN_EP;
 uint8_t MSC_OUT_EP = _MSC_OUT_EP;
 uint8_t MSC_ITF_NBR = _MSC_ITF_NBR;
 uint8_t MSC_BOT_STR_DESC_IDX = _MSC_BOT_STR_DESC_IDX;
+uint8_t MSC_UAS_CMD_EP = _MSC_UAS_CMD_EP;
+uint8_t MSC_UAS_STATUS_EP = _MSC_UAS_STATUS_EP;
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
   * @{
@@ -168,7 +173,60 @@ __ALIGN_BEGIN static uint8_t USBD_MSC_CfgHSDesc[USB_MSC_CONFIG_DESC_SIZ] __ALIGN
         0x02,        /* Bulk endpoint type */
         LOBYTE(MSC_MAX_HS_PACKET),
         HIBYTE(MSC_MAX_HS_PACKET),
+#if (MSC_UAS_ENABLED == 1U)
+        0x00, /* Polling interval in milliseconds */
+#else
         0x00 /* Polling interval in milliseconds */
+#endif /* MSC_UAS_ENABLED */
+
+#if (MSC_UAS_ENABLED == 1U)
+        /********************  UAS interface ********************/
+        0x09,                  /* bLength: Interface Descriptor size */
+        0x04,                  /* bDescriptorType: */
+        _MSC_ITF_NBR,          /* bInterfaceNumber: Number of Interface */
+        MSC_UAS_ALT_SETTING,   /* bAlternateSetting: Alternate setting */
+        0x04,                  /* bNumEndpoints */
+        0x08,                  /* bInterfaceClass: MSC Class */
+        0x06,                  /* bInterfaceSubClass : SCSI transparent */
+        0x62,                  /* nInterfaceProtocol : UAS */
+        _MSC_BOT_STR_DESC_IDX, /* iInterface */
+        /********************  UAS Endpoints ********************/
+        0x07,            /* Endpoint descriptor length = 7 */
+        0x05,            /* Endpoint descriptor type */
+        _MSC_UAS_CMD_EP, /* Endpoint address (OUT, address 2) */
+        0x02,            /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_HS_PACKET),
+        HIBYTE(MSC_MAX_HS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_COMMAND, 0x00, /* Pipe Usage: Command */
+
+        0x07,               /* Endpoint descriptor length = 7 */
+        0x05,               /* Endpoint descriptor type */
+        _MSC_UAS_STATUS_EP, /* Endpoint address (IN, address 2) */
+        0x02,               /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_HS_PACKET),
+        HIBYTE(MSC_MAX_HS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_STATUS, 0x00, /* Pipe Usage: Status */
+
+        0x07,       /* Endpoint descriptor length = 7 */
+        0x05,       /* Endpoint descriptor type */
+        _MSC_IN_EP, /* Endpoint address (IN, address 1) */
+        0x02,       /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_HS_PACKET),
+        HIBYTE(MSC_MAX_HS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_DATA_IN, 0x00, /* Pipe Usage: Data-in */
+
+        0x07,        /* Endpoint descriptor length = 7 */
+        0x05,        /* Endpoint descriptor type */
+        _MSC_OUT_EP, /* Endpoint address (OUT, address 1) */
+        0x02,        /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_HS_PACKET),
+        HIBYTE(MSC_MAX_HS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_DATA_OUT, 0x00 /* Pipe Usage: Data-out */
+#endif /* MSC_UAS_ENABLED */
 };
 
 /* USB Mass storage device Configuration Descriptor */
@@ -215,7 +273,60 @@ __ALIGN_BEGIN static uint8_t USBD_MSC_CfgFSDesc[USB_MSC_CONFIG_DESC_SIZ] __ALIGN
         0x02,        /* Bulk endpoint type */
         LOBYTE(MSC_MAX_FS_PACKET),
         HIBYTE(MSC_MAX_FS_PACKET),
+#if (MSC_UAS_ENABLED == 1U)
+        0x00, /* Polling interval in milliseconds */
+#else
         0x00 /* Polling interval in milliseconds */
+#endif /* MSC_UAS_ENABLED */
+
+#if (MSC_UAS_ENABLED == 1U)
+        /********************  UAS interface ********************/
+        0x09,                  /* bLength: Interface Descriptor size */
+        0x04,                  /* bDescriptorType: */
+        _MSC_ITF_NBR,          /* bInterfaceNumber: Number of Interface */
+        MSC_UAS_ALT_SETTING,   /* bAlternateSetting: Alternate setting */
+        0x04,                  /* bNumEndpoints */
+        0x08,                  /* bInterfaceClass: MSC Class */
+        0x06,                  /* bInterfaceSubClass : SCSI transparent */
+        0x62,                  /* nInterfaceProtocol : UAS */
+        _MSC_BOT_STR_DESC_IDX, /* iInterface */
+        /********************  UAS Endpoints ********************/
+        0x07,            /* Endpoint descriptor length = 7 */
+        0x05,            /* Endpoint descriptor type */
+        _MSC_UAS_CMD_EP, /* Endpoint address (OUT, address 2) */
+        0x02,            /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_FS_PACKET),
+        HIBYTE(MSC_MAX_FS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_COMMAND, 0x00, /* Pipe Usage: Command */
+
+        0x07,               /* Endpoint descriptor length = 7 */
+        0x05,               /* Endpoint descriptor type */
+        _MSC_UAS_STATUS_EP, /* Endpoint address (IN, address 2) */
+        0x02,               /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_FS_PACKET),
+        HIBYTE(MSC_MAX_FS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_STATUS, 0x00, /* Pipe Usage: Status */
+
+        0x07,       /* Endpoint descriptor length = 7 */
+        0x05,       /* Endpoint descriptor type */
+        _MSC_IN_EP, /* Endpoint address (IN, address 1) */
+        0x02,       /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_FS_PACKET),
+        HIBYTE(MSC_MAX_FS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_DATA_IN, 0x00, /* Pipe Usage: Data-in */
+
+        0x07,        /* Endpoint descriptor length = 7 */
+        0x05,        /* Endpoint descriptor type */
+        _MSC_OUT_EP, /* Endpoint address (OUT, address 1) */
+        0x02,        /* Bulk endpoint type */
+        LOBYTE(MSC_MAX_FS_PACKET),
+        HIBYTE(MSC_MAX_FS_PACKET),
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_DATA_OUT, 0x00 /* Pipe Usage: Data-out */
+#endif /* MSC_UAS_ENABLED */
 };
 
 __ALIGN_BEGIN static uint8_t USBD_MSC_OtherSpeedCfgDesc[USB_MSC_CONFIG_DESC_SIZ] __ALIGN_END =
@@ -260,7 +371,60 @@ __ALIGN_BEGIN static uint8_t USBD_MSC_OtherSpeedCfgDesc[USB_MSC_CONFIG_DESC_SIZ]
         0x02,        /* Bulk endpoint type */
         0x40,
         0x00,
+#if (MSC_UAS_ENABLED == 1U)
+        0x00, /* Polling interval in milliseconds */
+#else
         0x00 /* Polling interval in milliseconds */
+#endif /* MSC_UAS_ENABLED */
+
+#if (MSC_UAS_ENABLED == 1U)
+        /********************  UAS interface ********************/
+        0x09,                  /* bLength: Interface Descriptor size */
+        0x04,                  /* bDescriptorType: */
+        _MSC_ITF_NBR,          /* bInterfaceNumber: Number of Interface */
+        MSC_UAS_ALT_SETTING,   /* bAlternateSetting: Alternate setting */
+        0x04,                  /* bNumEndpoints */
+        0x08,                  /* bInterfaceClass: MSC Class */
+        0x06,                  /* bInterfaceSubClass : SCSI transparent */
+        0x62,                  /* nInterfaceProtocol : UAS */
+        _MSC_BOT_STR_DESC_IDX, /* iInterface */
+        /********************  UAS Endpoints ********************/
+        0x07,            /* Endpoint descriptor length = 7 */
+        0x05,            /* Endpoint descriptor type */
+        _MSC_UAS_CMD_EP, /* Endpoint address (OUT, address 2) */
+        0x02,            /* Bulk endpoint type */
+        0x40,
+        0x00,
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_COMMAND, 0x00, /* Pipe Usage: Command */
+
+        0x07,               /* Endpoint descriptor length = 7 */
+        0x05,               /* Endpoint descriptor type */
+        _MSC_UAS_STATUS_EP, /* Endpoint address (IN, address 2) */
+        0x02,               /* Bulk endpoint type */
+        0x40,
+        0x00,
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_STATUS, 0x00, /* Pipe Usage: Status */
+
+        0x07,       /* Endpoint descriptor length = 7 */
+        0x05,       /* Endpoint descriptor type */
+        _MSC_IN_EP, /* Endpoint address (IN, address 1) */
+        0x02,       /* Bulk endpoint type */
+        0x40,
+        0x00,
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_DATA_IN, 0x00, /* Pipe Usage: Data-in */
+
+        0x07,        /* Endpoint descriptor length = 7 */
+        0x05,        /* Endpoint descriptor type */
+        _MSC_OUT_EP, /* Endpoint address (OUT, address 1) */
+        0x02,        /* Bulk endpoint type */
+        0x40,
+        0x00,
+        0x00, /* Polling interval in milliseconds */
+        0x04, USBD_UAS_PIPE_DESC_TYPE, USBD_UAS_PIPE_DATA_OUT, 0x00 /* Pipe Usage: Data-out */
+#endif /* MSC_UAS_ENABLED */
 };
 
 /* USB Standard Device Descriptor */
@@ -316,6 +480,15 @@ uint8_t USBD_MSC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
     /* Open EP IN */
     (void)USBD_LL_OpenEP(pdev, MSC_IN_EP, USBD_EP_TYPE_BULK, MSC_MAX_HS_PACKET);
     pdev->ep_in[MSC_IN_EP & 0xFU].is_used = 1U;
+
+#if (MSC_UAS_ENABLED == 1U)
+    /* Open UAS command and status pipes */
+    (void)USBD_LL_OpenEP(pdev, MSC_UAS_CMD_EP, USBD_EP_TYPE_BULK, MSC_MAX_HS_PACKET);
+    pdev->ep_out[MSC_UAS_CMD_EP & 0xFU].is_used = 1U;
+
+    (void)USBD_LL_OpenEP(pdev, MSC_UAS_STATUS_EP, USBD_EP_TYPE_BULK, MSC_MAX_HS_PACKET);
+    pdev->ep_in[MSC_UAS_STATUS_EP & 0xFU].is_used = 1U;
+#endif /* MSC_UAS_ENABLED */
   }
   else
   {
@@ -326,9 +499,19 @@ uint8_t USBD_MSC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
     /* Open EP IN */
     (void)USBD_LL_OpenEP(pdev, MSC_IN_EP, USBD_EP_TYPE_BULK, MSC_MAX_FS_PACKET);
     pdev->ep_in[MSC_IN_EP & 0xFU].is_used = 1U;
+
+#if (MSC_UAS_ENABLED == 1U)
+    /* Open UAS command and status pipes */
+    (void)USBD_LL_OpenEP(pdev, MSC_UAS_CMD_EP, USBD_EP_TYPE_BULK, MSC_MAX_FS_PACKET);
+    pdev->ep_out[MSC_UAS_CMD_EP & 0xFU].is_used = 1U;
+
+    (void)USBD_LL_OpenEP(pdev, MSC_UAS_STATUS_EP, USBD_EP_TYPE_BULK, MSC_MAX_FS_PACKET);
+    pdev->ep_in[MSC_UAS_STATUS_EP & 0xFU].is_used = 1U;
+#endif /* MSC_UAS_ENABLED */
   }
 
   /* Init the BOT  layer */
+  hmsc->interface = 0U;
   MSC_BOT_Init(pdev);
 
   return (uint8_t)USBD_OK;
@@ -353,10 +536,22 @@ uint8_t USBD_MSC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   (void)USBD_LL_CloseEP(pdev, MSC_IN_EP);
   pdev->ep_in[MSC_IN_EP & 0xFU].is_used = 0U;
 
+#if (MSC_UAS_ENABLED == 1U)
+  /* Close UAS command and status pipes */
+  (void)USBD_LL_CloseEP(pdev, MSC_UAS_CMD_EP);
+  pdev->ep_out[MSC_UAS_CMD_EP & 0xFU].is_used = 0U;
+
+  (void)USBD_LL_CloseEP(pdev, MSC_UAS_STATUS_EP);
+  pdev->ep_in[MSC_UAS_STATUS_EP & 0xFU].is_used = 0U;
+#endif /* MSC_UAS_ENABLED */
+
   /* Free MSC Class Resources */
   if (pdev->pClassData_MSC != NULL)
   {
     /* De-Init the BOT layer */
+#if (MSC_UAS_ENABLED == 1U)
+    MSC_UAS_DeInit(pdev);
+#endif /* MSC_UAS_ENABLED */
     MSC_BOT_DeInit(pdev);
 #if (0)
     (void)USBD_free(pdev->pClassData_MSC);
@@ -452,10 +647,28 @@ uint8_t USBD_MSC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
       break;
 
     case USB_REQ_SET_INTERFACE:
+#if (MSC_UAS_ENABLED == 1U)
+      if ((pdev->dev_state == USBD_STATE_CONFIGURED) &&
+          (req->wValue <= MSC_UAS_ALT_SETTING))
+      {
+        hmsc->interface = (uint8_t)(req->wValue);
+
+        /* Switch transport, abandoning whatever the other one had in flight */
+        if (hmsc->interface == MSC_UAS_ALT_SETTING)
+        {
+          MSC_UAS_Init(pdev);
+        }
+        else
+        {
+          MSC_BOT_Init(pdev);
+        }
+      }
+#else
       if (pdev->dev_state == USBD_STATE_CONFIGURED)
       {
         hmsc->interface = (uint8_t)(req->wValue);
       }
+#endif /* MSC_UAS_ENABLED */
       else
       {
         USBD_CtlError(pdev, req);
@@ -471,8 +684,14 @@ uint8_t USBD_MSC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
           /* Flush the FIFO */
           (void)USBD_LL_FlushEP(pdev, (uint8_t)req->wIndex);
 
-          /* Handle BOT error */
-          MSC_BOT_CplClrFeature(pdev, (uint8_t)req->wIndex);
+#if (MSC_UAS_ENABLED == 1U)
+          /* UAS reports errors through Sense IUs and never stalls its pipes */
+          if (hmsc->interface != MSC_UAS_ALT_SETTING)
+#endif /* MSC_UAS_ENABLED */
+          {
+            /* Handle BOT error */
+            MSC_BOT_CplClrFeature(pdev, (uint8_t)req->wIndex);
+          }
         }
       }
       break;
@@ -502,6 +721,16 @@ uint8_t USBD_MSC_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
   */
 uint8_t USBD_MSC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
+#if (MSC_UAS_ENABLED == 1U)
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  if ((hmsc != NULL) && (hmsc->interface == MSC_UAS_ALT_SETTING))
+  {
+    MSC_UAS_DataIn(pdev, epnum);
+    return (uint8_t)USBD_OK;
+  }
+#endif /* MSC_UAS_ENABLED */
+
   MSC_BOT_DataIn(pdev, epnum);
 
   return (uint8_t)USBD_OK;
@@ -516,6 +745,16 @@ uint8_t USBD_MSC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   */
 uint8_t USBD_MSC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
+#if (MSC_UAS_ENABLED == 1U)
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  if ((hmsc != NULL) && (hmsc->interface == MSC_UAS_ALT_SETTING))
+  {
+    MSC_UAS_DataOut(pdev, epnum);
+    return (uint8_t)USBD_OK;
+  }
+#endif /* MSC_UAS_ENABLED */
+
   MSC_BOT_DataOut(pdev, epnum);
 
   return (uint8_t)USBD_OK;
@@ -589,13 +828,62 @@ uint8_t USBD_MSC_RegisterStorage(USBD_HandleTypeDef *pdev, USBD_StorageTypeDef *
   return (uint8_t)USBD_OK;
 }
 
-void USBD_Update_MSC_DESC(uint8_t *desc, uint8_t itf_no, uint8_t in_ep, uint8_t out_ep, uint8_t str_idx)
+/**
+  * @brief  USBD_MSC_Resume
+  *         Retry a write the storage deferred by returning USBD_BUSY
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_MSC_Resume(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  if ((hmsc == NULL) || (hmsc->scsi_write_pending == 0U))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  hmsc->scsi_write_pending = 0U;
+
+  if (SCSI_ProcessCmd(pdev, hmsc->cbw.bLUN, &hmsc->cbw.CB[0]) < 0)
+  {
+#if (MSC_UAS_ENABLED == 1U)
+    if (hmsc->interface == MSC_UAS_ALT_SETTING)
+    {
+      MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_FAILED);
+    }
+    else
+#endif /* MSC_UAS_ENABLED */
+    {
+      MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_FAILED);
+    }
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+void USBD_Update_MSC_DESC(uint8_t *desc, uint8_t itf_no, uint8_t in_ep, uint8_t out_ep, uint8_t status_ep, uint8_t cmd_ep, uint8_t str_idx)
 {
   desc[11] = itf_no;
   desc[17] = str_idx;
   desc[20] = in_ep;
   desc[27] = out_ep;
 
+#if (MSC_UAS_ENABLED == 1U)
+  desc[34] = itf_no;
+  desc[40] = str_idx;
+  desc[43] = cmd_ep;
+  desc[54] = status_ep;
+  desc[65] = in_ep;
+  desc[76] = out_ep;
+
+  MSC_UAS_CMD_EP = cmd_ep;
+  MSC_UAS_STATUS_EP = status_ep;
+#else
+  UNUSED(status_ep);
+  UNUSED(cmd_ep);
+#endif /* MSC_UAS_ENABLED */
+
   MSC_IN_EP = in_ep;
   MSC_OUT_EP = out_ep;
   MSC_ITF_NBR = itf_no;
@@ -98,6 +98,8 @@ static void MSC_BOT_Abort(USBD_HandleTypeDef *pdev);
 void MSC_BOT_Init(USBD_HandleTypeDef *pdev)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  int8_t max_lun;
+  int8_t lun;
 
   if (hmsc == NULL)
   {
@@ -106,12 +108,18 @@ void MSC_BOT_Init(USBD_HandleTypeDef *pdev)
 
   hmsc->bot_state = USBD_BOT_IDLE;
   hmsc->bot_status = USBD_BOT_STATUS_NORMAL;
+  hmsc->scsi_write_pending = 0U;
 
   hmsc->scsi_sense_tail = 0U;
   hmsc->scsi_sense_head = 0U;
   hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
 
-  ((USBD_StorageTypeDef *)pdev->pUserData_MSC)->Init(0U);
+  max_lun = ((USBD_StorageTypeDef *)pdev->pUserData_MSC)->GetMaxLun();
+
+  for (lun = 0; lun <= max_lun; lun++)
+  {
+    ((USBD_StorageTypeDef *)pdev->pUserData_MSC)->Init((uint8_t)lun);
+  }
 
   (void)USBD_LL_FlushEP(pdev, MSC_OUT_EP);
   (void)USBD_LL_FlushEP(pdev, MSC_IN_EP);
@@ -138,6 +146,7 @@ void MSC_BOT_Reset(USBD_HandleTypeDef *pdev)
 
   hmsc->bot_state  = USBD_BOT_IDLE;
   hmsc->bot_status = USBD_BOT_STATUS_RECOVERY;
+  hmsc->scsi_write_pending = 0U;
 
   (void)USBD_LL_ClearStallEP(pdev, MSC_IN_EP);
   (void)USBD_LL_ClearStallEP(pdev, MSC_OUT_EP);
@@ -464,7 +464,6 @@ static int8_t SCSI_ReadFormatCapacity(USBD_HandleTypeDef *pdev, uint8_t lun, uin
   */
 static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
   uint16_t len = MODE_SENSE6_LEN;
 
@@ -480,6 +479,12 @@ static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *pa
 
   (void)SCSI_UpdateBotData(hmsc, MSC_Mode_Sense6_data, len);
 
+  /* WP bit of the device-specific parameter */
+  if ((len > 2U) && (((USBD_StorageTypeDef *)pdev->pUserData_MSC)->IsWriteProtected(lun) != 0))
+  {
+    hmsc->bot_data[2U] |= 0x80U;
+  }
+
   return 0;
 }
 
@@ -493,7 +498,6 @@ static int8_t SCSI_ModeSense6(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *pa
   */
 static int8_t SCSI_ModeSense10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *params)
 {
-  UNUSED(lun);
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
   uint16_t len = MODE_SENSE10_LEN;
 
@@ -509,6 +513,12 @@ static int8_t SCSI_ModeSense10(USBD_HandleTypeDef *pdev, uint8_t lun, uint8_t *p
 
   (void)SCSI_UpdateBotData(hmsc, MSC_Mode_Sense10_data, len);
 
+  /* WP bit of the device-specific parameter */
+  if ((len > 3U) && (((USBD_StorageTypeDef *)pdev->pUserData_MSC)->IsWriteProtected(lun) != 0))
+  {
+    hmsc->bot_data[3U] |= 0x80U;
+  }
+
   return 0;
 }
 
@@ -1036,6 +1046,14 @@ static int8_t SCSI_CheckAddressRange(USBD_HandleTypeDef *pdev, uint8_t lun,
     return -1;
   }
 
+  /* Capacity is per LUN: refresh it for the unit this command addresses */
+  if (((USBD_StorageTypeDef *)pdev->pUserData_MSC)->GetCapacity(lun, &hmsc->scsi_blk_nbr,
+                                                            &hmsc->scsi_blk_size) != 0)
+  {
+    SCSI_SenseCode(pdev, lun, NOT_READY, MEDIUM_NOT_PRESENT);
+    return -1;
+  }
+
   if ((blk_offset + blk_nbr) > hmsc->scsi_blk_nbr)
   {
     SCSI_SenseCode(pdev, lun, ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
@@ -1097,6 +1115,7 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
 {
   USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
   uint32_t len = hmsc->scsi_blk_len * hmsc->scsi_blk_size;
+  int8_t status;
 
   if (hmsc == NULL)
   {
@@ -1105,14 +1124,23 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
 
   len = MIN(len, MSC_MEDIA_PACKET);
 
-  if (((USBD_StorageTypeDef *)pdev->pUserData_MSC)->Write(lun, hmsc->bot_data,
-                                                      hmsc->scsi_blk_addr,
-                                                      (len / hmsc->scsi_blk_size)) < 0)
+  status = ((USBD_StorageTypeDef *)pdev->pUserData_MSC)->Write(lun, hmsc->bot_data,
+                                                               hmsc->scsi_blk_addr,
+                                                               (len / hmsc->scsi_blk_size));
+  if (status < 0)
   {
     SCSI_SenseCode(pdev, lun, HARDWARE_ERROR, WRITE_FAULT);
     return -1;
   }
 
+  if (status == (int8_t)USBD_BUSY)
+  {
+    /* Backend queue full: keep the packet and leave the OUT endpoint
+       NAKing until USBD_MSC_Resume() retries it */
+    hmsc->scsi_write_pending = 1U;
+    return 0;
+  }
+
   hmsc->scsi_blk_addr += (len / hmsc->scsi_blk_size);
   hmsc->scsi_blk_len -= (len / hmsc->scsi_blk_size);
 
@@ -1121,7 +1149,16 @@ static int8_t SCSI_ProcessWrite(USBD_HandleTypeDef *pdev, uint8_t lun)
 
   if (hmsc->scsi_blk_len == 0U)
   {
-    MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
+#if (MSC_UAS_ENABLED == 1U)
+    if (hmsc->interface == MSC_UAS_ALT_SETTING)
+    {
+      MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_PASSED);
+    }
+    else
+#endif /* MSC_UAS_ENABLED */
+    {
+      MSC_BOT_SendCSW(pdev, USBD_CSW_CMD_PASSED);
+    }
   }
   else
   {
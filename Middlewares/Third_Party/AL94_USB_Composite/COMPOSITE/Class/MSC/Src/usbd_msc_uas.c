@@ -0,0 +1,869 @@
+/**
+  ******************************************************************************
+  * @file    usbd_msc_uas.c
+  * @author  MCD Application Team
+  * @brief   This file provides all the UAS protocol core functions.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                UAS Transport Description
+  *          ===================================================================
+  *           USB Attached SCSI is exposed as alternate setting 1 of the MSC
+  *           interface, next to the Bulk-Only Transport on alternate setting 0.
+  *           The data-in and data-out pipes are the BOT bulk endpoints, so the
+  *           SCSI layer keeps moving data exactly as it does for BOT; the UAS
+  *           layer adds a command pipe and a status pipe around it.
+  *
+  *           The command pipe stays armed, which lets the host queue up to
+  *           MSC_UAS_QUEUE_DEPTH tagged commands. A command beyond them gets a
+  *           Sense IU with TASK SET FULL for the host to retry it, so Task
+  *           Management IUs (abort, reset) still get in with the queue full.
+  *           Responses wait for the status pipe in a queue of
+  *           MSC_UAS_RESP_DEPTH entries and are built into resp_iu only once
+  *           the pipe is idle; only a full response queue holds the pipe.
+  *           On USB 2.0 (no streams) the data pipes are owned by one command at
+  *           a time: it is announced with a READ READY / WRITE READY IU, its
+  *           data phase runs through the SCSI handlers, and a Sense IU carrying
+  *           the same tag closes it before the next queued command starts.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * <h2><center>&copy; Copyright (c) 2015 STMicroelectronics.
+  * All rights reserved.</center></h2>
+  *
+  * This software component is licensed by ST under Ultimate Liberty license
+  * SLA0044, the "License"; You may not use this file except in compliance with
+  * the License. You may obtain a copy of the License at:
+  *                      www.st.com/SLA0044
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_uas.h"
+#include "usbd_msc.h"
+#include "usbd_msc_scsi.h"
+#include "usbd_ioreq.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup MSC_UAS
+  * @brief UAS protocol module
+  * @{
+  */
+
+/** @defgroup MSC_UAS_Private_TypesDefinitions
+  * @{
+  */
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_UAS_Private_Defines
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_UAS_Private_Macros
+  * @{
+  */
+#define UAS_SLOT(huas, n)          (&(huas)->queue[((huas)->head + (n)) % MSC_UAS_QUEUE_DEPTH])
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_UAS_Private_Variables
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_UAS_Private_FunctionPrototypes
+  * @{
+  */
+#if (MSC_UAS_ENABLED == 1U)
+static void MSC_UAS_CommandOut(USBD_HandleTypeDef *pdev);
+static void MSC_UAS_TaskManagement(USBD_HandleTypeDef *pdev, uint16_t tag);
+static void MSC_UAS_Kick(USBD_HandleTypeDef *pdev);
+static void MSC_UAS_StartCmd(USBD_HandleTypeDef *pdev, USBD_MSC_UAS_CmdTypeDef *cmd);
+static void MSC_UAS_CompleteCmd(USBD_HandleTypeDef *pdev);
+static void MSC_UAS_SendReady(USBD_HandleTypeDef *pdev, uint8_t iu_id);
+static void MSC_UAS_SendSense(USBD_HandleTypeDef *pdev);
+static void MSC_UAS_SendResponse(USBD_HandleTypeDef *pdev, uint16_t tag, uint8_t iu_id, uint8_t code);
+static uint8_t MSC_UAS_NextResponse(USBD_HandleTypeDef *pdev);
+static void MSC_UAS_ArmCommand(USBD_HandleTypeDef *pdev);
+static uint32_t MSC_UAS_DataLength(USBD_MSC_BOT_HandleTypeDef *hmsc, uint8_t *cdb, uint8_t *dir_in);
+#endif /* MSC_UAS_ENABLED */
+/**
+  * @}
+  */
+
+
+/** @defgroup MSC_UAS_Private_Functions
+  * @{
+  */
+
+#if (MSC_UAS_ENABLED == 1U)
+/**
+  * @brief  MSC_UAS_Init
+  *         Initialize the UAS Process
+  * @param  pdev: device instance
+  * @retval None
+  */
+void MSC_UAS_Init(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas;
+  uint8_t i;
+
+  if (hmsc == NULL)
+  {
+    return;
+  }
+
+  huas = &hmsc->uas;
+
+  for (i = 0U; i < MSC_UAS_QUEUE_DEPTH; i++)
+  {
+    huas->queue[i].state = USBD_UAS_SLOT_FREE;
+  }
+
+  huas->head = 0U;
+  huas->count = 0U;
+  huas->active = USBD_UAS_NO_CMD;
+  huas->phase = USBD_UAS_PHASE_IDLE;
+  huas->cmd_armed = 0U;
+  huas->status_busy = 0U;
+  huas->resp_head = 0U;
+  huas->resp_count = 0U;
+
+  hmsc->bot_state = USBD_BOT_IDLE;
+  hmsc->scsi_write_pending = 0U;
+  hmsc->bot_status = USBD_BOT_STATUS_NORMAL;
+
+  hmsc->scsi_sense_tail = 0U;
+  hmsc->scsi_sense_head = 0U;
+  hmsc->scsi_medium_state = SCSI_MEDIUM_UNLOCKED;
+
+  (void)USBD_LL_FlushEP(pdev, MSC_OUT_EP);
+  (void)USBD_LL_FlushEP(pdev, MSC_IN_EP);
+  (void)USBD_LL_FlushEP(pdev, MSC_UAS_CMD_EP);
+  (void)USBD_LL_FlushEP(pdev, MSC_UAS_STATUS_EP);
+
+  /* Prepare EP to Receive First Command IU */
+  MSC_UAS_ArmCommand(pdev);
+}
+
+/**
+  * @brief  MSC_UAS_DeInit
+  *         DeInitialize the UAS Machine
+  * @param  pdev: device instance
+  * @retval None
+  */
+void MSC_UAS_DeInit(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  if (hmsc != NULL)
+  {
+    hmsc->uas.count = 0U;
+    hmsc->uas.active = USBD_UAS_NO_CMD;
+    hmsc->uas.cmd_armed = 0U;
+    hmsc->bot_state = USBD_BOT_IDLE;
+  }
+}
+
+/**
+  * @brief  MSC_UAS_DataIn
+  *         Handle UAS status pipe and data-in pipe completions
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval None
+  */
+void MSC_UAS_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas;
+
+  if (hmsc == NULL)
+  {
+    return;
+  }
+
+  huas = &hmsc->uas;
+
+  if (epnum == (MSC_UAS_STATUS_EP & 0x7FU))
+  {
+    huas->status_busy = 0U;
+
+    if (huas->phase == USBD_UAS_PHASE_SENSE)
+    {
+      MSC_UAS_CompleteCmd(pdev);
+    }
+
+    if (MSC_UAS_NextResponse(pdev) != 0U)
+    {
+      /* A response queue entry is free again for the next IU */
+      if (huas->cmd_armed == 0U)
+      {
+        MSC_UAS_ArmCommand(pdev);
+      }
+    }
+    else if (huas->phase == USBD_UAS_PHASE_SENSE_PENDING)
+    {
+      MSC_UAS_SendSense(pdev);
+    }
+    else
+    {
+      MSC_UAS_Kick(pdev);
+    }
+    return;
+  }
+
+  if (huas->active == USBD_UAS_NO_CMD)
+  {
+    return;
+  }
+
+  switch (hmsc->bot_state)
+  {
+    case USBD_BOT_DATA_IN:
+      if (SCSI_ProcessCmd(pdev, hmsc->cbw.bLUN, &hmsc->cbw.CB[0]) < 0)
+      {
+        MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_FAILED);
+      }
+      break;
+
+    case USBD_BOT_SEND_DATA:
+    case USBD_BOT_LAST_DATA_IN:
+      MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_PASSED);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  * @brief  MSC_UAS_DataOut
+  *         Handle UAS command pipe and data-out pipe completions
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval None
+  */
+void MSC_UAS_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  if (hmsc == NULL)
+  {
+    return;
+  }
+
+  if (epnum == MSC_UAS_CMD_EP)
+  {
+    MSC_UAS_CommandOut(pdev);
+    return;
+  }
+
+  if ((hmsc->uas.active != USBD_UAS_NO_CMD) &&
+      (hmsc->bot_state == USBD_BOT_DATA_OUT))
+  {
+    if (SCSI_ProcessCmd(pdev, hmsc->cbw.bLUN, &hmsc->cbw.CB[0]) < 0)
+    {
+      MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_FAILED);
+    }
+  }
+}
+
+/**
+  * @brief  MSC_UAS_SendStatus
+  *         Close the active command with a Sense IU
+  * @param  pdev: device instance
+  * @param  CSW_Status : BOT status code of the command
+  * @retval None
+  */
+void MSC_UAS_SendStatus(USBD_HandleTypeDef *pdev, uint8_t CSW_Status)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  if ((hmsc == NULL) || (hmsc->uas.active == USBD_UAS_NO_CMD))
+  {
+    return;
+  }
+
+  hmsc->bot_state = USBD_BOT_IDLE;
+  hmsc->uas.sense_status = (CSW_Status == USBD_CSW_CMD_PASSED) ?
+                           USBD_UAS_STATUS_GOOD : USBD_UAS_STATUS_CHECK_CONDITION;
+  hmsc->uas.phase = USBD_UAS_PHASE_SENSE_PENDING;
+
+  if (hmsc->uas.status_busy == 0U)
+  {
+    MSC_UAS_SendSense(pdev);
+  }
+}
+
+/**
+  * @brief  MSC_UAS_CommandOut
+  *         Decode a Command or Task Management IU and queue it
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void MSC_UAS_CommandOut(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+  USBD_MSC_UAS_CmdTypeDef *cmd;
+  uint32_t size = USBD_LL_GetRxDataSize(pdev, MSC_UAS_CMD_EP);
+  uint16_t tag = ((uint16_t)huas->cmd_iu[2] << 8) | (uint16_t)huas->cmd_iu[3];
+  uint8_t overlapped = 0U;
+  uint8_t i;
+
+  huas->cmd_armed = 0U;
+
+  if ((huas->cmd_iu[0] == USBD_UAS_IU_COMMAND) && (size >= USBD_UAS_COMMAND_IU_LENGTH))
+  {
+    for (i = 0U; i < huas->count; i++)
+    {
+      cmd = UAS_SLOT(huas, i);
+      if ((cmd->state != USBD_UAS_SLOT_ABORTED) && (cmd->tag == tag))
+      {
+        overlapped = 1U;
+      }
+    }
+
+    if (overlapped != 0U)
+    {
+      MSC_UAS_SendResponse(pdev, tag, USBD_UAS_IU_RESPONSE, USBD_UAS_RC_OVERLAPPED_TAG);
+    }
+    else if (huas->cmd_iu[9] > (uint8_t)((USBD_StorageTypeDef *)pdev->pUserData_MSC)->GetMaxLun())
+    {
+      MSC_UAS_SendResponse(pdev, tag, USBD_UAS_IU_RESPONSE, USBD_UAS_RC_INCORRECT_LUN);
+    }
+    else if (huas->count == MSC_UAS_QUEUE_DEPTH)
+    {
+      /* No slot, the host retries it once one of its commands completes */
+      MSC_UAS_SendResponse(pdev, tag, USBD_UAS_IU_SENSE, USBD_UAS_STATUS_TASK_SET_FULL);
+    }
+    else
+    {
+      cmd = UAS_SLOT(huas, huas->count);
+      cmd->state = USBD_UAS_SLOT_QUEUED;
+      cmd->tag = tag;
+      cmd->lun = huas->cmd_iu[9];
+      (void)USBD_memcpy(cmd->CB, &huas->cmd_iu[16], sizeof(cmd->CB));
+      huas->count++;
+    }
+  }
+  else if ((huas->cmd_iu[0] == USBD_UAS_IU_TASK_MGMT) && (size >= USBD_UAS_TASK_MGMT_IU_LENGTH))
+  {
+    MSC_UAS_TaskManagement(pdev, tag);
+  }
+  else
+  {
+    MSC_UAS_SendResponse(pdev, tag, USBD_UAS_IU_RESPONSE, USBD_UAS_RC_INVALID_IU);
+  }
+
+  /* Keep accepting IUs while the response queue has room for their answer */
+  if (huas->resp_count < MSC_UAS_RESP_DEPTH)
+  {
+    MSC_UAS_ArmCommand(pdev);
+  }
+
+  MSC_UAS_Kick(pdev);
+}
+
+/**
+  * @brief  MSC_UAS_TaskManagement
+  *         Process a Task Management IU
+  * @param  pdev: device instance
+  * @param  tag: tag of the TMF itself
+  * @retval None
+  */
+static void MSC_UAS_TaskManagement(USBD_HandleTypeDef *pdev, uint16_t tag)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+  USBD_MSC_UAS_CmdTypeDef *cmd;
+  uint16_t task_tag = ((uint16_t)huas->cmd_iu[6] << 8) | (uint16_t)huas->cmd_iu[7];
+  uint8_t code = USBD_UAS_RC_TMF_COMPLETE;
+  uint8_t i;
+
+  switch (huas->cmd_iu[4])
+  {
+    case USBD_UAS_TMF_ABORT_TASK:
+      for (i = 0U; i < huas->count; i++)
+      {
+        cmd = UAS_SLOT(huas, i);
+        if ((cmd->tag == task_tag) && (cmd->state == USBD_UAS_SLOT_QUEUED))
+        {
+          cmd->state = USBD_UAS_SLOT_ABORTED;
+        }
+        else if ((cmd->tag == task_tag) && (cmd->state == USBD_UAS_SLOT_ACTIVE))
+        {
+          /* Data pipes already committed, let the command run to completion */
+          code = USBD_UAS_RC_TMF_FAILED;
+        }
+        else
+        {
+          /* .. */
+        }
+      }
+      break;
+
+    case USBD_UAS_TMF_ABORT_TASK_SET:
+    case USBD_UAS_TMF_CLEAR_TASK_SET:
+    case USBD_UAS_TMF_LUN_RESET:
+    case USBD_UAS_TMF_IT_NEXUS_RESET:
+      for (i = 0U; i < huas->count; i++)
+      {
+        cmd = UAS_SLOT(huas, i);
+        if (cmd->state == USBD_UAS_SLOT_QUEUED)
+        {
+          cmd->state = USBD_UAS_SLOT_ABORTED;
+        }
+      }
+      break;
+
+    case USBD_UAS_TMF_QUERY_TASK:
+      for (i = 0U; i < huas->count; i++)
+      {
+        cmd = UAS_SLOT(huas, i);
+        if ((cmd->tag == task_tag) && (cmd->state != USBD_UAS_SLOT_ABORTED))
+        {
+          code = USBD_UAS_RC_TMF_SUCCEEDED;
+        }
+      }
+      break;
+
+    default:
+      code = USBD_UAS_RC_TMF_NOT_SUPPORTED;
+      break;
+  }
+
+  MSC_UAS_SendResponse(pdev, tag, USBD_UAS_IU_RESPONSE, code);
+}
+
+/**
+  * @brief  MSC_UAS_Kick
+  *         Hand the data pipes to the oldest queued command
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void MSC_UAS_Kick(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+  USBD_MSC_UAS_CmdTypeDef *cmd;
+
+  if ((huas->active != USBD_UAS_NO_CMD) || (huas->status_busy != 0U))
+  {
+    return;
+  }
+
+  /* Drop commands aborted by a TMF while they were queued */
+  while ((huas->count != 0U) && (UAS_SLOT(huas, 0U)->state == USBD_UAS_SLOT_ABORTED))
+  {
+    UAS_SLOT(huas, 0U)->state = USBD_UAS_SLOT_FREE;
+    huas->head = (huas->head + 1U) % MSC_UAS_QUEUE_DEPTH;
+    huas->count--;
+  }
+
+  if (huas->count == 0U)
+  {
+    return;
+  }
+
+  cmd = UAS_SLOT(huas, 0U);
+  cmd->state = USBD_UAS_SLOT_ACTIVE;
+  huas->active = huas->head;
+
+  MSC_UAS_StartCmd(pdev, cmd);
+}
+
+/**
+  * @brief  MSC_UAS_StartCmd
+  *         Run a command through the SCSI layer and open its data phase
+  * @param  pdev: device instance
+  * @param  cmd: command slot
+  * @retval None
+  */
+static void MSC_UAS_StartCmd(USBD_HandleTypeDef *pdev, USBD_MSC_UAS_CmdTypeDef *cmd)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  uint8_t dir_in = 0U;
+  uint32_t length;
+
+  /* The SCSI handlers validate against the BOT wrapper: fill it from the IU */
+  hmsc->cbw.dSignature = USBD_BOT_CBW_SIGNATURE;
+  hmsc->cbw.dTag = cmd->tag;
+  hmsc->cbw.bLUN = cmd->lun;
+  hmsc->cbw.bCBLength = 16U;
+  (void)USBD_memcpy(hmsc->cbw.CB, cmd->CB, sizeof(hmsc->cbw.CB));
+
+  /* Block size of the addressed LUN, needed to size READ/WRITE transfers */
+  (void)((USBD_StorageTypeDef *)pdev->pUserData_MSC)->GetCapacity(cmd->lun, &hmsc->scsi_blk_nbr,
+                                                                  &hmsc->scsi_blk_size);
+
+  length = MSC_UAS_DataLength(hmsc, hmsc->cbw.CB, &dir_in);
+  hmsc->cbw.dDataLength = length;
+  hmsc->cbw.bmFlags = (dir_in != 0U) ? 0x80U : 0x00U;
+
+  hmsc->csw.dTag = cmd->tag;
+  hmsc->csw.dDataResidue = length;
+  hmsc->bot_state = USBD_BOT_IDLE;
+  hmsc->bot_status = USBD_BOT_STATUS_NORMAL;
+  hmsc->bot_data_length = 0U;
+
+  if (SCSI_ProcessCmd(pdev, hmsc->cbw.bLUN, &hmsc->cbw.CB[0]) < 0)
+  {
+    MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_FAILED);
+    return;
+  }
+
+  switch (hmsc->bot_state)
+  {
+    case USBD_BOT_DATA_IN:
+    case USBD_BOT_LAST_DATA_IN:
+      /* First media packet already queued on the data-in pipe */
+      MSC_UAS_SendReady(pdev, USBD_UAS_IU_READ_READY);
+      break;
+
+    case USBD_BOT_DATA_OUT:
+      /* Data-out pipe armed by the SCSI write handler */
+      MSC_UAS_SendReady(pdev, USBD_UAS_IU_WRITE_READY);
+      break;
+
+    default:
+      if (hmsc->bot_data_length > 0U)
+      {
+        hmsc->bot_state = USBD_BOT_SEND_DATA;
+        (void)USBD_LL_Transmit(pdev, MSC_IN_EP, hmsc->bot_data,
+                               MIN(hmsc->cbw.dDataLength, hmsc->bot_data_length));
+        MSC_UAS_SendReady(pdev, USBD_UAS_IU_READ_READY);
+      }
+      else
+      {
+        MSC_UAS_SendStatus(pdev, USBD_CSW_CMD_PASSED);
+      }
+      break;
+  }
+}
+
+/**
+  * @brief  MSC_UAS_CompleteCmd
+  *         Release the active command once its Sense IU is sent
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void MSC_UAS_CompleteCmd(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+
+  huas->queue[huas->active].state = USBD_UAS_SLOT_FREE;
+  huas->head = (huas->head + 1U) % MSC_UAS_QUEUE_DEPTH;
+  huas->count--;
+  huas->active = USBD_UAS_NO_CMD;
+  huas->phase = USBD_UAS_PHASE_IDLE;
+
+  if ((huas->cmd_armed == 0U) && (huas->resp_count < MSC_UAS_RESP_DEPTH))
+  {
+    MSC_UAS_ArmCommand(pdev);
+  }
+}
+
+/**
+  * @brief  MSC_UAS_SendReady
+  *         Announce the data phase of the active command
+  * @param  pdev: device instance
+  * @param  iu_id: READ READY or WRITE READY
+  * @retval None
+  */
+static void MSC_UAS_SendReady(USBD_HandleTypeDef *pdev, uint8_t iu_id)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+
+  huas->status_iu[0] = iu_id;
+  huas->status_iu[1] = 0U;
+  huas->status_iu[2] = (uint8_t)(hmsc->csw.dTag >> 8);
+  huas->status_iu[3] = (uint8_t)(hmsc->csw.dTag);
+
+  huas->phase = USBD_UAS_PHASE_DATA;
+  huas->status_busy = 1U;
+
+  (void)USBD_LL_Transmit(pdev, MSC_UAS_STATUS_EP, huas->status_iu,
+                         USBD_UAS_READY_IU_LENGTH);
+}
+
+/**
+  * @brief  MSC_UAS_SendSense
+  *         Send the Sense IU of the active command, with autosense data
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void MSC_UAS_SendSense(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+  uint8_t *pbuf = huas->status_iu;
+  uint32_t len = USBD_UAS_SENSE_IU_LENGTH;
+  uint8_t i;
+
+  for (i = 0U; i < USBD_UAS_STATUS_IU_MAX; i++)
+  {
+    pbuf[i] = 0U;
+  }
+
+  pbuf[0] = USBD_UAS_IU_SENSE;
+  pbuf[2] = (uint8_t)(hmsc->csw.dTag >> 8);
+  pbuf[3] = (uint8_t)(hmsc->csw.dTag);
+  pbuf[6] = huas->sense_status;
+
+  if (huas->sense_status != USBD_UAS_STATUS_GOOD)
+  {
+    /* Deliver the pending sense with the status, no REQUEST SENSE round trip */
+    pbuf[15] = REQUEST_SENSE_DATA_LEN;
+    pbuf[16] = 0x70U;
+    pbuf[16 + 7] = REQUEST_SENSE_DATA_LEN - 8U;
+
+    if (hmsc->scsi_sense_head != hmsc->scsi_sense_tail)
+    {
+      pbuf[16 + 2] = hmsc->scsi_sense[hmsc->scsi_sense_head].Skey;
+      pbuf[16 + 12] = hmsc->scsi_sense[hmsc->scsi_sense_head].w.b.ASC;
+      pbuf[16 + 13] = hmsc->scsi_sense[hmsc->scsi_sense_head].w.b.ASCQ;
+      hmsc->scsi_sense_head++;
+
+      if (hmsc->scsi_sense_head == SENSE_LIST_DEEPTH)
+      {
+        hmsc->scsi_sense_head = 0U;
+      }
+    }
+
+    len += REQUEST_SENSE_DATA_LEN;
+  }
+
+  huas->phase = USBD_UAS_PHASE_SENSE;
+  huas->status_busy = 1U;
+
+  (void)USBD_LL_Transmit(pdev, MSC_UAS_STATUS_EP, pbuf, len);
+}
+
+/**
+  * @brief  MSC_UAS_SendResponse
+  *         Queue a Response IU, or the Sense IU of a refused command, and send
+  *         it right away if the status pipe is free
+  * @param  pdev: device instance
+  * @param  tag: tag of the IU being answered
+  * @param  iu_id: USBD_UAS_IU_RESPONSE or USBD_UAS_IU_SENSE
+  * @param  code: response code, or SCSI status of the Sense IU
+  * @retval None
+  */
+static void MSC_UAS_SendResponse(USBD_HandleTypeDef *pdev, uint16_t tag, uint8_t iu_id, uint8_t code)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+  USBD_MSC_UAS_RespTypeDef *resp;
+
+  /* The command pipe is only armed with a free entry, one IU takes one */
+  if (huas->resp_count >= MSC_UAS_RESP_DEPTH)
+  {
+    return;
+  }
+
+  resp = &huas->resp[(huas->resp_head + huas->resp_count) % MSC_UAS_RESP_DEPTH];
+  resp->tag = tag;
+  resp->iu_id = iu_id;
+  resp->code = code;
+  huas->resp_count++;
+
+  (void)MSC_UAS_NextResponse(pdev);
+}
+
+/**
+  * @brief  MSC_UAS_NextResponse
+  *         Build the oldest queued response into resp_iu and send it, once
+  *         the status pipe is idle: the IU in flight is still read from there
+  * @param  pdev: device instance
+  * @retval 1 if a response was sent, 0 otherwise
+  */
+static uint8_t MSC_UAS_NextResponse(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+  USBD_MSC_UAS_HandleTypeDef *huas = &hmsc->uas;
+  USBD_MSC_UAS_RespTypeDef *resp;
+  uint8_t len;
+
+  if ((huas->status_busy != 0U) || (huas->resp_count == 0U))
+  {
+    return 0U;
+  }
+
+  resp = &huas->resp[huas->resp_head];
+
+  (void)USBD_memset(huas->resp_iu, 0, USBD_UAS_SENSE_IU_LENGTH);
+  huas->resp_iu[0] = resp->iu_id;
+  huas->resp_iu[2] = (uint8_t)(resp->tag >> 8);
+  huas->resp_iu[3] = (uint8_t)(resp->tag);
+
+  if (resp->iu_id == USBD_UAS_IU_SENSE)
+  {
+    /* Sense IU without sense data, the host retries the command */
+    huas->resp_iu[6] = resp->code;
+    len = USBD_UAS_SENSE_IU_LENGTH;
+  }
+  else
+  {
+    huas->resp_iu[7] = resp->code;
+    len = USBD_UAS_RESPONSE_IU_LENGTH;
+  }
+
+  huas->resp_head = (huas->resp_head + 1U) % MSC_UAS_RESP_DEPTH;
+  huas->resp_count--;
+
+  huas->status_busy = 1U;
+  (void)USBD_LL_Transmit(pdev, MSC_UAS_STATUS_EP, huas->resp_iu, len);
+
+  return 1U;
+}
+
+/**
+  * @brief  MSC_UAS_ArmCommand
+  *         Prepare the command pipe to receive the next IU
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void MSC_UAS_ArmCommand(USBD_HandleTypeDef *pdev)
+{
+  USBD_MSC_BOT_HandleTypeDef *hmsc = (USBD_MSC_BOT_HandleTypeDef *)pdev->pClassData_MSC;
+
+  hmsc->uas.cmd_armed = 1U;
+
+  (void)USBD_LL_PrepareReceive(pdev, MSC_UAS_CMD_EP, hmsc->uas.cmd_iu,
+                               USBD_UAS_COMMAND_IU_LENGTH);
+}
+
+/**
+  * @brief  MSC_UAS_DataLength
+  *         Derive the expected transfer length and direction from the CDB,
+  *         the information BOT carries in the CBW
+  * @param  hmsc: MSC handle
+  * @param  cdb: command descriptor block
+  * @param  dir_in: set to 1 for device to host transfers
+  * @retval expected transfer length in bytes
+  */
+static uint32_t MSC_UAS_DataLength(USBD_MSC_BOT_HandleTypeDef *hmsc, uint8_t *cdb, uint8_t *dir_in)
+{
+  uint32_t length;
+
+  *dir_in = 1U;
+
+  switch (cdb[0])
+  {
+    case SCSI_READ10:
+    case SCSI_WRITE10:
+      length = (((uint32_t)cdb[7] << 8) | (uint32_t)cdb[8]) * hmsc->scsi_blk_size;
+      break;
+
+    case SCSI_READ12:
+    case SCSI_WRITE12:
+      length = (((uint32_t)cdb[6] << 24) | ((uint32_t)cdb[7] << 16) |
+                ((uint32_t)cdb[8] << 8) | (uint32_t)cdb[9]) * hmsc->scsi_blk_size;
+      break;
+
+    case SCSI_INQUIRY:
+      length = ((uint32_t)cdb[3] << 8) | (uint32_t)cdb[4];
+      break;
+
+    case SCSI_REQUEST_SENSE:
+    case SCSI_MODE_SENSE6:
+      length = cdb[4];
+      break;
+
+    case SCSI_MODE_SENSE10:
+    case SCSI_READ_FORMAT_CAPACITIES:
+      length = ((uint32_t)cdb[7] << 8) | (uint32_t)cdb[8];
+      break;
+
+    case SCSI_READ_CAPACITY10:
+      length = READ_CAPACITY10_DATA_LEN;
+      break;
+
+    case SCSI_READ_CAPACITY16:
+      length = ((uint32_t)cdb[10] << 24) | ((uint32_t)cdb[11] << 16) |
+               ((uint32_t)cdb[12] << 8) | (uint32_t)cdb[13];
+      break;
+
+    default:
+      length = 0U;
+      break;
+  }
+
+  if ((cdb[0] == SCSI_WRITE10) || (cdb[0] == SCSI_WRITE12))
+  {
+    *dir_in = 0U;
+  }
+
+  return length;
+}
+#else
+void MSC_UAS_Init(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+}
+
+void MSC_UAS_DeInit(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+}
+
+void MSC_UAS_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  UNUSED(pdev);
+  UNUSED(epnum);
+}
+
+void MSC_UAS_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  UNUSED(pdev);
+  UNUSED(epnum);
+}
+
+void MSC_UAS_SendStatus(USBD_HandleTypeDef *pdev, uint8_t CSW_Status)
+{
+  UNUSED(pdev);
+  UNUSED(CSW_Status);
+}
+#endif /* MSC_UAS_ENABLED */
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
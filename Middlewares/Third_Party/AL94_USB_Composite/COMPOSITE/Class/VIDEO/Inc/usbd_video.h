@@ -50,17 +50,39 @@ extern "C" {
 #define UVC_VERSION                                   0x0110U      /* UVC 1.1 */
 #endif
 
-//#define USBD_UVC_FORMAT_UNCOMPRESSED
+/* Set to 1 to stream on a bulk endpoint of the VS interface alternate
+   setting 0 instead of an isochronous one on alternate setting 1. The
+   stream then starts on VS_COMMIT_CONTROL and stops when the host clears
+   the endpoint halt */
+#ifndef USBD_UVC_BULK
+#define USBD_UVC_BULK                                 0U
+#endif /* USBD_UVC_BULK */
 
 /* These defines shall be updated in the usbd_conf.h file */
+/* Largest resolution, also offered at half and quarter size. Three YUY2
+   images of that size must fit in the frame queue */
 #ifndef UVC_WIDTH
-#define UVC_WIDTH                                     400U
+#define UVC_WIDTH                                     320U
 #endif /* UVC_WIDTH */
 
 #ifndef UVC_HEIGHT
 #define UVC_HEIGHT                                    240U
 #endif /* UVC_HEIGHT */
 
+/* Frame rates offered at every resolution, fastest first */
+#ifndef UVC_FPS_1
+#define UVC_FPS_1                                     30U
+#endif /* UVC_FPS_1 */
+
+#ifndef UVC_FPS_2
+#define UVC_FPS_2                                     10U
+#endif /* UVC_FPS_2 */
+
+#ifndef UVC_FPS_3
+#define UVC_FPS_3                                     5U
+#endif /* UVC_FPS_3 */
+
+/* Default rate of each speed, one of the above */
 #ifndef UVC_CAM_FPS_FS
 #define UVC_CAM_FPS_FS                                10U
 #endif /* UVC_CAM_FPS_FS */
@@ -69,14 +91,6 @@ extern "C" {
 #define UVC_CAM_FPS_HS                                5U
 #endif /* UVC_CAM_FPS_HS */
 
-#ifndef UVC_PACKET_SIZE
-#define UVC_PACKET_SIZE                               512U
-#endif /* UVC_PACKET_SIZE */
-
-#ifndef UVC_MAX_FRAME_SIZE
-#define UVC_MAX_FRAME_SIZE                            (UVC_WIDTH * UVC_HEIGHT * 16U / 2U)
-#endif /* UVC_MAX_FRAME_SIZE */
-
 #ifndef UVC_COLOR_PRIMARIE
 #define UVC_COLOR_PRIMARIE                            0x01U
 #endif /* UVC_COLOR_PRIMARIE */
@@ -89,23 +103,29 @@ extern "C" {
 #define UVC_MATRIX_COEFFICIENTS                       0x04U
 #endif /* UVC_MATRIX_COEFFICIENTS */
 
-#ifndef UVC_BITS_PER_PIXEL
-#define UVC_BITS_PER_PIXEL                            12U
-#endif /* UVC_BITS_PER_PIXEL */
-
 #define UVC_GUID_YUY2                                 0x32595559U
 #define UVC_GUID_NV12                                 0x3231564EU
 
-#ifndef UVC_UNCOMPRESSED_GUID
-#define UVC_UNCOMPRESSED_GUID                         UVC_GUID_NV12
-#endif /* UVC_UNCOMPRESSED_GUID */
+/* bFormatIndex of the formats offered */
+#define UVC_FORMAT_MJPEG                              0x01U
+#define UVC_FORMAT_YUY2                               0x02U
+#define UVC_FORMAT_NV12                               0x03U
+#define UVC_NUM_FORMATS                               3U
 
-#define UVC_INTERVAL(n)                               (10000000U/(n))
+/* Frame descriptors per format and frame intervals per frame descriptor */
+#define UVC_NUM_FRAMES                                3U
+#define UVC_NUM_INTERVALS                             3U
 
-#define UVC_MIN_BIT_RATE(n)                           (UVC_WIDTH * UVC_HEIGHT * 16U * (n)) /* 16 bit */
-#define UVC_MAX_BIT_RATE(n)                           (UVC_WIDTH * UVC_HEIGHT * 16U * (n)) /* 16 bit */
+/* Image bytes of each format, JPEG is given up to 8 bits per pixel */
+#define UVC_FRAME_SIZE_MJPEG(w, h)                    ((w) * (h))
+#define UVC_FRAME_SIZE_YUY2(w, h)                     ((w) * (h) * 2U)
+#define UVC_FRAME_SIZE_NV12(w, h)                     (((w) * (h) * 3U) / 2U)
 
-#define UVC_PACKETS_IN_FRAME(n)                       (UVC_MAX_FRAME_SIZE / (n))
+#ifndef UVC_MAX_FRAME_SIZE
+#define UVC_MAX_FRAME_SIZE                            UVC_FRAME_SIZE_YUY2(UVC_WIDTH, UVC_HEIGHT)
+#endif /* UVC_MAX_FRAME_SIZE */
+
+#define UVC_INTERVAL(n)                               (10000000U/(n))
 
 #ifndef UVC_ISO_FS_MPS
 #define UVC_ISO_FS_MPS                                256U
@@ -115,19 +135,63 @@ extern "C" {
 #define UVC_ISO_HS_MPS                                512U
 #endif
 
-#ifndef UVC_HEADER_PACKET_CNT
-#define UVC_HEADER_PACKET_CNT                         0x01U
-#endif
+/* Transactions per microframe on the HS endpoint, 1 to 3. Above 1 the
+   endpoint is high bandwidth and a payload spans up to that many packets */
+#ifndef UVC_ISO_HS_TRANSACTIONS
+#define UVC_ISO_HS_TRANSACTIONS                       1U
+#endif /* UVC_ISO_HS_TRANSACTIONS */
 
+#define UVC_ISO_HS_PAYLOAD                            (UVC_ISO_HS_MPS * UVC_ISO_HS_TRANSACTIONS)
 
-#define UVC_REQ_READ_MASK                             0x80U
-#define UVC_TOTAL_IF_NUM                              0x02U
+#define UVC_BULK_FS_MPS                               64U
+#define UVC_BULK_HS_MPS                               512U
+
+/* Header and data per bulk payload, a multiple of the packet size */
+#ifndef UVC_BULK_PAYLOAD
+#define UVC_BULK_PAYLOAD                              16384U
+#endif /* UVC_BULK_PAYLOAD */
 
-#ifdef USBD_UVC_FORMAT_UNCOMPRESSED
-#define UVC_CONFIG_DESC_SIZE                           (0x88U + 0x16U)
+#if (USBD_UVC_BULK == 1U)
+#define UVC_EP_FS_MPS                                 UVC_BULK_FS_MPS
+#define UVC_EP_HS_MPS                                 UVC_BULK_HS_MPS
 #else
-#define UVC_CONFIG_DESC_SIZE                           0x88U
-#endif
+#define UVC_EP_FS_MPS                                 UVC_ISO_FS_MPS
+#define UVC_EP_HS_MPS                                 UVC_ISO_HS_MPS
+#endif /* USBD_UVC_BULK */
+
+/* Set to 0 to send the 2-byte payload header, without PTS and SCR */
+#ifndef UVC_PAYLOAD_PTS_SCR
+#define UVC_PAYLOAD_PTS_SCR                           1U
+#endif /* UVC_PAYLOAD_PTS_SCR */
+
+#if (UVC_PAYLOAD_PTS_SCR == 1U)
+#define UVC_PAYLOAD_HEADER_SIZE                       12U
+#else
+#define UVC_PAYLOAD_HEADER_SIZE                       2U
+#endif /* UVC_PAYLOAD_PTS_SCR */
+
+/* Bytes an application frame buffer keeps free in front of the image: the
+   class writes each payload header just before the data it sends */
+#define UVC_FRAME_HEADROOM                            UVC_PAYLOAD_HEADER_SIZE
+
+/* Largest payload, generated images are assembled in a buffer of that size */
+#if (USBD_UVC_BULK == 1U)
+#define UVC_MAX_PAYLOAD                               UVC_BULK_PAYLOAD
+#else
+#define UVC_MAX_PAYLOAD                               MAX(UVC_ISO_HS_PAYLOAD, UVC_ISO_FS_MPS)
+#endif /* USBD_UVC_BULK */
+
+/* Payload header bmHeaderInfo bits */
+#define UVC_HEADER_FID                                0x01U
+#define UVC_HEADER_EOF                                0x02U
+#define UVC_HEADER_PTS                                0x04U
+#define UVC_HEADER_SCR                                0x08U
+#define UVC_HEADER_ERR                                0x40U
+#define UVC_HEADER_EOH                                0x80U
+
+
+#define UVC_REQ_READ_MASK                             0x80U
+#define UVC_TOTAL_IF_NUM                              0x02U
 
 #define UVC_TOTAL_BUF_SIZE                            0x04U
 
@@ -155,31 +219,35 @@ extern "C" {
 #define VIDEO_VC_IF_HEADER_DESC_SIZE                  0x0DU
 #define VIDEO_IN_TERMINAL_DESC_SIZE                   0x08U
 #define VIDEO_OUT_TERMINAL_DESC_SIZE                  0x09U
-#define VIDEO_VS_IF_IN_HEADER_DESC_SIZE               0x0EU
+#define VIDEO_VS_IF_IN_HEADER_DESC_SIZE               (0x0DU + UVC_NUM_FORMATS)
 
 #define VS_FORMAT_UNCOMPRESSED_DESC_SIZE              0x1BU
 #define VS_FORMAT_MJPEG_DESC_SIZE                     0x0BU
-#define VS_FRAME_DESC_SIZE                            0x1EU
+#define VS_FRAME_DESC_SIZE                            (0x1AU + (4U * UVC_NUM_INTERVALS))
 #define VS_COLOR_MATCHING_DESC_SIZE                   0x06U
 
-#ifdef USBD_UVC_FORMAT_UNCOMPRESSED
-#define VS_FORMAT_DESC_SIZE                           VS_FORMAT_UNCOMPRESSED_DESC_SIZE
-#define VS_FORMAT_SUBTYPE                             VS_FORMAT_UNCOMPRESSED
-#define VS_FRAME_SUBTYPE                              VS_FRAME_UNCOMPRESSED
+/* Class-specific VC interface descriptors */
+#define VC_TERMINALS_SIZE (VIDEO_VC_IF_HEADER_DESC_SIZE + \
+                           VIDEO_IN_TERMINAL_DESC_SIZE + \
+                           VIDEO_OUT_TERMINAL_DESC_SIZE)
 
+/* Class-specific VS interface descriptors: each format is followed by its
+   frames and a color matching descriptor */
 #define VC_HEADER_SIZE (VIDEO_VS_IF_IN_HEADER_DESC_SIZE + \
-                        VS_FORMAT_UNCOMPRESSED_DESC_SIZE + \
-                        VS_FRAME_DESC_SIZE + \
-                        VS_COLOR_MATCHING_DESC_SIZE)
-#else
-#define VS_FORMAT_DESC_SIZE                           VS_FORMAT_MJPEG_DESC_SIZE
-#define VS_FORMAT_SUBTYPE                             VS_FORMAT_MJPEG
-#define VS_FRAME_SUBTYPE                              VS_FRAME_MJPEG
+                        VS_FORMAT_MJPEG_DESC_SIZE + \
+                        (2U * VS_FORMAT_UNCOMPRESSED_DESC_SIZE) + \
+                        (UVC_NUM_FORMATS * UVC_NUM_FRAMES * VS_FRAME_DESC_SIZE) + \
+                        (UVC_NUM_FORMATS * VS_COLOR_MATCHING_DESC_SIZE))
 
-#define VC_HEADER_SIZE (VIDEO_VS_IF_IN_HEADER_DESC_SIZE + \
-                        VS_FORMAT_DESC_SIZE + \
-                        VS_FRAME_DESC_SIZE)
-#endif
+/* Descriptors up to the class-specific VS ones, see USBD_VIDEO_CfgDesc */
+#define UVC_VS_HEADER_OFFSET                          0x41U
+
+#if (USBD_UVC_BULK == 1U)
+#define UVC_CONFIG_DESC_SIZE                          (UVC_VS_HEADER_OFFSET + VC_HEADER_SIZE + USB_EP_DESC_SIZE)
+#else
+#define UVC_CONFIG_DESC_SIZE                          (UVC_VS_HEADER_OFFSET + VC_HEADER_SIZE + \
+                                                       USB_IF_DESC_SIZE + USB_EP_DESC_SIZE)
+#endif /* USBD_UVC_BULK */
 
 /*
  * Video Class specification release 1.1
@@ -380,9 +448,7 @@ extern "C" {
     uint32_t dwMaxVideoFrameBufSize;
     uint32_t dwDefaultFrameInterval;
     uint8_t bFrameIntervalType;
-    uint32_t dwMinFrameInterval;
-    uint32_t dwMaxFrameInterval;
-    uint32_t dwFrameIntervalStep;
+    uint32_t dwFrameInterval[UVC_NUM_INTERVALS];
   } __PACKED USBD_VIDEO_VSFrameDescTypeDef;
 
   typedef struct
@@ -393,6 +459,29 @@ extern "C" {
     uint8_t unit;
   } USBD_VIDEO_ControlTypeDef;
 
+  /* Image handed over by the application, sent from its own buffer or,
+     when it has none, generated payload by payload */
+  typedef struct _USBD_VIDEO_Frame
+  {
+    uint8_t *data;             /* First image byte, UVC_FRAME_HEADROOM bytes before it are free */
+    uint32_t size;
+    uint32_t pts;              /* Capture time, from USBD_VIDEO_GetClock() */
+    /* With data NULL, writes len image bytes from offset to dst as each payload is armed */
+    void (*fill)(struct _USBD_VIDEO_Frame *frame, uint8_t *dst, uint32_t offset, uint32_t len);
+    void *context;             /* For fill */
+    uint8_t *payload;          /* For fill, UVC_MAX_PAYLOAD bytes word aligned the payloads are built in */
+  } USBD_VIDEO_FrameTypeDef;
+
+  /* Settings committed by the host, given with VIDEO_CMD_START */
+  typedef struct
+  {
+    uint8_t format;            /* UVC_FORMAT_MJPEG, UVC_FORMAT_YUY2 or UVC_FORMAT_NV12 */
+    uint16_t width;
+    uint16_t height;
+    uint32_t interval;         /* Frame interval in 100 ns units */
+    uint32_t max_frame_size;   /* Largest image the host accepts */
+  } USBD_VIDEO_StreamTypeDef;
+
   typedef struct
   {
     uint32_t interface;
@@ -400,14 +489,35 @@ extern "C" {
     uint8_t buffer[UVC_TOTAL_BUF_SIZE];
     VIDEO_OffsetTypeDef offset;
     USBD_VIDEO_ControlTypeDef control;
+    USBD_VIDEO_FrameTypeDef frame;   /* Image being sent, none when size is 0 */
+    uint32_t frame_offset;           /* Image bytes already sent */
+    uint32_t max_payload;            /* Header and data per (micro)frame */
+    uint8_t fid;
+    uint8_t *hdr_pos;                /* Where the header of the armed payload is written... */
+    uint8_t hdr_save[UVC_PAYLOAD_HEADER_SIZE];   /* ...and the image bytes it covers */
+    uint8_t header[UVC_PAYLOAD_HEADER_SIZE];     /* Payload without image data */
+    uint8_t *tx_buf;           /* Payload armed on the IN endpoint, sent again if the host misses it */
+    uint32_t tx_len;
+    uint32_t iso_incomplete;   /* Payloads the host missed */
+    USBD_VIDEO_StreamTypeDef stream;
+    uint32_t ep_mps;           /* Packet size of the streaming endpoint */
+    uint32_t sof_count;        /* (Micro)frames since the configuration */
+    uint32_t next_sof;         /* When the next image is due */
+    uint32_t interval_sofs;    /* Frame interval in (micro)frames */
   } USBD_VIDEO_HandleTypeDef;
 
   typedef struct
   {
     int8_t (*Init)(void);
     int8_t (*DeInit)(void);
+    /* VIDEO_CMD_START with the committed USBD_VIDEO_StreamTypeDef, VIDEO_CMD_STOP */
     int8_t (*Control)(uint8_t, uint8_t *, uint16_t);
-    int8_t (*Data)(uint8_t **, uint16_t *, uint16_t *);
+    /* Next image to send, called once the previous one is out: the class
+       gives the previous buffer back with this call. Return non-zero, or a
+       zero size, when there is none and empty payloads keep the stream up.
+       An image above the committed max_frame_size is not sent either.
+       fill and payload are NULL on entry */
+    int8_t (*Data)(USBD_VIDEO_FrameTypeDef *);
     uint8_t *pStrDesc;
   } USBD_VIDEO_ItfTypeDef;
 
@@ -448,6 +558,8 @@ extern "C" {
   */
 
   uint8_t USBD_VIDEO_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_VIDEO_ItfTypeDef *fops);
+  uint32_t USBD_VIDEO_GetClock(void);
+  uint32_t USBD_VIDEO_GetClockFrequency(void);
 
   void USBD_Update_UVC_DESC(uint8_t *desc, uint8_t vc_itf, uint8_t vs_itf, uint8_t in_ep, uint8_t str_idx);
 
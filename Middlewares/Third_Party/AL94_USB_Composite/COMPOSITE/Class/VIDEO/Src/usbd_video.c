@@ -25,11 +25,40 @@
   *             - VideoControl Requests
   *             - Video Synchronization type: Asynchronous
   *          The current  Video class version supports the following Video features:
-  *             - image JPEG format
-  *             - Asynchronous Endpoints
+  *             - MJPEG, YUY2 and NV12 formats, each at UVC_WIDTH x UVC_HEIGHT,
+  *               half and quarter size and UVC_FPS_1/2/3 frames per second
+  *             - Asynchronous isochronous endpoint, or bulk with USBD_UVC_BULK
+  *
+  *          The probe is answered with the nearest settings offered, its
+  *          dwMaxVideoFrameSize and dwMaxPayloadTransferSize follow from the
+  *          format, frame and endpoint. The commit is handed to the
+  *          application with VIDEO_CMD_START when streaming starts: on
+  *          alternate setting 1, or on the commit itself in bulk mode where
+  *          the host stops the stream by clearing the endpoint halt. A new
+  *          image is taken once per committed frame interval, counted in
+  *          SOFs.
+  *
+  *          Images are sent from the application buffers they were produced
+  *          in. Each payload header is written just before the image bytes
+  *          it precedes, over the tail of the payload already sent, and
+  *          those bytes are put back once the transfer is done. A buffer
+  *          keeps UVC_FRAME_HEADROOM free bytes in front of the image for
+  *          the first header. With UVC_ISO_HS_TRANSACTIONS above 1 a HS
+  *          payload is sent as several packets in the same microframe. The
+  *          last payload of an image carries the EOF bit and, with
+  *          UVC_PAYLOAD_PTS_SCR, every payload the PTS of the image and the
+  *          SCR sampled as it is armed.
+  *
+  *          An image may also come without a buffer: its fill callback then
+  *          writes each payload's data into the UVC_MAX_PAYLOAD buffer the
+  *          source gives with it as the payload is armed, so test patterns
+  *          or line based sources stream at any frame size without an image
+  *          in RAM, and the class holds no payload buffer of its own.
   *
   * @note     In HS mode and when the USB DMA is used, all variables and data structures
   *           dealing with the DMA during the transaction process should be 32-bit aligned.
+  *           Payload headers then land on word boundaries when the image
+  *           is word aligned and the header is 12 bytes.
   *
   *
   *  @endverbatim
@@ -58,6 +87,12 @@
 #define _UVC_VS_IF_NUM 0x01U
 #define _UVC_STR_DESC_IDX 0x00U
 
+#if defined(DWT)
+#define UVC_CLOCK_CYCCNT 1U
+#else
+#define UVC_CLOCK_CYCCNT 0U
+#endif /* DWT */
+
 uint8_t UVC_IN_EP = _UVC_IN_EP;
 uint8_t UVC_VC_IF_NUM = _UVC_VC_IF_NUM;
 uint8_t UVC_VS_IF_NUM = _UVC_VS_IF_NUM;
@@ -84,6 +119,52 @@ uint8_t UVC_STR_DESC_IDX = _UVC_STR_DESC_IDX;
   * @{
   */
 
+/* Class-specific VS Frame Descriptor of one resolution, offering the three
+   frame rates. The default interval is patched per speed */
+#define UVC_FRAME_DESC(subtype, index, w, h, size)                                 \
+  VS_FRAME_DESC_SIZE,                          /* bLength */                        \
+  CS_INTERFACE,                                /* bDescriptorType */                \
+  (subtype),                                   /* bDescriptorSubType */             \
+  (index),                                     /* bFrameIndex */                    \
+  0x02,                                        /* bmCapabilities: fixed rate */     \
+  WBVAL(w),                                    /* wWidth */                         \
+  WBVAL(h),                                    /* wHeight */                        \
+  DBVAL((size(w, h)) * 8U * UVC_FPS_3),        /* dwMinBitRate */                   \
+  DBVAL((size(w, h)) * 8U * UVC_FPS_1),        /* dwMaxBitRate */                   \
+  DBVAL(size(w, h)),                           /* dwMaxVideoFrameBufSize */         \
+  DBVAL(UVC_INTERVAL(UVC_CAM_FPS_FS)),         /* dwDefaultFrameInterval */         \
+  UVC_NUM_INTERVALS,                           /* bFrameIntervalType: discrete */   \
+  DBVAL(UVC_INTERVAL(UVC_FPS_1)),              /* dwFrameInterval(1) */             \
+  DBVAL(UVC_INTERVAL(UVC_FPS_2)),              /* dwFrameInterval(2) */             \
+  DBVAL(UVC_INTERVAL(UVC_FPS_3))               /* dwFrameInterval(3) */
+
+/* Color Matching Descriptor closing each format */
+#define UVC_COLOR_MATCHING_DESC                                                    \
+  VS_COLOR_MATCHING_DESC_SIZE,                 /* bLength */                        \
+  CS_INTERFACE,                                /* bDescriptorType: CS_INTERFACE */  \
+  VS_COLORFORMAT,                              /* bDescriptorSubType */             \
+  UVC_COLOR_PRIMARIE,                          /* bColorPrimarie: 1: BT.709, sRGB */\
+  UVC_TFR_CHARACTERISTICS,                     /* bTransferCharacteristics */       \
+  UVC_MATRIX_COEFFICIENTS                      /* bMatrixCoefficients: 4: BT.601 */
+
+/* Uncompressed format GUID {XXXXXXXX-0000-0010-8000-00AA00389B71} */
+#define UVC_GUID(fourcc)                                                           \
+  DBVAL(fourcc), 0x00, 0x00, 0x10, 0x00,                                           \
+  0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+
+/* bmFramingInfo: the FID toggles and EOF marks the last payload of an image */
+#define UVC_FRAMING_INFO                       0x03U
+
+/* SOF period in 100 ns units */
+#define UVC_SOF_PERIOD_FS                      10000U
+#define UVC_SOF_PERIOD_HS                      1250U
+
+#if (USBD_UVC_BULK == 1U)
+#define UVC_EP_TYPE                            USBD_EP_TYPE_BULK
+#else
+#define UVC_EP_TYPE                            USBD_EP_TYPE_ISOC
+#endif /* USBD_UVC_BULK */
+
 /**
   * @}
   */
@@ -96,6 +177,7 @@ uint8_t UVC_STR_DESC_IDX = _UVC_STR_DESC_IDX;
 static uint8_t USBD_VIDEO_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 static uint8_t USBD_VIDEO_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
 static uint8_t USBD_VIDEO_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+static uint8_t USBD_VIDEO_EP0_RxReady(USBD_HandleTypeDef *pdev);
 static uint8_t *USBD_VIDEO_GetFSCfgDesc(uint16_t *length);
 static uint8_t *USBD_VIDEO_GetHSCfgDesc(uint16_t *length);
 static uint8_t *USBD_VIDEO_GetOtherSpeedCfgDesc(uint16_t *length);
@@ -110,7 +192,29 @@ static void VIDEO_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
 
 static USBD_VIDEO_DescHeader_t *USBD_VIDEO_GetNextDesc(uint8_t *pbuf, uint16_t *ptr);
 static void *USBD_VIDEO_GetEpDesc(uint8_t *pConfDesc, uint8_t EpAddr);
-static void *USBD_VIDEO_GetVSFrameDesc(uint8_t *pConfDesc);
+static void USBD_VIDEO_SetFrameIntervals(uint8_t *pConfDesc, uint32_t interval);
+
+static void USBD_VIDEO_Negotiate(USBD_HandleTypeDef *pdev, USBD_VideoControlTypeDef *ctrl);
+static void USBD_VIDEO_Start(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO);
+static void USBD_VIDEO_Stop(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO);
+
+static void USBD_VIDEO_SendPayload(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO);
+static void USBD_VIDEO_Restore(USBD_VIDEO_HandleTypeDef *hVIDEO);
+static uint32_t USBD_VIDEO_Header(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO,
+                                  uint8_t *hdr, uint8_t info);
+
+#if ((UVC_ISO_HS_TRANSACTIONS < 1U) || (UVC_ISO_HS_TRANSACTIONS > 3U))
+#error "UVC_ISO_HS_TRANSACTIONS must be 1, 2 or 3"
+#endif
+
+#if (((UVC_ISO_HS_TRANSACTIONS == 2U) && (UVC_ISO_HS_MPS < 513U)) || \
+     ((UVC_ISO_HS_TRANSACTIONS == 3U) && (UVC_ISO_HS_MPS < 683U)))
+#error "UVC_ISO_HS_MPS is too small for a high bandwidth endpoint"
+#endif
+
+#if ((UVC_BULK_PAYLOAD % UVC_BULK_HS_MPS) != 0U)
+#error "UVC_BULK_PAYLOAD must be a multiple of the bulk packet size"
+#endif
 
 /**
   * @}
@@ -127,7 +231,7 @@ USBD_ClassTypeDef USBD_VIDEO =
         USBD_VIDEO_DeInit,
         USBD_VIDEO_Setup,
         NULL,
-        NULL,
+        USBD_VIDEO_EP0_RxReady,
         USBD_VIDEO_DataIn,
         NULL,
         USBD_VIDEO_SOF,
@@ -184,9 +288,8 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_CfgDesc[UVC_CONFIG_DESC_SIZE] __ALIGN_EN
         VC_HEADER,                    /* bDescriptorSubtype */
         LOBYTE(UVC_VERSION),
         HIBYTE(UVC_VERSION), /* bcdUVC: UVC1.0 or UVC1.1 revision */
-        VS_FRAME_DESC_SIZE,  /* wTotalLength: total size of class-specific descriptors */
-        0x00,
-        0x00, /* dwClockFrequency: not used. 48 Mhz value is set, but not used */
+        WBVAL(VC_TERMINALS_SIZE), /* wTotalLength: total size of class-specific descriptors */
+        0x00, /* dwClockFrequency: read by UVC 1.0 hosts only, 1.1 takes the probe value */
         0x6C,
         0xDC,
         0x02,
@@ -215,12 +318,16 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_CfgDesc[UVC_CONFIG_DESC_SIZE] __ALIGN_EN
         0x00, /* iTerminal: index of string descriptor relative to this item */
 
         /* Standard VS (Video Streaming) Interface Descriptor = interface 1, alternate setting 0 = Zero Bandwidth
-    (when no data are sent from the device) */
+    (when no data are sent from the device), or the bulk streaming interface */
         USB_IF_DESC_SIZE,        /* bLength: interface descriptor size */
         USB_DESC_TYPE_INTERFACE, /* bDescriptorType */
         _UVC_VS_IF_NUM,          /* bInterfaceNumber */
         0x00,                    /* bAlternateSetting */
+#if (USBD_UVC_BULK == 1U)
+        0x01,                    /* bNumEndpoints: the bulk endpoint */
+#else
         0x00,                    /* bNumEndpoints: no endpoints used for alternate setting 0 */
+#endif /* USBD_UVC_BULK */
         UVC_CC_VIDEO,            /* bInterfaceClass */
         SC_VIDEOSTREAMING,       /* bInterfaceSubClass */
         PC_PROTOCOL_UNDEFINED,   /* bInterfaceProtocol */
@@ -230,9 +337,8 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_CfgDesc[UVC_CONFIG_DESC_SIZE] __ALIGN_EN
         VIDEO_VS_IF_IN_HEADER_DESC_SIZE, /* bLength */
         CS_INTERFACE,                    /* bDescriptorType */
         VS_INPUT_HEADER,                 /* bDescriptorSubtype */
-        0x01,                            /* bNumFormats: 1 format descriptor is used */
-        VC_HEADER_SIZE,
-        0x00,       /* Total size of Video Control Specific Descriptors */
+        UVC_NUM_FORMATS,                 /* bNumFormats */
+        WBVAL(VC_HEADER_SIZE), /* Total size of Video Streaming Specific Descriptors */
         _UVC_IN_EP, /* bEndPointAddress: In endpoint is used for the alternate setting */
         0x00,       /* bmInfo: dynamic format change not supported */
         0x02,       /* bTerminalLink: output to terminal ID 2 */
@@ -240,59 +346,76 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_CfgDesc[UVC_CONFIG_DESC_SIZE] __ALIGN_EN
         0x00,       /* bTriggerSupport: not supported */
         0x00,       /* bTriggerUsage: not supported */
         0x01,       /* bControlSize: 1 byte field size */
-        0x00,       /* bmaControls: No specific controls used */
-
-        /* Payload Format Descriptor */
-        VS_FORMAT_DESC_SIZE, /* blength */
-        CS_INTERFACE,        /* bDescriptorType */
-        VS_FORMAT_SUBTYPE,   /* bDescriptorSubType */
-        0x01,                /* bFormatIndex */
-        0x01,                /* bNumFrameDescriptor */
-#ifdef USBD_UVC_FORMAT_UNCOMPRESSED
-        DBVAL(UVC_UNCOMPRESSED_GUID), /* Giud Format: YUY2 {32595559-0000-0010-8000-00AA00389B71} */
-        0x00, 0x00,
-        0x10, 0x00,
-        0x80, 0x00,
-        0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71,
-        UVC_BITS_PER_PIXEL, /* bBitsPerPixel : Number of bits per pixel */
-#else
+        0x00,       /* bmaControls(1): No specific controls used */
+        0x00,       /* bmaControls(2) */
+        0x00,       /* bmaControls(3) */
+
+        /* Payload Format Descriptor: MJPEG */
+        VS_FORMAT_MJPEG_DESC_SIZE, /* blength */
+        CS_INTERFACE,              /* bDescriptorType */
+        VS_FORMAT_MJPEG,           /* bDescriptorSubType */
+        UVC_FORMAT_MJPEG,          /* bFormatIndex */
+        UVC_NUM_FRAMES,            /* bNumFrameDescriptor */
         0x01, /* bmFlags: FixedSizeSamples */
-#endif
-        0x01, /* bDefaultFrameIndex: default frame used is frame 1 (only one frame used) */
+        0x01, /* bDefaultFrameIndex: full size */
         0x00, /* bAspectRatioX: not required by specification */
         0x00, /* bAspectRatioY: not required by specification */
         0x00, /* bInterlaceFlags: non interlaced stream */
         0x00, /* bCopyProtect: no protection restrictions */
 
-        /* Class-specific VS (Video Streaming) Frame Descriptor */
-        VS_FRAME_DESC_SIZE, /* bLength */
-        CS_INTERFACE,       /* bDescriptorType */
-        VS_FRAME_SUBTYPE,   /* bDescriptorSubType */
-        0x01,               /* bFrameIndex */
-#ifdef USBD_UVC_FORMAT_UNCOMPRESSED
-        0x00, /* bmCapabilities: no till image capture */
-#else
-        0x02, /* bmCapabilities: fixed frame rate supported */
-#endif
-        WBVAL(UVC_WIDTH),                        /* wWidth: Image Frame Width */
-        WBVAL(UVC_HEIGHT),                       /* wHeight: Image Frame Height */
-        DBVAL(UVC_MIN_BIT_RATE(UVC_CAM_FPS_FS)), /* dwMinBitRate: Minimum supported bit rate in bits/s  */
-        DBVAL(UVC_MAX_BIT_RATE(UVC_CAM_FPS_FS)), /* dwMaxBitRate: Maximum supported bit rate in bits/s  */
-        DBVAL(UVC_MAX_FRAME_SIZE),               /* dwMaxVideoFrameBufSize: Maximum video frame size, in bytes */
-        DBVAL(UVC_INTERVAL(UVC_CAM_FPS_FS)),     /* dwDefaultFrameInterval: following number of FPS */
-        0x01,                                    /* bFrameIntervalType: Discrete frame interval type */
-        DBVAL(UVC_INTERVAL(UVC_CAM_FPS_FS)),     /* dwMinFrameInterval: One supported value of interval (FPS) */
-
-#ifdef USBD_UVC_FORMAT_UNCOMPRESSED
-        /* Color Matching Descriptor */
-        VS_COLOR_MATCHING_DESC_SIZE, /* bLength */
-        CS_INTERFACE,                /* bDescriptorType: CS_INTERFACE */
-        VS_COLORFORMAT,              /* bDescriptorSubType: VS_COLORFORMAT */
-        UVC_COLOR_PRIMARIE,          /* bColorPrimarie: 1: BT.709, sRGB (default) */
-        UVC_TFR_CHARACTERISTICS,     /* bTransferCharacteristics: 1: BT.709 (default) */
-        UVC_MATRIX_COEFFICIENTS,     /* bMatrixCoefficients: 4: BT.601, (default) */
-#endif
+        UVC_FRAME_DESC(VS_FRAME_MJPEG, 1U, UVC_WIDTH, UVC_HEIGHT, UVC_FRAME_SIZE_MJPEG),
+        UVC_FRAME_DESC(VS_FRAME_MJPEG, 2U, UVC_WIDTH / 2U, UVC_HEIGHT / 2U, UVC_FRAME_SIZE_MJPEG),
+        UVC_FRAME_DESC(VS_FRAME_MJPEG, 3U, UVC_WIDTH / 4U, UVC_HEIGHT / 4U, UVC_FRAME_SIZE_MJPEG),
+        UVC_COLOR_MATCHING_DESC,
+
+        /* Payload Format Descriptor: YUY2 */
+        VS_FORMAT_UNCOMPRESSED_DESC_SIZE, /* blength */
+        CS_INTERFACE,                     /* bDescriptorType */
+        VS_FORMAT_UNCOMPRESSED,           /* bDescriptorSubType */
+        UVC_FORMAT_YUY2,                  /* bFormatIndex */
+        UVC_NUM_FRAMES,                   /* bNumFrameDescriptor */
+        UVC_GUID(UVC_GUID_YUY2), /* Giud Format: YUY2 {32595559-0000-0010-8000-00AA00389B71} */
+        16U,  /* bBitsPerPixel : Number of bits per pixel */
+        0x01, /* bDefaultFrameIndex: full size */
+        0x00, /* bAspectRatioX: not required by specification */
+        0x00, /* bAspectRatioY: not required by specification */
+        0x00, /* bInterlaceFlags: non interlaced stream */
+        0x00, /* bCopyProtect: no protection restrictions */
 
+        UVC_FRAME_DESC(VS_FRAME_UNCOMPRESSED, 1U, UVC_WIDTH, UVC_HEIGHT, UVC_FRAME_SIZE_YUY2),
+        UVC_FRAME_DESC(VS_FRAME_UNCOMPRESSED, 2U, UVC_WIDTH / 2U, UVC_HEIGHT / 2U, UVC_FRAME_SIZE_YUY2),
+        UVC_FRAME_DESC(VS_FRAME_UNCOMPRESSED, 3U, UVC_WIDTH / 4U, UVC_HEIGHT / 4U, UVC_FRAME_SIZE_YUY2),
+        UVC_COLOR_MATCHING_DESC,
+
+        /* Payload Format Descriptor: NV12 */
+        VS_FORMAT_UNCOMPRESSED_DESC_SIZE, /* blength */
+        CS_INTERFACE,                     /* bDescriptorType */
+        VS_FORMAT_UNCOMPRESSED,           /* bDescriptorSubType */
+        UVC_FORMAT_NV12,                  /* bFormatIndex */
+        UVC_NUM_FRAMES,                   /* bNumFrameDescriptor */
+        UVC_GUID(UVC_GUID_NV12), /* Giud Format: NV12 {3231564E-0000-0010-8000-00AA00389B71} */
+        12U,  /* bBitsPerPixel : Number of bits per pixel */
+        0x01, /* bDefaultFrameIndex: full size */
+        0x00, /* bAspectRatioX: not required by specification */
+        0x00, /* bAspectRatioY: not required by specification */
+        0x00, /* bInterlaceFlags: non interlaced stream */
+        0x00, /* bCopyProtect: no protection restrictions */
+
+        UVC_FRAME_DESC(VS_FRAME_UNCOMPRESSED, 1U, UVC_WIDTH, UVC_HEIGHT, UVC_FRAME_SIZE_NV12),
+        UVC_FRAME_DESC(VS_FRAME_UNCOMPRESSED, 2U, UVC_WIDTH / 2U, UVC_HEIGHT / 2U, UVC_FRAME_SIZE_NV12),
+        UVC_FRAME_DESC(VS_FRAME_UNCOMPRESSED, 3U, UVC_WIDTH / 4U, UVC_HEIGHT / 4U, UVC_FRAME_SIZE_NV12),
+        UVC_COLOR_MATCHING_DESC,
+
+#if (USBD_UVC_BULK == 1U)
+        /* Standard VS (Video Streaming) data Endpoint */
+        USB_EP_DESC_SIZE,        /* bLength */
+        USB_DESC_TYPE_ENDPOINT,  /* bDescriptorType */
+        _UVC_IN_EP,              /* bEndpointAddress */
+        0x02,                    /* bmAttributes: bulk transfer */
+        LOBYTE(UVC_BULK_FS_MPS), /* wMaxPacketSize */
+        HIBYTE(UVC_BULK_FS_MPS),
+        0x00, /* bInterval: ignored for bulk */
+#else
         /* Standard VS Interface Descriptor  = interface 1, alternate setting 1 = data transfer mode  */
         USB_IF_DESC_SIZE,        /* bLength */
         USB_DESC_TYPE_INTERFACE, /* bDescriptorType */
@@ -312,6 +435,7 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_CfgDesc[UVC_CONFIG_DESC_SIZE] __ALIGN_EN
         LOBYTE(UVC_ISO_FS_MPS), /* wMaxPacketSize */
         HIBYTE(UVC_ISO_FS_MPS),
         0x01, /* bInterval: 1 frame interval */
+#endif /* USBD_UVC_BULK */
 };
 
 /* USB Standard Device Descriptor */
@@ -329,6 +453,14 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIE
         0x00,
 };
 
+/* Frame intervals of every frame descriptor, in 100 ns units */
+static const uint32_t USBD_VIDEO_Intervals[UVC_NUM_INTERVALS] =
+    {
+        UVC_INTERVAL(UVC_FPS_1),
+        UVC_INTERVAL(UVC_FPS_2),
+        UVC_INTERVAL(UVC_FPS_3),
+};
+
 /* Video Commit data structure */
 static USBD_VideoControlTypeDef video_Commit_Control =
     {
@@ -403,20 +535,33 @@ static uint8_t USBD_VIDEO_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   pdev->pClassData_UVC = (void *)hVIDEO;
 
   /* Open EP IN */
-  if (pdev->dev_speed == USBD_SPEED_HIGH)
-  {
-    (void)USBD_LL_OpenEP(pdev, UVC_IN_EP, USBD_EP_TYPE_ISOC, UVC_ISO_HS_MPS);
-
-    pdev->ep_in[UVC_IN_EP & 0xFU].is_used = 1U;
-    pdev->ep_in[UVC_IN_EP & 0xFU].maxpacket = UVC_ISO_HS_MPS;
-  }
-  else
-  {
-    (void)USBD_LL_OpenEP(pdev, UVC_IN_EP, USBD_EP_TYPE_ISOC, UVC_ISO_FS_MPS);
-
-    pdev->ep_in[UVC_IN_EP & 0xFU].is_used = 1U;
-    pdev->ep_in[UVC_IN_EP & 0xFU].maxpacket = UVC_ISO_FS_MPS;
-  }
+  hVIDEO->ep_mps = (pdev->dev_speed == USBD_SPEED_HIGH) ? UVC_EP_HS_MPS : UVC_EP_FS_MPS;
+
+  (void)USBD_LL_OpenEP(pdev, UVC_IN_EP, UVC_EP_TYPE, (uint16_t)hVIDEO->ep_mps);
+
+  pdev->ep_in[UVC_IN_EP & 0xFU].is_used = 1U;
+  pdev->ep_in[UVC_IN_EP & 0xFU].maxpacket = hVIDEO->ep_mps;
+
+  /* Settings until the host negotiates its own */
+  video_Commit_Control.bFormatIndex = UVC_FORMAT_MJPEG;
+  video_Commit_Control.bFrameIndex = 1U;
+  video_Commit_Control.dwFrameInterval = 0U;
+  USBD_VIDEO_Negotiate(pdev, &video_Commit_Control);
+  video_Probe_Control = video_Commit_Control;
+  hVIDEO->max_payload = video_Commit_Control.dwMaxPayloadTransferSize;
+  hVIDEO->sof_count = 0U;
+
+#if (UVC_CLOCK_CYCCNT == 1U)
+  /* Source clock of the PTS and SCR fields */
+  USBD_LL_StartCycleCounter();
+#endif /* UVC_CLOCK_CYCCNT */
+
+  /* No image on the way */
+  hVIDEO->uvc_state = UVC_PLAY_STATUS_STOP;
+  hVIDEO->control.cmd = 0U;
+  hVIDEO->frame.size = 0U;
+  hVIDEO->hdr_pos = NULL;
+  hVIDEO->tx_buf = NULL;
 
   /* Init  physical Interface components */
   ((USBD_VIDEO_ItfTypeDef *)pdev->pUserData_UVC)->Init();
@@ -453,6 +598,9 @@ static uint8_t USBD_VIDEO_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   (void)USBD_LL_CloseEP(pdev, UVC_IN_EP);
   pdev->ep_in[UVC_IN_EP & 0xFU].is_used = 0U;
 
+  /* Give the image being sent its bytes back */
+  USBD_VIDEO_Restore((USBD_VIDEO_HandleTypeDef *)pdev->pClassData_UVC);
+
   /* DeInit  physical Interface components */
   ((USBD_VIDEO_ItfTypeDef *)pdev->pUserData_UVC)->DeInit();
 #if (0)
@@ -550,15 +698,13 @@ static uint8_t USBD_VIDEO_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *
           hVIDEO->interface = LOBYTE(req->wValue);
           if (hVIDEO->interface == 1U)
           {
-            /* Start Streaming (First endpoint writing will be done on next SOF) */
-            (void)USBD_LL_FlushEP(pdev, UVC_IN_EP);
-            hVIDEO->uvc_state = UVC_PLAY_STATUS_READY;
+            /* Start Streaming with the committed settings */
+            USBD_VIDEO_Start(pdev, hVIDEO);
           }
           else
           {
             /* Stop Streaming */
-            hVIDEO->uvc_state = UVC_PLAY_STATUS_STOP;
-            (void)USBD_LL_FlushEP(pdev, UVC_IN_EP);
+            USBD_VIDEO_Stop(pdev, hVIDEO);
           }
         }
         else
@@ -576,6 +722,15 @@ static uint8_t USBD_VIDEO_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *
       break;
 
     case USB_REQ_CLEAR_FEATURE:
+#if (USBD_UVC_BULK == 1U)
+      /* The halt of the bulk endpoint is cleared to stop the stream, the
+         core has already answered */
+      if (((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT) &&
+          (req->wValue == USB_FEATURE_EP_HALT) && (LOBYTE(req->wIndex) == UVC_IN_EP))
+      {
+        USBD_VIDEO_Stop(pdev, hVIDEO);
+      }
+#endif /* USBD_UVC_BULK */
       break;
 
     default:
@@ -595,74 +750,62 @@ static uint8_t USBD_VIDEO_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *
 }
 
 /**
-  * @brief  USBD_VIDEO_DataIn
-  *         handle data IN Stage
+  * @brief  USBD_VIDEO_EP0_RxReady
+  *         handle EP0 Rx Ready event
   * @param  pdev: device instance
-  * @param  epnum: endpoint index
   * @retval status
   */
-static uint8_t USBD_VIDEO_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+static uint8_t USBD_VIDEO_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
   USBD_VIDEO_HandleTypeDef *hVIDEO = (USBD_VIDEO_HandleTypeDef *)pdev->pClassData_UVC;
-  static uint8_t packet[UVC_PACKET_SIZE + (UVC_HEADER_PACKET_CNT * 2U)] = {0x00U};
-  static uint8_t *Pcktdata = packet;
-  static uint16_t PcktIdx = 0U;
-  static uint16_t PcktSze = UVC_PACKET_SIZE;
-  static uint8_t payload_header[2] = {0x02U, 0x00U};
-  uint8_t i = 0U;
-  uint32_t RemainData, DataOffset = 0U;
 
-  /* Check if the Streaming has already been started */
-  if (hVIDEO->uvc_state == UVC_PLAY_STATUS_STREAMING)
+  if (hVIDEO == NULL)
   {
-    /* Get the current packet buffer, index and size from the application layer */
-    ((USBD_VIDEO_ItfTypeDef *)pdev->pUserData_UVC)->Data(&Pcktdata, &PcktSze, &PcktIdx);
+    return (uint8_t)USBD_FAIL;
+  }
 
-    /* Check if end of current image has been reached */
-    if (PcktSze > 2U)
+  if (hVIDEO->control.cmd == UVC_SET_CUR)
+  {
+    if (hVIDEO->control.unit == HIBYTE(VS_PROBE_CONTROL))
     {
-      /* Check if this is the first packet in current image */
-      if (PcktIdx == 0U)
-      {
-        /* Set the packet start index */
-        payload_header[1] ^= 0x01U;
-      }
+      /* Answer the host proposal with the nearest settings offered */
+      USBD_VIDEO_Negotiate(pdev, &video_Probe_Control);
+    }
+    else if (hVIDEO->control.unit == HIBYTE(VS_COMMIT_CONTROL))
+    {
+      USBD_VIDEO_Negotiate(pdev, &video_Commit_Control);
 
-      RemainData = PcktSze;
+#if (USBD_UVC_BULK == 1U)
+      /* There is no alternate setting to select: the commit starts the stream */
+      USBD_VIDEO_Start(pdev, hVIDEO);
+#endif /* USBD_UVC_BULK */
+    }
 
-      /* fill the Transmit buffer */
-      while (RemainData > 0U)
-      {
-        packet[((DataOffset + 0U) * i)] = payload_header[0];
-        packet[((DataOffset + 0U) * i) + 1U] = payload_header[1];
-        if (RemainData > pdev->ep_in[UVC_IN_EP & 0xFU].maxpacket)
-        {
-          DataOffset = pdev->ep_in[UVC_IN_EP & 0xFU].maxpacket;
-          (void)USBD_memcpy((packet + ((DataOffset + 0U) * i) + 2U),
-                            Pcktdata + ((DataOffset - 2U) * i), (DataOffset - 2U));
+    hVIDEO->control.cmd = 0U;
+    hVIDEO->control.len = 0U;
+    hVIDEO->control.unit = 0U;
+  }
 
-          RemainData -= DataOffset;
-          i++;
-        }
-        else
-        {
-          (void)USBD_memcpy((packet + ((DataOffset + 0U) * i) + 2U),
-                            Pcktdata + ((DataOffset - 2U) * i), (RemainData - 2U));
+  return (uint8_t)USBD_OK;
+}
 
-          RemainData = 0U;
-        }
-      }
-    }
-    else
-    {
-      /* Add the packet header */
-      packet[0] = payload_header[0];
-      packet[1] = payload_header[1];
-    }
+/**
+  * @brief  USBD_VIDEO_DataIn
+  *         handle data IN Stage
+  * @param  pdev: device instance
+  * @param  epnum: endpoint index
+  * @retval status
+  */
+static uint8_t USBD_VIDEO_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_VIDEO_HandleTypeDef *hVIDEO = (USBD_VIDEO_HandleTypeDef *)pdev->pClassData_UVC;
 
-    /* Transmit the packet on Endpoint */
-    (void)USBD_LL_Transmit(pdev, (uint8_t)(epnum | 0x80U),
-                           (uint8_t *)&packet, (uint32_t)PcktSze);
+  UNUSED(epnum);
+
+  /* Check if the Streaming has already been started */
+  if (hVIDEO->uvc_state == UVC_PLAY_STATUS_STREAMING)
+  {
+    USBD_VIDEO_SendPayload(pdev, hVIDEO);
   }
 
   /* Exit with no error code */
@@ -678,16 +821,21 @@ static uint8_t USBD_VIDEO_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t USBD_VIDEO_SOF(USBD_HandleTypeDef *pdev)
 {
   USBD_VIDEO_HandleTypeDef *hVIDEO = (USBD_VIDEO_HandleTypeDef *)pdev->pClassData_UVC;
-  uint8_t payload[2] = {0x02U, 0x00U};
 
-  /* Check if the Streaming has already been started by SetInterface AltSetting 1 */
+  /* Paces the images */
+  hVIDEO->sof_count++;
+
+  /* Check if the Streaming has already been started by SetInterface AltSetting 1,
+     or a bulk stream waits for its next image */
   if (hVIDEO->uvc_state == UVC_PLAY_STATUS_READY)
   {
-    /* Transmit the first packet indicating that Streaming is starting */
-    (void)USBD_LL_Transmit(pdev, UVC_IN_EP, (uint8_t *)payload, 2U);
-
     /* Enable Streaming state */
     hVIDEO->uvc_state = UVC_PLAY_STATUS_STREAMING;
+
+    /* Transmit the first payload, the following ones are armed as each
+       one completes */
+    hVIDEO->frame.size = 0U;
+    USBD_VIDEO_SendPayload(pdev, hVIDEO);
   }
 
   /* Exit with no error code */
@@ -703,8 +851,22 @@ static uint8_t USBD_VIDEO_SOF(USBD_HandleTypeDef *pdev)
   */
 static uint8_t USBD_VIDEO_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  UNUSED(pdev);
-  UNUSED(epnum);
+  USBD_VIDEO_HandleTypeDef *hVIDEO = (USBD_VIDEO_HandleTypeDef *)pdev->pClassData_UVC;
+
+  if ((hVIDEO == NULL) || (epnum != (UVC_IN_EP & 0x7FU)) ||
+      (hVIDEO->uvc_state != UVC_PLAY_STATUS_STREAMING) || (hVIDEO->tx_buf == NULL))
+  {
+    return (uint8_t)USBD_OK;
+  }
+
+  /* The host did not read the payload armed for the last frame and the
+     driver has disabled the endpoint. Its header is still in place in
+     front of the image bytes: send the same payload again, with the same
+     frame ID, so the image reaches the host whole. The driver picks the
+     odd/even frame from the current frame number */
+  hVIDEO->iso_incomplete++;
+  (void)USBD_LL_FlushEP(pdev, UVC_IN_EP);
+  (void)USBD_LL_Transmit(pdev, UVC_IN_EP, hVIDEO->tx_buf, hVIDEO->tx_len);
 
   return (uint8_t)USBD_OK;
 }
@@ -719,6 +881,8 @@ static uint8_t USBD_VIDEO_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnu
 static void VIDEO_REQ_GetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
 {
   USBD_VIDEO_HandleTypeDef *hVIDEO;
+  USBD_VideoControlTypeDef *pctrl;
+  uint32_t i;
   hVIDEO = (USBD_VIDEO_HandleTypeDef *)(pdev->pClassData_UVC);
   static __IO uint8_t EntityStatus[8] = {0};
 
@@ -745,46 +909,46 @@ static void VIDEO_REQ_GetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
   /* Manage Video Streaming interface requests */
   else
   {
-    if (LOBYTE(req->wValue) == (uint8_t)VS_PROBE_CONTROL)
+    /* The control selector is the high byte */
+    if ((req->wValue == VS_PROBE_CONTROL) || (req->wValue == VS_COMMIT_CONTROL))
     {
-      /* Update bPreferedVersion, bMinVersion and bMaxVersion which must be set only by Device */
-      video_Probe_Control.bPreferedVersion = 0x00U;
-      video_Probe_Control.bMinVersion = 0x00U;
-      video_Probe_Control.bMaxVersion = 0x00U;
-      video_Probe_Control.dwMaxVideoFrameSize = UVC_MAX_FRAME_SIZE;
-
-      video_Probe_Control.dwClockFrequency = 0x02DC6C00U;
-
-      if (pdev->dev_speed == USBD_SPEED_HIGH)
+      if (req->bRequest == UVC_GET_CUR)
       {
-        video_Probe_Control.dwFrameInterval = (UVC_INTERVAL(UVC_CAM_FPS_HS));
-        video_Probe_Control.dwMaxPayloadTransferSize = UVC_ISO_HS_MPS;
+        (void)USBD_memcpy(hVIDEO->control.data,
+                          (req->wValue == VS_PROBE_CONTROL) ? &video_Probe_Control : &video_Commit_Control,
+                          sizeof(USBD_VideoControlTypeDef));
       }
       else
       {
-        video_Probe_Control.dwFrameInterval = (UVC_INTERVAL(UVC_CAM_FPS_FS));
-        video_Probe_Control.dwMaxPayloadTransferSize = UVC_ISO_FS_MPS;
-      }
+        /* GET_DEF: the first frame at the default rate, GET_MIN and GET_MAX
+           at the fastest and slowest rate offered */
+        pctrl = (USBD_VideoControlTypeDef *)(void *)hVIDEO->control.data;
+        (void)USBD_memset(pctrl, 0, sizeof(USBD_VideoControlTypeDef));
+        pctrl->bFormatIndex = UVC_FORMAT_MJPEG;
+        pctrl->bFrameIndex = 1U;
+        pctrl->dwFrameInterval = 0U;
+
+        for (i = 0U; i < UVC_NUM_INTERVALS; i++)
+        {
+          if ((req->bRequest == UVC_GET_MIN) &&
+              ((pctrl->dwFrameInterval == 0U) || (USBD_VIDEO_Intervals[i] < pctrl->dwFrameInterval)))
+          {
+            pctrl->dwFrameInterval = USBD_VIDEO_Intervals[i];
+          }
+          else if ((req->bRequest == UVC_GET_MAX) && (USBD_VIDEO_Intervals[i] > pctrl->dwFrameInterval))
+          {
+            pctrl->dwFrameInterval = USBD_VIDEO_Intervals[i];
+          }
+          else
+          {
+            /* GET_DEF keeps no preference */
+          }
+        }
 
-      /* Probe Request */
-      (void)USBD_CtlSendData(pdev, (uint8_t *)&video_Probe_Control,
-                             MIN(req->wLength, sizeof(USBD_VideoControlTypeDef)));
-    }
-    else if (LOBYTE(req->wValue) == (uint8_t)VS_COMMIT_CONTROL)
-    {
-      if (pdev->dev_speed == USBD_SPEED_HIGH)
-      {
-        video_Commit_Control.dwFrameInterval = (UVC_INTERVAL(UVC_CAM_FPS_HS));
-        video_Commit_Control.dwMaxPayloadTransferSize = UVC_ISO_HS_MPS;
-      }
-      else
-      {
-        video_Commit_Control.dwFrameInterval = (UVC_INTERVAL(UVC_CAM_FPS_FS));
-        video_Commit_Control.dwMaxPayloadTransferSize = UVC_ISO_FS_MPS;
+        USBD_VIDEO_Negotiate(pdev, pctrl);
       }
 
-      /* Commit Request */
-      (void)USBD_CtlSendData(pdev, (uint8_t *)&video_Commit_Control,
+      (void)USBD_CtlSendData(pdev, hVIDEO->control.data,
                              MIN(req->wLength, sizeof(USBD_VideoControlTypeDef)));
     }
     else
@@ -811,15 +975,19 @@ static void VIDEO_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
   if (req->wLength > 0U)
   {
     /* Prepare the reception of the buffer over EP0 */
-    if (LOBYTE(req->wValue) == (uint8_t)VS_PROBE_CONTROL)
+    if ((LOBYTE(req->wIndex) == UVC_VS_IF_NUM) && (req->wValue == VS_PROBE_CONTROL))
     {
-      /* Probe Request */
+      /* Probe Request, negotiated once received */
+      hVIDEO->control.cmd = UVC_SET_CUR;
+      hVIDEO->control.unit = HIBYTE(VS_PROBE_CONTROL);
       (void)USBD_CtlPrepareRx(pdev, (uint8_t *)&video_Probe_Control,
                               MIN(req->wLength, sizeof(USBD_VideoControlTypeDef)));
     }
-    else if (LOBYTE(req->wValue) == (uint8_t)VS_COMMIT_CONTROL)
+    else if ((LOBYTE(req->wIndex) == UVC_VS_IF_NUM) && (req->wValue == VS_COMMIT_CONTROL))
     {
-      /* Commit Request */
+      /* Commit Request, applied once received */
+      hVIDEO->control.cmd = UVC_SET_CUR;
+      hVIDEO->control.unit = HIBYTE(VS_COMMIT_CONTROL);
       (void)USBD_CtlPrepareRx(pdev, (uint8_t *)&video_Commit_Control,
                               MIN(req->wLength, sizeof(USBD_VideoControlTypeDef)));
     }
@@ -841,20 +1009,13 @@ static void VIDEO_REQ_SetCurrent(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef
 static uint8_t *USBD_VIDEO_GetFSCfgDesc(uint16_t *length)
 {
   USBD_EpDescTypedef *pEpDesc = USBD_VIDEO_GetEpDesc(USBD_VIDEO_CfgDesc, UVC_IN_EP);
-  USBD_VIDEO_VSFrameDescTypeDef *pVSFrameDesc = USBD_VIDEO_GetVSFrameDesc(USBD_VIDEO_CfgDesc);
 
   if (pEpDesc != NULL)
   {
-    pEpDesc->wMaxPacketSize = UVC_ISO_FS_MPS;
+    pEpDesc->wMaxPacketSize = UVC_EP_FS_MPS;
   }
 
-  if (pVSFrameDesc != NULL)
-  {
-    pVSFrameDesc->dwMinBitRate = UVC_MIN_BIT_RATE(UVC_CAM_FPS_FS);
-    pVSFrameDesc->dwMaxBitRate = UVC_MAX_BIT_RATE(UVC_CAM_FPS_FS);
-    pVSFrameDesc->dwDefaultFrameInterval = UVC_INTERVAL(UVC_CAM_FPS_FS);
-    pVSFrameDesc->dwMinFrameInterval = UVC_INTERVAL(UVC_CAM_FPS_FS);
-  }
+  USBD_VIDEO_SetFrameIntervals(USBD_VIDEO_CfgDesc, UVC_INTERVAL(UVC_CAM_FPS_FS));
 
   *length = (uint16_t)(sizeof(USBD_VIDEO_CfgDesc));
   return USBD_VIDEO_CfgDesc;
@@ -869,20 +1030,18 @@ static uint8_t *USBD_VIDEO_GetFSCfgDesc(uint16_t *length)
 static uint8_t *USBD_VIDEO_GetHSCfgDesc(uint16_t *length)
 {
   USBD_EpDescTypedef *pEpDesc = USBD_VIDEO_GetEpDesc(USBD_VIDEO_CfgDesc, UVC_IN_EP);
-  USBD_VIDEO_VSFrameDescTypeDef *pVSFrameDesc = USBD_VIDEO_GetVSFrameDesc(USBD_VIDEO_CfgDesc);
 
   if (pEpDesc != NULL)
   {
-    pEpDesc->wMaxPacketSize = UVC_ISO_HS_MPS;
+#if (USBD_UVC_BULK == 1U)
+    pEpDesc->wMaxPacketSize = UVC_BULK_HS_MPS;
+#else
+    /* Bits 12..11: additional transactions per microframe */
+    pEpDesc->wMaxPacketSize = UVC_ISO_HS_MPS | ((UVC_ISO_HS_TRANSACTIONS - 1U) << 11);
+#endif /* USBD_UVC_BULK */
   }
 
-  if (pVSFrameDesc != NULL)
-  {
-    pVSFrameDesc->dwMinBitRate = UVC_MIN_BIT_RATE(UVC_CAM_FPS_HS);
-    pVSFrameDesc->dwMaxBitRate = UVC_MAX_BIT_RATE(UVC_CAM_FPS_HS);
-    pVSFrameDesc->dwDefaultFrameInterval = UVC_INTERVAL(UVC_CAM_FPS_HS);
-    pVSFrameDesc->dwMinFrameInterval = UVC_INTERVAL(UVC_CAM_FPS_HS);
-  }
+  USBD_VIDEO_SetFrameIntervals(USBD_VIDEO_CfgDesc, UVC_INTERVAL(UVC_CAM_FPS_HS));
 
   *length = (uint16_t)(sizeof(USBD_VIDEO_CfgDesc));
   return USBD_VIDEO_CfgDesc;
@@ -896,24 +1055,7 @@ static uint8_t *USBD_VIDEO_GetHSCfgDesc(uint16_t *length)
   */
 static uint8_t *USBD_VIDEO_GetOtherSpeedCfgDesc(uint16_t *length)
 {
-  USBD_EpDescTypedef *pEpDesc = USBD_VIDEO_GetEpDesc(USBD_VIDEO_CfgDesc, UVC_IN_EP);
-  USBD_VIDEO_VSFrameDescTypeDef *pVSFrameDesc = USBD_VIDEO_GetVSFrameDesc(USBD_VIDEO_CfgDesc);
-
-  if (pEpDesc != NULL)
-  {
-    pEpDesc->wMaxPacketSize = UVC_ISO_FS_MPS;
-  }
-
-  if (pVSFrameDesc != NULL)
-  {
-    pVSFrameDesc->dwMinBitRate = UVC_MIN_BIT_RATE(UVC_CAM_FPS_FS);
-    pVSFrameDesc->dwMaxBitRate = UVC_MAX_BIT_RATE(UVC_CAM_FPS_FS);
-    pVSFrameDesc->dwDefaultFrameInterval = UVC_INTERVAL(UVC_CAM_FPS_FS);
-    pVSFrameDesc->dwMinFrameInterval = UVC_INTERVAL(UVC_CAM_FPS_FS);
-  }
-
-  *length = (uint16_t)(sizeof(USBD_VIDEO_CfgDesc));
-  return USBD_VIDEO_CfgDesc;
+  return USBD_VIDEO_GetFSCfgDesc(length);
 }
 
 /**
@@ -946,17 +1088,17 @@ static USBD_VIDEO_DescHeader_t *USBD_VIDEO_GetNextDesc(uint8_t *pbuf, uint16_t *
 }
 
 /**
-  * @brief  USBD_VIDEO_GetVSFrameDesc
-  *         This function return the Video Endpoint descriptor
-  * @param  pdev: device instance
-  * @param  pConfDesc:  pointer to Bos descriptor
-  * @retval pointer to video endpoint descriptor
+  * @brief  USBD_VIDEO_SetFrameIntervals
+  *         Set the default interval of every frame descriptor
+  * @param  pConfDesc: pointer to the configuration descriptor
+  * @param  interval: frame interval in 100 ns units
+  * @retval None
   */
-static void *USBD_VIDEO_GetVSFrameDesc(uint8_t *pConfDesc)
+static void USBD_VIDEO_SetFrameIntervals(uint8_t *pConfDesc, uint32_t interval)
 {
   USBD_VIDEO_DescHeader_t *pdesc = (USBD_VIDEO_DescHeader_t *)(void *)pConfDesc;
   USBD_ConfigDescTypedef *desc = (USBD_ConfigDescTypedef *)(void *)pConfDesc;
-  USBD_VIDEO_VSFrameDescTypeDef *pVSFrameDesc = NULL;
+  USBD_VIDEO_VSFrameDescTypeDef *pVSFrameDesc;
   uint16_t ptr;
 
   if (desc->wTotalLength > desc->bLength)
@@ -967,17 +1109,16 @@ static void *USBD_VIDEO_GetVSFrameDesc(uint8_t *pConfDesc)
     {
       pdesc = USBD_VIDEO_GetNextDesc((uint8_t *)pdesc, &ptr);
 
-      if (((pdesc->bDescriptorSubType == VS_FRAME_MJPEG) ||
+      if ((pdesc->bDescriptorType == CS_INTERFACE) &&
+          ((pdesc->bDescriptorSubType == VS_FRAME_MJPEG) ||
            (pdesc->bDescriptorSubType == VS_FRAME_UNCOMPRESSED)) &&
           (pdesc->bLength == VS_FRAME_DESC_SIZE))
       {
         pVSFrameDesc = (USBD_VIDEO_VSFrameDescTypeDef *)(void *)pdesc;
-        break;
+        pVSFrameDesc->dwDefaultFrameInterval = interval;
       }
     }
   }
-
-  return (void *)pVSFrameDesc;
 }
 
 /**
@@ -1022,6 +1163,361 @@ static void *USBD_VIDEO_GetEpDesc(uint8_t *pConfDesc, uint8_t EpAddr)
   return (void *)pEpDesc;
 }
 
+/**
+  * @brief  USBD_VIDEO_Negotiate
+  *         Bring a probe or commit to the nearest settings offered and fill
+  *         in the fields the device sets
+  * @param  pdev: device instance
+  * @param  ctrl: probe or commit control
+  * @retval None
+  */
+static void USBD_VIDEO_Negotiate(USBD_HandleTypeDef *pdev, USBD_VideoControlTypeDef *ctrl)
+{
+  uint32_t interval = ctrl->dwFrameInterval;
+  uint32_t frame_size;
+  uint32_t payload;
+  uint32_t diff;
+  uint32_t best = 0xFFFFFFFFU;
+  uint32_t width;
+  uint32_t height;
+  uint32_t i;
+
+  if ((ctrl->bFormatIndex == 0U) || (ctrl->bFormatIndex > UVC_NUM_FORMATS))
+  {
+    ctrl->bFormatIndex = UVC_FORMAT_MJPEG;
+  }
+
+  if ((ctrl->bFrameIndex == 0U) || (ctrl->bFrameIndex > UVC_NUM_FRAMES))
+  {
+    ctrl->bFrameIndex = 1U;
+  }
+
+  /* No preference is the default rate of the speed, others the nearest offered */
+  if (interval == 0U)
+  {
+    interval = (pdev->dev_speed == USBD_SPEED_HIGH) ? UVC_INTERVAL(UVC_CAM_FPS_HS) : UVC_INTERVAL(UVC_CAM_FPS_FS);
+  }
+
+  for (i = 0U; i < UVC_NUM_INTERVALS; i++)
+  {
+    diff = (interval > USBD_VIDEO_Intervals[i]) ? (interval - USBD_VIDEO_Intervals[i]) :
+                                                  (USBD_VIDEO_Intervals[i] - interval);
+    if (diff < best)
+    {
+      best = diff;
+      ctrl->dwFrameInterval = USBD_VIDEO_Intervals[i];
+    }
+  }
+
+  /* Frame n is the full size divided by 2^(n-1) */
+  width = UVC_WIDTH >> (ctrl->bFrameIndex - 1U);
+  height = UVC_HEIGHT >> (ctrl->bFrameIndex - 1U);
+
+  switch (ctrl->bFormatIndex)
+  {
+  case UVC_FORMAT_YUY2:
+    frame_size = UVC_FRAME_SIZE_YUY2(width, height);
+    break;
+  case UVC_FORMAT_NV12:
+    frame_size = UVC_FRAME_SIZE_NV12(width, height);
+    break;
+  default:
+    frame_size = UVC_FRAME_SIZE_MJPEG(width, height);
+    break;
+  }
+
+  /* A payload never needs more than a whole image */
+#if (USBD_UVC_BULK == 1U)
+  payload = UVC_BULK_PAYLOAD;
+#else
+  payload = (pdev->dev_speed == USBD_SPEED_HIGH) ? UVC_ISO_HS_PAYLOAD : UVC_ISO_FS_MPS;
+#endif /* USBD_UVC_BULK */
+
+  ctrl->dwMaxVideoFrameSize = frame_size;
+  ctrl->dwMaxPayloadTransferSize = MIN(payload, frame_size + UVC_PAYLOAD_HEADER_SIZE);
+  ctrl->dwClockFrequency = USBD_VIDEO_GetClockFrequency();
+  ctrl->bmFramingInfo = UVC_FRAMING_INFO;
+
+  /* Update bPreferedVersion, bMinVersion and bMaxVersion which must be set only by Device */
+  ctrl->bPreferedVersion = 0x00U;
+  ctrl->bMinVersion = 0x00U;
+  ctrl->bMaxVersion = 0x00U;
+}
+
+/**
+  * @brief  USBD_VIDEO_Start
+  *         Stream with the committed settings, from the next SOF
+  * @param  pdev: device instance
+  * @param  hVIDEO: video class handle
+  * @retval None
+  */
+static void USBD_VIDEO_Start(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO)
+{
+  USBD_VIDEO_ItfTypeDef *hItf = (USBD_VIDEO_ItfTypeDef *)pdev->pUserData_UVC;
+  uint32_t period = (pdev->dev_speed == USBD_SPEED_HIGH) ? UVC_SOF_PERIOD_HS : UVC_SOF_PERIOD_FS;
+
+  /* Selected again while streaming: the image being sent goes back first */
+  USBD_VIDEO_Stop(pdev, hVIDEO);
+
+  hVIDEO->stream.format = video_Commit_Control.bFormatIndex;
+  hVIDEO->stream.width = (uint16_t)(UVC_WIDTH >> (video_Commit_Control.bFrameIndex - 1U));
+  hVIDEO->stream.height = (uint16_t)(UVC_HEIGHT >> (video_Commit_Control.bFrameIndex - 1U));
+  hVIDEO->stream.interval = video_Commit_Control.dwFrameInterval;
+  hVIDEO->stream.max_frame_size = video_Commit_Control.dwMaxVideoFrameSize;
+  hVIDEO->max_payload = video_Commit_Control.dwMaxPayloadTransferSize;
+
+  /* The first image goes on the next SOF */
+  hVIDEO->interval_sofs = MAX(hVIDEO->stream.interval / period, 1U);
+  hVIDEO->next_sof = hVIDEO->sof_count;
+
+  (void)hItf->Control(VIDEO_CMD_START, (uint8_t *)&hVIDEO->stream, (uint16_t)sizeof(hVIDEO->stream));
+
+  (void)USBD_LL_FlushEP(pdev, UVC_IN_EP);
+  hVIDEO->uvc_state = UVC_PLAY_STATUS_READY;
+}
+
+/**
+  * @brief  USBD_VIDEO_Stop
+  *         Stop streaming and give the image being sent back
+  * @param  pdev: device instance
+  * @param  hVIDEO: video class handle
+  * @retval None
+  */
+static void USBD_VIDEO_Stop(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO)
+{
+  USBD_VIDEO_ItfTypeDef *hItf = (USBD_VIDEO_ItfTypeDef *)pdev->pUserData_UVC;
+
+  if (hVIDEO->uvc_state == UVC_PLAY_STATUS_STOP)
+  {
+    return;
+  }
+
+  hVIDEO->uvc_state = UVC_PLAY_STATUS_STOP;
+
+#if (USBD_UVC_BULK == 1U)
+  /* A bulk transfer may still be armed: disable the endpoint to drop it */
+  (void)USBD_LL_CloseEP(pdev, UVC_IN_EP);
+  (void)USBD_LL_FlushEP(pdev, UVC_IN_EP);
+  (void)USBD_LL_OpenEP(pdev, UVC_IN_EP, UVC_EP_TYPE, (uint16_t)hVIDEO->ep_mps);
+#else
+  (void)USBD_LL_FlushEP(pdev, UVC_IN_EP);
+#endif /* USBD_UVC_BULK */
+
+  USBD_VIDEO_Restore(hVIDEO);
+  hVIDEO->tx_buf = NULL;
+  hVIDEO->frame.size = 0U;
+  hVIDEO->frame_offset = 0U;
+
+  (void)hItf->Control(VIDEO_CMD_STOP, NULL, 0U);
+}
+
+/**
+  * @brief  USBD_VIDEO_SendPayload
+  *         Arm the next payload of the current image, taking a new one
+  *         from the application once it is all sent
+  * @param  pdev: device instance
+  * @param  hVIDEO: video class handle
+  * @retval None
+  */
+static void USBD_VIDEO_SendPayload(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO)
+{
+  USBD_VIDEO_ItfTypeDef *hItf = (USBD_VIDEO_ItfTypeDef *)pdev->pUserData_UVC;
+  uint32_t len;
+  uint8_t info;
+
+  /* The armed payload is out: give the image its bytes back */
+  USBD_VIDEO_Restore(hVIDEO);
+
+  if (hVIDEO->frame_offset >= hVIDEO->frame.size)
+  {
+    hVIDEO->frame.size = 0U;
+    hVIDEO->frame_offset = 0U;
+
+    /* One image per committed frame interval */
+    if ((int32_t)(hVIDEO->sof_count - hVIDEO->next_sof) >= 0)
+    {
+      /* The application gets the previous image back with this call */
+      hVIDEO->frame.fill = NULL;
+      hVIDEO->frame.payload = NULL;
+      if ((hItf->Data(&hVIDEO->frame) != 0) ||
+          ((hVIDEO->frame.data == NULL) &&
+           ((hVIDEO->frame.fill == NULL) || (hVIDEO->frame.payload == NULL))) ||
+          (hVIDEO->frame.size == 0U) ||
+          (hVIDEO->frame.size > hVIDEO->stream.max_frame_size))
+      {
+        /* Nothing to send, or more than the host sized its buffers for */
+        hVIDEO->frame.size = 0U;
+      }
+      else
+      {
+        /* The frame ID toggles at each new image */
+        hVIDEO->fid ^= UVC_HEADER_FID;
+
+        /* Catch up on late images rather than bursting */
+        hVIDEO->next_sof += hVIDEO->interval_sofs;
+        if ((int32_t)(hVIDEO->sof_count - hVIDEO->next_sof) >= 0)
+        {
+          hVIDEO->next_sof = hVIDEO->sof_count + hVIDEO->interval_sofs;
+        }
+      }
+    }
+  }
+
+  if (hVIDEO->frame.size == 0U)
+  {
+#if (USBD_UVC_BULK == 1U)
+    /* Nothing to send: the bulk stream idles until an SOF finds an image */
+    hVIDEO->tx_buf = NULL;
+    hVIDEO->uvc_state = UVC_PLAY_STATUS_READY;
+    return;
+#else
+    /* Nothing to send, an empty payload keeps the isochronous stream up */
+    hVIDEO->tx_buf = hVIDEO->header;
+    hVIDEO->tx_len = USBD_VIDEO_Header(pdev, hVIDEO, hVIDEO->header, 0U);
+#endif /* USBD_UVC_BULK */
+  }
+  else
+  {
+    len = MIN(hVIDEO->frame.size - hVIDEO->frame_offset, hVIDEO->max_payload - UVC_PAYLOAD_HEADER_SIZE);
+
+#if (USBD_UVC_BULK == 1U)
+    /* A payload shorter than dwMaxPayloadTransferSize must end with a short
+       packet, or the host reads on into the next one */
+    if ((((UVC_PAYLOAD_HEADER_SIZE + len) % hVIDEO->ep_mps) == 0U) &&
+        ((UVC_PAYLOAD_HEADER_SIZE + len) < hVIDEO->max_payload))
+    {
+      len--;
+    }
+#endif /* USBD_UVC_BULK */
+
+    info = (UVC_PAYLOAD_PTS_SCR == 1U) ? UVC_HEADER_PTS : 0U;
+    if ((hVIDEO->frame_offset + len) == hVIDEO->frame.size)
+    {
+      info |= UVC_HEADER_EOF;
+    }
+
+    if (hVIDEO->frame.data != NULL)
+    {
+      /* Header in front of the data, over bytes already sent or the headroom */
+      hVIDEO->hdr_pos = &hVIDEO->frame.data[hVIDEO->frame_offset] - UVC_PAYLOAD_HEADER_SIZE;
+      (void)USBD_memcpy(hVIDEO->hdr_save, hVIDEO->hdr_pos, UVC_PAYLOAD_HEADER_SIZE);
+      (void)USBD_VIDEO_Header(pdev, hVIDEO, hVIDEO->hdr_pos, info);
+      hVIDEO->tx_buf = hVIDEO->hdr_pos;
+    }
+    else
+    {
+      /* No image buffer: the application writes the data behind the header */
+      hVIDEO->frame.fill(&hVIDEO->frame, &hVIDEO->frame.payload[UVC_PAYLOAD_HEADER_SIZE],
+                         hVIDEO->frame_offset, len);
+      (void)USBD_VIDEO_Header(pdev, hVIDEO, hVIDEO->frame.payload, info);
+      hVIDEO->tx_buf = hVIDEO->frame.payload;
+    }
+
+    hVIDEO->tx_len = UVC_PAYLOAD_HEADER_SIZE + len;
+    hVIDEO->frame_offset += len;
+  }
+
+  /* Kept until the next one in case the host misses it */
+  (void)USBD_LL_Transmit(pdev, UVC_IN_EP, hVIDEO->tx_buf, hVIDEO->tx_len);
+}
+
+/**
+  * @brief  USBD_VIDEO_Restore
+  *         Put back the image bytes under the last payload header
+  * @param  hVIDEO: video class handle
+  * @retval None
+  */
+static void USBD_VIDEO_Restore(USBD_VIDEO_HandleTypeDef *hVIDEO)
+{
+  if ((hVIDEO != NULL) && (hVIDEO->hdr_pos != NULL))
+  {
+    (void)USBD_memcpy(hVIDEO->hdr_pos, hVIDEO->hdr_save, UVC_PAYLOAD_HEADER_SIZE);
+    hVIDEO->hdr_pos = NULL;
+  }
+}
+
+/**
+  * @brief  USBD_VIDEO_Header
+  *         Write a payload header
+  * @param  pdev: device instance
+  * @param  hVIDEO: video class handle
+  * @param  hdr: where to write it
+  * @param  info: UVC_HEADER_PTS and UVC_HEADER_EOF bits
+  * @retval header length
+  */
+static uint32_t USBD_VIDEO_Header(USBD_HandleTypeDef *pdev, USBD_VIDEO_HandleTypeDef *hVIDEO,
+                                  uint8_t *hdr, uint8_t info)
+{
+  uint32_t len = 2U;
+#if (UVC_PAYLOAD_PTS_SCR == 1U)
+  PCD_HandleTypeDef *hpcd = pdev->pData;
+  uint32_t stc = USBD_VIDEO_GetClock();
+  uint32_t sof = hpcd->FrameNumber;
+
+  if ((info & UVC_HEADER_PTS) != 0U)
+  {
+    hdr[len] = (uint8_t)hVIDEO->frame.pts;
+    hdr[len + 1U] = (uint8_t)(hVIDEO->frame.pts >> 8);
+    hdr[len + 2U] = (uint8_t)(hVIDEO->frame.pts >> 16);
+    hdr[len + 3U] = (uint8_t)(hVIDEO->frame.pts >> 24);
+    len += 4U;
+  }
+
+  /* The SOF counter holds the frame number, HS also counts microframes */
+  if (pdev->dev_speed == USBD_SPEED_HIGH)
+  {
+    sof >>= 3;
+  }
+  sof &= 0x7FFU;
+
+  hdr[len] = (uint8_t)stc;
+  hdr[len + 1U] = (uint8_t)(stc >> 8);
+  hdr[len + 2U] = (uint8_t)(stc >> 16);
+  hdr[len + 3U] = (uint8_t)(stc >> 24);
+  hdr[len + 4U] = LOBYTE(sof);
+  hdr[len + 5U] = HIBYTE(sof);
+  len += 6U;
+  info |= UVC_HEADER_SCR;
+#else
+  UNUSED(pdev);
+#endif /* UVC_PAYLOAD_PTS_SCR */
+
+  hdr[0] = (uint8_t)len;
+  hdr[1] = UVC_HEADER_EOH | hVIDEO->fid | info;
+
+  return len;
+}
+
+/**
+  * @brief  USBD_VIDEO_GetClock
+  *         Source clock of the payload headers, to timestamp the images
+  * @param  None
+  * @retval clock count, at USBD_VIDEO_GetClockFrequency()
+  */
+uint32_t USBD_VIDEO_GetClock(void)
+{
+#if (UVC_CLOCK_CYCCNT == 1U)
+  return DWT->CYCCNT;
+#else
+  return HAL_GetTick() * 1000U;
+#endif /* UVC_CLOCK_CYCCNT */
+}
+
+/**
+  * @brief  USBD_VIDEO_GetClockFrequency
+  *         Rate of USBD_VIDEO_GetClock(), reported as dwClockFrequency
+  * @param  None
+  * @retval frequency in Hz
+  */
+uint32_t USBD_VIDEO_GetClockFrequency(void)
+{
+#if (UVC_CLOCK_CYCCNT == 1U)
+  return SystemCoreClock;
+#else
+  return 1000000U;
+#endif /* UVC_CLOCK_CYCCNT */
+}
+
 /**
   * @brief  USBD_VIDEO_RegisterInterface
   * @param  pdev: instance
@@ -1045,11 +1541,8 @@ uint8_t USBD_VIDEO_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_VIDEO_ItfTyp
 
 void USBD_Update_UVC_DESC(uint8_t *desc, uint8_t vc_itf, uint8_t vs_itf, uint8_t in_ep, uint8_t str_idx)
 {
-#ifdef USBD_UVC_FORMAT_UNCOMPRESSED
-#define _OFFSET 44
-#else
-#define _OFFSET 22
-#endif
+  /* Descriptors following the class-specific VS ones */
+  uint8_t *tail = &desc[UVC_VS_HEADER_OFFSET + VC_HEADER_SIZE];
 
   desc[11] = vc_itf;
   desc[16] = str_idx;
@@ -1057,8 +1550,12 @@ void USBD_Update_UVC_DESC(uint8_t *desc, uint8_t vc_itf, uint8_t vs_itf, uint8_t
   desc[38] = vs_itf;
   desc[58] = vs_itf;
   desc[71] = in_ep;
-  desc[100 + _OFFSET] = vs_itf;
-  desc[109 + _OFFSET] = in_ep;
+#if (USBD_UVC_BULK == 1U)
+  tail[2] = in_ep;
+#else
+  tail[2] = vs_itf;
+  tail[USB_IF_DESC_SIZE + 2U] = in_ep;
+#endif /* USBD_UVC_BULK */
 
   UVC_IN_EP = in_ep;
   UVC_VC_IF_NUM = vc_itf;
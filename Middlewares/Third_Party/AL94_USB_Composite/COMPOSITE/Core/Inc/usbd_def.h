@@ -309,6 +309,8 @@ typedef struct _USBD_HandleTypeDef
   void                    *pUserData_CDC_RNDIS;
   void                    *pClassData_CDC_ECM;
   void                    *pUserData_CDC_ECM;
+  void                    *pClassData_CDC_NCM;
+  void                    *pUserData_CDC_NCM;
   void                    *pClassData_HID_Mouse;
   void                    *pClassData_HID_Keyboard;
   void                    *pClassData_HID_Custom;
@@ -317,6 +317,10 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_ECM_IN_EP & 0x7F), 128);
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_ECM_CMD_EP & 0x7F), 64);
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_NCM_IN_EP & 0x7F), 128);
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_NCM_CMD_EP & 0x7F), 64);
+#endif
 #if (USBD_USE_HID_MOUSE == 1)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (HID_MOUSE_IN_EP & 0x7F), 64);
 #endif
@@ -327,15 +331,19 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CUSTOM_HID_IN_EP & 0x7F), 64);
 #endif
 #if (USBD_USE_UAC_MIC == 1)
-    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (AUDIO_MIC_EP & 0x7F), 128);
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (AUDIO_MIC_EP & 0x7F), (AUDIO_MIC_PACKET + 3U) & ~3U);
 #endif
-#if (USBD_USE_UAC_SPKR == 1)
+#if (USBD_USE_UAC_SPKR == 1) && (AUDIO_SPKR_FB_ENABLED == 1U)
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (AUDIO_SPKR_FB_EP & 0x7F), 64);
 #endif
 #if (USBD_USE_UVC == 1)
-    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (UVC_IN_EP & 0x7F), 128);
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (UVC_IN_EP & 0x7F), UVC_EP_HS_MPS); // A whole packet
 #endif
 #if (USBD_USE_MSC == 1)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (MSC_IN_EP & 0x7F), 128);
+#if (MSC_UAS_ENABLED == 1U)
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (MSC_UAS_STATUS_EP & 0x7F), 64);
+#endif
 #endif
 #if (USBD_USE_DFU == 1)
 #endif
@@ -392,6 +400,14 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, CDC_ECM_CMD_EP, PCD_SNG_BUF, pma_track);
     pma_track += 8;
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, CDC_NCM_IN_EP, PCD_SNG_BUF, pma_track);
+    pma_track += 64;
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, CDC_NCM_OUT_EP, PCD_SNG_BUF, pma_track);
+    pma_track += 64;
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, CDC_NCM_CMD_EP, PCD_SNG_BUF, pma_track);
+    pma_track += 16;
+#endif
 #if (USBD_USE_HID_MOUSE == 1)
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, HID_MOUSE_IN_EP, PCD_SNG_BUF, pma_track);
     pma_track += 8;
@@ -413,6 +429,10 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
 #if (USBD_USE_UAC_SPKR == 1)
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, AUDIO_SPKR_EP, PCD_SNG_BUF, pma_track);
     pma_track += 128;
+#if (AUDIO_SPKR_FB_ENABLED == 1U)
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, AUDIO_SPKR_FB_EP, PCD_SNG_BUF, pma_track);
+    pma_track += 8;
+#endif
 #endif
 #if (USBD_USE_UVC == 1)
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, UVC_IN_EP, PCD_SNG_BUF, pma_track);
@@ -423,6 +443,12 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
     pma_track += 128;
     HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, MSC_OUT_EP, PCD_SNG_BUF, pma_track);
     pma_track += 128;
+#if (MSC_UAS_ENABLED == 1U)
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, MSC_UAS_STATUS_EP, PCD_SNG_BUF, pma_track);
+    pma_track += 64;
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef *)pdev->pData, MSC_UAS_CMD_EP, PCD_SNG_BUF, pma_track);
+    pma_track += 64;
+#endif
 #endif
 #if (USBD_USE_DFU == 1)
 #endif
@@ -447,7 +473,11 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
 #endif
 #else /** if HAL_PCDEx_SetRxFiFo() is used by HAL driver */
 
+#if (USBD_USE_UAC_SPKR == 1)
+    HAL_PCDEx_SetRxFiFoInBytes(hpcd_USB_OTG_PTR, 1024); // ALL OUT EP Buffer, holds a 24-bit 96 kHz speaker packet
+#else
     HAL_PCDEx_SetRxFiFoInBytes(hpcd_USB_OTG_PTR, 512); // ALL OUT EP Buffer
+#endif
 
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, 0, 64); // EP0 IN
 
@@ -460,6 +490,10 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_ECM_IN_EP & 0x7F), 128);
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_ECM_CMD_EP & 0x7F), 64);
 #endif
+#if (USBD_USE_CDC_NCM == 1)
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_NCM_IN_EP & 0x7F), 128);
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CDC_NCM_CMD_EP & 0x7F), 64);
+#endif
 #if (USBD_USE_HID_MOUSE == 1)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (HID_MOUSE_IN_EP & 0x7F), 64);
 #endif
@@ -470,15 +504,19 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (CUSTOM_HID_IN_EP & 0x7F), 64);
 #endif
 #if (USBD_USE_UAC_MIC == 1)
-    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (AUDIO_MIC_EP & 0x7F), 128);
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (AUDIO_MIC_EP & 0x7F), (AUDIO_MIC_PACKET + 3U) & ~3U);
 #endif
-#if (USBD_USE_UAC_SPKR == 1)
+#if (USBD_USE_UAC_SPKR == 1) && (AUDIO_SPKR_FB_ENABLED == 1U)
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (AUDIO_SPKR_FB_EP & 0x7F), 64);
 #endif
 #if (USBD_USE_UVC == 1)
-    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (UVC_IN_EP & 0x7F), 128);
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (UVC_IN_EP & 0x7F), UVC_EP_FS_MPS); // A whole packet
 #endif
 #if (USBD_USE_MSC == 1)
     HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (MSC_IN_EP & 0x7F), 128);
+#if (MSC_UAS_ENABLED == 1U)
+    HAL_PCDEx_SetTxFiFoInBytes(hpcd_USB_OTG_PTR, (MSC_UAS_STATUS_EP & 0x7F), 64);
+#endif
 #endif
 #if (USBD_USE_DFU == 1)
 #endif
@@ -756,6 +794,24 @@ void USBD_LL_Delay(uint32_t Delay)
   HAL_Delay(Delay);
 }
 
+/**
+  * @brief  Starts the DWT cycle counter the classes time their work with,
+  *         a counter already running (debugger, other class) is left alone.
+  * @retval None
+  */
+void USBD_LL_StartCycleCounter(void)
+{
+#if defined(DWT)
+  if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+  {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55U;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+#endif /* DWT */
+}
+
 /**
   * @brief  Retuns the USB status depending on the HAL status:
   * @param  hal_status: HAL status
@@ -154,6 +154,7 @@
   */
 
 /* Exported functions -------------------------------------------------------*/
+void USBD_LL_StartCycleCounter(void);
 
 /**
   * @}
@@ -0,0 +1,390 @@
+/**
+  ******************************************************************************
+  * @file           : csum_bench.c
+  * @brief          : Checksum and CRC harness for usbd_csum.c.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           usbd_csum.c is built unchanged for the host, where it takes the
+  *           portable paths: the two-lane Internet checksum and the word at a
+  *           time table CRCs (there is no CRC unit).
+  *
+  *           Checks: known CRC vectors, then every length up to 2 KB at
+  *           every alignment against bit-serial / byte-pair references,
+  *           split-buffer continuation and the RFC 1624 field updates.
+  *
+  *           Benchmark: each routine against the scalar code it replaces,
+  *           the byte-pair checksum the UDP path used and the classic byte
+  *           at a time table CRC, over Ethernet and storage sized buffers.
+  *           The timed loop is the routine alone; results are kept live so
+  *           the compiler cannot drop the calls.
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_perf.h"
+#include "usbd_csum.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BENCH_MAX_LEN                    65536U
+#define BENCH_CHECK_LEN                  2048U
+
+#define BENCH_CRC32_POLY                 0xEDB88320U   /* Reflected */
+#define BENCH_CRC32C_POLY                0x82F63B78U
+
+/* Private typedef -----------------------------------------------------------*/
+typedef uint32_t (*Bench_FnTypeDef)(const uint8_t *data, uint32_t len);
+
+typedef struct
+{
+  const char *name;
+  Bench_FnTypeDef fn;
+  Bench_FnTypeDef ref;
+} Bench_AlgoTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t Bench_Buf[BENCH_MAX_LEN + 8U];
+static uint32_t Bench_Crc32Table[256];
+static uint32_t Bench_Crc32CTable[256];
+static uint32_t Bench_Failures;
+static volatile uint32_t Bench_Sink;
+
+/* References ----------------------------------------------------------------*/
+
+/* Byte pairs, as usbd_udp.c summed before */
+static uint32_t Ref_Csum(const uint8_t *data, uint32_t len)
+{
+  uint32_t acc = 0U;
+  uint32_t i;
+
+  for (i = 0U; (i + 1U) < len; i += 2U)
+  {
+    acc += ((uint32_t)data[i] << 8) | data[i + 1U];
+  }
+  if ((len & 1U) != 0U)
+  {
+    acc += (uint32_t)data[len - 1U] << 8;
+  }
+  while ((acc >> 16) != 0U)
+  {
+    acc = (acc & 0xFFFFU) + (acc >> 16);
+  }
+
+  return acc;
+}
+
+static uint32_t Ref_CrcBits(uint32_t poly, const uint8_t *data, uint32_t len)
+{
+  uint32_t c = 0xFFFFFFFFU;
+  uint32_t i;
+  uint8_t k;
+
+  for (i = 0U; i < len; i++)
+  {
+    c ^= data[i];
+    for (k = 0U; k < 8U; k++)
+    {
+      c = ((c & 1U) != 0U) ? ((c >> 1) ^ poly) : (c >> 1);
+    }
+  }
+
+  return ~c;
+}
+
+static void Ref_MakeTable(uint32_t *table, uint32_t poly)
+{
+  uint32_t i;
+  uint32_t c;
+  uint8_t k;
+
+  for (i = 0U; i < 256U; i++)
+  {
+    c = i;
+    for (k = 0U; k < 8U; k++)
+    {
+      c = ((c & 1U) != 0U) ? ((c >> 1) ^ poly) : (c >> 1);
+    }
+    table[i] = c;
+  }
+}
+
+/* Sarwate, one byte per lookup */
+static uint32_t Ref_CrcTable(const uint32_t *table, const uint8_t *data, uint32_t len)
+{
+  uint32_t c = 0xFFFFFFFFU;
+  uint32_t i;
+
+  for (i = 0U; i < len; i++)
+  {
+    c = table[(c ^ data[i]) & 0xFFU] ^ (c >> 8);
+  }
+
+  return ~c;
+}
+
+/* Adapters for the timed loop -----------------------------------------------*/
+
+static uint32_t Bench_Csum(const uint8_t *data, uint32_t len)
+{
+  return USBD_Csum_Fold(USBD_Csum_Add(data, len, 0U));
+}
+
+static uint32_t Bench_Crc32(const uint8_t *data, uint32_t len)
+{
+  return USBD_Csum_Crc32(0U, data, len);
+}
+
+static uint32_t Bench_Crc32C(const uint8_t *data, uint32_t len)
+{
+  return USBD_Csum_Crc32C(0U, data, len);
+}
+
+static uint32_t Bench_RefCrc32(const uint8_t *data, uint32_t len)
+{
+  return Ref_CrcTable(Bench_Crc32Table, data, len);
+}
+
+static uint32_t Bench_RefCrc32C(const uint8_t *data, uint32_t len)
+{
+  return Ref_CrcTable(Bench_Crc32CTable, data, len);
+}
+
+static const Bench_AlgoTypeDef Bench_Algo[] =
+{
+  { "csum", Bench_Csum, Ref_Csum },
+  { "crc32", Bench_Crc32, Bench_RefCrc32 },
+  { "crc32c", Bench_Crc32C, Bench_RefCrc32C },
+};
+
+/* Checks --------------------------------------------------------------------*/
+
+static void Bench_Expect(const char *what, uint32_t got, uint32_t want, uint32_t len, uint32_t ofs)
+{
+  if (got != want)
+  {
+    Bench_Failures++;
+    (void)fprintf(stderr, "FAIL: %s len %u offset %u: 0x%08x, expected 0x%08x\n", what, len, ofs, got, want);
+  }
+}
+
+static void Bench_Check(void)
+{
+  static const uint8_t vector[] = "123456789";
+  const uint8_t *p;
+  uint32_t len;
+  uint32_t ofs;
+  uint32_t cut;
+  uint32_t sum;
+  uint16_t csum;
+  uint16_t patched;
+
+  Bench_Expect("crc32 vector", USBD_Csum_Crc32(0U, vector, 9U), 0xCBF43926U, 9U, 0U);
+  Bench_Expect("crc32c vector", USBD_Csum_Crc32C(0U, vector, 9U), 0xE3069283U, 9U, 0U);
+
+  for (ofs = 0U; ofs < 4U; ofs++)
+  {
+    for (len = 0U; len <= BENCH_CHECK_LEN; len++)
+    {
+      p = &Bench_Buf[ofs];
+
+      Bench_Expect("csum", Bench_Csum(p, len), Ref_Csum(p, len), len, ofs);
+
+      /* The bit-serial references are slow, sample the lengths */
+      if ((len < 64U) || ((len % 61U) == 0U))
+      {
+        Bench_Expect("crc32", Bench_Crc32(p, len), Ref_CrcBits(BENCH_CRC32_POLY, p, len), len, ofs);
+        Bench_Expect("crc32c", Bench_Crc32C(p, len), Ref_CrcBits(BENCH_CRC32C_POLY, p, len), len, ofs);
+      }
+
+      /* Continuation across an even cut for the checksum, any cut for CRCs */
+      cut = (len / 3U) & ~1U;
+      sum = USBD_Csum_Add(&p[cut], len - cut, USBD_Csum_Add(p, cut, 0U));
+      Bench_Expect("csum split", USBD_Csum_Fold(sum), Ref_Csum(p, len), len, ofs);
+      cut = len / 3U;
+      Bench_Expect("crc32 split", USBD_Csum_Crc32(USBD_Csum_Crc32(0U, p, cut), &p[cut], len - cut),
+                   Bench_Crc32(p, len), len, ofs);
+      Bench_Expect("crc32c split", USBD_Csum_Crc32C(USBD_Csum_Crc32C(0U, p, cut), &p[cut], len - cut),
+                   Bench_Crc32C(p, len), len, ofs);
+    }
+  }
+
+  /* A large buffer crosses the lane fold of the checksum */
+  Bench_Expect("csum 64K", Bench_Csum(Bench_Buf, BENCH_MAX_LEN), Ref_Csum(Bench_Buf, BENCH_MAX_LEN), BENCH_MAX_LEN, 0U);
+  (void)memset(Bench_Buf, 0xFF, BENCH_MAX_LEN);
+  Bench_Expect("csum 64K ones", Bench_Csum(Bench_Buf, BENCH_MAX_LEN), 0xFFFFU, BENCH_MAX_LEN, 0U);
+
+  /* Field updates against a full recompute, over a 20 byte header */
+  for (ofs = 0U; ofs < 1000U; ofs++)
+  {
+    Bench_Buf[ofs % 20U] = (uint8_t)(ofs * 37U);
+    Bench_Buf[10] = 0U;
+    Bench_Buf[11] = 0U;
+    csum = (uint16_t)~Ref_Csum(Bench_Buf, 20U);
+
+    patched = USBD_Csum_Update16(csum, ((uint16_t)Bench_Buf[4] << 8) | Bench_Buf[5], (uint16_t)(ofs * 7919U));
+    Bench_Buf[4] = (uint8_t)((ofs * 7919U) >> 8);
+    Bench_Buf[5] = (uint8_t)(ofs * 7919U);
+    Bench_Expect("update16", patched, (uint16_t)~Ref_Csum(Bench_Buf, 20U), 20U, ofs);
+
+    csum = patched;
+    patched = USBD_Csum_Update32(csum, ((uint32_t)Bench_Buf[12] << 24) | ((uint32_t)Bench_Buf[13] << 16) |
+                                 ((uint32_t)Bench_Buf[14] << 8) | Bench_Buf[15], ofs * 2654435761U);
+    Bench_Buf[12] = (uint8_t)((ofs * 2654435761U) >> 24);
+    Bench_Buf[13] = (uint8_t)((ofs * 2654435761U) >> 16);
+    Bench_Buf[14] = (uint8_t)((ofs * 2654435761U) >> 8);
+    Bench_Buf[15] = (uint8_t)(ofs * 2654435761U);
+    Bench_Expect("update32", patched, (uint16_t)~Ref_Csum(Bench_Buf, 20U), 20U, ofs);
+  }
+}
+
+/* Benchmark -----------------------------------------------------------------*/
+
+static void Bench_Time(Bench_FnTypeDef fn, uint32_t len, uint32_t count, HOST_PerfTypeDef *cost)
+{
+  uint32_t acc = 0U;
+  uint32_t i;
+
+  (void)memset(cost, 0, sizeof(*cost));
+
+  /* Odd offset: the UDP payload sits at 42 bytes into the frame */
+  HOST_Perf_Begin();
+  for (i = 0U; i < count; i++)
+  {
+    acc += fn(&Bench_Buf[2], len);
+  }
+  HOST_Perf_End(cost);
+
+  Bench_Sink = acc;
+}
+
+static void Bench_Row(const char *name, uint32_t len, uint32_t count, const HOST_PerfTypeDef *cost,
+                      const HOST_PerfTypeDef *base)
+{
+  double bytes = (double)len * count;
+
+  (void)printf("%-8s %-6s %7u %9.1f ", name, (base == NULL) ? "scalar" : "new", len,
+               (cost->ns != 0U) ? (bytes * 1000.0 / (double)cost->ns) : 0.0);
+  if (HOST_Perf_HasInstr() != 0U)
+  {
+    (void)printf("%10.2f ", (double)cost->instr / bytes);
+  }
+  else
+  {
+    (void)printf("%10s ", "-");
+  }
+  if ((base != NULL) && (cost->ns != 0U))
+  {
+    (void)printf("%7.2fx\n", (double)base->ns / (double)cost->ns);
+  }
+  else
+  {
+    (void)printf("%8s\n", "");
+  }
+}
+
+static void Bench_Usage(const char *prog)
+{
+  (void)fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -s, --size BYTES   buffer size, 0 for 64, 512, 1514 and 65536 (0)\n"
+                "  -n, --count N      megabytes processed per measurement (64)\n"
+                "  -q, --quiet        checks only, no benchmark\n",
+                prog);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option opts[] =
+  {
+    { "size", required_argument, NULL, 's' },
+    { "count", required_argument, NULL, 'n' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  static const uint32_t default_size[] = { 64U, 512U, 1514U, 65536U };
+  HOST_PerfTypeDef base;
+  HOST_PerfTypeDef cost;
+  uint32_t size = 0U;
+  uint32_t mbytes = 64U;
+  uint32_t count;
+  uint32_t len;
+  uint8_t quiet = 0U;
+  uint32_t a;
+  uint32_t x;
+  uint32_t i;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "s:n:qh", opts, NULL)) != -1)
+  {
+    switch (c)
+    {
+      case 's': size = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'n': mbytes = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'q': quiet = 1U; break;
+      default: Bench_Usage(argv[0]); return (c == 'h') ? 0 : 2;
+    }
+  }
+
+  if ((size > BENCH_MAX_LEN) || (mbytes == 0U))
+  {
+    Bench_Usage(argv[0]);
+    return 2;
+  }
+
+  Ref_MakeTable(Bench_Crc32Table, BENCH_CRC32_POLY);
+  Ref_MakeTable(Bench_Crc32CTable, BENCH_CRC32C_POLY);
+
+  srand(1U);
+  for (i = 0U; i < sizeof(Bench_Buf); i++)
+  {
+    Bench_Buf[i] = (uint8_t)rand();
+  }
+
+  Bench_Check();
+
+  if (Bench_Failures != 0U)
+  {
+    (void)fprintf(stderr, "%u check(s) failed\n", Bench_Failures);
+    return 1;
+  }
+
+  if (quiet != 0U)
+  {
+    return 0;
+  }
+
+  HOST_Perf_Init();
+
+  (void)printf("%-8s %-6s %7s %9s %10s %8s\n", "algo", "code", "bytes", "MB/s", "instr/B", "speedup");
+
+  for (a = 0U; a < (sizeof(Bench_Algo) / sizeof(Bench_Algo[0])); a++)
+  {
+    for (x = 0U; x < 4U; x++)
+    {
+      if ((size != 0U) && (x != 0U))
+      {
+        continue;
+      }
+
+      len = (size != 0U) ? size : default_size[x];
+      count = (len != 0U) ? (uint32_t)(((uint64_t)mbytes << 20) / len) : 1U;
+
+      Bench_Time(Bench_Algo[a].ref, len, count, &base);
+      Bench_Row(Bench_Algo[a].name, len, count, &base, NULL);
+      Bench_Time(Bench_Algo[a].fn, len, count, &cost);
+      Bench_Row(Bench_Algo[a].name, len, count, &cost, &base);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,652 @@
+/**
+  ******************************************************************************
+  * @file           : msc_bench.c
+  * @brief          : MSC BOT/SCSI performance harness on the simulated PCD.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           The class sources are built unchanged for the host and driven
+  *           through sim_pcd.c: the harness plays the host, injecting CBWs
+  *           and moving data and CSWs, and calls the class DataIn/DataOut
+  *           callbacks the way the PCD interrupt does.
+  *
+  *           Only the time spent inside the device (class callbacks, storage
+  *           and the main loop background work) is accounted, so the
+  *           figures are the stack's CPU cost per command, not a bus model.
+  *           Every read is checked against a shadow copy of the disk.
+  *
+  *           Backends:
+  *             ram    storage callbacks copy straight to a RAM disk
+  *             cache  the RAM disk sits behind usbd_msc_cache.c, flushed by
+  *                    the modelled main loop once every --flush-every OUT
+  *                    packets; a full cache defers the write (USBD_BUSY)
+  *                    until USBD_MSC_Resume()
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim_pcd.h"
+#include "host_perf.h"
+#include "usbd_msc.h"
+#include "usbd_msc_cache.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BENCH_BLK_SIZ                    512U
+#define BENCH_CBW_LEN                    31U
+#define BENCH_CSW_LEN                    13U
+#define BENCH_MAX_XFER                   (1024U * 1024U)
+#define BENCH_STALL_POLLS                100000U
+
+#define BENCH_BACKEND_RAM                0U
+#define BENCH_BACKEND_CACHE              1U
+
+#define BENCH_PATTERN_SEQ                0U
+#define BENCH_PATTERN_RAND               1U
+
+#define BENCH_OP_READ                    0U
+#define BENCH_OP_WRITE                   1U
+
+#define BENCH_ALL                        0xFFU
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint8_t  backend;
+  uint8_t  pattern;
+  uint8_t  op;
+  uint32_t xfer;
+  uint32_t count;
+} Bench_TestTypeDef;
+
+typedef struct
+{
+  HOST_PerfTypeDef cost;
+  uint64_t bytes;
+  uint32_t commands;
+  uint32_t deferrals;
+  uint32_t errors;
+} Bench_ResultTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *Bench_BackendName[] = { "ram", "cache" };
+static const char *Bench_PatternName[] = { "seq", "rand" };
+static const char *Bench_OpName[] = { "read", "write" };
+
+static USBD_HandleTypeDef Bench_Dev;
+static MSC_Cache_HandleTypeDef Bench_Cache;
+static uint8_t Bench_Backend;
+static uint8_t *Bench_Disk;
+static uint8_t *Bench_Shadow;
+static uint32_t Bench_BlkNbr = (16U * 1024U * 1024U) / BENCH_BLK_SIZ;
+static uint32_t Bench_FlushEvery = 1U;
+static uint32_t Bench_Seed = 1U;
+static uint32_t Bench_Tag;
+
+static uint8_t Bench_Data[BENCH_MAX_XFER];
+static Bench_ResultTypeDef *Bench_Run;
+
+static const int8_t Bench_Inquirydata[] = {
+  0x00, 0x80, 0x02, 0x02, (STANDARD_INQUIRY_DATA_LEN - 5), 0x00, 0x00, 0x00,
+  'S', 'T', 'M', ' ', ' ', ' ', ' ', ' ',
+  'H', 'o', 's', 't', ' ', 'b', 'e', 'n', 'c', 'h', ' ', ' ', ' ', ' ', ' ', ' ',
+  '0', '.', '0', '1'
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t Bench_Init(uint8_t lun);
+static int8_t Bench_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size);
+static int8_t Bench_IsReady(uint8_t lun);
+static int8_t Bench_IsWriteProtected(uint8_t lun);
+static int8_t Bench_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t Bench_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t Bench_GetMaxLun(void);
+
+static USBD_StorageTypeDef Bench_Fops =
+{
+  Bench_Init,
+  Bench_GetCapacity,
+  Bench_IsReady,
+  Bench_IsWriteProtected,
+  Bench_Read,
+  Bench_Write,
+  Bench_GetMaxLun,
+  (int8_t *)Bench_Inquirydata
+};
+
+/* Storage callbacks ---------------------------------------------------------*/
+
+static int8_t Bench_DiskRead(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  (void)memcpy(buf, &Bench_Disk[(size_t)blk_addr * BENCH_BLK_SIZ], (size_t)blk_len * BENCH_BLK_SIZ);
+  return 0;
+}
+
+static int8_t Bench_DiskWrite(uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  (void)memcpy(&Bench_Disk[(size_t)blk_addr * BENCH_BLK_SIZ], buf, (size_t)blk_len * BENCH_BLK_SIZ);
+  return 0;
+}
+
+static int8_t Bench_Init(uint8_t lun)
+{
+  (void)lun;
+  return 0;
+}
+
+static int8_t Bench_GetCapacity(uint8_t lun, uint32_t *block_num, uint16_t *block_size)
+{
+  (void)lun;
+  *block_num = Bench_BlkNbr;
+  *block_size = BENCH_BLK_SIZ;
+  return 0;
+}
+
+static int8_t Bench_IsReady(uint8_t lun)
+{
+  (void)lun;
+  return 0;
+}
+
+static int8_t Bench_IsWriteProtected(uint8_t lun)
+{
+  (void)lun;
+  return 0;
+}
+
+static int8_t Bench_Read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  (void)lun;
+
+  if ((blk_addr + blk_len) > Bench_BlkNbr)
+  {
+    return -1;
+  }
+
+  if (Bench_Backend == BENCH_BACKEND_CACHE)
+  {
+    return MSC_Cache_Read(&Bench_Cache, buf, blk_addr, blk_len);
+  }
+
+  return Bench_DiskRead(buf, blk_addr, blk_len);
+}
+
+static int8_t Bench_Write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+  (void)lun;
+
+  if ((blk_addr + blk_len) > Bench_BlkNbr)
+  {
+    return -1;
+  }
+
+  if (Bench_Backend == BENCH_BACKEND_CACHE)
+  {
+    return MSC_Cache_Write(&Bench_Cache, buf, blk_addr, blk_len);
+  }
+
+  return Bench_DiskWrite(buf, blk_addr, blk_len);
+}
+
+static int8_t Bench_GetMaxLun(void)
+{
+  return 0;
+}
+
+/* Device side, everything here is accounted ---------------------------------*/
+
+static void Bench_DataIn(void)
+{
+  HOST_Perf_Begin();
+  (void)USBD_MSC.DataIn(&Bench_Dev, MSC_IN_EP & 0x7FU);
+  HOST_Perf_End(&Bench_Run->cost);
+}
+
+static void Bench_DataOut(void)
+{
+  HOST_Perf_Begin();
+  (void)USBD_MSC.DataOut(&Bench_Dev, MSC_OUT_EP);
+  HOST_Perf_End(&Bench_Run->cost);
+}
+
+/* One pass of the firmware main loop */
+static int8_t Bench_Process(void)
+{
+  int8_t flushed = 0;
+
+  HOST_Perf_Begin();
+
+  if (Bench_Backend == BENCH_BACKEND_CACHE)
+  {
+    flushed = MSC_Cache_Flush(&Bench_Cache);
+  }
+
+  (void)USBD_MSC_Resume(&Bench_Dev);
+
+  HOST_Perf_End(&Bench_Run->cost);
+
+  return flushed;
+}
+
+/* Host side -----------------------------------------------------------------*/
+
+static uint32_t Bench_Rand(void)
+{
+  Bench_Seed = (Bench_Seed * 1103515245U) + 12345U;
+  return Bench_Seed >> 1;
+}
+
+static void Bench_Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t Bench_Get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+  * @brief  Run one BOT command: CBW, data phase, CSW
+  * @param  cb: SCSI command block
+  * @param  cb_len: command block length
+  * @param  dir_in: 1 for device to host data
+  * @param  data: data phase buffer
+  * @param  len: data phase length
+  * @retval CSW status, -1 on protocol error
+  */
+static int Bench_Command(const uint8_t *cb, uint8_t cb_len, uint8_t dir_in, uint8_t *data, uint32_t len)
+{
+  uint8_t cbw[BENCH_CBW_LEN];
+  uint8_t csw[BENCH_CSW_LEN];
+  uint32_t done = 0U;
+  uint32_t packets = 0U;
+  uint32_t polls = 0U;
+
+  (void)memset(cbw, 0, sizeof(cbw));
+  Bench_Put32(&cbw[0], USBD_BOT_CBW_SIGNATURE);
+  Bench_Put32(&cbw[4], ++Bench_Tag);
+  Bench_Put32(&cbw[8], len);
+  cbw[12] = (dir_in != 0U) ? 0x80U : 0x00U;
+  cbw[13] = 0U;
+  cbw[14] = cb_len;
+  (void)memcpy(&cbw[15], cb, cb_len);
+
+  if (SIM_PCD_OutReady(MSC_OUT_EP) == 0U)
+  {
+    return -1;
+  }
+
+  (void)SIM_PCD_PutOut(MSC_OUT_EP, cbw, BENCH_CBW_LEN);
+  Bench_DataOut();
+
+  for (;;)
+  {
+    if ((dir_in != 0U) && (done < len) && (SIM_PCD_InReady(MSC_IN_EP) != 0U))
+    {
+      done += SIM_PCD_TakeIn(MSC_IN_EP, &data[done], len - done);
+      Bench_DataIn();
+      polls = 0U;
+    }
+    else if ((dir_in == 0U) && (done < len) && (SIM_PCD_OutReady(MSC_OUT_EP) != 0U))
+    {
+      done += SIM_PCD_PutOut(MSC_OUT_EP, &data[done], len - done);
+      Bench_DataOut();
+      polls = 0U;
+
+      if ((++packets % Bench_FlushEvery) == 0U)
+      {
+        (void)Bench_Process();
+      }
+    }
+    else if (SIM_PCD_InReady(MSC_IN_EP) != 0U)
+    {
+      if (SIM_PCD_TakeIn(MSC_IN_EP, csw, BENCH_CSW_LEN) != BENCH_CSW_LEN)
+      {
+        return -1;
+      }
+      Bench_DataIn();
+      break;
+    }
+    else
+    {
+      /* Nothing armed: the device is holding the bus off, let the main loop run */
+      if (polls == 0U)
+      {
+        Bench_Run->deferrals++;
+      }
+
+      if (++polls > BENCH_STALL_POLLS)
+      {
+        return -1;
+      }
+
+      (void)Bench_Process();
+    }
+  }
+
+  if ((Bench_Get32(&csw[0]) != USBD_BOT_CSW_SIGNATURE) || (Bench_Get32(&csw[4]) != Bench_Tag))
+  {
+    return -1;
+  }
+
+  return csw[12];
+}
+
+static void Bench_Fill(uint8_t *buf, uint32_t lba, uint32_t blocks)
+{
+  uint32_t b;
+  uint32_t i;
+  uint32_t salt = Bench_Rand();
+
+  for (b = 0U; b < blocks; b++)
+  {
+    for (i = 0U; i < BENCH_BLK_SIZ; i += 4U)
+    {
+      Bench_Put32(&buf[(b * BENCH_BLK_SIZ) + i], ((lba + b) * 0x9E3779B9U) ^ salt ^ i);
+    }
+  }
+}
+
+static int Bench_Rw10(uint8_t op, uint32_t lba, uint32_t blocks)
+{
+  uint8_t cb[10];
+
+  (void)memset(cb, 0, sizeof(cb));
+  cb[0] = (op == BENCH_OP_READ) ? SCSI_READ10 : SCSI_WRITE10;
+  cb[2] = (uint8_t)(lba >> 24);
+  cb[3] = (uint8_t)(lba >> 16);
+  cb[4] = (uint8_t)(lba >> 8);
+  cb[5] = (uint8_t)lba;
+  cb[7] = (uint8_t)(blocks >> 8);
+  cb[8] = (uint8_t)blocks;
+
+  return Bench_Command(cb, sizeof(cb), (op == BENCH_OP_READ) ? 1U : 0U, Bench_Data, blocks * BENCH_BLK_SIZ);
+}
+
+static void Bench_Select(uint8_t backend)
+{
+  Bench_Backend = backend;
+
+  if (backend == BENCH_BACKEND_CACHE)
+  {
+    MSC_Cache_Init(&Bench_Cache, Bench_DiskRead, Bench_DiskWrite);
+  }
+}
+
+static void Bench_Test(const Bench_TestTypeDef *test, Bench_ResultTypeDef *res)
+{
+  uint32_t blocks = test->xfer / BENCH_BLK_SIZ;
+  uint32_t slots = Bench_BlkNbr / blocks;
+  uint32_t lba;
+  uint32_t n;
+  int status;
+
+  (void)memset(res, 0, sizeof(Bench_ResultTypeDef));
+  Bench_Run = res;
+  Bench_Select(test->backend);
+
+  for (n = 0U; n < test->count; n++)
+  {
+    lba = ((test->pattern == BENCH_PATTERN_SEQ) ? (n % slots) : (Bench_Rand() % slots)) * blocks;
+
+    if (test->op == BENCH_OP_WRITE)
+    {
+      Bench_Fill(Bench_Data, lba, blocks);
+    }
+
+    status = Bench_Rw10(test->op, lba, blocks);
+
+    if (status != USBD_CSW_CMD_PASSED)
+    {
+      res->errors++;
+      continue;
+    }
+
+    if (test->op == BENCH_OP_WRITE)
+    {
+      (void)memcpy(&Bench_Shadow[(size_t)lba * BENCH_BLK_SIZ], Bench_Data, test->xfer);
+    }
+    else if (memcmp(&Bench_Shadow[(size_t)lba * BENCH_BLK_SIZ], Bench_Data, test->xfer) != 0)
+    {
+      res->errors++;
+    }
+
+    res->commands++;
+    res->bytes += test->xfer;
+  }
+
+  /* Write-back left over is part of the cost of the workload */
+  while (Bench_Process() > 0)
+  {
+  }
+
+  if ((test->backend == BENCH_BACKEND_CACHE) &&
+      (memcmp(Bench_Disk, Bench_Shadow, (size_t)Bench_BlkNbr * BENCH_BLK_SIZ) != 0))
+  {
+    res->errors++;
+  }
+}
+
+static void Bench_Report(FILE *out, const Bench_TestTypeDef *test, const Bench_ResultTypeDef *res, uint8_t csv)
+{
+  double mbps = (res->cost.ns != 0U) ? ((double)res->bytes * 1000.0) / (double)res->cost.ns : 0.0;
+  double ns_cmd = (res->commands != 0U) ? (double)res->cost.ns / (double)res->commands : 0.0;
+  double in_cmd = (res->commands != 0U) ? (double)res->cost.instr / (double)res->commands : 0.0;
+
+  if (csv != 0U)
+  {
+    (void)fprintf(out, "%s,%s,%s,%u,%u,%llu,%llu,%.1f,%.0f,",
+                  Bench_BackendName[test->backend], Bench_PatternName[test->pattern],
+                  Bench_OpName[test->op], test->xfer, res->commands,
+                  (unsigned long long)res->bytes, (unsigned long long)res->cost.ns, mbps, ns_cmd);
+    if (HOST_Perf_HasInstr() != 0U)
+    {
+      (void)fprintf(out, "%.0f", in_cmd);
+    }
+    (void)fprintf(out, ",%u,%u\n", res->deferrals, res->errors);
+  }
+  else
+  {
+    (void)fprintf(out, "%-6s %-5s %-6s %8u %8u %10.1f %10.0f ",
+                  Bench_BackendName[test->backend], Bench_PatternName[test->pattern],
+                  Bench_OpName[test->op], test->xfer, res->commands, mbps, ns_cmd);
+    if (HOST_Perf_HasInstr() != 0U)
+    {
+      (void)fprintf(out, "%10.0f", in_cmd);
+    }
+    else
+    {
+      (void)fprintf(out, "%10s", "-");
+    }
+    (void)fprintf(out, " %9u %6u\n", res->deferrals, res->errors);
+  }
+}
+
+static uint8_t Bench_Lookup(const char *arg, const char *const *names, uint8_t nbr)
+{
+  uint8_t i;
+
+  if (strcmp(arg, "all") == 0)
+  {
+    return BENCH_ALL;
+  }
+
+  for (i = 0U; i < nbr; i++)
+  {
+    if (strcmp(arg, names[i]) == 0)
+    {
+      return i;
+    }
+  }
+
+  (void)fprintf(stderr, "unknown value '%s'\n", arg);
+  exit(2);
+}
+
+static void Bench_Usage(const char *prog)
+{
+  (void)fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -b, --backend ram|cache|all   storage backend (all)\n"
+                "  -p, --pattern seq|rand|all    access pattern (all)\n"
+                "  -o, --op read|write|all       command (all)\n"
+                "  -x, --xfer BYTES              transfer size, 0 for 4K and 64K (0)\n"
+                "  -n, --count N                 commands per test (256)\n"
+                "  -d, --disk MB                 disk size (16)\n"
+                "  -f, --flush-every N           OUT packets per main loop pass (1)\n"
+                "  -s, --seed N                  random seed (1)\n"
+                "  -c, --csv FILE                write results as CSV, - for stdout\n"
+                "  -q, --quiet                   no table on stdout\n",
+                prog);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option opts[] =
+  {
+    { "backend", required_argument, NULL, 'b' },
+    { "pattern", required_argument, NULL, 'p' },
+    { "op", required_argument, NULL, 'o' },
+    { "xfer", required_argument, NULL, 'x' },
+    { "count", required_argument, NULL, 'n' },
+    { "disk", required_argument, NULL, 'd' },
+    { "flush-every", required_argument, NULL, 'f' },
+    { "seed", required_argument, NULL, 's' },
+    { "csv", required_argument, NULL, 'c' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  static const uint32_t default_xfer[] = { 4096U, 65536U };
+  uint8_t backend = BENCH_ALL;
+  uint8_t pattern = BENCH_ALL;
+  uint8_t op = BENCH_ALL;
+  uint32_t xfer = 0U;
+  uint32_t count = 256U;
+  uint8_t quiet = 0U;
+  const char *csv_path = NULL;
+  FILE *csv = NULL;
+  Bench_TestTypeDef test;
+  Bench_ResultTypeDef res;
+  uint32_t failed = 0U;
+  uint8_t b, p, o, x;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "b:p:o:x:n:d:f:s:c:qh", opts, NULL)) != -1)
+  {
+    switch (c)
+    {
+      case 'b': backend = Bench_Lookup(optarg, Bench_BackendName, 2U); break;
+      case 'p': pattern = Bench_Lookup(optarg, Bench_PatternName, 2U); break;
+      case 'o': op = Bench_Lookup(optarg, Bench_OpName, 2U); break;
+      case 'x': xfer = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'n': count = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'd': Bench_BlkNbr = (uint32_t)strtoul(optarg, NULL, 0) * ((1024U * 1024U) / BENCH_BLK_SIZ); break;
+      case 'f': Bench_FlushEvery = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 's': Bench_Seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'c': csv_path = optarg; break;
+      case 'q': quiet = 1U; break;
+      default: Bench_Usage(argv[0]); return (c == 'h') ? 0 : 2;
+    }
+  }
+
+  if (((xfer % BENCH_BLK_SIZ) != 0U) || (xfer > BENCH_MAX_XFER) || (Bench_FlushEvery == 0U) ||
+      (Bench_BlkNbr < (BENCH_MAX_XFER / BENCH_BLK_SIZ)))
+  {
+    Bench_Usage(argv[0]);
+    return 2;
+  }
+
+  Bench_Disk = calloc(Bench_BlkNbr, BENCH_BLK_SIZ);
+  Bench_Shadow = calloc(Bench_BlkNbr, BENCH_BLK_SIZ);
+  if ((Bench_Disk == NULL) || (Bench_Shadow == NULL))
+  {
+    (void)fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  if (csv_path != NULL)
+  {
+    csv = (strcmp(csv_path, "-") == 0) ? stdout : fopen(csv_path, "w");
+    if (csv == NULL)
+    {
+      perror(csv_path);
+      return 1;
+    }
+    (void)fprintf(csv, "backend,pattern,op,xfer_bytes,commands,bytes,device_ns,mb_per_s,ns_per_cmd,instr_per_cmd,deferrals,errors\n");
+  }
+
+  HOST_Perf_Init();
+
+  /* Enumerated at high speed with the MSC interface configured */
+  (void)memset(&res, 0, sizeof(res));
+  Bench_Run = &res;
+  SIM_PCD_Reset(&Bench_Dev, USBD_SPEED_HIGH);
+  (void)USBD_MSC_RegisterStorage(&Bench_Dev, &Bench_Fops);
+  (void)USBD_MSC.Init(&Bench_Dev, 0U);
+
+  if (quiet == 0U)
+  {
+    (void)printf("%-6s %-5s %-6s %8s %8s %10s %10s %10s %9s %6s\n",
+                 "store", "pat", "op", "xfer", "cmds", "MB/s", "ns/cmd", "instr/cmd", "deferred", "errors");
+  }
+
+  for (b = 0U; b < 2U; b++)
+  {
+    for (p = 0U; p < 2U; p++)
+    {
+      /* Writes first so the reads have something to check */
+      for (o = 2U; o-- > 0U;)
+      {
+        for (x = 0U; x < 2U; x++)
+        {
+          if (((backend != BENCH_ALL) && (backend != b)) || ((pattern != BENCH_ALL) && (pattern != p)) ||
+              ((op != BENCH_ALL) && (op != o)) || ((xfer != 0U) && (x != 0U)))
+          {
+            continue;
+          }
+
+          test.backend = b;
+          test.pattern = p;
+          test.op = o;
+          test.xfer = (xfer != 0U) ? xfer : default_xfer[x];
+          test.count = count;
+
+          Bench_Test(&test, &res);
+          failed += res.errors;
+
+          if (quiet == 0U)
+          {
+            Bench_Report(stdout, &test, &res, 0U);
+          }
+          if (csv != NULL)
+          {
+            Bench_Report(csv, &test, &res, 1U);
+          }
+        }
+      }
+    }
+  }
+
+  if ((csv != NULL) && (csv != stdout))
+  {
+    (void)fclose(csv);
+  }
+
+  free(Bench_Disk);
+  free(Bench_Shadow);
+
+  return (failed == 0U) ? 0 : 1;
+}
@@ -0,0 +1,1692 @@
+/**
+  ******************************************************************************
+  * @file           : net_tap.c
+  * @brief          : RNDIS and CDC ECM harness, self-test and Linux TAP bridge.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           usbd_cdc_rndis.c and usbd_cdc_ecm.c run unchanged on the
+  *           simulated PCD, with their real interface files and the UDP
+  *           responder behind them, as the firmware builds them with
+  *           USBD_UDP_USE_FASTPATH. The harness is the USB host driver:
+  *
+  *             RNDIS  INITIALIZE, QUERY and SET through SEND_ENCAPSULATED /
+  *                    GET_ENCAPSULATED_RESPONSE, frames wrapped in
+  *                    PACKET_MSGs, --aggr of them per OUT transfer
+  *             ECM    SET_ETHERNET_PACKET_FILTER, one frame per transfer
+  *                    in max packet size chunks, with a ZLP when needed
+  *
+  *           and both drain the interrupt endpoint notifications. Between
+  *           transfers the main loop (CDC_x_Process) runs, like in main.c.
+  *
+  *           Self-test (default), for each class:
+  *             echo   ICMP echo with --window requests in flight, latency
+  *                    from the OUT transfer to the IN transfer of the reply
+  *             rx     UDP datagrams to the device, checked on its counters
+  *             tx     USBD_UDP_Send() from the main loop, every datagram
+  *                    checked by the host, the device's ARP is answered
+  *           then the RNDIS statistics OIDs are queried and compared with
+  *           what the host saw, and bursts of control messages and link
+  *           events must come out as merged notifications.
+  *
+  *           Only device calls are accounted (Setup, DataIn, DataOut, the
+  *           main loop and the application's Send). A main loop pass that
+  *           moved nothing is an idle poll: it is accounted apart, so the
+  *           per-frame cost does not depend on how fast the host polls.
+  *           Frames are counted in both directions, an echo is two.
+  *
+  *           TAP mode (--tap NAME) bridges one class to a Linux TAP device,
+  *           the kernel is the USB host's network stack:
+  *
+  *             ip tuntap add dev usb0 mode tap user $USER
+  *             ip addr add 192.168.7.2/24 dev usb0 && ip link set usb0 up
+  *             net_tap --class rndis --tap usb0
+  *             ping 192.168.7.1; iperf -c 192.168.7.1 -u -b 100M
+  *
+  *           ECM answers on 192.168.8.1. Ctrl-C prints the counters.
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_perf.h"
+#include "sim_pcd.h"
+#include "usbd_cdc_rndis_if.h"
+#include "usbd_cdc_ecm_if.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Private define ------------------------------------------------------------*/
+#define NET_CLASS_RNDIS                  0U
+#define NET_CLASS_ECM                    1U
+
+#define NET_LOAD_ECHO                    0U
+#define NET_LOAD_RX                      1U
+#define NET_LOAD_TX                      2U
+
+#define NET_ALL                          0xFFU
+
+#define NET_FRAME_SIZE                   1514U
+#define NET_XFER_SIZE                    16384U  /* Largest transfer the host takes or builds */
+#define NET_CTRL_SIZE                    1024U
+#define NET_QUEUE_DEPTH                  64U
+#define NET_NOTIF_BURST                  4U      /* Events raised back to back */
+#define NET_RNDIS_PKT_HLEN               44U
+#define NET_RNDIS_FILTER                 0x0000002DUL /* Directed, all multicast, broadcast, promiscuous */
+
+#define NET_TEST_PORT                    5000U
+#define NET_SRC_PORT                     4000U
+#define NET_DEV_PORT                     4001U
+#define NET_HOST_PORT                    6000U
+#define NET_ECHO_ID                      0x4E54U
+
+#define NET_STALL_NS                     1000000000ULL
+#define NET_SETTLE_NS                    5000000ULL  /* Longer than CDC_RNDIS_TX_FLUSH_TIMEOUT */
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  const char *name;
+  uint8_t id;
+  USBD_ClassTypeDef *cls;
+  uint8_t *in_ep;
+  uint8_t *out_ep;
+  uint8_t *cmd_ep;
+  uint8_t *cmd_itf;
+  USBD_UDP_HandleTypeDef *udp;
+  USBD_Iperf_HandleTypeDef *iperf;
+  void (*process)(void);
+  uint8_t hwaddr[6];
+  uint32_t ipaddr;
+} Net_ClassTypeDef;
+
+typedef struct
+{
+  uint32_t len;
+  int32_t tag;             /* Echo sequence number, -1 for other frames */
+  uint8_t data[NET_FRAME_SIZE];
+} Net_FrameTypeDef;
+
+typedef struct
+{
+  uint8_t load;
+  uint16_t size;
+  uint32_t count;
+} Net_TestTypeDef;
+
+typedef struct
+{
+  HOST_PerfTypeDef cost;
+  HOST_PerfTypeDef idle;
+  uint32_t frames;
+  uint64_t bytes;
+  uint32_t lost;
+  uint32_t errors;
+  uint32_t lat_count;
+  double lat_p50;
+  double lat_p99;
+  double lat_max;
+} Net_ResultTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *Net_ClassName[] = { "rndis", "ecm" };
+static const char *Net_LoadName[] = { "echo", "rx", "tx" };
+static const char *Net_SpeedName[] = { "hs", "fs" };
+
+static Net_ClassTypeDef Net_Classes[2] =
+{
+  {
+    "rndis", NET_CLASS_RNDIS, &USBD_CDC_RNDIS, &CDC_RNDIS_IN_EP, &CDC_RNDIS_OUT_EP, &CDC_RNDIS_CMD_EP,
+    &CDC_RNDIS_CMD_ITF_NBR, &CDC_RNDIS_Udp, &CDC_RNDIS_Iperf, CDC_RNDIS_Process,
+    CDC_RNDIS_NETIF_HWADDR, CDC_RNDIS_NETIF_IPADDR
+  },
+  {
+    "ecm", NET_CLASS_ECM, &USBD_CDC_ECM, &CDC_ECM_IN_EP, &CDC_ECM_OUT_EP, &CDC_ECM_CMD_EP,
+    &CDC_ECM_CMD_ITF_NBR, &CDC_ECM_Udp, &CDC_ECM_Iperf, CDC_ECM_Process,
+    CDC_ECM_NETIF_HWADDR, CDC_ECM_NETIF_IPADDR
+  },
+};
+
+/* The interface files drive the class through it */
+USBD_HandleTypeDef hUsbDevice;
+
+static Net_ClassTypeDef *Net_Cls;
+static uint8_t Net_HostMac[6];
+static uint32_t Net_HostIp;
+static uint32_t Net_ReqId;
+
+/* RNDIS INITIALIZE_CMPLT */
+static uint32_t Net_DevMaxPackets;
+static uint32_t Net_DevMaxTransfer;
+
+static Net_FrameTypeDef Net_Queue[NET_QUEUE_DEPTH];
+static uint32_t Net_QueueHead;
+static uint32_t Net_QueueTail;
+static uint32_t Net_Aggr = 1U;
+
+static uint8_t Net_Xfer[NET_XFER_SIZE + 4U];
+static uint8_t Net_In[NET_XFER_SIZE];
+
+/* Host side counters of the current class */
+static uint32_t Net_HostTx;
+static uint32_t Net_HostRx;
+static uint32_t Net_Notifications;
+
+/* Checks of the current load */
+static const Net_TestTypeDef *Net_Test;
+static uint64_t *Net_SentNs;
+static uint8_t *Net_Seen;
+static double *Net_Lat;
+static uint32_t Net_Done;
+static uint32_t Net_TxExpect;
+
+static HOST_PerfTypeDef *Net_Cost;
+static HOST_PerfTypeDef *Net_Idle;
+static HOST_PerfTypeDef Net_Unused;
+static uint32_t Net_Failures;
+static uint8_t Net_Quiet;
+
+static int Net_Fd = -1;
+static volatile sig_atomic_t Net_Stop;
+
+/* Helpers -------------------------------------------------------------------*/
+
+static void Net_Fail(const char *fmt, ...)
+{
+  va_list ap;
+
+  Net_Failures++;
+  (void)fprintf(stderr, "FAIL: %s: ", (Net_Cls != NULL) ? Net_Cls->name : "-");
+  va_start(ap, fmt);
+  (void)vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  (void)fprintf(stderr, "\n");
+}
+
+static uint64_t Net_NowNs(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static uint16_t Net_Get16(const uint8_t *p)
+{
+  return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static uint32_t Net_Get32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void Net_Put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static void Net_Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+/* RNDIS messages are little endian */
+static uint32_t Net_Le32(const uint8_t *p)
+{
+  return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void Net_PutLe32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+/* Reference checksum, byte by byte and independent of usbd_csum.c */
+static uint16_t Net_Csum(const uint8_t *data, uint32_t len, uint32_t sum)
+{
+  uint64_t acc = sum;
+  uint32_t i;
+
+  for (i = 0U; i < len; i++)
+  {
+    acc += ((i & 1U) == 0U) ? ((uint32_t)data[i] << 8) : data[i];
+  }
+  while ((acc >> 16) != 0U)
+  {
+    acc = (acc & 0xFFFFU) + (acc >> 16);
+  }
+
+  return (uint16_t)~acc;
+}
+
+static uint8_t Net_Pattern(uint32_t seq, uint32_t i)
+{
+  return (uint8_t)(seq + i);
+}
+
+static int Net_CompareDouble(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Device side, everything here is accounted ---------------------------------*/
+
+static void Net_Setup(USBD_SetupReqTypedef *req)
+{
+  HOST_Perf_Begin();
+  (void)Net_Cls->cls->Setup(&hUsbDevice, req);
+  HOST_Perf_End(Net_Cost);
+}
+
+static void Net_EP0RxReady(void)
+{
+  HOST_Perf_Begin();
+  (void)Net_Cls->cls->EP0_RxReady(&hUsbDevice);
+  HOST_Perf_End(Net_Cost);
+}
+
+static void Net_DataIn(uint8_t ep_addr)
+{
+  HOST_Perf_Begin();
+  (void)Net_Cls->cls->DataIn(&hUsbDevice, ep_addr & 0x7FU);
+  HOST_Perf_End(Net_Cost);
+}
+
+static void Net_DataOut(uint8_t ep_addr)
+{
+  HOST_Perf_Begin();
+  (void)Net_Cls->cls->DataOut(&hUsbDevice, ep_addr & 0x7FU);
+  HOST_Perf_End(Net_Cost);
+}
+
+/* One pass of the main loop, 1 if it moved anything */
+static uint8_t Net_Process(void)
+{
+  SIM_EpTypeDef *in = SIM_PCD_Ep(*Net_Cls->in_ep);
+  SIM_EpTypeDef *out = SIM_PCD_Ep(*Net_Cls->out_ep);
+  USBD_UDP_HandleTypeDef *udp = Net_Cls->udp;
+  HOST_PerfTypeDef pass = { 0U, 0U, 0U };
+  HOST_PerfTypeDef *acc;
+  uint8_t in_armed = in->armed;
+  uint8_t out_armed = out->armed;
+  uint32_t rx = udp->rx_frames;
+  uint32_t tx = udp->tx_datagrams + udp->arp_replies + udp->echo_replies;
+  uint8_t progress;
+
+  HOST_Perf_Begin();
+  Net_Cls->process();
+  HOST_Perf_End(&pass);
+
+  progress = ((in->armed != in_armed) || (out->armed != out_armed) || (udp->rx_frames != rx) ||
+              ((udp->tx_datagrams + udp->arp_replies + udp->echo_replies) != tx)) ? 1U : 0U;
+
+  acc = (progress != 0U) ? Net_Cost : Net_Idle;
+  acc->ns += pass.ns;
+  acc->instr += pass.instr;
+  acc->calls++;
+
+  return progress;
+}
+
+/* Datagram of the tx load, sent by the application from the main loop */
+static uint8_t Net_AppSend(USBD_UDP_FlowTypeDef *flow, uint32_t seq, uint16_t size)
+{
+  uint8_t *payload;
+  uint8_t ret;
+  uint32_t i;
+
+  payload = USBD_UDP_Alloc(Net_Cls->udp);
+  if (payload == NULL)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+
+  /* Writing the payload is the application's part, left out */
+  Net_Put32(payload, seq);
+  for (i = 4U; i < size; i++)
+  {
+    payload[i] = Net_Pattern(seq, i);
+  }
+
+  HOST_Perf_Begin();
+  ret = USBD_UDP_Send(Net_Cls->udp, flow, payload, size);
+  if (ret != (uint8_t)USBD_OK)
+  {
+    USBD_UDP_Free(Net_Cls->udp, payload);
+  }
+  HOST_Perf_End(Net_Cost);
+
+  return ret;
+}
+
+/* Host side: frames -------------------------------------------------------*/
+
+static uint32_t Net_EthHeader(uint8_t *frame, uint16_t type)
+{
+  (void)memcpy(frame, Net_Cls->hwaddr, 6U);
+  (void)memcpy(&frame[6], Net_HostMac, 6U);
+  Net_Put16(&frame[12], type);
+
+  return 14U;
+}
+
+static void Net_IpHeader(uint8_t *ip, uint8_t proto, uint16_t payload_len)
+{
+  (void)memset(ip, 0, 20U);
+  ip[0] = 0x45U;
+  Net_Put16(&ip[2], (uint16_t)(20U + payload_len));
+  Net_Put16(&ip[4], (uint16_t)Net_HostTx);
+  ip[8] = 64U;
+  ip[9] = proto;
+  Net_Put32(&ip[12], Net_HostIp);
+  Net_Put32(&ip[16], Net_Cls->ipaddr);
+  Net_Put16(&ip[10], Net_Csum(ip, 20U, 0U));
+}
+
+static uint32_t Net_PseudoSum(const uint8_t *ip, uint16_t len)
+{
+  return Net_Get16(&ip[12]) + Net_Get16(&ip[14]) + Net_Get16(&ip[16]) + Net_Get16(&ip[18]) +
+         ip[9] + len;
+}
+
+static uint8_t Net_QueueFull(void)
+{
+  return ((Net_QueueHead - Net_QueueTail) == NET_QUEUE_DEPTH) ? 1U : 0U;
+}
+
+/* Room for one frame at the head of the queue, NULL when full */
+static Net_FrameTypeDef *Net_QueueAlloc(void)
+{
+  Net_FrameTypeDef *f;
+
+  if (Net_QueueFull() != 0U)
+  {
+    return NULL;
+  }
+
+  f = &Net_Queue[Net_QueueHead % NET_QUEUE_DEPTH];
+  f->tag = -1;
+  return f;
+}
+
+static void Net_QueueEcho(uint32_t seq, uint16_t size)
+{
+  Net_FrameTypeDef *f = Net_QueueAlloc();
+  uint8_t *ip = &f->data[14];
+  uint8_t *icmp = &f->data[34];
+  uint32_t i;
+
+  (void)Net_EthHeader(f->data, 0x0800U);
+  Net_IpHeader(ip, 1U, (uint16_t)(8U + size));
+  icmp[0] = 8U;
+  icmp[1] = 0U;
+  Net_Put16(&icmp[2], 0U);
+  Net_Put16(&icmp[4], NET_ECHO_ID);
+  Net_Put16(&icmp[6], (uint16_t)seq);
+  for (i = 0U; i < size; i++)
+  {
+    icmp[8U + i] = Net_Pattern(seq, i);
+  }
+  Net_Put16(&icmp[2], Net_Csum(icmp, 8U + size, 0U));
+
+  f->len = 42U + size;
+  f->tag = (int32_t)seq;
+  Net_QueueHead++;
+}
+
+static void Net_QueueDatagram(uint32_t seq, uint16_t size)
+{
+  Net_FrameTypeDef *f = Net_QueueAlloc();
+  uint8_t *ip = &f->data[14];
+  uint8_t *udp = &f->data[34];
+  uint16_t udp_len = (uint16_t)(8U + size);
+  uint32_t i;
+
+  (void)Net_EthHeader(f->data, 0x0800U);
+  Net_IpHeader(ip, 17U, udp_len);
+  Net_Put16(&udp[0], NET_SRC_PORT);
+  Net_Put16(&udp[2], NET_TEST_PORT);
+  Net_Put16(&udp[4], udp_len);
+  Net_Put16(&udp[6], 0U);
+  Net_Put32(&udp[8], seq);
+  for (i = 4U; i < size; i++)
+  {
+    udp[8U + i] = Net_Pattern(seq, i);
+  }
+  Net_Put16(&udp[6], Net_Csum(udp, udp_len, Net_PseudoSum(ip, udp_len)));
+
+  f->len = 42U + size;
+  Net_QueueHead++;
+}
+
+/* Answer to the device's ARP request for the host address */
+static void Net_QueueArpReply(void)
+{
+  Net_FrameTypeDef *f = Net_QueueAlloc();
+  uint8_t *arp = &f->data[14];
+
+  if (f == NULL)
+  {
+    return;
+  }
+
+  (void)Net_EthHeader(f->data, 0x0806U);
+  Net_Put16(&arp[0], 1U);
+  Net_Put16(&arp[2], 0x0800U);
+  arp[4] = 6U;
+  arp[5] = 4U;
+  Net_Put16(&arp[6], 2U);
+  (void)memcpy(&arp[8], Net_HostMac, 6U);
+  Net_Put32(&arp[14], Net_HostIp);
+  (void)memcpy(&arp[18], Net_Cls->hwaddr, 6U);
+  Net_Put32(&arp[24], Net_Cls->ipaddr);
+
+  f->len = 42U;
+  Net_QueueHead++;
+}
+
+static void Net_CheckEcho(const uint8_t *ip, const uint8_t *icmp, uint32_t len, uint64_t now)
+{
+  uint32_t seq = Net_Get16(&icmp[6]);
+  uint32_t size;
+  uint32_t i;
+
+  if ((Net_Test == NULL) || (Net_Test->load != NET_LOAD_ECHO))
+  {
+    Net_Fail("unexpected ICMP message");
+    return;
+  }
+
+  size = Net_Test->size;
+  if ((len != (42U + size)) || (Net_Get16(&ip[2]) != (28U + size)) || (icmp[0] != 0U) ||
+      (Net_Get16(&icmp[4]) != NET_ECHO_ID) || (seq >= Net_Test->count) ||
+      (Net_Csum(icmp, 8U + size, 0U) != 0U))
+  {
+    Net_Fail("echo reply %u: bad header, length %u or checksum", seq, len);
+    return;
+  }
+
+  for (i = 0U; i < size; i++)
+  {
+    if (icmp[8U + i] != Net_Pattern(seq, i))
+    {
+      Net_Fail("echo reply %u: payload differs at %u", seq, i);
+      return;
+    }
+  }
+
+  if (Net_Seen[seq] != 0U)
+  {
+    Net_Fail("echo reply %u: duplicate", seq);
+    return;
+  }
+
+  Net_Seen[seq] = 1U;
+  Net_Lat[Net_Done] = (double)(now - Net_SentNs[seq]) / 1000.0;
+  Net_Done++;
+}
+
+static void Net_CheckDatagram(const uint8_t *ip, const uint8_t *udp, uint32_t len)
+{
+  uint32_t seq = Net_Get32(&udp[8]);
+  uint32_t size;
+  uint32_t i;
+
+  if ((Net_Test == NULL) || (Net_Test->load != NET_LOAD_TX))
+  {
+    Net_Fail("unexpected UDP datagram");
+    return;
+  }
+
+  size = Net_Test->size;
+  if ((len != (42U + size)) || (Net_Get16(&udp[0]) != NET_DEV_PORT) ||
+      (Net_Get16(&udp[2]) != NET_HOST_PORT) || (Net_Get16(&udp[4]) != (8U + size)))
+  {
+    Net_Fail("datagram %u: bad UDP header or length %u", seq, len);
+    return;
+  }
+
+#if (USBD_UDP_TX_CHECKSUM == 1U)
+  if ((Net_Get16(&udp[6]) == 0U) ||
+      (Net_Csum(udp, 8U + size, Net_PseudoSum(ip, (uint16_t)(8U + size))) != 0U))
+  {
+    Net_Fail("datagram %u: bad UDP checksum 0x%04x", seq, Net_Get16(&udp[6]));
+    return;
+  }
+#else
+  (void)ip;
+#endif /* USBD_UDP_TX_CHECKSUM */
+
+  if (seq != Net_TxExpect)
+  {
+    Net_Fail("datagram %u: expected %u", seq, Net_TxExpect);
+  }
+  Net_TxExpect = seq + 1U;
+
+  for (i = 4U; i < size; i++)
+  {
+    if (udp[8U + i] != Net_Pattern(seq, i))
+    {
+      Net_Fail("datagram %u: payload differs at %u", seq, i);
+      return;
+    }
+  }
+
+  Net_Done++;
+}
+
+/* Frame the device sent, self-test */
+static void Net_CheckFrame(const uint8_t *frame, uint32_t len, uint64_t now)
+{
+  const uint8_t *arp = &frame[14];
+  const uint8_t *ip = &frame[14];
+
+  if ((len < 42U) || (memcmp(&frame[6], Net_Cls->hwaddr, 6U) != 0))
+  {
+    Net_Fail("runt frame or bad source address, %u bytes", len);
+    return;
+  }
+
+  if (Net_Get16(&frame[12]) == 0x0806U)
+  {
+    if ((Net_Get16(&arp[6]) == 1U) && (Net_Get32(&arp[24]) == Net_HostIp))
+    {
+      Net_QueueArpReply();
+    }
+    return;
+  }
+
+  if ((Net_Get16(&frame[12]) != 0x0800U) || (memcmp(frame, Net_HostMac, 6U) != 0) ||
+      (ip[0] != 0x45U) || (Net_Get32(&ip[12]) != Net_Cls->ipaddr) ||
+      (Net_Get32(&ip[16]) != Net_HostIp) || (Net_Csum(ip, 20U, 0U) != 0U))
+  {
+    Net_Fail("bad Ethernet or IP header");
+    return;
+  }
+
+  if (ip[9] == 1U)
+  {
+    Net_CheckEcho(ip, &frame[34], len, now);
+  }
+  else if (ip[9] == 17U)
+  {
+    Net_CheckDatagram(ip, &frame[34], len);
+  }
+  else
+  {
+    Net_Fail("unexpected IP protocol %u", ip[9]);
+  }
+}
+
+static void Net_HostFrame(const uint8_t *frame, uint32_t len, uint64_t now)
+{
+  Net_HostRx++;
+
+  if (Net_Fd >= 0)
+  {
+    /* EIO while the interface is down, the frame is lost like on a cable */
+    if ((write(Net_Fd, frame, len) < 0) && (errno != EIO))
+    {
+      perror("tap write");
+    }
+    return;
+  }
+
+  Net_CheckFrame(frame, len, now);
+}
+
+/* Host side: class framing --------------------------------------------------*/
+
+/* Frames of one IN transfer */
+static void Net_Unwrap(const uint8_t *xfer, uint32_t len, uint64_t now)
+{
+  uint32_t offset = 0U;
+  uint32_t msg_len;
+  uint32_t data_offset;
+  uint32_t data_len;
+
+  if (Net_Cls->id == NET_CLASS_ECM)
+  {
+    Net_HostFrame(xfer, len, now);
+    return;
+  }
+
+  while ((offset + NET_RNDIS_PKT_HLEN) <= len)
+  {
+    msg_len = Net_Le32(&xfer[offset + 4U]);
+    data_offset = Net_Le32(&xfer[offset + 8U]) + 8U;
+    data_len = Net_Le32(&xfer[offset + 12U]);
+
+    if ((Net_Le32(&xfer[offset]) != CDC_RNDIS_PACKET_MSG_ID) || (msg_len < NET_RNDIS_PKT_HLEN) ||
+        ((msg_len & 3U) != 0U) || (msg_len > (len - offset)) || (data_offset < NET_RNDIS_PKT_HLEN) ||
+        ((data_offset + data_len) > msg_len))
+    {
+      Net_Fail("malformed PACKET_MSG at %u of %u", offset, len);
+      return;
+    }
+
+    Net_HostFrame(&xfer[offset + data_offset], data_len, now);
+    offset += msg_len;
+  }
+
+  if (offset != len)
+  {
+    Net_Fail("%u bytes left in an IN transfer of %u", len - offset, len);
+  }
+}
+
+/* Next OUT transfer from the queue, the endpoint is armed */
+static void Net_Submit(void)
+{
+  SIM_EpTypeDef *out = SIM_PCD_Ep(*Net_Cls->out_ep);
+  Net_FrameTypeDef *f;
+  uint64_t now;
+  uint32_t len = 0U;
+  uint32_t msg_len;
+  uint32_t chunk;
+  uint32_t count = 0U;
+  uint32_t limit;
+
+  if (Net_Cls->id == NET_CLASS_ECM)
+  {
+    f = &Net_Queue[Net_QueueTail % NET_QUEUE_DEPTH];
+    Net_QueueTail++;
+    Net_HostTx++;
+
+    if (f->tag >= 0)
+    {
+      Net_SentNs[f->tag] = Net_NowNs();
+    }
+
+    /* Split in packets like the host controller, the class re-arms for each */
+    do
+    {
+      chunk = ((f->len - len) < out->mps) ? (f->len - len) : out->mps;
+      if (SIM_PCD_OutReady(*Net_Cls->out_ep) == 0U)
+      {
+        Net_Fail("OUT endpoint not armed within a frame");
+        return;
+      }
+      (void)SIM_PCD_PutOut(*Net_Cls->out_ep, &f->data[len], chunk);
+      Net_DataOut(*Net_Cls->out_ep);
+      len += chunk;
+    } while (len < f->len);
+
+    /* Terminates a frame of a whole number of packets */
+    if (((f->len % out->mps) == 0U) && (f->len < CDC_ECM_ETH_MAX_SEGSZE))
+    {
+      (void)SIM_PCD_PutOut(*Net_Cls->out_ep, NULL, 0U);
+      Net_DataOut(*Net_Cls->out_ep);
+    }
+    return;
+  }
+
+  /* RNDIS: as many PACKET_MSGs as the device and --aggr allow */
+  limit = (Net_Aggr < Net_DevMaxPackets) ? Net_Aggr : Net_DevMaxPackets;
+  now = Net_NowNs();
+
+  while ((Net_QueueTail != Net_QueueHead) && (count < limit))
+  {
+    f = &Net_Queue[Net_QueueTail % NET_QUEUE_DEPTH];
+    msg_len = (NET_RNDIS_PKT_HLEN + f->len + 3U) & ~3U;
+
+    if ((len + msg_len) > out->len)
+    {
+      break;
+    }
+
+    (void)memset(&Net_Xfer[len], 0, msg_len);
+    Net_PutLe32(&Net_Xfer[len], CDC_RNDIS_PACKET_MSG_ID);
+    Net_PutLe32(&Net_Xfer[len + 4U], msg_len);
+    Net_PutLe32(&Net_Xfer[len + 8U], NET_RNDIS_PKT_HLEN - 8U);
+    Net_PutLe32(&Net_Xfer[len + 12U], f->len);
+    (void)memcpy(&Net_Xfer[len + NET_RNDIS_PKT_HLEN], f->data, f->len);
+
+    if (f->tag >= 0)
+    {
+      Net_SentNs[f->tag] = now;
+    }
+
+    len += msg_len;
+    count++;
+    Net_QueueTail++;
+    Net_HostTx++;
+  }
+
+  /* Like the Linux host, one filler byte instead of a ZLP */
+  if (((len % out->mps) == 0U) && (len < out->len))
+  {
+    Net_Xfer[len] = 0U;
+    len++;
+  }
+
+  if (SIM_PCD_PutOut(*Net_Cls->out_ep, Net_Xfer, len) != len)
+  {
+    Net_Fail("OUT transfer of %u bytes truncated", len);
+  }
+  Net_DataOut(*Net_Cls->out_ep);
+}
+
+/* Moves what is ready in both directions, 1 if anything moved */
+static uint8_t Net_Pump(void)
+{
+  uint8_t notif[16];
+  uint8_t progress = 0U;
+  uint32_t len;
+  uint64_t now;
+
+  while (SIM_PCD_InReady(*Net_Cls->cmd_ep) != 0U)
+  {
+    (void)SIM_PCD_TakeIn(*Net_Cls->cmd_ep, notif, sizeof(notif));
+    Net_Notifications++;
+    Net_DataIn(*Net_Cls->cmd_ep);
+    progress = 1U;
+  }
+
+  while (SIM_PCD_InReady(*Net_Cls->in_ep) != 0U)
+  {
+    len = SIM_PCD_TakeIn(*Net_Cls->in_ep, Net_In, sizeof(Net_In));
+    now = Net_NowNs();
+    Net_DataIn(*Net_Cls->in_ep);
+
+    if (len != 0U)
+    {
+      Net_Unwrap(Net_In, len, now);
+    }
+    progress = 1U;
+  }
+
+  if ((Net_QueueTail != Net_QueueHead) && (SIM_PCD_OutReady(*Net_Cls->out_ep) != 0U))
+  {
+    Net_Submit();
+    progress = 1U;
+  }
+
+  if (Net_Process() != 0U)
+  {
+    progress = 1U;
+  }
+
+  return progress;
+}
+
+/* Pumps until nothing moved for NET_SETTLE_NS */
+static void Net_Settle(void)
+{
+  uint64_t last = Net_NowNs();
+
+  while ((Net_NowNs() - last) < NET_SETTLE_NS)
+  {
+    if (Net_Pump() != 0U)
+    {
+      last = Net_NowNs();
+    }
+  }
+}
+
+/* Host side: control ------------------------------------------------------*/
+
+static void Net_SetupReq(USBD_SetupReqTypedef *req, uint8_t bmRequest, uint8_t bRequest,
+                         uint16_t wValue, uint16_t wLength)
+{
+  req->bmRequest = bmRequest;
+  req->bRequest = bRequest;
+  req->wValue = wValue;
+  req->wIndex = *Net_Cls->cmd_itf;
+  req->wLength = wLength;
+}
+
+/* SEND_ENCAPSULATED_COMMAND, 1 if the device took the message whole */
+static uint8_t Net_RndisSend(const uint8_t *msg, uint32_t len)
+{
+  USBD_SetupReqTypedef req;
+
+  Net_SetupReq(&req, 0x21U, CDC_RNDIS_SEND_ENCAPSULATED_COMMAND, 0U, (uint16_t)len);
+  Net_Setup(&req);
+
+  if ((SIM_PCD_OutReady(0x00U) == 0U) || (SIM_PCD_PutOut(0x00U, msg, len) != len))
+  {
+    Net_Fail("control message 0x%x of %u bytes not taken whole", Net_Le32(msg), len);
+    return 0U;
+  }
+  Net_EP0RxReady();
+
+  return 1U;
+}
+
+/* GET_ENCAPSULATED_RESPONSE, length of a successful completion of msg */
+static uint32_t Net_RndisGet(const uint8_t *msg, uint8_t *resp)
+{
+  USBD_SetupReqTypedef req;
+  uint32_t n;
+
+  Net_SetupReq(&req, 0xA1U, CDC_RNDIS_GET_ENCAPSULATED_RESPONSE, 0U, NET_CTRL_SIZE);
+  Net_Setup(&req);
+
+  n = (SIM_PCD_InReady(0x80U) != 0U) ? SIM_PCD_TakeIn(0x80U, resp, NET_CTRL_SIZE) : 0U;
+  if ((n < 16U) || (Net_Le32(resp) != (Net_Le32(msg) | 0x80000000UL)) ||
+      (Net_Le32(&resp[4]) != n) || (Net_Le32(&resp[8]) != Net_Le32(&msg[8])))
+  {
+    Net_Fail("bad response to message 0x%x, %u bytes", Net_Le32(msg), n);
+    return 0U;
+  }
+
+  if (Net_Le32(&resp[12]) != CDC_RNDIS_STATUS_SUCCESS)
+  {
+    Net_Fail("message 0x%x failed with status 0x%x", Net_Le32(msg), Net_Le32(&resp[12]));
+    return 0U;
+  }
+
+  return n;
+}
+
+/* SEND_ENCAPSULATED_COMMAND, then GET_ENCAPSULATED_RESPONSE once notified */
+static uint32_t Net_RndisRequest(const uint8_t *msg, uint32_t len, uint8_t *resp)
+{
+  uint8_t notif[8];
+
+  if (Net_RndisSend(msg, len) == 0U)
+  {
+    return 0U;
+  }
+
+  if ((SIM_PCD_InReady(*Net_Cls->cmd_ep) == 0U) ||
+      (SIM_PCD_TakeIn(*Net_Cls->cmd_ep, notif, sizeof(notif)) != 8U) ||
+      (notif[1] != (uint8_t)RNDIS_RESPONSE_AVAILABLE))
+  {
+    Net_Fail("no RESPONSE_AVAILABLE for message 0x%x", Net_Le32(msg));
+    return 0U;
+  }
+  Net_Notifications++;
+  Net_DataIn(*Net_Cls->cmd_ep);
+
+  return Net_RndisGet(msg, resp);
+}
+
+/* Value of a 32-bit OID, or the first bytes of a longer one */
+static uint32_t Net_RndisQuery(uint32_t oid, uint8_t *info, uint32_t max)
+{
+  uint8_t msg[28];
+  uint8_t resp[NET_CTRL_SIZE];
+  uint32_t len;
+  uint32_t offset;
+
+  (void)memset(msg, 0, sizeof(msg));
+  Net_PutLe32(&msg[0], CDC_RNDIS_QUERY_MSG_ID);
+  Net_PutLe32(&msg[4], sizeof(msg));
+  Net_PutLe32(&msg[8], ++Net_ReqId);
+  Net_PutLe32(&msg[12], oid);
+
+  if (Net_RndisRequest(msg, sizeof(msg), resp) == 0U)
+  {
+    return 0U;
+  }
+
+  len = Net_Le32(&resp[16]);
+  offset = Net_Le32(&resp[20]) + 8U;
+  if ((offset + len) > Net_Le32(&resp[4]))
+  {
+    Net_Fail("QUERY 0x%08x: information buffer out of the message", oid);
+    return 0U;
+  }
+
+  (void)memcpy(info, &resp[offset], (len < max) ? len : max);
+  return len;
+}
+
+static uint32_t Net_RndisQuery32(uint32_t oid)
+{
+  uint8_t info[4] = { 0U, 0U, 0U, 0U };
+
+  if (Net_RndisQuery(oid, info, sizeof(info)) != 4U)
+  {
+    Net_Fail("QUERY 0x%08x: not 4 bytes", oid);
+  }
+
+  return Net_Le32(info);
+}
+
+static void Net_RndisStart(void)
+{
+  uint8_t msg[32];
+  uint8_t resp[NET_CTRL_SIZE];
+  uint32_t speed;
+
+  /* INITIALIZE: the device answers with its OUT limits */
+  (void)memset(msg, 0, sizeof(msg));
+  Net_PutLe32(&msg[0], CDC_RNDIS_INITIALIZE_MSG_ID);
+  Net_PutLe32(&msg[4], 24U);
+  Net_PutLe32(&msg[8], ++Net_ReqId);
+  Net_PutLe32(&msg[12], 1U);
+  Net_PutLe32(&msg[16], 0U);
+  Net_PutLe32(&msg[20], NET_XFER_SIZE);
+
+  if (Net_RndisRequest(msg, 24U, resp) < 52U)
+  {
+    Net_Fail("no INITIALIZE_CMPLT");
+    return;
+  }
+  Net_DevMaxPackets = Net_Le32(&resp[32]);
+  Net_DevMaxTransfer = Net_Le32(&resp[36]);
+
+  if ((Net_DevMaxPackets == 0U) || (Net_DevMaxTransfer < (NET_RNDIS_PKT_HLEN + NET_FRAME_SIZE)) ||
+      (Net_DevMaxTransfer > NET_XFER_SIZE) || (Net_Le32(&resp[40]) > 3U))
+  {
+    Net_Fail("INITIALIZE_CMPLT: %u packets of %u bytes, alignment %u", Net_DevMaxPackets,
+             Net_DevMaxTransfer, Net_Le32(&resp[40]));
+  }
+
+  /* The host adapter takes the permanent address, like rndis_host */
+  if (Net_RndisQuery(OID_802_3_PERMANENT_ADDRESS, Net_HostMac, 6U) != 6U)
+  {
+    Net_Fail("no permanent address");
+  }
+
+  speed = Net_RndisQuery32(OID_GEN_LINK_SPEED);
+  if ((USBD_CDC_RNDIS_LINK_SPEED == 0U) &&
+      (speed != (((hUsbDevice.dev_speed == USBD_SPEED_HIGH) ? CDC_RNDIS_HS_LINK_SPEED :
+                                                             CDC_RNDIS_FS_LINK_SPEED) / 100U)))
+  {
+    Net_Fail("link speed %u00 bit/s does not follow the bus", speed);
+  }
+
+  /* SET the packet filter, 32 bytes: longer than one control packet */
+  (void)memset(msg, 0, sizeof(msg));
+  Net_PutLe32(&msg[0], CDC_RNDIS_SET_MSG_ID);
+  Net_PutLe32(&msg[4], 32U);
+  Net_PutLe32(&msg[8], ++Net_ReqId);
+  Net_PutLe32(&msg[12], OID_GEN_CURRENT_PACKET_FILTER);
+  Net_PutLe32(&msg[16], 4U);
+  Net_PutLe32(&msg[20], 20U);
+  Net_PutLe32(&msg[28], NET_RNDIS_FILTER);
+
+  (void)Net_RndisRequest(msg, 32U, resp);
+
+  if (((USBD_CDC_RNDIS_HandleTypeDef *)hUsbDevice.pClassData_CDC_RNDIS)->PacketFilter !=
+      (NET_RNDIS_FILTER & 0xFFU))
+  {
+    Net_Fail("packet filter not set");
+  }
+}
+
+/* Statistics OIDs against what the host counted */
+static void Net_RndisCheckStats(void)
+{
+  uint32_t xmit_ok = Net_RndisQuery32(OID_GEN_XMIT_OK);
+  uint32_t rcv_ok = Net_RndisQuery32(OID_GEN_RCV_OK);
+  uint32_t xmit_error = Net_RndisQuery32(OID_GEN_XMIT_ERROR);
+  uint32_t rcv_error = Net_RndisQuery32(OID_GEN_RCV_ERROR);
+  uint32_t rcv_no_buffer = Net_RndisQuery32(OID_GEN_RCV_NO_BUFFER);
+
+  if ((xmit_ok != Net_HostRx) || (rcv_ok != Net_HostTx) || (xmit_error != 0U) ||
+      (rcv_error != 0U) || (rcv_no_buffer != 0U))
+  {
+    Net_Fail("statistics: xmit ok %u (host %u), rcv ok %u (host %u), errors %u/%u/%u",
+             xmit_ok, Net_HostRx, rcv_ok, Net_HostTx, xmit_error, rcv_error, rcv_no_buffer);
+  }
+}
+
+static uint8_t Net_Hex(char c)
+{
+  return (uint8_t)(((c >= '0') && (c <= '9')) ? (c - '0') : ((c | 0x20) - 'a' + 10));
+}
+
+static void Net_EcmStart(void)
+{
+  const char *mac = (const char *)USBD_CDC_ECM_fops.pStrDesc;
+  USBD_SetupReqTypedef req;
+  uint8_t notif[16];
+  uint32_t i;
+
+  /* iMACAddress is the host's address */
+  for (i = 0U; i < 6U; i++)
+  {
+    Net_HostMac[i] = (uint8_t)((Net_Hex(mac[2U * i]) << 4) | Net_Hex(mac[(2U * i) + 1U]));
+  }
+
+  /* The first SET_ETHERNET_PACKET_FILTER brings the link up */
+  Net_SetupReq(&req, 0x21U, CDC_ECM_SET_ETH_PACKET_FILTER, 0x000FU, 0U);
+  Net_Setup(&req);
+
+  if ((SIM_PCD_InReady(*Net_Cls->cmd_ep) == 0U) ||
+      (SIM_PCD_TakeIn(*Net_Cls->cmd_ep, notif, sizeof(notif)) != 8U) ||
+      (notif[1] != (uint8_t)ECM_NETWORK_CONNECTION) || (notif[2] != 1U))
+  {
+    Net_Fail("no NETWORK_CONNECTION notification");
+    return;
+  }
+  Net_Notifications++;
+  Net_DataIn(*Net_Cls->cmd_ep);
+
+  if ((SIM_PCD_InReady(*Net_Cls->cmd_ep) == 0U) ||
+      (SIM_PCD_TakeIn(*Net_Cls->cmd_ep, notif, sizeof(notif)) != 16U) ||
+      (notif[1] != (uint8_t)ECM_CONNECTION_SPEED_CHANGE))
+  {
+    Net_Fail("no CONNECTION_SPEED_CHANGE notification");
+    return;
+  }
+  Net_Notifications++;
+  Net_DataIn(*Net_Cls->cmd_ep);
+}
+
+/* Takes the CMD endpoint notifications for ms, at least one pass, counted
+   by code */
+static void Net_DrainNotifications(uint32_t ms, uint32_t *count)
+{
+  uint8_t notif[16];
+  uint32_t start = HAL_GetTick();
+
+  do
+  {
+    (void)Net_Process();
+
+    while (SIM_PCD_InReady(*Net_Cls->cmd_ep) != 0U)
+    {
+      (void)SIM_PCD_TakeIn(*Net_Cls->cmd_ep, notif, sizeof(notif));
+      count[(notif[1] == (uint8_t)ECM_CONNECTION_SPEED_CHANGE) ? 2U : (notif[1] & 1U)]++;
+      Net_Notifications++;
+      Net_DataIn(*Net_Cls->cmd_ep);
+    }
+  } while ((HAL_GetTick() - start) < ms);
+}
+
+/* Control bursts are merged on the interrupt endpoint */
+static void Net_CheckNotifications(void)
+{
+  uint8_t msg[12];
+  uint8_t resp[NET_CTRL_SIZE];
+  uint32_t count[3] = { 0U, 0U, 0U };
+  uint32_t i;
+
+  if (Net_Cls->id == NET_CLASS_RNDIS)
+  {
+    /* Keepalives answered while the first notification is still queued */
+    for (i = 0U; i < NET_NOTIF_BURST; i++)
+    {
+      Net_PutLe32(&msg[0], CDC_RNDIS_KEEPALIVE_MSG_ID);
+      Net_PutLe32(&msg[4], sizeof(msg));
+      Net_PutLe32(&msg[8], ++Net_ReqId);
+
+      if ((Net_RndisSend(msg, sizeof(msg)) == 0U) || (Net_RndisGet(msg, resp) == 0U))
+      {
+        return;
+      }
+    }
+
+    Net_DrainNotifications(0U, count);
+    if (count[RNDIS_RESPONSE_AVAILABLE] != 1U)
+    {
+      Net_Fail("%u RESPONSE_AVAILABLE for %u keepalives", count[RNDIS_RESPONSE_AVAILABLE],
+               NET_NOTIF_BURST);
+    }
+    return;
+  }
+
+  /* The link flaps back to what the host knows */
+  (void)USBD_CDC_ECM_SendNotification(&hUsbDevice, ECM_NETWORK_CONNECTION,
+                                      CDC_ECM_NET_DISCONNECTED, NULL);
+  (void)USBD_CDC_ECM_SendNotification(&hUsbDevice, ECM_NETWORK_CONNECTION,
+                                      CDC_ECM_NET_CONNECTED, NULL);
+
+  for (i = 0U; i < NET_NOTIF_BURST; i++)
+  {
+    (void)USBD_CDC_ECM_SendNotification(&hUsbDevice, ECM_RESPONSE_AVAILABLE, 0U, NULL);
+    (void)USBD_CDC_ECM_SendNotification(&hUsbDevice, ECM_CONNECTION_SPEED_CHANGE, 0U, NULL);
+  }
+
+  /* The first response goes out at once, the others wait for it as one */
+  Net_DrainNotifications(2U * CDC_ECM_NOTIF_INTERVAL, count);
+  if ((count[ECM_NETWORK_CONNECTION] != 0U) || (count[ECM_RESPONSE_AVAILABLE] != 2U) ||
+      (count[2] != 1U))
+  {
+    Net_Fail("notifications: %u connection, %u response, %u speed",
+             count[ECM_NETWORK_CONNECTION], count[ECM_RESPONSE_AVAILABLE], count[2]);
+  }
+}
+
+/* Enumerated, configured and link up */
+static void Net_Start(Net_ClassTypeDef *cls, USBD_SpeedTypeDef speed)
+{
+  Net_Cls = cls;
+  Net_Cost = &Net_Unused;
+  Net_Idle = &Net_Unused;
+  Net_QueueHead = 0U;
+  Net_QueueTail = 0U;
+  Net_HostTx = 0U;
+  Net_HostRx = 0U;
+  Net_Notifications = 0U;
+  Net_Test = NULL;
+
+  (void)memset(&hUsbDevice, 0, sizeof(hUsbDevice));
+  SIM_PCD_Reset(&hUsbDevice, speed);
+  Net_HostIp = cls->ipaddr + 1U;
+
+  if (cls->id == NET_CLASS_RNDIS)
+  {
+    (void)USBD_CDC_RNDIS_RegisterInterface(&hUsbDevice, &USBD_CDC_RNDIS_fops);
+    (void)cls->cls->Init(&hUsbDevice, 0U);
+    Net_RndisStart();
+  }
+  else
+  {
+    (void)USBD_CDC_ECM_RegisterInterface(&hUsbDevice, &USBD_CDC_ECM_fops);
+    (void)cls->cls->Init(&hUsbDevice, 0U);
+    Net_EcmStart();
+  }
+}
+
+static void Net_End(void)
+{
+  (void)Net_Cls->cls->DeInit(&hUsbDevice, 0U);
+}
+
+/* Self-test -----------------------------------------------------------------*/
+
+static void Net_LoadEcho(const Net_TestTypeDef *test, uint32_t window, Net_ResultTypeDef *res)
+{
+  uint32_t queued = 0U;
+  uint64_t last = Net_NowNs();
+
+  while (Net_Done < test->count)
+  {
+    while ((queued < test->count) && ((queued - Net_Done) < window) && (Net_QueueFull() == 0U))
+    {
+      Net_QueueEcho(queued, test->size);
+      queued++;
+    }
+
+    if (Net_Pump() != 0U)
+    {
+      last = Net_NowNs();
+    }
+    else if ((Net_NowNs() - last) > NET_STALL_NS)
+    {
+      break;
+    }
+  }
+
+  res->lost = test->count - Net_Done;
+  res->frames = 2U * Net_Done;
+  res->bytes = (uint64_t)res->frames * (42U + test->size);
+}
+
+static void Net_LoadRx(const Net_TestTypeDef *test, Net_ResultTypeDef *res)
+{
+  USBD_UDP_HandleTypeDef *udp = Net_Cls->udp;
+  uint32_t datagrams = udp->rx_datagrams;
+  uint32_t errors = udp->rx_errors;
+  uint32_t queued = 0U;
+
+  while (queued < test->count)
+  {
+    while ((queued < test->count) && (Net_QueueFull() == 0U))
+    {
+      Net_QueueDatagram(queued, test->size);
+      queued++;
+    }
+    (void)Net_Pump();
+  }
+  Net_Settle();
+
+  Net_Done = udp->rx_datagrams - datagrams;
+  if ((udp->rx_errors != errors) || (Net_Done > test->count))
+  {
+    Net_Fail("rx: %u datagrams for %u sent, %u errors", Net_Done, test->count, udp->rx_errors - errors);
+    res->errors++;
+  }
+
+  res->lost = test->count - Net_Done;
+  res->frames = Net_Done;
+  res->bytes = (uint64_t)res->frames * (42U + test->size);
+}
+
+static void Net_LoadTx(const Net_TestTypeDef *test, Net_ResultTypeDef *res)
+{
+  USBD_UDP_FlowTypeDef flow;
+  uint64_t last = Net_NowNs();
+  uint32_t sent = 0U;
+
+  /* The host answers the device's ARP request if it needs one */
+  while (USBD_UDP_OpenFlow(Net_Cls->udp, &flow, Net_HostIp, NET_DEV_PORT, NET_HOST_PORT) != (uint8_t)USBD_OK)
+  {
+    Net_Settle();
+    if ((Net_NowNs() - last) > NET_STALL_NS)
+    {
+      Net_Fail("tx: host address not resolved");
+      return;
+    }
+  }
+
+  while (Net_Done < test->count)
+  {
+    if ((sent < test->count) && (Net_AppSend(&flow, sent, test->size) == (uint8_t)USBD_OK))
+    {
+      sent++;
+      last = Net_NowNs();
+    }
+
+    if (Net_Pump() != 0U)
+    {
+      last = Net_NowNs();
+    }
+    else if ((Net_NowNs() - last) > NET_STALL_NS)
+    {
+      break;
+    }
+  }
+
+  res->lost = test->count - Net_Done;
+  res->frames = Net_Done;
+  res->bytes = (uint64_t)res->frames * (42U + test->size);
+}
+
+static void Net_RunLoad(const Net_TestTypeDef *test, uint32_t window, Net_ResultTypeDef *res)
+{
+  uint32_t failures = Net_Failures;
+
+  (void)memset(res, 0, sizeof(Net_ResultTypeDef));
+
+  Net_SentNs = calloc(test->count, sizeof(uint64_t));
+  Net_Seen = calloc(test->count, sizeof(uint8_t));
+  Net_Lat = calloc(test->count, sizeof(double));
+  if ((Net_SentNs == NULL) || (Net_Seen == NULL) || (Net_Lat == NULL))
+  {
+    perror("calloc");
+    exit(1);
+  }
+
+  Net_Test = test;
+  Net_Done = 0U;
+  Net_TxExpect = 0U;
+  Net_Cost = &res->cost;
+  Net_Idle = &res->idle;
+
+  switch (test->load)
+  {
+    case NET_LOAD_ECHO: Net_LoadEcho(test, window, res); break;
+    case NET_LOAD_RX: Net_LoadRx(test, res); break;
+    default: Net_LoadTx(test, res); break;
+  }
+
+  /* Leftovers (a late ARP reply, a flush) are not part of the load */
+  Net_Cost = &Net_Unused;
+  Net_Idle = &Net_Unused;
+  Net_Settle();
+  Net_Test = NULL;
+
+  if (res->lost != 0U)
+  {
+    Net_Fail("%s %u: %u of %u frames lost", Net_LoadName[test->load], test->size, res->lost, test->count);
+  }
+  res->errors += Net_Failures - failures;
+
+  if ((test->load == NET_LOAD_ECHO) && (Net_Done != 0U))
+  {
+    qsort(Net_Lat, Net_Done, sizeof(double), Net_CompareDouble);
+    res->lat_count = Net_Done;
+    res->lat_p50 = Net_Lat[Net_Done / 2U];
+    res->lat_p99 = Net_Lat[((Net_Done * 99U) / 100U < Net_Done) ? ((Net_Done * 99U) / 100U) : (Net_Done - 1U)];
+    res->lat_max = Net_Lat[Net_Done - 1U];
+  }
+
+  free(Net_SentNs);
+  free(Net_Seen);
+  free(Net_Lat);
+  Net_SentNs = NULL;
+  Net_Seen = NULL;
+  Net_Lat = NULL;
+}
+
+static void Net_Report(FILE *out, uint8_t csv, const Net_TestTypeDef *test, const Net_ResultTypeDef *res)
+{
+  uint32_t frames = (res->frames != 0U) ? res->frames : 1U;
+  double ns = (double)res->cost.ns / frames;
+  double instr = (double)res->cost.instr / frames;
+  double mbps = (res->cost.ns != 0U) ? ((double)res->bytes * 8000.0 / (double)res->cost.ns) : 0.0;
+
+  if (csv != 0U)
+  {
+    (void)fprintf(out, "%s,%s,%u,%u,%.1f,%.1f,%.0f,%.1f,%.1f,%.1f,%llu,%u,%u\n", Net_Cls->name,
+                  Net_LoadName[test->load], test->size, res->frames, ns,
+                  (HOST_Perf_HasInstr() != 0U) ? instr : 0.0, mbps, res->lat_p50, res->lat_p99,
+                  res->lat_max, (unsigned long long)res->idle.calls, res->lost, res->errors);
+    return;
+  }
+
+  (void)fprintf(out, "%-5s %-4s %6u %7u %9.1f ", Net_Cls->name, Net_LoadName[test->load],
+                test->size, res->frames, ns);
+  if (HOST_Perf_HasInstr() != 0U)
+  {
+    (void)fprintf(out, "%11.1f ", instr);
+  }
+  else
+  {
+    (void)fprintf(out, "%11s ", "-");
+  }
+  (void)fprintf(out, "%8.0f ", mbps);
+  if (res->lat_count != 0U)
+  {
+    (void)fprintf(out, "%8.1f %8.1f %8.1f ", res->lat_p50, res->lat_p99, res->lat_max);
+  }
+  else
+  {
+    (void)fprintf(out, "%8s %8s %8s ", "-", "-", "-");
+  }
+  (void)fprintf(out, "%9llu %5u %6u\n", (unsigned long long)res->idle.calls, res->lost, res->errors);
+}
+
+static int Net_SelfTest(uint8_t cls, uint8_t load, uint16_t size, uint32_t count, uint32_t window,
+                        USBD_SpeedTypeDef speed, const char *csv)
+{
+  static const uint16_t default_size[] = { 64U, 512U, 1472U };
+  Net_TestTypeDef test;
+  Net_ResultTypeDef res;
+  FILE *csv_out = NULL;
+  uint8_t c, l, x;
+
+  HOST_Perf_Init();
+
+  if (csv != NULL)
+  {
+    csv_out = fopen(csv, "w");
+    if (csv_out == NULL)
+    {
+      perror(csv);
+      return 1;
+    }
+    (void)fprintf(csv_out, "class,load,size,frames,ns_per_frame,instr_per_frame,cpu_mbps,"
+                           "lat_p50_us,lat_p99_us,lat_max_us,idle_polls,lost,errors\n");
+  }
+
+  if (Net_Quiet == 0U)
+  {
+    (void)printf("%-5s %-4s %6s %7s %9s %11s %8s %8s %8s %8s %9s %5s %6s\n", "class", "load", "size",
+                 "frames", "ns/frame", "instr/frame", "cpu Mb/s", "p50 us", "p99 us", "max us",
+                 "idle", "lost", "errors");
+  }
+
+  for (c = 0U; c < 2U; c++)
+  {
+    if ((cls != NET_ALL) && (cls != c))
+    {
+      continue;
+    }
+
+    Net_Start(&Net_Classes[c], speed);
+
+    for (l = 0U; l < 3U; l++)
+    {
+      for (x = 0U; x < 3U; x++)
+      {
+        if (((load != NET_ALL) && (load != l)) || ((size != 0U) && (x != 0U)))
+        {
+          continue;
+        }
+
+        test.load = l;
+        test.size = (size != 0U) ? size : default_size[x];
+        test.count = count;
+
+        Net_RunLoad(&test, window, &res);
+
+        if (Net_Quiet == 0U)
+        {
+          Net_Report(stdout, 0U, &test, &res);
+        }
+        if (csv_out != NULL)
+        {
+          Net_Report(csv_out, 1U, &test, &res);
+        }
+      }
+    }
+
+    if (Net_Cls->id == NET_CLASS_RNDIS)
+    {
+      Net_RndisCheckStats();
+    }
+    Net_CheckNotifications();
+    if (Net_Cls->udp->rx_errors != 0U)
+    {
+      Net_Fail("%u frames rejected by the responder", Net_Cls->udp->rx_errors);
+    }
+    Net_End();
+  }
+
+  if (csv_out != NULL)
+  {
+    (void)fclose(csv_out);
+  }
+
+  if (Net_Failures != 0U)
+  {
+    (void)fprintf(stderr, "%u check(s) failed\n", Net_Failures);
+  }
+
+  return (Net_Failures == 0U) ? 0 : 1;
+}
+
+/* TAP mode ------------------------------------------------------------------*/
+
+static void Net_Signal(int sig)
+{
+  (void)sig;
+  Net_Stop = 1;
+}
+
+static int Net_Tap(uint8_t cls, const char *ifname, USBD_SpeedTypeDef speed)
+{
+  HOST_PerfTypeDef cost = { 0U, 0U, 0U };
+  HOST_PerfTypeDef idle = { 0U, 0U, 0U };
+  Net_FrameTypeDef *f;
+  USBD_Iperf_HandleTypeDef *iperf;
+  USBD_UDP_HandleTypeDef *udp;
+  struct ifreq ifr;
+  struct pollfd pfd;
+  uint32_t frames;
+  ssize_t n;
+
+  Net_Fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if (Net_Fd < 0)
+  {
+    perror("/dev/net/tun");
+    return 1;
+  }
+
+  (void)memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  (void)strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  if (ioctl(Net_Fd, TUNSETIFF, &ifr) < 0)
+  {
+    perror(ifname);
+    (void)close(Net_Fd);
+    return 1;
+  }
+
+  (void)signal(SIGINT, Net_Signal);
+  (void)signal(SIGTERM, Net_Signal);
+
+  HOST_Perf_Init();
+  Net_Start(&Net_Classes[cls], speed);
+  Net_Cost = &cost;
+  Net_Idle = &idle;
+
+  while (Net_Stop == 0)
+  {
+    /* Sleep while the class has nothing in flight */
+    pfd.fd = Net_Fd;
+    pfd.events = POLLIN;
+    (void)poll(&pfd, 1, (Net_QueueHead != Net_QueueTail) ? 0 : 1);
+
+    while (((f = Net_QueueAlloc()) != NULL) && ((n = read(Net_Fd, f->data, sizeof(f->data))) > 0))
+    {
+      f->len = (uint32_t)n;
+      Net_QueueHead++;
+    }
+
+    while (Net_Pump() != 0U)
+    {
+    }
+  }
+
+  Net_Cost = &Net_Unused;
+  Net_Idle = &Net_Unused;
+  udp = Net_Cls->udp;
+  iperf = Net_Cls->iperf;
+  frames = ((Net_HostTx + Net_HostRx) != 0U) ? (Net_HostTx + Net_HostRx) : 1U;
+
+  (void)printf("%s: host sent %u frames, received %u, %u notifications\n", Net_Cls->name,
+               Net_HostTx, Net_HostRx, Net_Notifications);
+  (void)printf("device %.1f ns/frame, %.1f instr/frame, %llu idle polls\n",
+               (double)cost.ns / frames, (double)cost.instr / frames, (unsigned long long)idle.calls);
+  (void)printf("rx frames %u datagrams %u errors %u, tx datagrams %u busy %u, arp %u echo %u\n",
+               udp->rx_frames, udp->rx_datagrams, udp->rx_errors, udp->tx_datagrams,
+               udp->tx_busy, udp->arp_replies, udp->echo_replies);
+  (void)printf("iperf rx %u tests %llu bytes %u kbit/s lost %u, tx %u tests %llu bytes %u kbit/s\n",
+               iperf->rx.tests, (unsigned long long)iperf->rx.bytes, USBD_Iperf_Kbps(&iperf->rx),
+               iperf->rx.lost, iperf->tx.tests, (unsigned long long)iperf->tx.bytes,
+               USBD_Iperf_Kbps(&iperf->tx));
+
+  if (Net_Cls->id == NET_CLASS_RNDIS)
+  {
+    (void)printf("OID xmit ok %u rcv ok %u xmit error %u rcv error %u rcv no buffer %u\n",
+                 Net_RndisQuery32(OID_GEN_XMIT_OK), Net_RndisQuery32(OID_GEN_RCV_OK),
+                 Net_RndisQuery32(OID_GEN_XMIT_ERROR), Net_RndisQuery32(OID_GEN_RCV_ERROR),
+                 Net_RndisQuery32(OID_GEN_RCV_NO_BUFFER));
+  }
+
+  Net_End();
+  (void)close(Net_Fd);
+  Net_Fd = -1;
+
+  return 0;
+}
+
+/* Command line --------------------------------------------------------------*/
+
+static uint8_t Net_Lookup(const char *arg, const char **names, uint8_t count)
+{
+  uint8_t i;
+
+  if (strcmp(arg, "all") == 0)
+  {
+    return NET_ALL;
+  }
+
+  for (i = 0U; i < count; i++)
+  {
+    if (strcmp(arg, names[i]) == 0)
+    {
+      return i;
+    }
+  }
+
+  (void)fprintf(stderr, "unknown value '%s'\n", arg);
+  exit(2);
+}
+
+static void Net_Usage(const char *prog)
+{
+  (void)fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -C, --class rndis|ecm|all     class under test (all, rndis in TAP mode)\n"
+                "  -l, --load echo|rx|tx|all     traffic (all)\n"
+                "  -s, --size BYTES              ICMP or UDP payload, 0 for 64, 512 and 1472 (0)\n"
+                "  -n, --count N                 frames per test (4096)\n"
+                "  -w, --window N                echo requests in flight (8)\n"
+                "  -a, --aggr N                  RNDIS: PACKET_MSGs per OUT transfer (1)\n"
+                "  -S, --speed hs|fs             bus speed (hs)\n"
+                "  -c, --csv FILE                also write the results as CSV\n"
+                "  -t, --tap NAME                bridge to a TAP device instead of the self-test\n"
+                "  -q, --quiet                   no table on stdout\n",
+                prog);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option opts[] =
+  {
+    { "class", required_argument, NULL, 'C' },
+    { "load", required_argument, NULL, 'l' },
+    { "size", required_argument, NULL, 's' },
+    { "count", required_argument, NULL, 'n' },
+    { "window", required_argument, NULL, 'w' },
+    { "aggr", required_argument, NULL, 'a' },
+    { "speed", required_argument, NULL, 'S' },
+    { "csv", required_argument, NULL, 'c' },
+    { "tap", required_argument, NULL, 't' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  uint8_t cls = NET_ALL;
+  uint8_t load = NET_ALL;
+  uint8_t speed = 0U;
+  uint32_t size = 0U;
+  uint32_t count = 4096U;
+  uint32_t window = 8U;
+  const char *csv = NULL;
+  const char *tap = NULL;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "C:l:s:n:w:a:S:c:t:qh", opts, NULL)) != -1)
+  {
+    switch (c)
+    {
+      case 'C': cls = Net_Lookup(optarg, Net_ClassName, 2U); break;
+      case 'l': load = Net_Lookup(optarg, Net_LoadName, 3U); break;
+      case 's': size = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'n': count = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'w': window = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'a': Net_Aggr = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'S': speed = Net_Lookup(optarg, Net_SpeedName, 2U); break;
+      case 'c': csv = optarg; break;
+      case 't': tap = optarg; break;
+      case 'q': Net_Quiet = 1U; break;
+      default: Net_Usage(argv[0]); return (c == 'h') ? 0 : 2;
+    }
+  }
+
+  if (((size != 0U) && ((size < 8U) || (size > USBD_UDP_MAX_PAYLOAD))) || (count == 0U) ||
+      (count > 65536U) || (window == 0U) || (window > NET_QUEUE_DEPTH) || (Net_Aggr == 0U) ||
+      (speed == NET_ALL))
+  {
+    Net_Usage(argv[0]);
+    return 2;
+  }
+
+  if (tap != NULL)
+  {
+    return Net_Tap((cls == NET_ALL) ? NET_CLASS_RNDIS : cls, tap,
+                   (speed == 0U) ? USBD_SPEED_HIGH : USBD_SPEED_FULL);
+  }
+
+  return Net_SelfTest(cls, load, (uint16_t)size, count, window,
+                      (speed == 0U) ? USBD_SPEED_HIGH : USBD_SPEED_FULL, csv);
+}
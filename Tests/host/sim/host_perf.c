@@ -0,0 +1,118 @@
+/**
+  ******************************************************************************
+  * @file           : host_perf.c
+  * @brief          : CPU cost accounting for the host harnesses.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           Time is taken from CLOCK_MONOTONIC. Instructions come from a
+  *           Linux perf counter when the kernel allows it (see
+  *           perf_event_paranoid); they are the more stable figure for
+  *           regression tracking since they do not depend on host load.
+  *           Sections do not nest.
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_perf.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+/* Private variables ---------------------------------------------------------*/
+static int Perf_Fd = -1;
+static uint64_t Perf_StartNs;
+static uint64_t Perf_StartInstr;
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint64_t Perf_Now(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000U) + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t Perf_Instr(void)
+{
+  uint64_t count = 0U;
+
+  if ((Perf_Fd < 0) || (read(Perf_Fd, &count, sizeof(count)) != (ssize_t)sizeof(count)))
+  {
+    return 0U;
+  }
+
+  return count;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Open the instruction counter for this thread if possible
+  * @retval None
+  */
+void HOST_Perf_Init(void)
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+
+  if (Perf_Fd >= 0)
+  {
+    return;
+  }
+
+  (void)memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.exclude_kernel = 1U;
+  attr.exclude_hv = 1U;
+
+  Perf_Fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif /* __linux__ */
+}
+
+/**
+  * @brief  Tell whether instruction counts are real
+  * @retval 1 if the perf counter is open
+  */
+uint8_t HOST_Perf_HasInstr(void)
+{
+  return (Perf_Fd >= 0) ? 1U : 0U;
+}
+
+/**
+  * @brief  Start a measured section
+  * @retval None
+  */
+void HOST_Perf_Begin(void)
+{
+  Perf_StartInstr = Perf_Instr();
+  Perf_StartNs = Perf_Now();
+}
+
+/**
+  * @brief  End a measured section and add it to an accumulator
+  * @param  acc: accumulator
+  * @retval None
+  */
+void HOST_Perf_End(HOST_PerfTypeDef *acc)
+{
+  uint64_t ns = Perf_Now();
+  uint64_t instr = Perf_Instr();
+
+  acc->ns += ns - Perf_StartNs;
+  acc->instr += instr - Perf_StartInstr;
+  acc->calls++;
+}
@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * @file           : host_perf.h
+  * @brief          : CPU cost accounting for the host harnesses.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HOST_PERF_H__
+#define __HOST_PERF_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint64_t ns;      /* Wall time spent in measured sections */
+  uint64_t instr;   /* User space instructions, 0 when counters are unavailable */
+  uint64_t calls;
+} HOST_PerfTypeDef;
+
+/* Exported functions --------------------------------------------------------*/
+void HOST_Perf_Init(void);
+uint8_t HOST_Perf_HasInstr(void);
+void HOST_Perf_Begin(void);
+void HOST_Perf_End(HOST_PerfTypeDef *acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_PERF_H__ */
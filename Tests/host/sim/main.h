@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file           : main.h
+  * @brief          : Host stand-in for Core/Inc/main.h, used by the host
+  *                   harnesses to build middleware sources without the HAL.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+/* Exported macro ------------------------------------------------------------*/
+/* CMSIS keywords the middleware headers use */
+#define __IO                             volatile
+#define __STATIC_INLINE                  static inline
+#define __PACKED                         __attribute__((packed))
+
+/* From stm32h7xx_hal_def.h */
+#define UNUSED(X)                        (void)X
+
+/* The harness is single threaded: interrupt masking has nothing to do */
+#define __get_PRIMASK()                  (0U)
+#define __set_PRIMASK(x)                 ((void)(x))
+#define __disable_irq()                  ((void)0)
+#define __enable_irq()                   ((void)0)
+
+/* Exported types ------------------------------------------------------------*/
+/* The part of stm32h7xx_hal_pcd.h the class drivers read through pdev->pData */
+typedef struct
+{
+  uint32_t maxpacket;
+} PCD_EPTypeDef;
+
+typedef struct
+{
+  PCD_EPTypeDef IN_ep[16];
+  PCD_EPTypeDef OUT_ep[16];
+  uint32_t FrameNumber;
+} PCD_HandleTypeDef;
+
+/* Exported functions prototypes ---------------------------------------------*/
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
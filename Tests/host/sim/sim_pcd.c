@@ -0,0 +1,284 @@
+/**
+  ******************************************************************************
+  * @file           : sim_pcd.c
+  * @brief          : Simulated peripheral controller for the host harnesses.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           Provides the USBD_LL_* layer the class drivers call. Transfers
+  *           are not split into packets: a Transmit or PrepareReceive arms
+  *           the endpoint, the harness moves the data with SIM_PCD_TakeIn()
+  *           or SIM_PCD_PutOut() and then calls the class DataIn/DataOut
+  *           callback itself, like the PCD interrupt would on completion.
+  *           Like the HAL, Transmit always works on the IN endpoint and
+  *           PrepareReceive on the OUT one, so EP0 data goes to 0x80/0x00.
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim_pcd.h"
+#include <time.h>
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_EpTypeDef SIM_EpIn[16];
+static SIM_EpTypeDef SIM_EpOut[16];
+static PCD_HandleTypeDef SIM_Pcd;
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief  Close every endpoint and set the bus speed
+  * @param  pdev: device instance
+  * @param  speed: enumerated speed
+  * @retval None
+  */
+void SIM_PCD_Reset(USBD_HandleTypeDef *pdev, USBD_SpeedTypeDef speed)
+{
+  (void)memset(SIM_EpIn, 0, sizeof(SIM_EpIn));
+  (void)memset(SIM_EpOut, 0, sizeof(SIM_EpOut));
+  (void)memset(&SIM_Pcd, 0, sizeof(SIM_Pcd));
+
+  pdev->pData = &SIM_Pcd;
+  pdev->dev_speed = speed;
+  pdev->dev_state = USBD_STATE_CONFIGURED;
+}
+
+/**
+  * @brief  Endpoint state
+  * @param  ep_addr: endpoint address, bit 7 set for IN
+  * @retval endpoint
+  */
+SIM_EpTypeDef *SIM_PCD_Ep(uint8_t ep_addr)
+{
+  return ((ep_addr & 0x80U) != 0U) ? &SIM_EpIn[ep_addr & 0xFU] : &SIM_EpOut[ep_addr & 0xFU];
+}
+
+/**
+  * @brief  Check that the device queued IN data
+  * @param  ep_addr: IN endpoint address
+  * @retval 1 if a transfer is armed and not stalled
+  */
+uint8_t SIM_PCD_InReady(uint8_t ep_addr)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr);
+
+  return ((ep->armed != 0U) && (ep->stalled == 0U)) ? 1U : 0U;
+}
+
+/**
+  * @brief  Host side of an IN transfer, disarms the endpoint
+  * @param  ep_addr: IN endpoint address
+  * @param  dst: host buffer, may be NULL to discard
+  * @param  max: host buffer size
+  * @retval bytes transferred
+  */
+uint32_t SIM_PCD_TakeIn(uint8_t ep_addr, uint8_t *dst, uint32_t max)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr);
+  uint32_t len = (ep->len < max) ? ep->len : max;
+
+  if ((dst != NULL) && (len != 0U))
+  {
+    (void)memcpy(dst, ep->buf, len);
+  }
+
+  ep->armed = 0U;
+  return len;
+}
+
+/**
+  * @brief  Check that the device is ready to receive
+  * @param  ep_addr: OUT endpoint address
+  * @retval 1 if a receive is armed and not stalled
+  */
+uint8_t SIM_PCD_OutReady(uint8_t ep_addr)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr);
+
+  return ((ep->armed != 0U) && (ep->stalled == 0U)) ? 1U : 0U;
+}
+
+/**
+  * @brief  Host side of an OUT transfer, disarms the endpoint
+  * @param  ep_addr: OUT endpoint address
+  * @param  src: host data
+  * @param  len: host data length
+  * @retval bytes accepted, at most what the device armed
+  */
+uint32_t SIM_PCD_PutOut(uint8_t ep_addr, const uint8_t *src, uint32_t len)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr);
+
+  if (len > ep->len)
+  {
+    len = ep->len;
+  }
+
+  (void)memcpy(ep->buf, src, len);
+  ep->rx_size = len;
+  ep->armed = 0U;
+
+  return len;
+}
+
+/* USBD_LL_* layer -----------------------------------------------------------*/
+
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                  uint8_t ep_type, uint16_t ep_mps)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr);
+
+  (void)pdev;
+  (void)memset(ep, 0, sizeof(SIM_EpTypeDef));
+  ep->type = ep_type;
+  ep->mps = ep_mps;
+  ep->open = 1U;
+
+  if ((ep_addr & 0x80U) != 0U)
+  {
+    SIM_Pcd.IN_ep[ep_addr & 0xFU].maxpacket = ep_mps;
+  }
+  else
+  {
+    SIM_Pcd.OUT_ep[ep_addr & 0xFU].maxpacket = ep_mps;
+  }
+
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  (void)memset(SIM_PCD_Ep(ep_addr), 0, sizeof(SIM_EpTypeDef));
+
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  SIM_PCD_Ep(ep_addr)->armed = 0U;
+
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  SIM_PCD_Ep(ep_addr)->stalled = 1U;
+
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+  SIM_PCD_Ep(ep_addr)->stalled = 0U;
+
+  return USBD_OK;
+}
+
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+
+  return SIM_PCD_Ep(ep_addr)->stalled;
+}
+
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+  (void)pdev;
+  (void)dev_addr;
+
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                    uint8_t *pbuf, uint32_t size)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr | 0x80U);
+
+  (void)pdev;
+  ep->buf = pbuf;
+  ep->len = size;
+  ep->armed = 1U;
+
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                          uint8_t *pbuf, uint32_t size)
+{
+  SIM_EpTypeDef *ep = SIM_PCD_Ep(ep_addr & 0x7FU);
+
+  (void)pdev;
+  ep->buf = pbuf;
+  ep->len = size;
+  ep->rx_size = 0U;
+  ep->armed = 1U;
+
+  return USBD_OK;
+}
+
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  (void)pdev;
+
+  return SIM_PCD_Ep(ep_addr & 0x7FU)->rx_size;
+}
+
+void USBD_LL_Delay(uint32_t Delay)
+{
+  (void)Delay;
+}
+
+/* Control pipe: harnesses call the class Setup/EP0_RxReady themselves */
+void USBD_CtlError(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  (void)req;
+  (void)USBD_LL_StallEP(pdev, 0x80U);
+  (void)USBD_LL_StallEP(pdev, 0x00U);
+}
+
+/* String descriptors of the class drivers, as in usbd_ctlreq.c */
+void USBD_GetString(uint8_t *desc, uint8_t *unicode, uint16_t *len)
+{
+  uint8_t idx = 2U;
+
+  if (desc == NULL)
+  {
+    return;
+  }
+
+  *len = (uint16_t)((strlen((const char *)desc) * 2U) + 2U);
+  unicode[0] = (uint8_t)*len;
+  unicode[1] = USB_DESC_TYPE_STRING;
+
+  while (*desc != (uint8_t)'\0')
+  {
+    unicode[idx] = *desc;
+    unicode[idx + 1U] = 0U;
+    desc++;
+    idx += 2U;
+  }
+}
+
+/* HAL time base -------------------------------------------------------------*/
+
+uint32_t HAL_GetTick(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  (void)Delay;
+}
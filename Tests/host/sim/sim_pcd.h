@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file           : sim_pcd.h
+  * @brief          : Simulated peripheral controller for the host harnesses.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SIM_PCD_H__
+#define __SIM_PCD_H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  uint8_t  *buf;       /* Buffer handed over by the last Transmit/PrepareReceive */
+  uint32_t len;
+  uint32_t rx_size;    /* Bytes the host put in the last OUT transfer */
+  uint16_t mps;
+  uint8_t  type;
+  uint8_t  open;
+  uint8_t  armed;
+  uint8_t  stalled;
+} SIM_EpTypeDef;
+
+/* Exported functions --------------------------------------------------------*/
+void SIM_PCD_Reset(USBD_HandleTypeDef *pdev, USBD_SpeedTypeDef speed);
+SIM_EpTypeDef *SIM_PCD_Ep(uint8_t ep_addr);
+
+uint8_t SIM_PCD_InReady(uint8_t ep_addr);
+uint32_t SIM_PCD_TakeIn(uint8_t ep_addr, uint8_t *dst, uint32_t max);
+uint8_t SIM_PCD_OutReady(uint8_t ep_addr);
+uint32_t SIM_PCD_PutOut(uint8_t ep_addr, const uint8_t *src, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_PCD_H__ */
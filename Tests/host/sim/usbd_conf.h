@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file           : usbd_conf.h
+  * @brief          : Host stand-in for Target/usbd_conf.h.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CONF__H__
+#define __USBD_CONF__H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+
+/*---------- -----------*/
+#define USBD_MAX_NUM_INTERFACES           15U
+/*---------- -----------*/
+#define USBD_MAX_NUM_CONFIGURATION        1U
+/*---------- -----------*/
+#define USBD_MAX_STR_DESC_SIZ             512U
+/*---------- -----------*/
+#define USBD_SUPPORT_USER_STRING_DESC     1U
+/*---------- -----------*/
+#define USBD_DEBUG_LEVEL                  0U
+/*---------- -----------*/
+#define USBD_LPM_ENABLED                  0U
+/*---------- -----------*/
+#define USBD_SELF_POWERED                 1U
+
+/* #define for FS and HS identification */
+#define DEVICE_FS 		0
+#define DEVICE_HS 		1
+
+/* Memory management macros */
+#define USBD_malloc         malloc
+#define USBD_free           free
+#define USBD_memset         memset
+#define USBD_memcpy         memcpy
+#define USBD_Delay          HAL_Delay
+
+/* DEBUG macros */
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CONF__H__ */
@@ -0,0 +1,1231 @@
+/**
+  ******************************************************************************
+  * @file           : udp_tap.c
+  * @brief          : UDP fast path harness, self-test and Linux TAP stand-in.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           usbd_udp.c is built unchanged for the host. Its Output callback
+  *           feeds a small wire queue standing in for the class TX frames:
+  *           a full queue answers USBD_BUSY like the ECM ring does, and in
+  *           ref mode every frame is handed back through
+  *           USBD_UDP_TransmitCplt() once the harness took it off the wire.
+  *           In copy mode the queue copies the frame (RNDIS, tx_copies).
+  *
+  *           Self-test (default): the harness plays the USB host. It checks
+  *           the ARP and echo replies, delivery and rejection of received
+  *           datagrams, the ARP request of an unresolved flow, then streams
+  *           datagrams through USBD_UDP_Alloc()/Send() and verifies every
+  *           header and checksum with its own byte-wise sum.
+  *
+  *           Only the device calls (Input, Alloc, Send, TransmitCplt) are
+  *           accounted. "bus cpu" is the share of one host CPU the stack
+  *           needs to keep a high speed bulk IN pipe (13 x 512 bytes per
+  *           microframe) busy at that datagram size, class headers left out.
+  *
+  *           Send modes:
+  *             plain   USBD_UDP_Send() sums the payload
+  *             summed  the application keeps the payload sum while writing
+  *                     it and calls USBD_UDP_SendSummed()
+  *
+  *           TAP mode (--tap NAME): frames go to and from a Linux TAP device
+  *           instead, so the responder can be pinged and talked to with the
+  *           usual tools:
+  *
+  *             ip tuntap add dev usb0 mode tap user $USER
+  *             ip addr add 192.168.7.1/24 dev usb0 && ip link set usb0 up
+  *             udp_tap --tap usb0 --dest 192.168.7.1:5001 --rate 1000
+  *             ping 192.168.7.2; nc -u 192.168.7.2 7; nc -ul 5001
+  *
+  *           Datagrams sent to port 7 are echoed back to their sender, and
+  *           the iperf 2 server (usbd_iperf.c) answers on port 5001:
+  *
+  *             iperf -c 192.168.7.2 -u -b 200M; iperf -c 192.168.7.2 -u -r
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_perf.h"
+#include "usbd_udp.h"
+#include "usbd_iperf.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Private define ------------------------------------------------------------*/
+#define TAP_WIRE_DEPTH                   4U
+#define TAP_HS_BULK_BPS                  (13.0 * 512.0 * 8000.0)
+#define TAP_ECHO_PORT                    7U
+#define TAP_TEST_PORT                    5000U
+#define TAP_SRC_PORT                     4000U
+#define TAP_HOST_PORT                    6000U
+#define TAP_IPERF_PORT                   5002U   /* Host side of a reverse test */
+#define TAP_IPERF_LEN                    100U
+#define TAP_STALL_POLLS                  1000U
+
+#define TAP_MODE_REF                     0U
+#define TAP_MODE_COPY                    1U
+
+#define TAP_SEND_PLAIN                   0U
+#define TAP_SEND_SUMMED                  1U
+
+#define TAP_ALL                          0xFFU
+
+#define TAP_IP(a, b, c, d)               (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | \
+                                          ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint8_t *frame;
+  uint32_t len;
+  uint8_t copy[USBD_UDP_FRAME_SIZE];
+} Tap_WireTypeDef;
+
+typedef struct
+{
+  uint8_t  mode;
+  uint8_t  send;
+  uint16_t size;
+  uint32_t count;
+} Tap_TestTypeDef;
+
+typedef struct
+{
+  HOST_PerfTypeDef cost;
+  uint32_t datagrams;
+  uint32_t busy;
+  uint32_t errors;
+} Tap_ResultTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *Tap_ModeName[] = { "ref", "copy" };
+static const char *Tap_SendName[] = { "plain", "summed" };
+
+static const uint8_t Tap_HostMac[6] = { 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U };
+static const uint32_t Tap_HostIp = TAP_IP(192, 168, 7, 1);
+
+static USBD_UDP_HandleTypeDef Tap_Udp;
+static USBD_UDP_ConfTypeDef Tap_Conf;
+static USBD_Iperf_HandleTypeDef Tap_Iperf;
+
+static Tap_WireTypeDef Tap_Wire[TAP_WIRE_DEPTH];
+static uint32_t Tap_WireHead;
+static uint32_t Tap_WireTail;
+
+static HOST_PerfTypeDef *Tap_Cost;
+static HOST_PerfTypeDef Tap_Unused;
+static uint32_t Tap_Failures;
+static uint8_t Tap_Quiet;
+
+/* Last datagram the Receive callback saw */
+static uint32_t Tap_RxCount;
+static uint32_t Tap_RxIp;
+static uint16_t Tap_RxSrcPort;
+static uint16_t Tap_RxDstPort;
+static uint8_t Tap_RxData[USBD_UDP_MAX_PAYLOAD];
+static uint16_t Tap_RxLen;
+
+static int Tap_Fd = -1;
+static volatile sig_atomic_t Tap_Stop;
+
+/* Helpers -------------------------------------------------------------------*/
+
+static void Tap_Fail(const char *fmt, ...)
+{
+  va_list ap;
+
+  Tap_Failures++;
+  (void)fprintf(stderr, "FAIL: ");
+  va_start(ap, fmt);
+  (void)vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  (void)fprintf(stderr, "\n");
+}
+
+static uint16_t Tap_Get16(const uint8_t *p)
+{
+  return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static uint32_t Tap_Get32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void Tap_Put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static void Tap_Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+/* Reference checksum, byte by byte and independent of usbd_udp.c */
+static uint16_t Tap_Csum(const uint8_t *data, uint32_t len, uint32_t sum)
+{
+  uint64_t acc = sum;
+  uint32_t i;
+
+  for (i = 0U; i < len; i++)
+  {
+    acc += ((i & 1U) == 0U) ? ((uint32_t)data[i] << 8) : data[i];
+  }
+  while ((acc >> 16) != 0U)
+  {
+    acc = (acc & 0xFFFFU) + (acc >> 16);
+  }
+
+  return (uint16_t)~acc;
+}
+
+static uint32_t Tap_PseudoSum(const uint8_t *ip, uint16_t udp_len)
+{
+  return Tap_Get16(&ip[12]) + Tap_Get16(&ip[14]) + Tap_Get16(&ip[16]) + Tap_Get16(&ip[18]) +
+         17U + udp_len;
+}
+
+/* Device side, everything here is accounted ---------------------------------*/
+
+static uint8_t Tap_Output(uint8_t *frame, uint32_t len)
+{
+  Tap_WireTypeDef *w;
+
+  if ((Tap_WireHead - Tap_WireTail) == TAP_WIRE_DEPTH)
+  {
+    return (uint8_t)USBD_BUSY;
+  }
+
+  w = &Tap_Wire[Tap_WireHead % TAP_WIRE_DEPTH];
+  w->len = len;
+
+  if (Tap_Conf.tx_copies != 0U)
+  {
+    (void)memcpy(w->copy, frame, len);
+    w->frame = w->copy;
+  }
+  else
+  {
+    w->frame = frame;
+  }
+  Tap_WireHead++;
+
+  return (uint8_t)USBD_OK;
+}
+
+static uint8_t Tap_Input(uint8_t *frame, uint32_t len)
+{
+  uint8_t ret;
+
+  HOST_Perf_Begin();
+  ret = USBD_UDP_Input(&Tap_Udp, frame, len);
+  HOST_Perf_End(Tap_Cost);
+
+  return ret;
+}
+
+/* Take the oldest frame off the wire, NULL if there is none */
+static uint8_t *Tap_WirePeek(uint32_t *len)
+{
+  Tap_WireTypeDef *w;
+
+  if (Tap_WireHead == Tap_WireTail)
+  {
+    return NULL;
+  }
+
+  w = &Tap_Wire[Tap_WireTail % TAP_WIRE_DEPTH];
+  *len = w->len;
+
+  return w->frame;
+}
+
+/* The IN transfer of the oldest frame completed */
+static void Tap_WirePop(void)
+{
+  Tap_WireTypeDef *w = &Tap_Wire[Tap_WireTail % TAP_WIRE_DEPTH];
+
+  Tap_WireTail++;
+
+  if (Tap_Conf.tx_copies == 0U)
+  {
+    HOST_Perf_Begin();
+    USBD_UDP_TransmitCplt(&Tap_Udp, w->frame);
+    HOST_Perf_End(Tap_Cost);
+  }
+}
+
+static void Tap_Receive(uint32_t src_ip, uint16_t src_port, uint16_t dst_port,
+                        uint8_t *data, uint16_t len)
+{
+  USBD_UDP_FlowTypeDef flow;
+  uint8_t *payload;
+
+  if (USBD_Iperf_UdpInput(&Tap_Iperf, src_ip, src_port, dst_port, data, len) == (uint8_t)USBD_OK)
+  {
+    return;
+  }
+
+  Tap_RxCount++;
+  Tap_RxIp = src_ip;
+  Tap_RxSrcPort = src_port;
+  Tap_RxDstPort = dst_port;
+  Tap_RxLen = len;
+  (void)memcpy(Tap_RxData, data, len);
+
+  /* UDP echo, the data is only valid during the call */
+  if ((Tap_Fd >= 0) && (dst_port == TAP_ECHO_PORT) &&
+      (USBD_UDP_OpenFlow(&Tap_Udp, &flow, src_ip, dst_port, src_port) == (uint8_t)USBD_OK))
+  {
+    payload = USBD_UDP_Alloc(&Tap_Udp);
+    if (payload != NULL)
+    {
+      (void)memcpy(payload, data, len);
+      if (USBD_UDP_Send(&Tap_Udp, &flow, payload, len) != (uint8_t)USBD_OK)
+      {
+        USBD_UDP_Free(&Tap_Udp, payload);
+      }
+    }
+  }
+}
+
+static void Tap_Start(uint8_t mode)
+{
+  (void)memset(&Tap_Udp, 0, sizeof(Tap_Udp));
+  Tap_WireHead = 0U;
+  Tap_WireTail = 0U;
+
+  Tap_Conf.Output = Tap_Output;
+  Tap_Conf.Receive = Tap_Receive;
+  Tap_Conf.tx_copies = (mode == TAP_MODE_COPY) ? 1U : 0U;
+  (void)memcpy(Tap_Conf.hwaddr, "\x02\x00\x00\x00\x00\x02", 6U);
+  Tap_Conf.ipaddr = TAP_IP(192, 168, 7, 2);
+  Tap_Conf.netmask = TAP_IP(255, 255, 255, 0);
+
+  USBD_UDP_Init(&Tap_Udp, &Tap_Conf);
+
+  (void)memset(&Tap_Iperf, 0, sizeof(Tap_Iperf));
+  USBD_Iperf_Init(&Tap_Iperf, &Tap_Udp);
+}
+
+/* Host side -----------------------------------------------------------------*/
+
+static uint32_t Tap_EthHeader(uint8_t *frame, const uint8_t *dst, uint16_t type)
+{
+  (void)memcpy(frame, dst, 6U);
+  (void)memcpy(&frame[6], Tap_HostMac, 6U);
+  Tap_Put16(&frame[12], type);
+
+  return 14U;
+}
+
+static uint32_t Tap_IpHeader(uint8_t *ip, uint8_t proto, uint32_t dst, uint16_t payload_len)
+{
+  (void)memset(ip, 0, 20U);
+  ip[0] = 0x45U;
+  Tap_Put16(&ip[2], (uint16_t)(20U + payload_len));
+  Tap_Put16(&ip[4], 0x1234U);
+  ip[8] = 64U;
+  ip[9] = proto;
+  Tap_Put32(&ip[12], Tap_HostIp);
+  Tap_Put32(&ip[16], dst);
+  Tap_Put16(&ip[10], Tap_Csum(ip, 20U, 0U));
+
+  return 20U;
+}
+
+static uint32_t Tap_BuildUdp(uint8_t *frame, uint16_t src_port, uint32_t dst, uint16_t dst_port,
+                             const uint8_t *data, uint16_t len)
+{
+  uint8_t *ip = &frame[14];
+  uint8_t *udp = &frame[34];
+  uint16_t udp_len = (uint16_t)(8U + len);
+
+  (void)Tap_EthHeader(frame, Tap_Conf.hwaddr, 0x0800U);
+  (void)Tap_IpHeader(ip, 17U, dst, udp_len);
+  Tap_Put16(&udp[0], src_port);
+  Tap_Put16(&udp[2], dst_port);
+  Tap_Put16(&udp[4], udp_len);
+  Tap_Put16(&udp[6], 0U);
+  (void)memcpy(&udp[8], data, len);
+  Tap_Put16(&udp[6], Tap_Csum(udp, udp_len, Tap_PseudoSum(ip, udp_len)));
+
+  return 42U + len;
+}
+
+/* Checks a frame the device sent is a valid UDP datagram of the flow */
+static void Tap_CheckDatagram(const uint8_t *frame, uint32_t len, uint32_t dst,
+                              uint16_t dst_port, uint16_t payload_len, uint16_t ip_id)
+{
+  const uint8_t *ip = &frame[14];
+  const uint8_t *udp = &frame[34];
+
+  if ((len != (42U + payload_len)) || (memcmp(frame, Tap_HostMac, 6U) != 0) ||
+      (memcmp(&frame[6], Tap_Conf.hwaddr, 6U) != 0) || (Tap_Get16(&frame[12]) != 0x0800U))
+  {
+    Tap_Fail("datagram %u: bad Ethernet header or length %u", ip_id, len);
+    return;
+  }
+
+  if ((ip[0] != 0x45U) || (Tap_Get16(&ip[2]) != (28U + payload_len)) || (Tap_Get16(&ip[4]) != ip_id) ||
+      (ip[9] != 17U) || (Tap_Get32(&ip[12]) != Tap_Conf.ipaddr) || (Tap_Get32(&ip[16]) != dst) ||
+      (Tap_Csum(ip, 20U, 0U) != 0U))
+  {
+    Tap_Fail("datagram %u: bad IP header", ip_id);
+    return;
+  }
+
+  if ((Tap_Get16(&udp[0]) != TAP_SRC_PORT) || (Tap_Get16(&udp[2]) != dst_port) ||
+      (Tap_Get16(&udp[4]) != (8U + payload_len)))
+  {
+    Tap_Fail("datagram %u: bad UDP header", ip_id);
+    return;
+  }
+
+#if (USBD_UDP_TX_CHECKSUM == 1U)
+  if ((Tap_Get16(&udp[6]) == 0U) ||
+      (Tap_Csum(udp, 8U + payload_len, Tap_PseudoSum(ip, (uint16_t)(8U + payload_len))) != 0U))
+  {
+    Tap_Fail("datagram %u: bad UDP checksum 0x%04x", ip_id, Tap_Get16(&udp[6]));
+  }
+#endif /* USBD_UDP_TX_CHECKSUM */
+}
+
+/* Self-test -----------------------------------------------------------------*/
+
+static void Tap_TestArp(void)
+{
+  static const uint8_t bcast[6] = { 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU };
+  uint8_t frame[60] = { 0 };
+  uint8_t *arp = &frame[14];
+  uint8_t *reply;
+  uint32_t len;
+
+  (void)Tap_EthHeader(frame, bcast, 0x0806U);
+  Tap_Put16(&arp[0], 1U);
+  Tap_Put16(&arp[2], 0x0800U);
+  arp[4] = 6U;
+  arp[5] = 4U;
+  Tap_Put16(&arp[6], 1U);
+  (void)memcpy(&arp[8], Tap_HostMac, 6U);
+  Tap_Put32(&arp[14], Tap_HostIp);
+  Tap_Put32(&arp[24], Tap_Conf.ipaddr);
+
+  if (Tap_Input(frame, sizeof(frame)) != (uint8_t)USBD_OK)
+  {
+    Tap_Fail("ARP request not taken");
+  }
+
+  reply = Tap_WirePeek(&len);
+  if (reply == NULL)
+  {
+    Tap_Fail("no ARP reply");
+    return;
+  }
+
+  arp = &reply[14];
+  if ((len < 42U) || (memcmp(reply, Tap_HostMac, 6U) != 0) || (Tap_Get16(&reply[12]) != 0x0806U) ||
+      (Tap_Get16(&arp[6]) != 2U) || (memcmp(&arp[8], Tap_Conf.hwaddr, 6U) != 0) ||
+      (Tap_Get32(&arp[14]) != Tap_Conf.ipaddr) || (memcmp(&arp[18], Tap_HostMac, 6U) != 0) ||
+      (Tap_Get32(&arp[24]) != Tap_HostIp))
+  {
+    Tap_Fail("bad ARP reply");
+  }
+  Tap_WirePop();
+
+  /* Not for us */
+  Tap_Put32(&frame[14 + 24], TAP_IP(192, 168, 7, 3));
+  if ((Tap_Input(frame, sizeof(frame)) != (uint8_t)USBD_FAIL) || (Tap_WirePeek(&len) != NULL))
+  {
+    Tap_Fail("ARP request for another address answered");
+  }
+}
+
+static void Tap_TestEcho(void)
+{
+  uint8_t frame[14 + 20 + 8 + 56];
+  uint8_t *icmp = &frame[34];
+  uint8_t *reply;
+  uint32_t len;
+  uint32_t i;
+
+  (void)Tap_EthHeader(frame, Tap_Conf.hwaddr, 0x0800U);
+  (void)Tap_IpHeader(&frame[14], 1U, Tap_Conf.ipaddr, 8U + 56U);
+  icmp[0] = 8U;
+  icmp[1] = 0U;
+  Tap_Put16(&icmp[2], 0U);
+  Tap_Put16(&icmp[4], 0xBEEFU);
+  Tap_Put16(&icmp[6], 1U);
+  for (i = 0U; i < 56U; i++)
+  {
+    icmp[8U + i] = (uint8_t)(i * 7U);
+  }
+  Tap_Put16(&icmp[2], Tap_Csum(icmp, 64U, 0U));
+
+  (void)Tap_Input(frame, sizeof(frame));
+
+  reply = Tap_WirePeek(&len);
+  if (reply == NULL)
+  {
+    Tap_Fail("no echo reply");
+    return;
+  }
+
+  icmp = &reply[34];
+  if ((len != sizeof(frame)) || (memcmp(reply, Tap_HostMac, 6U) != 0) ||
+      (Tap_Get32(&reply[14 + 12]) != Tap_Conf.ipaddr) || (Tap_Get32(&reply[14 + 16]) != Tap_HostIp) ||
+      (Tap_Csum(&reply[14], 20U, 0U) != 0U) || (icmp[0] != 0U) || (Tap_Csum(icmp, 64U, 0U) != 0U) ||
+      (memcmp(&icmp[4], &frame[34 + 4], 60U) != 0))
+  {
+    Tap_Fail("bad echo reply");
+  }
+  Tap_WirePop();
+}
+
+static void Tap_TestReceive(void)
+{
+  static const uint8_t hello[] = "telemetry hello";
+  uint8_t frame[128];
+  uint32_t len;
+  uint32_t errors;
+
+  len = Tap_BuildUdp(frame, TAP_HOST_PORT, Tap_Conf.ipaddr, TAP_TEST_PORT, hello, sizeof(hello));
+  Tap_RxCount = 0U;
+  (void)Tap_Input(frame, len);
+
+  if ((Tap_RxCount != 1U) || (Tap_RxIp != Tap_HostIp) || (Tap_RxSrcPort != TAP_HOST_PORT) ||
+      (Tap_RxDstPort != TAP_TEST_PORT) || (Tap_RxLen != sizeof(hello)) ||
+      (memcmp(Tap_RxData, hello, sizeof(hello)) != 0))
+  {
+    Tap_Fail("datagram not delivered");
+  }
+
+  /* Corrupted payload, dropped on the UDP checksum */
+  errors = Tap_Udp.rx_errors;
+  frame[42] ^= 0x01U;
+  (void)Tap_Input(frame, len);
+#if (USBD_UDP_RX_CHECKSUM == 1U)
+  if ((Tap_RxCount != 1U) || (Tap_Udp.rx_errors != (errors + 1U)))
+  {
+    Tap_Fail("bad UDP checksum accepted");
+  }
+#endif /* USBD_UDP_RX_CHECKSUM */
+  frame[42] ^= 0x01U;
+
+  /* Corrupted IP header */
+  errors = Tap_Udp.rx_errors;
+  frame[14 + 8] ^= 0x01U;
+  (void)Tap_Input(frame, len);
+  if (Tap_Udp.rx_errors != (errors + 1U))
+  {
+    Tap_Fail("bad IP checksum accepted");
+  }
+  frame[14 + 8] ^= 0x01U;
+
+  /* Another station's frame is left to whoever else listens */
+  frame[5] ^= 0x01U;
+  if (Tap_Input(frame, len) != (uint8_t)USBD_FAIL)
+  {
+    Tap_Fail("frame for another MAC taken");
+  }
+
+  /* Directed broadcast of our subnet, not of another one */
+  len = Tap_BuildUdp(frame, TAP_HOST_PORT, TAP_IP(192, 168, 7, 255), TAP_TEST_PORT, hello, sizeof(hello));
+  (void)Tap_Input(frame, len);
+  if (Tap_RxCount != 2U)
+  {
+    Tap_Fail("subnet broadcast not delivered");
+  }
+
+  len = Tap_BuildUdp(frame, TAP_HOST_PORT, TAP_IP(10, 0, 0, 255), TAP_TEST_PORT, hello, sizeof(hello));
+  if ((Tap_Input(frame, len) != (uint8_t)USBD_FAIL) || (Tap_RxCount != 2U))
+  {
+    Tap_Fail("broadcast of another subnet taken");
+  }
+
+  if (Tap_WirePeek(&len) != NULL)
+  {
+    Tap_Fail("unexpected frame on the wire");
+  }
+}
+
+static void Tap_TestResolve(void)
+{
+  USBD_UDP_FlowTypeDef flow;
+  uint8_t *req;
+  uint32_t len;
+
+  if (USBD_UDP_OpenFlow(&Tap_Udp, &flow, TAP_IP(192, 168, 7, 99), TAP_SRC_PORT, 1U) != (uint8_t)USBD_BUSY)
+  {
+    Tap_Fail("flow to an unknown host opened");
+  }
+
+  req = Tap_WirePeek(&len);
+  if ((req == NULL) || (req[0] != 0xFFU) || (Tap_Get16(&req[12]) != 0x0806U) ||
+      (Tap_Get16(&req[14 + 6]) != 1U) || (Tap_Get32(&req[14 + 24]) != TAP_IP(192, 168, 7, 99)))
+  {
+    Tap_Fail("no ARP request for an unknown host");
+  }
+  if (req != NULL)
+  {
+    Tap_WirePop();
+  }
+
+  if (USBD_UDP_OpenFlow(&Tap_Udp, &flow, Tap_HostIp, TAP_SRC_PORT, 1U) != (uint8_t)USBD_OK)
+  {
+    Tap_Fail("flow to the learnt host not opened");
+  }
+}
+
+/* Payload of a datagram the iperf server sent to dst_port, NULL if it is not one */
+static const uint8_t *Tap_IperfPayload(const uint8_t *frame, uint32_t len, uint16_t dst_port,
+                                       uint16_t *payload_len)
+{
+  const uint8_t *ip = &frame[14];
+  const uint8_t *udp = &frame[34];
+  uint16_t udp_len;
+
+  if ((len < 42U) || (Tap_Get16(&frame[12]) != 0x0800U) || (ip[9] != 17U) ||
+      (Tap_Get16(&udp[0]) != USBD_IPERF_PORT) || (Tap_Get16(&udp[2]) != dst_port))
+  {
+    return NULL;
+  }
+
+  udp_len = Tap_Get16(&udp[4]);
+  if ((udp_len < 8U) || (len != (34U + udp_len)) || (Tap_Csum(ip, 20U, 0U) != 0U) ||
+      ((Tap_Get16(&udp[6]) != 0U) && (Tap_Csum(udp, udp_len, Tap_PseudoSum(ip, udp_len)) != 0U)))
+  {
+    Tap_Fail("iperf: bad datagram to port %u", dst_port);
+    return NULL;
+  }
+
+  *payload_len = (uint16_t)(udp_len - 8U);
+
+  return &udp[8];
+}
+
+/* Host side of "iperf -c -u": one datagram late, the server report (twice,
+   as when the first is lost), then "-d" with the reverse test run to its end */
+static void Tap_TestIperf(void)
+{
+  static const int32_t ids[] = { 0, 1, 2, 4, 3, 5, -6 };
+  uint8_t data[TAP_IPERF_LEN];
+  uint8_t frame[42U + TAP_IPERF_LEN];
+  const uint8_t *payload;
+  uint8_t *reply;
+  uint32_t expect_id = 0U;
+  uint32_t fins = 0U;
+  uint32_t polls;
+  uint32_t frame_len;
+  uint32_t len;
+  uint32_t i;
+  uint16_t payload_len;
+  int32_t id;
+
+  (void)memset(data, 0, sizeof(data));
+
+  for (i = 0U; i < (sizeof(ids) / sizeof(ids[0])); i++)
+  {
+    Tap_Put32(&data[0], (uint32_t)ids[i]);
+    Tap_Put32(&data[4], 1U);
+    Tap_Put32(&data[8], i * 1000U);
+    frame_len = Tap_BuildUdp(frame, TAP_HOST_PORT, Tap_Conf.ipaddr, USBD_IPERF_PORT, data, TAP_IPERF_LEN);
+    (void)Tap_Input(frame, frame_len);
+  }
+
+  for (i = 0U; i < 2U; i++)
+  {
+    reply = Tap_WirePeek(&len);
+    payload = (reply != NULL) ? Tap_IperfPayload(reply, len, TAP_HOST_PORT, &payload_len) : NULL;
+
+    if ((payload == NULL) || (payload_len != TAP_IPERF_LEN) || ((int32_t)Tap_Get32(&payload[0]) != -6) ||
+        (Tap_Get32(&payload[12]) != 0x80000000U) || (Tap_Get32(&payload[16]) != 0U) ||
+        (Tap_Get32(&payload[20]) != (7U * TAP_IPERF_LEN)) || (Tap_Get32(&payload[32]) != 0U) ||
+        (Tap_Get32(&payload[36]) != 1U) || (Tap_Get32(&payload[40]) != 7U))
+    {
+      Tap_Fail("iperf: bad server report %u", i);
+    }
+    if (reply != NULL)
+    {
+      Tap_WirePop();
+    }
+
+    /* The client repeats its last datagram until a report arrives */
+    if (i == 0U)
+    {
+      (void)Tap_Input(frame, frame_len);
+    }
+  }
+
+  /* -d: 2000 bytes in 200 byte datagrams at 80 Mbit/s, towards TAP_IPERF_PORT */
+  Tap_Put32(&data[0], 0U);
+  Tap_Put32(&data[12], 0x80000001U);
+  Tap_Put32(&data[16], 1U);
+  Tap_Put32(&data[20], TAP_IPERF_PORT);
+  Tap_Put32(&data[24], 200U);
+  Tap_Put32(&data[28], 80000000U);
+  Tap_Put32(&data[32], 2000U);
+  frame_len = Tap_BuildUdp(frame, TAP_HOST_PORT + 1U, Tap_Conf.ipaddr, USBD_IPERF_PORT, data, TAP_IPERF_LEN);
+  (void)Tap_Input(frame, frame_len);
+
+  for (polls = 0U; (polls < 1000U) && (fins == 0U); polls++)
+  {
+    USBD_Iperf_Process(&Tap_Iperf);
+
+    while ((reply = Tap_WirePeek(&len)) != NULL)
+    {
+      payload = Tap_IperfPayload(reply, len, TAP_IPERF_PORT, &payload_len);
+      if ((payload == NULL) || (payload_len != 200U))
+      {
+        Tap_Fail("iperf: unexpected frame during the reverse test");
+
+      }
+      else
+      {
+        id = (int32_t)Tap_Get32(&payload[0]);
+        if ((id >= 0) && ((uint32_t)id != expect_id++))
+        {
+          Tap_Fail("iperf: reverse datagram %d out of order", id);
+        }
+        else if ((id < 0) && ((uint32_t)(-id) != expect_id))
+        {
+          Tap_Fail("iperf: last reverse datagram %d after %u", id, expect_id);
+        }
+        else
+        {
+          fins += (id < 0) ? 1U : 0U;
+        }
+      }
+      Tap_WirePop();
+    }
+
+    (void)usleep(1000U);
+  }
+
+  if ((fins != 1U) || (expect_id != 10U) || (Tap_Iperf.tx.bytes != 2000U) || (Tap_Iperf.tx.packets != 10U))
+  {
+    Tap_Fail("iperf: reverse test sent %u datagrams, %u closing", expect_id, fins);
+  }
+
+  /* The client's report ends the reverse test */
+  (void)memset(data, 0, sizeof(data));
+  Tap_Put32(&data[0], (uint32_t)-10);
+  frame_len = Tap_BuildUdp(frame, TAP_IPERF_PORT, Tap_Conf.ipaddr, USBD_IPERF_PORT, data, TAP_IPERF_LEN);
+  (void)Tap_Input(frame, frame_len);
+
+  (void)usleep((USBD_IPERF_FIN_INTERVAL + 10U) * 1000U);
+  USBD_Iperf_Process(&Tap_Iperf);
+  if (Tap_WirePeek(&len) != NULL)
+  {
+    Tap_Fail("iperf: reverse test not closed by the client report");
+    Tap_WirePop();
+  }
+}
+
+/* Everything on the wire reaches the host and is checked */
+static void Tap_DrainChecked(uint16_t size, uint32_t *expect_id)
+{
+  uint8_t *frame;
+  uint32_t len;
+
+  while ((frame = Tap_WirePeek(&len)) != NULL)
+  {
+    Tap_CheckDatagram(frame, len, Tap_HostIp, TAP_TEST_PORT, size, (uint16_t)*expect_id);
+    if (Tap_Get32(&frame[42]) != *expect_id)
+    {
+      Tap_Fail("datagram %u out of order", *expect_id);
+    }
+    (*expect_id)++;
+    Tap_WirePop();
+  }
+}
+
+static void Tap_Stream(const Tap_TestTypeDef *test, Tap_ResultTypeDef *res)
+{
+  USBD_UDP_FlowTypeDef flow;
+  uint32_t body_sum;
+  uint32_t expect_id = 0U;
+  uint32_t failures = Tap_Failures;
+  uint32_t stall;
+  uint32_t seq;
+  uint32_t i;
+  uint8_t *payload;
+  uint8_t ret;
+
+  (void)memset(res, 0, sizeof(*res));
+
+  Tap_Cost = &Tap_Unused;
+  Tap_Start(test->mode);
+  Tap_TestArp();
+  Tap_Cost = &res->cost;
+
+  if (USBD_UDP_OpenFlow(&Tap_Udp, &flow, Tap_HostIp, TAP_SRC_PORT, TAP_TEST_PORT) != (uint8_t)USBD_OK)
+  {
+    Tap_Fail("flow not opened");
+    res->errors++;
+    return;
+  }
+
+  /* Constant body behind a 32-bit sequence number, its sum is known upfront */
+  body_sum = 0U;
+  for (i = 4U; i < test->size; i++)
+  {
+    body_sum += ((i & 1U) == 0U) ? ((uint32_t)(uint8_t)i << 8) : (uint8_t)i;
+  }
+
+  for (seq = 0U; seq < test->count; seq++)
+  {
+    for (stall = 0U; stall < TAP_STALL_POLLS; stall++)
+    {
+      HOST_Perf_Begin();
+      payload = USBD_UDP_Alloc(&Tap_Udp);
+      HOST_Perf_End(&res->cost);
+
+      if (payload != NULL)
+      {
+        break;
+      }
+      Tap_DrainChecked(test->size, &expect_id);
+    }
+    if (payload == NULL)
+    {
+      Tap_Fail("no TX frame freed");
+      break;
+    }
+
+    /* Application work, not accounted */
+    Tap_Put32(payload, seq);
+    for (i = 4U; i < test->size; i++)
+    {
+      payload[i] = (uint8_t)i;
+    }
+
+    for (stall = 0U; stall < TAP_STALL_POLLS; stall++)
+    {
+      HOST_Perf_Begin();
+      if (test->send == TAP_SEND_SUMMED)
+      {
+        ret = USBD_UDP_SendSummed(&Tap_Udp, &flow, payload, test->size,
+                                  body_sum + (seq >> 16) + (seq & 0xFFFFU));
+      }
+      else
+      {
+        ret = USBD_UDP_Send(&Tap_Udp, &flow, payload, test->size);
+      }
+      HOST_Perf_End(&res->cost);
+
+      if (ret == (uint8_t)USBD_OK)
+      {
+        res->datagrams++;
+        break;
+      }
+      res->busy++;
+      Tap_DrainChecked(test->size, &expect_id);
+    }
+    if (ret != (uint8_t)USBD_OK)
+    {
+      Tap_Fail("datagram %u never sent", seq);
+      break;
+    }
+  }
+
+  Tap_DrainChecked(test->size, &expect_id);
+
+  if (expect_id != test->count)
+  {
+    Tap_Fail("%u of %u datagrams on the wire", expect_id, test->count);
+  }
+
+  res->errors = Tap_Failures - failures;
+}
+
+static void Tap_Report(const Tap_TestTypeDef *test, const Tap_ResultTypeDef *res)
+{
+  double ns = (res->datagrams != 0U) ? ((double)res->cost.ns / res->datagrams) : 0.0;
+  double bus_fps = TAP_HS_BULK_BPS / (double)(USBD_UDP_HLEN + test->size);
+
+  (void)printf("%-5s %-7s %7u %8u %9.1f ", Tap_ModeName[test->mode], Tap_SendName[test->send],
+               test->size, res->datagrams, ns);
+  if (HOST_Perf_HasInstr() != 0U)
+  {
+    (void)printf("%11.1f ", (double)res->cost.instr / (res->datagrams != 0U ? res->datagrams : 1U));
+  }
+  else
+  {
+    (void)printf("%11s ", "-");
+  }
+  (void)printf("%10.0f %8.0f %7.1f%% %5u %6u\n", (ns > 0.0) ? (1e6 / ns) : 0.0, bus_fps / 1000.0,
+               ns * bus_fps / 1e7, res->busy, res->errors);
+}
+
+static int Tap_SelfTest(uint8_t mode, uint8_t send, uint16_t size, uint32_t count)
+{
+  static const uint16_t default_size[] = { 64U, 512U, 1472U };
+  Tap_TestTypeDef test;
+  Tap_ResultTypeDef res;
+  uint8_t m, s, x;
+
+  HOST_Perf_Init();
+
+  /* Protocol checks in both TX modes */
+  for (m = 0U; m < 2U; m++)
+  {
+    Tap_Cost = &Tap_Unused;
+    Tap_Start(m);
+    Tap_TestArp();
+    Tap_TestEcho();
+    Tap_TestReceive();
+    Tap_TestResolve();
+    Tap_TestIperf();
+
+    for (x = 0U; x < USBD_UDP_TX_FRAMES; x++)
+    {
+      if (Tap_Udp.tx_frame[x].busy != 0U)
+      {
+        Tap_Fail("%s mode: TX frame %u leaked", Tap_ModeName[m], x);
+      }
+    }
+  }
+
+  if (Tap_Quiet == 0U)
+  {
+    (void)printf("%-5s %-7s %7s %8s %9s %11s %10s %8s %8s %5s %6s\n", "tx", "send", "payload",
+                 "dgrams", "ns/dgram", "instr/dgram", "kdgram/s", "bus k/s", "bus cpu", "busy", "errors");
+  }
+
+  for (m = 0U; m < 2U; m++)
+  {
+    for (s = 0U; s < 2U; s++)
+    {
+      for (x = 0U; x < 3U; x++)
+      {
+        if (((mode != TAP_ALL) && (mode != m)) || ((send != TAP_ALL) && (send != s)) ||
+            ((size != 0U) && (x != 0U)))
+        {
+          continue;
+        }
+
+        test.mode = m;
+        test.send = s;
+        test.size = (size != 0U) ? size : default_size[x];
+        test.count = count;
+
+        Tap_Stream(&test, &res);
+
+        if (Tap_Quiet == 0U)
+        {
+          Tap_Report(&test, &res);
+        }
+      }
+    }
+  }
+
+  if (Tap_Failures != 0U)
+  {
+    (void)fprintf(stderr, "%u check(s) failed\n", Tap_Failures);
+  }
+
+  return (Tap_Failures == 0U) ? 0 : 1;
+}
+
+/* TAP mode ------------------------------------------------------------------*/
+
+static void Tap_Signal(int sig)
+{
+  (void)sig;
+  Tap_Stop = 1;
+}
+
+static uint64_t Tap_NowNs(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* Hands everything on the wire to the kernel */
+static void Tap_DrainTap(void)
+{
+  uint8_t *frame;
+  uint32_t len;
+
+  while ((frame = Tap_WirePeek(&len)) != NULL)
+  {
+    /* EIO while the interface is down, the frame is lost like on a cable */
+    if ((write(Tap_Fd, frame, len) < 0) && (errno != EIO))
+    {
+      perror("tap write");
+    }
+    Tap_WirePop();
+  }
+}
+
+static int Tap_Run(const char *ifname, uint32_t dst, uint16_t dst_port, uint32_t rate,
+                   uint16_t size, uint32_t count)
+{
+  static uint8_t frame[USBD_UDP_FRAME_SIZE];
+  USBD_UDP_FlowTypeDef flow;
+  struct ifreq ifr;
+  struct pollfd pfd;
+  uint64_t start;
+  uint64_t next;
+  uint64_t now;
+  uint64_t last_arp = 0U;
+  uint32_t sent = 0U;
+  uint32_t sent_iperf;
+  uint8_t resolved = 0U;
+  uint8_t *payload;
+  ssize_t n;
+
+  Tap_Fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if (Tap_Fd < 0)
+  {
+    perror("/dev/net/tun");
+    return 1;
+  }
+
+  (void)memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  (void)strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  if (ioctl(Tap_Fd, TUNSETIFF, &ifr) < 0)
+  {
+    perror(ifname);
+    (void)close(Tap_Fd);
+    return 1;
+  }
+
+  (void)signal(SIGINT, Tap_Signal);
+  (void)signal(SIGTERM, Tap_Signal);
+
+  HOST_Perf_Init();
+  Tap_Cost = &Tap_Unused;
+  Tap_Start(TAP_MODE_REF);
+
+  start = Tap_NowNs();
+  next = start;
+
+  while ((Tap_Stop == 0) && ((dst == 0U) || (count == 0U) || (sent < count)))
+  {
+    pfd.fd = Tap_Fd;
+    pfd.events = POLLIN;
+    (void)poll(&pfd, 1, (dst != 0U) ? 0 : 1);
+
+    while ((n = read(Tap_Fd, frame, sizeof(frame))) > 0)
+    {
+      (void)Tap_Input(frame, (uint32_t)n);
+      Tap_DrainTap();
+    }
+    if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+    {
+      perror("tap read");
+      break;
+    }
+
+    /* iperf reverse tests, as long as they find room on the wire */
+    do
+    {
+      sent_iperf = Tap_WireHead;
+      HOST_Perf_Begin();
+      USBD_Iperf_Process(&Tap_Iperf);
+      HOST_Perf_End(Tap_Cost);
+      Tap_DrainTap();
+    } while (Tap_WireHead != sent_iperf);
+
+    if (dst == 0U)
+    {
+      continue;
+    }
+
+    now = Tap_NowNs();
+
+    if (resolved == 0U)
+    {
+      if ((now - last_arp) >= 100000000ULL)
+      {
+        last_arp = now;
+        resolved = (USBD_UDP_OpenFlow(&Tap_Udp, &flow, dst, TAP_SRC_PORT, dst_port) == (uint8_t)USBD_OK) ? 1U : 0U;
+        Tap_DrainTap();
+        next = now;
+      }
+      continue;
+    }
+
+    /* Telemetry: sequence number and timestamp, then a fixed pattern */
+    while ((now >= next) && ((count == 0U) || (sent < count)))
+    {
+      payload = USBD_UDP_Alloc(&Tap_Udp);
+      if (payload == NULL)
+      {
+        break;
+      }
+
+      Tap_Put32(payload, sent);
+      Tap_Put32(&payload[4], (uint32_t)((now - start) / 1000U));
+      (void)memset(&payload[8], 0xA5, size - 8U);
+
+      HOST_Perf_Begin();
+      if (USBD_UDP_Send(&Tap_Udp, &flow, payload, size) != (uint8_t)USBD_OK)
+      {
+        USBD_UDP_Free(&Tap_Udp, payload);
+      }
+      HOST_Perf_End(Tap_Cost);
+      Tap_DrainTap();
+
+      sent++;
+      next += (rate != 0U) ? (1000000000ULL / rate) : 0U;
+    }
+  }
+
+  (void)printf("rx frames %u datagrams %u errors %u, tx datagrams %u busy %u, arp %u echo %u\n",
+               Tap_Udp.rx_frames, Tap_Udp.rx_datagrams, Tap_Udp.rx_errors, Tap_Udp.tx_datagrams,
+               Tap_Udp.tx_busy, Tap_Udp.arp_replies, Tap_Udp.echo_replies);
+  (void)printf("iperf rx %u tests %llu bytes %u kbit/s lost %u late %u jitter %u us, "
+               "tx %u tests %llu bytes %u kbit/s\n",
+               Tap_Iperf.rx.tests, (unsigned long long)Tap_Iperf.rx.bytes, USBD_Iperf_Kbps(&Tap_Iperf.rx),
+               Tap_Iperf.rx.lost, Tap_Iperf.rx.out_of_order, Tap_Iperf.rx.jitter_us,
+               Tap_Iperf.tx.tests, (unsigned long long)Tap_Iperf.tx.bytes, USBD_Iperf_Kbps(&Tap_Iperf.tx));
+
+  (void)close(Tap_Fd);
+  Tap_Fd = -1;
+
+  return 0;
+}
+
+/* Command line --------------------------------------------------------------*/
+
+static uint8_t Tap_Lookup(const char *arg, const char **names, uint8_t count)
+{
+  uint8_t i;
+
+  if (strcmp(arg, "all") == 0)
+  {
+    return TAP_ALL;
+  }
+
+  for (i = 0U; i < count; i++)
+  {
+    if (strcmp(arg, names[i]) == 0)
+    {
+      return i;
+    }
+  }
+
+  (void)fprintf(stderr, "unknown value '%s'\n", arg);
+  exit(2);
+}
+
+static void Tap_Usage(const char *prog)
+{
+  (void)fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -m, --mode ref|copy|all       TX frame ownership (all)\n"
+                "  -S, --send plain|summed|all   payload sum by the stack or the app (all)\n"
+                "  -s, --size BYTES              payload, 0 for 64, 512 and 1472 (0)\n"
+                "  -n, --count N                 datagrams per test, 0 in TAP mode: no end (4096)\n"
+                "  -t, --tap NAME                run on a TAP device instead of the self-test\n"
+                "  -d, --dest IP:PORT            TAP mode: stream telemetry there\n"
+                "  -r, --rate N                  TAP mode: datagrams per second, 0 as fast as possible (100)\n"
+                "  -q, --quiet                   no table on stdout\n",
+                prog);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option opts[] =
+  {
+    { "mode", required_argument, NULL, 'm' },
+    { "send", required_argument, NULL, 'S' },
+    { "size", required_argument, NULL, 's' },
+    { "count", required_argument, NULL, 'n' },
+    { "tap", required_argument, NULL, 't' },
+    { "dest", required_argument, NULL, 'd' },
+    { "rate", required_argument, NULL, 'r' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  uint8_t mode = TAP_ALL;
+  uint8_t send = TAP_ALL;
+  uint32_t size = 0U;
+  uint32_t count = 4096U;
+  uint32_t rate = 100U;
+  uint8_t count_set = 0U;
+  const char *tap = NULL;
+  uint32_t dst = 0U;
+  uint16_t dst_port = 0U;
+  struct in_addr addr;
+  char *colon;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "m:S:s:n:t:d:r:qh", opts, NULL)) != -1)
+  {
+    switch (c)
+    {
+      case 'm': mode = Tap_Lookup(optarg, Tap_ModeName, 2U); break;
+      case 'S': send = Tap_Lookup(optarg, Tap_SendName, 2U); break;
+      case 's': size = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'n': count = (uint32_t)strtoul(optarg, NULL, 0); count_set = 1U; break;
+      case 't': tap = optarg; break;
+      case 'r': rate = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'q': Tap_Quiet = 1U; break;
+      case 'd':
+        colon = strchr(optarg, ':');
+        if ((colon == NULL) || (*colon = '\0', inet_aton(optarg, &addr) == 0))
+        {
+          Tap_Usage(argv[0]);
+          return 2;
+        }
+        dst = ntohl(addr.s_addr);
+        dst_port = (uint16_t)strtoul(colon + 1, NULL, 0);
+        break;
+      default: Tap_Usage(argv[0]); return (c == 'h') ? 0 : 2;
+    }
+  }
+
+  if (size > USBD_UDP_MAX_PAYLOAD)
+  {
+    Tap_Usage(argv[0]);
+    return 2;
+  }
+
+  if (tap != NULL)
+  {
+    if ((dst != 0U) && (size < 8U))
+    {
+      size = (size == 0U) ? 64U : 8U;
+    }
+    return Tap_Run(tap, dst, dst_port, rate, (uint16_t)size, (count_set != 0U) ? count : 0U);
+  }
+
+  if ((size != 0U) && (size < 4U))
+  {
+    Tap_Usage(argv[0]);
+    return 2;
+  }
+
+  return Tap_SelfTest(mode, send, (uint16_t)size, count);
+}
@@ -0,0 +1,461 @@
+/**
+  ******************************************************************************
+  * @file           : uvc_bench.c
+  * @brief          : UVC streaming harness for the generated test pattern.
+  *
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                Operation
+  *          ===================================================================
+  *           usbd_video.c and usbd_video_pattern.c are built unchanged for
+  *           the host and driven through sim_pcd.c: the harness plays the
+  *           host, negotiating the largest frame at the fastest rate with
+  *           probe/commit and selecting the streaming altsetting, then
+  *           gives the class an SOF each (micro)frame and collects the
+  *           payload the isochronous endpoint holds.
+  *
+  *           Each image is reassembled from its payloads and checked:
+  *           frame ID toggling, EOF on the last payload, the committed size,
+  *           and every byte against the same image rendered whole by a
+  *           second pattern handle, so a lost image shows as a counter
+  *           mismatch. Bar luma is also checked at fixed points.
+  *
+  *           Only the class SOF/DataIn callbacks, which generate the
+  *           payloads, are accounted: the figures are the CPU cost of
+  *           streaming without a frame buffer, next to the RAM it takes.
+  *
+  *  @endverbatim
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim_pcd.h"
+#include "host_perf.h"
+#include "usbd_video.h"
+#include "usbd_video_pattern.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BENCH_ALL                        0xFFU
+
+/* (Micro)frames allowed per image before the run is called stalled */
+#define BENCH_SOF_LIMIT                  100000U
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint8_t speed;           /* 0 full, 1 high */
+  uint8_t format;          /* 0 YUY2, 1 NV12 */
+  uint32_t frames;
+} Bench_TestTypeDef;
+
+typedef struct
+{
+  USBD_VIDEO_StreamTypeDef stream;
+  uint32_t images;
+  uint32_t payloads;
+  uint32_t sofs;
+  uint64_t bytes;
+  uint32_t errors;
+  HOST_PerfTypeDef cost;
+} Bench_ResultTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const Bench_SpeedName[] = { "fs", "hs" };
+static const char *const Bench_FormatName[] = { "yuy2", "nv12" };
+static const uint8_t Bench_Format[] = { UVC_FORMAT_YUY2, UVC_FORMAT_NV12 };
+
+static USBD_HandleTypeDef Bench_Dev;
+static USBD_VideoPattern_HandleTypeDef Bench_Pattern;   /* Streamed */
+static USBD_VideoPattern_HandleTypeDef Bench_RefPattern;
+static Bench_ResultTypeDef *Bench_Run;
+
+static uint8_t Bench_Packet[UVC_MAX_PAYLOAD];
+static uint8_t Bench_Image[UVC_MAX_FRAME_SIZE];
+static uint8_t Bench_Ref[UVC_MAX_FRAME_SIZE];
+
+/* Interface callbacks -------------------------------------------------------*/
+
+static int8_t Bench_Init(void)
+{
+  return 0;
+}
+
+static int8_t Bench_DeInit(void)
+{
+  return 0;
+}
+
+static int8_t Bench_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  if ((cmd == VIDEO_CMD_START) && (length == sizeof(USBD_VIDEO_StreamTypeDef)))
+  {
+    (void)memcpy(&Bench_Run->stream, pbuf, length);
+    USBD_VideoPattern_Start(&Bench_Pattern, &Bench_Run->stream);
+  }
+
+  return 0;
+}
+
+static int8_t Bench_Data(USBD_VIDEO_FrameTypeDef *frame)
+{
+  return USBD_VideoPattern_Next(&Bench_Pattern, frame);
+}
+
+static USBD_VIDEO_ItfTypeDef Bench_Fops =
+{
+  Bench_Init,
+  Bench_DeInit,
+  Bench_Control,
+  Bench_Data,
+  NULL,
+};
+
+/* Device side, everything here is accounted ---------------------------------*/
+
+static void Bench_Sof(void)
+{
+  ((PCD_HandleTypeDef *)Bench_Dev.pData)->FrameNumber++;
+
+  HOST_Perf_Begin();
+  (void)USBD_VIDEO.SOF(&Bench_Dev);
+  HOST_Perf_End(&Bench_Run->cost);
+}
+
+static void Bench_DataIn(void)
+{
+  HOST_Perf_Begin();
+  (void)USBD_VIDEO.DataIn(&Bench_Dev, UVC_IN_EP & 0x7FU);
+  HOST_Perf_End(&Bench_Run->cost);
+}
+
+/* Host side -----------------------------------------------------------------*/
+
+static void Bench_Error(const char *what, uint32_t image)
+{
+  Bench_Run->errors++;
+  (void)fprintf(stderr, "FAIL: %s, image %u\n", what, image);
+}
+
+static void Bench_Request(uint8_t bmRequest, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength)
+{
+  USBD_SetupReqTypedef req;
+
+  req.bmRequest = bmRequest;
+  req.bRequest = bRequest;
+  req.wValue = wValue;
+  req.wIndex = wIndex;
+  req.wLength = wLength;
+
+  (void)USBD_VIDEO.Setup(&Bench_Dev, &req);
+}
+
+/* Probe then commit the host choice, the device answers with what it can do */
+static void Bench_Negotiate(uint8_t format)
+{
+  USBD_VideoControlTypeDef ctrl;
+  uint16_t sel;
+
+  for (sel = VS_PROBE_CONTROL; sel <= VS_COMMIT_CONTROL; sel += VS_PROBE_CONTROL)
+  {
+    (void)memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.bFormatIndex = format;
+    ctrl.bFrameIndex = 1U;
+    ctrl.dwFrameInterval = UVC_INTERVAL(UVC_FPS_1);
+
+    Bench_Request(0x21U, UVC_SET_CUR, sel, 1U, 26U);
+    (void)SIM_PCD_PutOut(0x00U, (const uint8_t *)&ctrl, 26U);
+    (void)USBD_VIDEO.EP0_RxReady(&Bench_Dev);
+
+    if (sel == VS_PROBE_CONTROL)
+    {
+      Bench_Request(0xA1U, UVC_GET_CUR, sel, 1U, sizeof(ctrl));
+      (void)SIM_PCD_TakeIn(0x80U, (uint8_t *)&ctrl, sizeof(ctrl));
+      if ((ctrl.bFormatIndex != format) || (ctrl.bFrameIndex != 1U))
+      {
+        Bench_Error("probe not taken", 0U);
+      }
+    }
+  }
+
+  /* The limits are the fastest and slowest rate offered, whatever was probed */
+  Bench_Request(0xA1U, UVC_GET_MIN, VS_PROBE_CONTROL, 1U, sizeof(ctrl));
+  (void)SIM_PCD_TakeIn(0x80U, (uint8_t *)&ctrl, sizeof(ctrl));
+  if (ctrl.dwFrameInterval != MIN(UVC_INTERVAL(UVC_FPS_1), MIN(UVC_INTERVAL(UVC_FPS_2), UVC_INTERVAL(UVC_FPS_3))))
+  {
+    Bench_Error("GET_MIN interval", 0U);
+  }
+
+  Bench_Request(0xA1U, UVC_GET_MAX, VS_PROBE_CONTROL, 1U, sizeof(ctrl));
+  (void)SIM_PCD_TakeIn(0x80U, (uint8_t *)&ctrl, sizeof(ctrl));
+  if (ctrl.dwFrameInterval != MAX(UVC_INTERVAL(UVC_FPS_1), MAX(UVC_INTERVAL(UVC_FPS_2), UVC_INTERVAL(UVC_FPS_3))))
+  {
+    Bench_Error("GET_MAX interval", 0U);
+  }
+}
+
+/* Luma of the pixel at (x, y), reassembled image */
+static uint8_t Bench_Luma(const USBD_VIDEO_StreamTypeDef *stream, uint32_t x, uint32_t y)
+{
+  if (stream->format == UVC_FORMAT_YUY2)
+  {
+    return Bench_Image[(((y * stream->width) + x) * 2U)];
+  }
+
+  return Bench_Image[(y * stream->width) + x];
+}
+
+static void Bench_CheckImage(uint32_t size, uint32_t image)
+{
+  const USBD_VIDEO_StreamTypeDef *stream = &Bench_Run->stream;
+  USBD_VIDEO_FrameTypeDef ref;
+  uint32_t y = stream->height / 3U;
+
+  (void)memset(&ref, 0, sizeof(ref));
+  if ((USBD_VideoPattern_Next(&Bench_RefPattern, &ref) != 0) || (ref.size != size))
+  {
+    Bench_Error("image size", image);
+    return;
+  }
+
+  ref.fill(&ref, Bench_Ref, 0U, ref.size);
+  if (memcmp(Bench_Image, Bench_Ref, size) != 0)
+  {
+    Bench_Error("image data", image);
+  }
+
+  /* White and black bars at 75% */
+  if ((Bench_Luma(stream, stream->width / 16U, y) != 180U) ||
+      (Bench_Luma(stream, stream->width - (stream->width / 16U), y) != 16U))
+  {
+    Bench_Error("bars", image);
+  }
+}
+
+static void Bench_Test(const Bench_TestTypeDef *test, Bench_ResultTypeDef *res)
+{
+  uint8_t ep = UVC_IN_EP;
+  uint32_t offset = 0U;
+  uint32_t sof_limit;
+  uint8_t fid = 0xFFU;     /* Of the image being reassembled... */
+  uint8_t last = 0xFFU;    /* ...and of the previous one */
+  uint32_t len;
+  uint32_t hl;
+  uint8_t info;
+
+  (void)memset(res, 0, sizeof(*res));
+  Bench_Run = res;
+
+  SIM_PCD_Reset(&Bench_Dev, (test->speed == 0U) ? USBD_SPEED_FULL : USBD_SPEED_HIGH);
+  (void)USBD_VIDEO_RegisterInterface(&Bench_Dev, &Bench_Fops);
+  (void)USBD_VIDEO.Init(&Bench_Dev, 0U);
+
+  Bench_Negotiate(Bench_Format[test->format]);
+  Bench_Request(0x01U, USB_REQ_SET_INTERFACE, 1U, 1U, 0U);
+  USBD_VideoPattern_Start(&Bench_RefPattern, &res->stream);
+
+  sof_limit = (test->frames + 1U) * BENCH_SOF_LIMIT;
+
+  while ((res->images < test->frames) && (res->errors == 0U) && (res->sofs < sof_limit))
+  {
+    Bench_Sof();
+    res->sofs++;
+
+    /* A payload per (micro)frame, the next one is armed as it goes */
+    if (SIM_PCD_InReady(ep) == 0U)
+    {
+      continue;
+    }
+
+    len = SIM_PCD_TakeIn(ep, Bench_Packet, sizeof(Bench_Packet));
+    Bench_DataIn();
+
+    hl = Bench_Packet[0];
+    info = Bench_Packet[1];
+    if ((len < hl) || (hl < 2U))
+    {
+      Bench_Error("payload header", res->images);
+      break;
+    }
+    if (len == hl)
+    {
+      continue;
+    }
+
+    res->payloads++;
+
+    if (offset == 0U)
+    {
+      fid = info & UVC_HEADER_FID;
+      if (fid == last)
+      {
+        Bench_Error("frame ID not toggled", res->images);
+      }
+    }
+    else if ((info & UVC_HEADER_FID) != fid)
+    {
+      Bench_Error("image cut short", res->images);
+      break;
+    }
+
+    if ((offset + (len - hl)) > sizeof(Bench_Image))
+    {
+      Bench_Error("image too large", res->images);
+      break;
+    }
+
+    (void)memcpy(&Bench_Image[offset], &Bench_Packet[hl], len - hl);
+    offset += len - hl;
+
+    if ((info & UVC_HEADER_EOF) != 0U)
+    {
+      Bench_CheckImage(offset, res->images);
+      res->bytes += offset;
+      res->images++;
+      offset = 0U;
+      last = fid;
+    }
+  }
+
+  if (res->images < test->frames)
+  {
+    Bench_Error("stream stalled", res->images);
+  }
+
+  Bench_Request(0x01U, USB_REQ_SET_INTERFACE, 0U, 1U, 0U);
+  (void)USBD_VIDEO.DeInit(&Bench_Dev, 0U);
+}
+
+static void Bench_Report(const Bench_TestTypeDef *test, const Bench_ResultTypeDef *res)
+{
+  double period = (test->speed == 0U) ? 1e-3 : 125e-6;
+
+  /* Committed rate, what the bus carried and what the device CPU could generate */
+  (void)printf("%-3s %-5s %4ux%-4u %5.1f %8.2f %8.1f %10.1f ",
+               Bench_SpeedName[test->speed], Bench_FormatName[test->format],
+               res->stream.width, res->stream.height,
+               (res->stream.interval != 0U) ? (1e7 / (double)res->stream.interval) : 0.0,
+               (res->sofs != 0U) ? ((double)res->bytes / ((double)res->sofs * period) / 1e6) : 0.0,
+               (res->cost.ns != 0U) ? ((double)res->bytes * 1000.0 / (double)res->cost.ns) : 0.0,
+               (res->payloads != 0U) ? ((double)res->cost.ns / (double)res->payloads) : 0.0);
+  if ((HOST_Perf_HasInstr() != 0U) && (res->payloads != 0U))
+  {
+    (void)printf("%12.0f ", (double)res->cost.instr / (double)res->payloads);
+  }
+  else
+  {
+    (void)printf("%12s ", "-");
+  }
+  (void)printf("%6u\n", res->errors);
+}
+
+static uint8_t Bench_Lookup(const char *arg, const char *const *names, uint8_t nbr)
+{
+  uint8_t i;
+
+  if (strcmp(arg, "all") == 0)
+  {
+    return BENCH_ALL;
+  }
+
+  for (i = 0U; i < nbr; i++)
+  {
+    if (strcmp(arg, names[i]) == 0)
+    {
+      return i;
+    }
+  }
+
+  (void)fprintf(stderr, "unknown value '%s'\n", arg);
+  exit(2);
+}
+
+static void Bench_Usage(const char *prog)
+{
+  (void)fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -s, --speed fs|hs|all        bus speed (all)\n"
+                "  -f, --format yuy2|nv12|all   committed format (all)\n"
+                "  -n, --frames N               images per test (8)\n"
+                "  -q, --quiet                  no table on stdout\n",
+                prog);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option opts[] =
+  {
+    { "speed", required_argument, NULL, 's' },
+    { "format", required_argument, NULL, 'f' },
+    { "frames", required_argument, NULL, 'n' },
+    { "quiet", no_argument, NULL, 'q' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  uint8_t speed = BENCH_ALL;
+  uint8_t format = BENCH_ALL;
+  uint8_t quiet = 0U;
+  Bench_TestTypeDef test;
+  Bench_ResultTypeDef res;
+  uint32_t failed = 0U;
+  uint32_t frames = 8U;
+  uint8_t s, f;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "s:f:n:qh", opts, NULL)) != -1)
+  {
+    switch (c)
+    {
+      case 's': speed = Bench_Lookup(optarg, Bench_SpeedName, 2U); break;
+      case 'f': format = Bench_Lookup(optarg, Bench_FormatName, 2U); break;
+      case 'n': frames = (uint32_t)strtoul(optarg, NULL, 0); break;
+      case 'q': quiet = 1U; break;
+      default: Bench_Usage(argv[0]); return (c == 'h') ? 0 : 2;
+    }
+  }
+
+  if (frames == 0U)
+  {
+    Bench_Usage(argv[0]);
+    return 2;
+  }
+
+  HOST_Perf_Init();
+
+  if (quiet == 0U)
+  {
+    (void)printf("RAM without a frame buffer: %u bytes pattern handle, %u of them payload buffer\n",
+                 (unsigned)sizeof(USBD_VideoPattern_HandleTypeDef), (unsigned)UVC_MAX_PAYLOAD);
+    (void)printf("%-3s %-5s %9s %5s %8s %8s %10s %12s %6s\n",
+                 "bus", "fmt", "size", "fps", "bus MB/s", "cpu MB/s", "ns/payld", "instr/payld", "errors");
+  }
+
+  for (s = 0U; s < 2U; s++)
+  {
+    for (f = 0U; f < 2U; f++)
+    {
+      if (((speed != BENCH_ALL) && (speed != s)) || ((format != BENCH_ALL) && (format != f)))
+      {
+        continue;
+      }
+
+      test.speed = s;
+      test.format = f;
+      test.frames = frames;
+
+      Bench_Test(&test, &res);
+      failed += res.errors;
+
+      if (quiet == 0U)
+      {
+        Bench_Report(&test, &res);
+      }
+    }
+  }
+
+  return (failed == 0U) ? 0 : 1;
+}